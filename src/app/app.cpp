@@ -35,6 +35,7 @@
 #include "app/modules/gfx.h"
 #include "app/modules/gui.h"
 #include "app/modules/palettes.h"
+#include "app/perf_trace.h"
 #include "app/pref/preferences.h"
 #include "app/recent_files.h"
 #include "app/resource_finder.h"
@@ -55,6 +56,7 @@
 #include "app/ui/workspace.h"
 #include "app/ui_context.h"
 #include "app/util/clipboard.h"
+#include "base/chrono.h"
 #include "base/exception.h"
 #include "base/fs.h"
 #include "base/platform.h"
@@ -118,6 +120,68 @@ private:
 
 #endif // ENABLER_SCRIPTING
 
+namespace {
+
+// Measures the time spent in each step of App::initialize(). Each
+// step is logged (visible with --verbose) and recorded in the trace
+// file specified with --startup-trace.
+class StartupTimeline {
+public:
+  StartupTimeline(const std::string& traceFilename)
+    : m_traceFilename(traceFilename) {
+    if (!m_traceFilename.empty())
+      start_perf_trace();
+  }
+
+  ~StartupTimeline() {
+    finish();
+  }
+
+  // Finishes the current step and starts a new one. The name must be
+  // a string literal.
+  void step(const char* name) {
+    endStep();
+    m_name = name;
+    m_stepChrono.reset();
+    m_perf.emplace(PerfCategory::Startup, name);
+  }
+
+  void finish() {
+    if (m_finished)
+      return;
+    m_finished = true;
+
+    endStep();
+    LOG("APP: Startup took %.2f ms\n", m_totalChrono.elapsed()*1000.0);
+
+    if (!m_traceFilename.empty()) {
+      stop_perf_trace();
+      if (!save_perf_trace(m_traceFilename))
+        LOG(ERROR, "APP: Error saving startup trace in %s\n",
+            m_traceFilename.c_str());
+    }
+  }
+
+private:
+  void endStep() {
+    if (!m_name)
+      return;
+    m_perf.reset();
+    LOG("APP: Startup step \"%s\" took %.2f ms\n",
+        m_name, m_stepChrono.elapsed()*1000.0);
+    m_name = nullptr;
+  }
+
+  std::string m_traceFilename;
+  const char* m_name = nullptr;
+  base::Chrono m_totalChrono;
+  base::Chrono m_stepChrono;
+  std::optional<PerfScope> m_perf;
+  bool m_finished = false;
+};
+
+} // anonymous namespace
+
 class App::CoreModules {
 public:
 #ifdef ENABLE_UI
@@ -281,6 +345,9 @@ int App::initialize(const AppOptions& options)
 #endif
 
   m_isShell = options.startShell();
+
+  StartupTimeline timeline(options.startupTrace());
+  timeline.step("Config and preferences");
   m_coreModules = std::make_unique<CoreModules>();
 
   auto& pref = preferences();
@@ -335,6 +402,7 @@ int App::initialize(const AppOptions& options)
       break;
   }
 
+  timeline.step("Color spaces");
   initialize_color_spaces(pref);
 
 #ifdef ENABLE_DRM
@@ -348,21 +416,29 @@ int App::initialize(const AppOptions& options)
 #endif
 
   // Load modules
+  timeline.step("Modules");
   m_modules = std::make_unique<Modules>(createLogInDesktop, pref);
+  timeline.step("Legacy modules");
   m_legacy = std::make_unique<LegacyModules>(isGui() ? REQUIRE_INTERFACE: 0);
 #ifdef ENABLE_UI
-  m_brushes = std::make_unique<AppBrushes>();
+  if (isGui()) {
+    timeline.step("Brushes");
+    m_brushes = std::make_unique<AppBrushes>();
+  }
 #endif
 
   // Data recovery is enabled only in GUI mode
-  if (isGui() && pref.general.dataRecovery())
+  if (isGui() && pref.general.dataRecovery()) {
+    timeline.step("Data recovery");
     m_modules->createDataRecovery(context());
+  }
 
   if (isPortable())
     LOG("APP: Running in portable mode\n");
 
   // Load or create the default palette, or migrate the default
   // palette from an old format palette to the new one, etc.
+  timeline.step("Default palette");
   load_default_palette();
 
 #ifdef ENABLE_UI
@@ -383,6 +459,7 @@ int App::initialize(const AppOptions& options)
     manager->invalidate();
 
     // Create the main window.
+    timeline.step("Main window");
     m_mainWindow.reset(new MainWindow);
     m_mainWindow->initialize();
     if (m_mod)
@@ -421,11 +498,13 @@ int App::initialize(const AppOptions& options)
 #ifdef ENABLE_SCRIPTING
   // Call the init() function from all plugins
   LOG("APP: Initializing scripts...\n");
+  timeline.step("Scripts init");
   extensions().executeInitActions();
 #endif
 
   // Process options
   LOG("APP: Processing options...\n");
+  timeline.step("Process options");
   int code;
   {
     std::unique_ptr<CliDelegate> delegate;
@@ -439,7 +518,9 @@ int App::initialize(const AppOptions& options)
   }
 
   LOG("APP: Finish launching...\n");
+  timeline.step("Finish launching");
   system->finishLaunching();
+  timeline.finish();
   return code;
 }
 
@@ -103,7 +103,10 @@ namespace app {
 
 #ifdef ENABLE_UI
     AppBrushes& brushes() {
-      ASSERT(m_brushes.get());
+      // In batch mode the brushes are loaded only if they are used
+      // (e.g. from a script)
+      if (!m_brushes)
+        m_brushes = std::make_unique<AppBrushes>();
       return *m_brushes;
     }
 
@@ -38,10 +38,11 @@ AppOptions::AppOptions(int argc, const char* argv[])
   , m_colorMode(m_po.add("color-mode").requiresValue("<mode>").description("Change color mode of all previously\nopened sprites:\n  rgb\n  grayscale\n  indexed"))
   , m_shrinkTo(m_po.add("shrink-to").requiresValue("width,height").description("Shrink each sprite if it is\nlarger than width or height"))
   , m_data(m_po.add("data").requiresValue("<filename.json>").description("File to store the sprite sheet metadata"))
-  , m_format(m_po.add("format").requiresValue("<format>").description("Format to export the data file\n(json-hash, json-array)"))
+  , m_format(m_po.add("format").requiresValue("<format>").description("Format to export the data file\n(json-hash, json-array, binary)"))
   , m_sheet(m_po.add("sheet").requiresValue("<filename.png>").description("Image file to save the texture"))
   , m_sheetType(m_po.add("sheet-type").requiresValue("<type>").description("Algorithm to create the sprite sheet:\n  horizontal\n  vertical\n  rows\n  columns\n  packed"))
   , m_sheetPack(m_po.add("sheet-pack").description("Same as -sheet-type packed"))
+  , m_sheetPackFast(m_po.add("sheet-pack-fast").description("Use a faster algorithm to pack the sprite sheet\n(-sheet-type packed) with lots of frames,\nthe texture can be bigger"))
   , m_sheetWidth(m_po.add("sheet-width").requiresValue("<pixels>").description("Sprite sheet width"))
   , m_sheetHeight(m_po.add("sheet-height").requiresValue("<pixels>").description("Sprite sheet height"))
   , m_sheetColumns(m_po.add("sheet-columns").requiresValue("<columns>").description("Fixed # of columns for -sheet-type rows"))
@@ -73,6 +74,8 @@ AppOptions::AppOptions(int argc, const char* argv[])
   , m_script(m_po.add("script").requiresValue("<filename>").description("Execute a specific script"))
   , m_scriptParam(m_po.add("script-param").requiresValue("name=value").description("Parameter for a script executed from the\nCLI that you can access with app.params"))
 #endif
+  , m_jobs(m_po.add("jobs").requiresValue("<filename>").description("Process each line of the given file as the\narguments of a different execution of the\nprogram (all lines in the same process)"))
+  , m_skipIfUnchanged(m_po.add("skip-if-unchanged").requiresValue("<filename>").description("Do nothing if the arguments and input files\nare the same as in the last execution that\nsaved the given stamp file"))
   , m_listLayers(m_po.add("list-layers").description("List layers of the next given sprite\nor include layers in JSON data"))
   , m_listLayerHierarchy(m_po.add("list-layer-hierarchy").description("List layers with groups of the next given sprite\nor include layers hierarchy in JSON data"))
   , m_listTags(m_po.add("list-tags").description("List tags of the next given sprite\nor include frame tags in JSON data"))
@@ -81,6 +84,7 @@ AppOptions::AppOptions(int argc, const char* argv[])
   , m_exportTileset(m_po.add("export-tileset").description("Export only tilesets from visible tilemap layers"))
   , m_verbose(m_po.add("verbose").mnemonic('v').description("Explain what is being done"))
   , m_debug(m_po.add("debug").description("Extreme verbose mode and\ncopy log to desktop"))
+  , m_startupTrace(m_po.add("startup-trace").requiresValue("<filename.json>").description("Save the time spent in each step of the\nprogram startup in a trace file that can\nbe opened with https://ui.perfetto.dev/"))
 #ifdef ENABLE_STEAM
   , m_noInApp(m_po.add("noinapp").description("Disable \"in game\" visibility on Steam\nDoesn't count playtime"))
 #endif
@@ -119,6 +123,11 @@ AppOptions::AppOptions(int argc, const char* argv[])
   }
 }
 
+std::string AppOptions::startupTrace() const
+{
+  return m_po.value_of(m_startupTrace);
+}
+
 bool AppOptions::hasExporterParams() const
 {
   return
@@ -40,6 +40,7 @@ public:
   bool showHelp() const { return m_showHelp; }
   bool showVersion() const { return m_showVersion; }
   VerboseLevel verboseLevel() const { return m_verboseLevel; }
+  std::string startupTrace() const;
 
   const ValueList& values() const {
     return m_po.values();
@@ -58,6 +59,7 @@ public:
   const Option& sheet() const { return m_sheet; }
   const Option& sheetType() const { return m_sheetType; }
   const Option& sheetPack() const { return m_sheetPack; }
+  const Option& sheetPackFast() const { return m_sheetPackFast; }
   const Option& sheetWidth() const { return m_sheetWidth; }
   const Option& sheetHeight() const { return m_sheetHeight; }
   const Option& sheetColumns() const { return m_sheetColumns; }
@@ -89,6 +91,8 @@ public:
   const Option& script() const { return m_script; }
   const Option& scriptParam() const { return m_scriptParam; }
 #endif
+  const Option& jobs() const { return m_jobs; }
+  const Option& skipIfUnchanged() const { return m_skipIfUnchanged; }
   const Option& listLayers() const { return m_listLayers; }
   const Option& listLayerHierarchy() const { return m_listLayerHierarchy; }
   const Option& listTags() const { return m_listTags; }
@@ -133,6 +137,7 @@ private:
   Option& m_sheet;
   Option& m_sheetType;
   Option& m_sheetPack;
+  Option& m_sheetPackFast;
   Option& m_sheetWidth;
   Option& m_sheetHeight;
   Option& m_sheetColumns;
@@ -164,6 +169,8 @@ private:
   Option& m_script;
   Option& m_scriptParam;
 #endif
+  Option& m_jobs;
+  Option& m_skipIfUnchanged;
   Option& m_listLayers;
   Option& m_listLayerHierarchy;
   Option& m_listTags;
@@ -173,6 +180,7 @@ private:
 
   Option& m_verbose;
   Option& m_debug;
+  Option& m_startupTrace;
 #ifdef ENABLE_STEAM
   Option& m_noInApp;
 #endif
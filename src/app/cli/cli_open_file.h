@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2016-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -44,6 +44,7 @@ namespace app {
     bool trim = false;
     bool trimByGrid = false;
     bool oneFrame = false;
+    bool metadataOnly = false;  // Load without pixels (only to list metadata)
     bool exportTileset = false;
     bool playSubtags = false;
     gfx::Rect crop;
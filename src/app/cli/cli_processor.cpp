@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -17,6 +17,7 @@
 #include "app/commands/params.h"
 #include "app/console.h"
 #include "app/doc.h"
+#include "app/doc_access.h"
 #include "app/doc_exporter.h"
 #include "app/doc_undo.h"
 #include "app/file/file.h"
@@ -24,7 +25,10 @@
 #include "app/restore_visible_layers.h"
 #include "app/ui_context.h"
 #include "base/convert_to.h"
+#include "base/file_content.h"
 #include "base/fs.h"
+#include "base/fstream_path.h"
+#include "base/log.h"
 #include "base/split_string.h"
 #include "doc/layer.h"
 #include "doc/selected_frames.h"
@@ -32,10 +36,15 @@
 #include "doc/slice.h"
 #include "doc/tag.h"
 #include "doc/tags.h"
+#include "fmt/format.h"
 #include "os/system.h"
 #include "render/dithering_algorithm.h"
+#include "ver/info.h"
+
+#include <city.h>
 
 #include <algorithm>
+#include <fstream>
 #include <queue>
 #include <vector>
 
@@ -140,6 +149,132 @@ std::string convert_filter_to_layer_path_if_possible(
     return filter;
 }
 
+// Splits a line of the --jobs file in arguments separated by spaces
+// (double quotes can be used for arguments with spaces).
+std::vector<std::string> split_job_arguments(const std::string& line)
+{
+  std::vector<std::string> args;
+  std::string arg;
+  bool inArg = false;
+  bool quoted = false;
+  for (const char chr : line) {
+    if (chr == '"') {
+      quoted = !quoted;
+      inArg = true;
+    }
+    else if (!quoted && (chr == ' ' || chr == '\t' || chr == '\r')) {
+      if (inArg) {
+        args.push_back(arg);
+        arg.clear();
+        inArg = false;
+      }
+    }
+    else {
+      arg.push_back(chr);
+      inArg = true;
+    }
+  }
+  if (inArg)
+    args.push_back(arg);
+  return args;
+}
+
+void hash_string(uint64_t& hash, const std::string& str)
+{
+  hash = CityHash64WithSeed(str.c_str(), str.size(), hash);
+}
+
+void hash_file_content(uint64_t& hash, const std::string& filename)
+{
+  if (!base::is_file(filename))
+    return;
+
+  const base::buffer buf = base::read_file_content(filename);
+  if (!buf.empty())
+    hash = CityHash64WithSeed((const char*)&buf[0], buf.size(), hash);
+}
+
+void hash_cli_options(uint64_t& hash,
+                      const AppOptions& options,
+                      std::vector<std::string>& outputs);
+
+// Hashes the options (and input files) of each job in the given
+// --jobs file, as processJobs() will execute them.
+void hash_jobs_file(uint64_t& hash,
+                    const std::string& filename,
+                    const std::string& exeName,
+                    std::vector<std::string>& outputs)
+{
+  std::ifstream f(FSTREAM_PATH(filename));
+  if (!f)
+    return;
+
+  std::string line;
+  while (std::getline(f, line)) {
+    std::vector<std::string> args = split_job_arguments(line);
+    if (args.empty() || args[0][0] == '#')
+      continue;
+
+    std::vector<const char*> argv;
+    argv.push_back(exeName.c_str());
+    for (const auto& arg : args)
+      argv.push_back(arg.c_str());
+
+    const AppOptions options(int(argv.size()), &argv[0]);
+    hash_cli_options(hash, options, outputs);
+  }
+}
+
+void hash_cli_options(uint64_t& hash,
+                      const AppOptions& options,
+                      std::vector<std::string>& outputs)
+{
+  for (const auto& value : options.values()) {
+    const AppOptions::Option* opt = value.option();
+    if (opt == &options.skipIfUnchanged())
+      continue;
+
+    hash_string(hash, opt ? opt->name(): std::string());
+    hash_string(hash, value.value());
+
+    // Input files
+    if (!opt ||
+#ifdef ENABLE_SCRIPTING
+        opt == &options.script() ||
+#endif
+        opt == &options.palette() ||
+        opt == &options.ditheringMatrix()) {
+      hash_file_content(hash, value.value());
+    }
+    // The jobs file and the input files of its jobs
+    else if (opt == &options.jobs()) {
+      hash_file_content(hash, value.value());
+      hash_jobs_file(hash, value.value(), options.exeName(), outputs);
+    }
+    // Output files (we cannot know the output files when the
+    // filename has a format, e.g. {tag}.png)
+    else if ((opt == &options.saveAs() ||
+              opt == &options.sheet() ||
+              opt == &options.data()) &&
+             value.value().find('{') == std::string::npos) {
+      outputs.push_back(value.value());
+    }
+  }
+}
+
+// Calculates a hash of everything that can change the result of the
+// CLI execution: program version, arguments, and content of input
+// files (including the ones in --jobs files). Output files are
+// returned in "outputs" to check that they still exist.
+uint64_t calc_cli_hash(const AppOptions& options,
+                       std::vector<std::string>& outputs)
+{
+  uint64_t hash = 0;
+  hash_string(hash, get_app_version());
+  hash_cli_options(hash, options, outputs);
+  return hash;
+}
+
 } // anonymous namespace
 
 // static
@@ -192,466 +327,608 @@ int CliProcessor::process(Context* ctx)
   }
   // Process other options and file names
   else if (!m_options.values().empty()) {
+    const int code = processValues(ctx);
+    if (code != 0)
+      return code;
+  }
+
+  // Running mode
+  if (m_options.startUI()) {
+    m_delegate->uiMode();
+  }
+  else if (m_options.startShell()) {
+    m_delegate->shellMode();
+  }
+  else {
+    m_delegate->batchMode();
+  }
+  return 0;
+}
+
+int CliProcessor::processValues(Context* ctx)
+{
+  // --skip-if-unchanged <filename>
+  std::string stampFilename;
+  std::string stamp;
+  for (const auto& value : m_options.values()) {
+    if (value.option() == &m_options.skipIfUnchanged())
+      stampFilename = value.value();
+  }
+  if (!stampFilename.empty()) {
+    std::vector<std::string> outputs;
+    stamp = fmt::format("{:016x}\n", calc_cli_hash(m_options, outputs));
+
+    const bool outputsExist =
+      std::all_of(outputs.begin(), outputs.end(),
+                  [](const std::string& fn){ return base::is_file(fn); });
+    if (outputsExist &&
+        base::is_file(stampFilename)) {
+      const base::buffer buf = base::read_file_content(stampFilename);
+      if (std::string(buf.begin(), buf.end()) == stamp) {
+        LOG(INFO, "CLI: Skipping, nothing changed since \"%s\"\n",
+            stampFilename.c_str());
+        return 0;
+      }
+    }
+  }
+
 #ifdef ENABLE_SCRIPTING
-    Params scriptParams;
+  Params scriptParams;
 #endif
-    Console console;
-    CliOpenFile cof;
-    SpriteSheetType sheetType = SpriteSheetType::None;
-    Doc* lastDoc = nullptr;
-    render::DitheringAlgorithm ditheringAlgorithm = render::DitheringAlgorithm::None;
-    std::string ditheringMatrix;
-
+  Console console;
+  CliOpenFile cof;
+  SpriteSheetType sheetType = SpriteSheetType::None;
+  Doc* lastDoc = nullptr;
+  render::DitheringAlgorithm ditheringAlgorithm = render::DitheringAlgorithm::None;
+  std::string ditheringMatrix;
+
+  // Files given after the last option that can use the pixels of the
+  // opened documents (--save-as, --scale, --script, etc.) are used
+  // only to list their layers/tags/slices, so they can be loaded
+  // without reading their cels.
+  size_t metadataOnlyFrom = 0;
+  {
+    size_t i = 0;
     for (const auto& value : m_options.values()) {
       const AppOptions::Option* opt = value.option();
+      ++i;
+      if (opt &&
+          opt != &m_options.listLayers() &&
+          opt != &m_options.listLayerHierarchy() &&
+          opt != &m_options.listTags() &&
+          opt != &m_options.listSlices() &&
+          opt != &m_options.oneFrame() &&
+          opt != &m_options.allLayers()) {
+        metadataOnlyFrom = i;
+      }
+    }
+  }
 
-      // Special options/commands
-      if (opt) {
-        // --data <file.json>
-        if (opt == &m_options.data()) {
-          if (m_exporter)
-            m_exporter->setDataFilename(value.value());
-        }
-        // --format <format>
-        else if (opt == &m_options.format()) {
-          if (m_exporter) {
-            SpriteSheetDataFormat format = SpriteSheetDataFormat::Default;
-
-            if (value.value() == "json-hash")
-              format = SpriteSheetDataFormat::JsonHash;
-            else if (value.value() == "json-array")
-              format = SpriteSheetDataFormat::JsonArray;
-
-            m_exporter->setDataFormat(format);
-          }
-        }
-        // --sheet <file.png>
-        else if (opt == &m_options.sheet()) {
-          if (m_exporter)
-            m_exporter->setTextureFilename(value.value());
-        }
-        // --sheet-width <width>
-        else if (opt == &m_options.sheetWidth()) {
-          if (m_exporter)
-            m_exporter->setTextureWidth(strtol(value.value().c_str(), nullptr, 0));
-        }
-        // --sheet-height <height>
-        else if (opt == &m_options.sheetHeight()) {
-          if (m_exporter)
-            m_exporter->setTextureHeight(strtol(value.value().c_str(), nullptr, 0));
-        }
-        // --sheet-columns <columns>
-        else if (opt == &m_options.sheetColumns()) {
-          if (m_exporter)
-            m_exporter->setTextureColumns(strtol(value.value().c_str(), nullptr, 0));
-        }
-        // --sheet-rows <rows>
-        else if (opt == &m_options.sheetRows()) {
-          if (m_exporter)
-            m_exporter->setTextureRows(strtol(value.value().c_str(), nullptr, 0));
-        }
-        // --sheet-type <sheet-type>
-        else if (opt == &m_options.sheetType()) {
-          if (value.value() == "horizontal")
-            sheetType = SpriteSheetType::Horizontal;
-          else if (value.value() == "vertical")
-            sheetType = SpriteSheetType::Vertical;
-          else if (value.value() == "rows")
-            sheetType = SpriteSheetType::Rows;
-          else if (value.value() == "columns")
-            sheetType = SpriteSheetType::Columns;
-          else if (value.value() == "packed")
-            sheetType = SpriteSheetType::Packed;
+  size_t valueIndex = 0;
+  for (const auto& value : m_options.values()) {
+    const AppOptions::Option* opt = value.option();
+    ++valueIndex;
+
+    // Special options/commands
+    if (opt) {
+      // --data <file.json>
+      if (opt == &m_options.data()) {
+        if (m_exporter)
+          m_exporter->setDataFilename(value.value());
+      }
+      // --format <format>
+      else if (opt == &m_options.format()) {
+        if (m_exporter) {
+          SpriteSheetDataFormat format = SpriteSheetDataFormat::Default;
+
+          if (value.value() == "json-hash")
+            format = SpriteSheetDataFormat::JsonHash;
+          else if (value.value() == "json-array")
+            format = SpriteSheetDataFormat::JsonArray;
+          else if (value.value() == "binary")
+            format = SpriteSheetDataFormat::Binary;
+
+          m_exporter->setDataFormat(format);
         }
-        // --sheet-pack
-        else if (opt == &m_options.sheetPack()) {
+      }
+      // --sheet <file.png>
+      else if (opt == &m_options.sheet()) {
+        if (m_exporter)
+          m_exporter->setTextureFilename(value.value());
+      }
+      // --sheet-width <width>
+      else if (opt == &m_options.sheetWidth()) {
+        if (m_exporter)
+          m_exporter->setTextureWidth(strtol(value.value().c_str(), nullptr, 0));
+      }
+      // --sheet-height <height>
+      else if (opt == &m_options.sheetHeight()) {
+        if (m_exporter)
+          m_exporter->setTextureHeight(strtol(value.value().c_str(), nullptr, 0));
+      }
+      // --sheet-columns <columns>
+      else if (opt == &m_options.sheetColumns()) {
+        if (m_exporter)
+          m_exporter->setTextureColumns(strtol(value.value().c_str(), nullptr, 0));
+      }
+      // --sheet-rows <rows>
+      else if (opt == &m_options.sheetRows()) {
+        if (m_exporter)
+          m_exporter->setTextureRows(strtol(value.value().c_str(), nullptr, 0));
+      }
+      // --sheet-type <sheet-type>
+      else if (opt == &m_options.sheetType()) {
+        if (value.value() == "horizontal")
+          sheetType = SpriteSheetType::Horizontal;
+        else if (value.value() == "vertical")
+          sheetType = SpriteSheetType::Vertical;
+        else if (value.value() == "rows")
+          sheetType = SpriteSheetType::Rows;
+        else if (value.value() == "columns")
+          sheetType = SpriteSheetType::Columns;
+        else if (value.value() == "packed")
           sheetType = SpriteSheetType::Packed;
+      }
+      // --sheet-pack
+      else if (opt == &m_options.sheetPack()) {
+        sheetType = SpriteSheetType::Packed;
+      }
+      // --sheet-pack-fast
+      else if (opt == &m_options.sheetPackFast()) {
+        sheetType = SpriteSheetType::Packed;
+        if (m_exporter)
+          m_exporter->setFastPacking(true);
+      }
+      // --split-layers
+      else if (opt == &m_options.splitLayers()) {
+        cof.splitLayers = true;
+        if (m_exporter)
+          m_exporter->setSplitLayers(true);
+      }
+      // --split-tags
+      else if (opt == &m_options.splitTags()) {
+        cof.splitTags = true;
+        if (m_exporter)
+          m_exporter->setSplitTags(true);
+      }
+      // --split-slice
+      else if (opt == &m_options.splitSlices()) {
+        cof.splitSlices = true;
+      }
+      // --split-grid
+      else if (opt == &m_options.splitGrid()) {
+        cof.splitGrid = true;
+      }
+      // --layer <layer-name>
+      else if (opt == &m_options.layer()) {
+        cof.includeLayers.push_back(value.value());
+      }
+      // --ignore-layer <layer-name>
+      else if (opt == &m_options.ignoreLayer()) {
+        cof.excludeLayers.push_back(value.value());
+      }
+      // --all-layers
+      else if (opt == &m_options.allLayers()) {
+        cof.allLayers = true;
+      }
+      // --tag <tag-name>
+      else if (opt == &m_options.tag()) {
+        cof.tag = value.value();
+      }
+      // --play-subtags
+      else if (opt == &m_options.playSubtags()) {
+        cof.playSubtags = true;
+      }
+      // --frame-range from,to
+      else if (opt == &m_options.frameRange()) {
+        std::vector<std::string> splitRange;
+        base::split_string(value.value(), splitRange, ",");
+        if (splitRange.size() < 2)
+          throw std::runtime_error("--frame-range needs two parameters separated by comma (,)\n"
+                                   "Usage: --frame-range from,to\n"
+                                   "E.g. --frame-range 0,99");
+
+        cof.fromFrame = base::convert_to<frame_t>(splitRange[0]);
+        cof.toFrame   = base::convert_to<frame_t>(splitRange[1]);
+      }
+      // --ignore-empty
+      else if (opt == &m_options.ignoreEmpty()) {
+        cof.ignoreEmpty = true;
+        if (m_exporter)
+          m_exporter->setIgnoreEmptyCels(true);
+      }
+      // --merge-duplicates
+      else if (opt == &m_options.mergeDuplicates()) {
+        if (m_exporter)
+          m_exporter->setMergeDuplicates(true);
+      }
+      // --border-padding
+      else if (opt == &m_options.borderPadding()) {
+        if (m_exporter)
+          m_exporter->setBorderPadding(strtol(value.value().c_str(), NULL, 0));
+      }
+      // --shape-padding
+      else if (opt == &m_options.shapePadding()) {
+        if (m_exporter)
+          m_exporter->setShapePadding(strtol(value.value().c_str(), NULL, 0));
+      }
+      // --inner-padding
+      else if (opt == &m_options.innerPadding()) {
+        if (m_exporter)
+          m_exporter->setInnerPadding(strtol(value.value().c_str(), NULL, 0));
+      }
+      // --trim
+      else if (opt == &m_options.trim()) {
+        cof.trim = true;
+        if (m_exporter)
+          m_exporter->setTrimCels(true);
+      }
+      // --trim-sprite
+      else if (opt == &m_options.trimSprite()) {
+        cof.trim = true;
+        if (m_exporter)
+          m_exporter->setTrimSprite(true);
+      }
+      // --trim-by-grid
+      else if (opt == &m_options.trimByGrid()) {
+        cof.trim = cof.trimByGrid = true;
+        if (m_exporter) {
+          m_exporter->setTrimCels(true);
+          m_exporter->setTrimByGrid(true);
         }
-        // --split-layers
-        else if (opt == &m_options.splitLayers()) {
-          cof.splitLayers = true;
-          if (m_exporter)
-            m_exporter->setSplitLayers(true);
-        }
-        // --split-tags
-        else if (opt == &m_options.splitTags()) {
-          cof.splitTags = true;
-          if (m_exporter)
-            m_exporter->setSplitTags(true);
-        }
-        // --split-slice
-        else if (opt == &m_options.splitSlices()) {
-          cof.splitSlices = true;
-        }
-        // --split-grid
-        else if (opt == &m_options.splitGrid()) {
-          cof.splitGrid = true;
-        }
-        // --layer <layer-name>
-        else if (opt == &m_options.layer()) {
-          cof.includeLayers.push_back(value.value());
-        }
-        // --ignore-layer <layer-name>
-        else if (opt == &m_options.ignoreLayer()) {
-          cof.excludeLayers.push_back(value.value());
-        }
-        // --all-layers
-        else if (opt == &m_options.allLayers()) {
-          cof.allLayers = true;
-        }
-        // --tag <tag-name>
-        else if (opt == &m_options.tag()) {
-          cof.tag = value.value();
-        }
-        // --play-subtags
-        else if (opt == &m_options.playSubtags()) {
-          cof.playSubtags = true;
-        }
-        // --frame-range from,to
-        else if (opt == &m_options.frameRange()) {
-          std::vector<std::string> splitRange;
-          base::split_string(value.value(), splitRange, ",");
-          if (splitRange.size() < 2)
-            throw std::runtime_error("--frame-range needs two parameters separated by comma (,)\n"
-                                     "Usage: --frame-range from,to\n"
-                                     "E.g. --frame-range 0,99");
-
-          cof.fromFrame = base::convert_to<frame_t>(splitRange[0]);
-          cof.toFrame   = base::convert_to<frame_t>(splitRange[1]);
-        }
-        // --ignore-empty
-        else if (opt == &m_options.ignoreEmpty()) {
-          cof.ignoreEmpty = true;
-          if (m_exporter)
-            m_exporter->setIgnoreEmptyCels(true);
-        }
-        // --merge-duplicates
-        else if (opt == &m_options.mergeDuplicates()) {
-          if (m_exporter)
-            m_exporter->setMergeDuplicates(true);
-        }
-        // --border-padding
-        else if (opt == &m_options.borderPadding()) {
-          if (m_exporter)
-            m_exporter->setBorderPadding(strtol(value.value().c_str(), NULL, 0));
-        }
-        // --shape-padding
-        else if (opt == &m_options.shapePadding()) {
-          if (m_exporter)
-            m_exporter->setShapePadding(strtol(value.value().c_str(), NULL, 0));
-        }
-        // --inner-padding
-        else if (opt == &m_options.innerPadding()) {
-          if (m_exporter)
-            m_exporter->setInnerPadding(strtol(value.value().c_str(), NULL, 0));
-        }
-        // --trim
-        else if (opt == &m_options.trim()) {
-          cof.trim = true;
-          if (m_exporter)
-            m_exporter->setTrimCels(true);
-        }
-        // --trim-sprite
-        else if (opt == &m_options.trimSprite()) {
-          cof.trim = true;
-          if (m_exporter)
-            m_exporter->setTrimSprite(true);
-        }
-        // --trim-by-grid
-        else if (opt == &m_options.trimByGrid()) {
-          cof.trim = cof.trimByGrid = true;
-          if (m_exporter) {
-            m_exporter->setTrimCels(true);
-            m_exporter->setTrimByGrid(true);
-          }
-        }
-        // --extrude
-        else if (opt == &m_options.extrude()) {
-          if (m_exporter)
-            m_exporter->setExtrude(true);
-        }
-        // --crop x,y,width,height
-        else if (opt == &m_options.crop()) {
-          std::vector<std::string> parts;
-          base::split_string(value.value(), parts, ",");
-          if (parts.size() < 4)
-            throw std::runtime_error("--crop needs four parameters separated by comma (,)\n"
-                                     "Usage: --crop x,y,width,height\n"
-                                     "E.g. --crop 0,0,32,32");
-
-          cof.crop.x = base::convert_to<int>(parts[0]);
-          cof.crop.y = base::convert_to<int>(parts[1]);
-          cof.crop.w = base::convert_to<int>(parts[2]);
-          cof.crop.h = base::convert_to<int>(parts[3]);
-        }
-        // --slice <slice>
-        else if (opt == &m_options.slice()) {
-          cof.slice = value.value();
-        }
-        // --filename-format
-        else if (opt == &m_options.filenameFormat()) {
-          cof.filenameFormat = value.value();
-          if (m_exporter)
-            m_exporter->setFilenameFormat(cof.filenameFormat);
-        }
-        // --tagname-format
-        else if (opt == &m_options.tagnameFormat()) {
-          cof.tagnameFormat = value.value();
-          if (m_exporter)
-            m_exporter->setTagnameFormat(cof.tagnameFormat);
-        }
-        // --save-as <filename>
-        else if (opt == &m_options.saveAs()) {
-          if (lastDoc) {
-            std::string fn = value.value();
-
-            // Automatic --filename-format
-            // in case the output filename already contains template elements.
-            if (is_template_in_filename(fn)) {
-              cof.filenameFormat = fn;
-              // Automatic --split-layer, --split-tags, --split-slices
-              // in case the output filename already contains {layer},
-              // {tag}, or {slice} template elements.
-              bool hasLayerTemplate = (is_layer_in_filename_format(fn) ||
-                                      is_group_in_filename_format(fn));
-              bool hasTagTemplate = is_tag_in_filename_format(fn);
-              bool hasSliceTemplate = is_slice_in_filename_format(fn);
-
-              if (hasLayerTemplate || hasTagTemplate || hasSliceTemplate) {
-                cof.splitLayers = (cof.splitLayers || hasLayerTemplate);
-                cof.splitTags = (cof.splitTags || hasTagTemplate);
-                cof.splitSlices = (cof.splitSlices || hasSliceTemplate);
-              }
-
-              // Save all documents
-              for (auto doc : ctx->documents()) {
-                ctx->setActiveDocument(doc);
-                cof.filename = doc->filename();
-                cof.document = doc;
-                saveFile(ctx, cof);
-              }
-              ctx->setActiveDocument(lastDoc);
+      }
+      // --extrude
+      else if (opt == &m_options.extrude()) {
+        if (m_exporter)
+          m_exporter->setExtrude(true);
+      }
+      // --crop x,y,width,height
+      else if (opt == &m_options.crop()) {
+        std::vector<std::string> parts;
+        base::split_string(value.value(), parts, ",");
+        if (parts.size() < 4)
+          throw std::runtime_error("--crop needs four parameters separated by comma (,)\n"
+                                   "Usage: --crop x,y,width,height\n"
+                                   "E.g. --crop 0,0,32,32");
+
+        cof.crop.x = base::convert_to<int>(parts[0]);
+        cof.crop.y = base::convert_to<int>(parts[1]);
+        cof.crop.w = base::convert_to<int>(parts[2]);
+        cof.crop.h = base::convert_to<int>(parts[3]);
+      }
+      // --slice <slice>
+      else if (opt == &m_options.slice()) {
+        cof.slice = value.value();
+      }
+      // --filename-format
+      else if (opt == &m_options.filenameFormat()) {
+        cof.filenameFormat = value.value();
+        if (m_exporter)
+          m_exporter->setFilenameFormat(cof.filenameFormat);
+      }
+      // --tagname-format
+      else if (opt == &m_options.tagnameFormat()) {
+        cof.tagnameFormat = value.value();
+        if (m_exporter)
+          m_exporter->setTagnameFormat(cof.tagnameFormat);
+      }
+      // --save-as <filename>
+      else if (opt == &m_options.saveAs()) {
+        if (lastDoc) {
+          std::string fn = value.value();
+
+          // Automatic --filename-format
+          // in case the output filename already contains template elements.
+          if (is_template_in_filename(fn)) {
+            cof.filenameFormat = fn;
+            // Automatic --split-layer, --split-tags, --split-slices
+            // in case the output filename already contains {layer},
+            // {tag}, or {slice} template elements.
+            bool hasLayerTemplate = (is_layer_in_filename_format(fn) ||
+                                    is_group_in_filename_format(fn));
+            bool hasTagTemplate = is_tag_in_filename_format(fn);
+            bool hasSliceTemplate = is_slice_in_filename_format(fn);
+
+            if (hasLayerTemplate || hasTagTemplate || hasSliceTemplate) {
+              cof.splitLayers = (cof.splitLayers || hasLayerTemplate);
+              cof.splitTags = (cof.splitTags || hasTagTemplate);
+              cof.splitSlices = (cof.splitSlices || hasSliceTemplate);
             }
-            else {
-              cof.filename = fn;
-              cof.document = lastDoc;
+
+            // Save all documents
+            for (auto doc : ctx->documents()) {
+              ctx->setActiveDocument(doc);
+              cof.filename = doc->filename();
+              cof.document = doc;
               saveFile(ctx, cof);
             }
-          }
-          else
-            console.printf("A document is needed before --save-as argument\n");
-        }
-        // --palette <filename>
-        else if (opt == &m_options.palette()) {
-          if (lastDoc) {
-            ASSERT(cof.document == lastDoc);
-
-            std::string filename = value.value();
-            m_delegate->loadPalette(ctx, filename);
+            ctx->setActiveDocument(lastDoc);
           }
           else {
-            console.printf("You need to load a document to change its palette with --palette\n");
+            cof.filename = fn;
+            cof.document = lastDoc;
+            saveFile(ctx, cof);
           }
         }
-        // --scale <factor>
-        else if (opt == &m_options.scale()) {
-          Params params;
-          params.set("scale", value.value().c_str());
-
-          // Scale all sprites
-          for (auto doc : ctx->documents()) {
-            ctx->setActiveDocument(doc);
-            ctx->executeCommand(Commands::instance()->byId(CommandId::SpriteSize()),
-                                params);
-          }
+        else
+          console.printf("A document is needed before --save-as argument\n");
+      }
+      // --palette <filename>
+      else if (opt == &m_options.palette()) {
+        if (lastDoc) {
+          ASSERT(cof.document == lastDoc);
+
+          std::string filename = value.value();
+          m_delegate->loadPalette(ctx, filename);
         }
-        // --dithering-algorithm <algorithm>
-        else if (opt == &m_options.ditheringAlgorithm()) {
-          if (value.value() == "none")
-            ditheringAlgorithm = render::DitheringAlgorithm::None;
-          else if (value.value() == "ordered")
-            ditheringAlgorithm = render::DitheringAlgorithm::Ordered;
-          else if (value.value() == "old")
-            ditheringAlgorithm = render::DitheringAlgorithm::Old;
-          else if (value.value() == "error-diffusion")
-            ditheringAlgorithm = render::DitheringAlgorithm::ErrorDiffusion;
-          else
-            throw std::runtime_error("--dithering-algorithm needs a valid algorithm name\n"
-                                     "Usage: --dithering-algorithm <algorithm>\n"
-                                     "Where <algorithm> can be none, ordered, old, or error-diffusion");
+        else {
+          console.printf("You need to load a document to change its palette with --palette\n");
         }
-        // --dithering-matrix <id>
-        else if (opt == &m_options.ditheringMatrix()) {
-          ditheringMatrix = value.value();
+      }
+      // --scale <factor>
+      else if (opt == &m_options.scale()) {
+        Params params;
+        params.set("scale", value.value().c_str());
+
+        // Scale all sprites
+        for (auto doc : ctx->documents()) {
+          ctx->setActiveDocument(doc);
+          ctx->executeCommand(Commands::instance()->byId(CommandId::SpriteSize()),
+                              params);
         }
-        // --color-mode <mode>
-        else if (opt == &m_options.colorMode()) {
-          Command* command = Commands::instance()->byId(CommandId::ChangePixelFormat());
-          Params params;
-          if (value.value() == "rgb") {
-            params.set("format", "rgb");
-          }
-          else if (value.value() == "grayscale") {
-            params.set("format", "grayscale");
+      }
+      // --dithering-algorithm <algorithm>
+      else if (opt == &m_options.ditheringAlgorithm()) {
+        if (value.value() == "none")
+          ditheringAlgorithm = render::DitheringAlgorithm::None;
+        else if (value.value() == "ordered")
+          ditheringAlgorithm = render::DitheringAlgorithm::Ordered;
+        else if (value.value() == "old")
+          ditheringAlgorithm = render::DitheringAlgorithm::Old;
+        else if (value.value() == "error-diffusion")
+          ditheringAlgorithm = render::DitheringAlgorithm::ErrorDiffusion;
+        else
+          throw std::runtime_error("--dithering-algorithm needs a valid algorithm name\n"
+                                   "Usage: --dithering-algorithm <algorithm>\n"
+                                   "Where <algorithm> can be none, ordered, old, or error-diffusion");
+      }
+      // --dithering-matrix <id>
+      else if (opt == &m_options.ditheringMatrix()) {
+        ditheringMatrix = value.value();
+      }
+      // --color-mode <mode>
+      else if (opt == &m_options.colorMode()) {
+        Command* command = Commands::instance()->byId(CommandId::ChangePixelFormat());
+        Params params;
+        if (value.value() == "rgb") {
+          params.set("format", "rgb");
+        }
+        else if (value.value() == "grayscale") {
+          params.set("format", "grayscale");
+        }
+        else if (value.value() == "indexed") {
+          params.set("format", "indexed");
+          switch (ditheringAlgorithm) {
+            case render::DitheringAlgorithm::None:
+              params.set("dithering", "none");
+              break;
+            case render::DitheringAlgorithm::Ordered:
+              params.set("dithering", "ordered");
+              break;
+            case render::DitheringAlgorithm::Old:
+              params.set("dithering", "old");
+              break;
+            case render::DitheringAlgorithm::ErrorDiffusion:
+              params.set("dithering", "error-diffusion");
+              break;
           }
-          else if (value.value() == "indexed") {
-            params.set("format", "indexed");
-            switch (ditheringAlgorithm) {
-              case render::DitheringAlgorithm::None:
-                params.set("dithering", "none");
-                break;
-              case render::DitheringAlgorithm::Ordered:
-                params.set("dithering", "ordered");
-                break;
-              case render::DitheringAlgorithm::Old:
-                params.set("dithering", "old");
-                break;
-              case render::DitheringAlgorithm::ErrorDiffusion:
-                params.set("dithering", "error-diffusion");
-                break;
-            }
 
-            if (ditheringAlgorithm != render::DitheringAlgorithm::None &&
-                !ditheringMatrix.empty()) {
-              params.set("dithering-matrix", ditheringMatrix.c_str());
-            }
-          }
-          else {
-            throw std::runtime_error("--color-mode needs a valid color mode for conversion\n"
-                                     "Usage: --color-mode <mode>\n"
-                                     "Where <mode> can be rgb, grayscale, or indexed");
+          if (ditheringAlgorithm != render::DitheringAlgorithm::None &&
+              !ditheringMatrix.empty()) {
+            params.set("dithering-matrix", ditheringMatrix.c_str());
           }
+        }
+        else {
+          throw std::runtime_error("--color-mode needs a valid color mode for conversion\n"
+                                   "Usage: --color-mode <mode>\n"
+                                   "Where <mode> can be rgb, grayscale, or indexed");
+        }
 
-          for (auto doc : ctx->documents()) {
-            ctx->setActiveDocument(doc);
-            ctx->executeCommand(command, params);
-          }
+        for (auto doc : ctx->documents()) {
+          ctx->setActiveDocument(doc);
+          ctx->executeCommand(command, params);
         }
-        // --shrink-to <width,height>
-        else if (opt == &m_options.shrinkTo()) {
-          std::vector<std::string> dimensions;
-          base::split_string(value.value(), dimensions, ",");
-          if (dimensions.size() < 2)
-            throw std::runtime_error("--shrink-to needs two parameters separated by comma (,)\n"
-                                     "Usage: --shrink-to width,height\n"
-                                     "E.g. --shrink-to 128,64");
-
-          double maxWidth = base::convert_to<double>(dimensions[0]);
-          double maxHeight = base::convert_to<double>(dimensions[1]);
-          double scaleWidth, scaleHeight, scale;
-
-          // Shrink all sprites if needed
-          for (auto doc : ctx->documents()) {
-            ctx->setActiveDocument(doc);
-            scaleWidth = (doc->width() > maxWidth ? maxWidth / doc->width() : 1.0);
-            scaleHeight = (doc->height() > maxHeight ? maxHeight / doc->height() : 1.0);
-            if (scaleWidth < 1.0 || scaleHeight < 1.0) {
-              scale = std::min(scaleWidth, scaleHeight);
-              Params params;
-              params.set("scale", base::convert_to<std::string>(scale).c_str());
-              ctx->executeCommand(Commands::instance()->byId(CommandId::SpriteSize()),
-                                  params);
-            }
+      }
+      // --shrink-to <width,height>
+      else if (opt == &m_options.shrinkTo()) {
+        std::vector<std::string> dimensions;
+        base::split_string(value.value(), dimensions, ",");
+        if (dimensions.size() < 2)
+          throw std::runtime_error("--shrink-to needs two parameters separated by comma (,)\n"
+                                   "Usage: --shrink-to width,height\n"
+                                   "E.g. --shrink-to 128,64");
+
+        double maxWidth = base::convert_to<double>(dimensions[0]);
+        double maxHeight = base::convert_to<double>(dimensions[1]);
+        double scaleWidth, scaleHeight, scale;
+
+        // Shrink all sprites if needed
+        for (auto doc : ctx->documents()) {
+          ctx->setActiveDocument(doc);
+          scaleWidth = (doc->width() > maxWidth ? maxWidth / doc->width() : 1.0);
+          scaleHeight = (doc->height() > maxHeight ? maxHeight / doc->height() : 1.0);
+          if (scaleWidth < 1.0 || scaleHeight < 1.0) {
+            scale = std::min(scaleWidth, scaleHeight);
+            Params params;
+            params.set("scale", base::convert_to<std::string>(scale).c_str());
+            ctx->executeCommand(Commands::instance()->byId(CommandId::SpriteSize()),
+                                params);
           }
         }
+      }
 #ifdef ENABLE_SCRIPTING
-        // --script <filename>
-        else if (opt == &m_options.script()) {
-          std::string filename = value.value();
-          int code;
-          try {
-            code = m_delegate->execScript(filename, scriptParams);
-          }
-          catch (const std::exception& ex) {
-            Console::showException(ex);
-            return -1;
-          }
-          if (code != 0)
-            return code;
+      // --script <filename>
+      else if (opt == &m_options.script()) {
+        std::string filename = value.value();
+        int code;
+        try {
+          code = m_delegate->execScript(filename, scriptParams);
         }
-        // --script-param <name=value>
-        else if (opt == &m_options.scriptParam()) {
-          const std::string& v = value.value();
-          auto i = v.find('=');
-          if (i != std::string::npos)
-            scriptParams.set(v.substr(0, i).c_str(),
-                             v.substr(i+1).c_str());
-          else
-            scriptParams.set(v.c_str(), "1");
+        catch (const std::exception& ex) {
+          Console::showException(ex);
+          return -1;
         }
+        if (code != 0)
+          return code;
+      }
+      // --script-param <name=value>
+      else if (opt == &m_options.scriptParam()) {
+        const std::string& v = value.value();
+        auto i = v.find('=');
+        if (i != std::string::npos)
+          scriptParams.set(v.substr(0, i).c_str(),
+                           v.substr(i+1).c_str());
+        else
+          scriptParams.set(v.c_str(), "1");
+      }
 #endif
-        // --list-layers
-        else if (opt == &m_options.listLayers()) {
-          if (m_exporter)
-            m_exporter->setListLayers(true);
-          else
-            cof.listLayers = true;
-        }
-        // --list-layer-hierarchy
-        else if (opt == &m_options.listLayerHierarchy()) {
-          if (m_exporter)
-            m_exporter->setListLayerHierarchy(true);
-          else
-            cof.listLayerHierarchy = true;
-        }
-        // --list-tags
-        else if (opt == &m_options.listTags()) {
-          if (m_exporter)
-            m_exporter->setListTags(true);
-          else
-            cof.listTags = true;
-        }
-        // --list-slices
-        else if (opt == &m_options.listSlices()) {
-          if (m_exporter)
-            m_exporter->setListSlices(true);
-          else
-            cof.listSlices = true;
-        }
-        // --oneframe
-        else if (opt == &m_options.oneFrame()) {
-          cof.oneFrame = true;
-        }
-        // --export-tileset
-        else if (opt == &m_options.exportTileset()) {
-          cof.exportTileset = true;
-        }
+      // --jobs <filename>
+      else if (opt == &m_options.jobs()) {
+        const int code = processJobs(ctx, value.value());
+        if (code != 0)
+          return code;
       }
-      // File names aren't associated to any option
-      else {
-        cof.document = nullptr;
-        cof.filename = base::normalize_path(value.value());
-
-        if (// Check that the filename wasn't used loading a sequence
-            // of images as one sprite
-            m_usedFiles.find(cof.filename) == m_usedFiles.end() &&
-            // Open sprite
-            openFile(ctx, cof)) {
-          lastDoc = cof.document;
-        }
+      // --list-layers
+      else if (opt == &m_options.listLayers()) {
+        if (m_exporter)
+          m_exporter->setListLayers(true);
+        else
+          cof.listLayers = true;
+      }
+      // --list-layer-hierarchy
+      else if (opt == &m_options.listLayerHierarchy()) {
+        if (m_exporter)
+          m_exporter->setListLayerHierarchy(true);
+        else
+          cof.listLayerHierarchy = true;
+      }
+      // --list-tags
+      else if (opt == &m_options.listTags()) {
+        if (m_exporter)
+          m_exporter->setListTags(true);
+        else
+          cof.listTags = true;
+      }
+      // --list-slices
+      else if (opt == &m_options.listSlices()) {
+        if (m_exporter)
+          m_exporter->setListSlices(true);
+        else
+          cof.listSlices = true;
+      }
+      // --oneframe
+      else if (opt == &m_options.oneFrame()) {
+        cof.oneFrame = true;
+      }
+      // --export-tileset
+      else if (opt == &m_options.exportTileset()) {
+        cof.exportTileset = true;
+      }
+    }
+    // File names aren't associated to any option
+    else {
+      cof.document = nullptr;
+      cof.filename = base::normalize_path(value.value());
+      cof.metadataOnly =
+        (!m_exporter &&
+         !ctx->isUIAvailable() &&
+         valueIndex > metadataOnlyFrom &&
+         (cof.listLayers ||
+          cof.listLayerHierarchy ||
+          cof.listTags ||
+          cof.listSlices));
+
+      if (// Check that the filename wasn't used loading a sequence
+          // of images as one sprite
+          m_usedFiles.find(cof.filename) == m_usedFiles.end() &&
+          // Open sprite
+          openFile(ctx, cof)) {
+        lastDoc = cof.document;
       }
     }
+  }
 
-    if (m_exporter) {
-      // Rows sprite sheet as the default type
-      if (sheetType == SpriteSheetType::None)
-        sheetType = SpriteSheetType::Rows;
-      m_exporter->setSpriteSheetType(sheetType);
+  if (m_exporter) {
+    // Rows sprite sheet as the default type
+    if (sheetType == SpriteSheetType::None)
+      sheetType = SpriteSheetType::Rows;
+    m_exporter->setSpriteSheetType(sheetType);
 
-      m_delegate->exportFiles(ctx, *m_exporter.get());
-      m_exporter.reset(nullptr);
-    }
+    m_delegate->exportFiles(ctx, *m_exporter.get());
+    m_exporter.reset(nullptr);
   }
 
-  // Running mode
-  if (m_options.startUI()) {
-    m_delegate->uiMode();
+  // Save the stamp to skip the same execution next time
+  if (!stampFilename.empty() &&
+      !m_options.previewCLI()) {
+    base::write_file_content(stampFilename,
+                             (const uint8_t*)stamp.c_str(), stamp.size());
   }
-  else if (m_options.startShell()) {
-    m_delegate->shellMode();
+  return 0;
+}
+
+int CliProcessor::processJobs(Context* ctx, const std::string& filename)
+{
+  std::ifstream f(FSTREAM_PATH(filename));
+  if (!f) {
+    Console console;
+    console.printf("Error opening jobs file \"%s\"\n", filename.c_str());
+    return -1;
   }
-  else {
-    m_delegate->batchMode();
+
+  // Each line is a job with the arguments of one CLI execution
+  // (without the program name), e.g.
+  //
+  //   sprite.aseprite --sheet sheet.png --data sheet.json
+  //   "other sprite.aseprite" --save-as other.png
+  //
+  std::string line;
+  while (std::getline(f, line)) {
+    std::vector<std::string> args = split_job_arguments(line);
+    if (args.empty() || args[0][0] == '#')
+      continue;
+
+    std::vector<const char*> argv;
+    argv.push_back(m_options.exeName().c_str());
+    for (const auto& arg : args)
+      argv.push_back(arg.c_str());
+
+    // Documents opened by this job are closed at the end of it (to
+    // avoid accumulating all documents in memory)
+    std::set<Doc*> oldDocs(ctx->documents().begin(),
+                           ctx->documents().end());
+
+    const AppOptions options(int(argv.size()), &argv[0]);
+    CliProcessor job(m_delegate, options);
+    const int code = job.processValues(ctx);
+
+    std::vector<Doc*> newDocs;
+    for (Doc* doc : ctx->documents()) {
+      if (oldDocs.find(doc) == oldDocs.end())
+        newDocs.push_back(doc);
+    }
+    for (Doc* doc : newDocs) {
+      try {
+        DocDestroyer destroyer(ctx, doc, 500);
+        destroyer.destroyDocument();
+      }
+      catch (const LockedDocException& ex) {
+        Console::showException(ex);
+      }
+    }
+
+    if (code != 0)
+      return code;
   }
   return 0;
 }
@@ -664,7 +941,8 @@ bool CliProcessor::openFile(Context* ctx, CliOpenFile& cof)
 
   m_batch.open(ctx,
                cof.filename,
-               cof.oneFrame);
+               cof.oneFrame,
+               cof.metadataOnly);
 
   // Mark used file names as "already processed" so we don't try to
   // open then again
@@ -826,44 +1104,46 @@ void CliProcessor::saveFile(Context* ctx, const CliOpenFile& cof)
   bool groupInFormat = is_group_in_filename_format(fn);
 
   for (doc::Slice* slice : slices) {
-    for (doc::Tag* tag : tags) {
-      // For each layer, hide other ones and save the sprite.
-      for (doc::Layer* layer : layers) {
-        RestoreVisibleLayers layersVisibility;
+    // For each layer, hide other ones and save the sprite (one time
+    // for each tag). The trim only depends on the visible layers, so
+    // it's calculated once for all the tags of the layer.
+    for (doc::Layer* layer : layers) {
+      RestoreVisibleLayers layersVisibility;
 
-        if (cof.splitLayers) {
-          ASSERT(layer);
+      if (cof.splitLayers) {
+        ASSERT(layer);
 
-          // If the user doesn't want all layers and this one is hidden.
-          if (!layer->isVisible())
-            continue;     // Just ignore this layer.
+        // If the user doesn't want all layers and this one is hidden.
+        if (!layer->isVisible())
+          continue;     // Just ignore this layer.
 
-          // Make this layer ("show") the only one visible.
-          layersVisibility.showLayer(layer);
-        }
-        else if (!filteredLayers.empty())
-          layersVisibility.showSelectedLayers(doc->sprite(), filteredLayers);
+        // Make this layer ("show") the only one visible.
+        layersVisibility.showLayer(layer);
+      }
+      else if (!filteredLayers.empty())
+        layersVisibility.showSelectedLayers(doc->sprite(), filteredLayers);
 
-        if (layer) {
-          if ((layerInFormat && layer->isGroup()) ||
-              (!layerInFormat && groupInFormat && !layer->isGroup())) {
-            continue;
-          }
+      if (layer) {
+        if ((layerInFormat && layer->isGroup()) ||
+            (!layerInFormat && groupInFormat && !layer->isGroup())) {
+          continue;
         }
+      }
 
-        // TODO --trim --save-as --split-layers doesn't make too much
-        // sense as we lost the trim rectangle information (e.g. we
-        // don't have sheet .json) Also, we should trim each frame
-        // individually (a process that can be done only in
-        // FileOp::operate()).
-        if (cof.trim) {
-          Params params;
-          if (cof.trimByGrid) {
-            params.set("byGrid", "true");
-          }
-          ctx->executeCommand(trimCommand, params);
+      // TODO --trim --save-as --split-layers doesn't make too much
+      // sense as we lost the trim rectangle information (e.g. we
+      // don't have sheet .json) Also, we should trim each frame
+      // individually (a process that can be done only in
+      // FileOp::operate()).
+      if (cof.trim) {
+        Params params;
+        if (cof.trimByGrid) {
+          params.set("byGrid", "true");
         }
+        ctx->executeCommand(trimCommand, params);
+      }
 
+      for (doc::Tag* tag : tags) {
         CliOpenFile itemCof = cof;
         FilenameInfo fnInfo;
         fnInfo.filename(fn);
@@ -892,11 +1172,11 @@ void CliProcessor::saveFile(Context* ctx, const CliOpenFile& cof)
 
         // Call delegate
         m_delegate->saveFile(ctx, itemCof);
+      }
 
-        if (cof.trim) {
-          ctx->executeCommand(undoCommand);
-          clearUndo = true;
-        }
+      if (cof.trim) {
+        ctx->executeCommand(undoCommand);
+        clearUndo = true;
       }
     }
   }
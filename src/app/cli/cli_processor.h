@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -44,6 +44,8 @@ namespace app {
                              doc::SelectedLayers& filteredLayers);
 
   private:
+    int processValues(Context* ctx);
+    int processJobs(Context* ctx, const std::string& filename);
     bool openFile(Context* ctx, CliOpenFile& cof);
     void saveFile(Context* ctx, const CliOpenFile& cof);
 
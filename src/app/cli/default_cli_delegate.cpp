@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -20,7 +20,9 @@
 #include "app/doc_exporter.h"
 #include "app/file/palette_file.h"
 #include "app/ui_context.h"
+#include "app/util/memory_usage.h"
 #include "base/convert_to.h"
+#include "base/log.h"
 #include "doc/layer.h"
 #include "doc/palette.h"
 #include "doc/slice.h"
@@ -62,6 +64,12 @@ void DefaultCliDelegate::afterOpenFile(const CliOpenFile& cof)
   if (!cof.document)            // Do nothing
     return;
 
+  // With --debug we report the memory used by each loaded document
+  if (base::get_log_level() >= VERBOSE) {
+    LOG(VERBOSE, "CLI: %s",
+        get_doc_memory_report(cof.document).c_str());
+  }
+
   if (cof.listLayers) {
     for (doc::Layer* layer : cof.document->sprite()->allVisibleLayers())
       std::cout << layer->name() << "\n";
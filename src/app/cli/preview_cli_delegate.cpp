@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -79,6 +79,9 @@ void PreviewCliDelegate::afterOpenFile(const CliOpenFile& cof)
   if (cof.oneFrame)
     std::cout << "  - One frame\n";
 
+  if (cof.metadataOnly)
+    std::cout << "  - Metadata only (without pixels)\n";
+
   if (cof.allLayers)
     std::cout << "  - Make all layers visible\n";
 
@@ -206,6 +209,7 @@ void PreviewCliDelegate::exportFiles(Context* ctx, DocExporter& exporter)
     switch (exporter.dataFormat()) {
       case SpriteSheetDataFormat::JsonHash: format = "JSON Hash"; break;
       case SpriteSheetDataFormat::JsonArray: format = "JSON Array"; break;
+      case SpriteSheetDataFormat::Binary: format = "Binary"; break;
     }
     std::cout << "  - Save data file: '" << exporter.dataFilename() << "'\n"
               << "  - Data format: " << format << "\n";
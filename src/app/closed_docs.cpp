@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -10,6 +10,7 @@
 
 #include "app/closed_docs.h"
 #include "app/doc.h"
+#include "app/doc_undo.h"
 #include "app/pref/preferences.h"
 #include "base/thread.h"
 
@@ -33,6 +34,9 @@ ClosedDocs::ClosedDocs(const Preferences& pref)
   else
     m_keepClosedDocAliveForMSecs = 0;
 
+  m_compressClosedDocs = (m_keepClosedDocAliveForMSecs > 0 &&
+                          pref.general.compressClosedSpriteUndo());
+
   CLOSEDOC_TRACE("CLOSEDOC: Init",
                  "dataRecoveryPeriod", m_dataRecoveryPeriodMSecs,
                  "keepClosedDocs", m_keepClosedDocAliveForMSecs);
@@ -74,7 +78,7 @@ void ClosedDocs::addClosedDoc(Doc* doc)
   ASSERT(doc != nullptr);
   ASSERT(doc->context() == nullptr);
 
-  ClosedDoc closedDoc = { doc, base::current_tick() };
+  ClosedDoc closedDoc = { doc, base::current_tick(), false };
 
   std::unique_lock<std::mutex> lock(m_mutex);
   m_docs.insert(m_docs.begin(), std::move(closedDoc));
@@ -90,6 +94,12 @@ Doc* ClosedDocs::reopenLastClosedDoc()
   Doc* doc = nullptr;
   {
     std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_docs.empty()) {
+      // Wait the background thread if it's compressing this doc
+      m_compressingCv.wait(lock, [this]{
+        return (m_docs.empty() || m_docs.front().doc != m_compressingDoc);
+      });
+    }
     if (!m_docs.empty()) {
       doc = m_docs.front().doc;
       m_docs.erase(m_docs.begin());
@@ -105,6 +115,7 @@ std::vector<Doc*> ClosedDocs::getAndRemoveAllClosedDocs()
   std::vector<Doc*> docs;
   {
     std::unique_lock<std::mutex> lock(m_mutex);
+    m_compressingCv.wait(lock, [this]{ return !m_compressingDoc; });
     CLOSEDOC_TRACE("CLOSEDOC: Get and remove all closed", m_docs.size(), "docs");
     for (const ClosedDoc& closedDoc : m_docs)
       docs.push_back(closedDoc.doc);
@@ -125,6 +136,7 @@ void ClosedDocs::backgroundThread()
   while (!m_done) {
     base::tick_t now = base::current_tick();
     base::tick_t waitForMSecs = std::numeric_limits<base::tick_t>::max();
+    std::vector<Doc*> docsToDelete;
 
     for (auto it=m_docs.begin(); it != m_docs.end(); ) {
       const ClosedDoc& closedDoc = *it;
@@ -138,10 +150,7 @@ void ClosedDocs::backgroundThread()
             !doc->needsBackup() ||
             // Or the document already has the backup done
             doc->isFullyBackedUp()) {
-          // Finally delete the document (this is the place where we
-          // delete all documents created/loaded by the user)
-          CLOSEDOC_TRACE("CLOSEDOC: [BG] Delete doc", doc);
-          delete doc;
+          docsToDelete.push_back(doc);
           it = m_docs.erase(it);
         }
         else {
@@ -155,6 +164,25 @@ void ClosedDocs::backgroundThread()
       }
     }
 
+    if (!docsToDelete.empty()) {
+      // Finally delete the documents (this is the place where we
+      // delete all documents created/loaded by the user). Deleting a
+      // big document can take some seconds, so we unlock the mutex
+      // to avoid blocking the UI thread (e.g. in hasClosedDocs()).
+      lock.unlock();
+      for (Doc* doc : docsToDelete) {
+        CLOSEDOC_TRACE("CLOSEDOC: [BG] Delete doc", doc);
+        delete doc;
+      }
+      lock.lock();
+
+      // New docs could be added/removed in the meantime
+      continue;
+    }
+
+    if (compressNextDoc(lock))
+      continue;
+
     if (waitForMSecs < std::numeric_limits<base::tick_t>::max()) {
       CLOSEDOC_TRACE("CLOSEDOC: [BG] Wait for", waitForMSecs, "milliseconds");
 
@@ -172,4 +200,34 @@ void ClosedDocs::backgroundThread()
   CLOSEDOC_TRACE("CLOSEDOC: [BG] Background thread end");
 }
 
+// Compresses the undo history of one closed doc (except the last
+// closed one). Returns true if a doc was compressed.
+bool ClosedDocs::compressNextDoc(std::unique_lock<std::mutex>& lock)
+{
+  if (!m_compressClosedDocs)
+    return false;
+
+  auto it = std::find_if(m_docs.begin() + std::min<size_t>(1, m_docs.size()),
+                         m_docs.end(),
+                         [](const ClosedDoc& closedDoc){
+                           return !closedDoc.compressed;
+                         });
+  if (it == m_docs.end())
+    return false;
+
+  Doc* doc = it->doc;
+  it->compressed = true;
+  m_compressingDoc = doc;
+
+  CLOSEDOC_TRACE("CLOSEDOC: [BG] Compress undo history of doc", doc);
+
+  lock.unlock();
+  doc->undoHistory()->compressAllStates();
+  lock.lock();
+
+  m_compressingDoc = nullptr;
+  m_compressingCv.notify_all();
+  return true;
+}
+
 } // namespace app
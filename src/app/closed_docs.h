@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -29,6 +29,10 @@ namespace app {
   //   garbage collector).
   // * If the document was not restore, we delete it from memory, if
   //   the document was restore, we remove it from the m_docs.
+  // * While a document is kept in memory (except the last closed
+  //   one, which is the next one to be reopened), its undo history is
+  //   compressed in the background thread to save memory. It's
+  //   uncompressed state by state when the user undoes/redoes.
   class ClosedDocs {
   public:
     ClosedDocs(const Preferences& pref);
@@ -45,14 +49,23 @@ namespace app {
   private:
     void backgroundThread();
 
+    bool compressNextDoc(std::unique_lock<std::mutex>& lock);
+
     struct ClosedDoc {
       Doc* doc;
       base::tick_t timestamp;
+      bool compressed;
     };
 
     std::atomic<bool> m_done;
     base::tick_t m_dataRecoveryPeriodMSecs;
     base::tick_t m_keepClosedDocAliveForMSecs;
+    bool m_compressClosedDocs;
+
+    // Document being compressed in the background thread (it cannot
+    // be reopened until the compression finishes)
+    Doc* m_compressingDoc = nullptr;
+    std::condition_variable m_compressingCv;
     std::vector<ClosedDoc> m_docs;
     std::mutex m_mutex;
     std::condition_variable m_cv;
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +12,7 @@
 #include "app/cmd.h"
 #include "base/debug.h"
 #include "base/mem_utils.h"
+#include "doc/task_scheduler.h"
 
 #include <typeinfo>
 
@@ -49,6 +51,8 @@ void Cmd::undo()
   CMD_TRACE("CMD: Undo cmd '%s'\n", typeid(*this).name());
   ASSERT(m_state == State::Executed || m_state == State::Redone);
 
+  unspill();
+  uncompress();
   onUndo();
   onFireNotifications();
 
@@ -62,6 +66,8 @@ void Cmd::redo()
   CMD_TRACE("CMD: Redo cmd '%s'\n", typeid(*this).name());
   ASSERT(m_state == State::Undone);
 
+  unspill();
+  uncompress();
   onRedo();
   onFireNotifications();
 
@@ -79,6 +85,25 @@ void Cmd::dispose()
   delete this;
 }
 
+void Cmd::compress()
+{
+  if (!m_compressed)
+    m_compressed = onCompress();
+}
+
+void Cmd::uncompress()
+{
+  if (m_compressed) {
+    onUncompress();
+    m_compressed = false;
+  }
+}
+
+void Cmd::preload(doc::TaskGroup& tasks)
+{
+  onPreload(tasks);
+}
+
 std::string Cmd::label() const
 {
   return onLabel();
@@ -89,6 +114,30 @@ size_t Cmd::memSize() const
   return onMemSize();
 }
 
+void Cmd::spill(SpillFile* file)
+{
+  ASSERT(file);
+  if (m_spillFile)
+    return;
+
+  CMD_TRACE("CMD: Spilling '%s' (%s)\n",
+            typeid(*this).name(),
+            base::get_pretty_memory_size(memSize()).c_str());
+
+  if (onSpill(file))
+    m_spillFile = file;
+}
+
+void Cmd::unspill()
+{
+  if (m_spillFile) {
+    CMD_TRACE("CMD: Unspilling '%s'\n", typeid(*this).name());
+
+    onUnspill(m_spillFile);
+    m_spillFile = nullptr;
+  }
+}
+
 void Cmd::onExecute()
 {
   // Do nothing
@@ -119,4 +168,35 @@ size_t Cmd::onMemSize() const {
   return sizeof(*this);
 }
 
+bool Cmd::onSpill(SpillFile* file)
+{
+  // Do nothing, the data stays in memory
+  return false;
+}
+
+void Cmd::onUnspill(SpillFile* file)
+{
+  // Do nothing
+}
+
+bool Cmd::onCompress()
+{
+  // Do nothing, the data stays uncompressed
+  return false;
+}
+
+void Cmd::onUncompress()
+{
+  // Do nothing
+}
+
+void Cmd::onPreload(doc::TaskGroup& tasks)
+{
+  // The spill file is read from this thread (it's not thread-safe),
+  // only the uncompression is done in parallel.
+  unspill();
+  if (m_compressed)
+    tasks.run([this]{ uncompress(); });
+}
+
 } // namespace app
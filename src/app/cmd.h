@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -13,9 +14,14 @@
 
 #include <string>
 
+namespace doc {
+  class TaskGroup;
+}
+
 namespace app {
 
   class Context;
+  class SpillFile;
 
   class Cmd : public undo::UndoCommand {
   public:
@@ -34,6 +40,23 @@ namespace app {
 
     Context* context() const { return m_ctx; }
 
+    // Moves the data needed to undo/redo this command (e.g. pixels)
+    // to the given file to reduce the memory usage. The data is
+    // loaded again automatically before undoing/redoing the command.
+    void spill(SpillFile* file);
+    bool isSpilled() const { return m_spillFile != nullptr; }
+
+    // Compresses the data needed to undo/redo this command in
+    // memory. It's uncompressed automatically before undoing/redoing.
+    void compress();
+    bool isCompressed() const { return m_compressed; }
+
+    // Loads the spilled data and uncompresses it (in the given group
+    // of tasks) before undoing/redoing the command, so the data of
+    // several commands can be prepared at the same time (e.g. to move
+    // to a far state in the undo history).
+    void preload(doc::TaskGroup& tasks);
+
   protected:
     virtual void onExecute();
     virtual void onUndo();
@@ -42,8 +65,25 @@ namespace app {
     virtual std::string onLabel() const;
     virtual size_t onMemSize() const;
 
+    // Returns true if some data was moved to the file, in that case
+    // onUnspill() will be called before the next undo/redo.
+    virtual bool onSpill(SpillFile* file);
+    virtual void onUnspill(SpillFile* file);
+
+    // Returns true if the data was compressed, in that case
+    // onUncompress() will be called before the next undo/redo.
+    virtual bool onCompress();
+    virtual void onUncompress();
+
+    virtual void onPreload(doc::TaskGroup& tasks);
+
   private:
+    void unspill();
+    void uncompress();
+
     Context* m_ctx;
+    SpillFile* m_spillFile = nullptr;
+    bool m_compressed = false;
 #if _DEBUG
     enum class State { NotExecuted, Executed, Undone, Redone };
     State m_state;
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -15,6 +16,7 @@
 #include "doc/image.h"
 #include "doc/layer.h"
 #include "doc/primitives.h"
+#include "gfx/region.h"
 
 namespace app {
 namespace cmd {
@@ -43,6 +45,7 @@ ClearRect::ClearRect(Cel* cel, const gfx::Rect& bounds)
   m_dstImage.reset(new WithImage(image));
 
   Doc* doc = static_cast<Doc*>(cel->document());
+  m_doc.reset(new WithDocument(doc));
   m_bgcolor = doc->bgColor(cel->layer());
 
   m_copy.reset(crop_image(image,
@@ -70,18 +73,36 @@ void ClearRect::onRedo()
     clear();
 }
 
+void ClearRect::onFireNotifications()
+{
+  if (!m_dstImage)
+    return;
+
+  Doc* doc = m_doc->document();
+  if (doc) {
+    doc->notifyImagePixelsModified(
+      m_dstImage->image(),
+      gfx::Region(gfx::Rect(m_offsetX, m_offsetY,
+                            m_copy->width(), m_copy->height())));
+  }
+}
+
 void ClearRect::clear()
 {
-  fill_rect(m_dstImage->image(),
+  Image* image = m_dstImage->image();
+  fill_rect(image,
             m_offsetX, m_offsetY,
             m_offsetX + m_copy->width() - 1,
             m_offsetY + m_copy->height() - 1,
             m_bgcolor);
+  image->incrementVersion();
 }
 
 void ClearRect::restore()
 {
-  copy_image(m_dstImage->image(), m_copy.get(), m_offsetX, m_offsetY);
+  Image* image = m_dstImage->image();
+  copy_image(image, m_copy.get(), m_offsetX, m_offsetY);
+  image->incrementVersion();
 }
 
 } // namespace cmd
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -32,6 +33,7 @@ namespace cmd {
     void onExecute() override;
     void onUndo() override;
     void onRedo() override;
+    void onFireNotifications() override;
     size_t onMemSize() const override {
       return sizeof(*this) + m_seq.memSize() +
         (m_copy ? m_copy->getMemSize(): 0);
@@ -42,6 +44,7 @@ namespace cmd {
     void restore();
 
     CmdSequence m_seq;
+    std::unique_ptr<WithDocument> m_doc;
     std::unique_ptr<WithImage> m_dstImage;
     ImageRef m_copy;
     int m_offsetX, m_offsetY;
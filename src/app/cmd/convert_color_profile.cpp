@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2021  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -14,15 +14,68 @@
 #include "app/cmd/replace_image.h"
 #include "app/cmd/set_palette.h"
 #include "app/doc.h"
+#include "doc/algorithm/parallel_bands.h"
 #include "doc/cels_range.h"
 #include "doc/palette.h"
 #include "doc/sprite.h"
 #include "os/color_space.h"
 #include "os/system.h"
 
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 namespace app {
 namespace cmd {
 
+// Converts each different color of the image only once (pixel art
+// usually has a few colors). Returns false if the image has too many
+// colors and it's better to convert all pixels.
+static bool convert_rgb_image_using_unique_colors(const doc::Image* srcImage,
+                                                  doc::Image* dstImage,
+                                                  os::ColorSpaceConversion* conversion)
+{
+  const int w = srcImage->width();
+  const int h = srcImage->height();
+  const size_t maxColors = std::max<size_t>(256, size_t(w)*h / 16);
+
+  std::unordered_map<uint32_t, uint32_t> colorIndex;
+  std::vector<uint32_t> colors;
+  for (int y=0; y<h; ++y) {
+    auto srcPtr = (const uint32_t*)srcImage->getPixelAddress(0, y);
+    for (int x=0; x<w; ++x, ++srcPtr) {
+      if (colorIndex.insert(std::make_pair(*srcPtr, uint32_t(colors.size()))).second) {
+        colors.push_back(*srcPtr);
+        if (colors.size() > maxColors)
+          return false;
+      }
+    }
+  }
+
+  std::vector<uint32_t> newColors(colors.size());
+  conversion->convertRgba(newColors.data(), colors.data(), int(colors.size()));
+
+  for (int y=0; y<h; ++y) {
+    auto srcPtr = (const uint32_t*)srcImage->getPixelAddress(0, y);
+    auto dstPtr = (uint32_t*)dstImage->getPixelAddress(0, y);
+    // Avoid looking up the same color for runs of pixels
+    uint32_t lastSrc = *srcPtr;
+    uint32_t lastDst = newColors[colorIndex[lastSrc]];
+    for (int x=0; x<w; ++x, ++srcPtr, ++dstPtr) {
+      if (*srcPtr != lastSrc) {
+        lastSrc = *srcPtr;
+        lastDst = newColors[colorIndex[lastSrc]];
+      }
+      *dstPtr = lastDst;
+    }
+  }
+  return true;
+}
+
+// This function can be called from several threads at the same time
+// (os::ColorSpaceConversion doesn't modify its state when it
+// converts pixels).
 static doc::ImageRef convert_image_color_space(const doc::Image* srcImage,
                                                const gfx::ColorSpaceRef& newCS,
                                                os::ColorSpaceConversion* conversion)
@@ -37,39 +90,65 @@ static doc::ImageRef convert_image_color_space(const doc::Image* srcImage,
   }
 
   if (spec.colorMode() == doc::ColorMode::RGB) {
-    for (int y=0; y<spec.height(); ++y) {
-      conversion->convertRgba((uint32_t*)dstImage->getPixelAddress(0, y),
-                              (const uint32_t*)srcImage->getPixelAddress(0, y),
-                              spec.width());
+    if (!convert_rgb_image_using_unique_colors(srcImage, dstImage.get(), conversion)) {
+      for (int y=0; y<spec.height(); ++y) {
+        conversion->convertRgba((uint32_t*)dstImage->getPixelAddress(0, y),
+                                (const uint32_t*)srcImage->getPixelAddress(0, y),
+                                spec.width());
+      }
     }
   }
   else if (spec.colorMode() == doc::ColorMode::GRAYSCALE) {
     // TODO create a set of functions to create pixel format
     // conversions (this should be available when we add new kind of
     // pixel formats).
-    std::vector<uint8_t> buf(spec.width()*spec.height());
 
-    auto it = buf.begin();
-    for (int y=0; y<spec.height(); ++y) {
-      auto srcPtr = (const uint16_t*)srcImage->getPixelAddress(0, y);
-      for (int x=0; x<spec.width(); ++x, ++srcPtr, ++it)
-        *it = doc::graya_getv(*srcPtr);
-    }
-
-    conversion->convertGray(&buf[0], &buf[0], spec.width()*spec.height());
+    // There are only 256 gray levels, so we convert each one once
+    // and use the table to convert the pixels.
+    uint8_t grayTable[256];
+    for (int i=0; i<256; ++i)
+      grayTable[i] = uint8_t(i);
+    conversion->convertGray(grayTable, grayTable, 256);
 
-    it = buf.begin();
     for (int y=0; y<spec.height(); ++y) {
       auto srcPtr = (const uint16_t*)srcImage->getPixelAddress(0, y);
       auto dstPtr = (uint16_t*)dstImage->getPixelAddress(0, y);
-      for (int x=0; x<spec.width(); ++x, ++dstPtr, ++srcPtr, ++it)
-        *dstPtr = doc::graya(*it, doc::graya_geta(*srcPtr));
+      for (int x=0; x<spec.width(); ++x, ++dstPtr, ++srcPtr)
+        *dstPtr = doc::graya(grayTable[doc::graya_getv(*srcPtr)],
+                             doc::graya_geta(*srcPtr));
     }
   }
 
   return dstImage;
 }
 
+// Converts all the images of the sprite in parallel (one image per
+// thread). Returns pairs of old/new images.
+static std::vector<std::pair<ImageRef, ImageRef>>
+convert_sprite_images(doc::Sprite* sprite,
+                      const gfx::ColorSpaceRef& newCS,
+                      os::ColorSpaceConversion* conversion)
+{
+  std::vector<std::pair<ImageRef, ImageRef>> images;
+  if (sprite->pixelFormat() == doc::IMAGE_INDEXED)
+    return images;
+
+  for (Cel* cel : sprite->uniqueCels()) {
+    ImageRef old_image = cel->imageRef();
+    if (old_image.get()->pixelFormat() != IMAGE_TILEMAP)
+      images.push_back(std::make_pair(old_image, ImageRef()));
+  }
+
+  doc::algorithm::for_each_index(
+    int(images.size()),
+    [&images, &newCS, conversion](const int i) {
+      images[i].second = convert_image_color_space(
+        images[i].first.get(), newCS, conversion);
+    });
+
+  return images;
+}
+
 void convert_color_profile(doc::Sprite* sprite,
                            const gfx::ColorSpaceRef& newCS)
 {
@@ -85,17 +164,8 @@ void convert_color_profile(doc::Sprite* sprite,
   auto conversion = system->convertBetweenColorSpace(srcOCS, dstOCS);
 
   // Convert images
-  if (sprite->pixelFormat() != doc::IMAGE_INDEXED) {
-    for (Cel* cel : sprite->uniqueCels()) {
-      ImageRef old_image = cel->imageRef();
-      if (old_image.get()->pixelFormat() != IMAGE_TILEMAP) {
-        ImageRef new_image = convert_image_color_space(
-          old_image.get(), newCS, conversion.get());
-
-        sprite->replaceImage(old_image->id(), new_image);
-      }
-    }
-  }
+  for (const auto& pair : convert_sprite_images(sprite, newCS, conversion.get()))
+    sprite->replaceImage(pair.first->id(), pair.second);
 
   if (conversion) {
     // Convert palette
@@ -180,17 +250,8 @@ ConvertColorProfile::ConvertColorProfile(doc::Sprite* sprite, const gfx::ColorSp
   auto conversion = system->convertBetweenColorSpace(srcOCS, dstOCS);
 
   // Convert images
-  if (sprite->pixelFormat() != doc::IMAGE_INDEXED) {
-    for (Cel* cel : sprite->uniqueCels()) {
-      ImageRef old_image = cel->imageRef();
-      if (old_image.get()->pixelFormat() != IMAGE_TILEMAP) {
-        ImageRef new_image = convert_image_color_space(
-          old_image.get(), newCS, conversion.get());
-
-        m_seq.add(new cmd::ReplaceImage(sprite, old_image, new_image));
-      }
-    }
-  }
+  for (const auto& pair : convert_sprite_images(sprite, newCS, conversion.get()))
+    m_seq.add(new cmd::ReplaceImage(sprite, pair.first, pair.second));
 
   if (conversion) {
     // Convert palette
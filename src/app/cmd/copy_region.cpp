@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,7 @@
 
 #include "app/cmd/copy_region.h"
 
+#include "app/context.h"
 #include "app/doc.h"
 #include "app/util/buffer_region.h"
 #include "doc/image.h"
@@ -84,6 +85,76 @@ void CopyRegion::swap()
   rehash();
 }
 
+bool CopyRegion::onSpill(SpillFile* file)
+{
+  if (m_buffer.size() < SpillFile::kMinChunkSize)
+    return false;
+
+  m_spilledBuffer = file->write(&m_buffer[0], m_buffer.size());
+  base::buffer().swap(m_buffer);
+  return true;
+}
+
+void CopyRegion::onUnspill(SpillFile* file)
+{
+  file->read(m_spilledBuffer, m_buffer);
+}
+
+bool CopyRegion::onCompress()
+{
+  // Tiny buffers are not worth the time
+  if (m_buffer.size() < 256)
+    return false;
+
+  const size_t rawSize = m_buffer.size();
+  if (!compress_buffer(m_buffer))
+    return false;
+
+  m_rawSize = rawSize;
+  return true;
+}
+
+void CopyRegion::onUncompress()
+{
+  uncompress_buffer(m_buffer, m_rawSize);
+}
+
+void CopyRegion::onFireNotifications()
+{
+  if (m_region.isEmpty())
+    return;
+
+  // Only the exact modified region is reported, so editors can
+  // redraw just that part of the canvas.
+  if (Doc* doc = findDocument())
+    doc->notifyImagePixelsModified(image(), m_region);
+}
+
+Doc* CopyRegion::findDocument()
+{
+  if (m_docId != NullId) {
+    if (auto doc = doc::get<Doc>(m_docId))
+      return doc;
+  }
+
+  // The image doesn't know its sprite, so we look for the document
+  // that contains it (the active document can be a different one,
+  // e.g. when this command is undone from the Undo History of other
+  // document, or a script modifies a non-active sprite).
+  Image* img = image();
+  if (!context() || !img)
+    return nullptr;
+
+  for (Doc* doc : context()->documents()) {
+    if (doc->sprite() &&
+        doc->sprite()->getImageRef(img->id())) {
+      m_docId = doc->id();
+      return doc;
+    }
+  }
+  return nullptr;
+}
+
 void CopyTileRegion::rehash()
 {
   ASSERT(m_tileIndex != notile);
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,7 @@
 
 #include "app/cmd.h"
 #include "app/cmd/with_image.h"
+#include "app/util/spill_file.h"
 #include "base/buffer.h"
 #include "doc/tile.h"
 #include "gfx/point.h"
@@ -21,6 +22,8 @@ namespace doc {
 }
 
 namespace app {
+  class Doc;
+
 namespace cmd {
   using namespace doc;
 
@@ -40,17 +43,31 @@ namespace cmd {
     void onExecute() override;
     void onUndo() override;
     void onRedo() override;
+    void onFireNotifications() override;
     size_t onMemSize() const override {
       return sizeof(*this) + m_buffer.size();
     }
+    bool onSpill(SpillFile* file) override;
+    void onUnspill(SpillFile* file) override;
+    bool onCompress() override;
+    void onUncompress() override;
 
   private:
     void swap();
     virtual void rehash() { }
+    Doc* findDocument();
 
     bool m_alreadyCopied;
     gfx::Region m_region;
     base::buffer m_buffer;
+    SpillFile::Chunk m_spilledBuffer;
+
+    // Size of m_buffer before it was compressed.
+    size_t m_rawSize = 0;
+
+    // Document that contains the image (found in the first
+    // notification).
+    ObjectId m_docId = NullId;
   };
 
   class CopyTileRegion : public CopyRegion {
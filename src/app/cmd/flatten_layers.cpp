@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -22,6 +22,7 @@
 #include "app/doc.h"
 #include "app/i18n/strings.h"
 #include "app/restore_visible_layers.h"
+#include "app/util/parallel_tasks.h"
 #include "doc/algorithm/shrink_bounds.h"
 #include "doc/cel.h"
 #include "doc/layer.h"
@@ -29,9 +30,31 @@
 #include "doc/sprite.h"
 #include "render/render.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+
 namespace app {
 namespace cmd {
 
+namespace {
+
+// Adds all the image layers inside "layer" (or the layer itself) to
+// "images".
+void collect_image_layers(Layer* layer, std::vector<LayerImage*>& images)
+{
+  if (layer->isImage())
+    images.push_back(static_cast<LayerImage*>(layer));
+  else if (layer->isGroup()) {
+    for (Layer* child : static_cast<LayerGroup*>(layer)->layers())
+      collect_image_layers(child, images);
+  }
+}
+
+} // anonymous namespace
+
 FlattenLayers::FlattenLayers(doc::Sprite* sprite,
                              const doc::SelectedLayers& layers0,
                              const bool newBlend)
@@ -66,9 +89,6 @@ void FlattenLayers::onExecute()
   if (list.empty())
     return;                     // Do nothing
 
-  // Create a temporary image.
-  ImageRef image(Image::create(sprite->spec()));
-
   LayerImage* flatLayer;  // The layer onto which everything will be flattened.
   color_t bgcolor;        // The background color to use for flatLayer.
   bool newFlatLayer = false;
@@ -87,9 +107,43 @@ void FlattenLayers::onExecute()
     bgcolor = sprite->transparentColor();
   }
 
-  render::Render render;
-  render.setNewBlend(m_newBlendMethod);
-  render.setBgOptions(render::BgOptions::MakeNone());
+  // Image layers that are flattened, to know which frames will
+  // produce the same result as the previous one (frames where all
+  // cels are linked to the cels of the previous frame).
+  std::vector<LayerImage*> imageLayers;
+  for (Layer* layer : layers)
+    collect_image_layers(layer, imageLayers);
+
+  const frame_t nframes = sprite->totalFrames();
+  std::vector<bool> sameAsPrev(nframes, false);
+  std::vector<frame_t> framesToRender;
+  {
+    using CelKey = std::pair<const CelData*, int>;
+    std::vector<CelKey> prevKey, key;
+    for (frame_t frame(0); frame<nframes; ++frame) {
+      key.clear();
+      for (LayerImage* layer : imageLayers) {
+        const Cel* cel = layer->cel(frame);
+        key.push_back(cel ? CelKey(cel->data(), cel->zIndex()):
+                            CelKey(nullptr, 0));
+      }
+      if (frame > 0 &&
+          key == prevKey &&
+          sprite->palette(frame) == sprite->palette(frame-1)) {
+        sameAsPrev[frame] = true;
+      }
+      else
+        framesToRender.push_back(frame);
+      std::swap(key, prevKey);
+    }
+  }
+
+  // Flattened image of each frame (only for frames in
+  // "framesToRender", cropped to "bounds" when "cropImages" is true,
+  // i.e. when we're creating a new layer).
+  const bool cropImages = newFlatLayer;
+  std::vector<ImageRef> images(nframes);
+  std::vector<gfx::Rect> bounds(nframes);
 
   {
     // Show only the layers to be flattened so other layers are hidden
@@ -97,38 +151,85 @@ void FlattenLayers::onExecute()
     RestoreVisibleLayers restore;
     restore.showSelectedLayers(sprite, layers);
 
-    // Copy all frames to the background.
-    for (frame_t frame(0); frame<sprite->totalFrames(); ++frame) {
-      // Clear the image and render this frame.
-      clear_image(image.get(), bgcolor);
-      render.renderSprite(image.get(), sprite, frame);
+    // Frames are independent, so we render them in parallel (each
+    // task with its own render::Render), reading the sprite only.
+    const int nrender = int(framesToRender.size());
+    const int ntasks = std::clamp<int>(std::thread::hardware_concurrency(),
+                                       1, std::max(1, nrender));
+    std::atomic<int> next(0);
+
+    run_parallel_tasks(
+      ntasks,
+      [&](const std::atomic<bool>& stop){
+        render::Render render;
+        render.setNewBlend(m_newBlendMethod);
+        render.setBgOptions(render::BgOptions::MakeNone());
+
+        ImageRef image;
+        while (!stop) {
+          const int i = next++;
+          if (i >= nrender)
+            break;
+
+          const frame_t frame = framesToRender[i];
+          if (!image)
+            image.reset(Image::create(sprite->spec()));
+
+          // Clear the image and render this frame.
+          clear_image(image.get(), bgcolor);
+          render.renderSprite(image.get(), sprite, frame);
+
+          if (cropImages) {
+            gfx::Rect rc(image->bounds());
+            if (doc::algorithm::shrink_bounds(
+                  image.get(), image->maskColor(), nullptr, rc)) {
+              images[frame].reset(
+                doc::crop_image(image.get(), rc, image->maskColor()));
+              bounds[frame] = rc;
+            }
+          }
+          else {
+            images[frame] = image;
+            image.reset();
+          }
+        }
+      },
+      []{ return true; });
+  }
+
+  // Add the flattened images to the layer in frame order.
+  for (frame_t frame(0); frame<nframes; ++frame) {
+    if (sameAsPrev[frame]) {
+      images[frame] = images[frame-1];
+      bounds[frame] = bounds[frame-1];
+    }
 
-      // TODO Keep cel links when possible
+    const ImageRef& image = images[frame];
+    if (!image)
+      continue;
 
-      ImageRef cel_image;
-      Cel* cel = flatLayer->cel(frame);
-      if (cel) {
-        if (cel->links())
-          executeAndAdd(new cmd::UnlinkCel(cel));
+    Cel* cel = flatLayer->cel(frame);
+    if (cel) {
+      if (cel->links())
+        executeAndAdd(new cmd::UnlinkCel(cel));
 
-        cel_image = cel->imageRef();
-        ASSERT(cel_image);
+      ImageRef cel_image = cel->imageRef();
+      ASSERT(cel_image);
 
-        executeAndAdd(
-          new cmd::CopyRect(cel_image.get(), image.get(),
-                            gfx::Clip(0, 0, image->bounds())));
-      }
-      else {
-        gfx::Rect bounds(image->bounds());
-        if (doc::algorithm::shrink_bounds(
-              image.get(), image->maskColor(), nullptr, bounds)) {
-          cel_image.reset(
-            doc::crop_image(image.get(), bounds, image->maskColor()));
-          cel = new Cel(frame, cel_image);
-          cel->setPosition(bounds.origin());
-          flatLayer->addCel(cel);
-        }
-      }
+      executeAndAdd(
+        new cmd::CopyRect(cel_image.get(), image.get(),
+                          gfx::Clip(0, 0, image->bounds())));
+    }
+    // Link this cel with the previous one if the result is the
+    // same (the layer isn't in the sprite yet, so it doesn't need
+    // commands).
+    else if (newFlatLayer && sameAsPrev[frame] && flatLayer->cel(frame-1)) {
+      flatLayer->addCel(Cel::MakeLink(frame, flatLayer->cel(frame-1)));
+    }
+    else {
+      cel = new Cel(frame, image);
+      cel->setPosition(bounds[frame].origin());
+      flatLayer->addCel(cel);
     }
   }
 
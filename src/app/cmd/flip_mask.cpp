@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -46,7 +46,7 @@ void FlipMask::swap()
     return;
 
   mask->freeze();
-  doc::algorithm::flip_image(mask->bitmap(),
+  doc::algorithm::flip_image(mask->editableBitmap(),
     mask->bitmap()->bounds(), m_flipType);
   mask->unfreeze();
 
@@ -0,0 +1,79 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/cmd/permute_frames.h"
+
+#include "app/doc.h"
+#include "doc/layer.h"
+#include "doc/sprite.h"
+
+namespace app {
+namespace cmd {
+
+PermuteFrames::PermuteFrames(Sprite* sprite,
+                             const std::vector<frame_t>& newFrames)
+  : WithSprite(sprite)
+  , m_newFrames(newFrames)
+{
+}
+
+PermuteFrames::PermuteFrames(Sprite* sprite,
+                             const LayerList& layers,
+                             const std::vector<frame_t>& newFrames)
+  : WithSprite(sprite)
+  , m_newFrames(newFrames)
+{
+  for (const Layer* layer : layers) {
+    if (layer->isImage())
+      m_layerIds.push_back(layer->id());
+  }
+}
+
+void PermuteFrames::onExecute()
+{
+  permute(m_newFrames);
+}
+
+void PermuteFrames::onUndo()
+{
+  std::vector<frame_t> oldFrames(m_newFrames.size());
+  for (frame_t i=0; i<frame_t(m_newFrames.size()); ++i)
+    oldFrames[m_newFrames[i]] = i;
+
+  permute(oldFrames);
+}
+
+void PermuteFrames::onFireNotifications()
+{
+  // One general update is cheaper than notifying the new frame of
+  // each cel.
+  Doc* doc = static_cast<Doc*>(sprite()->document());
+  doc->notifyGeneralUpdate();
+}
+
+void PermuteFrames::permute(const std::vector<frame_t>& newFrames)
+{
+  Sprite* sprite = this->sprite();
+  if (m_layerIds.empty()) {
+    sprite->permuteFrames(newFrames);
+  }
+  else {
+    for (ObjectId layerId : m_layerIds) {
+      auto layer = doc::get<LayerImage>(layerId);
+      ASSERT(layer);
+      if (layer)
+        layer->permuteFrames(newFrames);
+    }
+  }
+  sprite->incrementVersion();
+}
+
+} // namespace cmd
+} // namespace app
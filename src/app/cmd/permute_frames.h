@@ -0,0 +1,55 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_CMD_PERMUTE_FRAMES_H_INCLUDED
+#define APP_CMD_PERMUTE_FRAMES_H_INCLUDED
+#pragma once
+
+#include "app/cmd.h"
+#include "app/cmd/with_sprite.h"
+#include "doc/frame.h"
+#include "doc/layer_list.h"
+#include "doc/object_id.h"
+
+#include <vector>
+
+namespace app {
+namespace cmd {
+  using namespace doc;
+
+  // Reorders the frames of the sprite (cels of all layers and frame
+  // durations) in one step, moving each frame "f" to "newFrames[f]".
+  // If a list of layers is given, only the cels of those layers are
+  // reordered (frame durations are kept). The undo applies the
+  // inverse permutation.
+  class PermuteFrames : public Cmd
+                      , public WithSprite {
+  public:
+    PermuteFrames(Sprite* sprite, const std::vector<frame_t>& newFrames);
+    PermuteFrames(Sprite* sprite, const LayerList& layers,
+                  const std::vector<frame_t>& newFrames);
+
+  protected:
+    void onExecute() override;
+    void onUndo() override;
+    void onFireNotifications() override;
+    size_t onMemSize() const override {
+      return sizeof(*this) +
+        sizeof(frame_t) * m_newFrames.size() +
+        sizeof(ObjectId) * m_layerIds.size();
+    }
+
+  private:
+    void permute(const std::vector<frame_t>& newFrames);
+
+    std::vector<ObjectId> m_layerIds;
+    std::vector<frame_t> m_newFrames;
+  };
+
+} // namespace cmd
+} // namespace app
+
+#endif
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2023  Igara Studio S.A.
+// Copyright (C) 2023-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,7 @@
 
 #include "app/cmd/replace_image.h"
 
+#include "base/exception.h"
 #include "doc/cel.h"
 #include "doc/cels_range.h"
 #include "doc/image.h"
@@ -68,6 +69,32 @@ void ReplaceImage::onRedo()
   m_copy.reset(Image::createCopy(oldImage.get()));
 }
 
+bool ReplaceImage::onSpill(SpillFile* file)
+{
+  if (!m_copy || m_copy->getMemSize() < SpillFile::kMinChunkSize)
+    return false;
+
+  std::ostringstream s;
+  write_image(s, m_copy.get());
+  const std::string data = s.str();
+
+  m_spilledCopy = file->write((const uint8_t*)data.data(), data.size());
+  m_copy.reset();
+  return true;
+}
+
+void ReplaceImage::onUnspill(SpillFile* file)
+{
+  base::buffer data;
+  file->read(m_spilledCopy, data);
+
+  // The ID is set in onUndo()/onRedo() anyway
+  std::istringstream s(std::string((const char*)&data[0], data.size()));
+  m_copy.reset(read_image(s, false));
+  if (!m_copy)
+    throw base::Exception("Error reading undo data from disk");
+}
+
 void ReplaceImage::replaceImage(ObjectId oldId, const ImageRef& newImage)
 {
   Sprite* spr = sprite();
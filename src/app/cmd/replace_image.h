@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -10,6 +11,7 @@
 
 #include "app/cmd.h"
 #include "app/cmd/with_sprite.h"
+#include "app/util/spill_file.h"
 #include "doc/image_ref.h"
 
 #include <sstream>
@@ -31,6 +33,8 @@ namespace cmd {
       return sizeof(*this) +
         (m_copy ? m_copy->getMemSize(): 0);
     }
+    bool onSpill(SpillFile* file) override;
+    void onUnspill(SpillFile* file) override;
 
   private:
     void replaceImage(ObjectId oldId, const ImageRef& newImage);
@@ -43,6 +47,9 @@ namespace cmd {
     // Then the reference is not used anymore.
     ImageRef m_newImage;
     ImageRef m_copy;
+
+    // Location of m_copy in the spill file when it's spilled.
+    SpillFile::Chunk m_spilledCopy;
   };
 
 } // namespace cmd
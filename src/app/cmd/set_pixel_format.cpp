@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -17,6 +17,7 @@
 #include "app/cmd/set_palette.h"
 #include "app/doc.h"
 #include "app/doc_event.h"
+#include "app/util/parallel_tasks.h"
 #include "doc/cel.h"
 #include "doc/cels_range.h"
 #include "doc/document.h"
@@ -28,6 +29,11 @@
 #include "render/quantization.h"
 #include "render/task_delegate.h"
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
 namespace app {
 namespace cmd {
 
@@ -66,6 +72,25 @@ private:
   TaskDelegate* m_delegate;
 };
 
+// Delegate used by each worker thread when images are converted in
+// parallel. The progress is reported from the main thread (as the
+// given delegate might not be thread-safe).
+class WorkerDelegate : public render::TaskDelegate {
+public:
+  WorkerDelegate(const std::atomic<bool>& stop)
+    : m_stop(stop) {
+  }
+
+  void notifyTaskProgress(double progress) override { }
+
+  bool continueTask() override {
+    return !m_stop;
+  }
+
+private:
+  const std::atomic<bool>& m_stop;
+};
+
 } // anonymous namespace
 
 SetPixelFormat::SetPixelFormat(Sprite* sprite,
@@ -73,7 +98,8 @@ SetPixelFormat::SetPixelFormat(Sprite* sprite,
                                const render::Dithering& dithering,
                                const doc::RgbMapAlgorithm mapAlgorithm,
                                doc::rgba_to_graya_func toGray,
-                               render::TaskDelegate* delegate)
+                               render::TaskDelegate* delegate,
+                               const bool parallel)
   : WithSprite(sprite)
   , m_oldFormat(sprite->pixelFormat())
   , m_newFormat(newFormat)
@@ -97,20 +123,35 @@ SetPixelFormat::SetPixelFormat(Sprite* sprite,
   SuperDelegate superDel(nimages, delegate);
 
   // Convert cel images
+  std::vector<Cel*> cels;
   for (Cel* cel : sprite->uniqueCels()) {
-    if (cel->layer()->isTilemap())
-      continue;
-
-    ImageRef oldImage = cel->imageRef();
-    convertImage(sprite, dithering,
-                 oldImage,
-                 cel->frame(),
-                 cel->layer()->isBackground(),
-                 mapAlgorithm,
-                 toGray,
-                 &superDel);
+    if (!cel->layer()->isTilemap())
+      cels.push_back(cel);
+  }
 
-    superDel.nextImage();
+  if (parallel &&
+      cels.size() >= 2 &&
+      std::thread::hardware_concurrency() >= 2) {
+    convertCelsInParallel(sprite, cels, dithering,
+                          mapAlgorithm, toGray, nimages, delegate);
+    for (size_t i=0; i<cels.size(); ++i)
+      superDel.nextImage();
+  }
+  else {
+    for (Cel* cel : cels) {
+      ImageRef oldImage = cel->imageRef();
+      ImageRef newImage =
+        convertImage(sprite, dithering,
+                     oldImage.get(),
+                     cel->frame(),
+                     cel->layer()->isBackground(),
+                     spriteRgbMap(sprite, cel->frame(), mapAlgorithm),
+                     toGray,
+                     &superDel);
+      m_seq.add(new cmd::ReplaceImage(sprite, oldImage, newImage));
+
+      superDel.nextImage();
+    }
   }
 
   // Convert tileset images
@@ -122,13 +163,15 @@ SetPixelFormat::SetPixelFormat(Sprite* sprite,
       for (tile_index i=0; i<tileset->size(); ++i) {
         ImageRef oldImage = tileset->get(i);
         if (oldImage) {
-          convertImage(sprite, dithering,
-                       oldImage,
-                       0,     // TODO select a frame or generate other tilesets?
-                       false, // TODO is background? it depends of the layer where this tileset is used
-                       mapAlgorithm,
-                       toGray,
-                       &superDel);
+          ImageRef newImage =
+            convertImage(sprite, dithering,
+                         oldImage.get(),
+                         0,     // TODO select a frame or generate other tilesets?
+                         false, // TODO is background? it depends of the layer where this tileset is used
+                         spriteRgbMap(sprite, 0, mapAlgorithm),
+                         toGray,
+                         &superDel);
+          m_seq.add(new cmd::ReplaceImage(sprite, oldImage, newImage));
         }
         superDel.nextImage();
       }
@@ -201,35 +244,41 @@ void SetPixelFormat::setFormat(PixelFormat format)
   doc->notify_observers<DocEvent&>(&DocObserver::onPixelFormatChanged, ev);
 }
 
-void SetPixelFormat::convertImage(doc::Sprite* sprite,
-                                  const render::Dithering& dithering,
-                                  const doc::ImageRef& oldImage,
-                                  const doc::frame_t frame,
-                                  const bool isBackground,
-                                  const doc::RgbMapAlgorithm mapAlgorithm,
-                                  doc::rgba_to_graya_func toGray,
-                                  render::TaskDelegate* delegate)
+// Making the RGBMap for Image->INDEXDED conversion.
+RgbMap* SetPixelFormat::spriteRgbMap(Sprite* sprite,
+                                     const frame_t frame,
+                                     const RgbMapAlgorithm mapAlgorithm) const
+{
+  if (m_newFormat == IMAGE_INDEXED)
+    return sprite->rgbMap(frame, sprite->rgbMapForSprite(), mapAlgorithm);
+  else
+    return nullptr;
+}
+
+ImageRef SetPixelFormat::convertImage(doc::Sprite* sprite,
+                                      const render::Dithering& dithering,
+                                      const doc::Image* oldImage,
+                                      const doc::frame_t frame,
+                                      const bool isBackground,
+                                      doc::RgbMap* rgbmap,
+                                      doc::rgba_to_graya_func toGray,
+                                      render::TaskDelegate* delegate) const
 {
   ASSERT(oldImage);
   ASSERT(oldImage->pixelFormat() != IMAGE_TILEMAP);
 
-  // Making the RGBMap for Image->INDEXDED conversion.
-  // TODO: this is needed only when newImage
-  RgbMap* rgbmap;
   int newMaskIndex = (isBackground ? -1 : 0);
   if (m_newFormat == IMAGE_INDEXED) {
-    rgbmap = sprite->rgbMap(frame, sprite->rgbMapForSprite(), mapAlgorithm);
+    ASSERT(rgbmap);
     if (m_oldFormat == IMAGE_INDEXED)
       newMaskIndex = sprite->transparentColor();
     else
       newMaskIndex = rgbmap->maskIndex();
   }
-  else {
-    rgbmap = nullptr;
-  }
-  ImageRef newImage(
+
+  return ImageRef(
     render::convert_pixel_format
-    (oldImage.get(), nullptr, m_newFormat,
+    (oldImage, nullptr, m_newFormat,
      dithering,
      rgbmap,
      sprite->palette(frame),
@@ -237,8 +286,71 @@ void SetPixelFormat::convertImage(doc::Sprite* sprite,
      newMaskIndex,
      toGray,
      delegate));
+}
+
+// Converts each cel image in a worker thread. Each image is converted
+// exactly as convertImage() does sequentially (the dithering of one
+// image only depends on that image), but each worker uses its own
+// RgbMap because RgbMaps aren't thread-safe (they are filled
+// lazily).
+void SetPixelFormat::convertCelsInParallel(Sprite* sprite,
+                                           const std::vector<Cel*>& cels,
+                                           const render::Dithering& dithering,
+                                           const RgbMapAlgorithm mapAlgorithm,
+                                           doc::rgba_to_graya_func toGray,
+                                           const int nimages,
+                                           render::TaskDelegate* delegate)
+{
+  const int ncels = int(cels.size());
+  const int ntasks = std::min<int>(ncels, std::thread::hardware_concurrency());
+  std::vector<ImageRef> newImages(ncels);
+  std::atomic<int> nextCel(0);
+  std::atomic<int> celsDone(0);
+
+  run_parallel_tasks(
+    ntasks,
+    [&](const std::atomic<bool>& stop){
+      WorkerDelegate workerDel(stop);
+      std::unique_ptr<RgbMap> rgbmap;
+      const Palette* rgbmapPalette = nullptr;
+
+      while (!stop) {
+        const int i = nextCel++;
+        if (i >= ncels)
+          break;
+
+        Cel* cel = cels[i];
+        if (m_newFormat == IMAGE_INDEXED &&
+            (!rgbmap || rgbmapPalette != sprite->palette(cel->frame()))) {
+          rgbmap = sprite->createRgbMap(cel->frame(),
+                                        sprite->rgbMapForSprite(),
+                                        mapAlgorithm);
+          rgbmapPalette = sprite->palette(cel->frame());
+        }
 
-  m_seq.add(new cmd::ReplaceImage(sprite, oldImage, newImage));
+        newImages[i] =
+          convertImage(sprite, dithering,
+                       cel->image(),
+                       cel->frame(),
+                       cel->layer()->isBackground(),
+                       rgbmap.get(),
+                       toGray,
+                       &workerDel);
+        ++celsDone;
+      }
+    },
+    [&]{
+      if (!delegate)
+        return true;
+      delegate->notifyTaskProgress(double(celsDone) / double(nimages));
+      return delegate->continueTask();
+    });
+
+  // Add the commands in the same order as the sequential conversion
+  for (int i=0; i<ncels; ++i) {
+    if (newImages[i])
+      m_seq.add(new cmd::ReplaceImage(sprite, cels[i]->imageRef(), newImages[i]));
+  }
 }
 
 } // namespace cmd
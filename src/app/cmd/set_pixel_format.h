@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -17,7 +17,12 @@
 #include "doc/pixel_format.h"
 #include "doc/rgbmap_algorithm.h"
 
+#include <vector>
+
 namespace doc {
+  class Cel;
+  class Image;
+  class RgbMap;
   class Sprite;
 }
 
@@ -37,7 +42,8 @@ namespace cmd {
                    const render::Dithering& dithering,
                    const doc::RgbMapAlgorithm mapAlgorithm,
                    doc::rgba_to_graya_func toGray,
-                   render::TaskDelegate* delegate);
+                   render::TaskDelegate* delegate,
+                   const bool parallel = false);
 
   protected:
     void onExecute() override;
@@ -49,14 +55,24 @@ namespace cmd {
 
   private:
     void setFormat(doc::PixelFormat format);
-    void convertImage(doc::Sprite* sprite,
-                      const render::Dithering& dithering,
-                      const doc::ImageRef& oldImage,
-                      const doc::frame_t frame,
-                      const bool isBackground,
-                      const doc::RgbMapAlgorithm mapAlgorithm,
-                      doc::rgba_to_graya_func toGray,
-                      render::TaskDelegate* delegate);
+    doc::RgbMap* spriteRgbMap(doc::Sprite* sprite,
+                              const doc::frame_t frame,
+                              const doc::RgbMapAlgorithm mapAlgorithm) const;
+    doc::ImageRef convertImage(doc::Sprite* sprite,
+                               const render::Dithering& dithering,
+                               const doc::Image* oldImage,
+                               const doc::frame_t frame,
+                               const bool isBackground,
+                               doc::RgbMap* rgbmap,
+                               doc::rgba_to_graya_func toGray,
+                               render::TaskDelegate* delegate) const;
+    void convertCelsInParallel(doc::Sprite* sprite,
+                               const std::vector<doc::Cel*>& cels,
+                               const render::Dithering& dithering,
+                               const doc::RgbMapAlgorithm mapAlgorithm,
+                               doc::rgba_to_graya_func toGray,
+                               const int nimages,
+                               render::TaskDelegate* delegate);
 
     doc::PixelFormat m_oldFormat;
     doc::PixelFormat m_newFormat;
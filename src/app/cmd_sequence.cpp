@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2023  Igara Studio S.A.
+// Copyright (C) 2023-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -80,6 +80,29 @@ size_t CmdSequence::onMemSize() const
   return size;
 }
 
+bool CmdSequence::onSpill(SpillFile* file)
+{
+  // Each command is unspilled by itself in its own undo()/redo(), so
+  // we don't need to keep track of the spilled state here.
+  for (Cmd* cmd : m_cmds)
+    cmd->spill(file);
+  return false;
+}
+
+bool CmdSequence::onCompress()
+{
+  // Same as onSpill(), each command uncompresses its own data
+  for (Cmd* cmd : m_cmds)
+    cmd->compress();
+  return false;
+}
+
+void CmdSequence::onPreload(doc::TaskGroup& tasks)
+{
+  for (Cmd* cmd : m_cmds)
+    cmd->preload(tasks);
+}
+
 void CmdSequence::executeAndAdd(Cmd* cmd)
 {
   addAndExecute(context(), cmd);
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2023  Igara Studio S.A.
+// Copyright (C) 2023-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -32,6 +32,9 @@ namespace app {
     void onUndo() override;
     void onRedo() override;
     size_t onMemSize() const override;
+    bool onSpill(SpillFile* file) override;
+    bool onCompress() override;
+    void onPreload(doc::TaskGroup& tasks) override;
 
   private:
     std::vector<Cmd*> m_cmds;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -13,6 +13,7 @@
 
 #include "app/context.h"
 #include "app/site.h"
+#include "base/chrono.h"
 
 #ifdef ENABLE_UI
 #include "app/app.h"
@@ -35,6 +36,7 @@ CmdTransaction* CmdTransaction::moveToEmptyCopy()
                                             m_changeSavedState);
   copy->m_spritePositionBefore = m_spritePositionBefore;
   copy->m_spritePositionAfter = m_spritePositionAfter;
+  copy->m_executionTime = m_executionTime;
   if (m_ranges) {
     copy->m_ranges.reset(new Ranges);
     copy->m_ranges->m_before = std::move(m_ranges->m_before);
@@ -100,12 +102,16 @@ void CmdTransaction::onExecute()
 
 void CmdTransaction::onUndo()
 {
+  base::Chrono chrono;
   CmdSequence::onUndo();
+  m_undoTime = chrono.elapsed();
 }
 
 void CmdTransaction::onRedo()
 {
+  base::Chrono chrono;
   CmdSequence::onRedo();
+  m_undoTime = chrono.elapsed();
 }
 
 std::string CmdTransaction::onLabel() const
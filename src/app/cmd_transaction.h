@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -41,6 +41,13 @@ namespace app {
     std::istream* documentRangeBeforeExecute() const;
     std::istream* documentRangeAfterExecute() const;
 
+    // Time (in seconds) used to execute all the cmds of this
+    // transaction, and to undo/redo it the last time (zero if it was
+    // never undone/redone).
+    double executionTime() const { return m_executionTime; }
+    double undoTime() const { return m_undoTime; }
+    void addExecutionTime(double seconds) { m_executionTime += seconds; }
+
   protected:
     void onExecute() override;
     void onUndo() override;
@@ -63,6 +70,8 @@ namespace app {
     std::unique_ptr<Ranges> m_ranges;
     std::string m_label;
     bool m_changeSavedState;
+    double m_executionTime = 0.0;
+    double m_undoTime = 0.0;
   };
 
 } // namespace app
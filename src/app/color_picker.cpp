@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -26,6 +26,7 @@
 #include "doc/tileset.h"
 #include "gfx/point.h"
 #include "render/get_sprite_pixel.h"
+#include "render/render_cache.h"
 
 #include <algorithm>
 
@@ -73,6 +74,15 @@ bool get_cel_pixel(const Cel* cel,
   }
 }
 
+// Flattened sprite used to pick colors from the composition, so
+// picking colors continuously (e.g. holding the eyedropper) doesn't
+// need to composite all layers on each mouse movement.
+render::RenderCache& composition_cache()
+{
+  static render::RenderCache cache(1);
+  return cache;
+}
+
 }
 
 ColorPicker::ColorPicker()
@@ -136,7 +146,8 @@ void ColorPicker::pickColor(const Site& site,
           sprite->pixelFormat(),
           render::get_sprite_pixel(sprite, pos.x, pos.y,
                                    site.frame(), proj,
-                                   Preferences::instance().experimental.newBlend()));
+                                   Preferences::instance().experimental.newBlend(),
+                                   &composition_cache()));
       }
       break;
     }
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -16,6 +16,10 @@
 #include "os/system.h"
 #include "os/window.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+
 namespace app {
 
 // We use this variable to avoid accessing Preferences::instance()
@@ -67,13 +71,98 @@ gfx::ColorSpaceRef get_working_rgb_space_from_preferences()
 //////////////////////////////////////////////////////////////////////
 // Color conversion
 
+namespace {
+
+// Number of samples of each RGB channel in the 3D LUT
+constexpr int kLutSize = 33;
+
+// LUT to convert from the current to the screen color space, it's
+// re-created only when one of these color spaces changes.
+struct ScreenLutCache {
+  std::mutex mutex;
+  os::ColorSpaceRef srcCS;
+  os::ColorSpaceRef dstCS;
+  std::shared_ptr<const ConvertCS::Lut> lut;
+};
+ScreenLutCache g_screenLut;
+
+std::shared_ptr<const ConvertCS::Lut>
+create_lut(os::ColorSpaceConversion* conversion)
+{
+  auto lut = std::make_shared<ConvertCS::Lut>(kLutSize*kLutSize*kLutSize);
+  auto it = lut->begin();
+  for (int r=0; r<kLutSize; ++r)
+    for (int g=0; g<kLutSize; ++g)
+      for (int b=0; b<kLutSize; ++b, ++it)
+        *it = gfx::rgba(255 * r / (kLutSize-1),
+                        255 * g / (kLutSize-1),
+                        255 * b / (kLutSize-1));
+
+  // Convert all samples at once
+  conversion->convertRgba((uint32_t*)lut->data(),
+                          (const uint32_t*)lut->data(),
+                          int(lut->size()));
+  return lut;
+}
+
+// Trilinear interpolation of the LUT samples (fixed point with 8 bits
+// of fraction).
+gfx::Color lookup_lut(const ConvertCS::Lut& lut, const gfx::Color c)
+{
+  int idx[3], frac[3];
+  const int comps[3] = { gfx::getr(c), gfx::getg(c), gfx::getb(c) };
+  for (int i=0; i<3; ++i) {
+    const int pos = comps[i] * (kLutSize-1) * 256 / 255;
+    idx[i] = std::min(pos >> 8, kLutSize-2);
+    frac[i] = pos - (idx[i] << 8);
+  }
+
+  int64_t out[3] = { 0, 0, 0 };
+  for (int corner=0; corner<8; ++corner) {
+    const int dr = (corner >> 2) & 1;
+    const int dg = (corner >> 1) & 1;
+    const int db = corner & 1;
+    const int64_t w =
+      (dr ? frac[0]: 256-frac[0]) *
+      (dg ? frac[1]: 256-frac[1]) *
+      (db ? frac[2]: 256-frac[2]);
+    if (!w)
+      continue;
+
+    const gfx::Color s = lut[((idx[0]+dr)*kLutSize + (idx[1]+dg))*kLutSize + (idx[2]+db)];
+    out[0] += w * gfx::getr(s);
+    out[1] += w * gfx::getg(s);
+    out[2] += w * gfx::getb(s);
+  }
+
+  // Weights sum 256^3 = 2^24
+  const int64_t half = 1 << 23;
+  return gfx::rgba(int((out[0] + half) >> 24),
+                   int((out[1] + half) >> 24),
+                   int((out[2] + half) >> 24),
+                   gfx::geta(c));
+}
+
+} // anonymous namespace
+
 ConvertCS::ConvertCS()
 {
   if (g_manage) {
     auto srcCS = get_current_color_space();
     auto dstCS = get_screen_color_space();
-    if (srcCS && dstCS)
-      m_conversion = os::instance()->convertBetweenColorSpace(srcCS, dstCS);
+    if (srcCS && dstCS) {
+      const std::lock_guard lock(g_screenLut.mutex);
+      if (!g_screenLut.lut ||
+          g_screenLut.srcCS.get() != srcCS.get() ||
+          g_screenLut.dstCS.get() != dstCS.get()) {
+        g_screenLut.lut.reset();
+        g_screenLut.srcCS = srcCS;
+        g_screenLut.dstCS = dstCS;
+        if (auto conversion = os::instance()->convertBetweenColorSpace(srcCS, dstCS))
+          g_screenLut.lut = create_lut(conversion.get());
+      }
+      m_lut = g_screenLut.lut;
+    }
   }
 }
 
@@ -87,12 +176,16 @@ ConvertCS::ConvertCS(const os::ColorSpaceRef& srcCS,
 
 ConvertCS::ConvertCS(ConvertCS&& that)
   : m_conversion(std::move(that.m_conversion))
+  , m_lut(std::move(that.m_lut))
 {
 }
 
 gfx::Color ConvertCS::operator()(const gfx::Color c)
 {
-  if (m_conversion) {
+  if (m_lut) {
+    return lookup_lut(*m_lut, c);
+  }
+  else if (m_conversion) {
     gfx::Color out;
     m_conversion->convertRgba((uint32_t*)&out, (const uint32_t*)&c, 1);
     return out;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (c) 2018-2020  Igara Studio S.A.
+// Copyright (c) 2018-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -12,6 +12,9 @@
 #include "gfx/color_space.h"
 #include "os/color_space.h"
 
+#include <memory>
+#include <vector>
+
 namespace doc {
   class Sprite;
 }
@@ -28,8 +31,15 @@ namespace app {
 
   gfx::ColorSpaceRef get_working_rgb_space_from_preferences();
 
+  // Converts colors between two color spaces. The default
+  // constructor converts from the current color space to the screen
+  // color space (to display colors), in this case a cached 3D LUT is
+  // used instead of the exact conversion (which is too slow to be
+  // used each time we paint a color in the UI).
   class ConvertCS {
   public:
+    using Lut = std::vector<gfx::Color>;
+
     ConvertCS();
     ConvertCS(const os::ColorSpaceRef& srcCS,
               const os::ColorSpaceRef& dstCS);
@@ -38,6 +48,7 @@ namespace app {
     gfx::Color operator()(const gfx::Color c);
   private:
     os::Ref<os::ColorSpaceConversion> m_conversion;
+    std::shared_ptr<const Lut> m_lut;
   };
 
   ConvertCS convert_from_current_to_screen_color_space();
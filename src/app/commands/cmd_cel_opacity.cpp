@@ -73,6 +73,7 @@ void CelOpacityCommand::onExecute(Context* context)
 
   {
     Tx tx(writer, "Set Cel Opacity");
+    tx.batchNotifications();
 
     // TODO the range of selected cels should be in app::Site.
     DocRange range;
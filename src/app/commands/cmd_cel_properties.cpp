@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2023  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -219,6 +219,7 @@ private:
       try {
         ContextWriter writer(UIContext::instance());
         Tx tx(writer, "Set Cel Properties");
+        tx.batchNotifications();
 
         DocRange range;
         if (m_range.enabled()) {
@@ -315,6 +316,12 @@ private:
       setCel(m_document, nullptr);
   }
 
+  // Notifications coalesced by Doc::endBatchNotifications()
+  void onGeneralUpdate(DocEvent& ev) override {
+    if (m_cel)
+      updateFromCel();
+  }
+
   void onCelOpacityChange(DocEvent& ev) override {
     if (m_cel == ev.cel())
       updateFromCel();
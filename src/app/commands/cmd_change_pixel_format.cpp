@@ -685,7 +685,8 @@ void ChangePixelFormatCommand::onExecute(Context* context)
             m_dithering,
             m_rgbmap,
             get_gray_func(m_toGray),
-            &job));             // SpriteJob is a render::TaskDelegate
+            &job,               // SpriteJob is a render::TaskDelegate
+            true));             // Convert cels in parallel
       });
     job.waitJob();
   }
@@ -40,6 +40,7 @@ struct ExportSpriteSheetParams : public NewParams {
   Param<bool> extrude { this, false, "extrude" };
   Param<bool> ignoreEmpty { this, false, "ignoreEmpty" };
   Param<bool> mergeDuplicates { this, false, "mergeDuplicates" };
+  Param<bool> fastPacking { this, false, "fastPacking" };
   Param<bool> openGenerated { this, false, "openGenerated" };
   Param<std::string> layer { this, std::string(), "layer" };
   // TODO The layerIndex parameter is for internal use only, layers
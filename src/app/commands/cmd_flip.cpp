@@ -214,7 +214,7 @@ void FlipCommand::onExecute(Context* ctx)
   }
 
   // Flip the mask.
-  Image* maskBitmap = mask->bitmap();
+  const Image* maskBitmap = mask->bitmap();
   if (maskBitmap) {
     tx(new cmd::FlipMask(document, m_flipType));
 
@@ -29,6 +29,7 @@
 #include "app/ui/editor/select_box_state.h"
 #include "app/ui/editor/standby_state.h"
 #include "app/ui/workspace.h"
+#include "app/util/parallel_tasks.h"
 #include "doc/cel.h"
 #include "doc/image.h"
 #include "doc/layer.h"
@@ -40,6 +41,12 @@
 
 #include "import_sprite_sheet.xml.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 namespace app {
 
 using namespace ui;
@@ -496,19 +503,47 @@ void ImportSpriteSheetCommand::onExecute(Context* context)
         break;
     }
 
-    // As first step, we cut each tile and add them into "animation" list.
-    for (const auto& tileRect : tileRects) {
-      ImageRef resultImage(
-        Image::create(
-          sprite->pixelFormat(), tileRect.w, tileRect.h));
-
-      // Render the portion of sheet.
-      render.renderSprite(
-        resultImage.get(), sprite, currentFrame,
-        gfx::Clip(0, 0, tileRect));
-
-      animation.push_back(resultImage);
+    // As first step, we render the whole sheet once, and then we cut
+    // each tile (in parallel) and add them into "animation" list.
+    ImageRef sheetImage(Image::create(sprite->spec()));
+    sheetImage->clear(sprite->transparentColor());
+    render.renderSprite(sheetImage.get(), sprite, currentFrame);
+
+    const int ntiles = int(tileRects.size());
+    animation.resize(ntiles);
+
+    // Empty tiles (which don't need a cel) and a hash of each tile to
+    // find duplicated tiles (which are linked to the first one)
+    std::vector<bool> emptyTiles(ntiles, false);
+    std::vector<uint64_t> tileHashes(ntiles, 0);
+    {
+      const int ntasks = std::clamp<int>(std::thread::hardware_concurrency(),
+                                         1, std::max(1, ntiles));
+      std::atomic<int> next(0);
+
+      run_parallel_tasks(
+        ntasks,
+        [&](const std::atomic<bool>& stop){
+          while (!stop) {
+            const int i = next++;
+            if (i >= ntiles)
+              break;
+
+            const gfx::Rect& tileRect = tileRects[i];
+            animation[i].reset(
+              crop_image(sheetImage.get(), tileRect,
+                         sprite->transparentColor()));
+
+            if (is_empty_image(animation[i].get()))
+              emptyTiles[i] = true;
+            else
+              tileHashes[i] = calculate_image_hash64(
+                animation[i].get(), animation[i]->bounds());
+          }
+        },
+        []{ return true; });
     }
+    sheetImage.reset();
 
     if (animation.size() == 0) {
       Alert::show(Strings::alerts_empty_rect_importing_sprite_sheet());
@@ -527,13 +562,31 @@ void ImportSpriteSheetCommand::onExecute(Context* context)
     LayerImage* resultLayer =
       api.newLayer(sprite->root(), Strings::import_sprite_sheet_layer_name());
 
-    // Add all frames+cels to the new layer
+    // Add all frames+cels to the new layer (empty tiles don't get a
+    // cel, and duplicated tiles are linked to the first one)
+    std::unordered_map<uint64_t, std::vector<Cel*>> celsByHash;
     for (size_t i=0; i<animation.size(); ++i) {
+      if (emptyTiles[i])
+        continue;
+
+      Cel* originalCel = nullptr;
+      auto& sameHashCels = celsByHash[tileHashes[i]];
+      for (Cel* cel : sameHashCels) {
+        if (is_same_image(cel->image(), animation[i].get())) {
+          originalCel = cel;
+          break;
+        }
+      }
+
       // Create the cel.
-      std::unique_ptr<Cel> resultCel(new Cel(frame_t(i), animation[i]));
+      std::unique_ptr<Cel> resultCel(
+        originalCel ? Cel::MakeLink(frame_t(i), originalCel):
+                      new Cel(frame_t(i), animation[i]));
 
       // Add the cel in the layer.
       api.addCel(resultLayer, resultCel.get());
+      if (!originalCel)
+        sameHashCels.push_back(resultCel.get());
       resultCel.release();
     }
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -70,7 +70,7 @@ void InvertMaskCommand::onExecute(Context* context)
 
     // Remove in the new mask the current sprite marked region
     const gfx::Rect& maskBounds = document->mask()->bounds();
-    doc::fill_rect(mask->bitmap(),
+    doc::fill_rect(mask->editableBitmap(),
       maskBounds.x, maskBounds.y,
       maskBounds.x + maskBounds.w-1,
       maskBounds.y + maskBounds.h-1, 0);
@@ -81,7 +81,7 @@ void InvertMaskCommand::onExecute(Context* context)
       // document's mask temporaly here)
       curMask->freeze();
       curMask->invert();
-      doc::copy_image(mask->bitmap(),
+      doc::copy_image(mask->editableBitmap(),
         curMask->bitmap(),
         curMask->bounds().x,
         curMask->bounds().y);
@@ -69,6 +69,7 @@ void LayerOpacityCommand::onExecute(Context* context)
 
   {
     Tx tx(writer, "Set Layer Opacity");
+    tx.batchNotifications();
 
     // TODO the range of selected frames should be in app::Site.
     SelectedLayers selLayers;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2023  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -332,6 +332,12 @@ private:
   }
 
   // DocObserver impl
+  // Notifications coalesced by Doc::endBatchNotifications()
+  void onGeneralUpdate(DocEvent& ev) override {
+    if (m_layer)
+      updateFromLayer();
+  }
+
   void onLayerNameChange(DocEvent& ev) override {
     if (m_layer == ev.layer())
       updateFromLayer();
@@ -79,6 +79,11 @@ private:
   Slider* m_sliderTolerance = nullptr;
   SelModeField* m_selMode = nullptr;
   bool m_isOrigMaskVisible;
+
+  // Distance of each pixel to the selected color, so the mask can be
+  // re-generated quickly when only the tolerance is changed
+  doc::ImageRef m_distanceMap;
+  int m_distanceMapColor = 0;
 };
 
 MaskByColorCommand::MaskByColorCommand()
@@ -108,6 +113,8 @@ void MaskByColorCommand::onExecute(Context* context)
   if (!image)
     return;
 
+  m_distanceMap.reset();
+
   std::unique_ptr<Window> win(
     new Window(Window::WithTitleBar, Strings::mask_by_color_title()));
   base::ScopedValue<Window*> setWindow(m_window, win.get(), nullptr);
@@ -207,6 +214,8 @@ void MaskByColorCommand::onExecute(Context* context)
 
   // Save window configuration.
   save_window_pos(m_window, ConfigSection);
+
+  m_distanceMap.reset();
 }
 
 Mask* MaskByColorCommand::generateMask(const Mask& origMask,
@@ -219,8 +228,15 @@ Mask* MaskByColorCommand::generateMask(const Mask& origMask,
                                            sprite->pixelFormat());
   int tolerance = m_sliderTolerance->getValue();
 
+  // The image cannot change while the dialog is open, so the distance
+  // map is valid while the color is the same
+  if (!m_distanceMap || m_distanceMapColor != color) {
+    m_distanceMap = Mask::createColorDistanceMap(image, color);
+    m_distanceMapColor = color;
+  }
+
   std::unique_ptr<Mask> mask(new Mask());
-  mask->byColor(image, color, tolerance);
+  mask->byColorDistance(m_distanceMap.get(), tolerance);
   mask->offsetOrigin(xpos, ypos);
 
   if (!origMask.isEmpty() && m_isOrigMaskVisible) {
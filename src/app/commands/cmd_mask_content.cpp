@@ -74,7 +74,8 @@ void MaskContentCommand::onExecute(Context* context)
 
     Mask newMask;
     gfx::Rect imgBounds = cel->image()->bounds();
-    if (algorithm::shrink_cel_bounds(cel, color, imgBounds)) {
+    if (algorithm::shrink_cel_bounds(cel, color, imgBounds,
+                                     true)) { // Use cached bounds
       newMask.replace(imgBounds);
     }
     else {
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,7 @@
 
 #include "app/app.h"
 #include "app/cmd/add_cel.h"
+#include "app/cmd/remove_cel.h"
 #include "app/cmd/replace_image.h"
 #include "app/cmd/set_cel_position.h"
 #include "app/cmd/unlink_cel.h"
@@ -20,6 +21,7 @@
 #include "app/doc_api.h"
 #include "app/modules/gui.h"
 #include "app/tx.h"
+#include "app/util/parallel_tasks.h"
 #include "doc/blend_internals.h"
 #include "doc/cel.h"
 #include "doc/image.h"
@@ -29,6 +31,13 @@
 #include "render/rasterize.h"
 #include "ui/ui.h"
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <thread>
+#include <utility>
+#include <vector>
+
 namespace app {
 
 class MergeDownLayerCommand : public Command {
@@ -81,79 +90,154 @@ void MergeDownLayerCommand::onExecute(Context* context)
 
   Tx tx(writer, friendlyName(), ModifyDocument);
 
+  // Each pair of source/destination cel data is merged just once
+  // (e.g. when both layers have linked cels in the same frames), so
+  // we group the frames by these pairs.
+  struct Merge {
+    Cel* srcCel;
+    Cel* dstCel;                // Can be nullptr (no destination cel)
+    std::vector<frame_t> frames;
+    gfx::Rect bounds;
+    ImageRef newImage;
+  };
+  std::vector<Merge> merges;
+  std::map<std::pair<const CelData*, const CelData*>, int> mergeIndex;
+  std::map<const CelData*, int> dstDataCels;
+
   for (frame_t frpos = 0; frpos<sprite->totalFrames(); ++frpos) {
-    // Get frames
     Cel* src_cel = src_layer->cel(frpos);
     Cel* dst_cel = dst_layer->cel(frpos);
+    if (dst_cel)
+      ++dstDataCels[dst_cel->data()];
 
-    // Get images
-    Image* src_image;
-    if (src_cel != NULL)
-      src_image = src_cel->image();
-    else
-      src_image = NULL;
+    // Without source image there is nothing to merge
+    if (!src_cel || !src_cel->image())
+      continue;
 
-    ImageRef dst_image;
-    if (dst_cel)
-      dst_image = dst_cel->imageRef();
+    const std::pair<const CelData*, const CelData*> key(
+      src_cel->data(), (dst_cel ? dst_cel->data(): nullptr));
+    auto it = mergeIndex.find(key);
+    if (it != mergeIndex.end()) {
+      merges[it->second].frames.push_back(frpos);
+    }
+    else {
+      mergeIndex[key] = int(merges.size());
+      merges.push_back(Merge{ src_cel, dst_cel, { frpos } });
+    }
+  }
 
-    // With source image?
-    if (src_image) {
+  const doc::color_t bgcolor = app_get_color_to_clear_layer(dst_layer);
+
+  // Merge the images in parallel (this only reads the sprite, the
+  // document is modified later from this thread)
+  {
+    const int nmerges = int(merges.size());
+    const int ntasks = std::clamp<int>(std::thread::hardware_concurrency(),
+                                       1, std::max(1, nmerges));
+    std::atomic<int> next(0);
+
+    run_parallel_tasks(
+      ntasks,
+      [&](const std::atomic<bool>& stop){
+        while (!stop) {
+          const int i = next++;
+          if (i >= nmerges)
+            break;
+
+          Merge& merge = merges[i];
+          const Cel* src_cel = merge.srcCel;
+          const Cel* dst_cel = merge.dstCel;
+
+          // No destination image, creating a copy of the image
+          if (!dst_cel) {
+            merge.newImage.reset(
+              render::rasterize_with_cel_bounds(src_cel));
+            continue;
+          }
+
+          // Merge down in the background layer
+          if (dst_layer->isBackground()) {
+            merge.bounds = sprite->bounds();
+          }
+          // Merge down in a transparent layer
+          else {
+            merge.bounds = src_cel->bounds().createUnion(dst_cel->bounds());
+          }
+
+          const gfx::Rect& bounds = merge.bounds;
+          merge.newImage.reset(doc::crop_image(
+              dst_cel->image(),
+              bounds.x-dst_cel->x(),
+              bounds.y-dst_cel->y(),
+              bounds.w, bounds.h, bgcolor));
+
+          // Draw src_cel on new_image
+          render::rasterize(
+            merge.newImage.get(), src_cel,
+            -bounds.x, -bounds.y, false);
+        }
+      },
+      []{ return true; });
+  }
+
+  for (Merge& merge : merges) {
+    Cel* src_cel = merge.srcCel;
+    Cel* dst_cel = merge.dstCel;
+
+    // No destination image
+    if (!dst_cel) {  // Only a transparent layer can have a null cel
       int t;
       int opacity;
       opacity = MUL_UN8(src_cel->opacity(), src_layer->opacity(), t);
 
-      // No destination image
-      if (!dst_image) {  // Only a transparent layer can have a null cel
-        // Copy this cel to the destination layer...
-
-        // Creating a copy of the image
-        dst_image.reset(
-          render::rasterize_with_cel_bounds(src_cel));
-
-        // Creating a copy of the cell
-        dst_cel = new Cel(frpos, dst_image);
-        dst_cel->setPosition(src_cel->x(), src_cel->y());
-        dst_cel->setOpacity(opacity);
+      // Creating a copy of the cell (and links to it in the other
+      // frames)
+      Cel* first_cel = nullptr;
+      for (frame_t frpos : merge.frames) {
+        if (!first_cel) {
+          dst_cel = new Cel(frpos, merge.newImage);
+          dst_cel->setPosition(src_cel->x(), src_cel->y());
+          dst_cel->setOpacity(opacity);
+          first_cel = dst_cel;
+        }
+        else
+          dst_cel = Cel::MakeLink(frpos, first_cel);
 
         tx(new cmd::AddCel(dst_layer, dst_cel));
       }
-      // With destination
-      else {
-        gfx::Rect bounds;
+      continue;
+    }
 
-        // Merge down in the background layer
-        if (dst_layer->isBackground()) {
-          bounds = sprite->bounds();
-        }
-        // Merge down in a transparent layer
-        else {
-          bounds = src_cel->bounds().createUnion(dst_cel->bounds());
-        }
+    // If all the cels linked to dst_cel are in this merge, we can
+    // modify the shared cel data directly
+    int& dstCels = dstDataCels[dst_cel->data()];
+    const bool allLinks = (dstCels == int(merge.frames.size()));
+    dstCels -= int(merge.frames.size());
 
-        doc::color_t bgcolor = app_get_color_to_clear_layer(dst_layer);
+    // First unlink the dst_cel
+    if (!allLinks)
+      tx(new cmd::UnlinkCel(dst_cel));
 
-        ImageRef new_image(doc::crop_image(
-            dst_image.get(),
-            bounds.x-dst_cel->x(),
-            bounds.y-dst_cel->y(),
-            bounds.w, bounds.h, bgcolor));
+    // Then modify the dst_cel
+    tx(new cmd::SetCelPosition(dst_cel,
+        merge.bounds.x, merge.bounds.y));
 
-        // Draw src_cel on new_image
-        render::rasterize(
-          new_image.get(), src_cel,
-          -bounds.x, -bounds.y, false);
+    tx(new cmd::ReplaceImage(sprite,
+        dst_cel->imageRef(), merge.newImage));
 
-        // First unlink the dst_cel
-        if (dst_cel->links())
-          tx(new cmd::UnlinkCel(dst_cel));
+    // Link the cels of other frames with the same result to dst_cel
+    if (!allLinks) {
+      for (int i=1; i<int(merge.frames.size()); ++i) {
+        const frame_t frpos = merge.frames[i];
+        Cel* old_cel = dst_layer->cel(frpos);
+        ASSERT(old_cel);
+        const int zIndex = old_cel->zIndex();
 
-        // Then modify the dst_cel
-        tx(new cmd::SetCelPosition(dst_cel,
-            bounds.x, bounds.y));
+        tx(new cmd::RemoveCel(old_cel));
 
-        tx(new cmd::ReplaceImage(sprite,
-            dst_cel->imageRef(), new_image));
+        Cel* link = Cel::MakeLink(frpos, dst_cel);
+        link->setZIndex(zIndex);
+        tx(new cmd::AddCel(dst_layer, link));
       }
     }
   }
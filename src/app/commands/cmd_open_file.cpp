@@ -28,50 +28,89 @@
 #include "base/fs.h"
 #include "base/thread.h"
 #include "doc/sprite.h"
+#include "doc/task_scheduler.h"
 #include "ui/ui.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <memory>
+#include <vector>
 
 namespace app {
 
-class OpenFileJob : public Job, public IFileOpProgress {
+// Loads a group of files in parallel (one task for each file).
+class OpenFileJob : public Job {
 public:
-  OpenFileJob(FileOp* fop, const bool showProgress)
+  OpenFileJob(const std::vector<FileOp*>& fops, const bool showProgress)
     : Job(Strings::open_file_loading(), showProgress)
-    , m_fop(fop)
+    , m_fops(fops)
+    , m_progress(fops.size())
   {
+    for (auto& p : m_progress)
+      p.job = this;
   }
 
   void showProgressWindow() {
     startJob();
 
-    if (isCanceled())
-      m_fop->stop();
+    if (isCanceled()) {
+      for (FileOp* fop : m_fops)
+        fop->stop();
+    }
 
     waitJob();
   }
 
 private:
-  // Thread to do the hard work: load the file from the disk.
+  // Progress of each file (we cannot ask the FileOp::progress()
+  // inside ackFileOpProgress() because the FileOp is locked).
+  struct FileProgress : public IFileOpProgress {
+    OpenFileJob* job = nullptr;
+    std::atomic<double> value { 0.0 };
+
+    void ackFileOpProgress(double progress) override {
+      value = progress;
+      job->updateProgress();
+    }
+  };
+
+  // Thread to do the hard work: load the files from the disk.
   virtual void onJob() override {
+    if (m_fops.size() == 1) {
+      loadFile(m_fops[0], m_progress[0]);
+      return;
+    }
+
+    doc::TaskGroup tasks(doc::TaskPriority::High);
+    for (size_t i=0; i<m_fops.size(); ++i)
+      tasks.run([this, i]{ loadFile(m_fops[i], m_progress[i]); });
+    tasks.wait();
+  }
+
+  void loadFile(FileOp* fop, FileProgress& progress) {
     try {
-      m_fop->operate(this);
+      fop->operate(&progress);
     }
     catch (const std::exception& e) {
-      m_fop->setError("Error loading file:\n%s", e.what());
+      fop->setError("Error loading file:\n%s", e.what());
     }
 
-    if (m_fop->isStop() && m_fop->document())
-      delete m_fop->releaseDocument();
+    if (fop->isStop() && fop->document())
+      delete fop->releaseDocument();
 
-    m_fop->done();
+    fop->done();
   }
 
-  virtual void ackFileOpProgress(double progress) override {
-    jobProgress(progress);
+  void updateProgress() {
+    double sum = 0.0;
+    for (const auto& p : m_progress)
+      sum += p.value;
+    jobProgress(sum / m_fops.size());
   }
 
-  FileOp* m_fop;
+  std::vector<FileOp*> m_fops;
+  std::vector<FileProgress> m_progress;
 };
 
 OpenFileCommand::OpenFileCommand()
@@ -79,6 +118,7 @@ OpenFileCommand::OpenFileCommand()
   , m_ui(true)
   , m_repeatCheckbox(false)
   , m_oneFrame(false)
+  , m_metadataOnly(false)
   , m_seqDecision(gen::SequenceDecision::ASK)
 {
 }
@@ -95,6 +135,7 @@ void OpenFileCommand::onLoadParams(const Params& params)
 
   m_repeatCheckbox = params.get_as<bool>("repeat_checkbox");
   m_oneFrame = params.get_as<bool>("oneframe");
+  m_metadataOnly = params.get_as<bool>("metadata_only");
 
   std::string sequence = params.get("sequence");
   if (m_oneFrame ||
@@ -146,7 +187,11 @@ void OpenFileCommand::onExecute(Context* context)
 #endif // ENABLE_UI
   if (!m_filename.empty()) {
     filenames.push_back(m_filename);
+    filenames.insert(filenames.end(),
+                     m_extraFilenames.begin(),
+                     m_extraFilenames.end());
   }
+  m_extraFilenames.clear();
 
   if (filenames.empty())
     return;
@@ -182,25 +227,45 @@ void OpenFileCommand::onExecute(Context* context)
   if (m_oneFrame)
     flags |= FILE_LOAD_ONE_FRAME;
 
-  std::string filename;
+  if (m_metadataOnly)
+    flags |= FILE_LOAD_METADATA_ONLY;
+
+  // Files are loaded in groups of one file per worker thread (so
+  // we don't keep all the documents in memory before showing the
+  // first ones), and the documents of each group are added to the
+  // context in the given order when the whole group is loaded.
+  const size_t maxGroupSize = std::max(1, doc::task_scheduler_threads());
+
   while (!filenames.empty()) {
-    filename = filenames[0];
-    filenames.erase(filenames.begin());
+    std::vector<std::unique_ptr<FileOp>> fops;
+    bool canceled = false;
+
+    // The FileOps are created in this thread because we might need
+    // to ask the user if they want to open a sequence of files.
+    while (!filenames.empty() && fops.size() < maxGroupSize) {
+      const std::string filename = filenames[0];
+      filenames.erase(filenames.begin());
+
+      std::unique_ptr<FileOp> fop(
+        FileOp::createLoadDocumentOperation(
+          context, filename, flags));
+
+      // Do nothing (the user cancelled or something like that)
+      if (!fop) {
+        canceled = true;
+        break;
+      }
 
-    std::unique_ptr<FileOp> fop(
-      FileOp::createLoadDocumentOperation(
-        context, filename, flags));
-    bool unrecent = false;
+      if (fop->hasError()) {
+        console.printf(fop->error().c_str());
 
-    // Do nothing (the user cancelled or something like that)
-    if (!fop)
-      return;
+        // The file was not found, so we can remove it from the
+        // recent-file list
+        if (context->isUIAvailable())
+          App::instance()->recentFiles()->removeRecentFile(filename);
+        continue;
+      }
 
-    if (fop->hasError()) {
-      console.printf(fop->error().c_str());
-      unrecent = true;
-    }
-    else {
       if (fop->isSequence()) {
         if (fop->sequenceFlags() & FILE_LOAD_SEQUENCE_YES) {
           m_seqDecision = gen::SequenceDecision::YES;
@@ -227,9 +292,19 @@ void OpenFileCommand::onExecute(Context* context)
         m_usedFiles.push_back(fn);
       }
 
-      OpenFileJob task(fop.get(), m_ui);
+      fops.push_back(std::move(fop));
+    }
+
+    if (!fops.empty()) {
+      std::vector<FileOp*> group;
+      for (auto& fop : fops)
+        group.push_back(fop.get());
+
+      OpenFileJob task(group, m_ui);
       task.showProgressWindow();
+    }
 
+    for (auto& fop : fops) {
       // Post-load processing, it is called from the GUI because may require user intervention.
       fop->postLoad();
 
@@ -259,16 +334,16 @@ void OpenFileCommand::onExecute(Context* context)
 
         doc->setContext(context);
       }
-      else if (!fop->isStop())
-        unrecent = true;
+      // The file was loaded with errors, so we can remove it from
+      // the recent-file list
+      else if (!fop->isStop()) {
+        if (context->isUIAvailable())
+          App::instance()->recentFiles()->removeRecentFile(fop->filename());
+      }
     }
 
-    // The file was not found or was loaded loaded with errors,
-    // so we can remove it from the recent-file list
-    if (unrecent) {
-      if (context->isUIAvailable())
-        App::instance()->recentFiles()->removeRecentFile(m_filename);
-    }
+    if (canceled)
+      return;
   }
 }
 
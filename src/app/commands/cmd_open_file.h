@@ -29,6 +29,13 @@ namespace app {
       return m_seqDecision;
     }
 
+    // Other files to open in the next execution of the command
+    // (after the "filename" param), so all of them can be loaded in
+    // parallel.
+    void setExtraFilenames(const base::paths& filenames) {
+      m_extraFilenames = filenames;
+    }
+
   protected:
     void onLoadParams(const Params& params) override;
     void onExecute(Context* context) override;
@@ -36,9 +43,11 @@ namespace app {
   private:
     std::string m_filename;
     std::string m_folder;
+    base::paths m_extraFilenames;
     bool m_ui;
     bool m_repeatCheckbox;
     bool m_oneFrame;
+    bool m_metadataOnly;
     base::paths m_usedFiles;
     gen::SequenceDecision m_seqDecision;
   };
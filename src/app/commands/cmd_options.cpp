@@ -592,6 +592,10 @@ public:
     limitUndo()->setSelected(m_pref.undo.sizeLimit() != 0);
     onLimitUndoCheck();
 
+    spillUndo()->Click.connect([this]{ onSpillUndoCheck(); });
+    spillUndo()->setSelected(m_pref.undo.memoryBudget() != 0);
+    onSpillUndoCheck();
+
     undoGotoModified()->setSelected(m_pref.undo.gotoModified());
     undoAllowNonlinearHistory()->setSelected(m_pref.undo.allowNonlinearHistory());
 
@@ -809,6 +813,13 @@ public:
     undo_size_limit_value = std::clamp(undo_size_limit_value, 0, 999999);
 
     m_pref.undo.sizeLimit(undo_size_limit_value);
+
+    int undo_memory_budget_value = 0;
+    if (spillUndo()->isSelected()) {
+      undo_memory_budget_value = undoMemoryBudget()->textInt();
+      undo_memory_budget_value = std::clamp(undo_memory_budget_value, 0, 999999);
+    }
+    m_pref.undo.memoryBudget(undo_memory_budget_value);
     m_pref.undo.gotoModified(undoGotoModified()->isSelected());
     m_pref.undo.allowNonlinearHistory(undoAllowNonlinearHistory()->isSelected());
 
@@ -1292,6 +1303,17 @@ private:
     }
   }
 
+  void onSpillUndoCheck() {
+    if (spillUndo()->isSelected()) {
+      undoMemoryBudget()->setEnabled(true);
+      undoMemoryBudget()->setTextf("%d", m_pref.undo.memoryBudget());
+    }
+    else {
+      undoMemoryBudget()->setEnabled(false);
+      undoMemoryBudget()->setText(kInfiniteSymbol);
+    }
+  }
+
   void refillLanguages() {
     language()->deleteAllItems();
     loadLanguages();
@@ -0,0 +1,103 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/commands/command.h"
+#include "app/context.h"
+#include "app/file_selector.h"
+#include "app/i18n/strings.h"
+#include "app/perf_trace.h"
+#include "ui/alert.h"
+#include "ui/manager.h"
+
+namespace app {
+
+class PerformanceHudCommand : public Command {
+public:
+  PerformanceHudCommand();
+
+protected:
+  bool onChecked(Context* context) override;
+  void onExecute(Context* context) override;
+};
+
+PerformanceHudCommand::PerformanceHudCommand()
+  : Command(CommandId::PerformanceHud(), CmdUIOnlyFlag)
+{
+}
+
+bool PerformanceHudCommand::onChecked(Context* context)
+{
+  return is_perf_hud_enabled();
+}
+
+void PerformanceHudCommand::onExecute(Context* context)
+{
+  const bool state = !is_perf_hud_enabled();
+  if (state)
+    reset_perf_stats();
+  set_perf_hud_enabled(state);
+
+  // Show/hide the HUD in all editors
+  if (auto manager = ui::Manager::getDefault())
+    manager->invalidate();
+}
+
+class RecordPerformanceTraceCommand : public Command {
+public:
+  RecordPerformanceTraceCommand();
+
+protected:
+  bool onChecked(Context* context) override;
+  void onExecute(Context* context) override;
+};
+
+RecordPerformanceTraceCommand::RecordPerformanceTraceCommand()
+  : Command(CommandId::RecordPerformanceTrace(), CmdUIOnlyFlag)
+{
+}
+
+bool RecordPerformanceTraceCommand::onChecked(Context* context)
+{
+  return is_perf_trace_recording();
+}
+
+void RecordPerformanceTraceCommand::onExecute(Context* context)
+{
+  if (!is_perf_trace_recording()) {
+    start_perf_trace();
+    return;
+  }
+
+  stop_perf_trace();
+
+  base::paths exts = { "json" };
+  base::paths selFilename;
+  if (!app::show_file_selector(Strings::performance_trace_title(),
+                               "trace.json",
+                               exts,
+                               FileSelectorType::Save, selFilename))
+    return;
+
+  const std::string filename = selFilename.front();
+  if (!save_perf_trace(filename))
+    ui::Alert::show(Strings::alerts_error_saving_file(filename));
+}
+
+Command* CommandFactory::createPerformanceHudCommand()
+{
+  return new PerformanceHudCommand;
+}
+
+Command* CommandFactory::createRecordPerformanceTraceCommand()
+{
+  return new RecordPerformanceTraceCommand;
+}
+
+} // namespace app
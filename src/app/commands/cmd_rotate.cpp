@@ -25,6 +25,7 @@
 #include "app/ui/status_bar.h"
 #include "app/ui/timeline/timeline.h"
 #include "app/ui/toolbar.h"
+#include "app/util/parallel_tasks.h"
 #include "app/util/range_utils.h"
 #include "base/convert_to.h"
 #include "doc/cel.h"
@@ -34,6 +35,11 @@
 #include "doc/sprite.h"
 #include "ui/ui.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
 namespace app {
 
 class RotateJob : public SpriteJob {
@@ -103,26 +109,47 @@ protected:
       }
     }
 
-    // 2) Rotate images
-    int i = 0;
-    for (Cel* cel : m_cels) {
-      Image* image = cel->image();
-      if (image) {
-        ImageRef new_image(Image::create(image->pixelFormat(),
-            m_angle == 180 ? image->width(): image->height(),
-            m_angle == 180 ? image->height(): image->width()));
-        new_image->setMaskColor(image->maskColor());
-
-        doc::rotate_image(image, new_image.get(), m_angle);
-        api.replaceImage(sprite(), cel->imageRef(), new_image);
-      }
-
-      jobProgress((float)i / m_cels.size());
-      ++i;
-
-      // cancel all the operation?
-      if (isCanceled())
-        return;        // Tx destructor will undo all operations
+    // 2) Rotate images (in parallel, the images are replaced later
+    // in the same order as the cels)
+    const int ncels = int(m_cels.size());
+    std::vector<ImageRef> newImages(ncels);
+    std::atomic<int> nextCel(0);
+    std::atomic<int> celsDone(0);
+
+    run_parallel_tasks(
+      std::clamp<int>(std::thread::hardware_concurrency(), 1, std::max(1, ncels)),
+      [&](const std::atomic<bool>& stop){
+        while (!stop) {
+          const int i = nextCel++;
+          if (i >= ncels)
+            break;
+
+          const Image* image = m_cels[i]->image();
+          if (image) {
+            ImageRef new_image(Image::create(image->pixelFormat(),
+                m_angle == 180 ? image->width(): image->height(),
+                m_angle == 180 ? image->height(): image->width()));
+            new_image->setMaskColor(image->maskColor());
+
+            doc::rotate_image(image, new_image.get(), m_angle);
+            newImages[i] = new_image;
+          }
+          ++celsDone;
+        }
+      },
+      [&]{
+        if (ncels > 0)
+          jobProgress(float(celsDone) / ncels);
+        return !isCanceled();
+      });
+
+    // cancel all the operation?
+    if (isCanceled())
+      return;        // Tx destructor will undo all operations
+
+    for (int i=0; i<ncels; ++i) {
+      if (newImages[i])
+        api.replaceImage(sprite(), m_cels[i]->imageRef(), newImages[i]);
     }
 
     // rotate mask
@@ -152,7 +179,7 @@ protected:
         gfx::Rect(x, y,
           m_angle == 180 ? origBounds.w: origBounds.h,
           m_angle == 180 ? origBounds.h: origBounds.w));
-      doc::rotate_image(origMask->bitmap(), new_mask->bitmap(), m_angle);
+      doc::rotate_image(origMask->bitmap(), new_mask->editableBitmap(), m_angle);
 
       // Copy new mask
       api.copyToCurrentMask(new_mask.get());
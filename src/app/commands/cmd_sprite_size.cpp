@@ -21,6 +21,7 @@
 #include "app/modules/gui.h"
 #include "app/modules/palettes.h"
 #include "app/sprite_job.h"
+#include "app/util/parallel_tasks.h"
 #include "app/util/resize_image.h"
 #include "base/convert_to.h"
 #include "doc/algorithm/resize_image.h"
@@ -30,7 +31,9 @@
 #include "doc/layer.h"
 #include "doc/layer_tilemap.h"
 #include "doc/mask.h"
+#include "doc/palette.h"
 #include "doc/primitives.h"
+#include "doc/rgbmap.h"
 #include "doc/slice.h"
 #include "doc/sprite.h"
 #include "doc/tilesets.h"
@@ -39,6 +42,10 @@
 #include "sprite_size.xml.h"
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
 
 #define PERC_FORMAT     "%.4g"
 
@@ -105,10 +112,7 @@ protected:
           img_count += tileset->size();
       }
     }
-    for (Cel* cel : sprite()->uniqueCels()) { // TODO add size() member function to CelsRange
-      (void)cel;
-      ++img_count;
-    }
+    img_count += int(sprite()->uniqueCelList()->size());
 
     int progress = 0;
     const gfx::SizeF scale(
@@ -159,7 +163,23 @@ protected:
       }
     }
 
+    // Resize the images of regular cels in parallel (the commands
+    // are added later in the same order as the cels)
+    std::vector<Cel*> cels;
+    for (Cel* cel : sprite()->uniqueCels()) {
+      if (cel->image() && !cel->link() &&
+          !cel->layer()->isTilemap() &&
+          !cel->layer()->isReference()) {
+        cels.push_back(cel);
+      }
+    }
+    std::vector<ImageRef> newImages(cels.size());
+    resizeCelImagesInParallel(cels, scale, newImages, progress, img_count);
+    if (isCanceled())
+      return;        // Tx destructor will undo all operations
+
     // For each cel...
+    std::size_t i = 0;
     for (Cel* cel : sprite()->uniqueCels()) {
       // We need to adjust only the origin/position of tilemap cels
       // (because tiles are resized automatically when we resize the
@@ -176,6 +196,14 @@ protected:
                             canvasSize.h);
         tx(new cmd::SetCelBoundsF(cel, newBounds));
       }
+      else if (i < cels.size() && cels[i] == cel) {
+        resize_cel_image(
+          tx, cel, scale,
+          m_resize_method,
+          gfx::PointF(-cel->bounds().origin()),
+          newImages[i++]);
+        continue;    // Progress already reported
+      }
       else {
         resize_cel_image(
           tx, cel, scale,
@@ -213,7 +241,7 @@ protected:
       // Always use the nearest-neighbor method to resize the bitmap
       // mask.
       algorithm::resize_image(
-        old_bitmap.get(), new_mask->bitmap(),
+        old_bitmap.get(), new_mask->editableBitmap(),
         doc::algorithm::RESIZE_METHOD_NEAREST_NEIGHBOR,
         sprite()->palette(0), // Ignored
         sprite()->rgbMap(0),  // Ignored
@@ -251,6 +279,61 @@ protected:
     api.setSpriteSize(sprite(), m_new_width, m_new_height);
   }
 
+private:
+
+  // Resizes the images of the given cels using several threads
+  // (called from onSpriteJob()).
+  void resizeCelImagesInParallel(const std::vector<Cel*>& cels,
+                                 const gfx::SizeF& scale,
+                                 std::vector<ImageRef>& newImages,
+                                 int& progress,
+                                 const int img_count) {
+    const int ncels = int(cels.size());
+    if (ncels == 0)
+      return;
+
+    const int ntasks =
+      std::clamp<int>(std::thread::hardware_concurrency(), 1, ncels);
+    const bool needsRgbMap =
+      (m_resize_method == ResizeMethod::RESIZE_METHOD_BILINEAR &&
+       sprite()->pixelFormat() == IMAGE_INDEXED);
+    std::atomic<int> nextCel(0);
+    std::atomic<int> celsDone(0);
+
+    run_parallel_tasks(
+      ntasks,
+      [&](const std::atomic<bool>& stop){
+        // Each thread needs its own RgbMap (its cache isn't thread-safe)
+        std::unique_ptr<RgbMap> rgbmap;
+        const Palette* rgbmapPalette = nullptr;
+
+        while (!stop) {
+          const int i = nextCel++;
+          if (i >= ncels)
+            break;
+
+          const Cel* cel = cels[i];
+          if (needsRgbMap &&
+              (!rgbmap || rgbmapPalette != sprite()->palette(cel->frame()))) {
+            rgbmap = sprite()->createRgbMap(cel->frame(),
+                                            sprite()->rgbMapForSprite(),
+                                            Sprite::DefaultRgbMapAlgorithm());
+            rgbmapPalette = sprite()->palette(cel->frame());
+          }
+
+          newImages[i] = create_resized_cel_image(
+            cel, scale, m_resize_method, rgbmap.get());
+          ++celsDone;
+        }
+      },
+      [&]{
+        jobProgress(float(progress + celsDone) / img_count);
+        return !isCanceled();
+      });
+
+    progress += ncels;
+  }
+
 };
 
 #ifdef ENABLE_UI
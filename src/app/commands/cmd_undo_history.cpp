@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2022  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2015-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -23,6 +23,7 @@
 #include "app/docs_observer.h"
 #include "app/modules/gui.h"
 #include "app/modules/palettes.h"
+#include "app/pref/preferences.h"
 #include "app/site.h"
 #include "app/ui/skin/skin_theme.h"
 #include "app/ui/workspace.h"
@@ -299,12 +300,15 @@ public:
                    const undo::UndoState* state,
                    const gfx::Rect& itemBounds,
                    const bool selected) {
-      const std::string itemText =
-        (state ? static_cast<Cmd*>(state->cmd())->label()
-#if _DEBUG
-         + std::string(" ") + base::get_pretty_memory_size(static_cast<Cmd*>(state->cmd())->memSize())
-#endif
-         : std::string("Initial State"));
+      std::string itemText;
+      if (state) {
+        auto cmd = static_cast<const CmdTransaction*>(state->cmd());
+        itemText = cmd->label();
+        if (Preferences::instance().undo.showStats())
+          itemText += " " + statsText(cmd);
+      }
+      else
+        itemText = "Initial State";
 
       if ((g->getClipBounds() & itemBounds).isEmpty())
         return;
@@ -320,6 +324,17 @@ public:
       theme->paintWidgetPart(g, style, itemBounds, info);
     }
 
+    static std::string statsText(const CmdTransaction* cmd) {
+      std::string text =
+        fmt::format("({}, {:.0f} ms",
+                    base::get_pretty_memory_size(cmd->memSize()),
+                    1000.0 * cmd->executionTime());
+      if (cmd->undoTime() > 0.0)
+        text += fmt::format(", undo {:.0f} ms", 1000.0 * cmd->undoTime());
+      text.push_back(')');
+      return text;
+    }
+
     UndoHistoryWindow* m_window;
     Doc* m_doc = nullptr;
     DocUndo* m_undoHistory = nullptr;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -28,6 +28,7 @@
 #include "app/ui/timeline/timeline.h"
 #include "app/ui_context.h"
 #include "app/util/cel_ops.h"
+#include "app/util/parallel_tasks.h"
 #include "app/util/range_utils.h"
 #include "doc/algorithm/shrink_bounds.h"
 #include "doc/cel.h"
@@ -41,15 +42,116 @@
 #include "ui/view.h"
 #include "ui/widget.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <set>
+#include <thread>
 
 namespace app {
 
 using namespace std;
 using namespace ui;
 
+// Number of rows processed by each task when the filter is applied
+// in parallel.
+static constexpr int kRowsPerTask = 16;
+
+#ifdef ENABLE_UI
+// Size of the tiles used to filter the preview progressively.
+static constexpr int kPreviewTileSize = 128;
+#endif
+
+// FilterManager used by each worker thread to apply the filter to a
+// set of rows of the given source/destination images (or by the
+// preview to apply the filter to one tile). It has its own bounds,
+// row and mask iterator, and uses the FilterManagerImpl for
+// everything else (the mask, palette, etc. are shared and read-only
+// while the rows are processed).
+class FilterManagerImpl::RowCursor : public FilterManager {
+public:
+  RowCursor(FilterManagerImpl* mgr,
+            const Image* src, Image* dst,
+            const gfx::Rect& bounds,
+            const Target target)
+    : m_mgr(mgr)
+    , m_src(src)
+    , m_dst(dst)
+    , m_bounds(bounds)
+    , m_target(target)
+    , m_row(0) { }
+
+  void applyRows(const int y1, const int y2) {
+    for (int y=y1; y<y2; ++y)
+      applyRow(y);
+  }
+
+  void applyRow(const int row) {
+    const Mask* mask = m_mgr->m_mask;
+
+    m_row = row;
+    if (mask && mask->bitmap()) {
+      int x = m_bounds.x - mask->bounds().x;
+      int y = m_bounds.y - mask->bounds().y + m_row;
+      if ((x >= mask->bounds().w) ||
+          (y >= mask->bounds().h))
+        return;
+
+      m_maskBits = mask->bitmap()
+        ->lockBits<BitmapTraits>(Image::ReadLock,
+          gfx::Rect(x, y, m_bounds.w, 1));
+
+      m_maskIterator = m_maskBits.begin();
+    }
+
+    switch (pixelFormat()) {
+      case IMAGE_RGB:       m_mgr->m_filter->applyToRgba(this); break;
+      case IMAGE_GRAYSCALE: m_mgr->m_filter->applyToGrayscale(this); break;
+      case IMAGE_INDEXED:   m_mgr->m_filter->applyToIndexed(this); break;
+    }
+
+    m_maskBits.unlock();
+  }
+
+  // FilterManager implementation
+  doc::PixelFormat pixelFormat() const override { return m_mgr->pixelFormat(); }
+  const void* getSourceAddress() override {
+    return m_src->getPixelAddress(m_bounds.x, m_bounds.y+m_row);
+  }
+  void* getDestinationAddress() override {
+    return m_dst->getPixelAddress(m_bounds.x, m_bounds.y+m_row);
+  }
+  int getWidth() override { return m_bounds.w; }
+  Target getTarget() override { return m_target; }
+  FilterIndexedData* getIndexedData() override { return m_mgr; }
+  bool skipPixel() override {
+    bool skip = false;
+    if (m_mgr->m_mask && m_mgr->m_mask->bitmap()) {
+      if (!*m_maskIterator)
+        skip = true;
+      ++m_maskIterator;
+    }
+    return skip;
+  }
+  const doc::Image* getSourceImage() override { return m_src; }
+  int x() const override { return m_bounds.x; }
+  int y() const override { return m_bounds.y+m_row; }
+  bool isFirstRow() const override { return m_row == 0; }
+  bool isMaskActive() const override { return m_mgr->isMaskActive(); }
+  base::task_token& taskToken() const override { return m_mgr->taskToken(); }
+
+private:
+  FilterManagerImpl* m_mgr;
+  const Image* m_src;
+  Image* m_dst;
+  gfx::Rect m_bounds;
+  Target m_target;
+  int m_row;
+  doc::ImageBits<doc::BitmapTraits> m_maskBits;
+  doc::ImageBits<doc::BitmapTraits>::iterator m_maskIterator;
+};
+
 FilterManagerImpl::FilterManagerImpl(Context* context, Filter* filter)
   : m_reader(context)
   , m_site(*const_cast<Site*>(m_reader.site()))
@@ -139,31 +241,110 @@ void FilterManagerImpl::beginForPreview()
     m_previewMask->replace(m_site.sprite()->bounds());
   }
 
-  m_row = m_nextRowToFlush = 0;
+  m_row = -1;
   m_mask = m_previewMask.get();
+  m_previewTiles.clear();
+  m_previewTile = gfx::Rect();
+  m_previewTileRow = m_previewTileFlushedRow = 0;
+  m_previewDirty.clear();
+  m_previewPaletteApplied = false;
+  m_previewPaletteFlushed = false;
 
-  // If we have a tiled mode enabled, we'll apply the filter to the whole areaes
-  Editor* activeEditor = UIContext::instance()->activeEditor();
-  if (activeEditor->docPref().tiled.mode() == filters::TiledMode::NONE) {
-    gfx::Rect vp;
-    for (Editor* editor : UIContext::instance()->getAllEditorsIncludingPreview(document)) {
-      vp |= editor->screenToEditor(
-        View::getView(editor)->viewportBounds());
-    }
-    vp &= m_site.sprite()->bounds();
-    if (vp.isEmpty()) {
-      m_previewMask.reset(nullptr);
-      m_row = -1;
-      return;
+  if (!updateBounds(m_mask)) {
+    m_previewMask.reset(nullptr);
+    return;
+  }
+
+  // Divide the whole area in tiles (aligned to the sprite origin), so
+  // we can filter first the tiles that are visible in the editors and
+  // then the rest of the area.
+  const int x1 = m_bounds.x - (m_bounds.x % kPreviewTileSize);
+  const int y1 = m_bounds.y - (m_bounds.y % kPreviewTileSize);
+  for (int y=y1; y<m_bounds.y2(); y+=kPreviewTileSize) {
+    for (int x=x1; x<m_bounds.x2(); x+=kPreviewTileSize) {
+      gfx::Rect tile(x, y, kPreviewTileSize, kPreviewTileSize);
+      tile &= m_bounds;
+      if (!tile.isEmpty())
+        m_previewTiles.push_back(tile);
     }
-    m_previewMask->intersect(vp);
   }
 
-  if (!updateBounds(m_mask)) {
-    m_previewMask.reset(nullptr);
-    m_row = -1;
+  sortPreviewTiles();
+}
+
+void FilterManagerImpl::updatePreviewViewport()
+{
+  if (!m_previewMask) {
+    beginForPreview();
     return;
   }
+
+  // The tiles that were already filtered are still valid, we only
+  // need to filter the new visible area first.
+  sortPreviewTiles();
+}
+
+bool FilterManagerImpl::applyPreviewStep()
+{
+  if (!m_previewMask)
+    return false;
+
+  if (!m_previewPaletteApplied) {
+    applyToPaletteIfNeeded();
+    m_previewPaletteApplied = true;
+  }
+
+  if (m_previewTile.isEmpty()) {
+    if (m_previewTiles.empty())
+      return false;
+
+    m_previewTile = m_previewTiles.back();
+    m_previewTiles.pop_back();
+    m_previewTileRow = m_previewTileFlushedRow = 0;
+  }
+
+  RowCursor cursor(this, m_src.get(), m_dst.get(), m_previewTile, m_target);
+  cursor.applyRow(m_previewTileRow++);
+
+  // The whole tile is filtered, we can move the unflushed rows to the
+  // dirty region.
+  if (m_previewTileRow >= m_previewTile.h) {
+    m_previewDirty.createUnion(
+      m_previewDirty,
+      gfx::Region(gfx::Rect(m_previewTile.x,
+                            m_previewTile.y+m_previewTileFlushedRow,
+                            m_previewTile.w,
+                            m_previewTile.h-m_previewTileFlushedRow)));
+    m_previewTile = gfx::Rect();
+  }
+  return true;
+}
+
+// Sorts the pending tiles so the ones that are visible in the editors
+// are filtered first (they are placed at the end of the vector), and
+// then the nearest ones to the visible area.
+void FilterManagerImpl::sortPreviewTiles()
+{
+  Doc* document = m_site.document();
+  gfx::Rect vp;
+  for (Editor* editor : UIContext::instance()->getAllEditorsIncludingPreview(document)) {
+    vp |= editor->screenToEditor(
+      View::getView(editor)->viewportBounds());
+  }
+  vp &= m_bounds;
+
+  const gfx::Point center = (vp.isEmpty() ? m_bounds.center(): vp.center());
+  auto priority = [&vp, center](const gfx::Rect& tile) -> int {
+    const gfx::Point d = tile.center() - center;
+    const int dist = std::abs(d.x) + std::abs(d.y);
+    // Visible tiles have the highest priority
+    return (vp.intersects(tile) ? dist: dist + (1 << 24));
+  };
+
+  std::sort(m_previewTiles.begin(), m_previewTiles.end(),
+            [&priority](const gfx::Rect& a, const gfx::Rect& b){
+              return priority(a) > priority(b);
+            });
 }
 
 #endif // ENABLE_UI
@@ -212,55 +393,23 @@ void FilterManagerImpl::apply()
   bool cancelled = false;
 
   begin();
-  while (!cancelled && applyStep()) {
-    if (m_progressDelegate) {
-      // Report progress.
-      m_progressDelegate->reportProgress(m_progressBase + m_progressWidth * (m_row+1) / m_bounds.h);
-
-      // Does the user cancelled the whole process?
-      cancelled = m_progressDelegate->isCancelled();
-    }
+  if (canApplyRowsInParallel()) {
+    cancelled = !applyRowsInParallel();
   }
+  else {
+    while (!cancelled && applyStep()) {
+      if (m_progressDelegate) {
+        // Report progress.
+        m_progressDelegate->reportProgress(m_progressBase + m_progressWidth * (m_row+1) / m_bounds.h);
 
-  if (!cancelled) {
-    gfx::Rect output;
-    if (algorithm::shrink_bounds2(m_src.get(), m_dst.get(),
-                                  m_bounds, output)) {
-      if (m_cel->layer()->isTilemap()) {
-        modify_tilemap_cel_region(
-          *m_tx,
-          m_cel, nullptr,
-          gfx::Region(output),
-          m_site.tilesetMode(),
-          [this](const doc::ImageRef& origTile,
-                 const gfx::Rect& tileBoundsInCanvas) -> doc::ImageRef {
-            return ImageRef(
-              crop_image(m_dst.get(),
-                         tileBoundsInCanvas.x,
-                         tileBoundsInCanvas.y,
-                         tileBoundsInCanvas.w,
-                         tileBoundsInCanvas.h,
-                         m_dst->maskColor()));
-          });
-      }
-      else if (m_cel->layer()->isBackground()) {
-        (*m_tx)(
-          new cmd::CopyRegion(
-            m_cel->image(),
-            m_dst.get(),
-            gfx::Region(output),
-            position()));
-      }
-      else {
-        // Patch "m_cel"
-        (*m_tx)(
-          new cmd::PatchCel(
-            m_cel, m_dst.get(),
-            gfx::Region(output),
-            position()));
+        // Does the user cancelled the whole process?
+        cancelled = m_progressDelegate->isCancelled();
       }
     }
+  }
 
+  if (!cancelled) {
+    commitChangesToCel();
     result = CommandResult(CommandResult::kOk);
   }
   else {
@@ -271,6 +420,196 @@ void FilterManagerImpl::apply()
   m_reader.context()->setCommandResult(result);
 }
 
+// Adds the undoable commands to modify the m_cel image with the
+// modified pixels of m_dst.
+void FilterManagerImpl::commitChangesToCel()
+{
+  gfx::Rect output;
+  if (algorithm::shrink_bounds2(m_src.get(), m_dst.get(),
+                                m_bounds, output)) {
+    if (m_cel->layer()->isTilemap()) {
+      modify_tilemap_cel_region(
+        *m_tx,
+        m_cel, nullptr,
+        gfx::Region(output),
+        m_site.tilesetMode(),
+        [this](const doc::ImageRef& origTile,
+               const gfx::Rect& tileBoundsInCanvas) -> doc::ImageRef {
+          return ImageRef(
+            crop_image(m_dst.get(),
+                       tileBoundsInCanvas.x,
+                       tileBoundsInCanvas.y,
+                       tileBoundsInCanvas.w,
+                       tileBoundsInCanvas.h,
+                       m_dst->maskColor()));
+        });
+    }
+    else if (m_cel->layer()->isBackground()) {
+      (*m_tx)(
+        new cmd::CopyRegion(
+          m_cel->image(),
+          m_dst.get(),
+          gfx::Region(output),
+          position()));
+    }
+    else {
+      // Patch "m_cel"
+      (*m_tx)(
+        new cmd::PatchCel(
+          m_cel, m_dst.get(),
+          gfx::Region(output),
+          position()));
+    }
+  }
+}
+
+bool FilterManagerImpl::canApplyRowsInParallel() const
+{
+  return (m_filter->canApplyRowsInParallel() &&
+          // Indexed filters use the RgbMap, which is regenerated
+          // lazily, so we keep them in one thread.
+          pixelFormat() != IMAGE_INDEXED &&
+          m_bounds.h >= 2*kRowsPerTask &&
+          std::thread::hardware_concurrency() >= 2);
+}
+
+// Applies the filter to all rows using several threads. Returns false
+// if the process was canceled by the user.
+bool FilterManagerImpl::applyRowsInParallel()
+{
+  // The palette is processed in this thread (it's the first step of
+  // applyStep()). We create the copy of the original palette (if
+  // it's needed) before the worker threads access it through
+  // getNewPalette().
+  applyToPaletteIfNeeded();
+  getNewPalette();
+
+  const int rows = m_bounds.h;
+  const int ntasks = std::min<int>(std::thread::hardware_concurrency(),
+                                   (rows + kRowsPerTask - 1) / kRowsPerTask);
+  std::atomic<int> nextRow(0);
+  std::atomic<int> rowsDone(0);
+  bool cancelled = false;
+
+  run_parallel_tasks(
+    ntasks,
+    [this, rows, &nextRow, &rowsDone](const std::atomic<bool>& stop){
+      RowCursor cursor(this, m_src.get(), m_dst.get(), m_bounds, m_target);
+      while (!stop) {
+        const int row = nextRow.fetch_add(kRowsPerTask);
+        if (row >= rows)
+          break;
+
+        const int end = std::min(row + kRowsPerTask, rows);
+        cursor.applyRows(row, end);
+        rowsDone += (end - row);
+      }
+    },
+    [this, rows, &rowsDone, &cancelled]{
+      if (m_progressDelegate) {
+        m_progressDelegate->reportProgress(
+          m_progressBase + m_progressWidth * rowsDone / rows);
+        cancelled = m_progressDelegate->isCancelled();
+      }
+      return !cancelled;
+    });
+
+  m_row = rows;
+  return !cancelled;
+}
+
+bool FilterManagerImpl::canApplyToCelsInParallel(const int ncels) const
+{
+  return (m_filter->canApplyRowsInParallel() &&
+          pixelFormat() != IMAGE_INDEXED &&
+          ncels >= 2 &&
+          std::thread::hardware_concurrency() >= 2);
+}
+
+// Applies the filter to several cels at the same time (each cel is
+// processed completely by one worker thread). The undoable changes
+// are added to the transaction in the original order of the cels
+// from this thread. Returns false if the user canceled the process.
+bool FilterManagerImpl::applyToCelsInParallel(const CelList& cels)
+{
+  getNewPalette();
+
+  struct CelJob {
+    Cel* cel;
+    ImageRef src, dst;
+  };
+
+  // We process the cels in batches to avoid keeping a copy of all
+  // images in memory.
+  const int nthreads = std::thread::hardware_concurrency();
+  const int batchSize = 2*nthreads;
+
+  bool cancelled = false;
+  auto it = cels.begin();
+  while (it != cels.end() && !cancelled) {
+    std::vector<CelJob> jobs;
+    for (; it != cels.end() && int(jobs.size()) < batchSize; ++it)
+      jobs.push_back(CelJob{ *it, nullptr, nullptr });
+
+    // The same mask/bounds are used in all cels
+    begin();
+    applyToPaletteIfNeeded();
+
+    const int njobs = int(jobs.size());
+    std::atomic<int> nextJob(0);
+    std::atomic<int> jobsDone(0);
+
+    run_parallel_tasks(
+      std::min(nthreads, njobs),
+      [this, njobs, &jobs, &nextJob, &jobsDone](const std::atomic<bool>& stop){
+        while (!stop) {
+          const int i = nextJob++;
+          if (i >= njobs)
+            break;
+
+          CelJob& job = jobs[i];
+          Target target = m_targetOrig;
+          if (job.cel->layer()->isBackground())
+            target &= ~TARGET_ALPHA_CHANNEL;
+
+          job.src = crop_cel_image(job.cel, 0);
+          job.dst.reset(Image::createCopy(job.src.get()));
+
+          RowCursor cursor(this, job.src.get(), job.dst.get(),
+                           m_bounds, target);
+          for (int y=0; y<m_bounds.h && !stop; y += kRowsPerTask)
+            cursor.applyRows(y, std::min(y + kRowsPerTask, m_bounds.h));
+          ++jobsDone;
+        }
+      },
+      [this, &jobsDone, &cancelled]{
+        if (m_progressDelegate) {
+          m_progressDelegate->reportProgress(
+            m_progressBase + m_progressWidth * jobsDone);
+          cancelled = m_progressDelegate->isCancelled();
+        }
+        return !cancelled;
+      });
+
+    if (cancelled)
+      break;
+
+    for (CelJob& job : jobs) {
+      m_cel = job.cel;
+      m_src = job.src;
+      m_dst = job.dst;
+      commitChangesToCel();
+    }
+    m_progressBase += m_progressWidth * njobs;
+  }
+
+  ASSERT(m_reader.context());
+  m_reader.context()->setCommandResult(
+    CommandResult(cancelled ? CommandResult::kCanceled:
+                              CommandResult::kOk));
+  return !cancelled;
+}
+
 void FilterManagerImpl::applyToTarget()
 {
   applyToPaletteIfNeeded();
@@ -325,24 +664,38 @@ void FilterManagerImpl::applyToTarget()
                           m_site.frame(), &newPalette));
   }
 
-  // For each target image
-  for (auto it = cels.begin();
-       it != cels.end() && !cancelled;
-       ++it) {
-    Image* image = (*it)->image();
-
-    // Avoid applying the filter two times to the same image
-    if (visited.find(image->id()) == visited.end()) {
-      visited.insert(image->id());
-      applyToCel(*it);
+  if (canApplyToCelsInParallel(int(cels.size()))) {
+    // Avoid applying the filter two times to the same image (linked
+    // cels)
+    CelList uniqueCels;
+    for (Cel* cel : cels) {
+      if (visited.insert(cel->image()->id()).second)
+        uniqueCels.push_back(cel);
     }
+    m_progressWidth = 1.0f / uniqueCels.size();
 
-    // Is there a delegate to know if the process was cancelled by the user?
-    if (m_progressDelegate)
-      cancelled = m_progressDelegate->isCancelled();
+    cancelled = !applyToCelsInParallel(uniqueCels);
+  }
+  else {
+    // For each target image
+    for (auto it = cels.begin();
+         it != cels.end() && !cancelled;
+         ++it) {
+      Image* image = (*it)->image();
+
+      // Avoid applying the filter two times to the same image
+      if (visited.find(image->id()) == visited.end()) {
+        visited.insert(image->id());
+        applyToCel(*it);
+      }
+
+      // Is there a delegate to know if the process was cancelled by the user?
+      if (m_progressDelegate)
+        cancelled = m_progressDelegate->isCancelled();
 
-    // Make progress
-    m_progressBase += m_progressWidth;
+      // Make progress
+      m_progressBase += m_progressWidth;
+    }
   }
 
   // Reset m_oldPalette to avoid restoring the color palette
@@ -376,39 +729,52 @@ void FilterManagerImpl::commitTransaction()
 
 void FilterManagerImpl::flush()
 {
-  int h = m_row - m_nextRowToFlush;
+  if (!m_previewMask)
+    return;
 
-  if (m_row >= 0 && h > 0) {
-    // Redraw the color palette
-    if (m_nextRowToFlush == 0 && paletteHasChanged())
+  // Redraw the color palette
+  if (m_previewPaletteApplied && !m_previewPaletteFlushed) {
+    if (paletteHasChanged())
       redrawColorPalette();
+    m_previewPaletteFlushed = true;
+  }
+
+  gfx::Region dirty(m_previewDirty);
+  m_previewDirty.clear();
+
+  // Rows of the current tile that were filtered since the last flush
+  if (!m_previewTile.isEmpty() &&
+      m_previewTileRow > m_previewTileFlushedRow) {
+    dirty.createUnion(
+      dirty,
+      gfx::Region(gfx::Rect(m_previewTile.x,
+                            m_previewTile.y+m_previewTileFlushedRow,
+                            m_previewTile.w,
+                            m_previewTileRow-m_previewTileFlushedRow)));
+    m_previewTileFlushedRow = m_previewTileRow;
+  }
 
-    for (Editor* editor : UIContext::instance()->getAllEditorsIncludingPreview(document())) {
-      // We expand the region one pixel at the top and bottom of the
-      // region [m_row,m_nextRowToFlush) to be updated on the screen to
-      // avoid screen artifacts when we apply filters like convolution
+  if (dirty.isEmpty())
+    return;
+
+  for (Editor* editor : UIContext::instance()->getAllEditorsIncludingPreview(document())) {
+    gfx::Region reg1;
+    for (const gfx::Rect& rc : dirty) {
+      // We expand each rectangle one pixel in each side to avoid
+      // screen artifacts when we apply filters like convolution
       // matrices.
-      gfx::Rect rect(
-        editor->editorToScreen(
-          gfx::Point(
-            m_bounds.x,
-            m_bounds.y+m_nextRowToFlush-1)),
-        gfx::Size(
-          editor->projection().applyX(m_bounds.w),
-          (editor->projection().scaleY() >= 1 ? editor->projection().applyY(h+2):
-                                                editor->projection().removeY(h+2))));
-
-      gfx::Region reg1(rect);
-      editor->expandRegionByTiledMode(reg1, true);
-
-      gfx::Region reg2;
-      editor->getDrawableRegion(reg2, Widget::kCutTopWindows);
-      reg1.createIntersection(reg1, reg2);
-
-      editor->invalidateRegion(reg1);
+      const gfx::Rect spriteRc = gfx::Rect(rc).enlarge(1);
+      const gfx::Point pt = editor->editorToScreen(spriteRc.origin());
+      const gfx::Point pt2 = editor->editorToScreen(spriteRc.point2());
+      reg1.createUnion(reg1, gfx::Region(gfx::Rect(pt, pt2)));
     }
+    editor->expandRegionByTiledMode(reg1, true);
+
+    gfx::Region reg2;
+    editor->getDrawableRegion(reg2, Widget::kCutTopWindows);
+    reg1.createIntersection(reg1, reg2);
 
-    m_nextRowToFlush = m_row+1;
+    editor->invalidateRegion(reg1);
   }
 }
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -15,12 +15,14 @@
 #include "app/tx.h"
 #include "base/exception.h"
 #include "base/task.h"
+#include "doc/cel_list.h"
 #include "doc/image_impl.h"
 #include "doc/image_ref.h"
 #include "doc/pixel_format.h"
 #include "filters/filter_indexed_data.h"
 #include "filters/filter_manager.h"
 #include "gfx/rect.h"
+#include "gfx/region.h"
 
 #include <cstring>
 #include <memory>
@@ -84,7 +86,18 @@ namespace app {
 
     void begin();
 #ifdef ENABLE_UI
+    // Starts a new preview. The area to be filtered is divided in
+    // tiles, and the tiles visible in the editors are filtered first.
     void beginForPreview();
+
+    // Re-sorts the pending tiles of the current preview when the
+    // visible area changes (scroll/zoom), keeping the tiles that were
+    // already filtered.
+    void updatePreviewViewport();
+
+    // Applies the filter to the next row of the current preview
+    // tile. Returns false when there are no more tiles to filter.
+    bool applyPreviewStep();
 #endif
     void end();
     bool applyStep();
@@ -130,8 +143,15 @@ namespace app {
     doc::PalettePicks getPalettePicks() override;
 
   private:
+    class RowCursor;
+
     void init(doc::Cel* cel);
     void apply();
+    void commitChangesToCel();
+    bool canApplyRowsInParallel() const;
+    bool applyRowsInParallel();
+    bool canApplyToCelsInParallel(const int ncels) const;
+    bool applyToCelsInParallel(const doc::CelList& cels);
     void applyToCel(doc::Cel* cel);
     bool updateBounds(doc::Mask* mask);
 
@@ -143,6 +163,7 @@ namespace app {
 
 #ifdef ENABLE_UI
     void redrawColorPalette();
+    void sortPreviewTiles();
 #endif
 
     ContextReader m_reader;
@@ -154,7 +175,15 @@ namespace app {
     doc::ImageRef m_dst;
     int m_row;
 #ifdef ENABLE_UI
-    int m_nextRowToFlush;
+    // Tiles that are not yet filtered for the preview (sorted from
+    // the lowest to the highest priority, the next one is the last).
+    std::vector<gfx::Rect> m_previewTiles;
+    gfx::Rect m_previewTile;      // Tile being filtered
+    int m_previewTileRow;         // Next row to filter in m_previewTile
+    int m_previewTileFlushedRow;  // Next row to flush in m_previewTile
+    gfx::Region m_previewDirty;   // Filtered area pending to be flushed
+    bool m_previewPaletteApplied;
+    bool m_previewPaletteFlushed;
 #endif
     gfx::Rect m_bounds;
     doc::Mask* m_mask;
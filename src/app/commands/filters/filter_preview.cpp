@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -31,6 +31,7 @@ FilterPreview::FilterPreview(FilterManagerImpl* filterMgr)
   , m_filterMgr(filterMgr)
   , m_timer(1, this)
   , m_restartPreviewTimer(10)
+  , m_keepTiles(false)
 {
   setVisible(false);
 
@@ -84,6 +85,7 @@ void FilterPreview::stop()
 void FilterPreview::restartPreview()
 {
   stop();
+  m_keepTiles = false;
 
   // Start the timer to re-launch the filter preview in the next 10
   // milliseconds. This is necessary to avoid restarting the preview
@@ -97,11 +99,27 @@ void FilterPreview::restartPreview()
   m_restartPreviewTimer.start();
 }
 
+void FilterPreview::updateViewport()
+{
+  stop();
+
+  // If the preview is going to be restarted from scratch anyway
+  // (e.g. a filter parameter has changed) we cannot keep the tiles.
+  if (!m_restartPreviewTimer.isRunning())
+    m_keepTiles = true;
+  m_restartPreviewTimer.start();
+}
+
 void FilterPreview::onDelayedStartPreview()
 {
   // Start the filter for preview purposes and the timer to flush the
-  // preview to the editor/display.
-  m_filterMgr->beginForPreview();
+  // preview to the editor/display. If only the viewport has changed,
+  // we continue with the tiles that weren't filtered yet.
+  if (m_keepTiles)
+    m_filterMgr->updatePreviewViewport();
+  else
+    m_filterMgr->beginForPreview();
+  m_keepTiles = false;
   m_timer.start();
 
   if (!m_filterTask.running()) {
@@ -156,7 +174,7 @@ void FilterPreview::onFilterTask(base::task_token& token)
   while (!token.canceled()) {
     {
       std::scoped_lock lock(m_filterMgrMutex);
-      if (!m_filterMgr->applyStep())
+      if (!m_filterMgr->applyPreviewStep())
         token.cancel();
     }
     base::this_thread::yield();
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -30,6 +30,10 @@ namespace app {
     void stop();
     void restartPreview();
 
+    // Continues the current preview giving priority to the visible
+    // area (e.g. when the editor is scrolled or zoomed).
+    void updateViewport();
+
   protected:
     bool onProcessMessage(ui::Message* msg) override;
 
@@ -42,6 +46,7 @@ namespace app {
     ui::Timer m_restartPreviewTimer;
     std::mutex m_filterMgrMutex;
     app::Task m_filterTask;
+    bool m_keepTiles;
   };
 
 } // namespace app
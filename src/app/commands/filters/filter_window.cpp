@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2023  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -234,12 +234,14 @@ void FilterWindow::stopPreview()
 
 void FilterWindow::onScrollChanged(Editor* editor)
 {
-  restartPreview();
+  if (m_showPreview.isSelected())
+    m_preview.updateViewport();
 }
 
 void FilterWindow::onZoomChanged(Editor* editor)
 {
-  restartPreview();
+  if (m_showPreview.isSelected())
+    m_preview.updateViewport();
 }
 
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -128,6 +128,8 @@ void Param<app::SpriteSheetDataFormat>::fromString(const std::string& value)
       base::utf8_icmp(value, "json-array") == 0 ||
       base::utf8_icmp(value, "json_array") == 0)
     setValue(app::SpriteSheetDataFormat::JsonArray);
+  else if (base::utf8_icmp(value, "binary") == 0)
+    setValue(app::SpriteSheetDataFormat::Binary);
   else
     setValue(app::SpriteSheetDataFormat::JsonHash);
 }
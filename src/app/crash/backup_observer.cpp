@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -26,6 +26,7 @@
 #include "app/doc.h"
 #include "app/doc_access.h"
 #include "app/doc_diff.h"
+#include "app/perf_trace.h"
 #include "app/pref/preferences.h"
 #include "base/chrono.h"
 #include "base/remove_from_container.h"
@@ -185,6 +186,7 @@ void BackupObserver::backgroundThread()
 // Executed from the backgroundThread() (non-UI thread)
 bool BackupObserver::saveDocData(Doc* doc)
 {
+  PerfScope perf(PerfCategory::Backup, "BackupObserver::saveDocData");
   try {
     if (!doc->needsBackup())
       return true;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -44,6 +44,7 @@ DataRecovery::DataRecovery(Context* ctx)
     m_config.keepEditedSpriteDataFor = pref.general.keepEditedSpriteDataFor();
   else
     m_config.keepEditedSpriteDataFor = 0;
+  m_config.diskBudget = pref.general.dataRecoveryDiskBudget();
 
   ResourceFinder rf;
   rf.includeUserDir(base::join_path("sessions", ".").c_str());
@@ -174,6 +175,9 @@ void DataRecovery::searchForSessions()
               return a->name() > b->name();
             });
 
+  if (m_config.diskBudget > 0)
+    removeSessionsOverBudget(sessions);
+
   // Assign m_sessions=sessions
   {
     std::unique_lock<std::mutex> lock(m_sessionsMutex);
@@ -187,5 +191,40 @@ void DataRecovery::searchForSessions()
     });
 }
 
+void DataRecovery::removeSessionsOverBudget(Sessions& sessions)
+{
+  const std::size_t budget = std::size_t(m_config.diskBudget)*1024*1024;
+  std::vector<std::size_t> sizes(sessions.size(), 0);
+  std::size_t used = 0;
+
+  // Crashed sessions are never removed automatically (they can
+  // contain unsaved work), but they count in the budget.
+  for (std::size_t i=0; i<sessions.size(); ++i) {
+    sizes[i] = sessions[i]->diskUsage();
+    if (sessions[i]->isCrashedSession())
+      used += sizes[i];
+  }
+
+  // Keep the most recent sessions (sessions are sorted from the most
+  // recent one to the oldest one) until the budget is exceeded.
+  Sessions kept;
+  for (std::size_t i=0; i<sessions.size(); ++i) {
+    const SessionPtr& session = sessions[i];
+    if (session->isCrashedSession()) {
+      kept.push_back(session);
+    }
+    else if (used + sizes[i] <= budget) {
+      used += sizes[i];
+      kept.push_back(session);
+    }
+    else {
+      RECO_TRACE("RECO: Session '%s' deleted (over the disk budget)\n",
+                 session->name().c_str());
+      session->removeFromDisk();
+    }
+  }
+  std::swap(sessions, kept);
+}
+
 } // namespace crash
 } // namespace app
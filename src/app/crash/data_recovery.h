@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2021  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -54,6 +54,10 @@ namespace crash {
     // Executed from m_thread to search for the list of sessions.
     void searchForSessions();
 
+    // Removes the oldest sessions that were correctly closed if the
+    // sessions use more disk space than the configured budget.
+    void removeSessionsOverBudget(Sessions& sessions);
+
     std::string m_sessionsDir;
     mutable std::mutex m_sessionsMutex;
     std::thread m_thread;
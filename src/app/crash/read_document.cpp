@@ -46,8 +46,13 @@
 #include "doc/util.h"
 #include "fixmath/fixmath.h"
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <thread>
+#include <vector>
 
 namespace app {
 namespace crash {
@@ -58,6 +63,9 @@ using namespace doc;
 
 namespace {
 
+// Fraction of the progress used to decode images in parallel
+const float kPreloadProgress = 0.9f;
+
 // Returns true if the file was saved correctly (has the "FINE" magic
 // number), so we can ignore broken versions of objects directly.
 bool check_magic_number(const std::string& fn)
@@ -76,6 +84,7 @@ public:
     , m_docId(0)
     , m_docVersions(nullptr)
     , m_loadInfo(nullptr)
+    , m_progressOffset(0.0f)
     , m_taskToken(t) {
     for (const auto& fn : base::list_files(dir)) {
       auto i = fn.find('-');
@@ -99,6 +108,9 @@ public:
       ObjVersions& versions = m_objVersions[id];
       versions.add(ver);
 
+      if (fn.compare(0, 4, "img-") == 0)
+        m_imageIds.insert(id);
+
       if (fn.compare(0, 3, "doc") == 0) {
         if (!m_docId)
           m_docId = id;
@@ -112,6 +124,8 @@ public:
   }
 
   Doc* loadDocument() {
+    preloadImages();
+
     Doc* doc = loadObject<Doc*>("doc", m_docId, &Reader::readDocument);
     if (doc)
       fixUndetectedDocumentIssues(doc);
@@ -157,10 +171,99 @@ private:
     return m_celdatas[celdataId] = celData;
   }
 
+  // Decodes all the images of the session from several threads
+  // before reading the rest of objects (decompressing images is the
+  // slowest part to restore a big document). The progress of this
+  // step is calculated from the size of the image files.
+  void preloadImages() {
+    struct Item {
+      ObjectId id;
+      uint64_t bytes;
+      ImageRef image;
+    };
+
+    std::vector<Item> items;
+    uint64_t totalBytes = 0;
+    for (ObjectId id : m_imageIds) {
+      const ObjectVersion ver = m_objVersions[id][0];
+      const uint64_t bytes =
+        base::file_size(base::join_path(m_dir, objectFilename("img", id, ver)));
+      items.push_back(Item{ id, bytes, nullptr });
+      totalBytes += bytes;
+    }
+    if (items.empty())
+      return;
+
+    std::atomic<int> nextItem(0);
+    std::atomic<uint64_t> loadedBytes(0);
+
+    auto worker = [&]{
+      while (!canceled()) {
+        const int i = nextItem++;
+        if (i >= int(items.size()))
+          break;
+
+        Item& item = items[i];
+        item.image.reset(tryLoadObject<Image*>("img", item.id, &Reader::readImage));
+
+        loadedBytes += item.bytes;
+        if (m_taskToken && totalBytes > 0) {
+          m_taskToken->set_progress(
+            kPreloadProgress * float(loadedBytes) / float(totalBytes));
+        }
+      }
+    };
+
+    const int nthreads = std::clamp(int(std::thread::hardware_concurrency()),
+                                    1, int(items.size()));
+    std::vector<std::thread> threads;
+    for (int i=1; i<nthreads; ++i)
+      threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : threads)
+      thread.join();
+
+    // Images that couldn't be loaded will be loaded again (showing
+    // the errors) from getImageRef()
+    for (Item& item : items) {
+      if (item.image)
+        m_images[item.id] = item.image;
+    }
+    m_progressOffset = kPreloadProgress;
+  }
+
+  std::string objectFilename(const char* prefix, ObjectId id, ObjectVersion ver) const {
+    std::string fn = prefix;
+    fn.push_back('-');
+    fn += base::convert_to<std::string>(id);
+    fn.push_back('.');
+    fn += base::convert_to<std::string>(ver);
+    return fn;
+  }
+
   template<typename T>
   T loadObject(const char* prefix, ObjectId id, T (Reader::*readMember)(std::ifstream&)) {
-    const ObjVersions& versions = m_objVersions[id];
+    T obj = tryLoadObject<T>(prefix, id, readMember);
+    if (obj)
+      return obj;
+
+    // Show error only if we've failed to load all versions
+    if (!m_loadInfo)
+      Console().printf("Error loading object %s #%d\n", prefix, id);
+
+    return nullptr;
+  }
+
+  // Tries to load the object from its files (newer versions first).
+  // It can be called from several threads at the same time to read
+  // different objects.
+  template<typename T>
+  T tryLoadObject(const char* prefix, ObjectId id, T (Reader::*readMember)(std::ifstream&)) {
+    auto it = m_objVersions.find(id);
+    if (it == m_objVersions.end())
+      return nullptr;
 
+    const ObjVersions& versions = it->second;
     for (size_t i=0; i<versions.size(); ++i) {
       ObjectVersion ver = versions[i];
       if (!ver)
@@ -168,12 +271,7 @@ private:
 
       RECO_TRACE("RECO: Restoring %s #%d v%d\n", prefix, id, ver);
 
-      std::string fn = prefix;
-      fn.push_back('-');
-      fn += base::convert_to<std::string>(id);
-      fn.push_back('.');
-      fn += base::convert_to<std::string>(ver);
-
+      const std::string fn = objectFilename(prefix, id, ver);
       std::ifstream s(FSTREAM_PATH(base::join_path(m_dir, fn)), std::ifstream::binary);
       T obj = nullptr;
       if (read32(s) == MAGIC_NUMBER)
@@ -187,11 +285,6 @@ private:
         RECO_TRACE("RECO: %s #%d v%d was not restored\n", prefix, id, ver);
       }
     }
-
-    // Show error only if we've failed to load all versions
-    if (!m_loadInfo)
-      Console().printf("Error loading object %s #%d\n", prefix, id);
-
     return nullptr;
   }
 
@@ -337,7 +430,9 @@ private:
       }
 
       if (m_taskToken) {
-        m_taskToken->set_progress(float(i) / float(m_celsToLoad.size()));
+        m_taskToken->set_progress(
+          m_progressOffset +
+          (1.0f - m_progressOffset) * float(i) / float(m_celsToLoad.size()));
       }
     }
 
@@ -515,9 +610,54 @@ private:
   }
 
   Image* readImage(std::ifstream& s) {
+    // An image ID = 0 means that the file contains a patch (modified
+    // tiles) of a full version of the image.
+    const std::ifstream::pos_type pos = s.tellg();
+    if (read32(s) == 0)
+      return readImagePatch(s);
+
+    s.seekg(pos);
     return read_image(s, false);
   }
 
+  Image* readImagePatch(std::ifstream& s) {
+    const ObjectVersion baseVer = read32(s);
+    const ObjectId imageId = read32(s);
+    const int pixelFormat = read8(s);
+    const int width = read16(s);
+    const int height = read16(s);
+    const color_t maskColor = read32(s);
+    const int ntiles = read32(s);
+    if (!baseVer || !imageId || ntiles < 0 || s.fail())
+      return nullptr;
+
+    // Read the full version of the image
+    std::string fn = "img-";
+    fn += base::convert_to<std::string>(imageId);
+    fn.push_back('.');
+    fn += base::convert_to<std::string>(baseVer);
+
+    std::ifstream baseStream(FSTREAM_PATH(base::join_path(m_dir, fn)), std::ifstream::binary);
+    if (read32(baseStream) != MAGIC_NUMBER)
+      return nullptr;
+
+    std::unique_ptr<Image> image(read_image(baseStream, false));
+    if (!image ||
+        image->pixelFormat() != pixelFormat ||
+        image->width() != width ||
+        image->height() != height)
+      return nullptr;
+
+    // Apply the modified tiles
+    for (int i=0; i<ntiles; ++i) {
+      if (canceled() || !read_image_region(s, image.get()))
+        return nullptr;
+    }
+
+    image->setMaskColor(maskColor);
+    return image.release();
+  }
+
   Palette* readPalette(std::ifstream& s) {
     return read_palette(s);
   }
@@ -600,6 +740,10 @@ private:
   // Each ObjectId is a tileset ID that didn't contain the empty tile
   // as the first tile (this was an old format used in internal betas)
   std::set<ObjectId> m_updateOldTilemapWithTileset;
+  // IDs of all images in the session
+  std::set<ObjectId> m_imageIds;
+  // Progress already done when we start loading cels
+  float m_progressOffset;
   base::task_token* m_taskToken;
 };
 
@@ -655,8 +799,15 @@ Doc* read_document_with_raw_images(const std::string& dir,
       continue;
 
     ImageRef img;
-    if (read32(s) == MAGIC_NUMBER)
-      img.reset(read_image(s, false));
+    if (read32(s) == MAGIC_NUMBER) {
+      // Skip patches (image ID = 0), their full versions of the
+      // images are in other files.
+      const std::ifstream::pos_type pos = s.tellg();
+      if (read32(s) != 0) {
+        s.seekg(pos);
+        img.reset(read_image(s, false));
+      }
+    }
 
     if (img) {
       lay->addCel(new Cel(frame, img));
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -16,6 +16,8 @@ namespace crash {
   struct RecoveryConfig {
     double dataRecoveryPeriod;
     int keepEditedSpriteDataFor;
+    // Maximum disk space (in MB) used by old sessions (0 = no limit)
+    int diskBudget;
   };
 
 } // namespace crash
@@ -161,6 +161,25 @@ bool Session::isEmpty()
   return true;
 }
 
+std::size_t Session::diskUsage()
+{
+  std::size_t size = 0;
+  for (auto& item : base::list_files(m_path)) {
+    const std::string path = base::join_path(m_path, item);
+    if (base::is_directory(path)) {
+      // Files of each backup
+      for (auto& docItem : base::list_files(path)) {
+        const std::string fn = base::join_path(path, docItem);
+        if (base::is_file(fn))
+          size += base::file_size(fn);
+      }
+    }
+    else
+      size += base::file_size(path);
+  }
+  return size;
+}
+
 void Session::create(base::pid pid)
 {
   m_pid = pid;
@@ -228,9 +247,19 @@ public:
 
 bool Session::saveDocumentChanges(Doc* doc)
 {
-  CustomWeakDocReader reader(doc);
-  if (!reader.isLocked())
-    return false;
+  // Copy the modified objects while the document is locked, then
+  // the snapshot is compressed and written to disk without the lock,
+  // so the user can continue editing the document.
+  DocSnapshotPtr snapshot;
+  {
+    CustomWeakDocReader reader(doc);
+    if (!reader.isLocked())
+      return false;
+
+    snapshot = snapshot_document(doc, &reader);
+    if (!snapshot)
+      return false;
+  }
 
   app::Context ctx;
   std::string dir = base::join_path(m_path,
@@ -252,7 +281,7 @@ bool Session::saveDocumentChanges(Doc* doc)
   }
 
   // Save document information
-  return write_document(dir, doc, &reader);
+  return write_document_snapshot(dir, snapshot.get());
 }
 
 void Session::removeDocument(Doc* doc)
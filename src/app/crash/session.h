@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -54,6 +54,10 @@ namespace crash {
     bool isOldSession();
     bool isEmpty();
 
+    // Returns the disk space used by the files of the session (in
+    // bytes).
+    std::size_t diskUsage();
+
     void create(base::pid pid);
     void close();
     void removeFromDisk();
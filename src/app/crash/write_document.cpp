@@ -30,6 +30,7 @@
 #include "doc/layer_tilemap.h"
 #include "doc/palette.h"
 #include "doc/palette_io.h"
+#include "doc/primitives.h"
 #include "doc/serial_format.h"
 #include "doc/slice.h"
 #include "doc/slice_io.h"
@@ -43,8 +44,12 @@
 #include "doc/user_data_io.h"
 #include "fixmath/fixmath.h"
 
+#include <algorithm>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
 
 namespace app {
 namespace crash {
@@ -55,20 +60,64 @@ using namespace doc;
 
 namespace {
 
+// Images are divided in tiles of this size to save only the modified
+// tiles of an image (a patch) in the backup.
+const int kPatchTileSize = 64;
+
+// Last full version of an image written in the backup session. The
+// next versions of the image are saved as patches with the tiles
+// that are different from this full version.
+struct ImageBase {
+  ObjectVersion version = 0;
+  std::vector<uint64_t> tileHashes;
+  // Old full versions that are still referenced by patches.
+  std::vector<ObjectVersion> oldVersions;
+};
+
+typedef std::map<ObjectId, ImageBase> ImageBasesMap;
+
 static std::map<ObjectId, ObjVersionsMap> g_docVersions;
+static std::map<ObjectId, ImageBasesMap> g_imageBases;
 static std::map<ObjectId, base::paths> g_deleteFiles;
 
+bool image_supports_patches(const Image* img)
+{
+  return (img->pixelFormat() == IMAGE_RGB ||
+          img->pixelFormat() == IMAGE_GRAYSCALE ||
+          img->pixelFormat() == IMAGE_INDEXED);
+}
+
+std::vector<uint64_t> calculate_tile_hashes(const Image* img)
+{
+  std::vector<uint64_t> hashes;
+  for (int y=0; y<img->height(); y+=kPatchTileSize) {
+    for (int x=0; x<img->width(); x+=kPatchTileSize) {
+      const gfx::Rect tile =
+        gfx::Rect(x, y, kPatchTileSize, kPatchTileSize)
+        .createIntersection(img->bounds());
+      hashes.push_back(calculate_image_hash64(img, tile));
+    }
+  }
+  return hashes;
+}
+
 class Writer {
 public:
-  Writer(const std::string& dir, Doc* doc, doc::CancelIO* cancel)
+  Writer(const std::string& dir, ObjectId docId, doc::CancelIO* cancel)
     : m_dir(dir)
-    , m_doc(doc)
-    , m_objVersions(g_docVersions[doc->id()])
-    , m_deleteFiles(g_deleteFiles[doc->id()])
+    , m_doc(nullptr)
+    , m_snapshot(nullptr)
+    , m_objVersions(g_docVersions[docId])
+    , m_imageBases(g_imageBases[docId])
+    , m_deleteFiles(g_deleteFiles[docId])
     , m_cancel(cancel) {
   }
 
-  bool saveDocument() {
+  // Adds to the snapshot all the objects of the document that were
+  // modified since the last backup.
+  bool snapshotDocument(Doc* doc, DocSnapshot& snapshot) {
+    m_doc = doc;
+    m_snapshot = &snapshot;
     Sprite* spr = m_doc->sprite();
 
     // Save from objects without children (e.g. images), to aggregated
@@ -109,7 +158,7 @@ public:
         if (cel->link())        // Skip link
           continue;
 
-        if (!saveObject("img", cel->image(), &Writer::writeImage))
+        if (!saveImage("img", cel->image()))
           return false;
 
         if (!saveObject("celdata", cel->data(), &Writer::writeCelData))
@@ -138,6 +187,17 @@ public:
     if (!saveObject("doc", m_doc, &Writer::writeDocumentFile))
       return false;
 
+    return true;
+  }
+
+  // Writes all the objects of the snapshot in the same order they
+  // were added.
+  bool writeSnapshot(const DocSnapshot& snapshot) {
+    for (const DocSnapshot::Object& obj : snapshot.objects) {
+      if (!writeObject(obj))
+        return false;
+    }
+
     // Delete old files after all files are correctly saved.
     deleteOldVersions();
     return true;
@@ -149,14 +209,14 @@ private:
     return (m_cancel && m_cancel->isCanceled());
   }
 
-  bool writeDocumentFile(std::ofstream& s, Doc* doc) {
+  bool writeDocumentFile(std::ostream& s, Doc* doc) {
     write32(s, doc->sprite()->id());
     write_string(s, doc->filename());
     write16(s, uint16_t(doc::SerialFormat::LastVer));
     return true;
   }
 
-  bool writeSprite(std::ofstream& s, Sprite* spr) {
+  bool writeSprite(std::ostream& s, Sprite* spr) {
     // Header
     write8(s, int(spr->colorMode()));
     write16(s, spr->width());
@@ -210,7 +270,7 @@ private:
     return true;
   }
 
-  bool writeGridBounds(std::ofstream& s, const gfx::Rect& grid) {
+  bool writeGridBounds(std::ostream& s, const gfx::Rect& grid) {
     write16(s, (int16_t)grid.x);
     write16(s, (int16_t)grid.y);
     write16(s, grid.w);
@@ -218,7 +278,7 @@ private:
     return true;
   }
 
-  bool writeColorSpace(std::ofstream& s, const gfx::ColorSpaceRef& colorSpace) {
+  bool writeColorSpace(std::ostream& s, const gfx::ColorSpaceRef& colorSpace) {
     write16(s, colorSpace->type());
     write16(s, colorSpace->flags());
     write32(s, fixmath::ftofix(colorSpace->gamma()));
@@ -232,7 +292,7 @@ private:
     return true;
   }
 
-  void writeAllLayersID(std::ofstream& s, ObjectId parentId, const LayerGroup* group) {
+  void writeAllLayersID(std::ostream& s, ObjectId parentId, const LayerGroup* group) {
     for (const Layer* lay : group->layers()) {
       write32(s, lay->id());
       write32(s, parentId);
@@ -242,7 +302,7 @@ private:
     }
   }
 
-  bool writeLayerStructure(std::ofstream& s, Layer* lay) {
+  bool writeLayerStructure(std::ostream& s, Layer* lay) {
     write32(s, static_cast<int>(lay->flags())); // Flags
     write16(s, static_cast<int>(lay->type()));  // Type
     write_string(s, lay->name());
@@ -282,64 +342,152 @@ private:
     return true;
   }
 
-  bool writeCel(std::ofstream& s, Cel* cel) {
+  bool writeCel(std::ostream& s, Cel* cel) {
     write_cel(s, cel);
     return true;
   }
 
-  bool writeCelData(std::ofstream& s, CelData* celdata) {
+  bool writeCelData(std::ostream& s, CelData* celdata) {
     write_celdata(s, celdata);
     return true;
   }
 
-  bool writeImage(std::ofstream& s, Image* img) {
-    return write_image(s, img, m_cancel);
+  // Writes a patch with the modified tiles of the image since its
+  // last full version, or the full image if there is no full version
+  // yet or if most of the image was modified.
+  bool writeImage(std::ostream& s, ObjectId id, const Image* img) {
+    m_newTileHashes.clear();
+
+    if (image_supports_patches(img)) {
+      const ImageBase& base = m_imageBases[id];
+      std::vector<uint64_t> hashes = calculate_tile_hashes(img);
+
+      if (base.version &&
+          base.tileHashes.size() == hashes.size()) {
+        std::vector<gfx::Rect> tiles;
+        int i = 0;
+        for (int y=0; y<img->height(); y+=kPatchTileSize) {
+          for (int x=0; x<img->width(); x+=kPatchTileSize, ++i) {
+            if (hashes[i] != base.tileHashes[i]) {
+              tiles.push_back(
+                gfx::Rect(x, y, kPatchTileSize, kPatchTileSize)
+                .createIntersection(img->bounds()));
+            }
+          }
+        }
+
+        // Write a patch only if less than half of the image was
+        // modified, in other case we write a new full version (so
+        // patches don't grow indefinitely).
+        if (tiles.size() <= hashes.size() / 2) {
+          write32(s, 0);        // Image ID = 0 means that this is a patch
+          write32(s, base.version);
+          write32(s, id);
+          write8(s, img->pixelFormat());
+          write16(s, img->width());
+          write16(s, img->height());
+          write32(s, img->maskColor());
+          write32(s, tiles.size());
+          for (const gfx::Rect& tile : tiles) {
+            if (!write_image_region(s, img, tile, m_cancel))
+              return false;
+          }
+          return true;
+        }
+      }
+
+      // This full version will be the new base image
+      m_newTileHashes = std::move(hashes);
+    }
+    return write_image_as(s, img, id, m_cancel);
   }
 
-  bool writePalette(std::ofstream& s, Palette* pal) {
+  bool writePalette(std::ostream& s, Palette* pal) {
     write_palette(s, pal);
     return true;
   }
 
-  bool writeTileset(std::ofstream& s, Tileset* tileset) {
+  bool writeTileset(std::ostream& s, Tileset* tileset) {
     write_tileset(s, tileset);
     return true;
   }
 
-  bool writeFrameTag(std::ofstream& s, Tag* frameTag) {
+  bool writeFrameTag(std::ostream& s, Tag* frameTag) {
     write_tag(s, frameTag);
     return true;
   }
 
-  bool writeSlice(std::ofstream& s, Slice* slice) {
+  bool writeSlice(std::ostream& s, Slice* slice) {
     write_slice(s, slice);
     return true;
   }
 
+  // Adds the object to the snapshot if it was modified. Objects are
+  // serialized in memory, except images, which are copied to be
+  // compressed later in writeObject().
   template<typename T>
-  bool saveObject(const char* prefix, T* obj, bool (Writer::*writeMember)(std::ofstream&, T*)) {
+  bool saveObject(const char* prefix, T* obj, bool (Writer::*writeMember)(std::ostream&, T*)) {
+    if (isCanceled())
+      return false;
+
+    if (!needsBackup(obj))
+      return true;
+
+    std::ostringstream s(std::ios::binary);
+    if (!(this->*writeMember)(s, obj)) // Write the object
+      return false;
+
+    m_snapshot->objects.push_back(
+      DocSnapshot::Object{ prefix, obj->id(), obj->version(), nullptr, s.str() });
+    return true;
+  }
+
+  bool saveImage(const char* prefix, Image* img) {
     if (isCanceled())
       return false;
 
+    if (!needsBackup(img))
+      return true;
+
+    m_snapshot->objects.push_back(
+      DocSnapshot::Object{ prefix, img->id(), img->version(),
+                           ImageRef(Image::createCopy(img)), std::string() });
+    return true;
+  }
+
+  template<typename T>
+  bool needsBackup(T* obj) {
     if (!obj->version())
       obj->incrementVersion();
 
     ObjVersions& versions = m_objVersions[obj->id()];
-    if (versions.newer() == obj->version())
+    return (versions.newer() != obj->version());
+  }
+
+  bool writeObject(const DocSnapshot::Object& obj) {
+    if (isCanceled())
+      return false;
+
+    ObjVersions& versions = m_objVersions[obj.id];
+    if (versions.newer() == obj.version)
       return true;
 
-    std::string fn = prefix;
+    std::string fn = obj.prefix;
     fn.push_back('-');
-    fn += base::convert_to<std::string>(obj->id());
+    fn += base::convert_to<std::string>(obj.id);
 
     std::string fullfn = base::join_path(m_dir, fn);
     std::string oldfn = fullfn + "." + base::convert_to<std::string>(versions.older());
-    fullfn += "." + base::convert_to<std::string>(obj->version());
+    fullfn += "." + base::convert_to<std::string>(obj.version);
 
     std::ofstream s(FSTREAM_PATH(fullfn), std::ofstream::binary);
     write32(s, 0);                // Leave a room for the magic number
-    if (!(this->*writeMember)(s, obj)) // Write the object
-      return false;
+    if (obj.image) {
+      if (!writeImage(s, obj.id, obj.image.get()))
+        return false;
+    }
+    else
+      s.write(obj.data.c_str(), obj.data.size());
 
     // Flush all data. In this way we ensure that the magic number is
     // the last thing being written in the file.
@@ -350,16 +498,70 @@ private:
     write32(s, MAGIC_NUMBER);
 
     // Remove the older version
-    if (versions.older() && base::is_file(oldfn))
+    if (versions.older() &&
+        !isReferencedVersion(obj, versions.older()) &&
+        base::is_file(oldfn))
       m_deleteFiles.push_back(oldfn);
 
     // Rotate versions and add the latest one
-    versions.rotateRevisions(obj->version());
+    versions.rotateRevisions(obj.version);
+    if (obj.image)
+      onImageSaved(obj, versions);
 
-    RECO_TRACE(" - Saved %s #%d v%d\n", prefix, obj->id(), obj->version());
+    RECO_TRACE(" - Saved %s #%d v%d\n", obj.prefix, obj.id, obj.version);
     return true;
   }
 
+  // Returns true if the given version of the object is still needed
+  // by other versions (e.g. a full image referenced by patches).
+  bool isReferencedVersion(const DocSnapshot::Object& obj, ObjectVersion ver) {
+    if (!obj.image)
+      return false;
+
+    auto it = m_imageBases.find(obj.id);
+    if (it == m_imageBases.end())
+      return false;
+
+    const ImageBase& base = it->second;
+    return (ver == base.version ||
+            std::find(base.oldVersions.begin(),
+                      base.oldVersions.end(), ver) != base.oldVersions.end());
+  }
+
+  void onImageSaved(const DocSnapshot::Object& obj, const ObjVersions& versions) {
+    if (!image_supports_patches(obj.image.get()))
+      return;
+
+    ImageBase& base = m_imageBases[obj.id];
+
+    // A new full version of the image was saved
+    if (!m_newTileHashes.empty()) {
+      if (base.version)
+        base.oldVersions.push_back(base.version);
+      base.version = obj.version;
+      base.tileHashes = std::move(m_newTileHashes);
+      m_newTileHashes.clear();
+    }
+
+    // Old full versions can be deleted when all versions in the
+    // session are newer than the current full version (so there are
+    // no more patches referencing old full versions).
+    if (!base.oldVersions.empty() &&
+        versions.older() >= base.version) {
+      for (ObjectVersion ver : base.oldVersions) {
+        std::string fn = obj.prefix;
+        fn.push_back('-');
+        fn += base::convert_to<std::string>(obj.id);
+        fn.push_back('.');
+        fn += base::convert_to<std::string>(ver);
+        fn = base::join_path(m_dir, fn);
+        if (base::is_file(fn))
+          m_deleteFiles.push_back(fn);
+      }
+      base.oldVersions.clear();
+    }
+  }
+
   void deleteOldVersions() {
     while (!m_deleteFiles.empty() && !isCanceled()) {
       std::string file = m_deleteFiles.back();
@@ -377,8 +579,11 @@ private:
 
   std::string m_dir;
   Doc* m_doc;
+  DocSnapshot* m_snapshot;
   ObjVersionsMap& m_objVersions;
+  ImageBasesMap& m_imageBases;
   base::paths& m_deleteFiles;
+  std::vector<uint64_t> m_newTileHashes;
   doc::CancelIO* m_cancel;
 };
 
@@ -387,12 +592,33 @@ private:
 //////////////////////////////////////////////////////////////////////
 // Public API
 
+DocSnapshotPtr snapshot_document(Doc* doc,
+                                 doc::CancelIO* cancel)
+{
+  auto snapshot = std::make_unique<DocSnapshot>();
+  snapshot->docId = doc->id();
+
+  Writer writer(std::string(), doc->id(), cancel);
+  if (!writer.snapshotDocument(doc, *snapshot))
+    return nullptr;
+  return snapshot;
+}
+
+bool write_document_snapshot(const std::string& dir,
+                             const DocSnapshot* snapshot,
+                             doc::CancelIO* cancel)
+{
+  Writer writer(dir, snapshot->docId, cancel);
+  return writer.writeSnapshot(*snapshot);
+}
+
 bool write_document(const std::string& dir,
                     Doc* doc,
                     doc::CancelIO* cancel)
 {
-  Writer writer(dir, doc, cancel);
-  return writer.saveDocument();
+  DocSnapshotPtr snapshot = snapshot_document(doc, cancel);
+  return (snapshot &&
+          write_document_snapshot(dir, snapshot.get(), cancel));
 }
 
 void delete_document_internals(Doc* doc)
@@ -406,6 +632,11 @@ void delete_document_internals(Doc* doc)
     if (it != g_docVersions.end())
       g_docVersions.erase(it);
   }
+  {
+    auto it = g_imageBases.find(doc->id());
+    if (it != g_imageBases.end())
+      g_imageBases.erase(it);
+  }
   {
     auto it = g_deleteFiles.find(doc->id());
     if (it != g_deleteFiles.end())
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -8,7 +9,13 @@
 #define APP_CRASH_WRITE_DOCUMENT_H_INCLUDED
 #pragma once
 
+#include "doc/image_ref.h"
+#include "doc/object_id.h"
+#include "doc/object_version.h"
+
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace doc {
   class CancelIO;
@@ -19,6 +26,33 @@ namespace app {
 
   namespace crash {
 
+    // Objects of a document that were modified since the last
+    // backup. Images are copied, and the rest of objects are already
+    // serialized, so the snapshot can be written to disk without
+    // locking the document.
+    struct DocSnapshot {
+      struct Object {
+        const char* prefix;
+        doc::ObjectId id;
+        doc::ObjectVersion version;
+        doc::ImageRef image;      // Copy of the image for "img" objects
+        std::string data;         // Serialized data for other objects
+      };
+      doc::ObjectId docId = 0;
+      std::vector<Object> objects;
+    };
+    using DocSnapshotPtr = std::unique_ptr<DocSnapshot>;
+
+    // Creates the snapshot of the document (the document must be
+    // locked for reading). Returns nullptr if it was canceled.
+    DocSnapshotPtr snapshot_document(Doc* doc, doc::CancelIO* cancel);
+
+    // Writes the snapshot in the given directory, the document
+    // doesn't need to be locked.
+    bool write_document_snapshot(const std::string& dir,
+                                 const DocSnapshot* snapshot,
+                                 doc::CancelIO* cancel = nullptr);
+
     bool write_document(const std::string& dir, Doc* doc, doc::CancelIO* cancel);
     void delete_document_internals(Doc* doc);
 
@@ -26,6 +26,7 @@
 #include "app/util/cel_ops.h"
 #include "base/memory.h"
 #include "doc/cel.h"
+#include "doc/image.h"
 #include "doc/layer.h"
 #include "doc/layer_tilemap.h"
 #include "doc/mask.h"
@@ -38,8 +39,11 @@
 #include "os/window.h"
 #include "ui/system.h"
 
+#include <algorithm>
+#include <iterator>
 #include <limits>
 #include <map>
+#include <tuple>
 
 #define DOC_TRACE(...) // TRACEARGS(__VA_ARGS__)
 
@@ -58,6 +62,8 @@ Doc::Doc(Sprite* sprite)
   // Mask
   , m_mask(new Mask())
   , m_lastDrawingPoint(Doc::NoLastDrawingPoint())
+  , m_batchNotifications(0)
+  , m_batchPendingUpdate(false)
 {
   setFilename("Sprite");
 
@@ -212,6 +218,156 @@ void Doc::notifyGeneralUpdate()
   notify_observers<DocEvent&>(&DocObserver::onGeneralUpdate, ev);
 }
 
+namespace {
+
+// Notifications that can be recorded and coalesced in a batch
+using DocEventMethod = void (DocObserver::*)(DocEvent&);
+const DocEventMethod kBatchableMethods[] = {
+  &DocObserver::onLayerNameChange,
+  &DocObserver::onLayerOpacityChange,
+  &DocObserver::onLayerBlendModeChange,
+  &DocObserver::onCelPositionChanged,
+  &DocObserver::onCelOpacityChange,
+  &DocObserver::onCelZIndexChange,
+  &DocObserver::onUserDataChange,
+  &DocObserver::onFrameDurationChanged,
+  &DocObserver::onImagePixelsModified,
+  &DocObserver::onSpritePixelsModified,
+};
+
+// If there are more events than this in a batch, a single
+// onGeneralUpdate() is cheaper than notifying each one.
+constexpr size_t kMaxBatchedEvents = 1024;
+
+} // anonymous namespace
+
+// Batched events keep IDs instead of pointers, so we can check if
+// the objects still exist when the batch ends.
+struct Doc::BatchedEvent {
+  int method;
+  ObjectId sprite;
+  ObjectId layer;
+  ObjectId cel;
+  ObjectId image;
+  ObjectId withUserData;
+  frame_t frame;
+  gfx::Region region;
+
+  auto key() const {
+    return std::make_tuple(method, sprite, layer, cel, image,
+                           withUserData, frame);
+  }
+};
+
+void Doc::beginBatchNotifications()
+{
+  ++m_batchNotifications;
+}
+
+void Doc::endBatchNotifications()
+{
+  ASSERT(m_batchNotifications > 0);
+  if (--m_batchNotifications == 0) {
+    if (!m_batchedEvents.empty())
+      sendBatchedNotifications();
+    if (m_batchPendingUpdate) {
+      m_batchPendingUpdate = false;
+      notifyGeneralUpdate();
+    }
+  }
+}
+
+bool Doc::batchNotification(void (DocObserver::*method)(DocEvent&), DocEvent& ev)
+{
+  auto it = std::find(std::begin(kBatchableMethods),
+                      std::end(kBatchableMethods), method);
+  if (it == std::end(kBatchableMethods))
+    return false;
+
+  // Too many events or fields that we don't record, we'll send an
+  // onGeneralUpdate() at the end.
+  if (m_batchPendingUpdate ||
+      m_batchedEvents.size() >= kMaxBatchedEvents ||
+      ev.tag() || ev.slice() || ev.tileset() || ev.targetLayer() ||
+      ev.imageIndex() >= 0) {
+    m_batchPendingUpdate = true;
+    m_batchedEvents.clear();
+    return true;
+  }
+
+  m_batchedEvents.push_back(
+    BatchedEvent{ int(it - std::begin(kBatchableMethods)),
+                  ev.sprite() ? ev.sprite()->id(): NullId,
+                  ev.layer() ? ev.layer()->id(): NullId,
+                  ev.cel() ? ev.cel()->id(): NullId,
+                  ev.image() ? ev.image()->id(): NullId,
+                  ev.withUserData() ? ev.withUserData()->id(): NullId,
+                  ev.frame(),
+                  ev.region() });
+  return true;
+}
+
+void Doc::sendBatchedNotifications()
+{
+  // Move the events to a local vector as observers might modify the
+  // document (and generate new events) while we notify them.
+  std::vector<BatchedEvent> events;
+  std::swap(events, m_batchedEvents);
+
+  // Coalesce equal events (joining their regions) keeping the order
+  // of the first occurrence.
+  std::map<decltype(events[0].key()), size_t> unique;
+  size_t n = 0;
+  for (size_t i=0; i<events.size(); ++i) {
+    auto result = unique.insert(std::make_pair(events[i].key(), n));
+    if (result.second) {
+      if (n != i)
+        events[n] = std::move(events[i]);
+      ++n;
+    }
+    else {
+      gfx::Region& rgn = events[result.first->second].region;
+      rgn.createUnion(rgn, events[i].region);
+    }
+  }
+  events.resize(n);
+
+  for (const BatchedEvent& batched : events) {
+    DocEvent ev(this);
+    if (batched.sprite) {
+      ev.sprite(doc::get<Sprite>(batched.sprite));
+      if (!ev.sprite()) { m_batchPendingUpdate = true; continue; }
+    }
+    if (batched.layer) {
+      ev.layer(doc::get<Layer>(batched.layer));
+      if (!ev.layer()) { m_batchPendingUpdate = true; continue; }
+    }
+    if (batched.cel) {
+      ev.cel(doc::get<Cel>(batched.cel));
+      if (!ev.cel()) { m_batchPendingUpdate = true; continue; }
+    }
+    if (batched.image) {
+      ev.image(doc::get<Image>(batched.image));
+      if (!ev.image()) { m_batchPendingUpdate = true; continue; }
+    }
+    if (batched.withUserData) {
+      ev.withUserData(doc::get<WithUserData>(batched.withUserData));
+      if (!ev.withUserData()) { m_batchPendingUpdate = true; continue; }
+    }
+    ev.frame(batched.frame);
+    ev.region(batched.region);
+
+    obs::observable<DocObserver>::notify_observers<DocEvent&>(
+      kBatchableMethods[batched.method], ev);
+  }
+
+  // Reuse the memory of the vector in the next batch
+  if (m_batchedEvents.empty()) {
+    events.clear();
+    std::swap(events, m_batchedEvents);
+  }
+}
+
 void Doc::notifyColorSpaceChanged()
 {
   updateOSColorSpace(true);
@@ -228,6 +384,18 @@ void Doc::notifyPaletteChanged()
   notify_observers<DocEvent&>(&DocObserver::onPaletteChanged, ev);
 }
 
+// The given region is in "image" coordinates (tiles for tilemaps),
+// observers must translate it to canvas coordinates using the cels
+// that reference the image.
+void Doc::notifyImagePixelsModified(Image* image, const gfx::Region& region)
+{
+  DocEvent ev(this);
+  ev.sprite(sprite());
+  ev.image(image);
+  ev.region(region);
+  notify_observers<DocEvent&>(&DocObserver::onImagePixelsModified, ev);
+}
+
 void Doc::notifySpritePixelsModified(Sprite* sprite, const gfx::Region& region, frame_t frame)
 {
   DocEvent ev(this);
@@ -418,23 +586,26 @@ void Doc::destroyMaskBoundaries()
 
 void Doc::generateMaskBoundaries(const Mask* mask)
 {
-  m_maskBoundaries.reset();
-
   // No mask specified? Use the current one in the document
   if (!mask) {
-    if (!isMaskVisible())       // The mask is hidden
+    if (!isMaskVisible()) {     // The mask is hidden
+      m_maskBoundaries.reset();
       return;                   // Done, without boundaries
+    }
     else
       mask = this->mask();      // Use the document mask
   }
 
   ASSERT(mask);
 
-  if (!mask->isEmpty()) {
-    m_maskBoundaries.regen(mask->bitmap());
-    m_maskBoundaries.offset(mask->bounds().x,
-                            mask->bounds().y);
-  }
+  // Only the modified area of the mask (compared with the previous
+  // boundaries) is regenerated
+  if (mask->isKnownRectangle())
+    m_maskBoundaries.regen(mask->bounds());
+  else if (!mask->isEmpty())
+    m_maskBoundaries.regen(mask->bitmap(), mask->bounds().origin());
+  else
+    m_maskBoundaries.reset();
 
   notifySelectionBoundariesChanged();
 }
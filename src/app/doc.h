@@ -28,9 +28,12 @@
 #include <atomic>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace doc {
   class Cel;
+  class Image;
   class Layer;
   class LayerTilemap;
   class Mask;
@@ -121,6 +124,7 @@ namespace app {
     void notifyGeneralUpdate();
     void notifyColorSpaceChanged();
     void notifyPaletteChanged();
+    void notifyImagePixelsModified(Image* image, const gfx::Region& region);
     void notifySpritePixelsModified(Sprite* sprite, const gfx::Region& region, frame_t frame);
     void notifyExposeSpritePixels(Sprite* sprite, const gfx::Region& region);
     void notifyLayerMergedDown(Layer* srcLayer, Layer* targetLayer);
@@ -134,6 +138,37 @@ namespace app {
     void notifyLayerGroupCollapseChange(Layer* layer);
     void notifyAfterAddTile(LayerTilemap* layer, frame_t frame, tile_index ti);
 
+    // Batch of notifications: between these calls the notifications
+    // that only mean "redraw this part of the sprite" (pixels
+    // modified, cel/layer properties changed, etc.) are not sent to
+    // observers, they are recorded and coalesced (e.g. all the
+    // modified regions of the same image are joined), and sent when
+    // the last batch ends. If there are too many different events
+    // (or some object was deleted in the middle), a single
+    // onGeneralUpdate() is sent instead. Notifications about
+    // structural changes (add/remove layers, cels, frames, etc.) are
+    // always sent. Used to modify thousands of objects from scripts
+    // or big commands without refreshing the UI on each change.
+    void beginBatchNotifications();
+    void endBatchNotifications();
+    bool isBatchingNotifications() const { return m_batchNotifications > 0; }
+
+    // Hides obs::observable<DocObserver>::notify_observers() to skip
+    // the notifications that can be batched.
+    template<typename ...Args>
+    void notify_observers(void (DocObserver::*method)(Args...), Args ...args) {
+      if (m_batchNotifications > 0) {
+        if (batchNotification(method, args...))
+          return;
+        // Send the recorded events before a structural change so
+        // observers receive them while the objects are still valid.
+        if (!m_batchedEvents.empty())
+          sendBatchedNotifications();
+      }
+      obs::observable<DocObserver>::notify_observers<Args...>(
+        method, std::forward<Args>(args)...);
+    }
+
     //////////////////////////////////////////////////////////////////////
     // File related properties
 
@@ -255,6 +290,13 @@ namespace app {
     void removeFromContext();
     void updateOSColorSpace(bool appWideSignal);
 
+    // Records the notification if it can be batched (returns false
+    // if it must be sent now).
+    template<typename Method, typename ...Args>
+    bool batchNotification(Method, Args&&...) { return false; }
+    bool batchNotification(void (DocObserver::*method)(DocEvent&), DocEvent& ev);
+    void sendBatchedNotifications();
+
     // The document is in the collection of documents of this context.
     Context* m_ctx;
 
@@ -291,6 +333,17 @@ namespace app {
     // Last used color space to render a sprite.
     os::ColorSpaceRef m_osColorSpace;
 
+    // Number of nested beginBatchNotifications() calls, and true if
+    // a notification was skipped in the current batch (so we have to
+    // send an onGeneralUpdate()).
+    int m_batchNotifications;
+    bool m_batchPendingUpdate;
+
+    // Notifications recorded in the current batch (the vector is
+    // reused between batches to avoid allocating it each time)
+    struct BatchedEvent;
+    std::vector<BatchedEvent> m_batchedEvents;
+
     DISABLE_COPYING(Doc);
   };
 
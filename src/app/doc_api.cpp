@@ -21,6 +21,7 @@
 #include "app/cmd/flip_image.h"
 #include "app/cmd/move_cel.h"
 #include "app/cmd/move_layer.h"
+#include "app/cmd/permute_frames.h"
 #include "app/cmd/remove_cel.h"
 #include "app/cmd/remove_frame.h"
 #include "app/cmd/remove_layer.h"
@@ -461,6 +462,60 @@ void DocApi::moveFrame(Sprite* sprite,
   }
 }
 
+void DocApi::moveFrames(Sprite* sprite,
+                        const std::vector<FrameMove>& moves,
+                        const TagsHandling tagsHandling)
+{
+  // Original frame in each position after the moves
+  std::vector<frame_t> order(sprite->totalFrames());
+  for (frame_t i=0; i<frame_t(order.size()); ++i)
+    order[i] = i;
+
+  for (const FrameMove& move : moves) {
+    const frame_t frame = move.frame;
+    frame_t targetFrame = move.targetFrame;
+    const frame_t beforeFrame =
+      (move.dropFramePlace == kDropBeforeFrame ? targetFrame: targetFrame+1);
+
+    // Same conditions as moveFrame()
+    if (frame       >= 0 && frame       <= sprite->lastFrame()   &&
+        beforeFrame >= 0 && beforeFrame <= sprite->lastFrame()+1 &&
+        ((frame != beforeFrame) ||
+         (!sprite->tags().empty() &&
+          tagsHandling != kDontAdjustTags))) {
+      if (tagsHandling != kDontAdjustTags) {
+        adjustTags(sprite, frame, -1, move.dropFramePlace, tagsHandling);
+        if (targetFrame >= frame)
+          --targetFrame;
+        adjustTags(sprite, targetFrame, +1, move.dropFramePlace, tagsHandling);
+      }
+
+      if (frame < beforeFrame) {
+        const frame_t f = order[frame];
+        order.erase(order.begin()+frame);
+        order.insert(order.begin()+beforeFrame-1, f);
+      }
+      else if (beforeFrame < frame) {
+        const frame_t f = order[frame];
+        order.erase(order.begin()+frame);
+        order.insert(order.begin()+beforeFrame, f);
+      }
+    }
+  }
+
+  // New position of each original frame
+  std::vector<frame_t> newFrames(order.size());
+  bool identity = true;
+  for (frame_t i=0; i<frame_t(order.size()); ++i) {
+    newFrames[order[i]] = i;
+    if (order[i] != i)
+      identity = false;
+  }
+
+  if (!identity)
+    m_transaction.execute(new cmd::PermuteFrames(sprite, newFrames));
+}
+
 void DocApi::moveFrameLayer(Layer* layer, frame_t frame, frame_t beforeFrame)
 {
   ASSERT(layer);
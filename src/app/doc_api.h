@@ -18,6 +18,7 @@
 #include "gfx/rect.h"
 
 #include <map>
+#include <vector>
 
 namespace doc {
   class Cel;
@@ -72,6 +73,17 @@ namespace app {
                    const DropFramePlace dropFramePlace,
                    const TagsHandling tagsHandling);
 
+    // Equivalent to calling moveFrame() for each move, but cels and
+    // frame durations are reordered with just one cmd::PermuteFrames.
+    struct FrameMove {
+      frame_t frame;
+      frame_t targetFrame;
+      DropFramePlace dropFramePlace;
+    };
+    void moveFrames(Sprite* sprite,
+                    const std::vector<FrameMove>& moves,
+                    const TagsHandling tagsHandling);
+
     // Cels API
     void addCel(LayerImage* layer, Cel* cel);
     Cel* addCel(LayerImage* layer, frame_t frameNumber, const ImageRef& image);
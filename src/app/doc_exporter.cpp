@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -21,10 +21,11 @@
 #include "app/restore_visible_layers.h"
 #include "app/snap_to_grid.h"
 #include "app/util/autocrop.h"
+#include "app/util/parallel_tasks.h"
+#include "app/util/skyline_packer.h"
 #include "base/convert_to.h"
 #include "base/fs.h"
 #include "base/fstream_path.h"
-#include "base/replace_string.h"
 #include "base/string.h"
 #include "doc/algorithm/shrink_bounds.h"
 #include "doc/cel.h"
@@ -48,12 +49,17 @@
 #include "ver/info.h"
 
 #include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
 #include <cstdio>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <set>
+#include <thread>
+#include <tuple>
 #include <vector>
 
 #define DX_TRACE(...) // TRACEARGS
@@ -62,32 +68,172 @@ using namespace doc;
 
 namespace {
 
-std::string escape_for_json(const std::string& path)
-{
-  std::string res = path;
-  base::replace_string(res, "\\", "\\\\");
-  base::replace_string(res, "\"", "\\\"");
-  return res;
-}
+// Size of the chunks written to the output stream by the data file
+// writers.
+constexpr size_t kDataBufferSize = 64*1024;
+
+// Formats the JSON data in a preallocated buffer that is written to
+// the stream in big chunks, so we avoid one std::ostream call (and
+// locale-aware number formatting) for each token of each frame.
+class JsonWriter {
+public:
+  struct Escaped {
+    const std::string& str;
+  };
+
+  explicit JsonWriter(std::ostream& os) : m_os(os) {
+    m_buf.reserve(kDataBufferSize + 1024);
+  }
+
+  ~JsonWriter() {
+    flush();
+  }
+
+  JsonWriter& operator<<(const char* str) {
+    m_buf.append(str);
+    return check();
+  }
+
+  JsonWriter& operator<<(const std::string& str) {
+    m_buf.append(str);
+    return check();
+  }
+
+  JsonWriter& operator<<(const int value) {
+    char tmp[16];
+    auto res = std::to_chars(tmp, tmp+sizeof(tmp), value);
+    m_buf.append(tmp, res.ptr);
+    return check();
+  }
 
-std::ostream& operator<<(std::ostream& os, const doc::UserData& data)
+  // Adds the given string escaping backslashes and quotes in one
+  // pass (most strings don't need escaping at all).
+  JsonWriter& operator<<(const Escaped& escaped) {
+    const std::string& str = escaped.str;
+    size_t i = 0;
+    for (size_t j=0; j<str.size(); ++j) {
+      if (str[j] == '\\' || str[j] == '"') {
+        m_buf.append(str, i, j-i);
+        m_buf.push_back('\\');
+        i = j;
+      }
+    }
+    m_buf.append(str, i, std::string::npos);
+    return check();
+  }
+
+  JsonWriter& operator<<(const doc::UserData& data) {
+    static const char* kHex = "0123456789abcdef";
+    doc::color_t color = data.color();
+    if (doc::rgba_geta(color)) {
+      const int comps[] = { doc::rgba_getr(color),
+                            doc::rgba_getg(color),
+                            doc::rgba_getb(color),
+                            doc::rgba_geta(color) };
+      m_buf.append(", \"color\": \"#");
+      for (int c : comps) {
+        m_buf.push_back(kHex[(c >> 4) & 15]);
+        m_buf.push_back(kHex[c & 15]);
+      }
+      m_buf.push_back('"');
+    }
+    if (!data.text().empty())
+      *this << ", \"data\": \"" << Escaped{ data.text() } << "\"";
+    return check();
+  }
+
+  void flush() {
+    if (!m_buf.empty()) {
+      m_os.write(m_buf.data(), m_buf.size());
+      m_buf.clear();
+    }
+  }
+
+private:
+  JsonWriter& check() {
+    if (m_buf.size() >= kDataBufferSize)
+      flush();
+    return *this;
+  }
+
+  std::ostream& m_os;
+  std::string m_buf;
+};
+
+JsonWriter::Escaped escape_for_json(const std::string& str)
 {
-  doc::color_t color = data.color();
-  if (doc::rgba_geta(color)) {
-    os << ", \"color\": \"#"
-       << std::hex << std::setfill('0')
-       << std::setw(2) << (int)doc::rgba_getr(color)
-       << std::setw(2) << (int)doc::rgba_getg(color)
-       << std::setw(2) << (int)doc::rgba_getb(color)
-       << std::setw(2) << (int)doc::rgba_geta(color)
-       << std::dec
-       << "\"";
-  }
-  if (!data.text().empty())
-    os << ", \"data\": \"" << escape_for_json(data.text()) << "\"";
-  return os;
+  return JsonWriter::Escaped{ str };
 }
 
+// Writes little-endian binary data in a preallocated buffer for the
+// SpriteSheetDataFormat::Binary data file.
+class BinaryWriter {
+public:
+  explicit BinaryWriter(std::ostream& os) : m_os(os) {
+    m_buf.reserve(kDataBufferSize + 1024);
+  }
+
+  ~BinaryWriter() {
+    flush();
+  }
+
+  void write8(const int value) {
+    m_buf.push_back(char(value & 0xff));
+    check();
+  }
+
+  void write16(const int value) {
+    m_buf.push_back(char(value & 0xff));
+    m_buf.push_back(char((value >> 8) & 0xff));
+    check();
+  }
+
+  void write32(const int value) {
+    const uint32_t v = uint32_t(value);
+    m_buf.push_back(char(v & 0xff));
+    m_buf.push_back(char((v >> 8) & 0xff));
+    m_buf.push_back(char((v >> 16) & 0xff));
+    m_buf.push_back(char((v >> 24) & 0xff));
+    check();
+  }
+
+  void writeRect(const gfx::Rect& rc) {
+    write32(rc.x);
+    write32(rc.y);
+    write32(rc.w);
+    write32(rc.h);
+  }
+
+  // Strings are stored as a 32-bit length + UTF-8 bytes (without
+  // the null character).
+  void writeString(const std::string& str) {
+    write32(int(str.size()));
+    m_buf.append(str);
+    check();
+  }
+
+  void writeBytes(const char* bytes, const size_t n) {
+    m_buf.append(bytes, n);
+    check();
+  }
+
+  void flush() {
+    if (!m_buf.empty()) {
+      m_os.write(m_buf.data(), m_buf.size());
+      m_buf.clear();
+    }
+  }
+
+private:
+  void check() {
+    if (m_buf.size() >= kDataBufferSize)
+      flush();
+  }
+
+  std::ostream& m_os;
+  std::string m_buf;
+};
+
 } // anonymous namespace
 
 namespace app {
@@ -182,6 +328,7 @@ public:
                                                       nullptr);
   }
   const Tag* tag() const { return m_tag; }
+  const ImageRef& image() const { return m_image; }
   SelectedLayers* selectedLayers() const { return m_selLayers; }
   frame_t frame() const { return m_frame; }
   std::string filename() const { return m_filename; }
@@ -223,6 +370,23 @@ public:
     m_inTextureBounds = bounds;
   }
 
+  // Render of the sample (made to trim it) that can be copied to the
+  // texture instead of rendering the sprite again. "bounds" is the
+  // area of the sample that this render contains.
+  void setRender(const ImageRef& render, const gfx::Rect& bounds) {
+    m_render = render;
+    m_renderBounds = bounds;
+  }
+
+  // Returns true if the sample can be copied from its render to
+  // the given destination image (i.e. it doesn't depend on the
+  // layers visibility).
+  bool canCopyRender(const doc::Image* dst) const {
+    return (m_render &&
+            m_render->pixelFormat() == dst->pixelFormat() &&
+            m_renderBounds.contains(m_trimmedBounds));
+  }
+
   bool isLinked() const { return m_isLinked; }
   bool isDuplicated() const { return m_isDuplicated; }
   bool isEmpty() const {
@@ -235,7 +399,11 @@ public:
   void setLinked() { m_isLinked = true; }
   void setDuplicated() { m_isDuplicated = true; }
 
-  ImageRef createRender(ImageBufferPtr& imageBuf) {
+  // If "showSelectedLayers" is false, the caller must show the
+  // selected layers before rendering the sample (useful to render
+  // several samples from different threads).
+  ImageRef createRender(ImageBufferPtr& imageBuf,
+                        const bool showSelectedLayers = true) const {
     ASSERT(m_sprite);
 
     // We use the m_image as it is, it doesn't require a special
@@ -250,13 +418,23 @@ public:
                     imageBuf));
     render->setMaskColor(m_sprite->transparentColor());
     clear_image(render.get(), m_sprite->transparentColor());
-    renderSample(render.get(), 0, 0, false);
+    renderSample(render.get(), 0, 0, false, showSelectedLayers);
     return render;
   }
 
-  void renderSample(doc::Image* dst, int x, int y, bool extrude) const {
+  void renderSample(doc::Image* dst, int x, int y, bool extrude,
+                    const bool showSelectedLayers = true) const {
+    // Images (e.g. tiles) are copied directly row by row, we don't
+    // need to change the layers visibility or render the sprite.
+    if (m_image && !extrude) {
+      dst->copy(m_image.get(), gfx::Clip(x, y, m_trimmedBounds));
+      return;
+    }
+
+    const bool copyRender = canCopyRender(dst);
+
     RestoreVisibleLayers layersVisibility;
-    if (m_selLayers)
+    if (m_selLayers && showSelectedLayers && !copyRender)
       layersVisibility.showSelectedLayers(m_sprite,
                                           *m_selLayers);
 
@@ -266,6 +444,19 @@ public:
     // 2) We should use the new blend mode always when we're saving files
     //render.setNewBlend(Preferences::instance().experimental.newBlend());
 
+    auto renderClip = [this, dst, copyRender, &render](gfx::Clip clip) {
+      if (m_image) {
+        dst->copy(m_image.get(), clip);
+      }
+      else if (copyRender) {
+        clip.src -= m_renderBounds.origin();
+        dst->copy(m_render.get(), clip);
+      }
+      else {
+        render.renderSprite(dst, m_sprite, m_frame, clip);
+      }
+    };
+
     if (extrude) {
       const gfx::Rect& trim = m_trimmedBounds;
 
@@ -287,24 +478,13 @@ public:
       // side.
       for (int j=0; j<3; ++j) {
         for (int i=0; i<3; ++i) {
-          gfx::Clip clip(x+dx[i], y+dy[j], gfx::RectT<int>(srcx[i], srcy[j], szx[i], szy[j]));
-          if (m_image) {
-            dst->copy(m_image.get(), clip);
-          }
-          else {
-            render.renderSprite(dst, m_sprite, m_frame, clip);
-          }
+          renderClip(gfx::Clip(x+dx[i], y+dy[j],
+                               gfx::RectT<int>(srcx[i], srcy[j], szx[i], szy[j])));
         }
       }
     }
     else {
-      gfx::Clip clip(x, y, m_trimmedBounds);
-      if (m_image) {
-        dst->copy(m_image.get(), clip);
-      }
-      else {
-        render.renderSprite(dst, m_sprite, m_frame, clip);
-      }
+      renderClip(gfx::Clip(x, y, m_trimmedBounds));
     }
   }
 
@@ -325,6 +505,8 @@ private:
   gfx::Size m_originalSize;
   gfx::Rect m_trimmedBounds;
   SharedRectPtr m_inTextureBounds;
+  ImageRef m_render;
+  gfx::Rect m_renderBounds;
 };
 
 class DocExporter::Samples {
@@ -337,6 +519,12 @@ public:
   int size() const { return int(m_samples.size()); }
 
   void addSample(const Sample& sample) {
+    // Only the first sample of each sprite/layer/frame is indexed
+    // (e.g. the first cell when the sprite is split by grid)
+    m_samplesByFrame.emplace(
+      FrameKey(sample.sprite(), sample.layer(), sample.frame()),
+      int(m_samples.size()));
+
     m_samples.push_back(sample);
   }
 
@@ -344,13 +532,27 @@ public:
     return m_samples[i];
   }
 
+  // Returns the first sample added for the given sprite/layer/frame
+  // (or nullptr if there is no such sample).
+  const Sample* findSample(const Sprite* sprite,
+                           const Layer* layer,
+                           const frame_t frame) const {
+    auto it = m_samplesByFrame.find(FrameKey(sprite, layer, frame));
+    if (it != m_samplesByFrame.end())
+      return &m_samples[it->second];
+    return nullptr;
+  }
+
   iterator begin() { return m_samples.begin(); }
   iterator end() { return m_samples.end(); }
   const_iterator begin() const { return m_samples.begin(); }
   const_iterator end() const { return m_samples.end(); }
 
 private:
+  using FrameKey = std::tuple<const Sprite*, const Layer*, frame_t>;
+
   List m_samples;
+  std::map<FrameKey, int> m_samplesByFrame;
 };
 
 class DocExporter::LayoutSamples {
@@ -420,8 +622,9 @@ public:
       if (m_mergeDups || sample.isLinked()) {
         doc::ImageBufferPtr sampleBuf = std::make_shared<doc::ImageBuffer>();
         doc::ImageRef sampleRender(sample.createRender(sampleBuf));
-        auto it = duplicates.find(sampleRender);
-        if (it != duplicates.end()) {
+        // Hash the sample image just one time to find/insert it
+        auto [it, inserted] = duplicates.emplace(sampleRender, i);
+        if (!inserted) {
           const uint32_t j = it->second;
 
           sample.setDuplicated();
@@ -429,9 +632,6 @@ public:
           ++i;
           continue;
         }
-        else {
-          duplicates[sampleRender] = i;
-        }
       }
 
       const Sprite* sprite = sample.sprite();
@@ -528,14 +728,35 @@ private:
 
 class DocExporter::BestFitLayoutSamples : public DocExporter::LayoutSamples {
 public:
+  // With "fastPacking" we use a skyline packer, which is much faster
+  // than gfx::PackingRects with lots of samples (but the texture can
+  // be a little bigger).
+  BestFitLayoutSamples(const bool fastPacking)
+    : m_fastPacking(fastPacking) {
+  }
+
   void layoutSamples(Samples& samples,
                      int borderPadding,
                      int shapePadding,
                      int& width, int& height,
                      base::task_token& token) override {
-    gfx::PackingRects pr(borderPadding, shapePadding);
-    doc::ImagesMap duplicates;
+    if (m_fastPacking) {
+      SkylinePacker packer(borderPadding, shapePadding);
+      layoutSamplesWithPacker(packer, samples, width, height, token);
+    }
+    else {
+      gfx::PackingRects packer(borderPadding, shapePadding);
+      layoutSamplesWithPacker(packer, samples, width, height, token);
+    }
+  }
 
+private:
+  template<typename Packer>
+  void layoutSamplesWithPacker(Packer& pr,
+                               Samples& samples,
+                               int& width, int& height,
+                               base::task_token& token) {
+    doc::ImagesMap duplicates;
     uint32_t i = 0;
     for (auto& sample : samples) {
       if (token.canceled())
@@ -552,15 +773,14 @@ public:
       // going to store all images in the "duplicates" map.
       doc::ImageBufferPtr sampleBuf = std::make_shared<doc::ImageBuffer>();
       doc::ImageRef sampleRender(sample.createRender(sampleBuf));
-      auto it = duplicates.find(sampleRender);
-      if (it != duplicates.end()) {
+      auto [it, inserted] = duplicates.emplace(sampleRender, i);
+      if (!inserted) {
         const uint32_t j = it->second;
 
         sample.setDuplicated();
         sample.setSharedBounds(samples[j].sharedBounds());
       }
       else {
-        duplicates[sampleRender] = i;
         pr.add(sample.requiredSize());
       }
       ++i;
@@ -588,6 +808,8 @@ public:
       sample.setInTextureBounds(*(it++));
     }
   }
+
+  bool m_fastPacking;
 };
 
 DocExporter::DocExporter()
@@ -615,6 +837,7 @@ void DocExporter::reset()
   m_innerPadding = 0;
   m_ignoreEmptyCels = false;
   m_mergeDuplicates = false;
+  m_fastPacking = false;
   m_trimSprite = false;
   m_trimCels = false;
   m_trimByGrid = false;
@@ -658,7 +881,9 @@ Doc* DocExporter::exportSheet(Context* ctx, base::task_token& token)
       }
     }
 
-    fos.open(FSTREAM_PATH(m_dataFilename), std::ios::out);
+    fos.open(FSTREAM_PATH(m_dataFilename),
+             (m_dataFormat == SpriteSheetDataFormat::Binary ?
+              std::ios::out | std::ios::binary: std::ios::out));
     osbuf = fos.rdbuf();
   }
   std::ostream os(osbuf);
@@ -880,15 +1105,266 @@ int DocExporter::addTilesetsSamples(
   return items;
 }
 
+void DocExporter::checkEmptyImages(base::task_token& token)
+{
+  std::vector<const Image*> images;
+  for (const auto& item : m_documents) {
+    if (!item.isOneImageOnly())
+      continue;
+
+    auto it = m_emptyImages.find(item.image->id());
+    if (it == m_emptyImages.end() ||
+        it->second.version != item.image->version())
+      images.push_back(item.image.get());
+  }
+  if (images.empty())
+    return;
+
+  DX_TRACE("DX: Check empty images", images.size());
+
+  // Each image is checked in its own thread, the results are saved
+  // in the cache later.
+  const int nimages = int(images.size());
+  std::vector<char> empty(nimages, 0);
+  std::atomic<int> next(0);
+  run_parallel_tasks(
+    std::min<int>(nimages, std::thread::hardware_concurrency()),
+    [&](const std::atomic<bool>& stop){
+      while (!stop) {
+        const int i = next++;
+        if (i >= nimages)
+          break;
+        empty[i] = is_empty_image(images[i]);
+      }
+    },
+    [&]{
+      return !token.canceled();
+    });
+
+  if (token.canceled())
+    return;
+
+  for (int i=0; i<nimages; ++i)
+    m_emptyImages[images[i]->id()] = EmptyImage{ images[i]->version(),
+                                                 empty[i] != 0 };
+}
+
+bool DocExporter::isEmptyImage(const Image* image) const
+{
+  auto it = m_emptyImages.find(image->id());
+  if (it != m_emptyImages.end() &&
+      it->second.version == image->version())
+    return it->second.empty;
+  return is_empty_image(image);
+}
+
 void DocExporter::captureSamples(Samples& samples,
                                  base::task_token& token)
 {
   DX_TRACE("DX: Capture samples");
 
-  for (auto& item : m_documents) {
+  // Check the emptiness of all images (tiles) at once
+  if (m_ignoreEmptyCels)
+    checkEmptyImages(token);
+
+  // Returns the sprite bounds to export (trimmed if "Trim Sprite" is
+  // enabled).
+  auto calcSpriteBounds = [this](const Sprite* sprite) -> gfx::Rect {
+    gfx::Rect spriteBounds = sprite->bounds();
+    if (m_trimSprite) {
+      if (m_cache.spriteId == sprite->id() &&
+          m_cache.spriteVer == sprite->version() &&
+          m_cache.trimmedByGrid == m_trimByGrid) {
+        spriteBounds = m_cache.trimmedBounds;
+      }
+      else {
+        spriteBounds = get_trimmed_bounds(sprite, m_trimByGrid);
+        if (spriteBounds.isEmpty())
+          spriteBounds = gfx::Rect(0, 0, 1, 1);
+
+        // Cache trimmed bounds so we don't have to recalculate them
+        // in the next iteration/preview.
+        m_cache.spriteId = sprite->id();
+        m_cache.spriteVer = sprite->version();
+        m_cache.trimmedByGrid = m_trimByGrid;
+        m_cache.trimmedBounds = spriteBounds;
+      }
+    }
+    return spriteBounds;
+  };
+
+  // Renders the sample and calculates its bounds without the
+  // transparent/background borders. Returns false if the whole
+  // sample is transparent. If "trimmedRender" is given, the trimmed
+  // area of the render is copied there.
+  auto shrinkSample = [this]
+    (const Sample& sample,
+     const gfx::Rect& spriteBounds,
+     ImageBufferPtr& imageBuf,
+     const bool showSelectedLayers,
+     gfx::Rect& frameBounds,
+     ImageRef* trimmedRender) -> bool {
+      const Sprite* sprite = sample.sprite();
+      const Layer* layer = sample.layer();
+      ImageRef sampleRender(sample.createRender(imageBuf, showSelectedLayers));
+      doc::color_t refColor = 0;
+
+      if (m_trimCels) {
+        if ((layer &&
+             layer->isBackground()) ||
+            (!layer &&
+             sprite->backgroundLayer() &&
+             sprite->backgroundLayer()->isVisible())) {
+          refColor = get_pixel(sampleRender.get(), 0, 0);
+        }
+        else {
+          refColor = sprite->transparentColor();
+        }
+      }
+      else if (m_ignoreEmptyCels)
+        refColor = sprite->transparentColor();
+
+      const bool nonEmpty =
+        algorithm::shrink_bounds(sampleRender.get(),
+                                 refColor,
+                                 nullptr,        // layer
+                                 spriteBounds,   // startBounds
+                                 frameBounds);   // output bounds
+
+      // The "sampleRender" uses the "imageBuf" memory, so we copy the
+      // trimmed area to keep it.
+      if (trimmedRender && nonEmpty)
+        trimmedRender->reset(crop_image(sampleRender.get(), frameBounds,
+                                        sprite->transparentColor()));
+      return nonEmpty;
+    };
+
+  // Render and shrink the samples of all items in parallel (the
+  // results are used in the sequential loop below, so the output is
+  // the same as shrinking each sample in order). Items with the same
+  // sprite/layers (e.g. the items of each tag with --split-tags) are
+  // in the same group, so each frame is rendered only once and the
+  // frames of all these items are rendered concurrently.
+  struct ShrinkResult {
+    bool nonEmpty = false;
+    gfx::Rect bounds;
+    ImageRef render;            // Render of the trimmed bounds
+  };
+  struct ShrinkGroup {
+    Doc* doc;
+    SelectedLayers* selLayers;
+    gfx::Size sampleSize;
+    std::vector<frame_t> frames;
+    std::map<frame_t, ShrinkResult> results;
+  };
+  std::vector<ShrinkGroup> groups;
+  std::vector<int> itemGroups(m_documents.size(), -1);
+
+  if (m_ignoreEmptyCels || m_trimCels) {
+    int nframes = 0;
+    for (int i=0; i<int(m_documents.size()); ++i) {
+      const Item& item = m_documents[i];
+      if (item.isOneImageOnly())
+        continue;
+
+      Sprite* sprite = item.doc->sprite();
+      SelectedLayers* selLayers = item.selLayers.get();
+      const Layer* layer = (selLayers && selLayers->size() == 1 ?
+                            *selLayers->begin(): nullptr);
+      const gfx::Size sampleSize =
+        (item.splitGrid ? sprite->gridBounds().size():
+                          sprite->size());
+
+      auto it = std::find_if(
+        groups.begin(), groups.end(),
+        [&](const ShrinkGroup& group){
+          return (group.doc == item.doc &&
+                  group.sampleSize == sampleSize &&
+                  ((!group.selLayers && !selLayers) ||
+                   (group.selLayers && selLayers &&
+                    *group.selLayers == *selLayers)));
+        });
+      if (it == groups.end()) {
+        groups.push_back(ShrinkGroup{ item.doc, selLayers, sampleSize });
+        it = groups.end()-1;
+      }
+      itemGroups[i] = int(it - groups.begin());
+
+      for (frame_t frame : item.getSelectedFrames()) {
+        const Cel* cel = (layer && layer->isImage() ? layer->cel(frame): nullptr);
+        // Skip empty cels that will be ignored and linked cels that
+        // (probably) re-use the bounds of other sample
+        if ((layer && layer->isImage() && !cel && m_ignoreEmptyCels) ||
+            (cel && cel->link() && m_mergeDuplicates))
+          continue;
+
+        if (it->results.emplace(frame, ShrinkResult()).second) {
+          it->frames.push_back(frame);
+          ++nframes;
+        }
+      }
+    }
+
+    // Only the trimmed area is kept to render the texture (with
+    // "Trim by Grid" the sample bounds are bigger than the trimmed
+    // area, so the sample is rendered again).
+    const bool keepRender = (m_trimCels && !m_trimByGrid);
+    std::atomic<int> done(0);
+
+    for (ShrinkGroup& group : groups) {
+      if (token.canceled())
+        return;
+      if (group.frames.empty())
+        continue;
+
+      const gfx::Rect spriteBounds = calcSpriteBounds(group.doc->sprite());
+      std::vector<ShrinkResult*> results;
+      for (frame_t frame : group.frames)
+        results.push_back(&group.results[frame]);
+
+      // The layers visibility is modified just one time for all
+      // threads.
+      RestoreVisibleLayers layersVisibility;
+      if (group.selLayers)
+        layersVisibility.showSelectedLayers(group.doc->sprite(), *group.selLayers);
+
+      const int npending = int(group.frames.size());
+      std::atomic<int> next(0);
+      run_parallel_tasks(
+        std::min<int>(npending, std::thread::hardware_concurrency()),
+        [&](const std::atomic<bool>& stop){
+          ImageBufferPtr imageBuf = std::make_shared<doc::ImageBuffer>();
+          while (!stop) {
+            const int i = next++;
+            if (i >= npending)
+              break;
+
+            Sample sample(group.sampleSize, group.doc, group.doc->sprite(),
+                          ImageRef(), group.selLayers,
+                          group.frames[i], nullptr,
+                          std::string(), m_innerPadding, m_extrude);
+            ShrinkResult* result = results[i];
+            result->nonEmpty = shrinkSample(sample, spriteBounds, imageBuf, false,
+                                            result->bounds,
+                                            (keepRender ? &result->render: nullptr));
+            ++done;
+          }
+        },
+        [&]{
+          token.set_progress(0.2f * done / nframes);
+          return !token.canceled();
+        });
+
+      if (token.canceled())
+        return;
+    }
+  }
+
+  for (int itemIndex=0; itemIndex<int(m_documents.size()); ++itemIndex) {
     if (token.canceled())
       return;
 
+    const Item& item = m_documents[itemIndex];
     Doc* doc = item.doc;
     Sprite* sprite = doc->sprite();
     Layer* layer = (item.selLayers && item.selLayers->size() == 1 ?
@@ -919,30 +1395,20 @@ void DocExporter::captureSamples(Samples& samples,
     }
     // This item comes from the sprite canvas
     else {
-      spriteBounds = sprite->bounds();
-      if (m_trimSprite) {
-        if (m_cache.spriteId == sprite->id() &&
-            m_cache.spriteVer == sprite->version() &&
-            m_cache.trimmedByGrid == m_trimByGrid) {
-          spriteBounds = m_cache.trimmedBounds;
-        }
-        else {
-          spriteBounds = get_trimmed_bounds(sprite, m_trimByGrid);
-          if (spriteBounds.isEmpty())
-            spriteBounds = gfx::Rect(0, 0, 1, 1);
-
-          // Cache trimmed bounds so we don't have to recalculate them
-          // in the next iteration/preview.
-          m_cache.spriteId = sprite->id();
-          m_cache.spriteVer = sprite->version();
-          m_cache.trimmedByGrid = m_trimByGrid;
-          m_cache.trimmedBounds = spriteBounds;
-        }
-      }
+      spriteBounds = calcSpriteBounds(sprite);
     }
 
+    const gfx::Size sampleSize =
+      (item.image ? item.image->size():
+       item.splitGrid ? sprite->gridBounds().size():
+                        sprite->size());
+
+    const doc::SelectedFrames selFrames = item.getSelectedFrames();
+    const ShrinkGroup* shrinkGroup =
+      (itemGroups[itemIndex] >= 0 ? &groups[itemGroups[itemIndex]]: nullptr);
+
     frame_t outputFrame = 0;
-    for (frame_t frame : item.getSelectedFrames()) {
+    for (frame_t frame : selFrames) {
       if (token.canceled())
         return;
 
@@ -964,9 +1430,7 @@ void DocExporter::captureSamples(Samples& samples,
       std::string filename = filename_formatter(format, fnInfo);
 
       Sample sample(
-        (item.image ? item.image->size():
-         item.splitGrid ? sprite->gridBounds().size():
-                          sprite->size()),
+        sampleSize,
         doc, sprite, item.image, item.selLayers.get(),
         frame, innerTag, filename,
         m_innerPadding, m_extrude);
@@ -984,22 +1448,15 @@ void DocExporter::captureSamples(Samples& samples,
       bool alreadyTrimmed = false;
       if (link && m_mergeDuplicates &&
           !item.isOneImageOnly()) {
-        for (const Sample& other : samples) {
-          if (token.canceled())
-            return;
-
-          if (other.sprite() == sprite &&
-              other.layer() == layer &&
-              other.frame() == link->frame()) {
-            ASSERT(!other.isLinked());
-
-            sample.setLinked();
-            sample.setTrimmedBounds(other.trimmedBounds());
-            sample.setSharedBounds(other.sharedBounds());
-            alreadyTrimmed = true;
-            done = true;
-            break;
-          }
+        if (const Sample* other = samples.findSample(sprite, layer,
+                                                     link->frame())) {
+          ASSERT(!other->isLinked());
+
+          sample.setLinked();
+          sample.setTrimmedBounds(other->trimmedBounds());
+          sample.setSharedBounds(other->sharedBounds());
+          alreadyTrimmed = true;
+          done = true;
         }
         // "done" variable can be false here, e.g. when we export a
         // frame tag and the first linked cel is outside the tag range.
@@ -1012,31 +1469,24 @@ void DocExporter::captureSamples(Samples& samples,
         if (layer && layer->isImage() && !cel && m_ignoreEmptyCels)
           continue;
 
-        ImageRef sampleRender(sample.createRender(m_sampleBuf));
-
         gfx::Rect frameBounds;
-        doc::color_t refColor = 0;
-
-        if (m_trimCels) {
-          if ((layer &&
-               layer->isBackground()) ||
-              (!layer &&
-               sprite->backgroundLayer() &&
-               sprite->backgroundLayer()->isVisible())) {
-            refColor = get_pixel(sampleRender.get(), 0, 0);
-          }
-          else {
-            refColor = sprite->transparentColor();
-          }
+        bool nonEmpty;
+        const ShrinkResult* result = nullptr;
+        if (shrinkGroup) {
+          auto it = shrinkGroup->results.find(frame);
+          if (it != shrinkGroup->results.end())
+            result = &it->second;
+        }
+        if (result) {
+          nonEmpty = result->nonEmpty;
+          frameBounds = result->bounds;
+        }
+        else {
+          nonEmpty = shrinkSample(sample, spriteBounds, m_sampleBuf, true,
+                                  frameBounds, nullptr);
         }
-        else if (m_ignoreEmptyCels)
-          refColor = sprite->transparentColor();
 
-        if (!algorithm::shrink_bounds(sampleRender.get(),
-                                      refColor,
-                                      nullptr,        // layer
-                                      spriteBounds,   // startBounds
-                                      frameBounds)) { // output bounds
+        if (!nonEmpty) {
           // If shrink_bounds() returns false, it's because the whole
           // image is transparent (equal to the mask color).
 
@@ -1068,12 +1518,17 @@ void DocExporter::captureSamples(Samples& samples,
           }
           sample.setTrimmedBounds(frameBounds);
           alreadyTrimmed = true;
+
+          // Copy the render to the texture instead of rendering the
+          // sample again
+          if (nonEmpty && result && result->render)
+            sample.setRender(result->render, result->bounds);
         }
       }
       // If "Ignore Empty" is checked and the item is a tile...
       else if (m_ignoreEmptyCels && item.isOneImageOnly()) {
         // Skip empty tile
-        if (is_empty_image(item.image.get()))
+        if (isEmptyImage(item.image.get()))
           continue;
       }
 
@@ -1115,7 +1570,7 @@ void DocExporter::layoutSamples(Samples& samples,
 
   switch (m_sheetType) {
     case SpriteSheetType::Packed: {
-      BestFitLayoutSamples layout;
+      BestFitLayoutSamples layout(m_fastPacking);
       layout.layoutSamples(
         samples, m_borderPadding, m_shapePadding,
         width, height, token);
@@ -1273,21 +1728,20 @@ void DocExporter::renderTexture(Context* ctx,
 {
   textureImage->clear(textureImage->maskColor());
 
-  int i = 0;
+  std::vector<const Sample*> samplesToRender;
   for (const auto& sample : samples) {
     if (token.canceled())
       return;
-    token.set_progress(0.6f + 0.2f * i / int(samples.size()));
 
     if (sample.isLinked() ||
         sample.isDuplicated() ||
         sample.isEmpty()) {
-      ++i;
       continue;
     }
 
     // Make the sprite compatible with the texture so the render()
-    // works correctly.
+    // works correctly. This modifies the sprite, so it must be done
+    // before rendering the samples in other threads.
     if (sample.sprite()->pixelFormat() != textureImage->pixelFormat()) {
       cmd::SetPixelFormat(
         sample.sprite(),
@@ -1299,12 +1753,84 @@ void DocExporter::renderTexture(Context* ctx,
         .execute(ctx);
     }
 
-    sample.renderSample(
+    samplesToRender.push_back(&sample);
+  }
+
+  auto renderSample = [this, textureImage](const Sample* sample) {
+    sample->renderSample(
       textureImage,
-      sample.inTextureBounds().x+m_innerPadding,
-      sample.inTextureBounds().y+m_innerPadding,
-      m_extrude);
-    ++i;
+      sample->inTextureBounds().x+m_innerPadding,
+      sample->inTextureBounds().y+m_innerPadding,
+      m_extrude,
+      false);                   // The layers are already visible
+  };
+
+  // Each sample is rendered in its own area of the texture, so we can
+  // render several samples in parallel. The visibility of layers is
+  // modified to render the selected layers of each sample, so we
+  // render in parallel groups of consecutive samples that use the
+  // same sprite/selected layers.
+  const int nsamples = int(samplesToRender.size());
+  int rendered = 0;
+  for (int i=0; i<nsamples; ) {
+    if (token.canceled())
+      return;
+
+    // Images (e.g. tiles from several tilesets/sprites) and samples
+    // copied from their trimmed render (e.g. samples from all layers
+    // with --split-layers) don't depend on the layers visibility, so
+    // all consecutive ones are copied in the same group.
+    auto isCopy = [textureImage](const Sample* sample) {
+      return (sample->image() ||
+              sample->canCopyRender(textureImage));
+    };
+    const Sample* first = samplesToRender[i];
+    int j = i+1;
+    if (isCopy(first)) {
+      while (j < nsamples &&
+             isCopy(samplesToRender[j]))
+        ++j;
+    }
+    else {
+      while (j < nsamples &&
+             !isCopy(samplesToRender[j]) &&
+             samplesToRender[j]->sprite() == first->sprite() &&
+             samplesToRender[j]->selectedLayers() == first->selectedLayers())
+        ++j;
+    }
+
+    RestoreVisibleLayers layersVisibility;
+    if (!isCopy(first) && first->selectedLayers())
+      layersVisibility.showSelectedLayers(first->sprite(),
+                                          *first->selectedLayers());
+
+    const int ngroup = j-i;
+    if (ngroup == 1) {
+      renderSample(first);
+    }
+    else {
+      std::atomic<int> next(i);
+      std::atomic<int> done(0);
+      run_parallel_tasks(
+        std::min<int>(ngroup, std::thread::hardware_concurrency()),
+        [&, j](const std::atomic<bool>& stop){
+          while (!stop) {
+            const int k = next++;
+            if (k >= j)
+              break;
+            renderSample(samplesToRender[k]);
+            ++done;
+          }
+        },
+        [&]{
+          token.set_progress(0.6f + 0.2f * (rendered+done) / nsamples);
+          return !token.canceled();
+        });
+    }
+
+    rendered += ngroup;
+    token.set_progress(0.6f + 0.2f * rendered / nsamples);
+    i = j;
   }
 }
 
@@ -1344,9 +1870,15 @@ void DocExporter::trimTexture(const Samples& samples,
 }
 
 void DocExporter::createDataFile(const Samples& samples,
-                                 std::ostream& os,
+                                 std::ostream& out,
                                  doc::Sprite* texture)
 {
+  if (m_dataFormat == SpriteSheetDataFormat::Binary) {
+    createBinaryDataFile(samples, out, texture);
+    return;
+  }
+
+  JsonWriter os(out);
   std::string frames_begin;
   std::string frames_end;
   bool filename_as_key = false;
@@ -1376,6 +1908,9 @@ void DocExporter::createDataFile(const Samples& samples,
       filename_as_key = false;
       filename_as_attr = true;
       break;
+    case SpriteSheetDataFormat::Binary:
+      // Handled by createBinaryDataFile()
+      break;
   }
 
   os << "{ \"frames\": " << frames_begin << "\n";
@@ -1426,7 +1961,7 @@ void DocExporter::createDataFile(const Samples& samples,
 
   if (!m_textureFilename.empty())
     os << "  \"image\": \""
-       << escape_for_json(base::get_file_name(m_textureFilename)).c_str()
+       << escape_for_json(base::get_file_name(m_textureFilename))
        << "\",\n";
 
   os << "  \"format\": \"" << (texture->pixelFormat() == IMAGE_RGB ? "RGBA8888": "I8") << "\",\n"
@@ -1668,4 +2203,147 @@ void DocExporter::createDataFile(const Samples& samples,
      << "}\n";
 }
 
+// Compact binary data file for engines that don't need to parse
+// JSON. All values are little-endian, bounds are 4 int32 (x, y, w,
+// h), and strings are a uint32 length + UTF-8 bytes:
+//
+//   char[4]   "ASSD"
+//   uint16    Version (1)
+//   uint16    Flags (1 = the texture is RGBA8888, otherwise I8)
+//   uint32    Texture width
+//   uint32    Texture height
+//   string    Texture filename (empty if there is no texture file)
+//   uint32    Number of frames
+//   For each frame:
+//     string  Filename (the key of the JSON data)
+//     bounds  Frame bounds in the texture
+//     bounds  Sprite source bounds (trimmed bounds)
+//     int32   Source width
+//     int32   Source height
+//     uint32  Duration in milliseconds
+//     uint8   Flags (1 = trimmed)
+//   uint32    Number of tags (zero if tags are not listed)
+//   For each tag:
+//     string  Name
+//     uint32  From frame
+//     uint32  To frame
+//     uint8   Direction (doc::AniDir value)
+//     uint32  Repeat (zero = infinite)
+//   uint32    Number of slices (zero if slices are not listed)
+//   For each slice:
+//     string  Name
+//     uint32  Number of keys
+//     For each key:
+//       uint32  Frame
+//       bounds  Bounds
+//       uint8   Flags (1 = it has a 9-slice center, 2 = it has a pivot)
+//       bounds  Center bounds (only if flags & 1)
+//       int32   Pivot X (only if flags & 2)
+//       int32   Pivot Y (only if flags & 2)
+//
+// Layers and user data are not included in this format.
+void DocExporter::createBinaryDataFile(const Samples& samples,
+                                       std::ostream& out,
+                                       doc::Sprite* texture)
+{
+  BinaryWriter os(out);
+
+  // If the the image was extruded, the frame bounds are displaced (1
+  // pixel) and reduced (2 pixels) to point to the real image.
+  const int nonExtrudedPosition = (m_extrude ? 1: 0);
+  const int nonExtrudedSize = (m_extrude ? -2: 0);
+
+  // Header
+  os.writeBytes("ASSD", 4);
+  os.write16(1);
+  os.write16(texture->pixelFormat() == IMAGE_RGB ? 1: 0);
+  os.write32(texture->width());
+  os.write32(texture->height());
+  os.writeString(m_textureFilename.empty() ? std::string():
+                                             base::get_file_name(m_textureFilename));
+
+  // Frames
+  os.write32(int(samples.size()));
+  for (const Sample& sample : samples) {
+    gfx::Rect frameBounds = sample.inTextureBounds();
+    frameBounds.x += nonExtrudedPosition;
+    frameBounds.y += nonExtrudedPosition;
+    frameBounds.w += nonExtrudedSize;
+    frameBounds.h += nonExtrudedSize;
+
+    os.writeString(sample.filename());
+    os.writeRect(frameBounds);
+    os.writeRect(sample.trimmedBounds());
+    os.write32(sample.originalSize().w);
+    os.write32(sample.originalSize().h);
+    os.write32(sample.sprite()->frameDuration(sample.frame()));
+    os.write8(sample.trimmed() ? 1: 0);
+  }
+
+  // Each sprite is included only one time in the list of tags/slices
+  // (e.g. when -split-layers is specified, several calls of
+  // addDocument() are used for each layer).
+  std::vector<Doc*> docs;
+  {
+    std::set<doc::ObjectId> includedSprites;
+    for (auto& item : m_documents) {
+      if (!item.isOneImageOnly() &&
+          includedSprites.insert(item.doc->sprite()->id()).second) {
+        docs.push_back(item.doc);
+      }
+    }
+  }
+
+  // Tags
+  std::vector<std::pair<Doc*, Tag*>> tags;
+  if (m_listTags) {
+    for (Doc* doc : docs)
+      for (Tag* tag : doc->sprite()->tags())
+        tags.emplace_back(doc, tag);
+  }
+  os.write32(int(tags.size()));
+  for (const auto& [doc, tag] : tags) {
+    FilenameInfo fnInfo;
+    fnInfo
+      .filename(doc->filename())
+      .innerTagName(tag->name());
+
+    os.writeString(filename_formatter(
+                     m_tagnameFormat.empty() ? "{tag}": m_tagnameFormat,
+                     fnInfo));
+    os.write32(tag->fromFrame());
+    os.write32(tag->toFrame());
+    os.write8(int(tag->aniDir()));
+    os.write32(tag->repeat());
+  }
+
+  // Slices
+  std::vector<Slice*> slices;
+  if (m_listSlices) {
+    for (Doc* doc : docs)
+      for (Slice* slice : doc->sprite()->slices())
+        slices.push_back(slice);
+  }
+  os.write32(int(slices.size()));
+  for (const Slice* slice : slices) {
+    os.writeString(slice->name());
+    os.write32(int(slice->size()));
+    for (const auto& key : *slice) {
+      const SliceKey* sliceKey = key.value();
+      const bool hasCenter = !sliceKey->center().isEmpty();
+      const bool hasPivot = sliceKey->hasPivot();
+
+      os.write32(key.frame());
+      os.writeRect(sliceKey->bounds());
+      os.write8((hasCenter ? 1: 0) | (hasPivot ? 2: 0));
+      if (hasCenter)
+        os.writeRect(sliceKey->center());
+      if (hasPivot) {
+        os.write32(sliceKey->pivot().x);
+        os.write32(sliceKey->pivot().y);
+      }
+    }
+  }
+}
+
 } // namespace app
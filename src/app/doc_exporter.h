@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -22,6 +22,7 @@
 #include "gfx/rect.h"
 
 #include <iosfwd>
+#include <map>
 #include <memory>
 #include <string>
 #include <utility>
@@ -64,6 +65,7 @@ namespace app {
     void setSpriteSheetType(SpriteSheetType type) { m_sheetType = type; }
     void setIgnoreEmptyCels(bool ignore) { m_ignoreEmptyCels = ignore; }
     void setMergeDuplicates(bool merge) { m_mergeDuplicates = merge; }
+    void setFastPacking(bool fast) { m_fastPacking = fast; }
     void setBorderPadding(int padding) { m_borderPadding = padding; }
     void setShapePadding(int padding) { m_shapePadding = padding; }
     void setInnerPadding(int padding) { m_innerPadding = padding; }
@@ -115,6 +117,8 @@ namespace app {
       const bool splitGrid);
     void captureSamples(Samples& samples,
                         base::task_token& token);
+    void checkEmptyImages(base::task_token& token);
+    bool isEmptyImage(const doc::Image* image) const;
     void layoutSamples(Samples& samples,
                        base::task_token& token);
     gfx::Size calculateSheetSize(const Samples& samples,
@@ -127,6 +131,7 @@ namespace app {
                        base::task_token& token) const;
     void trimTexture(const Samples& samples, doc::Sprite* texture) const;
     void createDataFile(const Samples& samples, std::ostream& os, doc::Sprite* texture);
+    void createBinaryDataFile(const Samples& samples, std::ostream& os, doc::Sprite* texture);
 
     class Item {
     public:
@@ -173,6 +178,7 @@ namespace app {
     int m_innerPadding;
     bool m_ignoreEmptyCels;
     bool m_mergeDuplicates;
+    bool m_fastPacking;
     bool m_trimSprite;
     bool m_trimCels;
     bool m_trimByGrid;
@@ -198,6 +204,15 @@ namespace app {
       bool trimmedByGrid;
     } m_cache;
 
+    // Cached result of is_empty_image() for each exported image
+    // (e.g. tileset tiles) to avoid scanning all pixels again if the
+    // image wasn't modified.
+    struct EmptyImage {
+      doc::ObjectVersion version;
+      bool empty;
+    };
+    std::map<doc::ObjectId, EmptyImage> m_emptyImages;
+
     DISABLE_COPYING(DocExporter);
   };
 
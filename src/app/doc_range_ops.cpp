@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -15,6 +15,7 @@
 #include "app/doc_range_ops.h"
 
 #include "app/app.h"
+#include "app/cmd/permute_frames.h"
 #include "app/context_access.h"
 #include "app/doc_api.h"
 #include "app/doc_range.h"
@@ -24,6 +25,7 @@
 #include "doc/sprite.h"
 
 #include <stdexcept>
+#include <vector>
 
 #ifdef TRACE_RANGE_OPS
 #include <iostream>
@@ -107,6 +109,9 @@ static DocRange move_or_copy_frames(
     (place == kDocRangeBefore ? dstFrame:
                                 dstFrame+1);
 
+  // Moved frames are reordered at the end with just one command
+  std::vector<DocApi::FrameMove> moves;
+
   for (; srcFrame != srcFrameEnd; ++srcFrame) {
     frame_t fromFrame = (*srcFrame)+srcDelta;
 
@@ -143,10 +148,10 @@ static DocRange move_or_copy_frames(
     switch (op) {
 
       case Move:
-        api.moveFrame(sprite, fromFrame, dstFrame,
-                      (place == kDocRangeBefore ? kDropBeforeFrame:
-                                                  kDropAfterFrame),
-                      tagsHandling);
+        moves.push_back(
+          DocApi::FrameMove{ fromFrame, dstFrame,
+                             (place == kDocRangeBefore ? kDropBeforeFrame:
+                                                         kDropAfterFrame) });
 
         if (fromFrame < dstBeforeFrame-1) {
           --srcDelta;
@@ -183,6 +188,9 @@ static DocRange move_or_copy_frames(
 #endif
   }
 
+  if (!moves.empty())
+    api.moveFrames(sprite, moves, tagsHandling);
+
   DocRange result;
   if (!srcRange.selectedLayers().empty())
     result.selectLayers(srcRange.selectedLayers());
@@ -491,7 +499,6 @@ void reverse_frames(Doc* doc, const DocRange& range)
   const ContextReader reader(context);
   ContextWriter writer(reader);
   Tx tx(writer, "Reverse Frames");
-  DocApi api = doc->getApi(tx);
   Sprite* sprite = doc->sprite();
   LayerList layers;
   frame_t frameBegin, frameEnd;
@@ -519,31 +526,19 @@ void reverse_frames(Doc* doc, const DocRange& range)
       break;
   }
 
-  if (moveFrames) {
-    for (frame_t frameRev = frameEnd+1;
-         frameRev > frameBegin;
-         --frameRev) {
-      api.moveFrame(sprite, frameBegin, frameRev,
-                    kDropBeforeFrame,
-                    kDontAdjustTags);
-    }
-  }
-  else if (swapCels) {
-    for (Layer* layer : layers) {
-      if (!layer->isImage())
-        continue;
-
-      for (frame_t frame = frameBegin,
-             frameRev = frameEnd;
-           frame != (frameBegin+frameEnd)/2+1;
-           ++frame, --frameRev) {
-        if (frame == frameRev)
-          continue;
-
-        LayerImage* imageLayer = static_cast<LayerImage*>(layer);
-        api.swapCel(imageLayer, frame, frameRev);
-      }
-    }
+  // Reverse the range of frames with just one permutation of the
+  // frames (of all the sprite, or of the cels in the given layers)
+  if (moveFrames || swapCels) {
+    std::vector<frame_t> newFrames(frameEnd+1);
+    for (frame_t frame=0; frame<frameBegin; ++frame)
+      newFrames[frame] = frame;
+    for (frame_t frame=frameBegin; frame<=frameEnd; ++frame)
+      newFrames[frame] = frameBegin+frameEnd-frame;
+
+    if (moveFrames)
+      tx(new cmd::PermuteFrames(sprite, newFrames));
+    else
+      tx(new cmd::PermuteFrames(sprite, layers, newFrames));
   }
 
   tx.setNewDocRange(range);
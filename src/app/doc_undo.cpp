@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -18,11 +18,15 @@
 #include "app/context.h"
 #include "app/doc_undo_observer.h"
 #include "app/pref/preferences.h"
+#include "app/util/spill_file.h"
+#include "base/log.h"
 #include "base/mem_utils.h"
 #include "base/scoped_value.h"
+#include "doc/task_scheduler.h"
 #include "undo/undo_history.h"
 #include "undo/undo_state.h"
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 
@@ -36,6 +40,10 @@ DocUndo::DocUndo()
 {
 }
 
+DocUndo::~DocUndo()
+{
+}
+
 void DocUndo::setContext(Context* ctx)
 {
   m_ctx = ctx;
@@ -64,6 +72,13 @@ void DocUndo::add(CmdTransaction* cmd)
   m_undoHistory.add(cmd);
   m_totalUndoSize += cmd->memSize();
 
+  // Compress the state that is just behind the most recent ones, so
+  // undoing the last steps doesn't need to uncompress anything.
+  if (App::instance() &&
+      App::instance()->preferences().undo.compressHistory()) {
+    compressOldState();
+  }
+
   notify_observers(&DocUndoObserver::onAddUndoState, this);
   notify_observers(&DocUndoObserver::onTotalUndoSizeChange, this);
 
@@ -86,6 +101,19 @@ void DocUndo::add(CmdTransaction* cmd)
           break;
       }
     }
+
+    // Move the data of the oldest states to disk if we are still
+    // using more memory than the given budget (0 means "no budget").
+    const size_t memoryBudget =
+      int(App::instance()->preferences().undo.memoryBudget())
+      * 1024 * 1024;
+    if (memoryBudget > 0 &&
+        m_totalUndoSize > memoryBudget) {
+      const size_t oldSize = m_totalUndoSize;
+      spillOldStates(memoryBudget);
+      if (m_totalUndoSize != oldSize)
+        notify_observers(&DocUndoObserver::onTotalUndoSizeChange, this);
+    }
   }
 
   UNDO_TRACE("UNDO: New undo size %s\n",
@@ -281,8 +309,22 @@ void DocUndo::moveToState(const undo::UndoState* state)
   ASSERT(!m_undoing);
   base::ScopedValue undoing(m_undoing, true);
 
+  // Jumping to a far state (e.g. from the Undo History panel) has to
+  // undo/redo all the intermediate states, so we load/uncompress the
+  // data of all of them in parallel before replaying them.
+  std::vector<const undo::UndoState*> states;
+  preloadStatesTo(state, states);
+
   m_undoHistory.moveTo(state);
 
+  // Compress again the data of the states that were uncompressed
+  // but are far from the new current state.
+  if (!states.empty() &&
+      App::instance() &&
+      App::instance()->preferences().undo.compressHistory()) {
+    compressStatesFarFromCurrent(states);
+  }
+
   // After onCurrentUndoStateChange don't use the "state" argument, it
   // might be deleted because some script might have modified the
   // sprite on its "change" event.
@@ -296,6 +338,18 @@ void DocUndo::moveToState(const undo::UndoState* state)
     m_totalUndoSize += STATE_CMD(s)->memSize();
     s = s->next();
   }
+
+  // The loaded data of the intermediate states could exceed the
+  // memory budget.
+  if (!states.empty() && App::instance()) {
+    const size_t memoryBudget =
+      int(App::instance()->preferences().undo.memoryBudget())
+      * 1024 * 1024;
+    if (memoryBudget > 0 &&
+        m_totalUndoSize > memoryBudget)
+      spillOldStates(memoryBudget);
+  }
+
   if (m_totalUndoSize != oldSize)
     notify_observers(&DocUndoObserver::onTotalUndoSizeChange, this);
 }
@@ -314,6 +368,157 @@ const undo::UndoState* DocUndo::nextRedo() const
     return m_undoHistory.firstState();
 }
 
+void DocUndo::compressOldState()
+{
+  const undo::UndoState* state = m_undoHistory.currentState();
+  for (int i=0; state && i<kUncompressedStates; ++i)
+    state = state->prev();
+  if (!state)
+    return;
+
+  Cmd* cmd = STATE_CMD(state);
+  const size_t oldSize = cmd->memSize();
+  try {
+    cmd->compress();
+  }
+  catch (const std::exception& ex) {
+    LOG(ERROR, "UNDO: Cannot compress undo data: %s\n", ex.what());
+  }
+  m_totalUndoSize -= oldSize;
+  m_totalUndoSize += cmd->memSize();
+}
+
+void DocUndo::compressAllStates()
+{
+  for (const undo::UndoState* state = m_undoHistory.firstState();
+       state; state = state->next()) {
+    Cmd* cmd = STATE_CMD(state);
+    const size_t oldSize = cmd->memSize();
+    try {
+      cmd->compress();
+    }
+    catch (const std::exception& ex) {
+      LOG(ERROR, "UNDO: Cannot compress undo data: %s\n", ex.what());
+      break;
+    }
+    m_totalUndoSize -= oldSize;
+    m_totalUndoSize += cmd->memSize();
+  }
+}
+
+const size_t memoryBudget)
+{
+  UNDO_TRACE("UNDO: Spilling undo history from %s to %s\n",
+             base::get_pretty_memory_size(m_totalUndoSize).c_str(),
+             base::get_pretty_memory_size(memoryBudget).c_str());
+
+  if (!m_spillFile)
+    m_spillFile = std::make_unique<SpillFile>();
+
+  // We don't spill the current state as it's the next one to be
+  // undone (and we would need to load it again).
+  const undo::UndoState* current = m_undoHistory.currentState();
+  const undo::UndoState* state = m_undoHistory.firstState();
+  try {
+    while (state && state != current &&
+           m_totalUndoSize > memoryBudget) {
+      Cmd* cmd = STATE_CMD(state);
+      const size_t oldSize = cmd->memSize();
+      cmd->spill(m_spillFile.get());
+      m_totalUndoSize -= oldSize;
+      m_totalUndoSize += cmd->memSize();
+      state = state->next();
+    }
+  }
+  catch (const std::exception& ex) {
+    // The data that cannot be written stays in memory
+    LOG(ERROR, "UNDO: Cannot move undo data to disk: %s\n", ex.what());
+  }
+}
+
+// Collects the states that must be undone/redone to move from the
+// current state to the given "target" state, and loads their data.
+void DocUndo::preloadStatesTo(const undo::UndoState* target,
+                              std::vector<const undo::UndoState*>& states)
+{
+  const undo::UndoState* current = m_undoHistory.currentState();
+  if (current == target)
+    return;
+
+  // Undo: from the current state back to the target
+  const undo::UndoState* s = current;
+  for (; s && s != target; s = s->prev())
+    states.push_back(s);
+
+  // Redo: from the next state of the current one to the target
+  if (s != target) {
+    states.clear();
+    for (s = nextRedo(); s; s = s->next()) {
+      states.push_back(s);
+      if (s == target)
+        break;
+    }
+    // The target is not in the same branch of the history (in a
+    // non-linear undo history), we let the UndoHistory to
+    // uncompress each state when it's needed.
+    if (!s) {
+      states.clear();
+      return;
+    }
+  }
+
+  // Only long jumps are worth a parallel preload
+  if (states.size() <= kUncompressedStates) {
+    states.clear();
+    return;
+  }
+
+  try {
+    doc::TaskGroup tasks(doc::TaskPriority::High);
+    for (const undo::UndoState* state : states)
+      STATE_CMD(state)->preload(tasks);
+    tasks.wait();
+  }
+  catch (const std::exception& ex) {
+    // The data that couldn't be loaded is loaded again (or the error
+    // is reported) when the state is undone/redone.
+    LOG(ERROR, "UNDO: Cannot load undo data: %s\n", ex.what());
+  }
+}
+
+void DocUndo::compressStatesFarFromCurrent(const std::vector<const undo::UndoState*>& states)
+{
+  // Keep uncompressed the states near the current one (in both
+  // directions) as it's probable that the user keeps moving around
+  // this position.
+  std::vector<const undo::UndoState*> nearStates;
+  const undo::UndoState* current = m_undoHistory.currentState();
+  nearStates.push_back(current);
+  const undo::UndoState* prev = current;
+  const undo::UndoState* next = current;
+  for (int i=0; i<kUncompressedStates; ++i) {
+    if (prev) prev = prev->prev();
+    if (next) next = next->next();
+    nearStates.push_back(prev);
+    nearStates.push_back(next);
+  }
+
+  doc::TaskGroup tasks(doc::TaskPriority::High);
+  for (const undo::UndoState* state : states) {
+    if (std::find(nearStates.begin(), nearStates.end(), state) != nearStates.end())
+      continue;
+
+    Cmd* cmd = STATE_CMD(state);
+    tasks.run([cmd]{ cmd->compress(); });
+  }
+  try {
+    tasks.wait();
+  }
+  catch (const std::exception& ex) {
+    LOG(ERROR, "UNDO: Cannot compress undo data: %s\n", ex.what());
+  }
+}
+
 void DocUndo::onDeleteUndoState(undo::UndoState* state)
 {
   ASSERT(state);
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -17,7 +17,9 @@
 #include "undo/undo_history.h"
 
 #include <iosfwd>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace app {
   using namespace doc;
@@ -26,6 +28,7 @@ namespace app {
   class CmdTransaction;
   class Context;
   class DocUndoObserver;
+  class SpillFile;
 
   // Exception thrown when we want to modify the sprite (add new
   // app::Cmd objects) when we are undoing/redoing/moving throw the
@@ -39,7 +42,11 @@ namespace app {
   class DocUndo : public obs::observable<DocUndoObserver>,
                   public undo::UndoHistoryDelegate {
   public:
+    // Number of recent undo states that are never compressed.
+    static constexpr int kUncompressedStates = 4;
+
     DocUndo();
+    ~DocUndo();
 
     size_t totalUndoSize() const { return m_totalUndoSize; }
 
@@ -100,9 +107,18 @@ namespace app {
 
     void moveToState(const undo::UndoState* state);
 
+    // Compresses the data of all undo states (e.g. to reduce the
+    // memory used by closed documents).
+    void compressAllStates();
+
   private:
     const undo::UndoState* nextUndo() const;
     const undo::UndoState* nextRedo() const;
+    void compressOldState();
+    void spillOldStates(const size_t memoryBudget);
+    void preloadStatesTo(const undo::UndoState* target,
+                         std::vector<const undo::UndoState*>& states);
+    void compressStatesFarFromCurrent(const std::vector<const undo::UndoState*>& states);
 
     // undo::UndoHistoryDelegate impl
     void onDeleteUndoState(undo::UndoState* state) override;
@@ -112,6 +128,10 @@ namespace app {
     Context* m_ctx = nullptr;
     size_t m_totalUndoSize = 0;
 
+    // Temporary file where the data of old undo states is moved when
+    // the undo history exceeds the "undo.memory_budget" preference.
+    std::unique_ptr<SpillFile> m_spillFile;
+
     // True when we are undoing/redoing. Used to avoid adding new undo
     // information when we are moving through the undo history.
     bool m_undoing = false;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -11,20 +11,185 @@
 #include "app/app.h"
 #include "app/cli/app_options.h"
 #include "app/doc.h"
+#include "app/doc_undo.h"
+#include "app/tools/active_tool.h"
+#include "app/tools/tool_box.h"
 #include "app/ui/editor/editor.h"
 #include "app/ui/main_window.h"
 #include "app/ui_context.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/primitives_fast.h"
 #include "doc/sprite.h"
 #include "os/system.h"
 #include "ui/manager.h"
+#include "ui/message.h"
 #include "ui/system.h"
 #include "ui/timer.h"
 
 #include <benchmark/benchmark.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
 using namespace app;
 using namespace doc;
 
+namespace {
+
+// Latency of each operation replayed in the editor (from the input
+// message until the editor is painted). The percentiles are reported
+// as counters of the benchmark (in milliseconds).
+class Latencies {
+  using Clock = std::chrono::steady_clock;
+public:
+  void start() { m_start = Clock::now(); }
+  void stop() {
+    m_samples.push_back(
+      std::chrono::duration<double, std::milli>(Clock::now() - m_start).count());
+  }
+
+  void report(benchmark::State& state) {
+    if (m_samples.empty())
+      return;
+    std::sort(m_samples.begin(), m_samples.end());
+    auto percentile = [this](double p) {
+      const int i = int(std::ceil(p * m_samples.size())) - 1;
+      return m_samples[std::clamp(i, 0, int(m_samples.size())-1)];
+    };
+    state.counters["p50_ms"] = percentile(0.50);
+    state.counters["p90_ms"] = percentile(0.90);
+    state.counters["p99_ms"] = percentile(0.99);
+    state.counters["max_ms"] = m_samples.back();
+  }
+
+private:
+  Clock::time_point m_start;
+  std::vector<double> m_samples;
+};
+
+// Creates a document with the given number of layers and frames
+// where each cel has a different pattern (so the editor cannot
+// reuse/skip the render of empty cels).
+std::unique_ptr<Doc> make_heavy_doc(const int w, const int h,
+                                    const int layers, const int frames)
+{
+  Sprite* spr = new Sprite(ImageSpec(ColorMode::RGB, w, h), 256);
+  spr->setTotalFrames(frames);
+
+  for (int i=0; i<layers; ++i) {
+    LayerImage* layer = new LayerImage(spr);
+    spr->root()->addLayer(layer);
+
+    for (frame_t f=0; f<frames; ++f) {
+      ImageRef image(Image::create(IMAGE_RGB, w, h));
+      for (int y=0; y<h; ++y)
+        for (int x=0; x<w; ++x)
+          put_pixel_fast<RgbTraits>(
+            image.get(), x, y,
+            rgba((x*(i+1)+f) & 255, (y*(i+1)) & 255, (x^y) & 255,
+                 ((x+y+f) % 7 == 0 ? 0: 255)));
+      layer->addCel(new Cel(f, image));
+    }
+  }
+
+  std::unique_ptr<Doc> doc(new Doc(spr));
+  doc->setContext(UIContext::instance());
+  return doc;
+}
+
+void select_tool(const char* id)
+{
+  App* app = App::instance();
+  app->activeToolManager()->setSelectedTool(app->toolBox()->getToolById(id));
+}
+
+void process_messages()
+{
+  auto mgr = ui::Manager::getDefault();
+  mgr->generateMessages();
+  mgr->dispatchMessages();
+}
+
+// Sends a mouse message to the editor as the ui::Manager does from
+// an os::Event. "spritePos" is in sprite coordinates.
+void send_mouse(Editor* editor,
+                const ui::MessageType type,
+                const gfx::Point& spritePos,
+                const float pressure = 1.0f)
+{
+  ui::MouseMessage msg(type,
+                       ui::PointerType::Pen,
+                       (type == ui::kMouseMoveMessage && !editor->hasCapture() ?
+                        ui::kButtonNone: ui::kButtonLeft),
+                       ui::kKeyNoneModifier,
+                       editor->editorToScreen(spritePos),
+                       gfx::Point(0, 0), false, pressure);
+  msg.setDisplay(editor->display());
+  msg.setRecipient(editor);
+  editor->sendMessage(&msg);
+}
+
+// Replays a drag from "a" to "b" in "steps" mouse movements
+// measuring the latency of each step.
+void replay_drag(Editor* editor,
+                 const gfx::Point& a,
+                 const gfx::Point& b,
+                 const int steps,
+                 Latencies& latencies,
+                 const bool withPressure = false)
+{
+  latencies.start();
+  send_mouse(editor, ui::kMouseDownMessage, a);
+  process_messages();
+  latencies.stop();
+
+  for (int i=1; i<=steps; ++i) {
+    const double t = double(i) / steps;
+    const gfx::Point pt(a.x + int((b.x - a.x) * t),
+                        a.y + int((b.y - a.y) * t));
+    const float pressure =
+      (withPressure ? float(0.5 + 0.5 * std::sin(t * 3.1416)): 1.0f);
+
+    latencies.start();
+    send_mouse(editor, ui::kMouseMoveMessage, pt, pressure);
+    process_messages();
+    latencies.stop();
+  }
+
+  latencies.start();
+  send_mouse(editor, ui::kMouseUpMessage, b);
+  process_messages();
+  latencies.stop();
+}
+
+// Undoes the replayed operation so each iteration starts with the
+// same document.
+void undo_all(benchmark::State& state, Doc* doc)
+{
+  state.PauseTiming();
+  while (doc->undoHistory()->canUndo())
+    doc->undoHistory()->undo();
+  doc->notifyGeneralUpdate();
+  process_messages();
+  state.ResumeTiming();
+}
+
+Editor* prepare_editor(Doc* doc, const int zoom)
+{
+  Editor* editor = UIContext::instance()->activeEditor();
+  editor->setLayer(doc->sprite()->root()->lastLayer());
+  editor->setZoom(render::Zoom(zoom, 1));
+  editor->setScrollToCenter();
+  process_messages();
+  return editor;
+}
+
+} // anonymous namespace
+
 void BM_ScrollEditor(benchmark::State& state) {
   const int w = state.range(0);
   const int h = state.range(1);
@@ -99,6 +264,110 @@ void BM_ZoomEditor(benchmark::State& state) {
   }
 }
 
+// Freehand strokes of the pencil tool with pen pressure
+void BM_FreehandStroke(benchmark::State& state) {
+  const int w = state.range(0);
+  const int h = state.range(1);
+  const int layers = state.range(2);
+  std::unique_ptr<Doc> doc = make_heavy_doc(w, h, layers, 1);
+  Editor* editor = prepare_editor(doc.get(), 2);
+  select_tool(tools::WellKnownTools::Pencil);
+
+  Latencies latencies;
+  ui::Timer timer(1);
+  timer.start();
+  for (auto _ : state) {
+    replay_drag(editor, gfx::Point(w/8, h/8), gfx::Point(7*w/8, 7*h/8),
+                64, latencies, true);
+    undo_all(state, doc.get());
+  }
+  latencies.report(state);
+}
+
+// Drag of a new rectangular selection
+void BM_SelectionDrag(benchmark::State& state) {
+  const int w = state.range(0);
+  const int h = state.range(1);
+  const int layers = state.range(2);
+  std::unique_ptr<Doc> doc = make_heavy_doc(w, h, layers, 1);
+  Editor* editor = prepare_editor(doc.get(), 2);
+  select_tool(tools::WellKnownTools::RectangularMarquee);
+
+  Latencies latencies;
+  ui::Timer timer(1);
+  timer.start();
+  for (auto _ : state) {
+    replay_drag(editor, gfx::Point(w/4, h/4), gfx::Point(3*w/4, 3*h/4),
+                32, latencies);
+    undo_all(state, doc.get());
+  }
+  latencies.report(state);
+}
+
+// One click with the paint bucket
+void BM_BucketFill(benchmark::State& state) {
+  const int w = state.range(0);
+  const int h = state.range(1);
+  const int layers = state.range(2);
+  std::unique_ptr<Doc> doc = make_heavy_doc(w, h, layers, 1);
+  Editor* editor = prepare_editor(doc.get(), 1);
+  select_tool("paint_bucket");
+
+  Latencies latencies;
+  ui::Timer timer(1);
+  timer.start();
+  for (auto _ : state) {
+    replay_drag(editor, gfx::Point(w/2, h/2), gfx::Point(w/2, h/2),
+                0, latencies);
+    undo_all(state, doc.get());
+  }
+  latencies.report(state);
+}
+
+// Moving the active cel with the move tool
+void BM_MoveCel(benchmark::State& state) {
+  const int w = state.range(0);
+  const int h = state.range(1);
+  const int layers = state.range(2);
+  std::unique_ptr<Doc> doc = make_heavy_doc(w, h, layers, 1);
+  Editor* editor = prepare_editor(doc.get(), 1);
+  select_tool(tools::WellKnownTools::Move);
+
+  Latencies latencies;
+  ui::Timer timer(1);
+  timer.start();
+  for (auto _ : state) {
+    replay_drag(editor, gfx::Point(w/2, h/2), gfx::Point(w/2+w/4, h/2+h/4),
+                32, latencies);
+    undo_all(state, doc.get());
+  }
+  latencies.report(state);
+}
+
+// Rendering of each frame of the animation (as the playback does)
+void BM_Playback(benchmark::State& state) {
+  const int w = state.range(0);
+  const int h = state.range(1);
+  const int layers = state.range(2);
+  const int frames = 8;
+  std::unique_ptr<Doc> doc = make_heavy_doc(w, h, layers, frames);
+  Editor* editor = prepare_editor(doc.get(), 1);
+
+  Latencies latencies;
+  ui::Timer timer(1);
+  timer.start();
+  for (auto _ : state) {
+    for (frame_t f=0; f<frames; ++f) {
+      latencies.start();
+      editor->setFrame(f);
+      editor->invalidate();
+      process_messages();
+      latencies.stop();
+    }
+  }
+  latencies.report(state);
+}
+
 BENCHMARK(BM_ScrollEditor)
   // Normal zoom
   ->Args({ 32, 32, 1, 1 })
@@ -132,6 +401,21 @@ BENCHMARK(BM_ZoomEditor)
   ->Args({ 4096, 4096 })
   ->Unit(benchmark::kMicrosecond);
 
+// Arguments: sprite width, height, and number of layers
+#define EDITOR_INTERACTION_ARGS                 \
+  ->Args({ 256, 256, 1 })                       \
+  ->Args({ 256, 256, 16 })                      \
+  ->Args({ 1024, 1024, 1 })                     \
+  ->Args({ 1024, 1024, 16 })                    \
+  ->Args({ 4096, 4096, 4 })                     \
+  ->Unit(benchmark::kMillisecond)
+
+BENCHMARK(BM_FreehandStroke) EDITOR_INTERACTION_ARGS;
+BENCHMARK(BM_SelectionDrag) EDITOR_INTERACTION_ARGS;
+BENCHMARK(BM_BucketFill) EDITOR_INTERACTION_ARGS;
+BENCHMARK(BM_MoveCel) EDITOR_INTERACTION_ARGS;
+BENCHMARK(BM_Playback) EDITOR_INTERACTION_ARGS;
+
 int app_main(int argc, char* argv[])
 {
   os::SystemRef system(os::make_system());
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2023  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2017-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -18,6 +18,7 @@
 #include "app/console.h"
 #include "app/ini_file.h"
 #include "app/load_matrix.h"
+#include "app/perf_trace.h"
 #include "app/pref/preferences.h"
 #include "app/resource_finder.h"
 #include "base/exception.h"
@@ -25,6 +26,7 @@
 #include "base/file_handle.h"
 #include "base/fs.h"
 #include "base/fstream_path.h"
+#include "doc/algorithm/parallel_bands.h"
 #include "render/dithering_matrix.h"
 #include "ui/widget.h"
 
@@ -43,6 +45,7 @@
 #include "json11.hpp"
 
 #include <fstream>
+#include <iterator>
 #include <queue>
 #include <sstream>
 #include <string>
@@ -179,12 +182,9 @@ private:
 
 void read_json_file(const std::string& path, json11::Json& json)
 {
-  std::string jsonText, line;
   std::ifstream in(FSTREAM_PATH(path), std::ifstream::binary);
-  while (std::getline(in, line)) {
-    jsonText += line;
-    jsonText.push_back('\n');
-  }
+  const std::string jsonText((std::istreambuf_iterator<char>(in)),
+                             std::istreambuf_iterator<char>());
   std::string err;
   json = json11::Json::parse(jsonText, err);
   if (!err.empty())
@@ -206,6 +206,7 @@ void write_json_file(const std::string& path, const json11::Json& json)
 // Extension
 
 Extension::DitheringMatrixInfo::DitheringMatrixInfo()
+  : m_matrix(std::make_shared<LazyMatrix>())
 {
 }
 
@@ -213,16 +214,17 @@ Extension::DitheringMatrixInfo::DitheringMatrixInfo(const std::string& path,
                                                     const std::string& name)
   : m_path(path)
   , m_name(name)
+  , m_matrix(std::make_shared<LazyMatrix>())
 {
 }
 
 const render::DitheringMatrix& Extension::DitheringMatrixInfo::matrix() const
 {
-  if (!m_loaded) {
-    load_dithering_matrix_from_sprite(m_path, m_matrix);
-    m_loaded = true;
+  if (!m_matrix->loaded) {
+    load_dithering_matrix_from_sprite(m_path, m_matrix->matrix);
+    m_matrix->loaded = true;
   }
-  return m_matrix;
+  return m_matrix->matrix;
 }
 
 Extension::Extension(const std::string& path,
@@ -793,6 +795,8 @@ void Extension::addScript(const std::string& fn)
 
 Extensions::Extensions()
 {
+  PerfScope perf(PerfCategory::Startup, "Extensions::Extensions");
+
   // Create and get the user extensions directory
   {
     ResourceFinder rf2;
@@ -810,6 +814,18 @@ Extensions::Extensions()
   rf.includeUserDir("extensions");
   rf.includeDataDir("extensions");
 
+  // First we collect all the extensions to load (in order), so we
+  // can read/parse their package.json files in parallel (which is
+  // the slowest part when there are a lot of extensions installed).
+  struct Candidate {
+    std::string dir;
+    std::string fullFn;
+    bool isBuiltinExtension;
+    json11::Json json;
+    std::string error;
+  };
+  std::vector<Candidate> candidates;
+
   // Load extensions from data/ directory on all possible locations
   // (installed folder and user folder)
   while (rf.next()) {
@@ -833,16 +849,40 @@ Extensions::Extensions()
           continue;
         }
 
-        try {
-          loadExtension(dir, fullFn, isBuiltinExtension);
-        }
-        catch (const std::exception& ex) {
-          LOG("EXT: Error loading JSON file: %s\n",
-              ex.what());
-        }
+        candidates.push_back(Candidate{ dir, fullFn, isBuiltinExtension });
       }
     }
   }
+
+  doc::algorithm::for_each_index(
+    int(candidates.size()),
+    [&candidates](const int i) {
+      Candidate& c = candidates[i];
+      try {
+        read_json_file(c.fullFn, c.json);
+      }
+      catch (const std::exception& ex) {
+        c.error = ex.what();
+      }
+    });
+
+  // Extensions are created in the main thread (in the same order as
+  // they were found).
+  for (const Candidate& c : candidates) {
+    if (!c.error.empty()) {
+      LOG("EXT: Error loading JSON file: %s\n",
+          c.error.c_str());
+      continue;
+    }
+
+    try {
+      loadExtension(c.dir, c.json, c.isBuiltinExtension);
+    }
+    catch (const std::exception& ex) {
+      LOG("EXT: Error loading JSON file: %s\n",
+          ex.what());
+    }
+  }
 }
 
 Extensions::~Extensions()
@@ -1099,6 +1139,13 @@ Extension* Extensions::loadExtension(const std::string& path,
 {
   json11::Json json;
   read_json_file(fullPackageFilename, json);
+  return loadExtension(path, json, isBuiltinExtension);
+}
+
+Extension* Extensions::loadExtension(const std::string& path,
+                                     const json11::Json& json,
+                                     const bool isBuiltinExtension)
+{
   auto name = json["name"].string_value();
   auto version = json["version"].string_value();
   auto displayName = json["displayName"].string_value();
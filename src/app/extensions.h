@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2023  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2017-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -14,9 +14,14 @@
 #include "render/dithering_matrix.h"
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
+namespace json11 {
+  class Json;
+}
+
 namespace ui {
   class Widget;
 }
@@ -61,13 +66,20 @@ namespace app {
                           const std::string& name);
 
       const std::string& name() const { return m_name; }
+
+      // Loads the matrix the first time it's needed (the loaded
+      // matrix is shared between all copies of this info).
       const render::DitheringMatrix& matrix() const;
 
     private:
+      struct LazyMatrix {
+        render::DitheringMatrix matrix;
+        bool loaded = false;
+      };
+
       std::string m_path;
       std::string m_name;
-      mutable render::DitheringMatrix m_matrix;
-      mutable bool m_loaded = false;
+      std::shared_ptr<LazyMatrix> m_matrix;
     };
 
     struct ThemeInfo {
@@ -232,6 +244,9 @@ namespace app {
     Extension* loadExtension(const std::string& path,
                              const std::string& fullPackageFilename,
                              const bool isBuiltinExtension);
+    Extension* loadExtension(const std::string& path,
+                             const json11::Json& json,
+                             const bool isBuiltinExtension);
     void generateExtensionSignals(Extension* extension);
 
     List m_extensions;
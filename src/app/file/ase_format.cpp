@@ -24,14 +24,18 @@
 #include "dio/decode_delegate.h"
 #include "dio/file_interface.h"
 #include "doc/doc.h"
+#include "doc/task_scheduler.h"
 #include "fixmath/fixmath.h"
 #include "fmt/format.h"
 #include "ui/alert.h"
 #include "ver/info.h"
 #include "zlib.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <deque>
+#include <map>
+#include <memory>
 #include <variant>
 
 #define ASEFILE_TRACE(...) // TRACE(__VA_ARGS__)
@@ -70,6 +74,10 @@ public:
     return m_fop->isOneFrame();
   }
 
+  bool decodeMetadataOnly() override {
+    return m_fop->isMetadataOnly();
+  }
+
   doc::color_t defaultSliceColor() override {
     auto color = m_fop->config().defaultSliceColor;
     return doc::rgba(color.getRed(),
@@ -88,6 +96,14 @@ public:
     return m_fop->config().cacheCompressedTilesets;
   }
 
+  bool cacheCompressedCels() const override {
+    return m_fop->config().cacheCompressedCels;
+  }
+
+  bool decodeCelsInParallel() const override {
+    return true;
+  }
+
 private:
   FileOp* m_fop;
   doc::Sprite* m_sprite;
@@ -142,6 +158,17 @@ public:
   }
 };
 
+// Compressed pixels of cel images (indexed by image ID) that were
+// compressed in background threads before writing the frame.
+struct CompressedCels {
+  // True if we can re-use (and update) the compressed data cached in
+  // each image (Image::compressedData()).
+  bool useCache = false;
+  // zlib compression level
+  int level = Z_DEFAULT_COMPRESSION;
+  std::map<ObjectId, base::buffer> images;
+};
+
 } // anonymous namespace
 
 static void ase_file_prepare_header(FILE* f, dio::AsepriteHeader* header, const Sprite* sprite,
@@ -161,7 +188,12 @@ static layer_t ase_file_write_cels(FILE* f,  FileOp* fop,
                                    const dio::AsepriteExternalFiles& ext_files,
                                    const Sprite* sprite, const Layer* layer,
                                    layer_t layer_index,
-                                   const frame_t frame);
+                                   const frame_t frame,
+                                   const CompressedCels& compressedCels);
+static void ase_file_compress_cels(FileOp* fop, const Sprite* sprite,
+                                   const frame_t frame,
+                                   CompressedCels& compressedCels);
+static int ase_file_compression_level(FileOp* fop);
 
 static void ase_file_write_padding(FILE* f, int bytes);
 static void ase_file_write_string(FILE* f, const std::string& string);
@@ -177,7 +209,8 @@ static void ase_file_write_cel_chunk(FILE* f, dio::AsepriteFrameHeader* frame_he
                                      const LayerImage* layer,
                                      const layer_t layer_index,
                                      const Sprite* sprite,
-                                     const frame_t firstFrame);
+                                     const frame_t firstFrame,
+                                     const CompressedCels& compressedCels);
 static void ase_file_write_cel_extra_chunk(FILE* f, dio::AsepriteFrameHeader* frame_header,
                                            const Cel* cel);
 static void ase_file_write_color_profile(FILE* f,
@@ -280,12 +313,22 @@ FileFormat* CreateAseFormat()
 
 bool AseFormat::onLoad(FileOp* fop)
 {
-  FileHandle handle(open_file_with_exception(fop->filename(), "rb"));
-  dio::StdioFileInterface fileInterface(handle.get());
+  // Try to map the whole file in memory, so we avoid small fread()
+  // calls for every chunk and inflate cels directly from the mapped
+  // region.
+  dio::MappedFileInterface mappedFile(fop->filename());
+  FileHandle handle;
+  std::unique_ptr<dio::StdioFileInterface> stdioFile;
+  dio::FileInterface* fileInterface = &mappedFile;
+  if (!mappedFile.isMapped()) {
+    handle = open_file_with_exception(fop->filename(), "rb");
+    stdioFile = std::make_unique<dio::StdioFileInterface>(handle.get());
+    fileInterface = stdioFile.get();
+  }
 
   DecodeDelegate delegate(fop);
   dio::AsepriteDecoder decoder;
-  decoder.initialize(&delegate, &fileInterface);
+  decoder.initialize(&delegate, fileInterface);
   if (!decoder.decode())
     return false;
 
@@ -437,10 +480,16 @@ bool AseFormat::onSave(FileOp* fop)
                                   fop->roi().toFrame());
     }
 
+    // Compress cel images of this frame in background threads
+    CompressedCels compressedCels;
+    compressedCels.useCache = fop->config().cacheCompressedCels;
+    compressedCels.level = ase_file_compression_level(fop);
+    ase_file_compress_cels(fop, sprite, frame, compressedCels);
+
     // Write cel chunks
     ase_file_write_cels(f, fop, &frame_header, ext_files,
                         sprite, sprite->root(),
-                        0, frame);
+                        0, frame, compressedCels);
 
     // Write the frame header
     ase_file_write_frame_header(f, &frame_header);
@@ -588,14 +637,16 @@ static layer_t ase_file_write_cels(FILE* f, FileOp* fop,
                                    const dio::AsepriteExternalFiles& ext_files,
                                    const Sprite* sprite, const Layer* layer,
                                    layer_t layer_index,
-                                   const frame_t frame)
+                                   const frame_t frame,
+                                   const CompressedCels& compressedCels)
 {
   if (layer->isImage()) {
     const Cel* cel = layer->cel(frame);
     if (cel) {
       ase_file_write_cel_chunk(f, frame_header, cel,
                                static_cast<const LayerImage*>(layer),
-                               layer_index, sprite, fop->roi().fromFrame());
+                               layer_index, sprite, fop->roi().fromFrame(),
+                               compressedCels);
 
       if (layer->isReference())
         ase_file_write_cel_extra_chunk(f, frame_header, cel);
@@ -615,7 +666,7 @@ static layer_t ase_file_write_cels(FILE* f, FileOp* fop,
     for (const Layer* child : static_cast<const LayerGroup*>(layer)->layers()) {
       layer_index =
         ase_file_write_cels(f, fop, frame_header, ext_files, sprite, child,
-                            layer_index, frame);
+                            layer_index, frame, compressedCels);
     }
   }
 
@@ -867,9 +918,9 @@ static void write_raw_image(FILE* f, ScanlinesGen* gen, PixelFormat pixelFormat)
 //////////////////////////////////////////////////////////////////////
 
 template<typename ImageTraits>
-static void write_compressed_image_templ(FILE* f,
-                                         ScanlinesGen* gen,
-                                         base::buffer* compressedOutput)
+static void compress_image_templ(ScanlinesGen* gen,
+                                 const int level,
+                                 base::buffer& output)
 {
   PixelIO<ImageTraits> pixel_io;
   z_stream zstream;
@@ -878,7 +929,7 @@ static void write_compressed_image_templ(FILE* f,
   zstream.zalloc = (alloc_func)0;
   zstream.zfree  = (free_func)0;
   zstream.opaque = (voidpf)0;
-  err = deflateInit(&zstream, Z_DEFAULT_COMPRESSION);
+  err = deflateInit(&zstream, level);
   if (err != Z_OK)
     throw base::Exception("ZLib error %d in deflateInit().", err);
 
@@ -902,25 +953,16 @@ static void write_compressed_image_templ(FILE* f,
 
       // Compress
       err = deflate(&zstream, flush);
-      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR) {
+        deflateEnd(&zstream);
         throw base::Exception("ZLib error %d in deflate().", err);
+      }
 
       int output_bytes = compressed.size() - zstream.avail_out;
       if (output_bytes > 0) {
-        if ((fwrite(&compressed[0], 1, output_bytes, f) != (size_t)output_bytes)
-            || ferror(f))
-          throw base::Exception("Error writing compressed image pixels.\n");
-
-        // Save the whole compressed buffer to re-use in following
-        // save options (so we don't have to re-compress the whole
-        // tileset)
-        if (compressedOutput) {
-          std::size_t n = compressedOutput->size();
-          compressedOutput->resize(n + output_bytes);
-          std::copy(compressed.begin(),
-                    compressed.begin() + output_bytes,
-                    compressedOutput->begin() + n);
-        }
+        output.insert(output.end(),
+                      compressed.begin(),
+                      compressed.begin() + output_bytes);
       }
     } while (zstream.avail_out == 0);
   }
@@ -930,40 +972,182 @@ static void write_compressed_image_templ(FILE* f,
     throw base::Exception("ZLib error %d in deflateEnd().", err);
 }
 
-static void write_compressed_image(FILE* f,
-                                   ScanlinesGen* gen,
-                                   PixelFormat pixelFormat,
-                                   base::buffer* compressedOutput = nullptr)
+// Compresses the image pixels using zlib. This function doesn't
+// touch any FILE so it can be called from background threads.
+static void compress_image(ScanlinesGen* gen,
+                           PixelFormat pixelFormat,
+                           const int level,
+                           base::buffer& output)
 {
   switch (pixelFormat) {
     case IMAGE_RGB:
-      write_compressed_image_templ<RgbTraits>(f, gen, compressedOutput);
+      compress_image_templ<RgbTraits>(gen, level, output);
       break;
 
     case IMAGE_GRAYSCALE:
-      write_compressed_image_templ<GrayscaleTraits>(f, gen, compressedOutput);
+      compress_image_templ<GrayscaleTraits>(gen, level, output);
       break;
 
     case IMAGE_INDEXED:
-      write_compressed_image_templ<IndexedTraits>(f, gen, compressedOutput);
+      compress_image_templ<IndexedTraits>(gen, level, output);
       break;
 
     case IMAGE_TILEMAP:
-      write_compressed_image_templ<TilemapTraits>(f, gen, compressedOutput);
+      compress_image_templ<TilemapTraits>(gen, level, output);
       break;
   }
 }
 
+// Returns the zlib compression level to use in deflateInit()
+static int ase_file_compression_level(FileOp* fop)
+{
+  switch (fop->config().compressionLevel) {
+    case gen::AseCompressionLevel::FAST: return Z_BEST_SPEED;
+    case gen::AseCompressionLevel::BEST: return Z_BEST_COMPRESSION;
+    case gen::AseCompressionLevel::DEFAULT:
+    default:
+      return Z_DEFAULT_COMPRESSION;
+  }
+}
+
+static void write_compressed_data(FILE* f, const base::buffer& data)
+{
+  if (data.empty())
+    return;
+
+  if ((fwrite(&data[0], 1, data.size(), f) != data.size())
+      || ferror(f))
+    throw base::Exception("Error writing compressed image pixels.\n");
+}
+
+static void write_compressed_image(FILE* f,
+                                   ScanlinesGen* gen,
+                                   PixelFormat pixelFormat,
+                                   const int level,
+                                   base::buffer* compressedOutput = nullptr)
+{
+  base::buffer compressed;
+  compress_image(gen, pixelFormat, level, compressed);
+  write_compressed_data(f, compressed);
+
+  // Save the whole compressed buffer to re-use in following save
+  // options (so we don't have to re-compress the whole tileset)
+  if (compressedOutput) {
+    if (compressedOutput->empty())
+      *compressedOutput = std::move(compressed);
+    else
+      compressedOutput->insert(compressedOutput->end(),
+                               compressed.begin(),
+                               compressed.end());
+  }
+}
+
+// Compresses the images of all cels in the given frame that will be
+// saved as compressed cels/tilemaps. Each image is compressed in its
+// own buffer in a worker thread, and then ase_file_write_cel_chunk()
+// writes the buffers in the original order, so the output file is the
+// same as if we compress each cel sequentially.
+static void ase_file_compress_cels(FileOp* fop, const Sprite* sprite,
+                                   const frame_t frame,
+                                   CompressedCels& compressedCels)
+{
+  if (doc::task_scheduler_threads() < 2)
+    return;
+
+  const frame_t firstFrame = fop->roi().fromFrame();
+  std::vector<const Image*> images;
+  for (const Layer* layer : sprite->allLayers()) {
+    if (!layer->isImage())
+      continue;
+
+    const Cel* cel = layer->cel(frame);
+    if (!cel || !cel->image())
+      continue;
+
+    // Linked cels are saved as links (except when the original cel is
+    // outside the ROI, which is checked in ase_file_write_cel_chunk()
+    // anyway).
+    const Cel* link = cel->link();
+    if (link && link->frame() >= firstFrame)
+      continue;
+
+    const Image* image = cel->image();
+    if (compressedCels.images.find(image->id()) != compressedCels.images.end())
+      continue;
+
+    // The image wasn't modified since the last load/save, so we don't
+    // need to compress it again
+    if (compressedCels.useCache &&
+        image->hasValidCompressedData(compressedCels.level))
+      continue;
+
+    // Create the entry here so the worker threads don't modify the
+    // std::map structure.
+    compressedCels.images[image->id()];
+    images.push_back(image);
+  }
+
+  // Nothing to parallelize
+  if (images.size() < 2) {
+    compressedCels.images.clear();
+    return;
+  }
+
+  // Exceptions are re-thrown by wait()
+  doc::TaskGroup group;
+  for (const Image* image : images) {
+    base::buffer& output = compressedCels.images[image->id()];
+    group.run(
+      [&compressedCels, &output, image]{
+        ImageScanlines scan(image);
+        compress_image(&scan, image->pixelFormat(),
+                       compressedCels.level, output);
+      });
+  }
+  group.wait();
+}
+
 //////////////////////////////////////////////////////////////////////
 // Cel Chunk
 //////////////////////////////////////////////////////////////////////
 
+// Writes the compressed pixels of a cel image re-using the cached
+// compressed data of the image (or the data compressed in background
+// threads) when it's possible.
+static void ase_file_write_cel_image(FILE* f,
+                                     const Image* image,
+                                     const CompressedCels& compressedCels)
+{
+  if (compressedCels.useCache &&
+      image->hasValidCompressedData(compressedCels.level)) {
+    write_compressed_data(f, image->compressedData());
+    return;
+  }
+
+  auto it = compressedCels.images.find(image->id());
+  if (it != compressedCels.images.end()) {
+    write_compressed_data(f, it->second);
+    if (compressedCels.useCache)
+      image->setCompressedData(it->second, compressedCels.level);
+  }
+  else {
+    ImageScanlines scan(image);
+    base::buffer compressedData;
+    write_compressed_image(f, &scan, image->pixelFormat(),
+                           compressedCels.level,
+                           compressedCels.useCache ? &compressedData: nullptr);
+    if (compressedCels.useCache)
+      image->setCompressedData(compressedData, compressedCels.level);
+  }
+}
+
 static void ase_file_write_cel_chunk(FILE* f, dio::AsepriteFrameHeader* frame_header,
                                      const Cel* cel,
                                      const LayerImage* layer,
                                      const layer_t layer_index,
                                      const Sprite* sprite,
-                                     const frame_t firstFrame)
+                                     const frame_t firstFrame,
+                                     const CompressedCels& compressedCels)
 {
   ChunkWriter chunk(f, frame_header, ASE_FILE_CHUNK_CEL);
 
@@ -1029,8 +1213,7 @@ static void ase_file_write_cel_chunk(FILE* f, dio::AsepriteFrameHeader* frame_he
         fputw(image->width(), f);
         fputw(image->height(), f);
 
-        ImageScanlines scan(image);
-        write_compressed_image(f, &scan, image->pixelFormat());
+        ase_file_write_cel_image(f, image, compressedCels);
       }
       else {
         // Width and height
@@ -1054,8 +1237,7 @@ static void ase_file_write_cel_chunk(FILE* f, dio::AsepriteFrameHeader* frame_he
       fputl(tile_f_dflip, f);
       ase_file_write_padding(f, 10);
 
-      ImageScanlines scan(image);
-      write_compressed_image(f, &scan, IMAGE_TILEMAP);
+      ase_file_write_cel_image(f, image, compressedCels);
     }
   }
 }
@@ -1477,10 +1659,13 @@ static void ase_file_write_tileset_chunk(FILE* f, FileOp* fop,
   // Flag 2 = tileset
   if (flags & ASE_TILESET_FLAG_EMBEDDED) {
     size_t beg = ftell(f);
+    const int level = ase_file_compression_level(fop);
 
-    // Save the cached tileset compressed data
+    // Save the cached tileset compressed data (if it was compressed
+    // with the same level)
     if (!tileset->compressedData().empty() &&
-        tileset->compressedDataVersion() == tileset->version()) {
+        tileset->compressedDataVersion() == tileset->version() &&
+        tileset->compressedDataLevel() == level) {
       const base::buffer& data = tileset->compressedData();
 
       ASEFILE_TRACE("[%d] saving compressed tileset (%s)\n",
@@ -1502,12 +1687,12 @@ static void ase_file_write_tileset_chunk(FILE* f, FileOp* fop,
         compressedDataPtr = &compressedData;
 
       write_compressed_image(f, &gen, tileset->sprite()->pixelFormat(),
-                             compressedDataPtr);
+                             level, compressedDataPtr);
 
       // As we've just compressed the tileset, we can cache this same
       // data (so saving the file again will not need recompressing).
       if (compressedDataPtr)
-        tileset->setCompressedData(compressedData);
+        tileset->setCompressedData(compressedData, level);
 
       size_t end = ftell(f);
       fseek(f, beg, SEEK_SET);
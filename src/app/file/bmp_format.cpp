@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -21,9 +21,14 @@
 #include "app/file/format_options.h"
 #include "base/cfile.h"
 #include "base/file_handle.h"
+#include "doc/algorithm/parallel_bands.h"
 #include "doc/doc.h"
 #include "fmt/format.h"
 
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
 namespace app {
 
 // Max supported .bmp size (to filter out invalid image sizes)
@@ -679,6 +684,66 @@ static void read_32bit_line(int length, FILE *f, Image *image, int line,
   }
 }
 
+// Reads all the rows of uncompressed 8, 24 and 32 bpp images with
+// one fread() call and decodes them in parallel (each row is
+// independent). Returns false for other bit depths.
+static bool read_image_rows_at_once(FILE* f, Image* image,
+                                    const BITMAPINFOHEADER* infoheader,
+                                    bool& withAlpha)
+{
+  const int bpp = infoheader->biBitCount;
+  if (bpp != 8 && bpp != 24 && bpp != 32)
+    return false;
+
+  const int width = infoheader->biWidth;
+  const int height = ABS((int)infoheader->biHeight);
+  const bool bottomUp = ((int)infoheader->biHeight > 0);
+  const size_t rowBytes = ((size_t(width)*bpp + 31) / 32) * 4;
+
+  // Missing data of truncated files is read as zeros
+  std::vector<uint8_t> data(rowBytes*height, 0);
+  if (fread(data.data(), 1, data.size(), f) != data.size() && ferror(f))
+    return true;
+
+  std::atomic<bool> alpha(false);
+  doc::algorithm::for_each_band(
+    height,
+    [&](const int y0, const int h) {
+      bool bandAlpha = false;
+      for (int y=y0; y<y0+h; ++y) {
+        const uint8_t* src = data.data() + rowBytes*y;
+        const int line = (bottomUp ? height-1-y: y);
+        switch (bpp) {
+          case 8:
+            std::copy(src, src+width,
+                      (uint8_t*)image->getPixelAddress(0, line));
+            break;
+          case 24: {
+            auto dst = (uint32_t*)image->getPixelAddress(0, line);
+            for (int x=0; x<width; ++x, src+=3)
+              dst[x] = rgba(src[2], src[1], src[0], 255);
+            break;
+          }
+          case 32: {
+            auto dst = (uint32_t*)image->getPixelAddress(0, line);
+            for (int x=0; x<width; ++x, src+=4) {
+              if (src[3])
+                bandAlpha = true;
+              dst[x] = rgba(src[2], src[1], src[0], src[3]);
+            }
+            break;
+          }
+        }
+      }
+      if (bandAlpha)
+        alpha = true;
+    });
+
+  if (alpha)
+    withAlpha = true;
+  return true;
+}
+
 /* read_image:
  *  For reading the noncompressed BMP image format.
  */
@@ -686,6 +751,17 @@ static void read_image(FILE *f, Image *image, const BITMAPINFOHEADER *infoheader
 {
   int i, line, height, dir;
 
+  if (read_image_rows_at_once(f, image, infoheader, withAlpha)) {
+    fop->setProgress(1.0);
+    if (infoheader->biBitCount == 32 && !withAlpha) {
+      LockImageBits<RgbTraits> imageBits(image, image->bounds());
+      auto imgIt = imageBits.begin(), imgEnd = imageBits.end();
+      for (; imgIt != imgEnd; ++imgIt)
+        *imgIt |= 0xff000000;
+    }
+    return;
+  }
+
   height = (int)infoheader->biHeight;
   line   = height < 0 ? 0: height-1;
   dir    = height < 0 ? 1: -1;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (c) 2018-2023  Igara Studio S.A.
+// Copyright (c) 2018-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -25,6 +25,7 @@
 
 #include "css_options.xml.h"
 
+#include <vector>
 
 namespace app {
 
@@ -35,11 +36,13 @@ class CssFormat : public FileFormat {
   public:
     CssOptions() : pixelScale(1), gutterSize(0),
                    generateHtml(false),
-                   withVars(false) { }
+                   withVars(false),
+                   mergePixels(true) { }
     int pixelScale;
     int gutterSize;
     bool generateHtml;
     bool withVars;
+    bool mergePixels;
   };
 
   const char* onGetName() const override {
@@ -156,73 +159,175 @@ bool CssFormat::onSave(FileOp* fop)
   }
   fprintf(f, "\tbox-shadow:\n");
   int num_printed_pixels = 0;
-  switch (image->pixelFormat()) {
-    case IMAGE_RGB: {
-      for (y=0; y<image->height(); y++) {
-        for (x=0; x<image->width(); x++) {
-          c = get_pixel_fast<RgbTraits>(image.get(), x, y);
-          alpha = rgba_geta(c);
-          if (alpha != 0x00) {
-            print_shadow_color(x, y, rgba_getr(c), rgba_getg(c), rgba_getb(c),
-                               alpha, num_printed_pixels>0);
-            num_printed_pixels ++;
+
+  // Squares of pixels of the same color can be drawn with just one
+  // shadow using the spread radius (only squares with an odd size,
+  // so the shadow offset is still in whole pixels). This is not
+  // possible with gutters between pixels, or with CSS variables (as
+  // the gutter size can be changed later).
+  if (css_options->mergePixels &&
+      !css_options->withVars &&
+      css_options->gutterSize == 0) {
+    const int w = image->width();
+    const int h = image->height();
+    std::vector<color_t> colors(w*h, 0);
+
+    // RGBA colors of all pixels (0 for pixels that are not exported)
+    switch (image->pixelFormat()) {
+      case IMAGE_RGB:
+        for (y=0; y<h; y++)
+          for (x=0; x<w; x++) {
+            c = get_pixel_fast<RgbTraits>(image.get(), x, y);
+            if (rgba_geta(c) != 0x00)
+              colors[y*w+x] = c;
           }
+        break;
+      case IMAGE_GRAYSCALE:
+        for (y=0; y<h; y++)
+          for (x=0; x<w; x++) {
+            c = get_pixel_fast<GrayscaleTraits>(image.get(), x, y);
+            auto v = graya_getv(c);
+            alpha = graya_geta(c);
+            if (alpha != 0x00)
+              colors[y*w+x] = rgba(v, v, v, alpha);
+          }
+        break;
+      case IMAGE_INDEXED: {
+        color_t mask_color = -1;
+        if (fop->document()->sprite()->backgroundLayer() == NULL ||
+            !fop->document()->sprite()->backgroundLayer()->isVisible()) {
+          mask_color = fop->document()->sprite()->transparentColor();
+        }
+        color_t palette[256];
+        for (y=0; y<256; y++) {
+          fop->sequenceGetColor(y, &r, &g, &b);
+          fop->sequenceGetAlpha(y, &a);
+          palette[y] = rgba(r, g, b, a);
         }
-        fop->setProgress((float)y / (float)(image->height()));
+        for (y=0; y<h; y++)
+          for (x=0; x<w; x++) {
+            c = get_pixel_fast<IndexedTraits>(image.get(), x, y);
+            if (c != mask_color)
+              colors[y*w+x] = palette[c];
+          }
+        break;
       }
-      break;
     }
-    case IMAGE_GRAYSCALE: {
-      for (y=0; y<image->height(); y++) {
-        for (x=0; x<image->width(); x++) {
-          c = get_pixel_fast<GrayscaleTraits>(image.get(), x, y);
-          auto v = graya_getv(c);
-          alpha = graya_geta(c);
-          if (alpha != 0x00) {
-            print_shadow_color(x, y, v, v, v, alpha, num_printed_pixels>0);
-            num_printed_pixels ++;
-          }
+
+    std::vector<bool> done(w*h, false);
+    auto same = [&](int u, int v, color_t color) {
+      return (!done[v*w+u] && colors[v*w+u] == color);
+    };
+
+    for (y=0; y<h; y++) {
+      for (x=0; x<w; x++) {
+        const color_t color = colors[y*w+x];
+        if (done[y*w+x] || rgba_geta(color) == 0)
+          continue;
+
+        // Grow the square (from its top-left corner) by two pixels
+        int k = 1;
+        for (int nk=3; x+nk <= w && y+nk <= h; k=nk, nk+=2) {
+          bool ok = true;
+          for (int v=y; ok && v<y+nk; ++v)
+            for (int u=(v < y+k ? x+k: x); ok && u<x+nk; ++u)
+              ok = same(u, v, color);
+          if (!ok)
+            break;
+        }
+        for (int v=y; v<y+k; ++v)
+          for (int u=x; u<x+k; ++u)
+            done[v*w+u] = true;
+
+        const int half = (k-1)/2;
+        fprintf(f, num_printed_pixels>0 ? ",\n": "\n");
+        if (k > 1) {
+          fprintf(f, "\t%dpx %dpx 0 %dpx ",
+                  (x+half) * css_options->pixelScale,
+                  (y+half) * css_options->pixelScale,
+                  half * css_options->pixelScale);
         }
-        fop->setProgress((float)y / (float)(image->height()));
+        else {
+          fprintf(f, "\t%dpx %dpx ",
+                  x * css_options->pixelScale,
+                  y * css_options->pixelScale);
+        }
+        print_color(rgba_getr(color), rgba_getg(color),
+                    rgba_getb(color), rgba_geta(color));
+        num_printed_pixels ++;
       }
-      break;
+      fop->setProgress((float)y / (float)(image->height()));
     }
-    case IMAGE_INDEXED: {
-      unsigned char image_palette[256][4];
-      for (y=0; !css_options->withVars && y<256; y++) {
-        fop->sequenceGetColor(y, &r, &g, &b);
-        image_palette[y][0] = r;
-        image_palette[y][1] = g;
-        image_palette[y][2] = b;
-        fop->sequenceGetAlpha(y, &a);
-        image_palette[y][3] = a;
-      }
-      color_t mask_color = -1;
-      if (fop->document()->sprite()->backgroundLayer() == NULL ||
-          !fop->document()->sprite()->backgroundLayer()->isVisible()) {
-        mask_color = fop->document()->sprite()->transparentColor();
+  }
+  else {
+    switch (image->pixelFormat()) {
+      case IMAGE_RGB: {
+        for (y=0; y<image->height(); y++) {
+          for (x=0; x<image->width(); x++) {
+            c = get_pixel_fast<RgbTraits>(image.get(), x, y);
+            alpha = rgba_geta(c);
+            if (alpha != 0x00) {
+              print_shadow_color(x, y, rgba_getr(c), rgba_getg(c), rgba_getb(c),
+                                 alpha, num_printed_pixels>0);
+              num_printed_pixels ++;
+            }
+          }
+          fop->setProgress((float)y / (float)(image->height()));
+        }
+        break;
       }
-      for (y=0; y<image->height(); y++) {
-        for (x=0; x<image->width(); x++) {
-          c = get_pixel_fast<IndexedTraits>(image.get(), x, y);
-          if (c != mask_color) {
-            if (css_options->withVars) {
-              print_shadow_index(x, y, c, num_printed_pixels>0);
+      case IMAGE_GRAYSCALE: {
+        for (y=0; y<image->height(); y++) {
+          for (x=0; x<image->width(); x++) {
+            c = get_pixel_fast<GrayscaleTraits>(image.get(), x, y);
+            auto v = graya_getv(c);
+            alpha = graya_geta(c);
+            if (alpha != 0x00) {
+              print_shadow_color(x, y, v, v, v, alpha, num_printed_pixels>0);
+              num_printed_pixels ++;
             }
-            else {
-              print_shadow_color(x, y,
-                     image_palette[c][0] & 0xff,
-                     image_palette[c][1] & 0xff,
-                     image_palette[c][2] & 0xff,
-                     image_palette[c][3] & 0xff,
-                     num_printed_pixels>0);
+          }
+          fop->setProgress((float)y / (float)(image->height()));
+        }
+        break;
+      }
+      case IMAGE_INDEXED: {
+        unsigned char image_palette[256][4];
+        for (y=0; !css_options->withVars && y<256; y++) {
+          fop->sequenceGetColor(y, &r, &g, &b);
+          image_palette[y][0] = r;
+          image_palette[y][1] = g;
+          image_palette[y][2] = b;
+          fop->sequenceGetAlpha(y, &a);
+          image_palette[y][3] = a;
+        }
+        color_t mask_color = -1;
+        if (fop->document()->sprite()->backgroundLayer() == NULL ||
+            !fop->document()->sprite()->backgroundLayer()->isVisible()) {
+          mask_color = fop->document()->sprite()->transparentColor();
+        }
+        for (y=0; y<image->height(); y++) {
+          for (x=0; x<image->width(); x++) {
+            c = get_pixel_fast<IndexedTraits>(image.get(), x, y);
+            if (c != mask_color) {
+              if (css_options->withVars) {
+                print_shadow_index(x, y, c, num_printed_pixels>0);
+              }
+              else {
+                print_shadow_color(x, y,
+                       image_palette[c][0] & 0xff,
+                       image_palette[c][1] & 0xff,
+                       image_palette[c][2] & 0xff,
+                       image_palette[c][3] & 0xff,
+                       num_printed_pixels>0);
+              }
+              num_printed_pixels ++;
             }
-            num_printed_pixels ++;
           }
+          fop->setProgress((float)y / (float)(image->height()));
         }
-        fop->setProgress((float)y / (float)(image->height()));
+        break;
       }
-      break;
     }
   }
   fprintf(f, ";\n}\n");
@@ -268,11 +373,15 @@ FormatOptionsPtr CssFormat::onAskUserForFormatOptions(FileOp* fop)
       if (pref.isSet(pref.css.generateHtml))
         opts->generateHtml = pref.css.generateHtml();
 
+      if (pref.isSet(pref.css.mergePixels))
+        opts->mergePixels = pref.css.mergePixels();
+
       if (pref.css.showAlert()) {
         app::gen::CssOptions win;
         win.pixelScale()->setTextf("%d", opts->pixelScale);
         win.withVars()->setSelected(opts->withVars);
         win.generateHtml()->setSelected(opts->generateHtml);
+        win.mergePixels()->setSelected(opts->mergePixels);
         win.openWindowInForeground();
 
         if (win.closer() == win.ok()) {
@@ -280,10 +389,12 @@ FormatOptionsPtr CssFormat::onAskUserForFormatOptions(FileOp* fop)
           pref.css.pixelScale((int)win.pixelScale()->textInt());
           pref.css.withVars(win.withVars()->isSelected());
           pref.css.generateHtml(win.generateHtml()->isSelected());
+          pref.css.mergePixels(win.mergePixels()->isSelected());
 
           opts->generateHtml = pref.css.generateHtml();
           opts->withVars = pref.css.withVars();
           opts->pixelScale = pref.css.pixelScale();
+          opts->mergePixels = pref.css.mergePixels();
         }
         else {
           opts.reset();
@@ -26,6 +26,7 @@
 #include "app/i18n/strings.h"
 #include "app/modules/gui.h"
 #include "app/modules/palettes.h"
+#include "app/perf_trace.h"
 #include "app/pref/preferences.h"
 #include "app/tx.h"
 #include "app/ui/incompat_file_window.h"
@@ -48,8 +49,10 @@
 #include "open_sequence.xml.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <cstdarg>
+#include <thread>
 
 namespace app {
 
@@ -100,7 +103,7 @@ public:
         m_tmpScaledImage.get(),
         doc::algorithm::RESIZE_METHOD_NEAREST_NEIGHBOR,
         palette(frame),
-        m_sprite->rgbMap(frame),
+        nullptr, // The RgbMap is not needed for nearest neighbor
         image->maskColor());
     }
   }
@@ -176,11 +179,12 @@ public:
         dst,
         doc::algorithm::RESIZE_METHOD_NEAREST_NEIGHBOR,
         palette(frame),
-        m_sprite->rgbMap(frame),
+        nullptr, // The RgbMap is not needed for nearest neighbor
         m_tmpUnscaledRender->maskColor());
     }
   }
 
+  const gfx::PointF& scale() const { return m_scale; }
   void setScale(const gfx::PointF& scale) {
     m_scale = scale;
     m_spec.setWidth(m_spec.width() * m_scale.x);
@@ -525,6 +529,10 @@ FileOp* FileOp::createLoadDocumentOperation(Context* context,
   if (flags & FILE_LOAD_ONE_FRAME)
     fop->m_oneframe = true;
 
+  // Load the document structure without pixels
+  if (flags & FILE_LOAD_METADATA_ONLY)
+    fop->m_metadataOnly = true;
+
   if (flags & FILE_LOAD_CREATE_PALETTE)
     fop->m_createPaletteFromRgba = true;
 
@@ -544,10 +552,11 @@ FileOp* FileOp::createSaveDocumentOperation(const Context* context,
                                             const FileOpROI& roi,
                                             const std::string& filename,
                                             const std::string& filenameFormatArg,
-                                            const bool ignoreEmptyFrames)
+                                            const bool ignoreEmptyFrames,
+                                            const FileOpConfig* config)
 {
   std::unique_ptr<FileOp> fop(
-    new FileOp(FileOpSave, const_cast<Context*>(context), nullptr));
+    new FileOp(FileOpSave, const_cast<Context*>(context), config));
 
   // Document to save
   fop->m_document = const_cast<Doc*>(roi.document());
@@ -837,6 +846,9 @@ bool FileOp::checkIfFormatSupportResizeOnTheFly(const std::string& filename)
 // TODO refactor this code
 void FileOp::operate(IFileOpProgress* progress)
 {
+  PerfScope perf(PerfCategory::FileOp,
+                 m_type == FileOpLoad ? "FileOp::operate (load)":
+                                        "FileOp::operate (save)");
   ASSERT(!isDone());
 
   m_progressInterface = progress;
@@ -845,8 +857,16 @@ void FileOp::operate(IFileOpProgress* progress)
   if (m_type == FileOpLoad &&
       m_format != NULL &&
       m_format->support(FILE_SUPPORT_LOAD)) {
+    // Load a sequence of files in parallel (each file is decoded in
+    // a different thread)
+    const int loadThreads = std::max(1, int(std::thread::hardware_concurrency()));
+    if (isSequence() &&
+        loadThreads > 1 &&
+        m_seq.filename_list.size() > 1) {
+      loadSequenceInParallel(loadThreads);
+    }
     // Load a sequence
-    if (isSequence()) {
+    else if (isSequence()) {
       // Default palette
       m_seq.palette->makeBlack();
 
@@ -1005,8 +1025,18 @@ void FileOp::operate(IFileOpProgress* progress)
     //      is already checked in SaveFileBaseCommand::saveDocumentInBackground
     //      and only in UI mode (so the CLI still works)
 
+    // Save a sequence of static images in parallel (each frame is
+    // saved in a different file)
+    const int saveThreads = std::max(1, int(std::thread::hardware_concurrency()));
+    if (isSequence() &&
+        saveThreads > 1 &&
+        m_roi.frames() > 1 &&
+        !m_format->support(FILE_SUPPORT_FRAMES)) {
+      ASSERT(m_format->support(FILE_SUPPORT_SEQUENCES));
+      saveSequenceInParallel(saveThreads);
+    }
     // Save a sequence
-    if (isSequence()) {
+    else if (isSequence()) {
       ASSERT(m_format->support(FILE_SUPPORT_SEQUENCES));
 
       Sprite* sprite = m_document->sprite();
@@ -1311,6 +1341,8 @@ void FileOp::setLoadedFormatOptions(const FormatOptionsPtr& opts)
 void FileOp::sequenceSetNColors(int ncolors)
 {
   m_seq.palette->resize(ncolors);
+  if (m_seq.palette_changes)
+    m_seq.palette_changes->push_back({ SeqPaletteChange::NColors, ncolors, 0 });
 }
 
 int FileOp::sequenceGetNColors() const
@@ -1321,6 +1353,9 @@ int FileOp::sequenceGetNColors() const
 void FileOp::sequenceSetColor(int index, int r, int g, int b)
 {
   m_seq.palette->setEntry(index, rgba(r, g, b, 255));
+  if (m_seq.palette_changes)
+    m_seq.palette_changes->push_back({ SeqPaletteChange::Color, index,
+                                       rgba(r, g, b, 255) });
 }
 
 void FileOp::sequenceGetColor(int index, int* r, int* g, int* b) const
@@ -1346,6 +1381,9 @@ void FileOp::sequenceSetAlpha(int index, int a)
   int b = rgba_getb(c);
 
   m_seq.palette->setEntry(index, rgba(r, g, b, a));
+  if (m_seq.palette_changes)
+    m_seq.palette_changes->push_back({ SeqPaletteChange::Alpha, index,
+                                       color_t(a) });
 }
 
 void FileOp::sequenceGetAlpha(int index, int* a) const
@@ -1531,6 +1569,8 @@ FileOp::FileOp(FileOpType type,
   , m_done(false)
   , m_stop(false)
   , m_oneframe(false)
+  , m_metadataOnly(false)
+  , m_thumbnailSize(0)
   , m_createPaletteFromRgba(false)
   , m_ignoreEmpty(false)
   , m_embeddedColorProfile(false)
@@ -1553,6 +1593,7 @@ FileOp::FileOp(FileOpType type,
   m_seq.last_cel = nullptr;
   m_seq.duration = 100;
   m_seq.flags = 0;
+  m_seq.palette_changes = nullptr;
 }
 
 void FileOp::prepareForSequence()
@@ -1561,6 +1602,335 @@ void FileOp::prepareForSequence()
   m_formatOptions.reset();
 }
 
+// Decodes the files of the sequence from "nthreads" worker
+// threads. Each worker uses its own FileOp (with its own document and
+// palette), and the decoded images are added to the sprite in the
+// order of m_seq.filename_list once all files are loaded. The changes
+// of each file to the palette are recorded and applied in the same
+// order, so the result (frames, palettes, and errors) is the same as
+// loading the files one after another (where each file modifies the
+// palette of the previous one).
+void FileOp::loadSequenceInParallel(const int nthreads)
+{
+  struct Job {
+    ImageRef image;
+    SeqPaletteChanges paletteChanges;
+    bool hasAlpha = false;
+    FormatOptionsPtr formatOptions;
+    std::string error;
+  };
+
+  const int n = int(m_seq.filename_list.size());
+  std::vector<Job> jobs(n);
+
+  m_seq.progress_offset = 0.0f;
+  m_seq.progress_fraction = 1.0f;
+
+  std::atomic<int> nextJob(0);
+  std::mutex doneMutex;
+  int doneJobs = 0;
+
+  // FileOp which loaded the first file of the sequence, its document
+  // will be the document of the whole sequence.
+  std::unique_ptr<FileOp> firstFop;
+
+  auto worker = [&]{
+    std::unique_ptr<FileOp> fop(new FileOp(FileOpLoad, m_context, &m_config));
+    fop->m_format = m_format;
+    fop->prepareForSequence();
+    bool loadedFirstFile = false;
+
+    while (!isStop()) {
+      const int i = nextJob++;
+      if (i >= n)
+        break;
+
+      Job& job = jobs[i];
+
+      // The palette of the previous file loaded by this worker isn't
+      // the previous file of the sequence, so we only record the
+      // changes to the palette here.
+      fop->m_filename = m_seq.filename_list[i];
+      fop->m_seq.palette->resize(256);
+      fop->m_seq.palette->makeBlack();
+      fop->m_seq.palette_changes = &job.paletteChanges;
+      fop->m_seq.has_alpha = false;
+      fop->m_error.clear();
+
+      bool loadres = false;
+      try {
+        loadres = m_format->load(fop.get());
+      }
+      catch (const std::exception& e) {
+        fop->setError("%s", e.what());
+      }
+
+      if (!fop->m_error.empty())
+        job.error = fop->m_error;
+      if (!loadres) {
+        job.error +=
+          fmt::format("Error loading frame {} from file \"{}\"\n",
+                      i+1, fop->m_filename);
+      }
+      else if (fop->m_seq.last_cel) {
+        job.image = fop->m_seq.image;
+        job.hasAlpha = fop->m_seq.has_alpha;
+        job.formatOptions = fop->m_formatOptions;
+      }
+
+      fop->m_seq.image.reset();
+      fop->m_seq.palette_changes = nullptr;
+      delete fop->m_seq.last_cel;
+      fop->m_seq.last_cel = nullptr;
+
+      // The first file is always the first one loaded by its worker,
+      // so the sprite of this worker was created from it.
+      if (i == 0)
+        loadedFirstFile = true;
+
+      const std::lock_guard lock(doneMutex);
+      ++doneJobs;
+      setProgress(double(doneJobs) / double(n));
+    }
+
+    if (loadedFirstFile) {
+      const std::lock_guard lock(doneMutex);
+      firstFop = std::move(fop);
+    }
+    else {
+      delete fop->releaseDocument();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i=1; i<std::min(nthreads, n); ++i)
+    threads.emplace_back(worker);
+  worker();
+  for (std::thread& thread : threads)
+    thread.join();
+
+  if (firstFop) {
+    m_document = firstFop->releaseDocument();
+    m_seq.layer = firstFop->m_seq.layer;
+    m_embeddedColorProfile = firstFop->m_embeddedColorProfile;
+    m_embeddedGridBounds = firstFop->m_embeddedGridBounds;
+  }
+
+  // Add the images in the same order of the files (stopping in the
+  // first file that cannot be loaded)
+  frame_t frame(0);
+  gfx::Size canvasSize(0, 0);
+  m_seq.has_alpha = false;
+
+  // Same default palette as the sequential loading
+  m_seq.palette->makeBlack();
+
+  for (Job& job : jobs) {
+    if (!job.error.empty())
+      setError("%s", job.error.c_str());
+
+    if (!m_document || !job.image)
+      break;
+
+    Sprite* sprite = m_document->sprite();
+    if (job.image->pixelFormat() != sprite->pixelFormat()) {
+      setError("Error: image does not match color mode\n"
+               "Error loading frame %d from file \"%s\"\n",
+               frame+1, m_seq.filename_list[frame].c_str());
+      break;
+    }
+
+    canvasSize |= job.image->size();
+
+    Cel* cel = new Cel(frame, ImageRef(nullptr));
+    cel->data()->setImage(job.image, m_seq.layer);
+    m_seq.layer->addCel(cel);
+
+    applySeqPaletteChanges(job.paletteChanges, m_seq.palette);
+    if (sprite->palette(frame)->countDiff(m_seq.palette, NULL, NULL) > 0) {
+      m_seq.palette->setFrame(frame);
+      sprite->setPalette(m_seq.palette, true);
+    }
+
+    if (job.hasAlpha)
+      m_seq.has_alpha = true;
+    if (job.formatOptions)
+      m_formatOptions = job.formatOptions;
+
+    sprite->setFrameDuration(frame, m_seq.duration);
+    ++frame;
+  }
+
+  // Error reading the first frame
+  if (frame == 0) {
+    delete m_document;
+    m_document = nullptr;
+    return;
+  }
+
+  // Configure the layer as the 'Background'
+  if (!m_seq.has_alpha)
+    m_seq.layer->configureAsBackground();
+
+  // Set the final canvas size (as the bigger loaded frame/image).
+  m_document->sprite()->setSize(canvasSize.w,
+                                canvasSize.h);
+
+  // Set the frames range
+  m_document->sprite()->setTotalFrames(frame);
+
+  // Sets special options from the specific format (e.g. BMP file can
+  // contain the number of bits per pixel).
+  m_document->setFormatOptions(m_formatOptions);
+}
+
+// static
+void FileOp::applySeqPaletteChanges(const SeqPaletteChanges& changes,
+                                    Palette* palette)
+{
+  for (const SeqPaletteChange& change : changes) {
+    switch (change.type) {
+      case SeqPaletteChange::NColors:
+        palette->resize(change.index);
+        break;
+      case SeqPaletteChange::Color:
+        palette->setEntry(change.index, change.value);
+        break;
+      case SeqPaletteChange::Alpha: {
+        const color_t c = palette->getEntry(change.index);
+        palette->setEntry(change.index,
+                          rgba(rgba_getr(c), rgba_getg(c), rgba_getb(c),
+                               int(change.value)));
+        break;
+      }
+    }
+  }
+}
+
+// Renders and saves each frame of the sequence from "nthreads"
+// worker threads. Each frame is saved using its own FileOp (with its
+// own image/palette/abstract image), and the file names are taken
+// from m_seq.filename_list, so the result is the same as saving the
+// frames one after another.
+void FileOp::saveSequenceInParallel(const int nthreads)
+{
+  const Sprite* sprite = m_document->sprite();
+
+  struct Job {
+    frame_t frame;
+    frame_t outputFrame;
+    gfx::Rect bounds;
+    std::string error;
+  };
+
+  std::vector<Job> jobs;
+  frame_t outputFrame = 0;
+  for (frame_t frame : m_roi.framesSequence()) {
+    gfx::Rect bounds = m_roi.frameBounds(frame);
+    if (bounds.isEmpty())
+      continue; // Skip frame because there is no slice key
+
+    jobs.push_back(Job{ frame, outputFrame, bounds, std::string() });
+    ++outputFrame;
+  }
+
+  // Make directories from this thread (so two workers don't try to
+  // create the same directory at the same time)
+  for (const Job& job : jobs) {
+    m_filename = m_seq.filename_list[job.outputFrame];
+    makeDirectories();
+  }
+  m_filename = *m_seq.filename_list.begin();
+  if (hasError())
+    return;
+
+  m_seq.progress_offset = 0.0f;
+  m_seq.progress_fraction = 1.0f;
+
+  std::atomic<int> nextJob(0);
+  std::mutex doneMutex;
+  int doneJobs = 0;
+
+  auto worker = [&]{
+    render::Render render;
+    render.setNewBlend(m_config.newBlend);
+
+    // FileOp used to save each frame of this worker
+    std::unique_ptr<FileOp> fop(new FileOp(FileOpSave, m_context, &m_config));
+    fop->m_format = m_format;
+    fop->m_document = m_document;
+    fop->m_roi = m_roi;
+    fop->m_formatOptions = m_formatOptions;
+    fop->m_seq.palette = new Palette(frame_t(0), 256);
+    fop->m_seq.image.reset(Image::create(sprite->pixelFormat(),
+                                         m_roi.fileCanvasSize().w,
+                                         m_roi.fileCanvasSize().h));
+    if (m_abstractImage) {
+      fop->makeAbstractImage();
+      fop->m_abstractImage->setScale(m_abstractImage->scale());
+    }
+
+    while (!isStop()) {
+      const int i = nextJob++;
+      if (i >= int(jobs.size()))
+        break;
+
+      Job& job = jobs[i];
+
+      if (fop->m_abstractImage) {
+        fop->m_abstractImage->setSpecSize(m_roi.fileCanvasSize(),
+                                          job.bounds.size());
+      }
+
+      // Render the (unscaled) sequenced image.
+      render.renderSprite(
+        fop->m_seq.image.get(), sprite, job.frame,
+        gfx::Clip(gfx::Point(0, 0), job.bounds));
+
+      // Check if we have to ignore empty frames
+      if (!m_ignoreEmpty ||
+          sprite->isOpaque() ||
+          !doc::is_empty_image(fop->m_seq.image.get())) {
+        sprite->palette(job.frame)->copyColorsTo(fop->m_seq.palette);
+        fop->m_filename = m_seq.filename_list[job.outputFrame];
+        fop->m_seq.frame = job.outputFrame;
+        fop->m_error.clear();
+
+        try {
+          if (!m_format->save(fop.get())) {
+            job.error =
+              fmt::format("Error saving frame {} in the file \"{}\"\n",
+                          job.outputFrame+1, fop->m_filename);
+          }
+        }
+        catch (const std::exception& e) {
+          job.error = e.what();
+        }
+
+        if (!fop->m_error.empty())
+          job.error = fop->m_error + job.error;
+      }
+
+      const std::lock_guard lock(doneMutex);
+      ++doneJobs;
+      setProgress(double(doneJobs) / double(jobs.size()));
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i=1; i<std::min<int>(nthreads, jobs.size()); ++i)
+    threads.emplace_back(worker);
+  worker();
+  for (std::thread& thread : threads)
+    thread.join();
+
+  // Report errors in the same order of frames
+  for (const Job& job : jobs) {
+    if (!job.error.empty())
+      setError("%s", job.error.c_str());
+  }
+}
+
 void FileOp::makeDirectories()
 {
   std::string dir = base::get_file_path(m_filename);
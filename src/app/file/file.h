@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -25,6 +25,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 // Flags for FileOp::createLoadDocumentOperation()
 #define FILE_LOAD_SEQUENCE_NONE         0x00000001
@@ -34,6 +35,7 @@
 #define FILE_LOAD_ONE_FRAME             0x00000010
 #define FILE_LOAD_DATA_FILE             0x00000020
 #define FILE_LOAD_CREATE_PALETTE        0x00000040
+#define FILE_LOAD_METADATA_ONLY         0x00000080
 
 namespace doc {
   class Tag;
@@ -161,7 +163,8 @@ namespace app {
                                                const FileOpROI& roi,
                                                const std::string& filename,
                                                const std::string& filenameFormat,
-                                               const bool ignoreEmptyFrames);
+                                               const bool ignoreEmptyFrames,
+                                               const FileOpConfig* config = nullptr);
 
     static bool checkIfFormatSupportResizeOnTheFly(const std::string& filename);
 
@@ -169,6 +172,18 @@ namespace app {
 
     bool isSequence() const { return !m_seq.filename_list.empty(); }
     bool isOneFrame() const { return m_oneframe; }
+
+    // True if the pixels of the document are not needed (e.g. to
+    // list layers/tags/slices from the CLI), so formats that support
+    // it (.aseprite) can skip the cels data.
+    bool isMetadataOnly() const { return m_metadataOnly; }
+
+    // If it's greater than zero, the file is being loaded just to
+    // generate a thumbnail of this maximum size, so the decoder can
+    // load a reduced version of the image (e.g. JPEG DCT scaling) as
+    // long as it's not smaller than this size.
+    int thumbnailSize() const { return m_thumbnailSize; }
+    void setThumbnailSize(const int size) { m_thumbnailSize = size; }
     bool preserveColorProfile() const { return m_config.preserveColorProfile; }
     const FileFormat* fileFormat() const { return m_format; }
 
@@ -312,6 +327,9 @@ namespace app {
     bool m_oneframe;            // Load just one frame (in formats
                                 // that support animation like
                                 // GIF/FLI/ASE).
+    bool m_metadataOnly;        // Load just the sprite structure
+                                // without pixels (only ASE).
+    int m_thumbnailSize;        // Max size of the thumbnail to generate (or 0)
     bool m_createPaletteFromRgba;
     bool m_ignoreEmpty;
 
@@ -326,6 +344,15 @@ namespace app {
     // Options
     FormatOptionsPtr m_formatOptions;
 
+    // A change made by the decoder to the palette of the sequence
+    // (sequenceSetNColors/Color/Alpha()).
+    struct SeqPaletteChange {
+      enum Type { NColors, Color, Alpha } type;
+      int index;                  // Number of colors for NColors
+      color_t value;
+    };
+    using SeqPaletteChanges = std::vector<SeqPaletteChange>;
+
     // Data for sequences.
     struct {
       base::paths filename_list;  // All file names to load/save.
@@ -342,6 +369,9 @@ namespace app {
       int duration;
       // Flags after the user choose what to do with the sequence.
       int flags;
+      // If it's not nullptr, changes to the palette are recorded here
+      // (to load files in parallel).
+      SeqPaletteChanges* palette_changes;
     } m_seq;
 
     class FileAbstractImageImpl;
@@ -350,6 +380,10 @@ namespace app {
     void prepareForSequence();
     void makeAbstractImage();
     void makeDirectories();
+    void loadSequenceInParallel(const int nthreads);
+    static void applySeqPaletteChanges(const SeqPaletteChanges& changes,
+                                       Palette* palette);
+    void saveSequenceInParallel(const int nthreads);
   };
 
   // Available extensions for each load/save operation.
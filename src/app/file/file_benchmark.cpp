@@ -0,0 +1,465 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/file/file.h"
+#include "app/file/file_op_config.h"
+#include "app/util/memory_usage.h"
+#include "base/file_handle.h"
+#include "base/fs.h"
+#include "doc/cel.h"
+#include "doc/grid.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/layer_tilemap.h"
+#include "doc/primitives_fast.h"
+#include "doc/sprite.h"
+#include "doc/tile.h"
+#include "doc/tileset.h"
+#include "doc/tilesets.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#if LAF_LINUX || LAF_MACOS
+  #include <sys/resource.h>
+#endif
+
+using namespace app;
+using namespace doc;
+
+namespace {
+
+// Content of the generated cels
+enum Content {
+  PixelArt = 0,   // Flat blocks of colors (compress well)
+  Noise = 1,      // Random pixels (the worst case for compressors)
+};
+
+color_t pixel_color(const int content, const int x, const int y,
+                    const int layer, const int frame)
+{
+  if (content == Noise) {
+    uint32_t v = uint32_t(x*73856093) ^ uint32_t(y*19349663) ^
+                 uint32_t((layer*31+frame)*83492791);
+    v ^= v >> 13;
+    v *= 0x5bd1e995;
+    v ^= v >> 15;
+    return rgba(v & 255, (v >> 8) & 255, (v >> 16) & 255, 255);
+  }
+  const int bx = (x + frame) / 8;
+  const int by = y / 8;
+  return rgba((bx*40 + layer*16) & 255, (by*40) & 255, ((bx^by)*32) & 255,
+              ((bx+by) % 5 == 0 ? 0: 255));
+}
+
+// Generates a RGB sprite with the given layers/frames
+std::unique_ptr<Doc> make_doc(Context* ctx,
+                              const int w, const int h,
+                              const int layers, const int frames,
+                              const int content)
+{
+  Sprite* spr = new Sprite(ImageSpec(ColorMode::RGB, w, h), 256);
+  spr->setTotalFrames(frames);
+
+  for (int i=0; i<layers; ++i) {
+    LayerImage* layer = new LayerImage(spr);
+    spr->root()->addLayer(layer);
+
+    for (frame_t f=0; f<frames; ++f) {
+      ImageRef image(Image::create(IMAGE_RGB, w, h));
+      for (int y=0; y<h; ++y)
+        for (int x=0; x<w; ++x)
+          put_pixel_fast<RgbTraits>(image.get(), x, y,
+                                    pixel_color(content, x, y, i, f));
+      layer->addCel(new Cel(f, image));
+    }
+  }
+
+  std::unique_ptr<Doc> doc(new Doc(spr));
+  doc->setContext(ctx);
+  return doc;
+}
+
+// Generates a sprite with one tilemap layer that uses "ntiles" tiles
+// of 16x16 pixels
+std::unique_ptr<Doc> make_tilemap_doc(Context* ctx,
+                                      const int w, const int h,
+                                      const int frames,
+                                      const int ntiles)
+{
+  Sprite* spr = new Sprite(ImageSpec(ColorMode::RGB, w, h), 256);
+  spr->setTotalFrames(frames);
+
+  const Grid grid(gfx::Size(16, 16));
+  auto tileset = new Tileset(spr, grid, 1);
+  for (int t=1; t<ntiles; ++t) {
+    ImageRef tile(Image::create(IMAGE_RGB, 16, 16));
+    for (int y=0; y<16; ++y)
+      for (int x=0; x<16; ++x)
+        put_pixel_fast<RgbTraits>(tile.get(), x, y,
+                                  pixel_color(Noise, x, y, t, 0));
+    tileset->add(tile);
+  }
+  const tileset_index tsi = spr->tilesets()->add(tileset);
+
+  auto layer = new LayerTilemap(spr, tsi);
+  spr->root()->addLayer(layer);
+
+  const int cols = (w+15) / 16;
+  const int rows = (h+15) / 16;
+  for (frame_t f=0; f<frames; ++f) {
+    ImageRef tilemap(Image::create(IMAGE_TILEMAP, cols, rows));
+    for (int v=0; v<rows; ++v)
+      for (int u=0; u<cols; ++u)
+        put_pixel_fast<TilemapTraits>(
+          tilemap.get(), u, v,
+          doc::tile((u*7 + v*13 + f) % ntiles, 0));
+    layer->addCel(new Cel(f, tilemap));
+  }
+
+  std::unique_ptr<Doc> doc(new Doc(spr));
+  doc->setContext(ctx);
+  return doc;
+}
+
+// PSD files cannot be saved, so we write a file without layers (only
+// the merged image data, without compression)
+void write_psd(const std::string& fn, const int w, const int h,
+               const int content)
+{
+  base::FileHandle handle(base::open_file_with_exception(fn, "wb"));
+  FILE* f = handle.get();
+  auto put16 = [f](int v) { std::fputc((v >> 8) & 0xff, f); std::fputc(v & 0xff, f); };
+  auto put32 = [&put16](uint32_t v) { put16(v >> 16); put16(v & 0xffff); };
+
+  std::fwrite("8BPS", 1, 4, f);
+  put16(1);                     // Version
+  put16(0); put32(0);           // Reserved
+  put16(3);                     // Channels
+  put32(h);
+  put32(w);
+  put16(8);                     // Depth
+  put16(3);                     // RGB mode
+  put32(0);                     // Color mode data
+  put32(0);                     // Image resources
+  put32(0);                     // Layer and mask information
+  put16(0);                     // Raw image data
+  for (int c=0; c<3; ++c)
+    for (int y=0; y<h; ++y)
+      for (int x=0; x<w; ++x)
+        std::fputc((pixel_color(content, x, y, 0, 0) >> (8*c)) & 0xff, f);
+}
+
+std::string bench_filename(const std::string& name)
+{
+  return base::join_path(base::get_temp_path(), "aseprite_file_benchmark_" + name);
+}
+
+void save_doc(Context* ctx, Doc* doc, const std::string& fn,
+              const FileOpConfig* config = nullptr)
+{
+  std::unique_ptr<FileOp> fop(
+    FileOp::createSaveDocumentOperation(
+      ctx,
+      FileOpROI(doc, doc->sprite()->bounds(),
+                "", "", FramesSequence(), false),
+      fn, "", false, config));
+  if (!fop)
+    return;
+  fop->operate();
+  fop->done();
+}
+
+std::unique_ptr<Doc> load_doc(Context* ctx, const std::string& fn,
+                              const int flags = FILE_LOAD_SEQUENCE_NONE)
+{
+  std::unique_ptr<FileOp> fop(
+    FileOp::createLoadDocumentOperation(ctx, fn, flags));
+  if (!fop)
+    return nullptr;
+  fop->operate();
+  fop->done();
+  fop->postLoad();
+  return std::unique_ptr<Doc>(fop->releaseDocument());
+}
+
+// Counters shared by all benchmarks: bytes of each processed
+// document (throughput), size of the file, memory used by the
+// document, and peak memory of the process.
+void report(benchmark::State& state, const Doc* doc,
+            const std::string& fn)
+{
+  const DocMemoryUsage usage = get_doc_memory_usage(doc);
+  state.SetBytesProcessed(int64_t(state.iterations()) * usage.images);
+  state.counters["file_kb"] = double(base::file_size(fn)) / 1024.0;
+  state.counters["doc_mb"] = double(usage.total()) / (1024.0*1024.0);
+#if LAF_LINUX || LAF_MACOS
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) == 0) {
+  #if LAF_MACOS
+    state.counters["peak_rss_mb"] = double(ru.ru_maxrss) / (1024.0*1024.0); // Bytes
+  #else
+    state.counters["peak_rss_mb"] = double(ru.ru_maxrss) / 1024.0; // Kilobytes
+  #endif
+  }
+#endif
+}
+
+FileOpConfig ase_config(const int level)
+{
+  FileOpConfig config;
+  // Don't re-use the compressed data of the previous iteration
+  config.cacheCompressedCels = false;
+  config.cacheCompressedTilesets = false;
+  config.compressionLevel =
+    (level == 0 ? gen::AseCompressionLevel::FAST:
+     level == 2 ? gen::AseCompressionLevel::BEST:
+                  gen::AseCompressionLevel::DEFAULT);
+  return config;
+}
+
+} // anonymous namespace
+
+// Arguments: width, height, layers, frames, content, compression level
+// (0=fast, 1=default, 2=best)
+void BM_SaveAse(benchmark::State& state) {
+  Context ctx;
+  auto doc = make_doc(&ctx, state.range(0), state.range(1),
+                      state.range(2), state.range(3), state.range(4));
+  const FileOpConfig config = ase_config(state.range(5));
+  const std::string fn = bench_filename("save.aseprite");
+  while (state.KeepRunning())
+    save_doc(&ctx, doc.get(), fn, &config);
+  report(state, doc.get(), fn);
+  base::delete_file(fn);
+}
+
+void BM_LoadAse(benchmark::State& state) {
+  Context ctx;
+  const FileOpConfig config = ase_config(state.range(5));
+  const std::string fn = bench_filename("load.aseprite");
+  {
+    auto doc = make_doc(&ctx, state.range(0), state.range(1),
+                        state.range(2), state.range(3), state.range(4));
+    save_doc(&ctx, doc.get(), fn, &config);
+  }
+  std::unique_ptr<Doc> doc;
+  while (state.KeepRunning())
+    doc = load_doc(&ctx, fn);
+  if (doc)
+    report(state, doc.get(), fn);
+  base::delete_file(fn);
+}
+
+// Arguments: width, height, frames, number of tiles
+void BM_SaveAseTilemap(benchmark::State& state) {
+  Context ctx;
+  auto doc = make_tilemap_doc(&ctx, state.range(0), state.range(1),
+                              state.range(2), state.range(3));
+  const FileOpConfig config = ase_config(1);
+  const std::string fn = bench_filename("tilemap.aseprite");
+  while (state.KeepRunning())
+    save_doc(&ctx, doc.get(), fn, &config);
+  report(state, doc.get(), fn);
+  base::delete_file(fn);
+}
+
+void BM_LoadAseTilemap(benchmark::State& state) {
+  Context ctx;
+  const FileOpConfig config = ase_config(1);
+  const std::string fn = bench_filename("tilemap_load.aseprite");
+  {
+    auto doc = make_tilemap_doc(&ctx, state.range(0), state.range(1),
+                                state.range(2), state.range(3));
+    save_doc(&ctx, doc.get(), fn, &config);
+  }
+  std::unique_ptr<Doc> doc;
+  while (state.KeepRunning())
+    doc = load_doc(&ctx, fn);
+  if (doc)
+    report(state, doc.get(), fn);
+  base::delete_file(fn);
+}
+
+// Extension of the file format of each benchmark (the index is the
+// first argument of BM_SaveFormat/BM_LoadFormat)
+static const char* kFormats[] = {
+  "png", "gif", "jpg", "bmp", "tga", "qoi",
+#ifdef ENABLE_WEBP
+  "webp",
+#endif
+};
+
+// Arguments: format index, width, height, frames, content
+void BM_SaveFormat(benchmark::State& state) {
+  const char* ext = kFormats[state.range(0)];
+  state.SetLabel(ext);
+  Context ctx;
+  auto doc = make_doc(&ctx, state.range(1), state.range(2),
+                      1, state.range(3), state.range(4));
+  const std::string fn = bench_filename(std::string("save.") + ext);
+  while (state.KeepRunning())
+    save_doc(&ctx, doc.get(), fn);
+  report(state, doc.get(), fn);
+  base::delete_file(fn);
+}
+
+void BM_LoadFormat(benchmark::State& state) {
+  const char* ext = kFormats[state.range(0)];
+  state.SetLabel(ext);
+  Context ctx;
+  const std::string fn = bench_filename(std::string("load.") + ext);
+  {
+    auto doc = make_doc(&ctx, state.range(1), state.range(2),
+                        1, state.range(3), state.range(4));
+    save_doc(&ctx, doc.get(), fn);
+  }
+  std::unique_ptr<Doc> doc;
+  while (state.KeepRunning())
+    doc = load_doc(&ctx, fn);
+  if (doc)
+    report(state, doc.get(), fn);
+  base::delete_file(fn);
+}
+
+#ifdef ENABLE_PSD
+// Arguments: width, height, content
+void BM_LoadPsd(benchmark::State& state) {
+  Context ctx;
+  const std::string fn = bench_filename("load.psd");
+  write_psd(fn, state.range(0), state.range(1), state.range(2));
+  std::unique_ptr<Doc> doc;
+  while (state.KeepRunning())
+    doc = load_doc(&ctx, fn);
+  if (doc)
+    report(state, doc.get(), fn);
+  base::delete_file(fn);
+}
+#endif
+
+// Sequence of PNG files (one file per frame, saved/loaded in
+// parallel). Arguments: width, height, frames
+void BM_SavePngSequence(benchmark::State& state) {
+  Context ctx;
+  const int frames = state.range(2);
+  auto doc = make_doc(&ctx, state.range(0), state.range(1),
+                      1, frames, PixelArt);
+  const std::string fn = bench_filename("seq.png");
+  while (state.KeepRunning())
+    save_doc(&ctx, doc.get(), fn);
+  report(state, doc.get(), bench_filename("seq1.png"));
+  for (int i=1; i<=frames; ++i)
+    base::delete_file(bench_filename("seq" + std::to_string(i) + ".png"));
+}
+
+void BM_LoadPngSequence(benchmark::State& state) {
+  Context ctx;
+  const int frames = state.range(2);
+  {
+    auto doc = make_doc(&ctx, state.range(0), state.range(1),
+                        1, frames, PixelArt);
+    save_doc(&ctx, doc.get(), bench_filename("loadseq.png"));
+  }
+  const std::string fn = bench_filename("loadseq1.png");
+  std::unique_ptr<Doc> doc;
+  while (state.KeepRunning())
+    doc = load_doc(&ctx, fn, FILE_LOAD_SEQUENCE_YES);
+  if (doc)
+    report(state, doc.get(), fn);
+  for (int i=1; i<=frames; ++i)
+    base::delete_file(bench_filename("loadseq" + std::to_string(i) + ".png"));
+}
+
+#define ASE_ARGS(w, h, layers, frames)                                  \
+  ->Args({ w, h, layers, frames, PixelArt, 0 })                         \
+  ->Args({ w, h, layers, frames, PixelArt, 1 })                         \
+  ->Args({ w, h, layers, frames, PixelArt, 2 })                         \
+  ->Args({ w, h, layers, frames, Noise, 0 })                            \
+  ->Args({ w, h, layers, frames, Noise, 1 })                            \
+  ->Args({ w, h, layers, frames, Noise, 2 })
+
+BENCHMARK(BM_SaveAse)
+  ASE_ARGS(256, 256, 1, 1)
+  ASE_ARGS(256, 256, 32, 16)
+  ASE_ARGS(2048, 2048, 4, 1)
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+
+BENCHMARK(BM_LoadAse)
+  ASE_ARGS(256, 256, 1, 1)
+  ASE_ARGS(256, 256, 32, 16)
+  ASE_ARGS(2048, 2048, 4, 1)
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+
+BENCHMARK(BM_SaveAseTilemap)
+  ->Args({ 1024, 1024, 1, 64 })
+  ->Args({ 1024, 1024, 16, 1024 })
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+
+BENCHMARK(BM_LoadAseTilemap)
+  ->Args({ 1024, 1024, 1, 64 })
+  ->Args({ 1024, 1024, 16, 1024 })
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+
+static void format_args(benchmark::internal::Benchmark* b)
+{
+  for (int i=0; i<int(sizeof(kFormats)/sizeof(kFormats[0])); ++i) {
+    b->Args({ i, 256, 256, 1, PixelArt });
+    b->Args({ i, 2048, 2048, 1, PixelArt });
+    b->Args({ i, 2048, 2048, 1, Noise });
+  }
+  // Animations (GIF/WebP)
+  b->Args({ 1, 256, 256, 32, PixelArt });
+#ifdef ENABLE_WEBP
+  b->Args({ 6, 256, 256, 32, PixelArt });
+#endif
+}
+
+BENCHMARK(BM_SaveFormat)
+  ->Apply(format_args)
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+
+BENCHMARK(BM_LoadFormat)
+  ->Apply(format_args)
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+
+#ifdef ENABLE_PSD
+BENCHMARK(BM_LoadPsd)
+  ->Args({ 256, 256, PixelArt })
+  ->Args({ 2048, 2048, PixelArt })
+  ->Args({ 2048, 2048, Noise })
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+#endif
+
+BENCHMARK(BM_SavePngSequence)
+  ->Args({ 256, 256, 64 })
+  ->Args({ 1024, 1024, 16 })
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+
+BENCHMARK(BM_LoadPngSequence)
+  ->Args({ 256, 256, 64 })
+  ->Args({ 1024, 1024, 16 })
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
+
+BENCHMARK_MAIN();
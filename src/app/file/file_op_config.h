@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -42,6 +42,16 @@ namespace app {
     // compressed data that was loaded as-is).
     bool cacheCompressedTilesets = true;
 
+    // Cache compressed cel images. The compressed pixels of each cel
+    // read/written from/to an .aseprite file are kept in memory, so
+    // saving the file again only has to re-compress the modified cels.
+    bool cacheCompressedCels = true;
+
+    // zlib compression level used to save cels, tilemaps, and
+    // tilesets in .aseprite files (FAST is useful for quick saves,
+    // BEST to get smaller files).
+    app::gen::AseCompressionLevel compressionLevel = app::gen::AseCompressionLevel::DEFAULT;
+
     void fillFromPreferences();
   };
 
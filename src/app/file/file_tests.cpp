@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -16,12 +16,14 @@
 #include "doc/doc.h"
 #include "doc/user_data.h"
 #include "fmt/format.h"
+#include "zlib.h"
 
 #include <cstdio>
 #include <cstdlib>
 #include <functional>
 #include <vector>
 #include <fstream>
+#include <iterator>
 
 using namespace app;
 
@@ -341,3 +343,182 @@ TEST(File, CustomProperties)
     }
   }
 }
+
+// Saves several layers/frames (cels compressed in background threads)
+// and checks that the file is the same when it's saved again.
+TEST(File, SeveralCels)
+{
+  app::Context ctx;
+  const int w = 97, h = 61;
+  const int nlayers = 8, nframes = 3;
+  std::vector<std::vector<ImageRef>> images(nlayers);
+
+  {
+    std::unique_ptr<Doc> doc(
+      ctx.documents().add(w, h, doc::ColorMode::RGB, 256));
+    doc->setFilename("test.ase");
+
+    Sprite* sprite = doc->sprite();
+    sprite->setTotalFrames(nframes);
+
+    std::srand(w*h);
+    for (int i=0; i<nlayers; ++i) {
+      LayerImage* layer;
+      if (i == 0)
+        layer = static_cast<LayerImage*>(sprite->root()->firstLayer());
+      else {
+        layer = new LayerImage(sprite);
+        sprite->root()->addLayer(layer);
+      }
+      for (frame_t frame=0; frame<nframes; ++frame) {
+        ImageRef image(Image::create(IMAGE_RGB, w, h));
+        for (int y=0; y<h; y++)
+          for (int x=0; x<w; x++)
+            put_pixel_fast<RgbTraits>(image.get(), x, y, rgba(std::rand()%256, x, y, 255));
+        images[i].push_back(image);
+
+        if (Cel* cel = layer->cel(frame))
+          copy_image(cel->image(), image.get());
+        else
+          layer->addCel(new Cel(frame, ImageRef(Image::createCopy(image.get()))));
+      }
+    }
+
+    save_document(&ctx, doc.get());
+    doc->close();
+  }
+
+  std::vector<char> firstFile;
+  {
+    std::ifstream f("test.ase", std::ios::binary);
+    firstFile.assign(std::istreambuf_iterator<char>(f),
+                     std::istreambuf_iterator<char>());
+  }
+
+  {
+    std::unique_ptr<Doc> doc(load_document(&ctx, "test.ase"));
+    const LayerList layers = doc->sprite()->allLayers();
+    ASSERT_EQ(nlayers, int(layers.size()));
+    for (int i=0; i<nlayers; ++i) {
+      for (frame_t frame=0; frame<nframes; ++frame) {
+        const Cel* cel = layers[i]->cel(frame);
+        ASSERT_TRUE(cel != nullptr);
+        EXPECT_TRUE(is_same_image(images[i][frame].get(), cel->image()));
+      }
+    }
+
+    save_document(&ctx, doc.get());
+    doc->close();
+  }
+
+  std::vector<char> secondFile;
+  {
+    std::ifstream f("test.ase", std::ios::binary);
+    secondFile.assign(std::istreambuf_iterator<char>(f),
+                      std::istreambuf_iterator<char>());
+  }
+  EXPECT_EQ(firstFile, secondFile);
+}
+
+// Checks that the compressed data of unmodified cels is re-used, and
+// modified cels are compressed again.
+TEST(File, CachedCompressedCels)
+{
+  app::Context ctx;
+  const int w = 32, h = 32;
+
+  {
+    std::unique_ptr<Doc> doc(
+      ctx.documents().add(w, h, doc::ColorMode::RGB, 256));
+    doc->setFilename("test.ase");
+
+    Sprite* sprite = doc->sprite();
+    Layer* layer1 = sprite->root()->firstLayer();
+    clear_image(layer1->cel(0)->image(), rgba(255, 0, 0, 255));
+
+    LayerImage* layer2 = new LayerImage(sprite);
+    sprite->root()->addLayer(layer2);
+    ImageRef image(Image::create(IMAGE_RGB, w, h));
+    clear_image(image.get(), rgba(0, 0, 255, 255));
+    layer2->addCel(new Cel(0, image));
+
+    save_document(&ctx, doc.get());
+    doc->close();
+  }
+
+  {
+    std::unique_ptr<Doc> doc(load_document(&ctx, "test.ase"));
+    const LayerList layers = doc->sprite()->allLayers();
+    ASSERT_EQ(2, int(layers.size()));
+
+    Image* image1 = layers[0]->cel(0)->image();
+    Image* image2 = layers[1]->cel(0)->image();
+    EXPECT_TRUE(image1->hasValidCompressedData(Z_DEFAULT_COMPRESSION));
+    EXPECT_TRUE(image2->hasValidCompressedData(Z_DEFAULT_COMPRESSION));
+
+    // Modify the second image
+    put_pixel(image2, 4, 4, rgba(0, 255, 0, 255));
+    image2->incrementVersion();
+    EXPECT_TRUE(image1->hasValidCompressedData(Z_DEFAULT_COMPRESSION));
+    EXPECT_FALSE(image2->hasValidCompressedData(Z_DEFAULT_COMPRESSION));
+
+    save_document(&ctx, doc.get());
+    EXPECT_TRUE(image2->hasValidCompressedData(Z_DEFAULT_COMPRESSION));
+    doc->close();
+  }
+
+  {
+    std::unique_ptr<Doc> doc(load_document(&ctx, "test.ase"));
+    const LayerList layers = doc->sprite()->allLayers();
+    ASSERT_EQ(2, int(layers.size()));
+
+    const Image* image1 = layers[0]->cel(0)->image();
+    const Image* image2 = layers[1]->cel(0)->image();
+    EXPECT_EQ(rgba(255, 0, 0, 255), get_pixel(image1, 4, 4));
+    EXPECT_EQ(rgba(0, 255, 0, 255), get_pixel(image2, 4, 4));
+    EXPECT_EQ(rgba(0, 0, 255, 255), get_pixel(image2, 5, 4));
+    doc->close();
+  }
+}
+
+// Checks that the cached compressed data is not re-used when the file
+// is saved with a different compression level.
+TEST(File, CachedCompressedCelsLevel)
+{
+  app::Context ctx;
+  const int w = 32, h = 32;
+
+  {
+    std::unique_ptr<Doc> doc(
+      ctx.documents().add(w, h, doc::ColorMode::RGB, 256));
+    doc->setFilename("test.ase");
+    clear_image(doc->sprite()->root()->firstLayer()->cel(0)->image(),
+                rgba(255, 0, 0, 255));
+    save_document(&ctx, doc.get());
+    doc->close();
+  }
+
+  std::unique_ptr<Doc> doc(load_document(&ctx, "test.ase"));
+  const Image* image = doc->sprite()->root()->firstLayer()->cel(0)->image();
+  EXPECT_TRUE(image->hasValidCompressedData(Z_DEFAULT_COMPRESSION));
+  EXPECT_FALSE(image->hasValidCompressedData(Z_BEST_COMPRESSION));
+
+  FileOpConfig config;
+  config.compressionLevel = gen::AseCompressionLevel::BEST;
+  std::unique_ptr<FileOp> fop(
+    FileOp::createSaveDocumentOperation(
+      &ctx,
+      FileOpROI(doc.get(), doc->sprite()->bounds(),
+                "", "", FramesSequence(), false),
+      doc->filename(), "", false, &config));
+  ASSERT_TRUE(fop != nullptr);
+  fop->operate();
+  fop->done();
+  EXPECT_FALSE(fop->hasError());
+
+  // The cel was compressed again with the new level
+  EXPECT_TRUE(image->hasValidCompressedData(Z_BEST_COMPRESSION));
+  ASSERT_LE(2, int(image->compressedData().size()));
+  EXPECT_EQ(3, image->compressedData()[1] >> 6); // zlib FLEVEL
+  doc->close();
+}
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -13,6 +13,7 @@
 #include "app/file/file.h"
 #include "app/file/file_format.h"
 #include "app/file/format_options.h"
+#include "app/file/frames_pipeline.h"
 #include "app/modules/palettes.h"
 #include "app/pref/preferences.h"
 #include "base/file_handle.h"
@@ -22,6 +23,7 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <vector>
 
 namespace app {
 
@@ -221,25 +223,24 @@ bool FliFormat::onSave(FileOp* fop)
   header.speed = get_time_precision(sprite, fop->roi().framesSequence());
   encoder.writeHeader(header);
 
-  // Create the bitmaps
-  ImageRef bmp(Image::create(IMAGE_INDEXED, sprite->width(), sprite->height()));
-  render::Render render;
-  render.setNewBlend(fop->newBlend());
+  // Frames to write, the last one is the ring frame (the first frame
+  // again)
+  std::vector<frame_t> frames;
+  for (frame_t frame : fop->roi().framesSequence())
+    frames.push_back(frame);
+  if (!frames.empty())
+    frames.push_back(frames.front());
+  const frame_t nframes = fop->roi().frames();
+
+  // Frames are rendered in a background thread while the encoder
+  // computes the delta of the previous ones
+  FramesPipeline pipeline(sprite, fop, frames, IMAGE_INDEXED,
+                          sprite->width(), sprite->height());
 
   // Write frame by frame
   flic::Frame fliFrame;
-  fliFrame.pixels = bmp->getPixelAddress(0, 0);
-  fliFrame.rowstride = bmp->rowBytes();
-
-  auto frame_beg = fop->roi().framesSequence().begin();
-  auto frame_end = fop->roi().framesSequence().end();
-  auto frame_it = frame_beg;
-  frame_t nframes = fop->roi().frames();
-  for (frame_t f=0; f<=nframes; ++f, ++frame_it) {
-    if (frame_it == frame_end)
-      frame_it = frame_beg;
-
-    frame_t frame = *frame_it;
+  for (frame_t f=0; f<frame_t(frames.size()); ++f) {
+    const frame_t frame = frames[f];
     const Palette* pal = sprite->palette(frame);
     int size = std::min(256, pal->size());
 
@@ -250,8 +251,10 @@ bool FliFormat::onSave(FileOp* fop)
       fliFrame.colormap[c].b = rgba_getb(color);
     }
 
-    // Render the frame in the bitmap
-    sprite->renderFrame(frame, fop->roi().frameBounds(frame), bmp.get());
+    // Get the rendered frame
+    Image* bmp = pipeline.next();
+    fliFrame.pixels = bmp->getPixelAddress(0, 0);
+    fliFrame.rowstride = bmp->rowBytes();
 
     // How many times this frame should be written to get the same
     // time that it has in the sprite
@@ -264,9 +267,13 @@ bool FliFormat::onSave(FileOp* fop)
     else {
       encoder.writeRingFrame(fliFrame);
     }
+    pipeline.release(bmp);
 
     // Update progress
     fop->setProgress((float)(f+1) / (float)(nframes+1));
+
+    if (fop->isStop())
+      break;
   }
 
   return true;
@@ -0,0 +1,111 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/file/frames_pipeline.h"
+
+#include "app/file/file.h"
+#include "doc/image.h"
+#include "doc/primitives.h"
+
+namespace app {
+
+using namespace doc;
+
+FramesPipeline::FramesPipeline(const FileAbstractImage* sprite,
+                               FileOp* fop,
+                               const std::vector<frame_t>& frames,
+                               const PixelFormat pixelFormat,
+                               const int w, const int h,
+                               PostRender postRender)
+  : m_sprite(sprite)
+  , m_fop(fop)
+  , m_frames(frames)
+  , m_postRender(std::move(postRender))
+{
+  for (int i=0; i<kBuffers; ++i) {
+    m_images[i].reset(Image::create(pixelFormat, w, h));
+    m_free.push_back(i);
+  }
+  m_thread = std::thread([this]{ renderFrames(); });
+}
+
+FramesPipeline::~FramesPipeline()
+{
+  {
+    const std::lock_guard lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  m_thread.join();
+}
+
+Image* FramesPipeline::next()
+{
+  std::unique_lock lock(m_mutex);
+  m_cv.wait(lock, [this]{ return !m_ready.empty() || m_error; });
+  if (m_ready.empty())
+    std::rethrow_exception(m_error);
+  const int i = m_ready.front();
+  m_ready.pop_front();
+  return m_images[i].get();
+}
+
+void FramesPipeline::release(const Image* image)
+{
+  {
+    const std::lock_guard lock(m_mutex);
+    for (int i=0; i<kBuffers; ++i) {
+      if (m_images[i].get() == image)
+        m_free.push_back(i);
+    }
+  }
+  m_cv.notify_all();
+}
+
+void FramesPipeline::renderFrames()
+{
+  try {
+    for (const frame_t frame : m_frames) {
+      int i;
+      {
+        std::unique_lock lock(m_mutex);
+        m_cv.wait(lock, [this]{ return !m_free.empty() || m_stop; });
+        if (m_stop)
+          return;
+        i = m_free.front();
+        m_free.pop_front();
+      }
+
+      Image* image = m_images[i].get();
+
+      // Render the frame in the bitmap
+      clear_image(image, image->maskColor());
+      m_sprite->renderFrame(frame, m_fop->roi().frameBounds(frame), image);
+
+      if (m_postRender)
+        m_postRender(image);
+
+      {
+        const std::lock_guard lock(m_mutex);
+        m_ready.push_back(i);
+      }
+      m_cv.notify_all();
+    }
+  }
+  catch (...) {
+    {
+      const std::lock_guard lock(m_mutex);
+      m_error = std::current_exception();
+    }
+    m_cv.notify_all();
+  }
+}
+
+} // namespace app
@@ -0,0 +1,80 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_FILE_FRAMES_PIPELINE_H_INCLUDED
+#define APP_FILE_FRAMES_PIPELINE_H_INCLUDED
+#pragma once
+
+#include "doc/frame.h"
+#include "doc/image_ref.h"
+#include "doc/pixel_format.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace doc {
+  class Image;
+}
+
+namespace app {
+
+  class FileAbstractImage;
+  class FileOp;
+
+  // Renders the frames to save in a background thread while the
+  // encoder compresses the previous ones. Only the background thread
+  // calls FileAbstractImage::renderFrame(), so it doesn't need to be
+  // thread-safe.
+  class FramesPipeline {
+  public:
+    // Number of frames that can be rendered ahead of the encoder
+    static constexpr int kBuffers = 3;
+
+    // Called from the background thread after rendering each frame
+    // (e.g. to convert pixels to the format expected by the encoder).
+    using PostRender = std::function<void(doc::Image*)>;
+
+    FramesPipeline(const FileAbstractImage* sprite,
+                   FileOp* fop,
+                   const std::vector<doc::frame_t>& frames,
+                   const doc::PixelFormat pixelFormat,
+                   const int w, const int h,
+                   PostRender postRender = nullptr);
+    ~FramesPipeline();
+
+    const std::vector<doc::frame_t>& frames() const { return m_frames; }
+
+    // Returns the rendered image of the next frame. Must be returned
+    // with release() once it's encoded. Re-throws the exception of
+    // the render thread (if any).
+    doc::Image* next();
+    void release(const doc::Image* image);
+
+  private:
+    void renderFrames();
+
+    const FileAbstractImage* m_sprite;
+    FileOp* m_fop;
+    std::vector<doc::frame_t> m_frames;
+    PostRender m_postRender;
+    doc::ImageRef m_images[kBuffers];
+    std::deque<int> m_free;   // Buffers that can be rendered
+    std::deque<int> m_ready;  // Rendered buffers in frame order
+    std::exception_ptr m_error;
+    bool m_stop = false;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+  };
+
+} // namespace app
+
+#endif
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -35,6 +35,9 @@
 #include "gif_options.xml.h"
 
 #include <algorithm>
+#include <exception>
+#include <iterator>
+#include <thread>
 
 #include <gif_lib.h>
 
@@ -386,10 +389,12 @@ private:
     // Composite frame with previous frame
     if (frameImage) {
       if (m_sprite->pixelFormat() == IMAGE_INDEXED) {
-        compositeIndexedImageToIndexed(frameBounds, frameImage.get());
+        if (compositeIndexedImageToIndexed(frameBounds, frameImage.get()))
+          m_currentImageModified = true;
       }
       else {
-        compositeIndexedImageToRgb(frameBounds, frameImage.get());
+        if (compositeIndexedImageToRgb(frameBounds, frameImage.get()))
+          m_currentImageModified = true;
       }
     }
 
@@ -402,6 +407,9 @@ private:
                             m_disposalMethod,
                             frameBounds,
                             m_bgIndex);
+    if (m_disposalMethod == DisposalMethod::RESTORE_BGCOLOR ||
+        m_disposalMethod == DisposalMethod::RESTORE_PREVIOUS)
+      m_currentImageModified = true;
 
     // Copy the current image into previous image
     copy_image(m_previousImage.get(), m_currentImage.get());
@@ -519,10 +527,17 @@ private:
       // Mark all entries as used if the colormap is global.
       usedEntries.all();
     else {
-      for (const auto& i : LockImageBits<IndexedTraits>(frameImage)) {
-        if (i >= 0 && i < ncolors) {
+      // Histogram of the used indexes (checking the palette size for
+      // each pixel is slower)
+      bool usedIndexes[256] = { false };
+      for (int y=0; y<frameImage->height(); ++y) {
+        auto addr = get_pixel_address_fast<IndexedTraits>(frameImage, 0, y);
+        for (int x=0; x<frameImage->width(); ++x, ++addr)
+          usedIndexes[*addr] = true;
+      }
+      for (int i=0; i<std::min(ncolors, 256); ++i) {
+        if (usedIndexes[i])
           usedEntries[i] = true;
-        }
       }
       // GIF Case: unnamed.gif. If a pixel is equal to
       // m_localtransparentindex in a frame > 0 in a sprite
@@ -649,7 +664,10 @@ private:
     m_sprite->setPalette(palette.get(), false);
   }
 
-  void compositeIndexedImageToIndexed(const gfx::Rect& frameBounds,
+  // Composes the frame indexes with the current image remapping
+  // them to the sprite palette. Returns true if a pixel of the
+  // current image was modified.
+  bool compositeIndexedImageToIndexed(const gfx::Rect& frameBounds,
                                       const Image* frameImage) {
     gfx::Clip clip(frameBounds.x, frameBounds.y, 0, 0,
                    frameBounds.w, frameBounds.h);
@@ -657,29 +675,16 @@ private:
                    m_currentImage->height(),
                    frameImage->width(),
                    frameImage->height()))
-      return;
-
-    const LockImageBits<IndexedTraits> srcBits(frameImage, clip.srcBounds());
-    LockImageBits<IndexedTraits> dstBits(m_currentImage.get(), clip.dstBounds());
-
-    auto srcIt = srcBits.begin(), srcEnd = srcBits.end();
-    auto dstIt = dstBits.begin(), dstEnd = dstBits.end();
-
-    // Compose the frame image with the previous frame
-    for (; srcIt != srcEnd && dstIt != dstEnd; ++srcIt, ++dstIt) {
-      color_t i = *srcIt;
-      if (int(i) == m_localTransparentIndex)
-        continue;
+      return false;
 
-      i = m_remap[i];
-      *dstIt = i;
-    }
+    int lut[256];
+    for (int i=0; i<256; ++i)
+      lut[i] = m_remap[i];
 
-    ASSERT(srcIt == srcEnd);
-    ASSERT(dstIt == dstEnd);
+    return compositeFrameImage<IndexedTraits>(clip, frameImage, lut);
   }
 
-  void compositeIndexedImageToRgb(const gfx::Rect& frameBounds,
+  bool compositeIndexedImageToRgb(const gfx::Rect& frameBounds,
                                   const Image* frameImage) {
     gfx::Clip clip(frameBounds.x, frameBounds.y, 0, 0,
                    frameBounds.w, frameBounds.h);
@@ -687,50 +692,77 @@ private:
                    m_currentImage->height(),
                    frameImage->width(),
                    frameImage->height()))
-      return;
-
-    const LockImageBits<IndexedTraits> srcBits(frameImage, clip.srcBounds());
-    LockImageBits<RgbTraits> dstBits(m_currentImage.get(), clip.dstBounds());
-
-    auto srcIt = srcBits.begin(), srcEnd = srcBits.end();
-    auto dstIt = dstBits.begin(), dstEnd = dstBits.end();
+      return false;
 
     ColorMapObject* colormap = getFrameColormap();
 
-    // Compose the frame image with the previous frame
-    for (; srcIt != srcEnd && dstIt != dstEnd; ++srcIt, ++dstIt) {
-      color_t i = *srcIt;
-      if (int(i) == m_localTransparentIndex)
-        continue;
+    // Convert the colormap to RGBA only one time (instead of for
+    // each pixel)
+    color_t lut[256];
+    for (int i=0; i<256; ++i) {
+      lut[i] = (i < colormap->ColorCount ? colormap2rgba(colormap, i):
+                                           rgba(0, 0, 0, 255));
+    }
 
-      i = rgba(
-        colormap->Colors[i].Red,
-        colormap->Colors[i].Green,
-        colormap->Colors[i].Blue, 255);
+    return compositeFrameImage<RgbTraits>(clip, frameImage, lut);
+  }
 
-      *dstIt = i;
-    }
+  // Composes the frame image with the current image converting each
+  // index with the given lookup table (except the transparent index).
+  template<typename DstTraits, typename LutType>
+  bool compositeFrameImage(const gfx::Clip& clip,
+                           const Image* frameImage,
+                           const LutType lut[256]) {
+    const gfx::Rect srcBounds = clip.srcBounds();
+    const gfx::Rect dstBounds = clip.dstBounds();
+    bool modified = false;
+
+    // Compose the frame image with the previous frame (row by row)
+    for (int y=0; y<srcBounds.h; ++y) {
+      auto srcAddr = get_pixel_address_fast<IndexedTraits>(
+        frameImage, srcBounds.x, srcBounds.y+y);
+      auto dstAddr = get_pixel_address_fast<DstTraits>(
+        m_currentImage.get(), dstBounds.x, dstBounds.y+y);
+
+      for (int x=0; x<srcBounds.w; ++x, ++srcAddr, ++dstAddr) {
+        const int i = *srcAddr;
+        if (i == m_localTransparentIndex)
+          continue;
 
-    ASSERT(srcIt == srcEnd);
-    ASSERT(dstIt == dstEnd);
+        const auto c = typename DstTraits::pixel_t(lut[i]);
+        if (*dstAddr != c) {
+          *dstAddr = c;
+          modified = true;
+        }
+      }
+    }
+    return modified;
   }
 
   void createCel() {
-    Cel* cel = new Cel(m_frameNum, ImageRef(0));
+    // Frames that don't modify the previous one (e.g. frames used
+    // only to change the duration) are linked to the previous cel
+    // instead of copying the whole image.
+    Cel* cel;
+    if (m_lastCel && !m_currentImageModified)
+      cel = Cel::MakeLink(m_frameNum, m_lastCel);
+    else
+      cel = new Cel(m_frameNum, ImageRef(0));
+
     try {
-      ImageRef celImage(Image::createCopy(m_currentImage.get()));
-      try {
+      if (!cel->image()) {
+        ImageRef celImage(Image::createCopy(m_currentImage.get()));
         cel->data()->setImage(celImage, m_layer);
       }
-      catch (...) {
-        throw;
-      }
       m_layer->addCel(cel);
     }
     catch (...) {
       delete cel;
       throw;
     }
+
+    m_lastCel = cel;
+    m_currentImageModified = false;
   }
 
   void readExtensionRecord() {
@@ -827,6 +859,10 @@ private:
 
     m_sprite->setPixelFormat(IMAGE_RGB);
     m_sprite->setTransparentColor(0);
+
+    // The current image uses the palette of the current frame (which
+    // can be different from the palette of the last cel)
+    m_currentImageModified = true;
   }
 
   void remapToGlobalColormap(ColorMapObject* colormap) {
@@ -879,6 +915,10 @@ private:
   ImageRef m_previousImage;
   Remap m_remap;
   bool m_hasLocalColormaps;     // Indicates that this fila contains local colormaps
+  // Last created cel and true if m_currentImage was modified since
+  // then (in other case the next cel can be linked to it)
+  Cel* m_lastCel = nullptr;
+  bool m_currentImageModified = true;
 
   // This is a copy of the first local color map. It's used to see if
   // all local colormaps are the same, so we can use it as a global
@@ -1113,6 +1153,7 @@ public:
     // In this code "gifFrame" will be the GIF frame, and "frame" will
     // be the doc::Sprite frame.
     gifframe_t nframes = totalFrames();
+    bool nextFrameRendered = false;
     for (gifframe_t gifFrame=0; gifFrame<nframes; ++gifFrame) {
       ASSERT(frame_it != frame_end);
       frame_t frame = *frame_it;
@@ -1123,9 +1164,10 @@ public:
       else
         std::swap(m_previousImage, m_currentImage);
 
-      // Render next frame
+      // Render next frame (if it wasn't rendered in the background
+      // thread in the previous iteration)
       std::swap(m_currentImage, m_nextImage);
-      if (gifFrame+1 < nframes)
+      if (gifFrame+1 < nframes && !nextFrameRendered)
         renderFrame(*frame_it, m_nextImage);
 
       gfx::Rect frameBounds = m_spriteBounds;
@@ -1140,9 +1182,44 @@ public:
 
       calculateDeltaImageFrameBoundsDisposal(gifFrame, frameBounds, disposal);
 
-      writeImage(gifFrame, frame, frameBounds, disposal,
-                 // Only the last frame in the animation needs the fix
-                 (fix_last_frame_duration && gifFrame == nframes-1));
+      // Now the previous image is not needed anymore, so we can
+      // render the frame after the next one in that image in a
+      // background thread, while we quantize and compress the current
+      // frame (the previous image will be the next one in the
+      // following iteration).
+      std::thread renderThread;
+      std::exception_ptr renderError;
+      nextFrameRendered = false;
+      if (gifFrame+2 < nframes) {
+        const frame_t frameToRender = *std::next(frame_it);
+        Image* dst = m_previousImage;
+        renderThread = std::thread(
+          [this, frameToRender, dst, &renderError]{
+            try {
+              renderFrame(frameToRender, dst);
+            }
+            catch (...) {
+              renderError = std::current_exception();
+            }
+          });
+        nextFrameRendered = true;
+      }
+
+      try {
+        writeImage(gifFrame, frame, frameBounds, disposal,
+                   // Only the last frame in the animation needs the fix
+                   (fix_last_frame_duration && gifFrame == nframes-1));
+      }
+      catch (...) {
+        if (renderThread.joinable())
+          renderThread.join();
+        throw;
+      }
+
+      if (renderThread.joinable())
+        renderThread.join();
+      if (renderError)
+        std::rethrow_exception(renderError);
 
       m_fop->setProgress(double(gifFrame+1) / double(nframes));
     }
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -70,6 +70,7 @@ class JpegFormat : public FileFormat {
 
   bool onLoad(FileOp* fop) override;
   gfx::ColorSpaceRef loadColorSpace(FileOp* fop, jpeg_decompress_struct* dinfo);
+  void readColorSpace(FileOp* fop, jpeg_decompress_struct* dinfo);
 #ifdef ENABLE_SAVE
   bool onSave(FileOp* fop) override;
   void saveColorSpace(FileOp* fop, jpeg_compress_struct* cinfo,
@@ -171,16 +172,36 @@ bool JpegFormat::onLoad(FileOp* fop)
 
   if (dinfo.jpeg_color_space == JCS_GRAYSCALE)
     dinfo.out_color_space = JCS_GRAYSCALE;
-  else
+  else {
+#ifdef JCS_ALPHA_EXTENSIONS
+    // libjpeg-turbo can decode the pixels directly in our RGBA
+    // format (with alpha=255), so we don't need to convert them.
+    dinfo.out_color_space = JCS_EXT_RGBA;
+#else
     dinfo.out_color_space = JCS_RGB;
+#endif
+  }
+
+  // Use DCT scaling to decode a smaller version of the image when we
+  // only need a thumbnail.
+  if (fop->thumbnailSize() > 0) {
+    const int size = int(std::max(dinfo.image_width, dinfo.image_height));
+    int denom = 1;
+    while (denom < 8 && size / (denom*2) >= fop->thumbnailSize())
+      denom *= 2;
+    dinfo.scale_num = 1;
+    dinfo.scale_denom = denom;
+    dinfo.dct_method = JDCT_IFAST;
+    dinfo.do_fancy_upsampling = FALSE;
+  }
 
   // Start decompressor.
   jpeg_start_decompress(&dinfo);
 
   // Create the image.
   ImageRef image = fop->sequenceImageToLoad(
-    (dinfo.out_color_space == JCS_RGB ? IMAGE_RGB:
-                                        IMAGE_GRAYSCALE),
+    (dinfo.out_color_space != JCS_GRAYSCALE ? IMAGE_RGB:
+                                              IMAGE_GRAYSCALE),
     dinfo.output_width,
     dinfo.output_height);
   if (!image) {
@@ -188,6 +209,33 @@ bool JpegFormat::onLoad(FileOp* fop)
     return false;
   }
 
+#ifdef JCS_ALPHA_EXTENSIONS
+  // Decode the scanlines directly in the image rows.
+  if (dinfo.out_color_space == JCS_EXT_RGBA) {
+    // A fixed array (instead of a std::vector) because we cannot
+    // leave destructors behind if error_exit() uses longjmp().
+    // rec_outbuf_height is never bigger than 4 (max v_samp_factor).
+    JSAMPROW rows[4];
+    const int maxRows = std::clamp(dinfo.rec_outbuf_height, 1, 4);
+    while (dinfo.output_scanline < dinfo.output_height) {
+      const int y0 = int(dinfo.output_scanline);
+      const int n = std::min(maxRows, int(dinfo.output_height) - y0);
+      for (int y=0; y<n; ++y)
+        rows[y] = (JSAMPROW)image->getPixelAddress(0, y0+y);
+      jpeg_read_scanlines(&dinfo, rows, n);
+
+      fop->setProgress((float)(dinfo.output_scanline+1) / (float)(dinfo.output_height));
+      if (fop->isStop())
+        break;
+    }
+
+    readColorSpace(fop, &dinfo);
+    jpeg_finish_decompress(&dinfo);
+    jpeg_destroy_decompress(&dinfo);
+    return true;
+  }
+#endif
+
   // Create the buffer.
   buffer_height = dinfo.rec_outbuf_height;
   buffer = (JSAMPARRAY)base_malloc(sizeof(JSAMPROW) * buffer_height);
@@ -255,8 +303,21 @@ bool JpegFormat::onLoad(FileOp* fop)
       break;
   }
 
-  // Read color space
-  gfx::ColorSpaceRef colorSpace = loadColorSpace(fop, &dinfo);
+  readColorSpace(fop, &dinfo);
+
+  for (c=0; c<(int)buffer_height; c++)
+    base_free(buffer[c]);
+  base_free(buffer);
+
+  jpeg_finish_decompress(&dinfo);
+  jpeg_destroy_decompress(&dinfo);
+
+  return true;
+}
+
+void JpegFormat::readColorSpace(FileOp* fop, jpeg_decompress_struct* dinfo)
+{
+  gfx::ColorSpaceRef colorSpace = loadColorSpace(fop, dinfo);
   if (colorSpace)
     fop->setEmbeddedColorProfile();
   else { // sRGB is the default JPG color space.
@@ -267,15 +328,6 @@ bool JpegFormat::onLoad(FileOp* fop)
     fop->document()->sprite()->setColorSpace(colorSpace);
     fop->document()->notifyColorSpaceChanged();
   }
-
-  for (c=0; c<(int)buffer_height; c++)
-    base_free(buffer[c]);
-  base_free(buffer);
-
-  jpeg_finish_decompress(&dinfo);
-  jpeg_destroy_decompress(&dinfo);
-
-  return true;
 }
 
 // ICC profiles may be stored using a sequence of multiple markers.  We obtain the ICC profile
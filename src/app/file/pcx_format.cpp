@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -18,6 +18,8 @@
 #include "base/file_handle.h"
 #include "doc/doc.h"
 
+#include <vector>
+
 namespace app {
 
 using namespace base;
@@ -59,6 +61,33 @@ FileFormat* CreatePcxFormat()
   return new PcxFormat;
 }
 
+namespace {
+
+// Reads the file in big chunks, fgetc() is too slow to read each
+// byte of the RLE data.
+class ChunkReader {
+public:
+  ChunkReader(FILE* f) : m_f(f), m_buf(64*1024) { }
+
+  int read() {
+    if (m_pos == m_size) {
+      m_pos = 0;
+      m_size = fread(m_buf.data(), 1, m_buf.size(), m_f);
+      if (m_size == 0)
+        return EOF;
+    }
+    return m_buf[m_pos++];
+  }
+
+private:
+  FILE* m_f;
+  std::vector<uint8_t> m_buf;
+  size_t m_pos = 0;
+  size_t m_size = 0;
+};
+
+} // anonymous namespace
+
 bool PcxFormat::onLoad(FileOp* fop)
 {
   int c, r, g, b;
@@ -117,15 +146,16 @@ bool PcxFormat::onLoad(FileOp* fop)
   if (bpp == 24)
     clear_image(image.get(), rgba(0, 0, 0, 255));
 
+  ChunkReader reader(f);
   for (y=0; y<height; y++) {       /* read RLE encoded PCX data */
     x = xx = 0;
     po = rgba_r_shift;
 
     while (x < bytes_per_line*bpp/8) {
-      ch = fgetc(f);
+      ch = reader.read();
       if ((ch & 0xC0) == 0xC0) {
         c = (ch & 0x3F);
-        ch = fgetc(f);
+        ch = reader.read();
       }
       else
         c = 1;
@@ -166,12 +196,12 @@ bool PcxFormat::onLoad(FileOp* fop)
 
   if (!fop->isStop()) {
     if (bpp == 8) {                  /* look for a 256 color palette */
-      while ((c = fgetc(f)) != EOF) {
+      while ((c = reader.read()) != EOF) {
         if (c == 12) {
           for (c=0; c<256; c++) {
-            r = fgetc(f);
-            g = fgetc(f);
-            b = fgetc(f);
+            r = reader.read();
+            g = reader.read();
+            b = reader.read();
             fop->sequenceSetColor(c, r, g, b);
           }
           break;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -10,20 +10,25 @@
 #endif
 
 #include "app/app.h"
+#include "app/console.h"
+#include "app/context.h"
 #include "app/doc.h"
 #include "app/file/file.h"
 #include "app/file/file_format.h"
 #include "app/file/format_options.h"
 #include "app/file/png_format.h"
 #include "app/file/png_options.h"
+#include "app/pref/preferences.h"
 #include "base/file_handle.h"
 #include "doc/doc.h"
 #include "gfx/color_space.h"
 
+#include <algorithm>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "png.h"
+#include "zlib.h"
 
 #define PNG_TRACE(...) // TRACE
 
@@ -55,6 +60,7 @@ class PngFormat : public FileFormat {
       FILE_SUPPORT_INDEXED |
       FILE_SUPPORT_SEQUENCES |
       FILE_SUPPORT_PALETTE_WITH_ALPHA |
+      FILE_SUPPORT_GET_FORMAT_OPTIONS |
       FILE_ENCODE_ABSTRACT_IMAGE;
   }
 
@@ -64,6 +70,7 @@ class PngFormat : public FileFormat {
   bool onSave(FileOp* fop) override;
   void saveColorSpace(png_structp png, png_infop info, const gfx::ColorSpace* colorSpace);
 #endif
+  FormatOptionsPtr onAskUserForFormatOptions(FileOp* fop) override;
 };
 
 FileFormat* CreatePngFormat()
@@ -523,6 +530,43 @@ gfx::ColorSpaceRef PngFormat::loadColorSpace(png_structp png_ptr, png_infop info
 
 #ifdef ENABLE_SAVE
 
+static void set_png_compression(png_structp png, const PngOptions* opts)
+{
+  switch (opts->filter()) {
+    case PngOptions::Filter::Adaptive:
+      // Use the libpng default (all filters with its heuristic)
+      break;
+    case PngOptions::Filter::None:
+      png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+      break;
+    case PngOptions::Filter::Sub:
+      png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+      break;
+  }
+
+  if (opts->compressionLevel() != PngOptions::kDefaultCompressionLevel)
+    png_set_compression_level(png, std::clamp(opts->compressionLevel(), 0, 9));
+
+  switch (opts->strategy()) {
+    case PngOptions::Strategy::Auto:
+      // libpng uses Z_FILTERED when the rows are filtered, and
+      // Z_DEFAULT_STRATEGY when they are not
+      break;
+    case PngOptions::Strategy::Default:
+      png_set_compression_strategy(png, Z_DEFAULT_STRATEGY);
+      break;
+    case PngOptions::Strategy::Filtered:
+      png_set_compression_strategy(png, Z_FILTERED);
+      break;
+    case PngOptions::Strategy::HuffmanOnly:
+      png_set_compression_strategy(png, Z_HUFFMAN_ONLY);
+      break;
+    case PngOptions::Strategy::Rle:
+      png_set_compression_strategy(png, Z_RLE);
+      break;
+  }
+}
+
 bool PngFormat::onSave(FileOp* fop)
 {
   png_infop info;
@@ -552,6 +596,9 @@ bool PngFormat::onSave(FileOp* fop)
 
   png_init_io(png, fp);
 
+  auto opts = fop->formatOptionsOfDocument<PngOptions>();
+  set_png_compression(png, opts.get());
+
   const FileAbstractImage* img = fop->abstractImageToSave();
   const ImageSpec spec = img->spec();
 
@@ -585,7 +632,6 @@ bool PngFormat::onSave(FileOp* fop)
                PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
   // User chunks
-  auto opts = fop->formatOptionsOfDocument<PngOptions>();
   if (opts && !opts->isEmpty()) {
     int num_unknowns = opts->size();
     ASSERT(num_unknowns > 0);
@@ -832,4 +878,32 @@ void PngFormat::saveColorSpace(png_structp png_ptr, png_infop info_ptr,
 
 #endif  // ENABLE_SAVE
 
+FormatOptionsPtr PngFormat::onAskUserForFormatOptions(FileOp* fop)
+{
+  auto opts = fop->formatOptionsOfDocument<PngOptions>();
+  if (fop->context() && App::instance()) {
+    try {
+      auto& pref = Preferences::instance();
+
+      // Re-exporting a lot of files from the command line is faster
+      // with the fast preset (the files will be a little bigger).
+      if (!fop->context()->isUIAvailable() &&
+          pref.png.fastBatchExport())
+        opts->setFastExport();
+
+      if (pref.isSet(pref.png.filter))
+        opts->setFilter(PngOptions::Filter(pref.png.filter()));
+      if (pref.isSet(pref.png.compressionLevel))
+        opts->setCompressionLevel(pref.png.compressionLevel());
+      if (pref.isSet(pref.png.strategy))
+        opts->setStrategy(PngOptions::Strategy(pref.png.strategy()));
+    }
+    catch (std::exception& e) {
+      Console::showException(e);
+      return std::shared_ptr<PngOptions>(nullptr);
+    }
+  }
+  return opts;
+}
+
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -16,6 +16,25 @@ namespace app {
   // Data for PNG files
   class PngOptions : public FormatOptions {
   public:
+    // Filter heuristic used for each row before the compression.
+    enum class Filter {
+      Adaptive,    // libpng chooses the best filter for each row (default)
+      None,        // Fastest, no filter at all
+      Sub,         // Fast filter, good enough for most pixel art
+    };
+
+    // zlib compression strategy.
+    enum class Strategy {
+      Auto,        // libpng chooses the strategy depending on the filter
+      Default,
+      Filtered,
+      HuffmanOnly,
+      Rle,
+    };
+
+    // Value for compressionLevel() to use the zlib default level.
+    static constexpr int kDefaultCompressionLevel = -1;
+
     struct Chunk {
       std::string name;
       base::buffer data;
@@ -39,8 +58,27 @@ namespace app {
 
     const Chunks& chunks() const { return m_userChunks; }
 
+    Filter filter() const { return m_filter; }
+    int compressionLevel() const { return m_compressionLevel; }
+    Strategy strategy() const { return m_strategy; }
+
+    void setFilter(const Filter filter) { m_filter = filter; }
+    void setCompressionLevel(const int level) { m_compressionLevel = level; }
+    void setStrategy(const Strategy strategy) { m_strategy = strategy; }
+
+    // Preset used to export a lot of files as fast as possible
+    // (e.g. from --batch mode), generating slightly bigger files.
+    void setFastExport() {
+      m_filter = Filter::Sub;
+      m_compressionLevel = 1;
+      m_strategy = Strategy::Auto;
+    }
+
   private:
     Chunks m_userChunks;
+    Filter m_filter = Filter::Adaptive;
+    int m_compressionLevel = kDefaultCompressionLevel;
+    Strategy m_strategy = Strategy::Auto;
   };
 
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2021  Igara Studio S.A.
+// Copyright (C) 2021-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -15,6 +15,8 @@
 #include "doc/sprite.h"
 #include "psd/psd.h"
 
+#include <algorithm>
+
 namespace app {
 
 doc::PixelFormat psd_cmode_to_ase_format(const psd::ColorMode mode)
@@ -111,6 +113,10 @@ public:
 
   Sprite* getSprite() { return assembleDocument(); }
 
+  // True if the file has layers (in that case we don't need the
+  // merged image data)
+  bool hasLayers() const { return !m_layers.empty(); }
+
   void onFileHeader(const psd::FileHeader& header) override
   {
     m_pixelFormat = psd_cmode_to_ase_format(header.colorMode);
@@ -324,28 +330,38 @@ public:
     }
     else if (m_pixelFormat == doc::PixelFormat::IMAGE_RGB) {
       RgbTraits::address_t dstAddress = (RgbTraits::address_t)dstGenericAddress;
-      uint8_t r, g, b, a;
-      for (int x = 0; x < dataCount && x < m_currentImage->width(); ++x) {
-        const uint8_t newPixelValue = getNormalizedPixelValue(data, img.depth);
-        const color_t c = *(dstAddress);
-        r = rgba_getr(c);
-        g = rgba_getg(c);
-        b = rgba_getb(c);
-        a = m_layerHasTransparentChannel ? rgba_geta(c) : 255;
-        if (chanID == psd::ChannelID::Red) {
-          r = newPixelValue;
-        }
-        else if (chanID == psd::ChannelID::Green) {
-          g = newPixelValue;
-        }
-        else if (chanID == psd::ChannelID::Blue) {
-          b = newPixelValue;
-        }
-        else if (chanID == psd::ChannelID::Alpha ||
-                 chanID == psd::ChannelID::TransparencyMask) {
-          a = newPixelValue;
+      const int n = std::min(dataCount, m_currentImage->width());
+
+      // Opaque layers (without transparent channel) get alpha=255
+      // with the first channel.
+      const color_t opaque = (m_layerHasTransparentChannel ? 0: rgba_a_mask);
+
+      int shift;
+      switch (chanID) {
+        case psd::ChannelID::Red:   shift = rgba_r_shift; break;
+        case psd::ChannelID::Green: shift = rgba_g_shift; break;
+        case psd::ChannelID::Blue:  shift = rgba_b_shift; break;
+        case psd::ChannelID::Alpha:
+        case psd::ChannelID::TransparencyMask:
+          shift = rgba_a_shift;
+          break;
+        default:
+          for (int x = 0; x < n; ++x)
+            *(dstAddress++) |= opaque;
+          return;
+      }
+
+      // Replace only the byte of this channel in each pixel
+      const color_t keep = ~(color_t(0xff) << shift);
+      if (img.depth == 8) {
+        for (int x = 0; x < n; ++x, ++dstAddress)
+          *dstAddress = (*dstAddress & keep) | (color_t(data[x]) << shift) | opaque;
+      }
+      else {
+        for (int x = 0; x < n; ++x, ++dstAddress) {
+          const color_t v = getNormalizedPixelValue(data, img.depth);
+          *dstAddress = (*dstAddress & keep) | (v << shift) | opaque;
         }
-        *(dstAddress++) = rgba(r, g, b, a);
       }
     }
   }
@@ -459,7 +475,13 @@ bool PsdFormat::onLoad(FileOp* fop)
     decoder.readColorModeData();
     decoder.readImageResources();
     decoder.readLayersAndMask();
-    decoder.readImageData();
+
+    // The image data section contains the merged image of all
+    // layers, which is only used when the file doesn't have
+    // layers. Decoding it in files with layers takes a lot of time
+    // and memory for nothing.
+    if (!pDelegate.hasLayers())
+      decoder.readImageData();
   }
   catch (const std::runtime_error& e) {
     fop->setError(e.what());
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2023  Igara Studio S.A.
+// Copyright (C) 2023-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -16,10 +16,231 @@
 #define QOI_IMPLEMENTATION
 #include "qoi.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace app {
 
 using namespace base;
 
+namespace {
+
+// The pixels are decoded/encoded directly from/to the doc::Image rows
+// using the same ops/tables of the reference implementation (qoi.h),
+// so we don't need an intermediate buffer with all the pixels of the
+// image (which is as big as the image itself).
+
+inline doc::color_t to_color(const qoi_rgba_t& px,
+                             const doc::color_t alphaMask) {
+  return doc::rgba(px.rgba.r, px.rgba.g, px.rgba.b, px.rgba.a) | alphaMask;
+}
+
+void decode_qoi_pixels(const uint8_t* bytes, const int size,
+                       const qoi_desc& desc, doc::Image* image)
+{
+  qoi_rgba_t index[64];
+  qoi_rgba_t px;
+  int p = QOI_HEADER_SIZE;
+  int run = 0;
+  const int chunksLen = size - int(sizeof(qoi_padding));
+
+  std::fill(std::begin(index), std::end(index), qoi_rgba_t{});
+  px.rgba.r = 0;
+  px.rgba.g = 0;
+  px.rgba.b = 0;
+  px.rgba.a = 255;
+
+  // Without alpha channel the pixels must be opaque
+  const doc::color_t alphaMask = (desc.channels == 3 ? doc::rgba_a_mask: 0);
+
+  const int w = int(desc.width);
+  const int h = int(desc.height);
+  for (int y=0; y<h; ++y) {
+    auto dst = (uint32_t*)image->getPixelAddress(0, y);
+    auto dstEnd = dst + w;
+    while (dst < dstEnd) {
+      if (run > 0) {
+        // Fill the whole run (or what fits in this row) at once
+        const int n = std::min(run, int(dstEnd - dst));
+        std::fill(dst, dst+n, to_color(px, alphaMask));
+        dst += n;
+        run -= n;
+        continue;
+      }
+
+      if (p < chunksLen) {
+        const int b1 = bytes[p++];
+
+        if (b1 == QOI_OP_RGB) {
+          px.rgba.r = bytes[p++];
+          px.rgba.g = bytes[p++];
+          px.rgba.b = bytes[p++];
+        }
+        else if (b1 == QOI_OP_RGBA) {
+          px.rgba.r = bytes[p++];
+          px.rgba.g = bytes[p++];
+          px.rgba.b = bytes[p++];
+          px.rgba.a = bytes[p++];
+        }
+        else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+          px = index[b1];
+        }
+        else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+          px.rgba.r += ((b1 >> 4) & 0x03) - 2;
+          px.rgba.g += ((b1 >> 2) & 0x03) - 2;
+          px.rgba.b += ( b1       & 0x03) - 2;
+        }
+        else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+          const int b2 = bytes[p++];
+          const int vg = (b1 & 0x3f) - 32;
+          px.rgba.r += vg - 8 + ((b2 >> 4) & 0x0f);
+          px.rgba.g += vg;
+          px.rgba.b += vg - 8 +  (b2       & 0x0f);
+        }
+        else if ((b1 & QOI_MASK_2) == QOI_OP_RUN) {
+          // The current pixel is included in the run
+          run = (b1 & 0x3f) + 1;
+        }
+
+        index[QOI_COLOR_HASH(px) % 64] = px;
+        if (run > 0)
+          continue;
+      }
+      // Truncated files repeat the last pixel (like qoi_decode())
+      *dst = to_color(px, alphaMask);
+      ++dst;
+    }
+  }
+}
+
+// Buffered output of the encoded QOI data to the file.
+class QoiWriter {
+public:
+  QoiWriter(FILE* f) : m_f(f) {
+    m_buf.reserve(kBufSize);
+  }
+  ~QoiWriter() {
+    flush();
+  }
+  void put(const uint8_t byte) {
+    m_buf.push_back(byte);
+    if (m_buf.size() == kBufSize)
+      flush();
+  }
+  void put32(const uint32_t v) {
+    put((v >> 24) & 0xff);
+    put((v >> 16) & 0xff);
+    put((v >>  8) & 0xff);
+    put( v        & 0xff);
+  }
+  void flush() {
+    if (!m_buf.empty()) {
+      fwrite(m_buf.data(), 1, m_buf.size(), m_f);
+      m_buf.clear();
+    }
+  }
+private:
+  static constexpr std::size_t kBufSize = 64*1024;
+  FILE* m_f;
+  std::vector<uint8_t> m_buf;
+};
+
+void encode_qoi_pixels(const qoi_desc& desc, const doc::Image* image, FILE* f)
+{
+  QoiWriter out(f);
+  out.put32(QOI_MAGIC);
+  out.put32(desc.width);
+  out.put32(desc.height);
+  out.put(desc.channels);
+  out.put(desc.colorspace);
+
+  qoi_rgba_t index[64];
+  qoi_rgba_t px, pxPrev;
+  int run = 0;
+
+  std::fill(std::begin(index), std::end(index), qoi_rgba_t{});
+  pxPrev.rgba.r = 0;
+  pxPrev.rgba.g = 0;
+  pxPrev.rgba.b = 0;
+  pxPrev.rgba.a = 255;
+  px = pxPrev;
+
+  const int w = int(desc.width);
+  const int h = int(desc.height);
+  for (int y=0; y<h; ++y) {
+    auto src = (const uint32_t*)image->getPixelAddress(0, y);
+    for (int x=0; x<w; ++x, ++src) {
+      const uint32_t c = *src;
+      px.rgba.r = doc::rgba_getr(c);
+      px.rgba.g = doc::rgba_getg(c);
+      px.rgba.b = doc::rgba_getb(c);
+      if (desc.channels == 4)
+        px.rgba.a = doc::rgba_geta(c);
+
+      if (px.v == pxPrev.v) {
+        ++run;
+        if (run == 62 || (y == h-1 && x == w-1)) {
+          out.put(QOI_OP_RUN | (run - 1));
+          run = 0;
+        }
+        continue;
+      }
+
+      if (run > 0) {
+        out.put(QOI_OP_RUN | (run - 1));
+        run = 0;
+      }
+
+      const int indexPos = QOI_COLOR_HASH(px) % 64;
+      if (index[indexPos].v == px.v) {
+        out.put(QOI_OP_INDEX | indexPos);
+      }
+      else {
+        index[indexPos] = px;
+
+        if (px.rgba.a == pxPrev.rgba.a) {
+          const signed char vr = px.rgba.r - pxPrev.rgba.r;
+          const signed char vg = px.rgba.g - pxPrev.rgba.g;
+          const signed char vb = px.rgba.b - pxPrev.rgba.b;
+          const signed char vg_r = vr - vg;
+          const signed char vg_b = vb - vg;
+
+          if (vr > -3 && vr < 2 &&
+              vg > -3 && vg < 2 &&
+              vb > -3 && vb < 2) {
+            out.put(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+          }
+          else if (vg_r >  -9 && vg_r <  8 &&
+                   vg   > -33 && vg   < 32 &&
+                   vg_b >  -9 && vg_b <  8) {
+            out.put(QOI_OP_LUMA | (vg + 32));
+            out.put((vg_r + 8) << 4 | (vg_b + 8));
+          }
+          else {
+            out.put(QOI_OP_RGB);
+            out.put(px.rgba.r);
+            out.put(px.rgba.g);
+            out.put(px.rgba.b);
+          }
+        }
+        else {
+          out.put(QOI_OP_RGBA);
+          out.put(px.rgba.r);
+          out.put(px.rgba.g);
+          out.put(px.rgba.b);
+          out.put(px.rgba.a);
+        }
+      }
+      pxPrev = px;
+    }
+  }
+
+  for (const auto byte : qoi_padding)
+    out.put(byte);
+}
+
+} // anonymous namespace
+
 class QoiFormat : public FileFormat {
   const char* onGetName() const override {
     return "qoi";
@@ -65,16 +286,26 @@ bool QoiFormat::onLoad(FileOp* fop)
     return false;
   fseek(f, 0, SEEK_SET);
 
-  auto data = QOI_MALLOC(size);
-  if (!data)
+  std::vector<uint8_t> data(size);
+  const int bytesRead = int(fread(data.data(), 1, size, f));
+  if (bytesRead < QOI_HEADER_SIZE + int(sizeof(qoi_padding)))
     return false;
 
+  // Read the header (same checks as qoi_decode())
+  int p = 0;
   qoi_desc desc;
-  auto bytes_read = fread(data, 1, size, f);
-  auto pixels = qoi_decode(data, bytes_read, &desc, 0);
-  QOI_FREE(data);
-  if (!pixels)
+  const unsigned int magic = qoi_read_32(data.data(), &p);
+  desc.width = qoi_read_32(data.data(), &p);
+  desc.height = qoi_read_32(data.data(), &p);
+  desc.channels = data[p++];
+  desc.colorspace = data[p++];
+  if (magic != QOI_MAGIC ||
+      desc.width == 0 || desc.height == 0 ||
+      desc.channels < 3 || desc.channels > 4 ||
+      desc.colorspace > 1 ||
+      desc.height >= QOI_PIXELS_MAX / desc.width) {
     return false;
+  }
 
   ImageRef image = fop->sequenceImageToLoad(
     IMAGE_RGB,
@@ -83,26 +314,7 @@ bool QoiFormat::onLoad(FileOp* fop)
   if (!image)
     return false;
 
-  auto src = (const uint8_t*)pixels;
-  for (int y=0; y<desc.height; ++y) {
-    auto dst = (uint32_t*)image->getPixelAddress(0, y);
-    switch (desc.channels) {
-      case 4:
-        for (int x=0; x<desc.width; ++x, ++dst) {
-          *dst = doc::rgba(src[0], src[1], src[2], src[3]);
-          src += 4;
-        }
-        break;
-      case 3:
-        for (int x=0; x<desc.width; ++x, ++dst) {
-          *dst = doc::rgba(src[0], src[1], src[2], 255);
-          src += 3;
-        }
-        break;
-    }
-  }
-
-  QOI_FREE(pixels);
+  decode_qoi_pixels(data.data(), bytesRead, desc, image.get());
 
   if (desc.channels == 4)
     fop->sequenceSetHasAlpha(true);
@@ -156,44 +368,7 @@ bool QoiFormat::onSave(FileOp* fop)
     desc.colorspace = QOI_LINEAR;
   }
 
-  auto pixels = (uint8_t*)QOI_MALLOC(desc.width * desc.height * desc.channels);
-  if (!pixels)
-    return false;
-
-  auto dst = pixels;
-  for (int y=0; y<desc.height; ++y) {
-    auto src = (uint32_t*)image->getPixelAddress(0, y);
-    switch (desc.channels) {
-      case 4:
-        for (int x=0; x<desc.width; ++x, ++src) {
-          uint32_t c = *src;
-          dst[0] = doc::rgba_getr(c);
-          dst[1] = doc::rgba_getg(c);
-          dst[2] = doc::rgba_getb(c);
-          dst[3] = doc::rgba_geta(c);
-          dst += 4;
-        }
-        break;
-      case 3:
-        for (int x=0; x<desc.width; ++x, ++src) {
-          uint32_t c = *src;
-          dst[0] = doc::rgba_getr(c);
-          dst[1] = doc::rgba_getg(c);
-          dst[2] = doc::rgba_getb(c);
-          dst += 3;
-        }
-        break;
-    }
-  }
-
-  int size = 0;
-  auto encoded = qoi_encode(pixels, &desc, &size);
-  QOI_FREE(pixels);
-  if (!encoded)
-    return false;
-
-  fwrite(encoded, 1, size, f);
-  QOI_FREE(encoded);
+  encode_qoi_pixels(desc, image.get(), f);
 
   if (ferror(handle.get())) {
     fop->setError("Error writing file.\n");
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (c) 2018-2023  Igara Studio S.A.
+// Copyright (c) 2018-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -23,6 +23,9 @@
 
 #include "svg_options.xml.h"
 
+#include <map>
+#include <vector>
+
 namespace app {
 
 using namespace base;
@@ -31,8 +34,9 @@ class SvgFormat : public FileFormat {
   // Data for SVG files
   class SvgOptions : public FormatOptions {
   public:
-    SvgOptions() : pixelScale(1) { }
+    SvgOptions() : pixelScale(1), mergePixels(true) { }
     int pixelScale;
+    bool mergePixels;
   };
 
   const char* onGetName() const override {
@@ -82,7 +86,7 @@ bool SvgFormat::onLoad(FileOp* fop)
 bool SvgFormat::onSave(FileOp* fop)
 {
   const ImageRef image = fop->sequenceImageToSave();
-  int x, y, c, r, g, b, a, alpha;
+  int x, y, r, g, b, a;
   const auto svg_options = std::static_pointer_cast<SvgOptions>(fop->formatOptions());
   const int pixelScaleValue = std::clamp(svg_options->pixelScale, 0, 10000);
   FileHandle handle(open_file_with_exception_sync_on_close(fop->filename(), "wb"));
@@ -98,63 +102,131 @@ bool SvgFormat::onSave(FileOp* fop)
   fprintf(f, "<svg version=\"1.1\" width=\"%d\" height=\"%d\" xmlns=\"http://www.w3.org/2000/svg\" shape-rendering=\"crispEdges\">\n",
           image->width()*pixelScaleValue, image->height()*pixelScaleValue);
 
-  switch (image->pixelFormat()) {
+  // Palette of indexed images
+  unsigned char image_palette[256][4];
+  color_t mask_color = -1;
+  if (image->pixelFormat() == IMAGE_INDEXED) {
+    for (y=0; y<256; y++) {
+      fop->sequenceGetColor(y, &r, &g, &b);
+      image_palette[y][0] = r;
+      image_palette[y][1] = g;
+      image_palette[y][2] = b;
+      fop->sequenceGetAlpha(y, &a);
+      image_palette[y][3] = a;
+    }
+    if (fop->document()->sprite()->backgroundLayer() == NULL ||
+        !fop->document()->sprite()->backgroundLayer()->isVisible()) {
+      mask_color = fop->document()->sprite()->transparentColor();
+    }
+  }
 
-    case IMAGE_RGB: {
-      for (y=0; y<image->height(); y++) {
-        for (x=0; x<image->width(); x++) {
-          c = get_pixel_fast<RgbTraits>(image.get(), x, y);
-          alpha = rgba_geta(c);
-          if (alpha != 0x00)
-            printcol(x, y, rgba_getr(c), rgba_getg(c), rgba_getb(c), alpha, pixelScaleValue);
-        }
-        fop->setProgress((float)y / (float)(image->height()));
+  // Returns the RGBA color of the given pixel, or 0 if the pixel is
+  // not exported (completely transparent).
+  auto get_rgba = [&image, &image_palette, mask_color](int x, int y) -> color_t {
+    switch (image->pixelFormat()) {
+      case IMAGE_RGB: {
+        const color_t c = get_pixel_fast<RgbTraits>(image.get(), x, y);
+        return (rgba_geta(c) ? c: 0);
+      }
+      case IMAGE_GRAYSCALE: {
+        const color_t c = get_pixel_fast<GrayscaleTraits>(image.get(), x, y);
+        const int v = graya_getv(c);
+        const int alpha = graya_geta(c);
+        return (alpha ? rgba(v, v, v, alpha): 0);
+      }
+      case IMAGE_INDEXED: {
+        const color_t c = get_pixel_fast<IndexedTraits>(image.get(), x, y);
+        if (c == mask_color || image_palette[c][3] == 0)
+          return 0;
+        return rgba(image_palette[c][0],
+                    image_palette[c][1],
+                    image_palette[c][2],
+                    image_palette[c][3]);
       }
-      break;
     }
-    case IMAGE_GRAYSCALE: {
-      for (y=0; y<image->height(); y++) {
-        for (x=0; x<image->width(); x++) {
-          c = get_pixel_fast<GrayscaleTraits>(image.get(), x, y);
-          auto v = graya_getv(c);
-          alpha = graya_geta(c);
-          if (alpha != 0x00)
-            printcol(x, y, v, v, v, alpha, pixelScaleValue);
+    return 0;
+  };
+
+  if (svg_options->mergePixels) {
+    // Merge horizontal runs of pixels of the same color, and then
+    // identical runs of consecutive rows, in rectangles. All the
+    // rectangles of the same color are drawn with one <path>.
+    struct Rect {
+      int x, y, w, h;
+    };
+    std::map<color_t, std::vector<Rect>> rects;
+    struct OpenRect {
+      int x, w;
+      color_t color;
+      int index;                // Index in rects[color]
+    };
+    std::vector<OpenRect> prevRow, curRow;
+
+    for (y=0; y<image->height(); y++) {
+      curRow.clear();
+      auto prev = prevRow.begin();
+      for (x=0; x<image->width(); ) {
+        const color_t c = get_rgba(x, y);
+        if (!c) {
+          ++x;
+          continue;
+        }
+        const int x0 = x;
+        for (++x; x<image->width() && get_rgba(x, y) == c; ++x)
+          ;
+        const int w = x - x0;
+
+        while (prev != prevRow.end() && prev->x < x0)
+          ++prev;
+
+        auto& colorRects = rects[c];
+        if (prev != prevRow.end() &&
+            prev->x == x0 &&
+            prev->w == w &&
+            prev->color == c) {
+          ++colorRects[prev->index].h;
+          curRow.push_back(*prev);
+          ++prev;
+        }
+        else {
+          colorRects.push_back(Rect{ x0, y, w, 1 });
+          curRow.push_back(OpenRect{ x0, w, c, int(colorRects.size()-1) });
         }
-        fop->setProgress((float)y / (float)(image->height()));
       }
-      break;
+      std::swap(prevRow, curRow);
+      fop->setProgress(0.5f * float(y) / float(image->height()));
     }
-    case IMAGE_INDEXED: {
-      unsigned char image_palette[256][4];
-      for (y=0; y<256; y++) {
-        fop->sequenceGetColor(y, &r, &g, &b);
-        image_palette[y][0] = r;
-        image_palette[y][1] = g;
-        image_palette[y][2] = b;
-        fop->sequenceGetAlpha(y, &a);
-        image_palette[y][3] = a;
-      }
-      color_t mask_color = -1;
-      if (fop->document()->sprite()->backgroundLayer() == NULL ||
-          !fop->document()->sprite()->backgroundLayer()->isVisible()) {
-        mask_color = fop->document()->sprite()->transparentColor();
+
+    int i = 0;
+    for (const auto& it : rects) {
+      const color_t c = it.first;
+      fprintf(f, "<path fill=\"#%02X%02X%02X\" ",
+              rgba_getr(c), rgba_getg(c), rgba_getb(c));
+      if (rgba_geta(c) != 255)
+        fprintf(f, "fill-opacity=\"%f\" ", (float)rgba_geta(c) / 255.0);
+      fprintf(f, "d=\"");
+      for (const Rect& rc : it.second) {
+        fprintf(f, "M%d %dh%dv%dh-%dz",
+                rc.x*pixelScaleValue, rc.y*pixelScaleValue,
+                rc.w*pixelScaleValue, rc.h*pixelScaleValue,
+                rc.w*pixelScaleValue);
       }
-      for (y=0; y<image->height(); y++) {
-        for (x=0; x<image->width(); x++) {
-          c = get_pixel_fast<IndexedTraits>(image.get(), x, y);
-          if (c != mask_color)
-            printcol(x, y, image_palette[c][0] & 0xff,
-                     image_palette[c][1] & 0xff,
-                     image_palette[c][2] & 0xff,
-                     image_palette[c][3] & 0xff,
-                     pixelScaleValue);
-        }
-        fop->setProgress((float)y / (float)(image->height()));
+      fprintf(f, "\"/>\n");
+      fop->setProgress(0.5f + 0.5f * float(++i) / float(rects.size()));
+    }
+  }
+  else {
+    for (y=0; y<image->height(); y++) {
+      for (x=0; x<image->width(); x++) {
+        const color_t c = get_rgba(x, y);
+        if (c)
+          printcol(x, y, rgba_getr(c), rgba_getg(c), rgba_getb(c), rgba_geta(c),
+                   pixelScaleValue);
       }
-      break;
+      fop->setProgress((float)y / (float)(image->height()));
     }
   }
+
   fprintf(f, "</svg>");
   if (ferror(f)) {
     fop->setError("Error writing file.\n");
@@ -178,16 +250,22 @@ FormatOptionsPtr SvgFormat::onAskUserForFormatOptions(FileOp* fop)
       if (pref.isSet(pref.svg.pixelScale))
         opts->pixelScale = pref.svg.pixelScale();
 
+      if (pref.isSet(pref.svg.mergePixels))
+        opts->mergePixels = pref.svg.mergePixels();
+
      if (pref.svg.showAlert()) {
         app::gen::SvgOptions win;
         win.pxsc()->setTextf("%d", opts->pixelScale);
+        win.mergePixels()->setSelected(opts->mergePixels);
         win.openWindowInForeground();
 
         if (win.closer() == win.ok()) {
           pref.svg.pixelScale((int)win.pxsc()->textInt());
+          pref.svg.mergePixels(win.mergePixels()->isSelected());
           pref.svg.showAlert(!win.dontShow()->isSelected());
 
           opts->pixelScale = pref.svg.pixelScale();
+          opts->mergePixels = pref.svg.mergePixels();
         }
         else {
           opts.reset();
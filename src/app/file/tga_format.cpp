@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -26,6 +26,8 @@
 
 #include "tga_options.xml.h"
 
+#include <cstdio>
+
 namespace app {
 
 using namespace base;
@@ -125,6 +127,11 @@ bool get_image_spec(const tga::Header& header, ImageSpec& spec)
 bool TgaFormat::onLoad(FileOp* fop)
 {
   FileHandle handle(open_file_with_exception(fop->filename(), "rb"));
+
+  // The TGA decoder reads the RLE data byte by byte, a bigger buffer
+  // reduces the number of read() calls to the OS.
+  std::setvbuf(handle.get(), nullptr, _IOFBF, 256*1024);
+
   tga::StdioFileInterface finterface(handle.get());
   tga::Decoder decoder(&finterface);
   tga::Header header;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2015-2018  David Capello
 // Copyright (C) 2015  Gabriel Rauter
 //
@@ -17,6 +17,7 @@
 #include "app/file/file.h"
 #include "app/file/file_format.h"
 #include "app/file/format_options.h"
+#include "app/file/frames_pipeline.h"
 #include "app/file/webp_options.h"
 #include "app/ini_file.h"
 #include "app/pref/preferences.h"
@@ -297,14 +298,16 @@ bool WebPFormat::onSave(FileOp* fop)
       break;
   }
 
+  if (opts->method() >= 0)
+    config.method = std::clamp(opts->method(), 0, 6);
+  config.thread_level = (opts->multiThreading() ? 1: 0);
+
   WebPAnimEncoderOptions enc_options;
   WebPAnimEncoderOptionsInit(&enc_options);
   enc_options.anim_params.loop_count =
     (opts->loop() ? 0:  // 0 = infinite
                     1); // 1 = loop once
 
-  ImageRef image(Image::create(IMAGE_RGB, w, h));
-
   const doc::frame_t totalFrames = fop->roi().frames();
   WriterData wd(fp, fop, totalFrames);
   WebPPicture pic;
@@ -312,43 +315,53 @@ bool WebPFormat::onSave(FileOp* fop)
   pic.width = w;
   pic.height = h;
   pic.use_argb = true;
-  pic.argb = (uint32_t*)image->getPixelAddress(0, 0);
-  pic.argb_stride = image->rowPixels(); // Stride in pixels (not bytes)
   pic.user_data = &wd;
   pic.progress_hook = progress_report;
 
   WebPAnimEncoder* enc = WebPAnimEncoderNew(w, h, &enc_options);
   int timestamp_ms = 0;
-  for (frame_t frame : fop->roi().framesSequence()) {
-    // Render the frame in the bitmap
-    clear_image(image.get(), image->maskColor());
-    sprite->renderFrame(frame, fop->roi().frameBounds(frame), image.get());
-
-    // Switch R <-> B channels because WebPAnimEncoderAssemble()
-    // expects MODE_BGRA pictures.
-    {
-      LockImageBits<RgbTraits> bits(image.get(), Image::ReadWriteLock);
-      auto it = bits.begin(), end = bits.end();
-      for (; it != end; ++it) {
-        auto c = *it;
-        *it = rgba(rgba_getb(c), // Use blue in red channel
-                   rgba_getg(c),
-                   rgba_getr(c), // Use red in blue channel
-                   rgba_geta(c));
+  {
+    std::vector<frame_t> frames;
+    for (frame_t frame : fop->roi().framesSequence())
+      frames.push_back(frame);
+
+    FramesPipeline pipeline(
+      sprite, fop, frames, IMAGE_RGB, w, h,
+      [](Image* image){
+        // Switch R <-> B channels because WebPAnimEncoderAssemble()
+        // expects MODE_BGRA pictures.
+        LockImageBits<RgbTraits> bits(image, Image::ReadWriteLock);
+        auto it = bits.begin(), end = bits.end();
+        for (; it != end; ++it) {
+          auto c = *it;
+          *it = rgba(rgba_getb(c), // Use blue in red channel
+                     rgba_getg(c),
+                     rgba_getr(c), // Use red in blue channel
+                     rgba_geta(c));
+        }
+      });
+    for (frame_t frame : pipeline.frames()) {
+      Image* image = pipeline.next();
+      pic.argb = (uint32_t*)image->getPixelAddress(0, 0);
+      pic.argb_stride = image->rowPixels(); // Stride in pixels (not bytes)
+
+      // WebPAnimEncoderAdd() copies the picture, so the render
+      // thread can reuse the image for other frame
+      const bool added = WebPAnimEncoderAdd(enc, &pic, timestamp_ms, &config);
+      pipeline.release(image);
+
+      if (!added) {
+        if (!fop->isStop()) {
+          fop->setError("Error saving frame %d info\n", frame);
+          return false;
+        }
+        else
+          return true;
       }
-    }
+      timestamp_ms += sprite->frameDuration(frame);
 
-    if (!WebPAnimEncoderAdd(enc, &pic, timestamp_ms, &config)) {
-      if (!fop->isStop()) {
-        fop->setError("Error saving frame %d info\n", frame);
-        return false;
-      }
-      else
-        return true;
+      wd.f++;
     }
-    timestamp_ms += sprite->frameDuration(frame);
-
-    wd.f++;
   }
   WebPAnimEncoderAdd(enc, nullptr, timestamp_ms, nullptr);
 
@@ -394,6 +407,10 @@ FormatOptionsPtr WebPFormat::onAskUserForFormatOptions(FileOp* fop)
           break;
       }
 
+      // Encoder options (they are not in the dialog)
+      opts->setMethod(pref.webp.method());
+      opts->setMultiThreading(pref.webp.multiThreading());
+
       if (pref.webp.showAlert()) {
         app::gen::WebpOptions win;
 
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 // Copyright (C) 2015  Gabriel Rauter
 //
@@ -29,7 +30,9 @@ namespace app {
                     m_compression(kDefaultCompression),
                     m_imageHint(WEBP_HINT_DEFAULT),
                     m_quality(100),
-                    m_imagePreset(WEBP_PRESET_DEFAULT) { }
+                    m_imagePreset(WEBP_PRESET_DEFAULT),
+                    m_method(-1),
+                    m_multiThreading(true) { }
 
     bool loop() const { return m_loop; }
     Type type() const { return m_type; }
@@ -37,6 +40,8 @@ namespace app {
     WebPImageHint imageHint() const { return m_imageHint; }
     int quality() const { return m_quality; }
     WebPPreset imagePreset() const { return m_imagePreset; }
+    int method() const { return m_method; }
+    bool multiThreading() const { return m_multiThreading; }
 
     void setLoop(const bool loop) {
       m_loop = loop;
@@ -71,6 +76,16 @@ namespace app {
       m_imagePreset = imagePreset;
     }
 
+    // Sets the WebPConfig::method (-1 uses the value of the
+    // preset/compression level).
+    void setMethod(const int method) {
+      m_method = method;
+    }
+
+    void setMultiThreading(const bool multiThreading) {
+      m_multiThreading = multiThreading;
+    }
+
   private:
     bool m_loop;
     Type m_type;
@@ -80,6 +95,9 @@ namespace app {
     // Lossy options
     int m_quality;      // Between 0 (smallest file) and 100 (biggest)
     WebPPreset m_imagePreset;  // Image Preset for lossy webp.
+    // Encoder options
+    int m_method;         // Quality/speed trade-off (0=fast, 6=slower-better, -1=default)
+    bool m_multiThreading; // Use multiple threads to encode each frame
   };
 
 } // namespace app
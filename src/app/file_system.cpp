@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -19,13 +19,19 @@
 
 #include "base/fs.h"
 #include "base/string.h"
+#include "base/thread.h"
+#include "base/time.h"
 #include "os/surface.h"
-#include "os/system.h"
-#include "os/window.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -70,6 +76,60 @@ unsigned int current_file_system_version = 0;
   base::ComPtr<IShellFolder> shl_idesktop;
 #endif
 
+// Lists the content of a folder in a background thread. Only the
+// information from the OS is collected here (names and attributes),
+// the FileItems are created in the main thread (see
+// FileItem::updateChildren()) because the map of items is not
+// thread-safe.
+class FolderLoader {
+public:
+  struct Entry {
+    std::string keyname;
+    std::string filename;
+    std::string displayname;
+    bool is_folder = false;
+#ifdef _WIN32
+    LPITEMIDLIST pidl = nullptr;
+    LPITEMIDLIST fullpidl = nullptr;
+#endif
+  };
+  using Entries = std::vector<Entry>;
+
+#ifdef _WIN32
+  FolderLoader(LPITEMIDLIST fullpidl, bool isDesktop);
+#else
+  FolderLoader(const std::string& path);
+#endif
+  ~FolderLoader();
+
+  bool isDone() const { return m_done; }
+
+  // Waits up to "msecs" milliseconds (or forever if it's negative)
+  // until all entries are found. Returns true if the listing is done.
+  bool wait(const int msecs);
+
+  // Returns the entries found since the last call.
+  Entries takeEntries();
+
+private:
+  void bgThread();
+  void listFolder();            // Platform-specific
+  void addEntry(Entry&& entry);
+
+#ifdef _WIN32
+  LPITEMIDLIST m_fullpidl;
+  bool m_isDesktop;
+#else
+  std::string m_path;
+#endif
+  std::mutex m_mutex;
+  std::condition_variable m_doneCond;
+  Entries m_entries;
+  std::atomic<bool> m_stop;
+  std::atomic<bool> m_done;
+  std::thread m_thread;
+};
+
 // a position in the file-system
 class FileItem final : public IFileItem {
 public:
@@ -81,6 +141,10 @@ public:
   FileItemList m_children;
   unsigned int m_version;
   bool m_removed;
+  bool m_listed;                  // True if m_children is complete
+  base::Time m_listedTime;        // Folder modification time when it was listed
+  base::Time m_loadingTime;
+  std::unique_ptr<FolderLoader> m_loader;
   mutable bool m_is_folder;
   std::atomic<double> m_thumbnailProgress;
   std::atomic<os::Surface*> m_thumbnail;
@@ -94,7 +158,8 @@ public:
   FileItem(FileItem* parent);
   ~FileItem();
 
-  void insertChildSorted(FileItem* child);
+  bool isChildrenOutdated();
+  void startLoader();
   int compare(const FileItem& that) const;
 
   bool operator<(const FileItem& that) const { return compare(that) < 0; }
@@ -114,6 +179,11 @@ public:
 
   IFileItem* parent() const override;
   const FileItemList& children() override;
+  bool loadChildren(const int msecs) override;
+  bool updateChildren() override;
+  bool isLoadingChildren() const override { return m_loader != nullptr; }
+  const FileItemList& loadedChildren() const override { return m_children; }
+  void invalidateChildren() override { m_listed = false; }
   void createDirectory(const std::string& dirname) override;
 
   bool hasExtension(const base::paths& extensions) override;
@@ -165,6 +235,13 @@ public:
 #ifdef _WIN32
   static SFGAOF get_pidl_attrib(FileItem* fileitem, SFGAOF attrib);
   static void update_by_pidl(FileItem* fileitem, SFGAOF attrib);
+  static void get_names_by_pidl(base::ComPtr<IShellFolder>& pDesktop,
+                                base::ComPtr<IShellFolder>& pFolder,
+                                LPITEMIDLIST pidl, LPITEMIDLIST fullpidl,
+                                SFGAOF attrib,
+                                std::string& filename,
+                                std::string& displayname,
+                                bool& is_folder);
   static LPITEMIDLIST concat_pidl(LPITEMIDLIST pidlHead, LPITEMIDLIST pidlTail);
   static UINT get_pidl_size(LPITEMIDLIST pidl);
   static LPITEMIDLIST get_next_pidl(LPITEMIDLIST pidl);
@@ -172,7 +249,8 @@ public:
   static LPITEMIDLIST clone_pidl(LPITEMIDLIST pidl);
   static LPITEMIDLIST remove_last_pidl(LPITEMIDLIST pidl);
   static void free_pidl(LPITEMIDLIST pidl);
-  static std::string get_key_for_pidl(LPITEMIDLIST pidl);
+  static std::string get_key_for_pidl(base::ComPtr<IShellFolder>& pDesktop,
+                                      LPITEMIDLIST pidl);
 
   static FileItem* get_fileitem_by_fullpidl(LPITEMIDLIST pidl, bool create_if_not);
   static void put_fileitem(FileItem* fileitem);
@@ -183,6 +261,8 @@ public:
   static void put_fileitem(FileItem* fileitem);
 #endif
 
+static base::Time get_folder_time(const std::string& path);
+
 FileSystemModule* FileSystemModule::m_instance = nullptr;
 
 FileSystemModule::FileSystemModule()
@@ -423,146 +503,99 @@ IFileItem* FileItem::parent() const
 
 const FileItemList& FileItem::children()
 {
-  // Is the file-item a folder?
-  if (isFolder() &&
-      // if the children list is empty, or the file-system version
-      // change (it's like to say: the current m_children list
-      // is outdated)...
-      (m_children.empty() ||
-       current_file_system_version > m_version)) {
-    FileItemList::iterator it;
-    FileItem* child;
-
-    // we have to mark current items as deprecated
-    for (it=m_children.begin();
-         it!=m_children.end(); ++it) {
-      child = static_cast<FileItem*>(*it);
-      child->m_removed = true;
-    }
-
-    //LOG("FS: Loading files for %p (%s)\n", fileitem, fileitem->displayname);
-#ifdef _WIN32
-    {
-      base::ComPtr<IShellFolder> pFolder;
-      HRESULT hr;
-
-      if (this == rootitem) {
-        pFolder = shl_idesktop;
-      }
-      else {
-        hr = shl_idesktop->BindToObject(
-          m_fullpidl, nullptr,
-          IID_IShellFolder, (LPVOID *)&pFolder);
-
-        if (hr != S_OK)
-          pFolder = nullptr;
-      }
-
-      if (pFolder) {
-        base::ComPtr<IEnumIDList> pEnum;
-        ULONG c, fetched;
-
-        // Get the interface to enumerate subitems
-        hr = pFolder->EnumObjects(
-          reinterpret_cast<HWND>(os::instance()->defaultWindow()->nativeHandle()),
-          SHCONTF_FOLDERS | SHCONTF_NONFOLDERS, &pEnum);
+  loadChildren(-1);
+  return m_children;
+}
 
-        if (hr == S_OK && pEnum) {
-          LPITEMIDLIST itempidl[256];
-          SFGAOF attribs[256];
+bool FileItem::loadChildren(const int msecs)
+{
+  if (!m_loader && isChildrenOutdated())
+    startLoader();
 
-          // Enumerate the items in the folder
-          while (pEnum->Next(256, itempidl, &fetched) == S_OK && fetched > 0) {
-            // Request the SFGAO_FOLDER attribute to know what of the
-            // item is file or a folder
-            for (c=0; c<fetched; ++c) {
-              attribs[c] = SFGAO_FOLDER;
-              pFolder->GetAttributesOf(1, (LPCITEMIDLIST*)itempidl, attribs+c);
-            }
+  if (m_loader) {
+    m_loader->wait(msecs);
+    updateChildren();
+  }
+  return (m_loader == nullptr);
+}
 
-            // Generate the FileItems
-            for (c=0; c<fetched; ++c) {
-              LPITEMIDLIST fullpidl = concat_pidl(m_fullpidl,
-                                                  itempidl[c]);
+bool FileItem::updateChildren()
+{
+  if (!m_loader)
+    return false;
 
-              child = get_fileitem_by_fullpidl(fullpidl, false);
-              if (!child) {
-                child = new FileItem(this);
+  // Check if the listing is done before taking the entries, so we
+  // cannot miss the last ones.
+  const bool done = m_loader->isDone();
+  FolderLoader::Entries entries = m_loader->takeEntries();
+  bool changed = false;
 
-                child->m_pidl = itempidl[c];
-                child->m_fullpidl = fullpidl;
+  FileItemList added;
+  for (FolderLoader::Entry& entry : entries) {
+    FileItem* child;
+    auto it = fileitems_map->find(entry.keyname);
+    if (it != fileitems_map->end()) {
+      child = it->second;
+      ASSERT(child->m_parent == this);
 
-                update_by_pidl(child, attribs[c]);
-                put_fileitem(child);
-              }
-              else {
-                ASSERT(child->m_parent == this);
-                free_pidl(fullpidl);
-                free_pidl(itempidl[c]);
-              }
+#ifdef _WIN32
+      free_pidl(entry.fullpidl);
+      free_pidl(entry.pidl);
+#endif
 
-              insertChildSorted(child);
-            }
-          }
-        }
+      // This file-item is already in the list and it wasn't removed
+      if (child->m_removed) {
+        child->m_removed = false;
+        continue;
       }
+      if (std::find(m_children.begin(), m_children.end(), child) != m_children.end())
+        continue;
     }
-#else
-    {
-      DIR* dir = opendir(m_filename.c_str());
-      if (dir) {
-        dirent* entry;
-        while ((entry = readdir(dir)) != NULL) {
-          FileItem* child;
-          std::string fn = entry->d_name;
-          std::string fullfn = base::join_path(m_filename, fn);
-
-          if (fn == "." || fn == "..")
-            continue;
-
-          child = get_fileitem_by_path(fullfn, false);
-          if (!child) {
-            child = new FileItem(this);
-
-            bool is_folder;
-            struct stat fileStat;
-
-            stat(fullfn.c_str(), &fileStat);
-
-            if ((fileStat.st_mode & S_IFMT) == S_IFLNK) {
-              is_folder = base::is_directory(fullfn);
-            }
-            else {
-              is_folder = ((fileStat.st_mode & S_IFMT) == S_IFDIR);
-            }
+    else {
+      child = new FileItem(this);
+      child->m_filename = std::move(entry.filename);
+      child->m_displayname = std::move(entry.displayname);
+      child->m_is_folder = entry.is_folder;
+#ifdef _WIN32
+      child->m_pidl = entry.pidl;
+      child->m_fullpidl = entry.fullpidl;
+#endif
+      // Same as put_fileitem() but with the key calculated in the
+      // background thread
+      child->m_keyname = std::move(entry.keyname);
+      fileitems_map->insert(std::make_pair(child->m_keyname, child));
+    }
+    added.push_back(child);
+  }
 
-            child->m_filename = fullfn;
-            child->m_displayname = fn;
-            child->m_is_folder = is_folder;
+  // Merge the new items with the sorted list of children
+  if (!added.empty()) {
+    auto less = [](const IFileItem* a, const IFileItem* b) {
+      return *static_cast<const FileItem*>(a) < *static_cast<const FileItem*>(b);
+    };
+    std::sort(added.begin(), added.end(), less);
+
+    const auto n = m_children.size();
+    m_children.insert(m_children.end(), added.begin(), added.end());
+    std::inplace_merge(m_children.begin(), m_children.begin()+n,
+                       m_children.end(), less);
+    changed = true;
+  }
 
-            put_fileitem(child);
-          }
-          else {
-            ASSERT(child->m_parent == this);
-          }
-
-          insertChildSorted(child);
-        }
-        closedir(dir);
-      }
-    }
-#endif
+  if (done) {
+    m_loader.reset();
 
     // check old file-items (maybe removed directories or file-items)
-    for (it=m_children.begin();
+    for (auto it=m_children.begin();
          it!=m_children.end(); ) {
-      child = static_cast<FileItem*>(*it);
+      FileItem* child = static_cast<FileItem*>(*it);
       ASSERT(child);
 
       if (child && child->m_removed) {
         it = m_children.erase(it);
         child->m_parent = nullptr;
         child->deleteItem();
+        changed = true;
       }
       else
         ++it;
@@ -570,9 +603,54 @@ const FileItemList& FileItem::children()
 
     // now this file-item is updated
     m_version = current_file_system_version;
+    m_listedTime = m_loadingTime;
+    m_listed = true;
   }
 
-  return m_children;
+  return changed;
+}
+
+bool FileItem::isChildrenOutdated()
+{
+  if (!isFolder())
+    return false;
+
+  if (m_listed) {
+    if (m_version == current_file_system_version)
+      return false;
+
+    // The file system was refreshed, but we don't need to list the
+    // folder again if it wasn't modified (which is really slow for
+    // big folders in network drives).
+    const base::Time time = get_folder_time(m_filename);
+    if (time.year > 0 && time == m_listedTime) {
+      m_version = current_file_system_version;
+      return false;
+    }
+  }
+  return true;
+}
+
+void FileItem::startLoader()
+{
+  ASSERT(!m_loader);
+
+  // The modification time has a precision of seconds, so we cannot
+  // trust it if the folder is being modified in this same second.
+  m_loadingTime = get_folder_time(m_filename);
+  if (m_loadingTime == base::current_time())
+    m_loadingTime = base::Time();
+
+  // we have to mark current items as deprecated
+  for (auto ichild : m_children)
+    static_cast<FileItem*>(ichild)->m_removed = true;
+
+  //LOG("FS: Loading files for %p (%s)\n", fileitem, fileitem->displayname);
+#ifdef _WIN32
+  m_loader = std::make_unique<FolderLoader>(m_fullpidl, this == rootitem);
+#else
+  m_loader = std::make_unique<FolderLoader>(m_filename);
+#endif
 }
 
 void FileItem::createDirectory(const std::string& dirname)
@@ -580,7 +658,7 @@ void FileItem::createDirectory(const std::string& dirname)
   base::make_directory(base::join_path(m_filename, dirname));
 
   // Invalidate the children list.
-  m_version = 0;
+  invalidateChildren();
 }
 
 bool FileItem::hasExtension(const base::paths& extensions)
@@ -619,6 +697,7 @@ FileItem::FileItem(FileItem* parent)
   m_parent = parent;
   m_version = current_file_system_version;
   m_removed = false;
+  m_listed = false;
   m_is_folder = false;
   m_thumbnailProgress = 0.0;
   m_thumbnail = nullptr;
@@ -647,25 +726,6 @@ FileItem::~FileItem()
 #endif
 }
 
-void FileItem::insertChildSorted(FileItem* child)
-{
-  // this file-item wasn't removed from the last lookup
-  child->m_removed = false;
-
-  // if the fileitem is already in the list we can go back
-  if (std::find(m_children.begin(), m_children.end(), child) != m_children.end())
-    return;
-
-  for (auto it=m_children.begin(), end=m_children.end(); it!=end; ++it) {
-    if (*child < *static_cast<FileItem*>(*it)) {
-      m_children.insert(it, child);
-      return;
-    }
-  }
-
-  m_children.push_back(child);
-}
-
 int FileItem::compare(const FileItem& that) const
 {
   if (isFolder()) {
@@ -678,6 +738,85 @@ int FileItem::compare(const FileItem& that) const
   return base::compare_filenames(m_displayname, that.m_displayname);
 }
 
+// ======================================================================
+// FolderLoader class
+// ======================================================================
+
+#ifdef _WIN32
+FolderLoader::FolderLoader(LPITEMIDLIST fullpidl, bool isDesktop)
+  : m_fullpidl(clone_pidl(fullpidl))
+  , m_isDesktop(isDesktop)
+#else
+FolderLoader::FolderLoader(const std::string& path)
+  : m_path(path)
+#endif
+  , m_stop(false)
+  , m_done(false)
+  , m_thread([this]{ bgThread(); })
+{
+}
+
+FolderLoader::~FolderLoader()
+{
+  m_stop = true;
+  m_thread.join();
+
+#ifdef _WIN32
+  for (Entry& entry : m_entries) {
+    free_pidl(entry.fullpidl);
+    free_pidl(entry.pidl);
+  }
+  free_pidl(m_fullpidl);
+#endif
+}
+
+bool FolderLoader::wait(const int msecs)
+{
+  std::unique_lock lock(m_mutex);
+  if (msecs < 0)
+    m_doneCond.wait(lock, [this]{ return m_done.load(); });
+  else
+    m_doneCond.wait_for(lock, std::chrono::milliseconds(msecs),
+                        [this]{ return m_done.load(); });
+  return m_done;
+}
+
+FolderLoader::Entries FolderLoader::takeEntries()
+{
+  const std::lock_guard lock(m_mutex);
+  Entries entries;
+  std::swap(entries, m_entries);
+  return entries;
+}
+
+void FolderLoader::bgThread()
+{
+  base::this_thread::set_name("listing");
+
+  listFolder();
+  {
+    const std::lock_guard lock(m_mutex);
+    m_done = true;
+  }
+  m_doneCond.notify_all();
+}
+
+void FolderLoader::addEntry(Entry&& entry)
+{
+  const std::lock_guard lock(m_mutex);
+  m_entries.push_back(std::move(entry));
+}
+
+static base::Time get_folder_time(const std::string& path)
+{
+#ifdef _WIN32
+  // Special locations (like "My Computer") don't have a time
+  if (path.empty() || path.front() == ':')
+    return base::Time();
+#endif
+  return base::get_modification_time(path);
+}
+
 //////////////////////////////////////////////////////////////////////
 // PIDLS: Only for Win32
 //////////////////////////////////////////////////////////////////////
@@ -720,8 +859,6 @@ static SFGAOF get_pidl_attrib(FileItem* fileitem, SFGAOF attrib)
 // Updates the names of the file-item through its PIDL
 static void update_by_pidl(FileItem* fileitem, SFGAOF attrib)
 {
-  STRRET strret;
-  WCHAR pszName[MAX_PATH];
   base::ComPtr<IShellFolder> pFolder;
   HRESULT hr;
 
@@ -735,47 +872,67 @@ static void update_by_pidl(FileItem* fileitem, SFGAOF attrib)
       pFolder = nullptr;
   }
 
+  get_names_by_pidl(shl_idesktop, pFolder,
+                    fileitem->m_pidl, fileitem->m_fullpidl, attrib,
+                    fileitem->m_filename,
+                    fileitem->m_displayname,
+                    fileitem->m_is_folder);
+}
+
+// Gets the names of an item through its PIDL (it can be used from a
+// background thread with its own desktop/parent folder interfaces).
+static void get_names_by_pidl(base::ComPtr<IShellFolder>& pDesktop,
+                              base::ComPtr<IShellFolder>& pFolder,
+                              LPITEMIDLIST pidl, LPITEMIDLIST fullpidl,
+                              SFGAOF attrib,
+                              std::string& filename,
+                              std::string& displayname,
+                              bool& is_folder)
+{
+  STRRET strret;
+  WCHAR pszName[MAX_PATH];
+
   // Get the file name
 
   if (pFolder &&
-      pFolder->GetDisplayNameOf(fileitem->m_pidl,
+      pFolder->GetDisplayNameOf(pidl,
                                 SHGDN_NORMAL | SHGDN_FORPARSING,
                                 &strret) == S_OK) {
-    StrRetToBuf(&strret, fileitem->m_pidl, pszName, MAX_PATH);
-    fileitem->m_filename = base::to_utf8(pszName);
+    StrRetToBuf(&strret, pidl, pszName, MAX_PATH);
+    filename = base::to_utf8(pszName);
   }
-  else if (shl_idesktop->GetDisplayNameOf(fileitem->m_fullpidl,
-                                          SHGDN_NORMAL | SHGDN_FORPARSING,
-                                          &strret) == S_OK) {
-    StrRetToBuf(&strret, fileitem->m_fullpidl, pszName, MAX_PATH);
-    fileitem->m_filename = base::to_utf8(pszName);
+  else if (pDesktop->GetDisplayNameOf(fullpidl,
+                                      SHGDN_NORMAL | SHGDN_FORPARSING,
+                                      &strret) == S_OK) {
+    StrRetToBuf(&strret, fullpidl, pszName, MAX_PATH);
+    filename = base::to_utf8(pszName);
   }
   else
-    fileitem->m_filename = "ERR";
+    filename = "ERR";
 
   // Is it a folder?
 
-  fileitem->m_is_folder = calc_is_folder(fileitem->m_filename, attrib);
+  is_folder = calc_is_folder(filename, attrib);
 
   // Get the name to display
 
-  if (fileitem->isFolder() &&
+  if (is_folder &&
       pFolder &&
-      pFolder->GetDisplayNameOf(fileitem->m_pidl,
+      pFolder->GetDisplayNameOf(pidl,
                                 SHGDN_INFOLDER,
                                 &strret) == S_OK) {
-    StrRetToBuf(&strret, fileitem->m_pidl, pszName, MAX_PATH);
-    fileitem->m_displayname = base::to_utf8(pszName);
+    StrRetToBuf(&strret, pidl, pszName, MAX_PATH);
+    displayname = base::to_utf8(pszName);
   }
-  else if (fileitem->isFolder() &&
-           shl_idesktop->GetDisplayNameOf(fileitem->m_fullpidl,
-                                          SHGDN_INFOLDER,
-                                          &strret) == S_OK) {
-    StrRetToBuf(&strret, fileitem->m_fullpidl, pszName, MAX_PATH);
-    fileitem->m_displayname = base::to_utf8(pszName);
+  else if (is_folder &&
+           pDesktop->GetDisplayNameOf(fullpidl,
+                                      SHGDN_INFOLDER,
+                                      &strret) == S_OK) {
+    StrRetToBuf(&strret, fullpidl, pszName, MAX_PATH);
+    displayname = base::to_utf8(pszName);
   }
   else {
-    fileitem->m_displayname = base::get_file_name(fileitem->m_filename);
+    displayname = base::get_file_name(filename);
   }
 }
 
@@ -876,7 +1033,8 @@ static void free_pidl(LPITEMIDLIST pidl)
   shl_imalloc->Free(pidl);
 }
 
-static std::string get_key_for_pidl(LPITEMIDLIST pidl)
+static std::string get_key_for_pidl(base::ComPtr<IShellFolder>& pDesktop,
+                                    LPITEMIDLIST pidl)
 {
 #if 0
   char *key = base_malloc(get_pidl_size(pidl)+1);
@@ -904,9 +1062,9 @@ static std::string get_key_for_pidl(LPITEMIDLIST pidl)
   //LOG("FS: ***\n");
   pidl = clone_pidl(pidl);
   while (pidl->mkid.cb > 0) {
-    if (shl_idesktop->GetDisplayNameOf(pidl,
-                                       SHGDN_INFOLDER | SHGDN_FORPARSING,
-                                       &strret) == S_OK) {
+    if (pDesktop->GetDisplayNameOf(pidl,
+                                   SHGDN_INFOLDER | SHGDN_FORPARSING,
+                                   &strret) == S_OK) {
       if (StrRetToBuf(&strret, pidl, pszName, MAX_PATH) != S_OK)
         pszName[0] = 0;
 
@@ -939,7 +1097,7 @@ static std::string get_key_for_pidl(LPITEMIDLIST pidl)
 
 static FileItem* get_fileitem_by_fullpidl(LPITEMIDLIST fullpidl, bool create_if_not)
 {
-  auto key = get_key_for_pidl(fullpidl);
+  auto key = get_key_for_pidl(shl_idesktop, fullpidl);
   auto it = fileitems_map->find(key);
   if (it != fileitems_map->end()) {
     FileItem* item = it->second;
@@ -1001,12 +1159,12 @@ static void put_fileitem(FileItem* fileitem)
   ASSERT(fileitem->m_filename != NOTINITIALIZED);
   ASSERT(fileitem->m_keyname == NOTINITIALIZED);
 
-  fileitem->m_keyname = get_key_for_pidl(fileitem->m_fullpidl);
+  fileitem->m_keyname = get_key_for_pidl(shl_idesktop, fileitem->m_fullpidl);
 
   ASSERT(fileitem->m_keyname != NOTINITIALIZED);
 
 #ifdef _DEBUG
-  auto it = fileitems_map->find(get_key_for_pidl(fileitem->m_fullpidl));
+  auto it = fileitems_map->find(get_key_for_pidl(shl_idesktop, fileitem->m_fullpidl));
   ASSERT(it == fileitems_map->end());
 #endif
 
@@ -1014,6 +1172,72 @@ static void put_fileitem(FileItem* fileitem)
   fileitems_map->insert(std::make_pair(fileitem->m_keyname, fileitem));
 }
 
+void FolderLoader::listFolder()
+{
+  // This thread needs its own COM interfaces
+  const HRESULT comInit = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
+  {
+    base::ComPtr<IShellFolder> pDesktop;
+    base::ComPtr<IShellFolder> pFolder;
+    HRESULT hr = SHGetDesktopFolder(&pDesktop);
+    if (hr != S_OK)
+      pDesktop = nullptr;
+    else if (m_isDesktop)
+      pFolder = pDesktop;
+    else {
+      hr = pDesktop->BindToObject(
+        m_fullpidl, nullptr,
+        IID_IShellFolder, (LPVOID *)&pFolder);
+
+      if (hr != S_OK)
+        pFolder = nullptr;
+    }
+
+    if (pFolder) {
+      base::ComPtr<IEnumIDList> pEnum;
+      ULONG c, fetched;
+
+      // Get the interface to enumerate subitems (without a parent
+      // window, because we are not in the UI thread)
+      hr = pFolder->EnumObjects(
+        nullptr, SHCONTF_FOLDERS | SHCONTF_NONFOLDERS, &pEnum);
+
+      if (hr == S_OK && pEnum) {
+        LPITEMIDLIST itempidl[256];
+
+        // Enumerate the items in the folder
+        while (!m_stop &&
+               pEnum->Next(256, itempidl, &fetched) == S_OK && fetched > 0) {
+          for (c=0; c<fetched; ++c) {
+            if (m_stop) {
+              free_pidl(itempidl[c]);
+              continue;
+            }
+
+            // Request the SFGAO_FOLDER attribute to know what of the
+            // item is file or a folder
+            SFGAOF attrib = SFGAO_FOLDER;
+            pFolder->GetAttributesOf(1, (LPCITEMIDLIST*)(itempidl+c), &attrib);
+
+            Entry entry;
+            entry.pidl = itempidl[c];
+            entry.fullpidl = concat_pidl(m_fullpidl, itempidl[c]);
+            entry.keyname = get_key_for_pidl(pDesktop, entry.fullpidl);
+            get_names_by_pidl(pDesktop, pFolder,
+                              entry.pidl, entry.fullpidl, attrib,
+                              entry.filename,
+                              entry.displayname,
+                              entry.is_folder);
+            addEntry(std::move(entry));
+          }
+        }
+      }
+    }
+  }
+  if (SUCCEEDED(comInit))
+    CoUninitialize();
+}
+
 #else
 
 //////////////////////////////////////////////////////////////////////
@@ -1101,6 +1325,53 @@ static void put_fileitem(FileItem* fileitem)
   fileitems_map->insert(std::make_pair(fileitem->m_keyname, fileitem));
 }
 
+void FolderLoader::listFolder()
+{
+  DIR* dir = opendir(m_path.c_str());
+  if (!dir)
+    return;
+
+  dirent* entry;
+  while (!m_stop && (entry = readdir(dir)) != NULL) {
+    std::string fn = entry->d_name;
+    if (fn == "." || fn == "..")
+      continue;
+
+    std::string fullfn = base::join_path(m_path, fn);
+    bool is_folder;
+
+#ifdef DT_DIR
+    // Avoid a stat() call for each file when the file system gives
+    // us the type of the entry (stat() is slow in network drives)
+    if (entry->d_type == DT_DIR)
+      is_folder = true;
+    else if (entry->d_type == DT_REG)
+      is_folder = false;
+    else
+#endif
+    {
+      struct stat fileStat;
+
+      stat(fullfn.c_str(), &fileStat);
+
+      if ((fileStat.st_mode & S_IFMT) == S_IFLNK) {
+        is_folder = base::is_directory(fullfn);
+      }
+      else {
+        is_folder = ((fileStat.st_mode & S_IFMT) == S_IFDIR);
+      }
+    }
+
+    Entry item;
+    item.keyname = get_key_for_filename(fullfn);
+    item.filename = std::move(fullfn);
+    item.displayname = std::move(fn);
+    item.is_folder = is_folder;
+    addEntry(std::move(item));
+  }
+  closedir(dir);
+}
+
 #endif
 
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -79,7 +79,32 @@ namespace app {
     virtual const std::string& displayName() const = 0;
 
     virtual IFileItem* parent() const = 0;
+
+    // Returns the children of this folder. If the list is outdated
+    // (the folder was modified since the last time it was listed),
+    // the folder is listed again and the caller is blocked until
+    // it's finished.
     virtual const FileItemList& children() = 0;
+
+    // Starts listing the children of this folder in a background
+    // thread (only if the list is outdated) and waits up to "msecs"
+    // milliseconds for it. Returns true if the list is complete, in
+    // other case updateChildren() must be called periodically from
+    // the main thread to add the items that are being found.
+    virtual bool loadChildren(const int msecs) = 0;
+
+    // Adds the items found by the background listing to the list of
+    // children, returns true if the list of children was modified.
+    virtual bool updateChildren() = 0;
+    virtual bool isLoadingChildren() const = 0;
+
+    // Children listed so far (without listing the folder again).
+    virtual const FileItemList& loadedChildren() const = 0;
+
+    // Forces listing the folder again the next time its children are
+    // requested (even if it wasn't modified).
+    virtual void invalidateChildren() = 0;
+
     virtual void createDirectory(const std::string& dirname) = 0;
 
     virtual bool hasExtension(const base::paths& extensions) = 0;
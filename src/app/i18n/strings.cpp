@@ -13,6 +13,7 @@
 
 #include "app/app.h"
 #include "app/extensions.h"
+#include "app/perf_trace.h"
 #include "app/pref/preferences.h"
 #include "app/resource_finder.h"
 #include "app/xml_document.h"
@@ -33,6 +34,8 @@ const char* Strings::kDefLanguage = "en";
 void Strings::createInstance(Preferences& pref,
                              Extensions& exts)
 {
+  PerfScope perf(PerfCategory::Startup, "Strings::createInstance");
+
   ASSERT(!singleton);
   singleton = new Strings(pref, exts);
 }
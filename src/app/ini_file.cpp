@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -13,8 +13,10 @@
 
 #include "app/resource_finder.h"
 #include "base/fs.h"
+#include "base/log.h"
 #include "base/split_string.h"
 #include "base/string.h"
+#include "base/thread.h"
 #include "cfg/cfg.h"
 #include "fmt/format.h"
 
@@ -27,18 +29,131 @@
   #include "base/fs.h"
 #endif
 
+#include <chrono>
+#include <condition_variable>
 #include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 namespace app {
 
 using namespace gfx;
 
+namespace {
+
+// Time to wait before writing a flushed file, so consecutive flushes
+// of the same file (e.g. saving the preferences several times) are
+// written only once.
+constexpr auto kWriteDelay = std::chrono::milliseconds(500);
+
+void write_config_file(const std::string& filename, const std::string& data)
+{
+  try {
+    base::write_file_content(filename, (const uint8_t*)data.c_str(), data.size());
+  }
+  catch (const std::exception& ex) {
+    LOG(ERROR, "CFG: Error saving configuration into %s: %s\n",
+        filename.c_str(), ex.what());
+  }
+}
+
+// Writes the configuration files in a background thread, so the UI
+// thread doesn't have to wait the disk each time the preferences are
+// flushed. The pending files are written when this object is
+// destroyed (at exit).
+class ConfigWriter {
+public:
+  ConfigWriter() : m_thread([this]{ writerThread(); }) { }
+
+  ~ConfigWriter() {
+    {
+      const std::lock_guard lock(m_mutex);
+      m_stop = true;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+  }
+
+  // Replaces the pending content of the given file (only the last
+  // content is written).
+  void write(const std::string& filename, std::string&& data) {
+    {
+      const std::lock_guard lock(m_mutex);
+      m_pending[filename] = std::move(data);
+    }
+    m_cv.notify_one();
+  }
+
+  // Writes right now the pending content of the given file and waits
+  // the background thread if it's writing it (used before reading
+  // the file again).
+  void flushFile(const std::string& filename) {
+    std::unique_lock lock(m_mutex);
+    std::string data;
+    bool found = false;
+    auto it = m_pending.find(filename);
+    if (it != m_pending.end()) {
+      data = std::move(it->second);
+      m_pending.erase(it);
+      found = true;
+    }
+
+    // Always m_mutex -> m_writeMutex order (same as writerThread())
+    const std::lock_guard writeLock(m_writeMutex);
+    lock.unlock();
+
+    if (found)
+      write_config_file(filename, data);
+  }
+
+private:
+  void writerThread() {
+    base::this_thread::set_name("config-writer");
+
+    std::unique_lock lock(m_mutex);
+    while (true) {
+      m_cv.wait(lock, [this]{ return m_stop || !m_pending.empty(); });
+
+      // Wait some time to coalesce more flushes
+      if (!m_stop)
+        m_cv.wait_for(lock, kWriteDelay, [this]{ return m_stop; });
+
+      while (!m_pending.empty()) {
+        auto node = m_pending.extract(m_pending.begin());
+        {
+          const std::lock_guard writeLock(m_writeMutex);
+          lock.unlock();
+          write_config_file(node.key(), node.mapped());
+        }
+        lock.lock();
+      }
+
+      if (m_stop)
+        break;
+    }
+  }
+
+  std::mutex m_mutex;           // Protects m_pending and m_stop
+  std::mutex m_writeMutex;      // Locked while a file is written
+  std::condition_variable m_cv;
+  std::map<std::string, std::string> m_pending;
+  bool m_stop = false;
+  std::thread m_thread;
+};
+
+} // anonymous namespace
+
 static std::string g_configFilename;
 static std::vector<cfg::CfgFile*> g_configs;
+static std::unique_ptr<ConfigWriter> g_writer;
 
 ConfigModule::ConfigModule()
 {
+  g_writer = std::make_unique<ConfigWriter>();
+
   ResourceFinder rf;
   rf.includeUserDir("aseprite.ini");
 
@@ -101,6 +216,9 @@ ConfigModule::~ConfigModule()
 {
   flush_config_file();
 
+  // Write all pending files
+  g_writer.reset();
+
   for (auto cfg : g_configs)
     delete cfg;
   g_configs.clear();
@@ -126,7 +244,14 @@ void flush_config_file()
 {
   ASSERT(!g_configs.empty());
 
-  g_configs.back()->save();
+  cfg::CfgFile* cfg = g_configs.back();
+  if (!cfg->isModified())
+    return;
+
+  if (g_writer)
+    g_writer->write(cfg->filename(), cfg->saveToString());
+  else
+    cfg->save();
 }
 
 void set_config_file(const char* filename)
@@ -134,6 +259,10 @@ void set_config_file(const char* filename)
   if (g_configs.empty())
     g_configs.push_back(new cfg::CfgFile());
 
+  // The file could be waiting to be written
+  if (g_writer)
+    g_writer->flushFile(filename);
+
   g_configs.back()->load(filename);
 }
 
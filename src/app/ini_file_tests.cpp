@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -55,3 +55,35 @@ TEST(IniFile, PushPop)
 
   EXPECT_EQ(32, get_config_int("A", "a", 0));
 }
+
+TEST(IniFile, FlushAndReload)
+{
+  if (base::is_file("_c.ini")) base::delete_file("_c.ini");
+
+  {
+    ConfigModule cm;
+
+    push_config_state();
+    set_config_file("_c.ini");
+    set_config_int("A", "a", 32);
+    flush_config_file();
+    pop_config_state();
+
+    // The file can be still pending to be written, but we must load
+    // the flushed values
+    push_config_state();
+    set_config_file("_c.ini");
+    EXPECT_EQ(32, get_config_int("A", "a", 0));
+
+    set_config_int("A", "a", 64);
+    flush_config_file();
+    pop_config_state();
+  }
+
+  // All pending files are written when the ConfigModule is destroyed
+  ConfigModule cm;
+  push_config_state();
+  set_config_file("_c.ini");
+  EXPECT_EQ(64, get_config_int("A", "a", 0));
+  pop_config_state();
+}
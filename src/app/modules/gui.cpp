@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -523,14 +523,11 @@ bool CustomizedGuiManager::onProcessMessage(Message* msg)
       //
       // TODO could we send the files to each dialog?
       if (getForegroundWindow() == App::instance()->mainWindow()) {
-        base::paths files = static_cast<DropFilesMessage*>(msg)->files();
+        const base::paths& files = static_cast<DropFilesMessage*>(msg)->files();
         UIContext* ctx = UIContext::instance();
-        OpenBatchOfFiles batch;
-
-        while (!files.empty()) {
-          auto fn = files.front();
-          files.erase(files.begin());
+        base::paths filesToOpen;
 
+        for (const auto& fn : files) {
           // If the document is already open, select it.
           Doc* doc = ctx->documents().getByFileName(fn);
           if (doc) {
@@ -556,18 +553,19 @@ bool CustomizedGuiManager::onProcessMessage(Message* msg)
             }
             // Other extensions will be handled as an image/sprite
             else {
-              batch.open(ctx, fn,
-                         false); // Open all frames
-
-              // Remove all used file names from the "dropped files"
-              for (const auto& usedFn : batch.usedFiles()) {
-                auto it = std::find(files.begin(), files.end(), usedFn);
-                if (it != files.end())
-                  files.erase(it);
-              }
+              filesToOpen.push_back(fn);
             }
           }
         }
+
+        // Open all the images at the same time (they are loaded in
+        // parallel, and the files used in sequences are opened only
+        // one time)
+        if (!filesToOpen.empty()) {
+          OpenBatchOfFiles batch;
+          batch.open(ctx, filesToOpen,
+                     false); // Open all frames
+        }
       }
       break;
 
@@ -0,0 +1,192 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/perf_trace.h"
+
+#include "base/file_handle.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace app {
+
+namespace details {
+std::atomic<bool> g_perfEnabled(false);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Limit of events in a trace (~32MB), older events are discarded
+// after this limit so the recorder can be left running.
+constexpr std::size_t kMaxEvents = 1024*1024;
+
+struct Event {
+  const char* name;
+  PerfCategory category;
+  int tid;
+  Clock::time_point start;
+  Clock::duration dur;
+};
+
+std::mutex g_mutex;
+bool g_hud = false;
+bool g_recording = false;
+PerfStats g_stats[int(PerfCategory::Count)];
+std::vector<Event> g_events;
+std::size_t g_firstEvent = 0; // Oldest event when g_events is full (ring buffer)
+Clock::time_point g_traceStart;
+
+// Small thread IDs for the trace file
+std::atomic<int> g_nextTid(1);
+thread_local int t_tid = 0;
+
+int current_tid()
+{
+  if (!t_tid)
+    t_tid = g_nextTid++;
+  return t_tid;
+}
+
+void update_enabled()
+{
+  details::g_perfEnabled = (g_hud || g_recording);
+}
+
+} // anonymous namespace
+
+const char* perf_category_name(const PerfCategory category)
+{
+  switch (category) {
+    case PerfCategory::Render:   return "render";
+    case PerfCategory::Surface:  return "surface";
+    case PerfCategory::ToolLoop: return "tool_loop";
+    case PerfCategory::FileOp:   return "file";
+    case PerfCategory::Backup:   return "backup";
+    case PerfCategory::Script:   return "script";
+    case PerfCategory::Startup:  return "startup";
+    case PerfCategory::Count:    break;
+  }
+  return "";
+}
+
+void set_perf_hud_enabled(const bool state)
+{
+  const std::lock_guard lock(g_mutex);
+  g_hud = state;
+  update_enabled();
+}
+
+bool is_perf_hud_enabled()
+{
+  const std::lock_guard lock(g_mutex);
+  return g_hud;
+}
+
+PerfStats get_perf_stats(const PerfCategory category)
+{
+  const std::lock_guard lock(g_mutex);
+  return g_stats[int(category)];
+}
+
+void reset_perf_stats()
+{
+  const std::lock_guard lock(g_mutex);
+  std::fill(std::begin(g_stats), std::end(g_stats), PerfStats());
+}
+
+void start_perf_trace()
+{
+  const std::lock_guard lock(g_mutex);
+  g_events.clear();
+  g_firstEvent = 0;
+  g_traceStart = Clock::now();
+  g_recording = true;
+  update_enabled();
+}
+
+void stop_perf_trace()
+{
+  const std::lock_guard lock(g_mutex);
+  g_recording = false;
+  update_enabled();
+}
+
+bool is_perf_trace_recording()
+{
+  const std::lock_guard lock(g_mutex);
+  return g_recording;
+}
+
+bool save_perf_trace(const std::string& filename)
+{
+  std::vector<Event> events;
+  Clock::time_point traceStart;
+  {
+    const std::lock_guard lock(g_mutex);
+    events.reserve(g_events.size());
+    events.insert(events.end(), g_events.begin() + g_firstEvent, g_events.end());
+    events.insert(events.end(), g_events.begin(), g_events.begin() + g_firstEvent);
+    traceStart = g_traceStart;
+  }
+
+  base::FileHandle handle(base::open_file(filename, "wb"));
+  FILE* f = handle.get();
+  if (!f)
+    return false;
+
+  using us = std::chrono::microseconds;
+  std::fprintf(f, "{\"traceEvents\":[\n");
+  for (std::size_t i=0; i<events.size(); ++i) {
+    const Event& ev = events[i];
+    // Complete events ("ph":"X") with timestamps in microseconds
+    std::fprintf(f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                    "\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%d}%s\n",
+                 ev.name,
+                 perf_category_name(ev.category),
+                 (long long)std::chrono::duration_cast<us>(ev.start - traceStart).count(),
+                 (long long)std::chrono::duration_cast<us>(ev.dur).count(),
+                 ev.tid,
+                 (i+1 < events.size() ? ",": ""));
+  }
+  std::fprintf(f, "],\"displayTimeUnit\":\"ms\"}\n");
+  return (std::ferror(f) == 0);
+}
+
+void PerfScope::record()
+{
+  const Clock::time_point end = Clock::now();
+  const Clock::duration dur = end - m_start;
+  const double secs = std::chrono::duration<double>(dur).count();
+  const int tid = current_tid();
+
+  const std::lock_guard lock(g_mutex);
+  PerfStats& stats = g_stats[int(m_category)];
+  stats.last = secs;
+  stats.total += secs;
+  stats.max = std::max(stats.max, secs);
+  ++stats.count;
+
+  if (g_recording && m_start >= g_traceStart) {
+    const Event ev = { m_name, m_category, tid, m_start, dur };
+    if (g_events.size() < kMaxEvents)
+      g_events.push_back(ev);
+    else {
+      g_events[g_firstEvent] = ev;
+      g_firstEvent = (g_firstEvent+1) % kMaxEvents;
+    }
+  }
+}
+
+} // namespace app
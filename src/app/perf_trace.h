@@ -0,0 +1,97 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_PERF_TRACE_H_INCLUDED
+#define APP_PERF_TRACE_H_INCLUDED
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace app {
+
+  // Parts of the program measured with PerfScope.
+  enum class PerfCategory {
+    Render,     // Editor rendering (Editor::drawOneSpriteUnclippedRect)
+    Surface,    // Conversion of doc images to os::Surfaces
+    ToolLoop,   // ToolLoopManager steps
+    FileOp,     // Load/save of files (FileOp::operate)
+    Backup,     // Data recovery backups
+    Script,     // Script event handlers
+    Startup,    // Steps of App::initialize() and loading of modules
+    Count
+  };
+
+  const char* perf_category_name(const PerfCategory category);
+
+  // Time measured for one category (in seconds) since the last
+  // reset_perf_stats().
+  struct PerfStats {
+    double last = 0.0;
+    double total = 0.0;
+    double max = 0.0;
+    int count = 0;
+
+    double avg() const { return (count > 0 ? total / count: 0.0); }
+  };
+
+  // Enables/disables the measurement of the scopes to show the
+  // performance HUD (recording a trace enables the measurement too).
+  void set_perf_hud_enabled(const bool state);
+  bool is_perf_hud_enabled();
+
+  PerfStats get_perf_stats(const PerfCategory category);
+  void reset_perf_stats();
+
+  // Records each PerfScope as an event of a trace that can be saved
+  // in the Chrome Trace Event format (JSON), which can be opened with
+  // chrome://tracing or https://ui.perfetto.dev/
+  void start_perf_trace();
+  void stop_perf_trace();
+  bool is_perf_trace_recording();
+  bool save_perf_trace(const std::string& filename);
+
+  namespace details {
+    // True if the HUD or the recorder are enabled, so PerfScope
+    // doesn't do anything in the common case.
+    extern std::atomic<bool> g_perfEnabled;
+  }
+
+  // Measures the time of the current scope. The given name must be a
+  // string literal (or a string that lives until the trace is saved).
+  // It can be used from any thread.
+  class PerfScope {
+    using Clock = std::chrono::steady_clock;
+  public:
+    PerfScope(const PerfCategory category, const char* name)
+      : m_category(category)
+      , m_name(name)
+      , m_active(details::g_perfEnabled.load(std::memory_order_relaxed)) {
+      if (m_active)
+        m_start = Clock::now();
+    }
+
+    ~PerfScope() {
+      if (m_active)
+        record();
+    }
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+  private:
+    void record();
+
+    PerfCategory m_category;
+    const char* m_name;
+    bool m_active;
+    Clock::time_point m_start;
+  };
+
+} // namespace app
+
+#endif
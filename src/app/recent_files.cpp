@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2020  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -11,13 +11,19 @@
 
 #include "app/recent_files.h"
 
+#include "app/app.h"
 #include "app/ini_file.h"
 #include "base/fs.h"
 #include "fmt/format.h"
+#include "ui/system.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <set>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace {
 
@@ -41,18 +47,34 @@ struct compare_path {
   }
 };
 
+bool path_exists(const int collection, const std::string& fn)
+{
+  return (collection == kPinnedFiles ||
+          collection == kRecentFiles ? base::is_file(fn):
+                                       base::is_directory(fn));
+}
+
 }
 
 namespace app {
 
 RecentFiles::RecentFiles(const int limit)
   : m_limit(limit)
+  , m_alive(std::make_shared<RecentFiles*>(this))
 {
   load();
+
+  // Without UI the functions sent to the UI thread are never called
+  // (e.g. in batch mode), so we have to check the paths right now.
+  if (App::instance() && App::instance()->isGui())
+    checkPathsInBackground();
+  else
+    checkPaths();
 }
 
 RecentFiles::~RecentFiles()
 {
+  m_alive.reset();
   save();
 }
 
@@ -76,6 +98,11 @@ void RecentFiles::addRecentFile(const std::string& filename)
     addItem(m_paths[kRecentFolders], path);
   }
 
+  if (m_checkingPaths) {
+    m_addedPaths.insert(fn);
+    m_addedPaths.insert(path);
+  }
+
   Changed();
 }
 
@@ -195,10 +222,11 @@ void RecentFiles::load()
         continue;
       }
 
+      // The existence of each path is checked later in
+      // checkPathsInBackground() (paths in network drives can block
+      // the startup for several seconds) or checkPaths().
       const char* fn = get_config_string(section, key.c_str(), nullptr);
-      if (fn && *fn &&
-          ((i < 2 && base::is_file(fn)) ||
-           (i >= 2 && base::is_directory(fn)))) {
+      if (fn && *fn) {
         std::string normalFn = normalizePath(fn);
         m_paths[i].push_back(normalFn);
       }
@@ -236,4 +264,79 @@ void RecentFiles::save()
   }
 }
 
+void RecentFiles::checkPaths()
+{
+  for (int i=0; i<kCollections; ++i) {
+    auto& list = m_paths[i];
+    list.erase(std::remove_if(list.begin(), list.end(),
+                              [i](const std::string& fn){
+                                return !path_exists(i, fn);
+                              }),
+               list.end());
+  }
+}
+
+void RecentFiles::checkPathsInBackground()
+{
+  std::vector<std::pair<int, std::string>> paths;
+  for (int i=0; i<kCollections; ++i) {
+    for (const auto& fn : m_paths[i])
+      paths.emplace_back(i, fn);
+  }
+  if (paths.empty())
+    return;
+
+  m_checkingPaths = true;
+
+  // The thread is detached because base::is_file() can block for a
+  // long time (e.g. a disconnected network drive), and we don't want
+  // to wait it when the program is closed. The thread doesn't have a
+  // pointer to "this", it sends the results to the UI thread where
+  // the RecentFiles instance is taken from "alive" (if it wasn't
+  // destroyed yet). Paths that don't answer are kept in the list (and
+  // they are checked again when they are clicked).
+  std::thread(
+    [paths = std::move(paths),
+     alive = std::weak_ptr<RecentFiles*>(m_alive)]{
+      for (const auto& item : paths) {
+        if (alive.expired())
+          return;
+
+        const int collection = item.first;
+        const std::string& fn = item.second;
+        if (!path_exists(collection, fn) && !alive.expired()) {
+          ui::execute_from_ui_thread([alive, collection, fn]{
+            if (auto self = alive.lock())
+              (*self)->onPathNotFound(collection, fn);
+          });
+        }
+      }
+
+      if (!alive.expired()) {
+        ui::execute_from_ui_thread([alive]{
+          if (auto self = alive.lock()) {
+            (*self)->m_checkingPaths = false;
+            (*self)->m_addedPaths.clear();
+          }
+        });
+      }
+    }).detach();
+}
+
+void RecentFiles::onPathNotFound(const int collection,
+                                 const std::string& path)
+{
+  // The path was added again (e.g. the file was saved) after we've
+  // started the check.
+  if (m_addedPaths.find(path) != m_addedPaths.end())
+    return;
+
+  auto& list = m_paths[collection];
+  auto it = std::find_if(list.begin(), list.end(), compare_path(path));
+  if (it != list.end()) {
+    list.erase(it);
+    Changed();
+  }
+}
+
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2019  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -12,6 +12,8 @@
 #include "base/paths.h"
 #include "obs/signal.h"
 
+#include <memory>
+#include <set>
 #include <string>
 
 namespace app {
@@ -50,9 +52,23 @@ namespace app {
     void removeItem(base::paths& list, const std::string& filename);
     void load();
     void save();
+    void checkPaths();
+    void checkPathsInBackground();
+    void onPathNotFound(const int collection, const std::string& path);
 
     base::paths m_paths[kCollections];
     int m_limit;
+
+    // True while the existence of the loaded paths is checked in a
+    // background thread. Paths added in the meantime are saved in
+    // m_addedPaths so they are not removed by a previous check.
+    bool m_checkingPaths = false;
+    std::set<std::string> m_addedPaths;
+
+    // Points to "this" while it's alive. The background thread keeps
+    // a weak_ptr to report paths that don't exist (from the UI thread)
+    // only if this instance wasn't destroyed yet.
+    std::shared_ptr<RecentFiles*> m_alive;
   };
 
 } // namespace app
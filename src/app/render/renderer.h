@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -10,6 +10,9 @@
 
 #include "render/render.h"
 
+#include <cstddef>
+#include <vector>
+
 namespace doc {
   class Image;
   class Sprite;
@@ -58,6 +61,8 @@ namespace app {
     virtual void setNewBlendMethod(const bool newBlend) = 0;
     virtual void setBgOptions(const render::BgOptions& bg) = 0;
     virtual void setProjection(const render::Projection& projection) = 0;
+    virtual void setMaxThreads(const int threads) = 0;
+    virtual void setBoxFilterScaleDown(const bool state) = 0;
 
     // ----------------------------------------------------------------------
     // Advance configuration (for preview/brushes purposes)
@@ -97,6 +102,22 @@ namespace app {
                              const int y,
                              const int opacity,
                              const doc::BlendMode blendMode) = 0;
+
+    // ----------------------------------------------------------------------
+    // Animation playback
+
+    // Renders the given frames in a background thread (if the
+    // renderer supports it) using the configuration of the next
+    // renderSprite() call for the given sprite, so they are ready
+    // when the animation reaches them. "maxMemory" is the maximum
+    // number of bytes to keep pre-rendered frames.
+    virtual void prerenderFrames(const doc::Sprite* sprite,
+                                 const std::vector<doc::frame_t>& frames,
+                                 const std::size_t maxMemory) { }
+
+    // Stops rendering frames in the background (waiting the current
+    // frame to finish) and releases the pre-rendered frames.
+    virtual void stopPrerender() { }
   };
 
 } // namespace app
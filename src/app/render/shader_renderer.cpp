@@ -18,8 +18,13 @@
 #include "os/skia/skia_surface.h"
 
 #include "include/core/SkCanvas.h"
+#include "include/core/SkImage.h"
 #include "include/effects/SkRuntimeEffect.h"
 
+#if SK_SUPPORT_GPU
+  #include "include/gpu/GrDirectContext.h"
+#endif
+
 namespace app {
 
 using namespace doc;
@@ -92,7 +97,10 @@ ShaderRenderer::ShaderRenderer()
   m_grayscaleEffect = make_shader(kGrayscaleShaderCode);
 }
 
-ShaderRenderer::~ShaderRenderer() = default;
+ShaderRenderer::~ShaderRenderer()
+{
+  clearTexturesCache();
+}
 
 void ShaderRenderer::setRefLayersVisiblity(const bool visible)
 {
@@ -119,6 +127,22 @@ void ShaderRenderer::setProjection(const render::Projection& projection)
   m_proj = projection;
 }
 
+void ShaderRenderer::setMaxThreads(const int threads)
+{
+  // Do nothing, the GPU does the compositing
+}
+
+void ShaderRenderer::setBoxFilterScaleDown(const bool state)
+{
+  // TODO impl
+}
+
+void ShaderRenderer::setTexturesCacheSize(const std::size_t size)
+{
+  m_texturesMaxSize = size;
+  shrinkTexturesCache(m_texturesMaxSize);
+}
+
 void ShaderRenderer::setSelectedLayer(const doc::Layer* layer)
 {
   // TODO impl
@@ -406,7 +430,9 @@ void ShaderRenderer::drawImage(SkCanvas* canvas,
                                const int opacity,
                                const doc::BlendMode blendMode)
 {
-  auto skImg = make_skimage_for_docimage(srcImage);
+  auto skImg = getSkImage(canvas, srcImage);
+  if (!skImg)
+    return;
 
   switch (srcImage->colorMode()) {
 
@@ -477,6 +503,78 @@ void ShaderRenderer::drawImage(SkCanvas* canvas,
   }
 }
 
+sk_sp<SkImage> ShaderRenderer::getSkImage(SkCanvas* canvas,
+                                          const doc::Image* srcImage)
+{
+  auto skImg = make_skimage_for_docimage(srcImage);
+
+#if SK_SUPPORT_GPU
+  // Raster images just wrap the doc::Image pixels, there is nothing
+  // to cache. The preview image is modified in-place without
+  // incrementing its version (e.g. while we paint with a tool), so it
+  // must be uploaded again on each frame.
+  GrRecordingContext* context = canvas->recordingContext();
+  GrDirectContext* dContext = GrAsDirectContext(context);
+  if (!skImg || !dContext ||
+      m_texturesMaxSize == 0 ||
+      srcImage == m_previewImage)
+    return skImg;
+
+  // Textures cannot be shared between different GPU contexts
+  if (m_texturesContext != context) {
+    clearTexturesCache();
+    m_texturesContext = context;
+  }
+
+  const doc::ObjectId imageId = srcImage->id();
+  auto it = m_texturesMap.find(imageId);
+  if (it != m_texturesMap.end()) {
+    Texture& texture = *it->second;
+    if (texture.version == srcImage->version()) {
+      // Move to the front, it's the most recently used texture now
+      m_textures.splice(m_textures.begin(), m_textures, it->second);
+      return texture.skImage;
+    }
+    m_texturesSize -= texture.size;
+    m_textures.erase(it->second);
+    m_texturesMap.erase(it);
+  }
+
+  sk_sp<SkImage> skTex = skImg->makeTextureImage(dContext);
+  if (!skTex)
+    return skImg;
+
+  const std::size_t size = srcImage->rowBytes() * srcImage->height();
+  if (size <= m_texturesMaxSize) {
+    shrinkTexturesCache(m_texturesMaxSize - size);
+    m_textures.push_front(Texture{ imageId, srcImage->version(), skTex, size });
+    m_texturesMap[imageId] = m_textures.begin();
+    m_texturesSize += size;
+  }
+  return skTex;
+#else
+  return skImg;
+#endif
+}
+
+void ShaderRenderer::shrinkTexturesCache(const std::size_t maxSize)
+{
+  while (!m_textures.empty() && m_texturesSize > maxSize) {
+    const Texture& texture = m_textures.back();
+    m_texturesSize -= texture.size;
+    m_texturesMap.erase(texture.imageId);
+    m_textures.pop_back();
+  }
+}
+
+void ShaderRenderer::clearTexturesCache()
+{
+  m_textures.clear();
+  m_texturesMap.clear();
+  m_texturesSize = 0;
+  m_texturesContext = nullptr;
+}
+
 // TODO this is equal to Render::checkIfWeShouldUsePreview(const Cel*),
 //      we might think in a way to merge both functions
 bool ShaderRenderer::checkIfWeShouldUsePreview(const doc::Cel* cel) const
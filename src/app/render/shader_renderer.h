@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -11,11 +11,19 @@
 #if SK_ENABLE_SKSL
 
 #include "app/render/renderer.h"
+#include "doc/object_id.h"
+#include "doc/object_version.h"
 #include "doc/palette.h"
 
 #include "include/core/SkRefCnt.h"
 
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+
+class GrRecordingContext;
 class SkCanvas;
+class SkImage;
 class SkRuntimeEffect;
 
 namespace doc {
@@ -41,6 +49,12 @@ namespace app {
     void setNewBlendMethod(const bool newBlend) override;
     void setBgOptions(const render::BgOptions& bg) override;
     void setProjection(const render::Projection& projection) override;
+    void setMaxThreads(const int threads) override;
+    void setBoxFilterScaleDown(const bool state) override;
+
+    // Maximum number of bytes used by GPU textures of unmodified
+    // images that are kept between frames (0 = disable the cache).
+    void setTexturesCacheSize(const std::size_t size);
 
     void setSelectedLayer(const doc::Layer* layer) override;
     void setPreviewImage(const doc::Layer* layer,
@@ -88,6 +102,11 @@ namespace app {
                    const int opacity,
                    const doc::BlendMode blendMode);
 
+    sk_sp<SkImage> getSkImage(SkCanvas* canvas,
+                              const doc::Image* srcImage);
+    void shrinkTexturesCache(const std::size_t maxSize);
+    void clearTexturesCache();
+
     bool checkIfWeShouldUsePreview(const doc::Cel* cel) const;
     void afterBackgroundLayerIsPainted();
 
@@ -111,6 +130,22 @@ namespace app {
     // Palette of 256 colors (useful for the indexed shader to set all
     // colors outside the valid range as transparent RGBA=0 values)
     doc::Palette m_palette;
+
+    // Textures uploaded to the GPU for each doc::Image, they are
+    // re-uploaded only when the image version changes. The list is
+    // sorted from the most recently used texture to the least one.
+    struct Texture {
+      doc::ObjectId imageId;
+      doc::ObjectVersion version;
+      sk_sp<SkImage> skImage;
+      std::size_t size;
+    };
+    using Textures = std::list<Texture>;
+    Textures m_textures;
+    std::unordered_map<doc::ObjectId, Textures::iterator> m_texturesMap;
+    std::size_t m_texturesSize = 0;
+    std::size_t m_texturesMaxSize = 256*1024*1024;
+    GrRecordingContext* m_texturesContext = nullptr;
   };
 
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -10,16 +10,40 @@
 
 #include "app/render/simple_renderer.h"
 
-#include "app/ui/editor/editor_render.h"
+#include "app/doc.h"
+#include "app/doc_access.h"
 #include "app/util/conversion_to_surface.h"
 
+#include <algorithm>
+
 namespace app {
 
 using namespace doc;
 
+// Number of cached images when the animation is not being played
+// (the sprite and the bottom layers of the active layer)
+static constexpr int kDefaultCacheEntries = 2;
+
 SimpleRenderer::SimpleRenderer()
+  : m_cache(kDefaultCacheEntries)
+  , m_renderBuffer(std::make_shared<doc::ImageBuffer>())
 {
   m_properties.outputsUnpremultiplied = true;
+  m_render.setCache(&m_cache);
+  m_render.setMipmapCache(&m_mipmaps);
+}
+
+SimpleRenderer::~SimpleRenderer()
+{
+  if (m_prerenderThread.joinable()) {
+    {
+      const std::lock_guard lock(m_prerenderMutex);
+      m_prerenderExit = true;
+      m_prerenderCancel = true;
+    }
+    m_prerenderCV.notify_all();
+    m_prerenderThread.join();
+  }
 }
 
 void SimpleRenderer::setRefLayersVisiblity(const bool visible)
@@ -44,9 +68,20 @@ void SimpleRenderer::setBgOptions(const render::BgOptions& bg)
 
 void SimpleRenderer::setProjection(const render::Projection& projection)
 {
+  m_proj = projection;
   m_render.setProjection(projection);
 }
 
+void SimpleRenderer::setMaxThreads(const int threads)
+{
+  m_render.setMaxThreads(threads);
+}
+
+void SimpleRenderer::setBoxFilterScaleDown(const bool state)
+{
+  m_render.setBoxFilterScaleDown(state);
+}
+
 void SimpleRenderer::setSelectedLayer(const doc::Layer* layer)
 {
   m_render.setSelectedLayer(layer);
@@ -101,11 +136,20 @@ void SimpleRenderer::renderSprite(os::Surface* dstSurface,
 {
   ImageRef dstImage(Image::create(
                       IMAGE_RGB, area.size.w, area.size.h,
-                      EditorRender::getRenderImageBuffer()));
-  m_render.renderSprite(dstImage.get(), sprite, frame, area);
+                      m_renderBuffer));
+  m_render.renderSprite(dstImage.get(), sprite, frame,
+                        gfx::ClipF(0, 0, area.src.x, area.src.y,
+                                   area.size.w, area.size.h));
 
+  // The destination position is used to render only a part of the
+  // surface (e.g. by bands from EditorAsyncRender)
   convert_image_to_surface(dstImage.get(), sprite->palette(frame),
-                           dstSurface, 0, 0, 0, 0, area.size.w, area.size.h);
+                           dstSurface, 0, 0,
+                           int(area.dst.x), int(area.dst.y),
+                           area.size.w, area.size.h);
+
+  if (sprite == m_nextPrerenderSprite)
+    startPrerender(sprite);
 }
 
 void SimpleRenderer::renderCheckeredBackground(os::Surface* dstSurface,
@@ -114,7 +158,7 @@ void SimpleRenderer::renderCheckeredBackground(os::Surface* dstSurface,
 {
   ImageRef dstImage(Image::create(
                       IMAGE_RGB, area.size.w, area.size.h,
-                      EditorRender::getRenderImageBuffer()));
+                      m_renderBuffer));
 
   m_render.renderCheckeredBackground(dstImage.get(), area);
 
@@ -134,4 +178,112 @@ void SimpleRenderer::renderImage(doc::Image* dstImage,
                        x, y, opacity, blendMode);
 }
 
+void SimpleRenderer::prerenderFrames(const doc::Sprite* sprite,
+                                     const std::vector<doc::frame_t>& frames,
+                                     const std::size_t maxMemory)
+{
+  // Each cached frame is the whole projected sprite
+  const std::size_t pixels =
+    std::size_t(m_proj.applyX(sprite->width())) *
+    std::size_t(m_proj.applyY(sprite->height()));
+  if (pixels == 0 || pixels > std::size_t(m_cache.maxPixels()))
+    return;
+
+  const std::size_t maxFrames =
+    std::min(frames.size(), maxMemory / (pixels * 4));
+  if (maxFrames == 0)
+    return;
+
+  // Keep the frames that are being played (and the pre-rendered
+  // ones) in the cache
+  m_cache.setMaxEntries(
+    std::max(m_cache.maxEntries(), kDefaultCacheEntries + int(maxFrames)));
+
+  m_nextPrerenderSprite = sprite;
+  m_nextPrerenderFrames.assign(frames.begin(), frames.begin() + maxFrames);
+}
+
+void SimpleRenderer::stopPrerender()
+{
+  m_nextPrerenderSprite = nullptr;
+  m_nextPrerenderFrames.clear();
+
+  {
+    std::unique_lock lock(m_prerenderMutex);
+    m_prerenderJob.reset();
+    m_prerenderCancel = true;
+    // Wait the current frame, so the sprite can be deleted after this
+    m_prerenderCV.wait(lock, [this]{ return !m_prerenderBusy; });
+  }
+
+  m_cache.setMaxEntries(kDefaultCacheEntries);
+}
+
+void SimpleRenderer::startPrerender(const doc::Sprite* sprite)
+{
+  // The preview/extra images are removed from the copy in
+  // render::Render::prerenderSprite()
+  auto job = std::make_unique<PrerenderJob>(
+    PrerenderJob{ m_render, sprite, std::move(m_nextPrerenderFrames),
+                  sprite->structureVersion(),
+                  sprite->tags().version() });
+  m_nextPrerenderSprite = nullptr;
+  m_nextPrerenderFrames.clear();
+
+  {
+    const std::lock_guard lock(m_prerenderMutex);
+    // Replace the previous job (if it's still running it's cancelled)
+    m_prerenderJob = std::move(job);
+    m_prerenderCancel = true;
+  }
+  m_prerenderCV.notify_all();
+
+  if (!m_prerenderThread.joinable())
+    m_prerenderThread = std::thread([this]{ prerenderThread(); });
+}
+
+void SimpleRenderer::prerenderThread()
+{
+  std::unique_lock lock(m_prerenderMutex);
+  while (true) {
+    m_prerenderCV.wait(lock, [this]{
+      return m_prerenderJob || m_prerenderExit;
+    });
+    if (m_prerenderExit)
+      break;
+
+    std::unique_ptr<PrerenderJob> job = std::move(m_prerenderJob);
+    m_prerenderBusy = true;
+    m_prerenderCancel = false;
+    lock.unlock();
+
+    auto doc = static_cast<Doc*>(job->sprite->document());
+    for (const doc::frame_t frame : job->frames) {
+      if (m_prerenderCancel)
+        break;
+      try {
+        // Lock the document to read it (if it's being modified we
+        // stop pre-rendering, the frames will be rendered in the UI
+        // thread anyway)
+        const DocReader docReader(doc, 50);
+
+        // Layers/cels/frames/tags could be deleted between two
+        // frames, and the Render copy would use dangling pointers.
+        if (job->sprite->structureVersion() != job->structureVersion ||
+            job->sprite->tags().version() != job->tagsVersion)
+          break;
+
+        job->render.prerenderSprite(job->sprite, frame);
+      }
+      catch (const LockedDocException&) {
+        break;
+      }
+    }
+
+    lock.lock();
+    m_prerenderBusy = false;
+    m_prerenderCV.notify_all();
+  }
+}
+
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -9,6 +9,16 @@
 #pragma once
 
 #include "app/render/renderer.h"
+#include "doc/image_buffer.h"
+#include "render/mipmap_cache.h"
+#include "render/render_cache.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace app {
 
@@ -18,6 +28,7 @@ namespace app {
   class SimpleRenderer : public Renderer {
   public:
     SimpleRenderer();
+    ~SimpleRenderer();
 
     const Properties& properties() const override { return m_properties; }
 
@@ -26,6 +37,8 @@ namespace app {
     void setNewBlendMethod(const bool newBlend) override;
     void setBgOptions(const render::BgOptions& bg) override;
     void setProjection(const render::Projection& projection) override;
+    void setMaxThreads(const int threads) override;
+    void setBoxFilterScaleDown(const bool state) override;
 
     void setSelectedLayer(const doc::Layer* layer) override;
     void setPreviewImage(const doc::Layer* layer,
@@ -59,9 +72,49 @@ namespace app {
                      const int y,
                      const int opacity,
                      const doc::BlendMode blendMode) override;
+
+    void prerenderFrames(const doc::Sprite* sprite,
+                         const std::vector<doc::frame_t>& frames,
+                         const std::size_t maxMemory) override;
+    void stopPrerender() override;
+
   private:
+    // Frames to pre-render with a copy of m_render configured as in
+    // the last renderSprite() call. The copy has pointers to layers
+    // and tags of the sprite, so the job is cancelled if the sprite
+    // structure/tags change (see the versions) between two frames.
+    struct PrerenderJob {
+      render::Render render;
+      const doc::Sprite* sprite;
+      std::vector<doc::frame_t> frames;
+      uint32_t structureVersion;
+      int tagsVersion;
+    };
+
+    void startPrerender(const doc::Sprite* sprite);
+    void prerenderThread();
+
     Properties m_properties;
+    render::RenderCache m_cache;
+    render::MipmapCache m_mipmaps;
     render::Render m_render;
+    render::Projection m_proj;
+    // Each renderer has its own buffer as it can be used from a
+    // background thread (EditorAsyncRender)
+    doc::ImageBufferPtr m_renderBuffer;
+
+    // Frames requested with prerenderFrames() to be rendered after
+    // the next renderSprite()
+    const doc::Sprite* m_nextPrerenderSprite = nullptr;
+    std::vector<doc::frame_t> m_nextPrerenderFrames;
+
+    std::thread m_prerenderThread;
+    std::mutex m_prerenderMutex;
+    std::condition_variable m_prerenderCV;
+    std::unique_ptr<PrerenderJob> m_prerenderJob;
+    bool m_prerenderBusy = false;
+    bool m_prerenderExit = false;
+    std::atomic<bool> m_prerenderCancel = false;
   };
 
 } // namespace app
@@ -0,0 +1,208 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/render/shader_renderer.h"
+#include "app/render/simple_renderer.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/palette.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+#include "os/surface.h"
+#include "os/system.h"
+#include "render/bg_options.h"
+#include "render/projection.h"
+#include "render/zoom.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+using namespace app;
+using namespace doc;
+
+namespace {
+
+enum class RendererType { Simple, Shader };
+
+enum class DocShape {
+  Layers,      // Many semi-transparent RGB layers
+  Indexed,     // Indexed sprite with a 256 colors palette
+  Groups,      // Groups of layers with different blend modes
+};
+
+const char* doc_shape_name(const DocShape shape)
+{
+  switch (shape) {
+    case DocShape::Layers: return "layers";
+    case DocShape::Indexed: return "indexed";
+    case DocShape::Groups: return "groups";
+  }
+  return "";
+}
+
+void add_layer(LayerGroup* parent, Sprite* spr, const int seed,
+               const BlendMode blendMode = BlendMode::NORMAL)
+{
+  const bool indexed = (spr->pixelFormat() == IMAGE_INDEXED);
+  const int w = spr->width();
+  const int h = spr->height();
+
+  ImageRef img(Image::create(spr->pixelFormat(), w, h));
+  clear_image(img.get(), 0);
+  for (int i=0; i<4; ++i) {
+    const int k = seed*4 + i;
+    const int x = (k * 37) % (w/2);
+    const int y = (k * 53) % (h/2);
+    const color_t c =
+      (indexed ? color_t(1 + (k * 29) % 255):
+                 rgba((k * 71) & 255,
+                      (k * 113) & 255,
+                      (k * 157) & 255,
+                      (i == 0 ? 255: 64 + (k * 31) % 192)));
+    fill_rect(img.get(), x, y, x + w/2, y + h/2, c);
+  }
+
+  auto lay = new LayerImage(spr);
+  lay->setBlendMode(blendMode);
+  parent->addLayer(lay);
+  lay->addCel(new Cel(0, img));
+}
+
+std::unique_ptr<Sprite> make_doc_shape(const DocShape shape,
+                                       const int w, const int h)
+{
+  const ColorMode colorMode =
+    (shape == DocShape::Indexed ? ColorMode::INDEXED: ColorMode::RGB);
+  std::unique_ptr<Sprite> spr(new Sprite(ImageSpec(colorMode, w, h), 256));
+  LayerGroup* root = spr->root();
+
+  switch (shape) {
+
+    case DocShape::Layers:
+      for (int i=0; i<16; ++i)
+        add_layer(root, spr.get(), i);
+      break;
+
+    case DocShape::Indexed: {
+      Palette pal(0, 256);
+      for (int i=0; i<256; ++i)
+        pal.setEntry(i, rgba(i, 255-i, (i*7) & 255, 255));
+      spr->setPalette(&pal, true);
+      spr->setTransparentColor(0);
+
+      for (int i=0; i<8; ++i)
+        add_layer(root, spr.get(), i);
+      break;
+    }
+
+    case DocShape::Groups: {
+      const BlendMode modes[] = {
+        BlendMode::MULTIPLY, BlendMode::SCREEN,
+        BlendMode::OVERLAY, BlendMode::DIFFERENCE
+      };
+      for (int g=0; g<4; ++g) {
+        auto group = new LayerGroup(spr.get());
+        root->addLayer(group);
+        for (int i=0; i<4; ++i)
+          add_layer(group, spr.get(), g*4+i, modes[(g+i) % 4]);
+      }
+      break;
+    }
+  }
+
+  return spr;
+}
+
+std::unique_ptr<Renderer> make_renderer(const RendererType type)
+{
+#if SK_ENABLE_SKSL && ENABLE_DEVMODE
+  if (type == RendererType::Shader)
+    return std::make_unique<ShaderRenderer>();
+#endif
+  if (type == RendererType::Simple)
+    return std::make_unique<SimpleRenderer>();
+  return nullptr;
+}
+
+} // anonymous namespace
+
+// Renders a 512x512 viewport of a 512x512 sprite with the given
+// renderer, shape, and zoom level. Reports the number of rendered
+// pixels per second as the throughput of the configuration.
+void BM_Renderer(benchmark::State& state)
+{
+  const RendererType type = RendererType(state.range(0));
+  const DocShape shape = DocShape(state.range(1));
+  const render::Zoom zoom(state.range(2), state.range(3));
+  const int w = 512;
+  const int h = 512;
+
+  std::unique_ptr<Renderer> renderer = make_renderer(type);
+  if (!renderer) {
+    state.SkipWithError("Renderer not available in this build");
+    return;
+  }
+
+  std::unique_ptr<Sprite> spr = make_doc_shape(shape, w, h);
+
+  const int dstW = std::clamp(zoom.apply(w), 1, 512);
+  const int dstH = std::clamp(zoom.apply(h), 1, 512);
+  const int scrollX = std::max(0, (zoom.apply(w) - dstW) / 2);
+  const int scrollY = std::max(0, (zoom.apply(h) - dstH) / 2);
+  os::SurfaceRef dst = os::instance()->makeRgbaSurface(dstW, dstH);
+
+  render::BgOptions bg;
+  bg.type = render::BgType::CHECKERED;
+  bg.zoom = true;
+  bg.color1 = rgba(100, 100, 100, 255);
+  bg.color2 = rgba(200, 200, 200, 255);
+  bg.stripeSize = gfx::Size(16, 16);
+  renderer->setBgOptions(bg);
+  renderer->setNewBlendMethod(true);
+  renderer->setProjection(render::Projection(PixelRatio(1, 1), zoom));
+
+  while (state.KeepRunning()) {
+    renderer->renderSprite(
+      dst.get(), spr.get(), frame_t(0),
+      gfx::Clip(0, 0, scrollX, scrollY, dstW, dstH));
+  }
+
+  state.SetLabel(std::string(type == RendererType::Simple ? "simple/": "shader/") +
+                 doc_shape_name(shape));
+  state.SetItemsProcessed(int64_t(state.iterations()) * dstW * dstH);
+}
+
+void renderer_args(benchmark::internal::Benchmark* b)
+{
+  const int zooms[][2] = {
+    { 1, 8 }, { 1, 4 }, { 1, 2 }, { 1, 1 },
+    { 2, 1 }, { 4, 1 }, { 8, 1 }, { 16, 1 }, { 32, 1 }
+  };
+  for (int type=int(RendererType::Simple); type<=int(RendererType::Shader); ++type)
+    for (int shape=int(DocShape::Layers); shape<=int(DocShape::Groups); ++shape)
+      for (const auto& z : zooms)
+        b->Args({ type, shape, z[0], z[1] });
+}
+
+BENCHMARK(BM_Renderer)
+  ->Apply(renderer_args)
+  ->Unit(benchmark::kMicrosecond);
+
+int app_main(int argc, char* argv[])
+{
+  os::SystemRef system(os::make_system());
+
+  ::benchmark::Initialize(&argc, argv);
+  return ::benchmark::RunSpecifiedBenchmarks();
+}
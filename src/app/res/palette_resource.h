@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -24,10 +24,10 @@ namespace app {
   public:
     PaletteResource(const std::string& id,
                     const std::string& path,
-                    std::unique_ptr<doc::Palette>&& palette)
+                    const std::shared_ptr<const doc::Palette>& palette)
       : m_id(id)
       , m_path(path)
-      , m_palette(std::move(palette)) {
+      , m_palette(palette) {
     }
     virtual ~PaletteResource() { }
     virtual const std::string& id() const override { return m_id; }
@@ -37,7 +37,8 @@ namespace app {
   private:
     std::string m_id;
     std::string m_path;
-    std::unique_ptr<doc::Palette> m_palette;
+    // Shared with the cache of loaded palettes
+    std::shared_ptr<const doc::Palette> m_palette;
   };
 
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -19,11 +19,69 @@
 #include "app/resource_finder.h"
 #include "base/fs.h"
 #include "base/scoped_value.h"
+#include "base/time.h"
 #include "doc/palette.h"
 #include "ui/system.h"
 
+#include <map>
+#include <memory>
+#include <mutex>
+
 namespace app {
 
+namespace {
+
+// Palettes loaded from files are kept in memory while their files
+// don't change, so the palettes popup doesn't need to parse all the
+// palettes each time the list is reloaded (e.g. when an extension is
+// installed, or a preset is saved).
+class PaletteCache {
+public:
+  std::shared_ptr<const doc::Palette> get(const std::string& path) {
+    const Key key = keyFor(path);
+    const std::lock_guard lock(m_mutex);
+    auto it = m_palettes.find(path);
+    if (it != m_palettes.end() && it->second.key == key)
+      return it->second.palette;
+    return nullptr;
+  }
+
+  void add(const std::string& path,
+           const std::shared_ptr<const doc::Palette>& palette) {
+    const Key key = keyFor(path);
+    const std::lock_guard lock(m_mutex);
+    m_palettes[path] = Entry{ key, palette };
+  }
+
+private:
+  struct Key {
+    base::Time time;
+    std::size_t size = 0;
+    bool operator==(const Key& other) const {
+      return time == other.time && size == other.size;
+    }
+  };
+
+  struct Entry {
+    Key key;
+    std::shared_ptr<const doc::Palette> palette;
+  };
+
+  static Key keyFor(const std::string& path) {
+    Key key;
+    key.time = base::get_modification_time(path);
+    key.size = base::file_size(path);
+    return key;
+  }
+
+  std::mutex m_mutex;
+  std::map<std::string, Entry> m_palettes;
+};
+
+PaletteCache g_cache;
+
+} // anonymous namespace
+
 PalettesLoaderDelegate::PalettesLoaderDelegate()
 {
   // Necessary to load preferences in the UI-thread which will be used
@@ -63,11 +121,15 @@ void PalettesLoaderDelegate::getResourcesPaths(std::map<std::string, std::string
 Resource* PalettesLoaderDelegate::loadResource(const std::string& id,
                                                const std::string& path)
 {
-  auto palette = load_palette(path.c_str(), &m_config);
-  if (palette)
-    return new PaletteResource(id, path, std::move(palette));
-  else
-    return nullptr;
+  std::shared_ptr<const doc::Palette> palette = g_cache.get(path);
+  if (!palette) {
+    palette = load_palette(path.c_str(), &m_config);
+    if (!palette)
+      return nullptr;
+
+    g_cache.add(path, palette);
+  }
+  return new PaletteResource(id, path, palette);
 }
 
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2023  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -16,7 +16,6 @@
 #include "app/res/resources_loader_delegate.h"
 #include "app/resource_finder.h"
 #include "base/fs.h"
-#include "base/scoped_value.h"
 
 namespace app {
 
@@ -52,18 +51,25 @@ bool ResourcesLoader::next(std::unique_ptr<Resource>& resource)
 
 void ResourcesLoader::reload()
 {
+  // Stop the current loading as all resources will be loaded again
   if (m_thread) {
+    m_cancel = true;
     m_thread->join();
     m_thread.reset(nullptr);
+    m_cancel = false;
   }
 
+  // Discard the resources of the previous loading
+  Resource* rawResource;
+  while (m_queue.try_pop(rawResource))
+    delete rawResource;
+
+  m_done = false;
   m_thread.reset(createThread());
 }
 
 void ResourcesLoader::threadLoadResources()
 {
-  base::ScopedValue scoped(m_done, false, true);
-
   // Load resources from extensions
   std::map<std::string, std::string> idAndPaths;
   m_delegate->getResourcesPaths(idAndPaths);
@@ -81,6 +87,8 @@ void ResourcesLoader::threadLoadResources()
     if (resource)
       m_queue.push(resource);
   }
+
+  m_done = true;
 }
 
 std::thread* ResourcesLoader::createThread()
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,7 @@
 
 #include "base/concurrent_queue.h"
 
+#include <atomic>
 #include <memory>
 #include <thread>
 
@@ -36,8 +37,8 @@ namespace app {
     typedef base::concurrent_queue<Resource*> Queue;
 
     std::unique_ptr<ResourcesLoaderDelegate> m_delegate;
-    bool m_done;
-    bool m_cancel;
+    std::atomic<bool> m_done;
+    std::atomic<bool> m_cancel;
     Queue m_queue;
     std::unique_ptr<std::thread> m_thread;
   };
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2015-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -132,7 +132,23 @@ int App_exit(lua_State* L)
   return 0;
 }
 
-int App_transaction(lua_State* L)
+// Batch of notifications for the whole app.batch() call (it's
+// ended even if the function fails).
+class ScopedBatchNotifications {
+public:
+  ScopedBatchNotifications(Doc* doc) : m_doc(doc) {
+    if (m_doc)
+      m_doc->beginBatchNotifications();
+  }
+  ~ScopedBatchNotifications() {
+    if (m_doc)
+      m_doc->endBatchNotifications();
+  }
+private:
+  Doc* m_doc;
+};
+
+int run_transaction(lua_State* L, const bool batch)
 {
   int top = lua_gettop(L);
   int nresults = 0;
@@ -157,27 +173,48 @@ int App_transaction(lua_State* L)
     if (!ctx)
       return luaL_error(L, "no context");
 
+    bool failed = false;
     try {
       // We lock the document in the whole transaction because the
       // RWLock now is re-entrant and we are able to call commands
       // inside the app.transaction() (creating inner ContextWriters).
       ContextWriter writer(ctx);
       Tx tx(writer, label);
+      ScopedBatchNotifications batchNotifications(batch ? writer.document(): nullptr);
 
       lua_pushvalue(L, -1);
       if (lua_pcall(L, 0, LUA_MULTRET, 0) == LUA_OK)
         tx.commit();
       else
-        return lua_error(L); // pcall already put an error object on the stack
+        failed = true;
       nresults = lua_gettop(L) - top;
     }
     catch (const LockedDocException& ex) {
       return luaL_error(L, "cannot lock document for transaction\n%s", ex.what());
     }
+    // Raise the error outside the scope of the batch/transaction (so
+    // they are destroyed/rolled back before the longjmp)
+    if (failed)
+      return lua_error(L); // pcall already put an error object on the stack
   }
   return nresults;
 }
 
+int App_transaction(lua_State* L)
+{
+  return run_transaction(L, false);
+}
+
+// Like app.transaction() but the notifications to redraw the sprite
+// (e.g. Cel.position, Layer.opacity, modified pixels) are coalesced
+// into a single update when the function ends. This is useful to
+// modify thousands of cels/layers without refreshing the UI on each
+// change.
+int App_batch(lua_State* L)
+{
+  return run_transaction(L, true);
+}
+
 int App_undo(lua_State* L)
 {
   app::Context* ctx = App::instance()->context();
@@ -805,6 +842,7 @@ const luaL_Reg App_methods[] = {
   { "open",        App_open },
   { "exit",        App_exit },
   { "transaction", App_transaction },
+  { "batch",       App_batch },
   { "undo",        App_undo },
   { "redo",        App_redo },
   { "alert",       App_alert },
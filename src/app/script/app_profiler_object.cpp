@@ -0,0 +1,81 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/script/engine.h"
+#include "app/script/luacpp.h"
+#include "app/script/profiler.h"
+#include "app/script/security.h"
+
+namespace app {
+namespace script {
+
+namespace {
+
+struct AppProfiler { };
+
+// app.profiler.start([sampleInterval]) where sampleInterval is the
+// number of Lua instructions between each sample
+int AppProfiler_start(lua_State* L)
+{
+  const int sampleInterval = int(luaL_optinteger(L, 1, 1000));
+  if (!Profiler::start(L, sampleInterval))
+    return luaL_error(L, "cannot start the profiler while the debugger is running");
+  return 0;
+}
+
+// app.profiler.stop([filename]) returns the report as a string, and
+// saves the sampled stacks (for a flame graph) in the given file
+int AppProfiler_stop(lua_State* L)
+{
+  std::string filename;
+  if (const char* fn = lua_tostring(L, 1)) {
+    if (!ask_access(L, fn, FileAccessMode::Write, ResourceType::File))
+      return luaL_error(L, "the script doesn't have access to create file '%s'", fn);
+    filename = fn;
+  }
+  lua_pushstring(L, Profiler::stop(L, filename).c_str());
+  return 1;
+}
+
+int AppProfiler_get_isRunning(lua_State* L)
+{
+  lua_pushboolean(L, Profiler::isRunning());
+  return 1;
+}
+
+const luaL_Reg AppProfiler_methods[] = {
+  { "start", AppProfiler_start },
+  { "stop", AppProfiler_stop },
+  { nullptr, nullptr }
+};
+
+const Property AppProfiler_properties[] = {
+  { "isRunning", AppProfiler_get_isRunning, nullptr },
+  { nullptr, nullptr, nullptr }
+};
+
+} // anonymous namespace
+
+DEF_MTNAME(AppProfiler);
+
+void register_app_profiler_object(lua_State* L)
+{
+  REG_CLASS(L, AppProfiler);
+  REG_CLASS_PROPERTIES(L, AppProfiler);
+
+  lua_getglobal(L, "app");
+  lua_pushstring(L, "profiler");
+  push_new<AppProfiler>(L);
+  lua_rawset(L, -3);
+  lua_pop(L, 1);
+}
+
+} // namespace script
+} // namespace app
@@ -0,0 +1,137 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/script/bytecode_cache.h"
+
+#include "app/resource_finder.h"
+#include "app/script/luacpp.h"
+#include "base/fs.h"
+#include "base/fstream_path.h"
+#include "base/log.h"
+#include "fmt/format.h"
+
+#include <city.h>
+
+#include <fstream>
+#include <sstream>
+
+namespace app {
+namespace script {
+
+namespace {
+
+// The header of each cached file is the magic, the Lua version, and
+// the hash of the source code.
+const char* kMagic = "AsepriteLuaCache";
+
+std::string cache_dir()
+{
+  static std::string dir;
+  if (dir.empty()) {
+    ResourceFinder rf(false);
+    rf.includeUserDir("luacache/.");
+    dir = base::get_file_path(rf.defaultFilename());
+  }
+  return dir;
+}
+
+std::string cache_header(const std::string& code)
+{
+  return fmt::format("{}\n{}\n{:016x}\n",
+                     kMagic,
+                     LUA_VERSION_RELEASE,
+                     CityHash64(code.c_str(), code.size()));
+}
+
+int dump_writer(lua_State* L, const void* p, size_t sz, void* ud)
+{
+  static_cast<std::string*>(ud)->append((const char*)p, sz);
+  return 0;
+}
+
+} // anonymous namespace
+
+int load_buffer_with_cache(lua_State* L,
+                           const std::string& code,
+                           const std::string& chunkname)
+{
+  // The cache is indexed by the chunk name (the script filename),
+  // and the header is used to check that the source code didn't
+  // change.
+  const std::string fn =
+    base::join_path(cache_dir(),
+                    fmt::format("{:016x}.luac",
+                                CityHash64(chunkname.c_str(), chunkname.size())));
+  const std::string header = cache_header(code);
+
+  if (base::is_file(fn)) {
+    std::ifstream f(FSTREAM_PATH(fn), std::ifstream::binary);
+    std::stringstream buf;
+    buf << f.rdbuf();
+    const std::string data = buf.str();
+
+    if (data.size() > header.size() &&
+        data.compare(0, header.size(), header) == 0) {
+      if (luaL_loadbufferx(L,
+                           data.c_str() + header.size(),
+                           data.size() - header.size(),
+                           chunkname.c_str(), "b") == LUA_OK) {
+        return LUA_OK;
+      }
+      // Invalid cache, pop the error message
+      lua_pop(L, 1);
+    }
+  }
+
+  const int status = luaL_loadbuffer(L, code.c_str(), code.size(), chunkname.c_str());
+  if (status != LUA_OK)
+    return status;
+
+  // Save the compiled chunk (with debug information to get the
+  // right line numbers in error messages)
+  std::string data = header;
+  if (lua_dump(L, dump_writer, &data, 0) == 0) {
+    try {
+      base::make_all_directories(cache_dir());
+      std::ofstream f(FSTREAM_PATH(fn), std::ofstream::binary);
+      f.write(data.c_str(), data.size());
+    }
+    catch (const std::exception& ex) {
+      LOG(ERROR, "SCRIPT: Cannot save bytecode cache %s: %s\n", fn.c_str(), ex.what());
+    }
+  }
+  return LUA_OK;
+}
+
+int load_file_with_cache(lua_State* L,
+                         const std::string& filename)
+{
+  std::stringstream buf;
+  {
+    std::ifstream s(FSTREAM_PATH(filename), std::ifstream::binary);
+    if (!s) {
+      lua_pushstring(L, fmt::format("cannot open {}", filename).c_str());
+      return LUA_ERRFILE;
+    }
+    buf << s.rdbuf();
+  }
+  std::string code = buf.str();
+
+  // Skip the first line if it's a shebang/comment (like
+  // luaL_loadfile() does), but keep the new line character to
+  // report the right line numbers.
+  if (!code.empty() && code[0] == '#')
+    code.erase(0, code.find('\n'));
+
+  return load_buffer_with_cache(L, code, "@" + filename);
+}
+
+} // namespace script
+} // namespace app
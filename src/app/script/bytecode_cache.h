@@ -0,0 +1,39 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_SCRIPT_BYTECODE_CACHE_H_INCLUDED
+#define APP_SCRIPT_BYTECODE_CACHE_H_INCLUDED
+#pragma once
+
+#ifndef ENABLE_SCRIPTING
+  #error ENABLE_SCRIPTING must be defined
+#endif
+
+#include <string>
+
+struct lua_State;
+
+namespace app {
+namespace script {
+
+  // Like luaL_loadbuffer() but uses the compiled bytecode of the
+  // chunk saved in the user config folder (luacache/) if it was
+  // compiled from the same source code with the same Lua version. In
+  // other case the code is compiled and the bytecode is saved for the
+  // next time. Returns the luaL_loadbuffer() result (the chunk or the
+  // error message are pushed on the stack).
+  int load_buffer_with_cache(lua_State* L,
+                             const std::string& code,
+                             const std::string& chunkname);
+
+  // Like luaL_loadfile() using load_buffer_with_cache()
+  int load_file_with_cache(lua_State* L,
+                           const std::string& filename);
+
+} // namespace script
+} // namespace app
+
+#endif
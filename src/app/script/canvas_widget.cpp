@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (c) 2022-2023  Igara Studio S.A.
+// Copyright (c) 2022-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -42,14 +42,23 @@ Canvas::Canvas() : ui::Widget(Type())
 {
 }
 
-void Canvas::callPaint()
+void Canvas::callPaint(const gfx::Rect& area)
 {
   if (!m_surface)
     return;
 
+  const gfx::Rect rc = (area.isEmpty() ? m_surface->bounds():
+                                         area & m_surface->bounds());
+  if (rc.isEmpty())
+    return;
+
+  // Keep the cached pixels outside the area
+  m_surface->save();
+  m_surface->clipRect(rc);
+
   os::Paint p;
   p.color(bgColor());
-  m_surface->drawRect(m_surface->bounds(), p);
+  m_surface->drawRect(rc, p);
 
   // Draw only on resize (onPaint we draw the cached m_surface)
   GraphicsContext gc(m_surface, m_autoScaling ? ui::guiscale() : 1);
@@ -60,7 +69,27 @@ void Canvas::callPaint()
   else
     gc.font(AddRef(font()));
 
-  Paint(gc);
+  Paint(gc, rc);
+  m_surface->restore();
+}
+
+void Canvas::requestRepaint(const gfx::Rect& area)
+{
+  if (!m_surface)
+    return;
+
+  const gfx::Rect rc = (area.isEmpty() ? m_surface->bounds():
+                                         area & m_surface->bounds());
+  if (rc.isEmpty())
+    return;
+
+  m_dirtyBounds |= rc;
+
+  // Invalidate the area in screen coordinates
+  gfx::Rect screenRc = rc;
+  if (m_autoScaling)
+    screenRc *= ui::guiscale();
+  invalidateRect(screenRc.offset(bounds().origin()));
 }
 
 void Canvas::onInitTheme(ui::InitThemeEvent& ev)
@@ -196,6 +225,7 @@ void Canvas::onResize(ui::ResizeEvent& ev)
         m_surface->width() != w ||
         m_surface->height() != h) {
       m_surface = os::instance()->makeSurface(w, h);
+      m_dirtyBounds = gfx::Rect();
       callPaint();
     }
   }
@@ -205,6 +235,13 @@ void Canvas::onResize(ui::ResizeEvent& ev)
 
 void Canvas::onPaint(ui::PaintEvent& ev)
 {
+  // Paint all the coalesced repaint requests
+  if (!m_dirtyBounds.isEmpty()) {
+    const gfx::Rect dirty = m_dirtyBounds;
+    m_dirtyBounds = gfx::Rect();
+    callPaint(dirty);
+  }
+
   auto g = ev.graphics();
   gfx::Rect rc = clientBounds();
   if (m_surface) {
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (c) 2022-2023  Igara Studio S.A.
+// Copyright (c) 2022-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -29,7 +29,16 @@ public:
 
   Canvas();
 
-  void callPaint();
+  // Calls the Paint signal to draw the given area of the canvas
+  // (or the whole canvas if the area is empty). The drawing is
+  // clipped to that area and cached in m_surface, so onPaint() just
+  // draws the cached surface.
+  void callPaint(const gfx::Rect& area = gfx::Rect());
+
+  // Marks the given area (in canvas coordinates) to be painted in
+  // the next onPaint(). Several calls before the next onPaint() are
+  // coalesced into one Paint signal.
+  void requestRepaint(const gfx::Rect& area = gfx::Rect());
 
   void setMouseCursor(const ui::CursorType cursor) {
     m_cursorType = cursor;
@@ -43,7 +52,8 @@ public:
     return m_autoScaling;
   }
 
-  obs::signal<void(GraphicsContext&)> Paint;
+  // The rectangle is the area to be painted (in canvas coordinates)
+  obs::signal<void(GraphicsContext&, const gfx::Rect&)> Paint;
   obs::signal<void(ui::KeyMessage*)> KeyDown;
   obs::signal<void(ui::KeyMessage*)> KeyUp;
   obs::signal<void(ui::MouseMessage*)> MouseMove;
@@ -64,6 +74,8 @@ private:
   void onPaint(ui::PaintEvent& ev) override;
 
   os::SurfaceRef m_surface;
+  // Area to be painted in the next onPaint()
+  gfx::Rect m_dirtyBounds;
   ui::CursorType m_cursorType = ui::kArrowCursor;
 
   // Flag used to indicate that the canvas will scale all the drawing operations
@@ -18,6 +18,7 @@
 #include "app/script/graphics_context.h"
 #include "app/script/keys.h"
 #include "app/script/luacpp.h"
+#include "app/script/profiler.h"
 #include "app/script/tabs_widget.h"
 #include "app/ui/button_set.h"
 #include "app/ui/color_button.h"
@@ -301,6 +302,7 @@ void Dialog_connect_signal(lua_State* L,
 
       if (lua_isfunction(L, -2)) {
         try {
+          Profiler::Call call(L, -2, "dialog");
           if (lua_pcall(L, 1, 0, 0)) {
             if (const char* s = lua_tostring(L, -1))
               App::instance()
@@ -1240,9 +1242,11 @@ int Dialog_canvas(lua_State* L)
       if (type == LUA_TFUNCTION) {
         Dialog_connect_signal(
           L, 1, widget->Paint,
-          [](lua_State* L, GraphicsContext& gc) {
+          [](lua_State* L, GraphicsContext& gc, const gfx::Rect& bounds) {
             push_new<GraphicsContext>(L, std::move(gc));
             lua_setfield(L, -2, "context");
+            push_new<gfx::Rect>(L, bounds);
+            lua_setfield(L, -2, "bounds");
           });
       }
       lua_pop(L, 1);
@@ -1615,20 +1619,43 @@ int Dialog_modify(lua_State* L)
   return 1;
 }
 
+// Dialog:repaint() repaints all canvases, or
+// Dialog:repaint{ id=canvasId, bounds=Rectangle } repaints only one
+// canvas and/or a part of it. The repaint is done in the next paint
+// message of each canvas (so several repaint() calls are coalesced
+// into one onpaint event).
 int Dialog_repaint(lua_State* L)
 {
   auto dlg = get_obj<Dialog>(L, 1);
   std::stack<ui::Widget*> widgets;
-  widgets.push(&dlg->grid);
+  gfx::Rect bounds;
+
+  if (lua_istable(L, 2)) {
+    if (lua_getfield(L, 2, "bounds") != LUA_TNIL)
+      bounds = convert_args_into_rect(L, -1);
+    lua_pop(L, 1);
+
+    if (lua_getfield(L, 2, "id") != LUA_TNIL) {
+      if (const char* id = lua_tostring(L, -1)) {
+        if (ui::Widget* widget = dlg->findDataWidgetById(id))
+          widgets.push(widget);
+      }
+      lua_pop(L, 1);
+      if (widgets.empty())
+        return 0;
+    }
+    else
+      lua_pop(L, 1);
+  }
+  if (widgets.empty())
+    widgets.push(&dlg->grid);
 
   while (!widgets.empty()) {
     auto child = widgets.top();
     widgets.pop();
 
-    if (child->type() == Canvas::Type()) {
-      static_cast<Canvas*>(child)->callPaint();
-      child->invalidate();
-    }
+    if (child->type() == Canvas::Type())
+      static_cast<Canvas*>(child)->requestRepaint(bounds);
 
     for (auto subchild : child->children())
       widgets.push(subchild);
@@ -17,7 +17,9 @@
 #include "app/doc_range.h"
 #include "app/pref/preferences.h"
 #include "app/script/blend_mode.h"
+#include "app/script/bytecode_cache.h"
 #include "app/script/luacpp.h"
+#include "app/script/profiler.h"
 #include "app/script/require.h"
 #include "app/script/security.h"
 #include "app/sprite_sheet_type.h"
@@ -173,6 +175,7 @@ void register_app_object(lua_State* L);
 void register_app_pixel_color_object(lua_State* L);
 void register_app_fs_object(lua_State* L);
 void register_app_os_object(lua_State* L);
+void register_app_profiler_object(lua_State* L);
 void register_app_command_object(lua_State* L);
 void register_app_preferences_object(lua_State* L);
 void register_json_object(lua_State* L);
@@ -192,6 +195,7 @@ void register_events_class(lua_State* L);
 void register_frame_class(lua_State* L);
 void register_frames_class(lua_State* L);
 void register_grid_class(lua_State* L);
+void register_image_bytes_class(lua_State* L);
 void register_image_class(lua_State* L);
 void register_image_iterator_class(lua_State* L);
 void register_image_spec_class(lua_State* L);
@@ -223,6 +227,7 @@ void register_tool_class(lua_State* L);
 void register_uuid_class(lua_State* L);
 void register_version_class(lua_State* L);
 void register_websocket_class(lua_State* L);
+void register_worker_class(lua_State* L);
 
 void set_app_params(lua_State* L, const Params& params);
 
@@ -268,6 +273,7 @@ Engine::Engine()
   register_app_pixel_color_object(L);
   register_app_fs_object(L);
   register_app_os_object(L);
+  register_app_profiler_object(L);
   register_app_command_object(L);
   register_app_preferences_object(L);
   register_json_object(L);
@@ -359,6 +365,7 @@ Engine::Engine()
   lua_setglobal(L, "SpriteSheetDataFormat");
   setfield_integer(L, "JSON_HASH", SpriteSheetDataFormat::JsonHash);
   setfield_integer(L, "JSON_ARRAY", SpriteSheetDataFormat::JsonArray);
+  setfield_integer(L, "BINARY", SpriteSheetDataFormat::Binary);
   lua_pop(L, 1);
 
   lua_newtable(L);
@@ -494,6 +501,7 @@ Engine::Engine()
   register_frame_class(L);
   register_frames_class(L);
   register_grid_class(L);
+  register_image_bytes_class(L);
   register_image_class(L);
   register_image_iterator_class(L);
   register_image_spec_class(L);
@@ -527,6 +535,7 @@ Engine::Engine()
 #if ENABLE_WEBSOCKET
   register_websocket_class(L);
 #endif
+  register_worker_class(L);
 
   // Check that we have a clean start (without dirty in the stack)
   ASSERT(lua_gettop(L) == top);
@@ -571,11 +580,25 @@ void Engine::printLastResult()
 
 bool Engine::evalCode(const std::string& code,
                       const std::string& filename)
+{
+  return evalChunk(code, filename, false);
+}
+
+bool Engine::evalChunk(const std::string& code,
+                       const std::string& filename,
+                       const bool useBytecodeCache)
 {
   bool ok = true;
   try {
-    if (luaL_loadbuffer(L, code.c_str(), code.size(), filename.c_str()) ||
-        lua_pcall(L, 0, 1, 0)) {
+    int status =
+      (useBytecodeCache ?
+       load_buffer_with_cache(L, code, filename):
+       luaL_loadbuffer(L, code.c_str(), code.size(), filename.c_str()));
+    if (status == LUA_OK) {
+      Profiler::Call call(L, -1, "script");
+      status = lua_pcall(L, 0, 1, 0);
+    }
+    if (status != LUA_OK) {
       const char* s = lua_tostring(L, -1);
       if (s)
         onConsoleError(s);
@@ -642,7 +665,9 @@ bool Engine::evalFile(const std::string& filename,
   if (g_debuggerDelegate)
     g_debuggerDelegate->startFile(absFilename, buf.str());
 
-  bool result = evalCode(buf.str(), "@" + absFilename);
+  // Files are loaded from the bytecode cache (e.g. to start faster
+  // with several extensions installed)
+  bool result = evalChunk(buf.str(), "@" + absFilename, true);
 
   if (g_debuggerDelegate)
     g_debuggerDelegate->endFile(absFilename);
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2021-2023  Igara Studio S.A.
+// Copyright (C) 2021-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -16,10 +16,12 @@
 #include "app/doc_event.h"
 #include "app/doc_undo.h"
 #include "app/doc_undo_observer.h"
+#include "app/perf_trace.h"
 #include "app/pref/preferences.h"
 #include "app/script/docobj.h"
 #include "app/script/engine.h"
 #include "app/script/luacpp.h"
+#include "app/script/profiler.h"
 #include "app/script/values.h"
 #include "app/site.h"
 #include "app/ui/main_window.h"
@@ -130,6 +132,8 @@ protected:
           }
         }
 
+        PerfScope perf(PerfCategory::Script, "app.events");
+        Profiler::Call call(L, -1-callbackArgs, "event");
         if (lua_pcall(L, callbackArgs, 0, 0)) {
           if (const char* s = lua_tostring(L, -1))
             engine->consolePrint(s);
@@ -0,0 +1,191 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/script/docobj.h"
+#include "app/script/engine.h"
+#include "app/script/luacpp.h"
+#include "doc/image.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace app {
+namespace script {
+
+namespace {
+
+// A view of the bytes of an image (or a range of them) without
+// copying them to a Lua string (as Image.bytes does). The view is
+// invalidated if the image is deleted or its pixels are reallocated
+// (e.g. with Image:resize()).
+struct ImageBytesObj {
+  doc::ObjectId imageId;
+  const uint8_t* data;          // Used to know if the image buffer has changed
+  size_t imageSize;
+  size_t offset;                // Range of bytes [offset, offset+size)
+  size_t size;
+
+  ImageBytesObj(const doc::Image* image)
+    : imageId(image->id())
+    , data(image->getPixelAddress(0, 0))
+    , imageSize(image->rowBytes() * image->height())
+    , offset(0)
+    , size(imageSize) {
+  }
+  ImageBytesObj(const ImageBytesObj& other,
+                const size_t offset,
+                const size_t size)
+    : imageId(other.imageId)
+    , data(other.data)
+    , imageSize(other.imageSize)
+    , offset(other.offset + offset)
+    , size(size) {
+  }
+  ImageBytesObj& operator=(const ImageBytesObj&) = delete;
+
+  // Returns the image (or throws a Lua error if the view is not
+  // valid anymore)
+  doc::Image* image(lua_State* L) {
+    doc::Image* image = check_docobj(L, doc::get<doc::Image>(imageId));
+    if (image->getPixelAddress(0, 0) != data ||
+        image->rowBytes() * image->height() != imageSize) {
+      luaL_error(L, "the image pixels have changed, this bytes view is not valid anymore");
+    }
+    return image;
+  }
+
+  // Returns a pointer to the given element of "elemSize" bytes
+  // (index from 1 to N)
+  uint8_t* address(lua_State* L, const lua_Integer i, const size_t elemSize) {
+    doc::Image* img = image(L);
+    if (i < 1 || size_t(i) > size / elemSize)
+      luaL_error(L, "index out of bounds: %d", int(i));
+    return img->getPixelAddress(0, 0) + offset + (i-1)*elemSize;
+  }
+};
+
+template<typename T>
+int get_value(lua_State* L)
+{
+  auto obj = get_obj<ImageBytesObj>(L, 1);
+  const uint8_t* p = obj->address(L, luaL_checkinteger(L, 2), sizeof(T));
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  lua_pushinteger(L, value);
+  return 1;
+}
+
+template<typename T>
+int set_value(lua_State* L)
+{
+  auto obj = get_obj<ImageBytesObj>(L, 1);
+  uint8_t* p = obj->address(L, luaL_checkinteger(L, 2), sizeof(T));
+  const T value = T(luaL_checkinteger(L, 3));
+  std::memcpy(p, &value, sizeof(T));
+  obj->image(L)->incrementVersion();
+  return 0;
+}
+
+int ImageBytes_gc(lua_State* L)
+{
+  get_obj<ImageBytesObj>(L, 1)->~ImageBytesObj();
+  return 0;
+}
+
+int ImageBytes_len(lua_State* L)
+{
+  auto obj = get_obj<ImageBytesObj>(L, 1);
+  lua_pushinteger(L, obj->size);
+  return 1;
+}
+
+int ImageBytes_index(lua_State* L)
+{
+  // view[i] returns the i-th byte
+  if (lua_isinteger(L, 2))
+    return get_value<uint8_t>(L);
+
+  // Methods
+  if (lua_type(L, 2) == LUA_TSTRING &&
+      luaL_getmetafield(L, 1, lua_tostring(L, 2)) != LUA_TNIL) {
+    return 1;
+  }
+  return luaL_error(L, "field '%s' does not exist", lua_tostring(L, 2));
+}
+
+int ImageBytes_newindex(lua_State* L)
+{
+  // view[i] = value changes the i-th byte
+  if (lua_isinteger(L, 2))
+    return set_value<uint8_t>(L);
+  return luaL_error(L, "cannot set field '%s'", lua_tostring(L, 2));
+}
+
+// view:toString() returns a copy of the bytes as a Lua string
+int ImageBytes_toString(lua_State* L)
+{
+  auto obj = get_obj<ImageBytesObj>(L, 1);
+  const doc::Image* img = obj->image(L);
+  lua_pushlstring(L, (const char*)img->getPixelAddress(0, 0) + obj->offset,
+                  obj->size);
+  return 1;
+}
+
+// view:slice(i, j) returns a view of the bytes from i to j
+// (inclusive, like string.sub)
+int ImageBytes_slice(lua_State* L)
+{
+  auto obj = get_obj<ImageBytesObj>(L, 1);
+  obj->image(L);                // Check that the view is still valid
+
+  const lua_Integer n = lua_Integer(obj->size);
+  lua_Integer i = luaL_optinteger(L, 2, 1);
+  lua_Integer j = luaL_optinteger(L, 3, n);
+  if (i < 0) i = std::max<lua_Integer>(n + i + 1, 1);
+  else if (i == 0) i = 1;
+  if (j < 0) j = n + j + 1;
+  else if (j > n) j = n;
+
+  const size_t size = (i <= j ? size_t(j - i + 1): 0);
+  push_new<ImageBytesObj>(L, *obj, size_t(i-1), size);
+  return 1;
+}
+
+const luaL_Reg ImageBytes_methods[] = {
+  { "getUint16", get_value<uint16_t> },
+  { "setUint16", set_value<uint16_t> },
+  { "getUint32", get_value<uint32_t> },
+  { "setUint32", set_value<uint32_t> },
+  { "slice", ImageBytes_slice },
+  { "__index", ImageBytes_index },
+  { "__newindex", ImageBytes_newindex },
+  { "__len", ImageBytes_len },
+  { "toString", ImageBytes_toString },
+  { "__gc", ImageBytes_gc },
+  { nullptr, nullptr }
+};
+
+} // anonymous namespace
+
+DEF_MTNAME(ImageBytesObj);
+
+void register_image_bytes_class(lua_State* L)
+{
+  using ImageBytes = ImageBytesObj;
+  REG_CLASS(L, ImageBytes);
+}
+
+void push_image_bytes(lua_State* L, const doc::Image* image)
+{
+  push_new<ImageBytesObj>(L, image);
+}
+
+} // namespace script
+} // namespace app
@@ -34,13 +34,18 @@
 #include "doc/cel.h"
 #include "doc/image.h"
 #include "doc/image_ref.h"
+#include "doc/layer.h"
+#include "doc/primitives_fast.h"
 #include "doc/primitives.h"
 #include "doc/sprite.h"
 #include "render/render.h"
 
 #include <algorithm>
+#include <array>
 #include <cstring>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace app {
 namespace script {
@@ -115,6 +120,102 @@ void render_sprite(Image* dst,
               sprite->height()));
 }
 
+// Applies the given function "f(pixel) -> pixel" to all pixels of
+// the image.
+template<typename ImageTraits, typename Func>
+void transform_pixels_templ(Image* img, Func&& f)
+{
+  using address_t = typename ImageTraits::address_t;
+  const int w = img->width();
+  const int h = img->height();
+  for (int y=0; y<h; ++y) {
+    auto p = (address_t)img->getPixelAddress(0, y);
+    for (int x=0; x<w; ++x, ++p)
+      *p = f(*p);
+  }
+}
+
+template<typename Func>
+void transform_pixels(Image* img, Func&& f)
+{
+  switch (img->pixelFormat()) {
+    case doc::IMAGE_RGB:       transform_pixels_templ<doc::RgbTraits>(img, f); break;
+    case doc::IMAGE_GRAYSCALE: transform_pixels_templ<doc::GrayscaleTraits>(img, f); break;
+    case doc::IMAGE_INDEXED:   transform_pixels_templ<doc::IndexedTraits>(img, f); break;
+    case doc::IMAGE_TILEMAP:   transform_pixels_templ<doc::TilemapTraits>(img, f); break;
+    case doc::IMAGE_BITMAP: {
+      const int w = img->width();
+      const int h = img->height();
+      for (int y=0; y<h; ++y)
+        for (int x=0; x<w; ++x)
+          doc::put_pixel_fast<doc::BitmapTraits>(img, x, y, f(doc::get_pixel_fast<doc::BitmapTraits>(img, x, y)));
+      break;
+    }
+  }
+}
+
+// Modifies the pixels of the image with "modify(Image*)". If the
+// image is from a cel, the modified area is copied back to the cel
+// image with undo information.
+template<typename Func>
+void modify_image(lua_State* L, ImageObj* obj, Func&& modify)
+{
+  Image* img = obj->image(L);
+
+  if (auto cel = obj->cel(L)) {
+    ImageRef tmp(Image::createCopy(img));
+    modify(tmp.get());
+
+    int x1, y1, x2, y2;
+    if (get_shrink_rect2(&x1, &y1, &x2, &y2, img, tmp.get())) {
+      Tx tx(cel->sprite());
+      tx(new cmd::CopyRect(
+           img, tmp.get(),
+           gfx::Clip(x1, y1, x1, y1, x2-x1+1, y2-y1+1)));
+      tx.commit();
+    }
+  }
+  else {
+    modify(img);
+    img->incrementVersion();
+
+    // Rehash tileset
+    if (obj->tilesetId) {
+      if (doc::Tileset* ts = obj->tileset(L)) {
+        ts->incrementVersion();
+        ts->notifyTileContentChange(obj->ti);
+      }
+    }
+  }
+}
+
+// Reads a table with 256 values (indexes from 0 to 255) to remap one
+// color channel, nil values keep the original channel value.
+bool get_channel_lut(lua_State* L, int index, const char* field,
+                     std::array<uint8_t, 256>& lut)
+{
+  for (int i=0; i<256; ++i)
+    lut[i] = i;
+
+  const int type = lua_getfield(L, index, field);
+  if (type == LUA_TNIL) {
+    lua_pop(L, 1);
+    return false;
+  }
+  if (type != LUA_TTABLE) {
+    luaL_error(L, "'%s' must be a table with values from 0 to 255", field);
+    return false;
+  }
+
+  for (int i=0; i<256; ++i) {
+    if (lua_geti(L, -1, i) != LUA_TNIL)
+      lut[i] = std::clamp<int>(lua_tointeger(L, -1), 0, 255);
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+  return true;
+}
+
 int Image_clone(lua_State* L);
 
 int Image_new(lua_State* L)
@@ -255,6 +356,7 @@ int Image_clear(lua_State* L)
     color = convert_args_into_pixel_color(L, i, img->pixelFormat());
 
   doc::fill_rect(img, rc, color); // Clips the rectangle to the image bounds
+  img->incrementVersion();
   return 0;
 }
 
@@ -270,6 +372,7 @@ int Image_drawPixel(lua_State* L)
   else
     color = convert_args_into_pixel_color(L, 4, img->pixelFormat());
   doc::put_pixel(img, x, y, color);
+  img->incrementVersion();
 
   // Rehash tileset
   if (obj->tilesetId) {
@@ -380,6 +483,108 @@ int Image_drawSprite(lua_State* L)
   return 0;
 }
 
+// Renders several frames of a sprite in the image in one call,
+// reusing the same render::Render (and its buffers) for all frames:
+//
+//   image:drawSpriteFrames{ sprite=spr,
+//                           frames={ 1, 2, ... },  -- default: all frames
+//                           columns=n,             -- default: one row
+//                           layer=layer,           -- default: all visible layers
+//                           position=Point(x, y),  -- position of the first frame
+//                           threads=n }            -- threads to render each frame
+//
+// Each frame is drawn in a cell of the sprite size, from left to
+// right and top to bottom (a sprite sheet).
+int Image_drawSpriteFrames(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  doc::Image* dst = obj->image(L);
+
+  lua_getfield(L, 2, "sprite");
+  const auto sprite = get_docobj<Sprite>(L, -1);
+  lua_pop(L, 1);
+
+  std::vector<frame_t> frames;
+  if (lua_getfield(L, 2, "frames") == LUA_TTABLE) {
+    const int n = int(luaL_len(L, -1));
+    frames.reserve(n);
+    for (int i=1; i<=n; ++i) {
+      lua_geti(L, -1, i);
+      const frame_t frame = get_frame_number_from_arg(L, -1);
+      lua_pop(L, 1);
+      if (frame < 0 || frame >= sprite->totalFrames())
+        return luaL_error(L, "frame %d out of range", int(frame+1));
+      frames.push_back(frame);
+    }
+  }
+  else {
+    for (frame_t frame=0; frame<sprite->totalFrames(); ++frame)
+      frames.push_back(frame);
+  }
+  lua_pop(L, 1);
+
+  int columns = int(frames.size());
+  if (lua_getfield(L, 2, "columns") != LUA_TNIL)
+    columns = std::max<int>(1, lua_tointeger(L, -1));
+  lua_pop(L, 1);
+
+  const Layer* layer = nullptr;
+  if (lua_getfield(L, 2, "layer") != LUA_TNIL)
+    layer = get_docobj<Layer>(L, -1);
+  lua_pop(L, 1);
+
+  gfx::Point pos(0, 0);
+  if (lua_getfield(L, 2, "position") != LUA_TNIL)
+    pos = convert_args_into_point(L, -1);
+  lua_pop(L, 1);
+
+  int threads = 1;
+  if (lua_getfield(L, 2, "threads") != LUA_TNIL)
+    threads = std::max<int>(1, lua_tointeger(L, -1));
+  lua_pop(L, 1);
+
+  auto renderFrames = [&](Image* image) {
+    render::Render render;
+    render.setNewBlend(true);
+    render.setMaxThreads(threads);
+
+    const int w = sprite->width();
+    const int h = sprite->height();
+    for (int i=0; i<int(frames.size()); ++i) {
+      const gfx::Clip area(pos.x + (i % columns) * w,
+                           pos.y + (i / columns) * h,
+                           0, 0, w, h);
+      if (layer)
+        render.renderLayer(image, layer, frames[i], area);
+      else
+        render.renderSprite(image, sprite, frames[i], area);
+    }
+  };
+
+  // Same as Image:drawSprite(), but with only one copy of the image
+  // and one undoable command for all frames.
+  if (auto cel = obj->cel(L)) {
+    Tx tx(cel->sprite());
+
+    ImageRef tmp(Image::createCopy(dst));
+    renderFrames(tmp.get());
+
+    int x1, y1, x2, y2;
+    if (get_shrink_rect2(&x1, &y1, &x2, &y2, dst, tmp.get())) {
+      tx(new cmd::CopyRect(
+           dst, tmp.get(),
+           gfx::Clip(x1, y1, x1, y1, x2-x1+1, y2-y1+1)));
+    }
+
+    tx.commit();
+  }
+  else {
+    renderFrames(dst);
+  }
+  return 0;
+}
+
 int Image_pixels(lua_State* L)
 {
   auto obj = get_obj<ImageObj>(L, 1);
@@ -646,6 +851,95 @@ int Image_flip(lua_State* L)
   return 0;
 }
 
+// Image:remap(table) replaces each pixel value "k" with "table[k]"
+// (pixels without an entry in the table are kept), e.g. to change
+// the indexes of an indexed image or replace some RGB colors.
+int Image_remap(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+
+  std::unordered_map<doc::color_t, doc::color_t> map;
+  lua_pushnil(L);
+  while (lua_next(L, 2) != 0) {
+    if (lua_isinteger(L, -2) && lua_isinteger(L, -1))
+      map[doc::color_t(lua_tointeger(L, -2))] = doc::color_t(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+  }
+  if (map.empty())
+    return 0;
+
+  modify_image(L, obj, [&map](Image* img){
+    // Indexed images use a LUT (faster than a map lookup per pixel)
+    if (img->pixelFormat() == doc::IMAGE_INDEXED) {
+      std::array<doc::color_t, 256> lut;
+      for (int i=0; i<256; ++i) {
+        auto it = map.find(i);
+        lut[i] = (it != map.end() ? it->second: i);
+      }
+      transform_pixels(img, [&lut](doc::color_t c){ return lut[c]; });
+    }
+    else {
+      transform_pixels(img, [&map](doc::color_t c) -> doc::color_t {
+        auto it = map.find(c);
+        return (it != map.end() ? it->second: c);
+      });
+    }
+  });
+  return 0;
+}
+
+// Image:remapChannels{ red=lut, green=lut, blue=lut, alpha=lut } (or
+// { gray=lut, alpha=lut } for grayscale images) remaps each channel
+// value "v" with "lut[v]".
+int Image_remapChannels(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+
+  std::array<uint8_t, 256> r, g, b, a;
+  bool any = false;
+
+  switch (obj->image(L)->pixelFormat()) {
+
+    case doc::IMAGE_RGB: {
+      any |= get_channel_lut(L, 2, "red", r);
+      any |= get_channel_lut(L, 2, "green", g);
+      any |= get_channel_lut(L, 2, "blue", b);
+      any |= get_channel_lut(L, 2, "alpha", a);
+      if (any) {
+        modify_image(L, obj, [&](Image* img){
+          transform_pixels_templ<doc::RgbTraits>(img, [&](const doc::color_t c){
+            return doc::rgba(r[doc::rgba_getr(c)],
+                             g[doc::rgba_getg(c)],
+                             b[doc::rgba_getb(c)],
+                             a[doc::rgba_geta(c)]);
+          });
+        });
+      }
+      break;
+    }
+
+    case doc::IMAGE_GRAYSCALE: {
+      any |= get_channel_lut(L, 2, "gray", g);
+      any |= get_channel_lut(L, 2, "alpha", a);
+      if (any) {
+        modify_image(L, obj, [&](Image* img){
+          transform_pixels_templ<doc::GrayscaleTraits>(img, [&](const doc::color_t c){
+            return doc::graya(g[doc::graya_getv(c)],
+                              a[doc::graya_geta(c)]);
+          });
+        });
+      }
+      break;
+    }
+
+    default:
+      return luaL_error(L, "remapChannels() needs an RGB or grayscale image");
+  }
+  return 0;
+}
+
 int Image_get_id(lua_State* L)
 {
   const auto obj = get_obj<ImageObj>(L, 1);
@@ -682,6 +976,13 @@ int Image_get_bytes(lua_State* L)
   return 1;
 }
 
+int Image_bytesView(lua_State* L)
+{
+  const auto img = get_obj<ImageObj>(L, 1)->image(L);
+  push_image_bytes(L, img);
+  return 1;
+}
+
 int Image_set_bytes(lua_State* L)
 {
   const auto img = get_obj<ImageObj>(L, 1)->image(L);
@@ -690,6 +991,7 @@ int Image_set_bytes(lua_State* L)
 
   if (bytes_size == bytes_needed) {
     std::memcpy(img->getPixelAddress(0, 0), bytes, bytes_size);
+    img->incrementVersion();
   }
   else {
     lua_pushfstring(L, "Data size does not match: given %d, needed %d.", bytes_size, bytes_needed);
@@ -748,6 +1050,7 @@ const luaL_Reg Image_methods[] = {
   { "drawPixel", Image_drawPixel }, { "putPixel", Image_drawPixel },
   { "drawImage", Image_drawImage }, { "putImage", Image_drawImage }, // TODO putImage is deprecated
   { "drawSprite", Image_drawSprite }, { "putSprite", Image_drawSprite }, // TODO putSprite is deprecated
+  { "drawSpriteFrames", Image_drawSpriteFrames },
   { "pixels", Image_pixels },
   { "isEqual", Image_isEqual },
   { "isEmpty", Image_isEmpty },
@@ -756,6 +1059,9 @@ const luaL_Reg Image_methods[] = {
   { "resize", Image_resize },
   { "shrinkBounds", Image_shrinkBounds },
   { "flip", Image_flip },
+  { "remap", Image_remap },
+  { "remapChannels", Image_remapChannels },
+  { "bytesView", Image_bytesView },
   { "__gc", Image_gc },
   { "__eq", Image_eq },
   { nullptr, nullptr }
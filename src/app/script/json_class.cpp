@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2023  Igara Studio S.A.
+// Copyright (C) 2023-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -11,7 +11,13 @@
 #include "app/script/luacpp.h"
 #include "app/script/values.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <string>
+#include <vector>
 
 #include "json11.hpp"
 
@@ -99,6 +105,659 @@ JsonObj get_json_value(lua_State* L, int index)
   return JsonObj();
 }
 
+// Limit of nested tables/arrays to avoid stack overflows with
+// recursive tables or malicious data
+const int kMaxDepth = 512;
+
+//////////////////////////////////////////////////////////////////////
+// JSON encoder from Lua values (without an intermediate json11::Json
+// object, the output is the same as json11::Json::dump())
+
+class JsonWriter {
+public:
+  JsonWriter(lua_State* L) : L(L) { }
+
+  std::string& output() { return m_out; }
+
+  void write(int index, const int depth = 0) {
+    index = lua_absindex(L, index);
+    switch (lua_type(L, index)) {
+
+      case LUA_TBOOLEAN:
+        m_out += (lua_toboolean(L, index) ? "true": "false");
+        break;
+
+      case LUA_TNUMBER:
+        writeNumber(lua_tonumber(L, index));
+        break;
+
+      case LUA_TSTRING: {
+        size_t len;
+        const char* str = lua_tolstring(L, index, &len);
+        writeString(str, len);
+        break;
+      }
+
+      case LUA_TTABLE:
+        if (depth >= kMaxDepth)
+          luaL_error(L, "table too deep to be encoded (or recursive)");
+        luaL_checkstack(L, 3, nullptr);
+        if (is_array_table(L, index))
+          writeArray(index, depth);
+        else
+          writeObject(index, depth);
+        break;
+
+      case LUA_TUSERDATA:
+        if (auto obj = may_get_obj<JsonObj>(L, index)) {
+          obj->dump(m_out);
+          break;
+        }
+        [[fallthrough]];
+
+      default:
+        m_out += "null";
+        break;
+    }
+  }
+
+private:
+  void writeNumber(const double value) {
+    if (std::isfinite(value)) {
+      char buf[32];
+      std::snprintf(buf, sizeof(buf), "%.17g", value);
+      m_out += buf;
+    }
+    else
+      m_out += "null";
+  }
+
+  void writeString(const char* str, const size_t len) {
+    m_out.push_back('"');
+    for (size_t i=0; i<len; ++i) {
+      const uint8_t ch = str[i];
+      switch (ch) {
+        case '\\': m_out += "\\\\"; break;
+        case '"': m_out += "\\\""; break;
+        case '\b': m_out += "\\b"; break;
+        case '\f': m_out += "\\f"; break;
+        case '\n': m_out += "\\n"; break;
+        case '\r': m_out += "\\r"; break;
+        case '\t': m_out += "\\t"; break;
+        default:
+          if (ch <= 0x1f) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", ch);
+            m_out += buf;
+          }
+          // U+2028 and U+2029 are escaped to be valid JavaScript
+          else if (ch == 0xe2 && i+2 < len &&
+                   uint8_t(str[i+1]) == 0x80 &&
+                   (uint8_t(str[i+2]) == 0xa8 || uint8_t(str[i+2]) == 0xa9)) {
+            m_out += (uint8_t(str[i+2]) == 0xa8 ? "\\u2028": "\\u2029");
+            i += 2;
+          }
+          else
+            m_out.push_back(ch);
+          break;
+      }
+    }
+    m_out.push_back('"');
+  }
+
+  void writeArray(const int index, const int depth) {
+    m_out.push_back('[');
+    const lua_Integer n = luaL_len(L, index);
+    for (lua_Integer i=1; i<=n; ++i) {
+      if (i > 1)
+        m_out += ", ";
+      lua_rawgeti(L, index, i);
+      write(-1, depth+1);
+      lua_pop(L, 1);
+    }
+    m_out.push_back(']');
+  }
+
+  // Keys are sorted as in json11::Json::object (a std::map)
+  void writeObject(const int index, const int depth) {
+    struct Key {
+      std::string name;
+      bool isString;
+      bool isInteger;
+      lua_Number number;
+      lua_Integer integer;
+    };
+    std::vector<Key> keys;
+    lua_pushnil(L);
+    while (lua_next(L, index) != 0) {
+      Key key;
+      key.isString = (lua_type(L, -2) == LUA_TSTRING);
+      key.isInteger = lua_isinteger(L, -2);
+      key.number = lua_tonumber(L, -2);
+      key.integer = lua_tointeger(L, -2);
+      // Convert a copy of the key (lua_tostring() on the key itself
+      // would break lua_next())
+      lua_pushvalue(L, -2);
+      if (const char* k = lua_tostring(L, -1)) {
+        key.name = k;
+        keys.push_back(std::move(key));
+      }
+      lua_pop(L, 2);
+    }
+    std::sort(keys.begin(), keys.end(),
+              [](const Key& a, const Key& b){ return a.name < b.name; });
+
+    m_out.push_back('{');
+    for (size_t i=0; i<keys.size(); ++i) {
+      const Key& key = keys[i];
+      if (i > 0) {
+        // Ignore duplicated keys (e.g. 1 and "1")
+        if (key.name == keys[i-1].name)
+          continue;
+        m_out += ", ";
+      }
+      writeString(key.name.c_str(), key.name.size());
+      m_out += ": ";
+
+      if (key.isString)
+        lua_pushlstring(L, key.name.c_str(), key.name.size());
+      else if (key.isInteger)
+        lua_pushinteger(L, key.integer);
+      else
+        lua_pushnumber(L, key.number);
+      lua_rawget(L, index);
+      write(-1, depth+1);
+      lua_pop(L, 1);
+    }
+    m_out.push_back('}');
+  }
+
+  lua_State* L;
+  std::string m_out;
+};
+
+//////////////////////////////////////////////////////////////////////
+// JSON decoder to Lua tables (without an intermediate json11::Json
+// object)
+
+class JsonReader {
+public:
+  JsonReader(lua_State* L, const char* str, const size_t len)
+    : L(L), m_ptr(str), m_end(str+len) { }
+
+  // Pushes the decoded value on the stack
+  void read() {
+    readValue(0);
+    skipSpaces();
+    if (m_ptr != m_end)
+      error("unexpected trailing characters");
+  }
+
+private:
+  void error(const char* msg) {
+    luaL_error(L, "invalid JSON: %s", msg);
+  }
+
+  void skipSpaces() {
+    while (m_ptr != m_end &&
+           (*m_ptr == ' ' || *m_ptr == '\t' || *m_ptr == '\n' || *m_ptr == '\r'))
+      ++m_ptr;
+  }
+
+  bool consume(const char* word) {
+    const size_t n = std::strlen(word);
+    if (size_t(m_end - m_ptr) >= n && std::strncmp(m_ptr, word, n) == 0) {
+      m_ptr += n;
+      return true;
+    }
+    return false;
+  }
+
+  void readValue(const int depth) {
+    skipSpaces();
+    if (m_ptr == m_end)
+      error("unexpected end of input");
+
+    switch (*m_ptr) {
+      case '{':
+        ++m_ptr;
+        readObject(depth);
+        break;
+      case '[':
+        ++m_ptr;
+        readArray(depth);
+        break;
+      case '"':
+        ++m_ptr;
+        readString();
+        break;
+      default:
+        if (consume("true"))
+          lua_pushboolean(L, true);
+        else if (consume("false"))
+          lua_pushboolean(L, false);
+        else if (consume("null"))
+          lua_pushnil(L);
+        else
+          readNumber();
+        break;
+    }
+  }
+
+  void readObject(const int depth) {
+    if (depth >= kMaxDepth)
+      error("too many nested objects");
+    luaL_checkstack(L, 3, nullptr);
+    lua_newtable(L);
+    skipSpaces();
+    if (m_ptr != m_end && *m_ptr == '}') {
+      ++m_ptr;
+      return;
+    }
+    while (true) {
+      skipSpaces();
+      if (m_ptr == m_end || *m_ptr != '"')
+        error("expected a string key in object");
+      ++m_ptr;
+      readString();
+      skipSpaces();
+      if (m_ptr == m_end || *m_ptr != ':')
+        error("expected ':' in object");
+      ++m_ptr;
+      readValue(depth+1);
+      lua_rawset(L, -3);
+
+      skipSpaces();
+      if (m_ptr != m_end && *m_ptr == ',') {
+        ++m_ptr;
+        continue;
+      }
+      if (m_ptr != m_end && *m_ptr == '}') {
+        ++m_ptr;
+        return;
+      }
+      error("expected ',' or '}' in object");
+    }
+  }
+
+  void readArray(const int depth) {
+    if (depth >= kMaxDepth)
+      error("too many nested arrays");
+    luaL_checkstack(L, 2, nullptr);
+    lua_newtable(L);
+    skipSpaces();
+    if (m_ptr != m_end && *m_ptr == ']') {
+      ++m_ptr;
+      return;
+    }
+    // null values are nil elements (holes in the Lua table)
+    for (lua_Integer i=1; ; ++i) {
+      readValue(depth+1);
+      lua_rawseti(L, -2, i);
+
+      skipSpaces();
+      if (m_ptr != m_end && *m_ptr == ',') {
+        ++m_ptr;
+        continue;
+      }
+      if (m_ptr != m_end && *m_ptr == ']') {
+        ++m_ptr;
+        return;
+      }
+      error("expected ',' or ']' in array");
+    }
+  }
+
+  void readNumber() {
+    const char* begin = m_ptr;
+    while (m_ptr != m_end &&
+           ((*m_ptr >= '0' && *m_ptr <= '9') ||
+            *m_ptr == '-' || *m_ptr == '+' ||
+            *m_ptr == '.' || *m_ptr == 'e' || *m_ptr == 'E'))
+      ++m_ptr;
+    if (begin == m_ptr)
+      error("unexpected character");
+
+    // lua_stringtonumber() needs a null-terminated string, and
+    // converts integers to Lua integers.
+    const std::string number(begin, m_ptr);
+    if (lua_stringtonumber(L, number.c_str()) == 0)
+      error("invalid number");
+  }
+
+  static int hex_value(const char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+  }
+
+  uint32_t readHex4() {
+    if (m_end - m_ptr < 4)
+      error("invalid \\u escape");
+    uint32_t cp = 0;
+    for (int i=0; i<4; ++i) {
+      const int v = hex_value(*m_ptr++);
+      if (v < 0)
+        error("invalid \\u escape");
+      cp = (cp << 4) | v;
+    }
+    return cp;
+  }
+
+  void readString() {
+    m_buf.clear();
+    while (true) {
+      if (m_ptr == m_end)
+        error("unterminated string");
+
+      const char ch = *m_ptr++;
+      if (ch == '"')
+        break;
+      if (ch != '\\') {
+        m_buf.push_back(ch);
+        continue;
+      }
+
+      if (m_ptr == m_end)
+        error("unterminated string");
+      switch (*m_ptr++) {
+        case '"': m_buf.push_back('"'); break;
+        case '\\': m_buf.push_back('\\'); break;
+        case '/': m_buf.push_back('/'); break;
+        case 'b': m_buf.push_back('\b'); break;
+        case 'f': m_buf.push_back('\f'); break;
+        case 'n': m_buf.push_back('\n'); break;
+        case 'r': m_buf.push_back('\r'); break;
+        case 't': m_buf.push_back('\t'); break;
+        case 'u': {
+          uint32_t cp = readHex4();
+          // Surrogate pair
+          if (cp >= 0xd800 && cp <= 0xdbff &&
+              m_end - m_ptr >= 6 && m_ptr[0] == '\\' && m_ptr[1] == 'u') {
+            m_ptr += 2;
+            const uint32_t low = readHex4();
+            if (low >= 0xdc00 && low <= 0xdfff)
+              cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            else
+              error("invalid surrogate pair");
+          }
+          encodeUtf8(cp);
+          break;
+        }
+        default:
+          error("invalid escape character");
+      }
+    }
+    lua_pushlstring(L, m_buf.c_str(), m_buf.size());
+  }
+
+  void encodeUtf8(const uint32_t cp) {
+    if (cp < 0x80)
+      m_buf.push_back(char(cp));
+    else if (cp < 0x800) {
+      m_buf.push_back(char(0xc0 | (cp >> 6)));
+      m_buf.push_back(char(0x80 | (cp & 0x3f)));
+    }
+    else if (cp < 0x10000) {
+      m_buf.push_back(char(0xe0 | (cp >> 12)));
+      m_buf.push_back(char(0x80 | ((cp >> 6) & 0x3f)));
+      m_buf.push_back(char(0x80 | (cp & 0x3f)));
+    }
+    else {
+      m_buf.push_back(char(0xf0 | (cp >> 18)));
+      m_buf.push_back(char(0x80 | ((cp >> 12) & 0x3f)));
+      m_buf.push_back(char(0x80 | ((cp >> 6) & 0x3f)));
+      m_buf.push_back(char(0x80 | (cp & 0x3f)));
+    }
+  }
+
+  lua_State* L;
+  const char* m_ptr;
+  const char* m_end;
+  std::string m_buf;
+};
+
+//////////////////////////////////////////////////////////////////////
+// MessagePack encoder/decoder (https://msgpack.org/)
+
+class MsgPackWriter {
+public:
+  MsgPackWriter(lua_State* L) : L(L) { }
+
+  std::string& output() { return m_out; }
+
+  void write(int index, const int depth = 0) {
+    index = lua_absindex(L, index);
+    switch (lua_type(L, index)) {
+
+      case LUA_TBOOLEAN:
+        m_out.push_back(char(lua_toboolean(L, index) ? 0xc3: 0xc2));
+        break;
+
+      case LUA_TNUMBER:
+        if (lua_isinteger(L, index))
+          writeInteger(lua_tointeger(L, index));
+        else {
+          const double v = lua_tonumber(L, index);
+          uint64_t bits;
+          std::memcpy(&bits, &v, sizeof(bits));
+          m_out.push_back(char(0xcb));
+          writeBE(bits, 8);
+        }
+        break;
+
+      case LUA_TSTRING: {
+        size_t len;
+        const char* str = lua_tolstring(L, index, &len);
+        writeHeader(len, 0xa0, 32, 0xd9, 0xda, 0xdb);
+        m_out.append(str, len);
+        break;
+      }
+
+      case LUA_TTABLE:
+        if (depth >= kMaxDepth)
+          luaL_error(L, "table too deep to be encoded (or recursive)");
+        luaL_checkstack(L, 3, nullptr);
+        if (is_array_table(L, index)) {
+          const lua_Integer n = luaL_len(L, index);
+          writeHeader(n, 0x90, 16, 0, 0xdc, 0xdd);
+          for (lua_Integer i=1; i<=n; ++i) {
+            lua_rawgeti(L, index, i);
+            write(-1, depth+1);
+            lua_pop(L, 1);
+          }
+        }
+        else {
+          size_t n = 0;
+          lua_pushnil(L);
+          while (lua_next(L, index) != 0) {
+            ++n;
+            lua_pop(L, 1);
+          }
+          writeHeader(n, 0x80, 16, 0, 0xde, 0xdf);
+          lua_pushnil(L);
+          while (lua_next(L, index) != 0) {
+            write(-2, depth+1);
+            write(-1, depth+1);
+            lua_pop(L, 1);
+          }
+        }
+        break;
+
+      default:
+        m_out.push_back(char(0xc0)); // nil
+        break;
+    }
+  }
+
+private:
+  void writeBE(const uint64_t value, const int bytes) {
+    for (int i=bytes-1; i>=0; --i)
+      m_out.push_back(char((value >> (8*i)) & 0xff));
+  }
+
+  // Writes the header of a string (or array/map) with its length
+  // using the fix/8/16/32 variant
+  void writeHeader(const size_t n, const int fixType, const size_t fixMax,
+                   const int type8, const int type16, const int type32) {
+    if (n < fixMax)
+      m_out.push_back(char(fixType | n));
+    else if (type8 && n <= 0xff) {
+      m_out.push_back(char(type8));
+      writeBE(n, 1);
+    }
+    else if (n <= 0xffff) {
+      m_out.push_back(char(type16));
+      writeBE(n, 2);
+    }
+    else {
+      m_out.push_back(char(type32));
+      writeBE(n, 4);
+    }
+  }
+
+  void writeInteger(const lua_Integer v) {
+    if (v >= 0) {
+      if (v < 128)
+        m_out.push_back(char(v));
+      else if (v <= 0xff) { m_out.push_back(char(0xcc)); writeBE(v, 1); }
+      else if (v <= 0xffff) { m_out.push_back(char(0xcd)); writeBE(v, 2); }
+      else if (v <= 0xffffffffll) { m_out.push_back(char(0xce)); writeBE(v, 4); }
+      else { m_out.push_back(char(0xcf)); writeBE(v, 8); }
+    }
+    else {
+      if (v >= -32)
+        m_out.push_back(char(0xe0 | (v + 32)));
+      else if (v >= INT8_MIN) { m_out.push_back(char(0xd0)); writeBE(uint64_t(v), 1); }
+      else if (v >= INT16_MIN) { m_out.push_back(char(0xd1)); writeBE(uint64_t(v), 2); }
+      else if (v >= INT32_MIN) { m_out.push_back(char(0xd2)); writeBE(uint64_t(v), 4); }
+      else { m_out.push_back(char(0xd3)); writeBE(uint64_t(v), 8); }
+    }
+  }
+
+  lua_State* L;
+  std::string m_out;
+};
+
+class MsgPackReader {
+public:
+  MsgPackReader(lua_State* L, const char* data, const size_t len)
+    : L(L)
+    , m_ptr((const uint8_t*)data)
+    , m_end((const uint8_t*)data + len) { }
+
+  // Pushes the decoded value on the stack
+  void read() {
+    readValue(0);
+    if (m_ptr != m_end)
+      error("unexpected trailing bytes");
+  }
+
+private:
+  void error(const char* msg) {
+    luaL_error(L, "invalid MessagePack data: %s", msg);
+  }
+
+  uint64_t readBE(const int bytes) {
+    if (m_end - m_ptr < bytes)
+      error("unexpected end of data");
+    uint64_t value = 0;
+    for (int i=0; i<bytes; ++i)
+      value = (value << 8) | *m_ptr++;
+    return value;
+  }
+
+  void readString(const size_t n) {
+    if (size_t(m_end - m_ptr) < n)
+      error("unexpected end of data");
+    lua_pushlstring(L, (const char*)m_ptr, n);
+    m_ptr += n;
+  }
+
+  void readArray(const size_t n, const int depth) {
+    if (depth >= kMaxDepth)
+      error("too many nested arrays");
+    luaL_checkstack(L, 2, nullptr);
+    lua_createtable(L, int(std::min<size_t>(n, m_end - m_ptr)), 0);
+    for (size_t i=1; i<=n; ++i) {
+      readValue(depth+1);
+      lua_rawseti(L, -2, lua_Integer(i));
+    }
+  }
+
+  void readMap(const size_t n, const int depth) {
+    if (depth >= kMaxDepth)
+      error("too many nested maps");
+    luaL_checkstack(L, 3, nullptr);
+    lua_createtable(L, 0, int(std::min<size_t>(n, m_end - m_ptr)));
+    for (size_t i=0; i<n; ++i) {
+      readValue(depth+1);
+      if (lua_isnil(L, -1))
+        error("nil map key");
+      readValue(depth+1);
+      lua_rawset(L, -3);
+    }
+  }
+
+  void readValue(const int depth) {
+    const uint8_t type = uint8_t(readBE(1));
+
+    if (type <= 0x7f) lua_pushinteger(L, type);
+    else if (type <= 0x8f) readMap(type & 0x0f, depth);
+    else if (type <= 0x9f) readArray(type & 0x0f, depth);
+    else if (type <= 0xbf) readString(type & 0x1f);
+    else if (type >= 0xe0) lua_pushinteger(L, int8_t(type));
+    else {
+      switch (type) {
+        case 0xc0: lua_pushnil(L); break;
+        case 0xc2: lua_pushboolean(L, false); break;
+        case 0xc3: lua_pushboolean(L, true); break;
+        // bin 8/16/32 (as Lua strings)
+        case 0xc4: readString(readBE(1)); break;
+        case 0xc5: readString(readBE(2)); break;
+        case 0xc6: readString(readBE(4)); break;
+        case 0xca: {
+          const uint32_t bits = uint32_t(readBE(4));
+          float v;
+          std::memcpy(&v, &bits, sizeof(v));
+          lua_pushnumber(L, v);
+          break;
+        }
+        case 0xcb: {
+          const uint64_t bits = readBE(8);
+          double v;
+          std::memcpy(&v, &bits, sizeof(v));
+          lua_pushnumber(L, v);
+          break;
+        }
+        case 0xcc: lua_pushinteger(L, lua_Integer(readBE(1))); break;
+        case 0xcd: lua_pushinteger(L, lua_Integer(readBE(2))); break;
+        case 0xce: lua_pushinteger(L, lua_Integer(readBE(4))); break;
+        case 0xcf: lua_pushinteger(L, lua_Integer(readBE(8))); break;
+        case 0xd0: lua_pushinteger(L, int8_t(readBE(1))); break;
+        case 0xd1: lua_pushinteger(L, int16_t(readBE(2))); break;
+        case 0xd2: lua_pushinteger(L, int32_t(readBE(4))); break;
+        case 0xd3: lua_pushinteger(L, int64_t(readBE(8))); break;
+        case 0xd9: readString(readBE(1)); break;
+        case 0xda: readString(readBE(2)); break;
+        case 0xdb: readString(readBE(4)); break;
+        case 0xdc: readArray(readBE(2), depth); break;
+        case 0xdd: readArray(readBE(4), depth); break;
+        case 0xde: readMap(readBE(2), depth); break;
+        case 0xdf: readMap(readBE(4), depth); break;
+        default:
+          // Extension types are not supported
+          error("unsupported type");
+      }
+    }
+  }
+
+  lua_State* L;
+  const uint8_t* m_ptr;
+  const uint8_t* m_end;
+};
+
 int JsonObj_gc(lua_State* L)
 {
   get_obj<JsonObj>(L, 1)->~JsonObj();
@@ -232,8 +891,27 @@ int JsonArrayIterator_gc(lua_State* L)
   return 0;
 }
 
+// json.decode(text [, { tables=true }]) returns a json object, or
+// plain Lua tables if tables=true (decoded directly without an
+// intermediate json object, null values are nil)
 int Json_decode(lua_State* L)
 {
+  bool tables = false;
+  if (lua_istable(L, 2)) {
+    lua_getfield(L, 2, "tables");
+    tables = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+  }
+
+  size_t len;
+  if (tables) {
+    if (const char* s = lua_tolstring(L, 1, &len)) {
+      JsonReader(L, s, len).read();
+      return 1;
+    }
+    return 0;
+  }
+
   if (const char* s = lua_tostring(L, 1)) {
     std::string err;
     auto json = json11::Json::parse(s, std::strlen(s), err);
@@ -252,14 +930,34 @@ int Json_encode(lua_State* L)
     lua_pushstring(L, obj->dump().c_str());
     return 1;
   }
-  // Encode a Lua table
+  // Encode a Lua table (directly from the table)
   else if (lua_istable(L, 1)) {
-    lua_pushstring(L, get_json_value(L, 1).dump().c_str());
+    JsonWriter writer(L);
+    writer.write(1);
+    lua_pushlstring(L, writer.output().c_str(), writer.output().size());
     return 1;
   }
   return 0;
 }
 
+// json.encodeMessagePack(value) returns a binary string
+int Json_encodeMessagePack(lua_State* L)
+{
+  MsgPackWriter writer(L);
+  writer.write(1);
+  lua_pushlstring(L, writer.output().c_str(), writer.output().size());
+  return 1;
+}
+
+// json.decodeMessagePack(data) returns the decoded Lua value
+int Json_decodeMessagePack(lua_State* L)
+{
+  size_t len;
+  const char* data = luaL_checklstring(L, 1, &len);
+  MsgPackReader(L, data, len).read();
+  return 1;
+}
+
 const luaL_Reg JsonObj_methods[] = {
   { "__gc",       JsonObj_gc },
   { "__eq",       JsonObj_eq },
@@ -284,6 +982,8 @@ const luaL_Reg JsonArrayIterator_methods[] = {
 const luaL_Reg Json_methods[] = {
   { "decode",     Json_decode },
   { "encode",     Json_encode },
+  { "decodeMessagePack", Json_decodeMessagePack },
+  { "encodeMessagePack", Json_encodeMessagePack },
   { nullptr,      nullptr }
 };
 
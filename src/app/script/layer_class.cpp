@@ -21,6 +21,7 @@
 #include "app/script/luacpp.h"
 #include "app/script/userdata.h"
 #include "app/tx.h"
+#include "app/util/memory_usage.h"
 #include "doc/layer.h"
 #include "doc/layer_tilemap.h"
 #include "doc/sprite.h"
@@ -235,6 +236,15 @@ int Layer_get_cels(lua_State* L)
   return 1;
 }
 
+// Approximated memory (in bytes) used by the cels of the layer (or
+// all the layers inside the group)
+int Layer_get_memoryUsage(lua_State* L)
+{
+  auto layer = get_docobj<Layer>(L, 1);
+  lua_pushinteger(L, get_layer_memory_usage(layer));
+  return 1;
+}
+
 int Layer_get_tileset(lua_State* L)
 {
   auto layer = get_docobj<Layer>(L, 1);
@@ -445,6 +455,7 @@ const Property Layer_properties[] = {
   { "data", UserData_get_text<Layer>, UserData_set_text<Layer> },
   { "properties", UserData_get_properties<Layer>, UserData_set_properties<Layer> },
   { "tileset", Layer_get_tileset, Layer_set_tileset },
+  { "memoryUsage", Layer_get_memoryUsage, nullptr },
   { nullptr, nullptr, nullptr }
 };
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2023  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -15,6 +15,7 @@
 #include "app/console.h"
 #include "app/script/engine.h"
 #include "app/script/luacpp.h"
+#include "app/script/profiler.h"
 #include "app/ui/app_menuitem.h"
 
 namespace app {
@@ -62,6 +63,7 @@ protected:
     lua_State* L = engine->luaState();
 
     lua_rawgeti(L, LUA_REGISTRYINDEX, m_onclickRef);
+    Profiler::Call call(L, -1, "command");
     if (lua_pcall(L, 0, 1, 0)) {
       if (const char* s = lua_tostring(L, -1)) {
         Console().printf("Error: %s", s);
@@ -78,6 +80,7 @@ protected:
       lua_State* L = engine->luaState();
 
       lua_rawgeti(L, LUA_REGISTRYINDEX, m_onenabledRef);
+      Profiler::Call call(L, -1, "onenabled");
       if (lua_pcall(L, 0, 1, 0)) {
         if (const char* s = lua_tostring(L, -1)) {
           Console().printf("Error: %s", s);
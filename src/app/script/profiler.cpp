@@ -0,0 +1,279 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/script/profiler.h"
+
+#include "app/app.h"
+#include "app/extensions.h"
+#include "app/script/luacpp.h"
+#include "base/fs.h"
+#include "base/fstream_path.h"
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+namespace app {
+namespace script {
+
+namespace {
+
+// Used to know if a Profiler::Call is from the current profiler
+// session (the profiler can be stopped/started inside a Lua call)
+int g_profilerSession = 0;
+
+std::string frame_name(const lua_Debug& ar)
+{
+  const char* name = (ar.name ? ar.name:
+                      *ar.what == 'm' ? "main chunk": "?");
+  if (*ar.what == 'C')
+    return fmt::format("{} [C]", name);
+  return fmt::format("{} ({}:{})", name, ar.short_src, ar.linedefined);
+}
+
+int64_t to_usecs(const std::chrono::steady_clock::duration& d)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+// Returns the map items sorted by the time returned by "getTime"
+// (from the slowest to the fastest)
+template<typename Map, typename GetTime>
+std::vector<typename Map::const_iterator> sorted_by_time(const Map& map,
+                                                         GetTime getTime)
+{
+  std::vector<typename Map::const_iterator> items;
+  for (auto it=map.begin(); it!=map.end(); ++it)
+    items.push_back(it);
+  std::sort(items.begin(), items.end(),
+            [getTime](const auto& a, const auto& b){
+              return getTime(a->second) > getTime(b->second);
+            });
+  return items;
+}
+
+} // anonymous namespace
+
+Profiler* Profiler::s_profiler = nullptr;
+
+Profiler::Call::Call(lua_State* L, int funcIndex, const char* label)
+  : m_profiler(s_profiler)
+  , m_session(g_profilerSession)
+  , m_topLevel(false)
+{
+  if (!m_profiler)
+    return;
+
+  // If there is no Lua function running, this is a top-level call
+  // (e.g. an event from the UI), in other case it's a nested call
+  // (e.g. an event triggered by app.command() from a script)
+  lua_Debug ar;
+  m_topLevel = (lua_getstack(L, 0, &ar) == 0);
+
+  lua_pushvalue(L, funcIndex);
+  if (lua_getinfo(L, ">S", &ar)) {
+    ar.name = nullptr;
+    m_frame = frame_name(ar);
+    m_handler = fmt::format("{} {}:{}", label, ar.short_src, ar.linedefined);
+    if (m_topLevel)
+      m_extension = m_profiler->extensionName(ar.source ? ar.source: "");
+  }
+
+  if (m_topLevel) {
+    m_profiler->m_label = label;
+    m_profiler->m_lastSample = Clock::now();
+  }
+  // The time until now belongs to the outer Lua stack
+  else
+    m_profiler->sample(L);
+  m_start = Clock::now();
+}
+
+Profiler::Call::~Call()
+{
+  if (!m_profiler ||
+      m_profiler != s_profiler ||
+      m_session != g_profilerSession) {
+    return;
+  }
+
+  const Clock::time_point now = Clock::now();
+
+  // The time since the last sample is added to the handler itself
+  m_profiler->addTime(m_profiler->m_label + ";" + m_frame, m_frame,
+                      to_usecs(now - m_profiler->m_lastSample));
+  m_profiler->m_lastSample = now;
+
+  const int64_t usecs = to_usecs(now - m_start);
+  auto add = [usecs](Timing& t){
+    ++t.calls;
+    t.total += usecs;
+    t.max = std::max(t.max, usecs);
+  };
+  add(m_profiler->m_handlers[m_handler]);
+  if (m_topLevel)
+    add(m_profiler->m_extensions[m_extension]);
+}
+
+// static
+bool Profiler::start(lua_State* L, int sampleInterval)
+{
+  if (s_profiler)
+    return true;
+
+  // Another hook is installed (e.g. the debugger)
+  if (lua_gethook(L))
+    return false;
+
+  s_profiler = new Profiler;
+  ++g_profilerSession;
+
+  // In case that the profiler is started from a script, the rest of
+  // the script is measured too
+  s_profiler->m_label = "script";
+  s_profiler->m_lastSample = Clock::now();
+  lua_sethook(L, &Profiler::hook, LUA_MASKCOUNT, std::max(1, sampleInterval));
+  return true;
+}
+
+// static
+std::string Profiler::stop(lua_State* L,
+                           const std::string& foldedStacksFilename)
+{
+  if (!s_profiler)
+    return std::string();
+
+  lua_sethook(L, nullptr, 0, 0);
+  std::unique_ptr<Profiler> profiler(s_profiler);
+  s_profiler = nullptr;
+  ++g_profilerSession;
+
+  std::string result = profiler->report();
+  if (!foldedStacksFilename.empty()) {
+    if (profiler->saveFoldedStacks(foldedStacksFilename))
+      result += fmt::format("Stacks saved in {}\n", foldedStacksFilename);
+    else
+      result += fmt::format("Error saving stacks in {}\n", foldedStacksFilename);
+  }
+  return result;
+}
+
+// static
+void Profiler::hook(lua_State* L, lua_Debug* ar)
+{
+  if (s_profiler)
+    s_profiler->sample(L);
+}
+
+void Profiler::sample(lua_State* L)
+{
+  const Clock::time_point now = Clock::now();
+  const int64_t usecs = to_usecs(now - m_lastSample);
+  m_lastSample = now;
+
+  std::vector<std::string> frames;
+  lua_Debug ar;
+  for (int level=0; lua_getstack(L, level, &ar); ++level) {
+    if (lua_getinfo(L, "Sn", &ar))
+      frames.push_back(frame_name(ar));
+  }
+  if (frames.empty())
+    return;
+
+  std::string stack = m_label;
+  for (auto it=frames.rbegin(); it!=frames.rend(); ++it) {
+    stack.push_back(';');
+    stack += *it;
+  }
+  ++m_samples;
+  addTime(stack, frames.front(), usecs);
+}
+
+void Profiler::addTime(const std::string& stack,
+                       const std::string& leaf,
+                       const int64_t usecs)
+{
+  m_stacks[stack] += usecs;
+  m_functions[leaf] += usecs;
+}
+
+std::string Profiler::extensionName(const std::string& source)
+{
+  auto it = m_sourceExtension.find(source);
+  if (it != m_sourceExtension.end())
+    return it->second;
+
+  std::string name = "(scripts)";
+  if (!source.empty() && source[0] == '@') {
+    const std::string fn = base::normalize_path(source.substr(1));
+    for (const Extension* ext : App::instance()->extensions()) {
+      const std::string path = base::normalize_path(ext->path());
+      if (!path.empty() && fn.size() > path.size() &&
+          fn.compare(0, path.size(), path) == 0) {
+        name = ext->displayName();
+        break;
+      }
+    }
+  }
+  m_sourceExtension[source] = name;
+  return name;
+}
+
+std::string Profiler::report() const
+{
+  auto ms = [](const int64_t usecs){ return double(usecs) / 1000.0; };
+  auto timingTotal = [](const Timing& t){ return t.total; };
+  auto usecs = [](const int64_t usecs){ return usecs; };
+
+  std::string result = fmt::format("Lua profiler ({} samples)\n", m_samples);
+
+  result += "Extensions:\n";
+  for (const auto& it : sorted_by_time(m_extensions, timingTotal)) {
+    const Timing& t = it->second;
+    result += fmt::format("  {:10.3f} ms {:6} calls (max {:.3f} ms) {}\n",
+                          ms(t.total), t.calls, ms(t.max), it->first);
+  }
+
+  result += "Handlers:\n";
+  for (const auto& it : sorted_by_time(m_handlers, timingTotal)) {
+    const Timing& t = it->second;
+    result += fmt::format("  {:10.3f} ms {:6} calls (max {:.3f} ms) {}\n",
+                          ms(t.total), t.calls, ms(t.max), it->first);
+  }
+
+  result += "Functions (self time):\n";
+  const int kMaxFunctions = 20;
+  int n = 0;
+  for (const auto& it : sorted_by_time(m_functions, usecs)) {
+    if (++n > kMaxFunctions)
+      break;
+    result += fmt::format("  {:10.3f} ms {}\n", ms(it->second), it->first);
+  }
+  return result;
+}
+
+bool Profiler::saveFoldedStacks(const std::string& filename) const
+{
+  std::ofstream f(FSTREAM_PATH(filename), std::ofstream::binary);
+  if (!f)
+    return false;
+
+  // One line per stack with the time in microseconds
+  for (const auto& it : m_stacks) {
+    if (it.second > 0)
+      f << it.first << ' ' << it.second << '\n';
+  }
+  return bool(f);
+}
+
+} // namespace script
+} // namespace app
@@ -0,0 +1,109 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_SCRIPT_PROFILER_H_INCLUDED
+#define APP_SCRIPT_PROFILER_H_INCLUDED
+#pragma once
+
+#ifndef ENABLE_SCRIPTING
+  #error ENABLE_SCRIPTING must be defined
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+struct lua_State;
+struct lua_Debug;
+
+namespace app {
+namespace script {
+
+  // Sampling profiler for Lua code. Each "sampleInterval" Lua
+  // instructions the current Lua stack is sampled, and the wall time
+  // elapsed since the previous sample is added to that stack. The
+  // places where the C++ code calls Lua functions (event handlers,
+  // plugin commands, dialogs, timers, etc.) use a Profiler::Call to
+  // restart the time measurement, so the time where the app is idle
+  // is not included.
+  class Profiler {
+    using Clock = std::chrono::steady_clock;
+  public:
+    // Measures the time of a call from C++ to a Lua function
+    // (e.g. a handler of app.events). The total time of each handler
+    // is accumulated by function and by extension (even if the
+    // handler is too fast to be sampled).
+    class Call {
+    public:
+      // "funcIndex" is the stack index of the function to be called
+      Call(lua_State* L, int funcIndex, const char* label);
+      ~Call();
+    private:
+      Profiler* m_profiler;
+      int m_session;
+      bool m_topLevel;
+      std::string m_frame;      // Frame name of the function
+      std::string m_handler;    // Label + function location
+      std::string m_extension;  // Extension of the function (top-level calls only)
+      Clock::time_point m_start;
+    };
+
+    // Installs the profiler hook in the given Lua state. Returns false
+    // if there is another hook (e.g. the debugger is running).
+    static bool start(lua_State* L, int sampleInterval);
+
+    // Stops the profiler, returns a text report with the measured
+    // times (per handler, per extension, and per function), and
+    // saves all the sampled stacks in "foldedStacksFilename" (if it's
+    // not empty) using the collapsed stacks format, which can be
+    // used to create flame graphs (e.g. with flamegraph.pl or
+    // speedscope).
+    static std::string stop(lua_State* L,
+                            const std::string& foldedStacksFilename);
+
+    static bool isRunning() { return s_profiler != nullptr; }
+
+  private:
+    struct Timing {
+      int calls = 0;
+      int64_t total = 0;        // In microseconds
+      int64_t max = 0;
+    };
+
+    static void hook(lua_State* L, lua_Debug* ar);
+
+    void sample(lua_State* L);
+    void addTime(const std::string& stack,
+                 const std::string& leaf,
+                 const int64_t usecs);
+    std::string extensionName(const std::string& source);
+    std::string report() const;
+    bool saveFoldedStacks(const std::string& filename) const;
+
+    static Profiler* s_profiler;
+
+    std::string m_label;      // Label of the current top-level call
+    Clock::time_point m_lastSample;
+    int m_samples = 0;
+
+    // Sampled time by stack (frames separated by ';', from the
+    // outermost call to the innermost one) and by function (self
+    // time).
+    std::map<std::string, int64_t> m_stacks;
+    std::map<std::string, int64_t> m_functions;
+
+    // Time of each handler called from C++ and by extension
+    std::map<std::string, Timing> m_handlers;
+    std::map<std::string, Timing> m_extensions;
+    std::unordered_map<std::string, std::string> m_sourceExtension;
+  };
+
+} // namespace script
+} // namespace app
+
+#endif
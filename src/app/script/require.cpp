@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (c) 2023  Igara Studio S.A.
+// Copyright (c) 2023-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -11,6 +11,7 @@
 #include "app/script/require.h"
 
 #include "app/extensions.h"
+#include "app/script/bytecode_cache.h"
 
 #include <cstring>
 
@@ -30,8 +31,24 @@ static void eval_code(lua_State* L, const char* code)
   }
 }
 
+// Loads a module file using the bytecode cache, returns the chunk or
+// nil + the error message (like loadfile())
+static int load_module_file(lua_State* L)
+{
+  const char* filename = luaL_checkstring(L, 1);
+  if (load_file_with_cache(L, filename) != LUA_OK) {
+    lua_pushnil(L);
+    lua_insert(L, -2);
+    return 2;
+  }
+  return 1;
+}
+
 void custom_require_function(lua_State* L)
 {
+  lua_pushcfunction(L, load_module_file);
+  lua_setglobal(L, "__load_module_file");
+
   eval_code(L, R"(
 _PACKAGE_PATH_STACK = {}
 
@@ -44,12 +61,25 @@ function require(name)
   return origRequire(name)
 end
 
-local origLuaSearcher = package.searchers[2]
+local loadModuleFile = __load_module_file
+__load_module_file = nil
+
+-- Same as the original Lua searcher but loading the compiled
+-- bytecode of the module from the cache
 package.searchers[2] = function(name)
   if _PLUGIN then
     name = name:sub(#_PLUGIN.name+2)
   end
-  return origLuaSearcher(name)
+  local filename, err = package.searchpath(name, package.path)
+  if not filename then
+    return "\n\t" .. err
+  end
+  local chunk, msg = loadModuleFile(filename)
+  if not chunk then
+    error(string.format("error loading module '%s' from file '%s':\n\t%s",
+                        name, filename, msg), 2)
+  end
+  return chunk, filename
 end
 )");
 }
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2015-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -31,6 +31,7 @@
 #include "app/cmd/set_sprite_size.h"
 #include "app/cmd/set_sprite_tile_management_plugin.h"
 #include "app/cmd/set_transparent_color.h"
+#include "app/cmd_transaction.h"
 #include "app/color_spaces.h"
 #include "app/commands/commands.h"
 #include "app/commands/params.h"
@@ -52,6 +53,7 @@
 #include "app/transaction.h"
 #include "app/tx.h"
 #include "app/ui/doc_view.h"
+#include "app/util/memory_usage.h"
 #include "base/convert_to.h"
 #include "base/fs.h"
 #include "doc/layer.h"
@@ -63,6 +65,7 @@
 #include "doc/tag.h"
 #include "doc/tileset.h"
 #include "doc/tilesets.h"
+#include "undo/undo_state.h"
 
 #include <algorithm>
 
@@ -763,6 +766,55 @@ int Sprite_get_events(lua_State* L)
   return 1;
 }
 
+// Returns an array with information about each undo state: its
+// label, used memory (in bytes), execution time, and last undo/redo
+// time (in seconds).
+int Sprite_get_undoHistory(lua_State* L)
+{
+  auto sprite = get_docobj<Sprite>(L, 1);
+  Doc* doc = static_cast<Doc*>(sprite->document());
+  const DocUndo* undo = doc->undoHistory();
+
+  lua_newtable(L);
+  int i = 0;
+  for (const undo::UndoState* state = undo->firstState();
+       state; state = state->next()) {
+    auto cmd = static_cast<const CmdTransaction*>(state->cmd());
+    lua_newtable(L);
+    lua_pushstring(L, cmd->label().c_str());
+    lua_setfield(L, -2, "label");
+    setfield_uinteger(L, "memSize", cmd->memSize());
+    lua_pushnumber(L, cmd->executionTime());
+    lua_setfield(L, -2, "executionTime");
+    lua_pushnumber(L, cmd->undoTime());
+    lua_setfield(L, -2, "undoTime");
+    lua_pushboolean(L, state == undo->currentState());
+    lua_setfield(L, -2, "isCurrent");
+    lua_seti(L, -2, ++i);
+  }
+  return 1;
+}
+
+// Returns a table with the approximated memory (in bytes) used by
+// each part of the document.
+int Sprite_get_memoryUsage(lua_State* L)
+{
+  auto sprite = get_docobj<Sprite>(L, 1);
+  const Doc* doc = static_cast<const Doc*>(sprite->document());
+  const DocMemoryUsage usage = get_doc_memory_usage(doc);
+
+  lua_newtable(L);
+  setfield_uinteger(L, "images", usage.images);
+  setfield_uinteger(L, "cels", usage.cels);
+  setfield_uinteger(L, "tilesets", usage.tilesets);
+  setfield_uinteger(L, "palettes", usage.palettes);
+  setfield_uinteger(L, "selection", usage.masks);
+  setfield_uinteger(L, "undoHistory", usage.undo);
+  setfield_uinteger(L, "extra", usage.extra);
+  setfield_uinteger(L, "total", usage.total());
+  return 1;
+}
+
 int Sprite_get_id(lua_State* L)
 {
   auto sprite = get_docobj<Sprite>(L, 1);
@@ -1076,6 +1128,8 @@ const Property Sprite_properties[] = {
   { "properties", UserData_get_properties<Sprite>, UserData_set_properties<Sprite> },
   { "pixelRatio", Sprite_get_pixelRatio, Sprite_set_pixelRatio },
   { "events", Sprite_get_events, nullptr },
+  { "undoHistory", Sprite_get_undoHistory, nullptr },
+  { "memoryUsage", Sprite_get_memoryUsage, nullptr },
   { "tileManagementPlugin", Sprite_get_tileManagementPlugin, Sprite_set_tileManagementPlugin },
   { nullptr, nullptr, nullptr }
 };
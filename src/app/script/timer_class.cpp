@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -11,6 +11,7 @@
 #include "app/app.h"
 #include "app/script/engine.h"
 #include "app/script/luacpp.h"
+#include "app/script/profiler.h"
 #include "ui/timer.h"
 
 #include <algorithm>
@@ -74,6 +75,7 @@ int Timer_new(lua_State* L)
             lua_rawgeti(L, LUA_REGISTRYINDEX, timer->runningRef());
             lua_getuservalue(L, -1);
             if (lua_isfunction(L, -1)) {
+              Profiler::Call call(L, -1, "timer");
               if (lua_pcall(L, 0, 0, 0)) {
                 if (const char* s = lua_tostring(L, -1))
                   App::instance()
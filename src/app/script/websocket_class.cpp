@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2021  Igara Studio S.A.
+// Copyright (C) 2021-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -13,14 +13,21 @@
 #include "app/script/engine.h"
 #include "app/script/luacpp.h"
 #include "app/script/security.h"
+#include "doc/image.h"
 #include "ui/timer.h"
 #include "ui/manager.h"
 #include "ui/system.h"
 
 #include <ixwebsocket/IXNetSystem.h>
 #include <ixwebsocket/IXWebSocket.h>
-#include <sstream>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace app {
 namespace script {
@@ -33,6 +40,36 @@ namespace {
 static std::unique_ptr<ui::Timer> g_timer;
 static std::set<ix::WebSocket*> g_connections;
 
+// Messages received in the WebSocket thread waiting to be delivered
+// to the onreceive callback. All pending messages are delivered in
+// one UI thread call (instead of one call per message) so a fast
+// stream of messages doesn't flood the UI event queue.
+struct Inbox {
+  using Message = std::pair<int, std::string>;
+  std::mutex mutex;
+  std::vector<Message> messages;
+  bool scheduled = false;
+};
+
+// ix::WebSocket with the options to limit the outgoing data
+class WebSocketObj : public ix::WebSocket {
+public:
+  // If it's > 0, messages are dropped (the send functions return
+  // false) when there are more than this number of bytes waiting
+  // to be sent (e.g. when the receiver is slower than the sender)
+  size_t maxBufferedAmount = 0;
+  int droppedMessages = 0;
+
+  bool canSend(const size_t size) {
+    if (maxBufferedAmount > 0 &&
+        bufferedAmount() + size > maxBufferedAmount) {
+      ++droppedMessages;
+      return false;
+    }
+    return true;
+  }
+};
+
 static void close_ws(ix::WebSocket* ws)
 {
   ws->stop();
@@ -47,7 +84,7 @@ int WebSocket_new(lua_State* L)
   static std::once_flag f;
   std::call_once(f, &ix::initNetSystem);
 
-  auto ws = new ix::WebSocket();
+  auto ws = new WebSocketObj();
 
   push_ptr(L, ws);
 
@@ -82,25 +119,49 @@ int WebSocket_new(lua_State* L)
     }
     lua_pop(L, 1);
 
+    type = lua_getfield(L, 1, "maxbufferedamount");
+    if (type == LUA_TNUMBER) {
+      ws->maxBufferedAmount = std::max<lua_Integer>(0, lua_tointeger(L, -1));
+    }
+    lua_pop(L, 1);
+
     type = lua_getfield(L, 1, "onreceive");
     if (type == LUA_TFUNCTION) {
       int onreceiveRef = luaL_ref(L, LUA_REGISTRYINDEX);
+      auto inbox = std::make_shared<Inbox>();
 
       ws->setOnMessageCallback(
-        [L, ws, onreceiveRef](const ix::WebSocketMessagePtr& msg) {
+        [L, ws, onreceiveRef, inbox](const ix::WebSocketMessagePtr& msg) {
           int msgType =
             (msg->binary ? MESSAGE_TYPE_BINARY : static_cast<int>(msg->type));
-          std::string msgData = msg->str;
-
-          ui::execute_from_ui_thread([=]() {
-            lua_rawgeti(L, LUA_REGISTRYINDEX, onreceiveRef);
-            lua_pushinteger(L, msgType);
-            lua_pushlstring(L, msgData.c_str(), msgData.length());
+          {
+            const std::lock_guard lock(inbox->mutex);
+            inbox->messages.emplace_back(msgType, msg->str);
+            if (inbox->scheduled)
+              return;
+            inbox->scheduled = true;
+          }
+
+          ui::execute_from_ui_thread([L, ws, onreceiveRef, inbox]() {
+            std::vector<Inbox::Message> messages;
+            {
+              const std::lock_guard lock(inbox->mutex);
+              std::swap(messages, inbox->messages);
+              inbox->scheduled = false;
+            }
 
-            if (lua_pcall(L, 2, 0, 0)) {
-              if (const char* s = lua_tostring(L, -1)) {
-                App::instance()->scriptEngine()->consolePrint(s);
-                ws->stop();
+            for (const auto& msg : messages) {
+              lua_rawgeti(L, LUA_REGISTRYINDEX, onreceiveRef);
+              lua_pushinteger(L, msg.first);
+              lua_pushlstring(L, msg.second.c_str(), msg.second.length());
+
+              if (lua_pcall(L, 2, 0, 0)) {
+                if (const char* s = lua_tostring(L, -1)) {
+                  App::instance()->scriptEngine()->consolePrint(s);
+                  ws->stop();
+                }
+                lua_pop(L, 1);
+                break;
               }
             }
           });
@@ -118,61 +179,96 @@ int WebSocket_new(lua_State* L)
 
 int WebSocket_gc(lua_State* L)
 {
-  auto ws = get_ptr<ix::WebSocket>(L, 1);
+  auto ws = get_ptr<WebSocketObj>(L, 1);
   close_ws(ws);
   delete ws;
   return 0;
 }
 
+// Joins all the arguments from "index" (strings or images) in one
+// buffer. The pixels of images are copied directly to the buffer
+// (without creating a Lua string, as Image.bytes would do).
+std::string get_message_data(lua_State* L, int index)
+{
+  const int argc = lua_gettop(L);
+
+  // Calculate the total size to allocate the buffer only once
+  size_t size = 0;
+  for (int i=index; i<=argc; ++i) {
+    if (const doc::Image* img = may_get_image_from_arg(L, i)) {
+      size += img->rowBytes() * img->height();
+    }
+    else {
+      size_t len = 0;
+      luaL_checklstring(L, i, &len);
+      size += len;
+    }
+  }
+
+  std::string data;
+  data.reserve(size);
+  for (int i=index; i<=argc; ++i) {
+    if (const doc::Image* img = may_get_image_from_arg(L, i)) {
+      data.append((const char*)img->getPixelAddress(0, 0),
+                  img->rowBytes() * img->height());
+    }
+    else {
+      size_t len;
+      const char* buf = lua_tolstring(L, i, &len);
+      data.append(buf, len);
+    }
+  }
+  return data;
+}
+
+// Returns true if the message was sent (or queued to be sent), or
+// false if it was dropped because the "maxbufferedamount" limit was
+// reached.
 int WebSocket_sendText(lua_State* L)
 {
-  auto ws = get_ptr<ix::WebSocket>(L, 1);
+  auto ws = get_ptr<WebSocketObj>(L, 1);
 
   if (ws->getReadyState() != ix::ReadyState::Open) {
     return luaL_error(L, "WebSocket is not connected, can't send text");
   }
 
-  std::stringstream data;
-  int argc = lua_gettop(L);
-
-  for (int i = 2; i <= argc; i++) {
-    size_t bufLen;
-    const char* buf = lua_tolstring(L, i, &bufLen);
-    data.write(buf, bufLen);
+  const std::string data = get_message_data(L, 2);
+  if (!ws->canSend(data.size())) {
+    lua_pushboolean(L, false);
+    return 1;
   }
 
-  if (!ws->sendText(data.str()).success) {
+  if (!ws->sendText(data).success) {
     return luaL_error(L, "WebSocket failed to send text");
   }
-  return 0;
+  lua_pushboolean(L, true);
+  return 1;
 }
 
 int WebSocket_sendBinary(lua_State* L)
 {
-  auto ws = get_ptr<ix::WebSocket>(L, 1);
+  auto ws = get_ptr<WebSocketObj>(L, 1);
 
   if (ws->getReadyState() != ix::ReadyState::Open) {
     return luaL_error(L, "WebSocket is not connected, can't send data");
   }
 
-  std::stringstream data;
-  int argc = lua_gettop(L);
-
-  for (int i = 2; i <= argc; i++) {
-    size_t bufLen;
-    const char* buf = lua_tolstring(L, i, &bufLen);
-    data.write(buf, bufLen);
+  const std::string data = get_message_data(L, 2);
+  if (!ws->canSend(data.size())) {
+    lua_pushboolean(L, false);
+    return 1;
   }
 
-  if (!ws->sendBinary(data.str()).success) {
+  if (!ws->sendBinary(data).success) {
     return luaL_error(L, "WebSocket failed to send data");
   }
-  return 0;
+  lua_pushboolean(L, true);
+  return 1;
 }
 
 int WebSocket_sendPing(lua_State* L)
 {
-  auto ws = get_ptr<ix::WebSocket>(L, 1);
+  auto ws = get_ptr<WebSocketObj>(L, 1);
 
   if (ws->getReadyState() != ix::ReadyState::Open) {
     return luaL_error(L, "WebSocket is not connected, can't send ping");
@@ -190,7 +286,7 @@ int WebSocket_sendPing(lua_State* L)
 
 int WebSocket_connect(lua_State* L)
 {
-  auto ws = get_ptr<ix::WebSocket>(L, 1);
+  auto ws = get_ptr<WebSocketObj>(L, 1);
   ws->start();
 
   if (g_connections.empty()) {
@@ -208,18 +304,32 @@ int WebSocket_connect(lua_State* L)
 
 int WebSocket_close(lua_State* L)
 {
-  auto ws = get_ptr<ix::WebSocket>(L, 1);
+  auto ws = get_ptr<WebSocketObj>(L, 1);
   close_ws(ws);
   return 0;
 }
 
 int WebSocket_get_url(lua_State* L)
 {
-  auto ws = get_ptr<ix::WebSocket>(L, 1);
+  auto ws = get_ptr<WebSocketObj>(L, 1);
   lua_pushstring(L, ws->getUrl().c_str());
   return 1;
 }
 
+int WebSocket_get_bufferedAmount(lua_State* L)
+{
+  auto ws = get_ptr<WebSocketObj>(L, 1);
+  lua_pushinteger(L, ws->bufferedAmount());
+  return 1;
+}
+
+int WebSocket_get_droppedMessages(lua_State* L)
+{
+  auto ws = get_ptr<WebSocketObj>(L, 1);
+  lua_pushinteger(L, ws->droppedMessages);
+  return 1;
+}
+
 const luaL_Reg WebSocket_methods[] = {
   { "__gc", WebSocket_gc },
   { "close", WebSocket_close },
@@ -232,16 +342,18 @@ const luaL_Reg WebSocket_methods[] = {
 
 const Property WebSocket_properties[] = {
   { "url", WebSocket_get_url, nullptr },
+  { "bufferedAmount", WebSocket_get_bufferedAmount, nullptr },
+  { "droppedMessages", WebSocket_get_droppedMessages, nullptr },
   { nullptr, nullptr, nullptr }
 };
 
 } // anonymous namespace
 
-using WebSocket = ix::WebSocket;
-DEF_MTNAME(WebSocket);
+DEF_MTNAME(WebSocketObj);
 
 void register_websocket_class(lua_State* L)
 {
+  using WebSocket = WebSocketObj;
   REG_CLASS(L, WebSocket);
   REG_CLASS_NEW(L, WebSocket);
   REG_CLASS_PROPERTIES(L, WebSocket);
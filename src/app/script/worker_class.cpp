@@ -0,0 +1,363 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/app.h"
+#include "app/script/engine.h"
+#include "app/script/luacpp.h"
+#include "ui/system.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace app {
+namespace script {
+
+namespace {
+
+// Runs a chunk of Lua code in its own lua_State in a background
+// thread. The worker state doesn't have access to the app API
+// (sprites, app.command, etc. must be used from the UI thread), only
+// to the standard Lua libraries (without io/os/package), to the
+// string arguments given in Worker{ args={...} } (e.g. Image.bytes
+// to analyze a copy of an image), and to postMessage(string) to
+// send messages to the onmessage() callback.
+class Worker {
+public:
+  Worker(std::string&& code,
+         std::vector<std::string>&& args)
+    : m_code(std::move(code))
+    , m_args(std::move(args)) {
+  }
+
+  // Stops and waits the thread (the stop hook is checked each 10000
+  // instructions)
+  ~Worker() {
+    stop();
+    join();
+  }
+
+  bool isRunning() const { return m_running; }
+
+  void start() {
+    if (m_running || m_thread.joinable())
+      return;
+    m_running = true;
+    m_thread = std::thread([this]{ run(); });
+  }
+
+  void stop() { m_stop = true; }
+
+  void join() {
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+
+  // Called from the UI thread to get the pending messages
+  std::vector<std::string> fetchMessages() {
+    const std::lock_guard lock(m_mutex);
+    return std::move(m_messages);
+  }
+
+  // Returns true only once when the worker has finished (so the
+  // onfinish() callback is called once)
+  bool fetchFinished(std::string& result, std::string& error) {
+    const std::lock_guard lock(m_mutex);
+    if (!m_finished || m_finishedFetched)
+      return false;
+    m_finishedFetched = true;
+    result = m_result;
+    error = m_error;
+    return true;
+  }
+
+  // Registry references of the onmessage/onfinish callbacks and the
+  // Worker userdata itself (to keep it alive while it's running).
+  // These are only used from the UI thread.
+  int onmessageRef = LUA_REFNIL;
+  int onfinishRef = LUA_REFNIL;
+  int runningRef = LUA_REFNIL;
+
+  // Function to notify the UI thread that there are new
+  // messages/results to deliver.
+  std::function<void()> notify;
+
+private:
+  static int postMessage(lua_State* L) {
+    auto worker = (Worker*)lua_touserdata(L, lua_upvalueindex(1));
+    size_t len;
+    const char* s = luaL_checklstring(L, 1, &len);
+    {
+      const std::lock_guard lock(worker->m_mutex);
+      worker->m_messages.emplace_back(s, len);
+    }
+    if (worker->notify)
+      worker->notify();
+    return 0;
+  }
+
+  static void stopHook(lua_State* L, lua_Debug*) {
+    lua_getfield(L, LUA_REGISTRYINDEX, "__worker");
+    auto worker = (Worker*)lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    if (worker && worker->m_stop)
+      luaL_error(L, "worker stopped");
+  }
+
+  void run() {
+    std::string result, error;
+
+    lua_State* L = luaL_newstate();
+    const luaL_Reg libs[] = {
+      { "_G", luaopen_base },
+      { LUA_COLIBNAME, luaopen_coroutine },
+      { LUA_TABLIBNAME, luaopen_table },
+      { LUA_STRLIBNAME, luaopen_string },
+      { LUA_MATHLIBNAME, luaopen_math },
+      { LUA_UTF8LIBNAME, luaopen_utf8 },
+    };
+    for (const auto& lib : libs) {
+      luaL_requiref(L, lib.name, lib.func, 1);
+      lua_pop(L, 1);
+    }
+    // Remove base functions that access files
+    for (const char* name : { "dofile", "loadfile" }) {
+      lua_pushnil(L);
+      lua_setglobal(L, name);
+    }
+
+    lua_pushlightuserdata(L, this);
+    lua_setfield(L, LUA_REGISTRYINDEX, "__worker");
+    lua_pushlightuserdata(L, this);
+    lua_pushcclosure(L, &Worker::postMessage, 1);
+    lua_setglobal(L, "postMessage");
+    lua_sethook(L, &Worker::stopHook, LUA_MASKCOUNT, 10000);
+
+    if (luaL_loadbuffer(L, m_code.c_str(), m_code.size(), "=worker") == LUA_OK) {
+      for (const auto& arg : m_args)
+        lua_pushlstring(L, arg.c_str(), arg.size());
+
+      if (lua_pcall(L, int(m_args.size()), 1, 0) == LUA_OK) {
+        size_t len;
+        if (const char* s = lua_tolstring(L, -1, &len))
+          result.assign(s, len);
+      }
+      else if (const char* s = lua_tostring(L, -1))
+        error = s;
+    }
+    else if (const char* s = lua_tostring(L, -1))
+      error = s;
+    lua_close(L);
+
+    {
+      const std::lock_guard lock(m_mutex);
+      m_result = std::move(result);
+      m_error = std::move(error);
+      m_finished = true;
+    }
+    m_running = false;
+    if (notify)
+      notify();
+  }
+
+  std::string m_code;
+  std::vector<std::string> m_args;
+  std::thread m_thread;
+  std::atomic<bool> m_running = false;
+  std::atomic<bool> m_stop = false;
+
+  std::mutex m_mutex;
+  std::vector<std::string> m_messages;
+  bool m_finished = false;
+  bool m_finishedFetched = false;
+  std::string m_result;
+  std::string m_error;
+};
+
+struct WorkerObj {
+  std::shared_ptr<Worker> worker;
+  WorkerObj(std::shared_ptr<Worker>&& worker)
+    : worker(std::move(worker)) {
+  }
+  WorkerObj(const WorkerObj&) = delete;
+  WorkerObj& operator=(const WorkerObj&) = delete;
+};
+
+// Calls the callback with the given string arguments (empty strings
+// after the first one are converted to nil)
+void call_callback(lua_State* L, const int ref, const std::string* args, const int nargs)
+{
+  if (ref == LUA_REFNIL)
+    return;
+
+  lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+  for (int i=0; i<nargs; ++i) {
+    if (args[i].empty() && i > 0)
+      lua_pushnil(L);
+    else
+      lua_pushlstring(L, args[i].c_str(), args[i].size());
+  }
+  if (lua_pcall(L, nargs, 0, 0)) {
+    if (const char* s = lua_tostring(L, -1))
+      App::instance()->scriptEngine()->consolePrint(s);
+    lua_pop(L, 1);
+  }
+}
+
+// Delivers all pending messages and the final result of the worker
+// to the Lua callbacks (from the UI thread).
+void deliver_messages(lua_State* L, Worker* worker)
+{
+  for (const std::string& msg : worker->fetchMessages())
+    call_callback(L, worker->onmessageRef, &msg, 1);
+
+  std::string res[2];
+  if (worker->fetchFinished(res[0], res[1])) {
+    call_callback(L, worker->onfinishRef, res, 2);
+
+    luaL_unref(L, LUA_REGISTRYINDEX, worker->onmessageRef);
+    luaL_unref(L, LUA_REGISTRYINDEX, worker->onfinishRef);
+    worker->onmessageRef = worker->onfinishRef = LUA_REFNIL;
+
+    // Now the Worker object can be garbage collected
+    luaL_unref(L, LUA_REGISTRYINDEX, worker->runningRef);
+    worker->runningRef = LUA_REFNIL;
+  }
+}
+
+int Worker_new(lua_State* L)
+{
+  std::string code;
+  std::vector<std::string> args;
+  int onmessageRef = LUA_REFNIL;
+  int onfinishRef = LUA_REFNIL;
+
+  luaL_checktype(L, 1, LUA_TTABLE);
+
+  size_t len;
+  lua_getfield(L, 1, "code");
+  if (const char* s = lua_tolstring(L, -1, &len))
+    code.assign(s, len);
+  lua_pop(L, 1);
+  if (code.empty())
+    return luaL_error(L, "Worker{ code=... } is required");
+
+  if (lua_getfield(L, 1, "args") == LUA_TTABLE) {
+    const int n = int(luaL_len(L, -1));
+    for (int i=1; i<=n; ++i) {
+      lua_geti(L, -1, i);
+      const char* s = lua_tolstring(L, -1, &len);
+      args.emplace_back(s ? std::string(s, len): std::string());
+      lua_pop(L, 1);
+    }
+  }
+  lua_pop(L, 1);
+
+  if (lua_getfield(L, 1, "onmessage") == LUA_TFUNCTION)
+    onmessageRef = luaL_ref(L, LUA_REGISTRYINDEX);
+  else
+    lua_pop(L, 1);
+
+  if (lua_getfield(L, 1, "onfinish") == LUA_TFUNCTION)
+    onfinishRef = luaL_ref(L, LUA_REGISTRYINDEX);
+  else
+    lua_pop(L, 1);
+
+  auto worker = std::make_shared<Worker>(std::move(code), std::move(args));
+  worker->onmessageRef = onmessageRef;
+  worker->onfinishRef = onfinishRef;
+
+  std::weak_ptr<Worker> weak(worker);
+  worker->notify = [L, weak]{
+    ui::execute_from_ui_thread([L, weak]{
+      if (auto worker = weak.lock())
+        deliver_messages(L, worker.get());
+    });
+  };
+
+  push_new<WorkerObj>(L, std::move(worker));
+  return 1;
+}
+
+int Worker_gc(lua_State* L)
+{
+  get_obj<WorkerObj>(L, 1)->~WorkerObj();
+  return 0;
+}
+
+int Worker_start(lua_State* L)
+{
+  auto obj = get_obj<WorkerObj>(L, 1);
+  // Keep the Worker alive while it's running to call its callbacks
+  if (obj->worker->runningRef == LUA_REFNIL &&
+      (obj->worker->onmessageRef != LUA_REFNIL ||
+       obj->worker->onfinishRef != LUA_REFNIL)) {
+    lua_pushvalue(L, 1);
+    obj->worker->runningRef = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
+  obj->worker->start();
+  return 0;
+}
+
+int Worker_stop(lua_State* L)
+{
+  auto obj = get_obj<WorkerObj>(L, 1);
+  obj->worker->stop();
+  return 0;
+}
+
+// Waits the worker to finish and delivers all its messages (useful
+// in batch mode, where there is no UI loop to deliver them)
+int Worker_wait(lua_State* L)
+{
+  auto obj = get_obj<WorkerObj>(L, 1);
+  obj->worker->join();
+  deliver_messages(L, obj->worker.get());
+  return 0;
+}
+
+int Worker_get_isRunning(lua_State* L)
+{
+  auto obj = get_obj<WorkerObj>(L, 1);
+  lua_pushboolean(L, obj->worker->isRunning());
+  return 1;
+}
+
+const luaL_Reg Worker_methods[] = {
+  { "__gc", Worker_gc },
+  { "start", Worker_start },
+  { "stop", Worker_stop },
+  { "wait", Worker_wait },
+  { nullptr, nullptr }
+};
+
+const Property Worker_properties[] = {
+  { "isRunning", Worker_get_isRunning, nullptr },
+  { nullptr, nullptr, nullptr }
+};
+
+} // anonymous namespace
+
+DEF_MTNAME(WorkerObj);
+
+void register_worker_class(lua_State* L)
+{
+  using Worker = WorkerObj;
+  REG_CLASS(L, Worker);
+  REG_CLASS_NEW(L, Worker);
+  REG_CLASS_PROPERTIES(L, Worker);
+}
+
+} // namespace script
+} // namespace app
@@ -0,0 +1,253 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/thumbnail_cache.h"
+
+#include "base/file_handle.h"
+#include "base/fs.h"
+#include "base/time.h"
+#include "doc/image.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Increment this version each time the format of the cache files
+// changes, so old files are ignored.
+#define THUMBNAIL_CACHE_MAGIC    0x4d485441 // "ATHM"
+#define THUMBNAIL_CACHE_VERSION  1
+
+namespace app {
+
+namespace {
+
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t fileSize;
+  int32_t time[6];              // Modification time of the file
+  uint32_t pathLength;
+  uint16_t width;
+  uint16_t height;
+};
+
+bool fill_header(const std::string& filename, Header& header)
+{
+  if (!base::is_file(filename))
+    return false;
+
+  const base::Time time = base::get_modification_time(filename);
+  header.magic = THUMBNAIL_CACHE_MAGIC;
+  header.version = THUMBNAIL_CACHE_VERSION;
+  header.fileSize = base::file_size(filename);
+  header.time[0] = time.year;
+  header.time[1] = time.month;
+  header.time[2] = time.day;
+  header.time[3] = time.hour;
+  header.time[4] = time.minute;
+  header.time[5] = time.second;
+  header.pathLength = uint32_t(filename.size());
+  header.width = 0;
+  header.height = 0;
+  return true;
+}
+
+} // anonymous namespace
+
+ThumbnailCache::ThumbnailCache(const std::string& dir,
+                               const std::size_t maxSize)
+  : m_dir(dir)
+  , m_maxSize(maxSize)
+{
+  if (!m_dir.empty() && !base::is_directory(m_dir)) {
+    try {
+      base::make_all_directories(m_dir);
+    }
+    catch (const std::exception&) {
+      // Without a directory the cache is just disabled
+      m_dir.clear();
+    }
+  }
+  if (m_dir.empty())
+    return;
+
+  // Add the files of previous sessions to the LRU list, the oldest
+  // ones first so they are the first ones to be deleted.
+  std::vector<std::pair<base::Time, Entry>> files;
+  for (const auto& item : base::list_files(m_dir)) {
+    if (base::get_file_extension(item) != "thumb")
+      continue;
+
+    std::string fn = base::join_path(m_dir, item);
+    files.emplace_back(base::get_modification_time(fn),
+                       Entry{ fn, std::size_t(base::file_size(fn)) });
+  }
+  std::sort(files.begin(), files.end(),
+            [](const auto& a, const auto& b){
+              return a.first < b.first;
+            });
+  for (const auto& file : files)
+    add(file.second.fn, file.second.size);
+}
+
+doc::ImageRef ThumbnailCache::load(const std::string& filename) const
+{
+  Header expected;
+  if (m_dir.empty() || !fill_header(filename, expected))
+    return nullptr;
+
+  const std::string fn = cacheFilename(filename);
+  base::FileHandle handle(base::open_file(fn, "rb"));
+  FILE* f = handle.get();
+  if (!f)
+    return nullptr;
+
+  Header header;
+  if (fread(&header, sizeof(Header), 1, f) != 1 ||
+      header.magic != expected.magic ||
+      header.version != expected.version ||
+      header.fileSize != expected.fileSize ||
+      !std::equal(header.time, header.time+6, expected.time) ||
+      header.pathLength != expected.pathLength ||
+      header.width == 0 ||
+      header.height == 0)
+    return nullptr;
+
+  // Different files can generate the same hash, so we compare the
+  // full path too.
+  std::string path(header.pathLength, 0);
+  if (fread(&path[0], 1, path.size(), f) != path.size() ||
+      path != filename)
+    return nullptr;
+
+  doc::ImageRef image(
+    doc::Image::create(doc::IMAGE_RGB, header.width, header.height));
+  for (int y=0; y<image->height(); ++y) {
+    if (fread(image->getPixelAddress(0, y),
+              image->widthBytes(), 1, f) != 1)
+      return nullptr;
+  }
+  touch(fn);
+  return image;
+}
+
+void ThumbnailCache::save(const std::string& filename,
+                          const doc::Image* thumbnail) const
+{
+  ASSERT(thumbnail->pixelFormat() == doc::IMAGE_RGB);
+
+  Header header;
+  if (m_dir.empty() || !fill_header(filename, header))
+    return;
+
+  header.width = uint16_t(thumbnail->width());
+  header.height = uint16_t(thumbnail->height());
+
+  const std::string fn = cacheFilename(filename);
+  bool ok = false;
+  {
+    base::FileHandle handle(base::open_file(fn, "wb"));
+    FILE* f = handle.get();
+    if (!f)
+      return;
+
+    ok = (fwrite(&header, sizeof(Header), 1, f) == 1 &&
+          fwrite(filename.c_str(), 1, filename.size(), f) == filename.size());
+    for (int y=0; ok && y<thumbnail->height(); ++y) {
+      ok = (fwrite(thumbnail->getPixelAddress(0, y),
+                   thumbnail->widthBytes(), 1, f) == 1);
+    }
+  }
+
+  // Don't leave incomplete files in the cache
+  if (!ok) {
+    remove(fn);
+    try {
+      base::delete_file(fn);
+    }
+    catch (const std::exception&) {
+      // Ignore errors
+    }
+    return;
+  }
+
+  add(fn, sizeof(Header) + filename.size()
+          + std::size_t(thumbnail->widthBytes()) * thumbnail->height());
+}
+
+std::string ThumbnailCache::cacheFilename(const std::string& filename) const
+{
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%016llx.thumb",
+                (unsigned long long)std::hash<std::string>()(filename));
+  return base::join_path(m_dir, buf);
+}
+
+void ThumbnailCache::touch(const std::string& fn) const
+{
+  const std::lock_guard lock(m_mutex);
+  auto it = m_map.find(fn);
+  if (it != m_map.end())
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+}
+
+void ThumbnailCache::add(const std::string& fn,
+                         const std::size_t size) const
+{
+  std::vector<std::string> deleted;
+  {
+    const std::lock_guard lock(m_mutex);
+    auto it = m_map.find(fn);
+    if (it != m_map.end()) {
+      m_size -= it->second->size;
+      it->second->size = size;
+      m_entries.splice(m_entries.begin(), m_entries, it->second);
+    }
+    else {
+      m_entries.push_front(Entry{ fn, size });
+      m_map[fn] = m_entries.begin();
+    }
+    m_size += size;
+
+    // Delete the least recently used thumbnails (but never the new one)
+    while (m_size > m_maxSize && m_entries.size() > 1) {
+      const Entry& entry = m_entries.back();
+      m_size -= entry.size;
+      deleted.push_back(entry.fn);
+      m_map.erase(entry.fn);
+      m_entries.pop_back();
+    }
+  }
+
+  for (const auto& deletedFn : deleted) {
+    try {
+      base::delete_file(deletedFn);
+    }
+    catch (const std::exception&) {
+      // Ignore errors
+    }
+  }
+}
+
+void ThumbnailCache::remove(const std::string& fn) const
+{
+  const std::lock_guard lock(m_mutex);
+  auto it = m_map.find(fn);
+  if (it != m_map.end()) {
+    m_size -= it->second->size;
+    m_entries.erase(it->second);
+    m_map.erase(it);
+  }
+}
+
+} // namespace app
@@ -0,0 +1,75 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_THUMBNAIL_CACHE_H_INCLUDED
+#define APP_THUMBNAIL_CACHE_H_INCLUDED
+#pragma once
+
+#include "doc/image_ref.h"
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace app {
+
+  // Persistent on-disk cache of file thumbnails. Each thumbnail is
+  // stored as a RGB image (in sRGB) and keyed by the full path of the
+  // original file, its size, and its modification time, so a modified
+  // file invalidates its thumbnail automatically.
+  //
+  // The total size of the cache is limited, the least recently used
+  // thumbnails are deleted when a new one doesn't fit. Between
+  // sessions the order is given by the modification time of the
+  // cache files.
+  //
+  // load() and save() can be called from several threads at the same
+  // time (as long as they use different file names).
+  class ThumbnailCache {
+  public:
+    static constexpr std::size_t kDefaultMaxSize = 64*1024*1024;
+
+    // Creates a cache that stores its files in the given directory
+    // (created if it doesn't exist), using at most maxSize bytes.
+    explicit ThumbnailCache(const std::string& dir,
+                            std::size_t maxSize = kDefaultMaxSize);
+
+    // Returns the cached thumbnail for the given file, or nullptr if
+    // the file doesn't have a valid thumbnail in the cache.
+    doc::ImageRef load(const std::string& filename) const;
+
+    // Saves the thumbnail (a RGB image) of the given file.
+    void save(const std::string& filename,
+              const doc::Image* thumbnail) const;
+
+  private:
+    struct Entry {
+      std::string fn;
+      std::size_t size;
+    };
+    using Entries = std::list<Entry>;
+
+    std::string cacheFilename(const std::string& filename) const;
+    void touch(const std::string& fn) const;
+    void add(const std::string& fn, std::size_t size) const;
+    void remove(const std::string& fn) const;
+
+    std::string m_dir;
+    std::size_t m_maxSize;
+
+    // LRU list of cache files (the most recently used ones are at the
+    // beginning of the list).
+    mutable std::mutex m_mutex;
+    mutable Entries m_entries;
+    mutable std::unordered_map<std::string, Entries::iterator> m_map;
+    mutable std::size_t m_size = 0;
+  };
+
+} // namespace app
+
+#endif
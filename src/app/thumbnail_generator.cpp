@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -16,6 +16,8 @@
 #include "app/doc.h"
 #include "app/file/file.h"
 #include "app/file_system.h"
+#include "app/resource_finder.h"
+#include "app/thumbnail_cache.h"
 #include "app/util/conversion_to_surface.h"
 #include "base/thread.h"
 #include "doc/algorithm/rotate.h"
@@ -38,10 +40,43 @@
 
 namespace app {
 
+// Converts the thumbnail to a RGB image so it can be stored in the
+// ThumbnailCache.
+static ImageRef make_rgb_thumbnail(const Image* image,
+                                   const Palette* palette)
+{
+  ImageRef rgb(Image::create(IMAGE_RGB, image->width(), image->height()));
+  for (int y=0; y<image->height(); ++y) {
+    for (int x=0; x<image->width(); ++x) {
+      const color_t c = get_pixel(image, x, y);
+      color_t rgba;
+      switch (image->pixelFormat()) {
+        case IMAGE_RGB:
+          rgba = c;
+          break;
+        case IMAGE_GRAYSCALE:
+          rgba = doc::rgba(graya_getv(c), graya_getv(c), graya_getv(c),
+                           graya_geta(c));
+          break;
+        case IMAGE_INDEXED:
+          rgba = (int(c) < palette->size() ? palette->getEntry(c): 0);
+          break;
+        default:
+          rgba = 0;
+          break;
+      }
+      put_pixel(rgb.get(), x, y, rgba);
+    }
+  }
+  return rgb;
+}
+
 class ThumbnailGenerator::Worker {
 public:
-  Worker(base::concurrent_queue<ThumbnailGenerator::Item>& queue)
+  Worker(base::concurrent_queue<ThumbnailGenerator::Item>& queue,
+         const ThumbnailCache* cache)
     : m_queue(queue)
+    , m_cache(cache)
     , m_fop(nullptr)
     , m_isDone(false)
     , m_thread([this]{ loadBgThread(); }) {
@@ -85,8 +120,20 @@ private:
         ASSERT(m_fop);
       }
 
-      THUMB_TRACE("FOP loading thumbnail: %s\n",
-                  m_item.fileitem->fileName().c_str());
+      const std::string& filename = m_item.fileitem->fileName();
+
+      // Use the cached thumbnail if the file wasn't modified.
+      if (m_cache) {
+        if (ImageRef cached = m_cache->load(filename)) {
+          THUMB_TRACE("FOP cached thumbnail: %s\n", filename.c_str());
+          setThumbnail(cached.get());
+          delete m_fop->releaseDocument();
+          done();
+          return;
+        }
+      }
+
+      THUMB_TRACE("FOP loading thumbnail: %s\n", filename.c_str());
 
       // Load the file
       m_fop->operate(nullptr);
@@ -157,29 +204,27 @@ private:
 
       // Set the thumbnail of the file-item.
       if (thumbnailImage) {
-        os::SurfaceRef thumbnail =
-          os::instance()->makeRgbaSurface(
-            thumbnailImage->width(),
-            thumbnailImage->height());
+        ImageRef rgbImage = make_rgb_thumbnail(thumbnailImage.get(),
+                                               palette.get());
+        setThumbnail(rgbImage.get());
 
-        convert_image_to_surface(
-          thumbnailImage.get(), palette.get(), thumbnail.get(),
-          0, 0, 0, 0, thumbnailImage->width(), thumbnailImage->height());
-
-        {
-          const std::lock_guard lock(m_mutex);
-          m_item.fileitem->setThumbnail(thumbnail);
-        }
+        if (m_cache && !m_fop->isStop() && !m_fop->hasError())
+          m_cache->save(filename, rgbImage.get());
       }
 
       THUMB_TRACE("FOP done with thumbnail: %s %s\n",
-                  m_item.fileitem->fileName().c_str(),
+                  filename.c_str(),
                   (m_fop->isStop() ? " (stop)": ""));
     }
     catch (const std::exception& e) {
       m_fop->setError("Error loading file:\n%s", e.what());
     }
 
+    done();
+  }
+
+  // Finishes the processing of the current item.
+  void done() {
     if (!m_fop->isStop()) {
       // Set a nullptr thumbnail if we failed loading the given file,
       // in this way we're not going to re-try generating this same
@@ -223,7 +268,23 @@ private:
     m_isDone = true;
   }
 
+  // Converts the RGB thumbnail to a os::Surface for the file-item.
+  void setThumbnail(const Image* rgbImage) {
+    os::SurfaceRef thumbnail =
+      os::instance()->makeRgbaSurface(
+        rgbImage->width(),
+        rgbImage->height());
+
+    convert_image_to_surface(
+      rgbImage, nullptr, thumbnail.get(),
+      0, 0, 0, 0, rgbImage->width(), rgbImage->height());
+
+    const std::lock_guard lock(m_mutex);
+    m_item.fileitem->setThumbnail(thumbnail);
+  }
+
   base::concurrent_queue<Item>& m_queue;
+  const ThumbnailCache* m_cache;
   app::ThumbnailGenerator::Item m_item;
   FileOp* m_fop;
   mutable std::mutex m_mutex;
@@ -249,6 +310,16 @@ ThumbnailGenerator::ThumbnailGenerator()
   int n = std::thread::hardware_concurrency()-1;
   if (n < 1) n = 1;
   m_maxWorkers = n;
+
+  ResourceFinder rf;
+  rf.includeUserDir("thumbnails");
+  m_cache = std::make_unique<ThumbnailCache>(rf.defaultFilename());
+}
+
+ThumbnailGenerator::~ThumbnailGenerator()
+{
+  // Workers must be destroyed before the cache.
+  m_workers.clear();
 }
 
 bool ThumbnailGenerator::checkWorkers()
@@ -318,6 +389,9 @@ void ThumbnailGenerator::generateThumbnail(IFileItem* fileitem)
     return;
   }
 
+  // Formats can decode a reduced version of the image for thumbnails.
+  fop->setThumbnailSize(MAX_THUMBNAIL_SIZE);
+
   m_remainingItems.push(Item(fileitem, fop.get()));
   fop.release();
 
@@ -348,7 +422,7 @@ void ThumbnailGenerator::startWorker()
 {
   const std::lock_guard lock(m_workersAccess);
   if (m_workers.size() < m_maxWorkers) {
-    m_workers.push_back(std::make_unique<Worker>(m_remainingItems));
+    m_workers.push_back(std::make_unique<Worker>(m_remainingItems, m_cache.get()));
   }
 }
 
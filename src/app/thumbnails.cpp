@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 // Copyright (C) 2016  Carlo Caputo
 //
@@ -10,20 +10,139 @@
 #include "config.h"
 #endif
 
+#include "app/thumbnails.h"
+
 #include "app/util/conversion_to_surface.h"
 #include "doc/blend_mode.h"
 #include "doc/cel.h"
 #include "doc/layer.h"
+#include "doc/layer_tilemap.h"
+#include "doc/palette.h"
 #include "doc/sprite.h"
+#include "doc/tileset.h"
 #include "os/surface.h"
 #include "os/system.h"
 #include "render/render.h"
 
+#include <list>
+#include <tuple>
+#include <unordered_map>
+
 namespace app {
 namespace thumb {
 
-os::SurfaceRef get_cel_thumbnail(const doc::Cel* cel,
-                                 const gfx::Size& fitInSize)
+namespace {
+
+// Maximum number of thumbnails in the cache (e.g. all the visible
+// cels in the timeline with some margin to scroll)
+const size_t kMaxCachedThumbnails = 2048;
+
+struct ThumbnailKey {
+  doc::ObjectId imageId;
+  doc::ObjectVersion imageVersion;
+  doc::ObjectId paletteId;
+  int paletteModifications;
+  doc::ObjectId tilesetId;
+  doc::ObjectVersion tilesetVersion;
+  gfx::Size celSize;
+  gfx::Size fitInSize;
+  doc::PixelRatio pixelRatio;
+
+  ThumbnailKey(const doc::Cel* cel,
+               const doc::Palette* palette,
+               const gfx::Size& fitInSize)
+    : imageId(cel->image()->id())
+    , imageVersion(cel->image()->version())
+    , paletteId(palette->id())
+    , paletteModifications(palette->getModifications())
+    , tilesetId(doc::NullId)
+    , tilesetVersion(0)
+    , celSize(cel->bounds().size())
+    , fitInSize(fitInSize)
+    , pixelRatio(cel->sprite()->pixelRatio()) {
+    if (cel->layer()->isTilemap()) {
+      if (auto tileset = static_cast<const doc::LayerTilemap*>(cel->layer())->tileset()) {
+        tilesetId = tileset->id();
+        tilesetVersion = tileset->version();
+      }
+    }
+  }
+
+  bool operator==(const ThumbnailKey& o) const {
+    return
+      std::tie(imageId, imageVersion, paletteId, paletteModifications,
+               tilesetId, tilesetVersion) ==
+      std::tie(o.imageId, o.imageVersion, o.paletteId, o.paletteModifications,
+               o.tilesetId, o.tilesetVersion) &&
+      celSize == o.celSize &&
+      fitInSize == o.fitInSize &&
+      pixelRatio == o.pixelRatio;
+  }
+};
+
+struct ThumbnailKeyHash {
+  size_t operator()(const ThumbnailKey& k) const {
+    size_t h = std::hash<doc::ObjectId>()(k.imageId);
+    auto combine = [&h](const size_t v) {
+      h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+    };
+    combine(k.imageVersion);
+    combine(k.paletteId);
+    combine(k.paletteModifications);
+    combine(k.tilesetId);
+    combine(k.tilesetVersion);
+    combine((k.celSize.w << 16) ^ k.celSize.h);
+    combine((k.fitInSize.w << 16) ^ k.fitInSize.h);
+    return h;
+  }
+};
+
+// LRU cache of thumbnails (the most recently used ones are at the
+// beginning of the list)
+class ThumbnailsCache {
+public:
+  os::SurfaceRef get(const ThumbnailKey& key) {
+    auto it = m_map.find(key);
+    if (it == m_map.end())
+      return nullptr;
+    m_list.splice(m_list.begin(), m_list, it->second);
+    return it->second->second;
+  }
+
+  void add(const ThumbnailKey& key, const os::SurfaceRef& surface) {
+    auto it = m_map.find(key);
+    if (it != m_map.end()) {
+      it->second->second = surface;
+      m_list.splice(m_list.begin(), m_list, it->second);
+      return;
+    }
+    m_list.emplace_front(key, surface);
+    m_map.emplace(key, m_list.begin());
+
+    while (m_list.size() > kMaxCachedThumbnails) {
+      m_map.erase(m_list.back().first);
+      m_list.pop_back();
+    }
+  }
+
+  void clear() {
+    m_map.clear();
+    m_list.clear();
+  }
+
+private:
+  using Entry = std::pair<ThumbnailKey, os::SurfaceRef>;
+  std::list<Entry> m_list;
+  std::unordered_map<ThumbnailKey,
+                     std::list<Entry>::iterator,
+                     ThumbnailKeyHash> m_map;
+};
+
+ThumbnailsCache g_cache;
+
+os::SurfaceRef create_cel_thumbnail(const doc::Cel* cel,
+                                    const doc::Palette* palette,
+                                    const gfx::Size& fitInSize)
 {
   gfx::Size newSize;
 
@@ -46,7 +165,6 @@ os::SurfaceRef get_cel_thumbnail(const doc::Cel* cel,
                           render::Zoom(newSize.w, cel->bounds().w));
   render.setProjection(proj);
 
-  const doc::Palette* palette = cel->sprite()->palette(cel->frame());
   render.renderCel(
     thumbnailImage.get(),
     cel,
@@ -70,5 +188,29 @@ os::SurfaceRef get_cel_thumbnail(const doc::Cel* cel,
     return nullptr;
 }
 
+} // anonymous namespace
+
+os::SurfaceRef get_cel_thumbnail(const doc::Cel* cel,
+                                 const gfx::Size& fitInSize)
+{
+  if (!cel->image())
+    return nullptr;
+
+  const doc::Palette* palette = cel->sprite()->palette(cel->frame());
+  const ThumbnailKey key(cel, palette, fitInSize);
+  if (os::SurfaceRef thumbnail = g_cache.get(key))
+    return thumbnail;
+
+  os::SurfaceRef thumbnail = create_cel_thumbnail(cel, palette, fitInSize);
+  if (thumbnail)
+    g_cache.add(key, thumbnail);
+  return thumbnail;
+}
+
+void clear_thumbnails_cache()
+{
+  g_cache.clear();
+}
+
 } // thumb
 } // app
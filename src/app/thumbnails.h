@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2016  Carlo Caputo
 //
 // This program is distributed under the terms of
@@ -23,9 +23,16 @@ namespace os {
 namespace app {
 namespace thumb {
 
+  // Returns the thumbnail of the cel image to fit in the given
+  // size. Thumbnails are cached (the least recently used ones are
+  // removed from the cache), and regenerated only when the cel
+  // image, its palette, or its tileset are modified.
   os::SurfaceRef get_cel_thumbnail(const doc::Cel* cel,
                                    const gfx::Size& fitInSize);
 
+  // Releases all cached thumbnails.
+  void clear_thumbnails_cache();
+
 } // thumb
 } // app
 
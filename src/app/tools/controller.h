@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -47,6 +47,11 @@ namespace app {
 
       // The input and output strokes are relative to sprite coordinates.
       virtual void getStrokeToInterwine(const Stroke& input, Stroke& output) = 0;
+
+      // Returns true if getStrokeToInterwine() returns only the last
+      // two points of the stroke, so the ToolLoopManager can skip
+      // some steps and then join all the new points in one step.
+      virtual bool canCoalescePoints() const { return false; }
       virtual void getStatusBarText(ToolLoop* loop, const Stroke& stroke, std::string& text) = 0;
 
       // Last point used by this controller, useful to save the last
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -74,6 +74,8 @@ public:
     stroke.addPoint(pt);
   }
 
+  bool canCoalescePoints() const override { return true; }
+
   void getStrokeToInterwine(const Stroke& input, Stroke& output) override {
     if (input.size() == 1) {
       output.addPoint(input[0]);
@@ -514,6 +516,10 @@ public:
     m_controller->getStrokeToInterwine(input, output);
   }
 
+  bool canCoalescePoints() const override {
+    return (m_controller == &m_freehand);
+  }
+
   void getStatusBarText(ToolLoop* loop, const Stroke& stroke, std::string& text) override {
     m_controller->getStatusBarText(loop, stroke, text);
   }
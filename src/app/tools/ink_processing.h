@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -22,6 +22,10 @@
 #include "render/dithering.h"
 #include "render/gradient.h"
 
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
 namespace app {
 namespace tools {
 
@@ -72,7 +76,11 @@ public:
       if (x2 > maskOrigin.x+maskBounds.w-1)
         x2 = maskOrigin.x+maskBounds.w-1;
 
-      if (Image* bitmap = loop->getMask()->bitmap()) {
+      // Rectangular masks are already clipped
+      const Mask* mask = loop->getMask();
+      const Image* bitmap = (mask->isKnownRectangle() ? nullptr:
+                                                        mask->bitmap());
+      if (bitmap) {
         static_cast<Derived*>(this)->initIterators(loop, x1, y);
 
         for (x=x1; x<=x2; ++x) {
@@ -86,13 +94,45 @@ public:
     }
 
     static_cast<Derived*>(this)->initIterators(loop, x1, y);
+
+    // Process the whole scanline at once if the ink supports it
+    if (x1 <= x2 &&
+        static_cast<Derived*>(this)->processSpan(x2-x1+1))
+      return;
+
     for (x=x1; x<=x2; ++x) {
       static_cast<Derived*>(this)->processPixel(x, y);
       static_cast<Derived*>(this)->moveIterators();
     }
   }
+
+  // Can be implemented by inks that are able to process a span of
+  // "w" pixels from the current iterators position without calling
+  // processPixel() for each pixel. Returns false if it's not
+  // supported.
+  bool processSpan(int w) {
+    return false;
+  }
 };
 
+// Converts "w" indexes to RGBA colors using the given palette (the
+// mask index is converted to a color with alpha = 0). Used by inks
+// that blend a whole span of an indexed image in RGBA.
+void convert_indexes_to_rgba(const uint8_t* src, const int w,
+                             const Palette* palette,
+                             const int maskIndex,
+                             std::vector<color_t>& dst)
+{
+  dst.resize(w);
+  for (int i=0; i<w; ++i) {
+    const int c = src[i];
+    if (c == maskIndex)
+      dst[i] = palette->getEntry(c) & rgba_rgb_mask;  // Alpha = 0
+    else
+      dst[i] = palette->getEntry(c);
+  }
+}
+
 template<typename Derived, typename ImageTraits>
 class SimpleInkProcessing : public InkProcessing<Derived> {
 public:
@@ -151,10 +191,20 @@ public:
     *this->m_dstAddress = m_color;
   }
 
+  bool processSpan(int w) {
+    return false;
+  }
+
 private:
   color_t m_color;
 };
 
+template<>
+bool CopyInkProcessing<RgbTraits>::processSpan(int w) {
+  std::fill(m_dstAddress, m_dstAddress+w, m_color);
+  return true;
+}
+
 //////////////////////////////////////////////////////////////////////
 // LockAlpha Ink
 //////////////////////////////////////////////////////////////////////
@@ -174,11 +224,21 @@ public:
     // Do nothing
   }
 
+  bool processSpan(int w) {
+    return false;
+  }
+
 private:
   color_t m_color;
   const int m_opacity;
 };
 
+template<>
+bool LockAlphaInkProcessing<RgbTraits>::processSpan(int w) {
+  rgba_blend_color_row_lock_alpha(m_dstAddress, m_srcAddress, w, m_color, m_opacity);
+  return true;
+}
+
 template<>
 void LockAlphaInkProcessing<RgbTraits>::processPixel(int x, int y) {
   color_t result = rgba_blender_normal(*m_srcAddress, m_color, m_opacity);
@@ -254,11 +314,21 @@ public:
     // Do nothing
   }
 
+  bool processSpan(int w) {
+    return false;
+  }
+
 private:
   color_t m_color;
   int m_opacity;
 };
 
+template<>
+bool TransparentInkProcessing<RgbTraits>::processSpan(int w) {
+  rgba_blend_color_row_normal(m_dstAddress, m_srcAddress, w, m_color, m_opacity);
+  return true;
+}
+
 template<>
 void TransparentInkProcessing<RgbTraits>::processPixel(int x, int y) {
   *m_dstAddress = rgba_blender_normal(*m_srcAddress, m_color, m_opacity);
@@ -298,6 +368,17 @@ public:
     *m_dstAddress = m_rgbmap->mapColor(c);
   }
 
+  bool processSpan(int w) {
+    if (m_colorIndex == m_maskIndex)
+      return true;
+
+    // Blend the whole span in RGBA and map it to indexes at once
+    convert_indexes_to_rgba(m_srcAddress, w, m_palette, m_maskIndex, m_span);
+    rgba_blend_color_row_normal(m_span.data(), m_span.data(), w, m_color, m_opacity);
+    m_rgbmap->mapColors(m_span.data(), m_dstAddress, w);
+    return true;
+  }
+
 private:
   const Palette* m_palette;
   const RgbMap* m_rgbmap;
@@ -305,6 +386,7 @@ private:
   color_t m_color;
   const int m_maskIndex;
   int m_colorIndex;
+  std::vector<color_t> m_span;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -326,11 +408,21 @@ public:
     // Do nothing
   }
 
+  bool processSpan(int w) {
+    return false;
+  }
+
 private:
   color_t m_color;
   int m_opacity;
 };
 
+template<>
+bool MergeInkProcessing<RgbTraits>::processSpan(int w) {
+  rgba_blend_color_row_merge(m_dstAddress, m_srcAddress, w, m_color, m_opacity);
+  return true;
+}
+
 template<>
 void MergeInkProcessing<RgbTraits>::processPixel(int x, int y) {
   *m_dstAddress = rgba_blender_merge(*m_srcAddress, m_color, m_opacity);
@@ -368,12 +460,20 @@ public:
     *m_dstAddress = m_rgbmap->mapColor(c);
   }
 
+  bool processSpan(int w) {
+    convert_indexes_to_rgba(m_srcAddress, w, m_palette, m_maskIndex, m_span);
+    rgba_blend_color_row_merge(m_span.data(), m_span.data(), w, m_color, m_opacity);
+    m_rgbmap->mapColors(m_span.data(), m_dstAddress, w);
+    return true;
+  }
+
 private:
   const Palette* m_palette;
   const RgbMap* m_rgbmap;
   const int m_opacity;
   const int m_maskIndex;
   color_t m_color;
+  std::vector<color_t> m_span;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -757,6 +857,19 @@ public:
       m_shadePalette.setEntry(
         i++, color_utils::color_for_layer(color, loop->getLayer()));
     }
+
+    // Precalculate the next/previous color of each color in the
+    // shade, so we don't have to search the shade for each pixel.
+    // emplace() doesn't replace existent entries, so repeated colors
+    // use the first index (as findExactMatch() does).
+    const int n = m_shadePalette.size();
+    m_ramp.reserve(n);
+    for (i=0; i<n; ++i) {
+      const int j = (m_left ? std::max(i-1, 0):
+                              std::min(i+1, n-1));
+      m_ramp.emplace(m_shadePalette.getEntry(i),
+                     m_shadePalette.getEntry(j));
+    }
   }
 
   int findIndex(uint8_t r, uint8_t g, uint8_t b, uint8_t a) const {
@@ -764,27 +877,16 @@ public:
   }
 
   pixel_t operator()(const pixel_t src) const {
-    int i = findIndex(rgba_getr(src),
-                      rgba_getg(src),
-                      rgba_getb(src),
-                      rgba_geta(src));
-    if (i < 0)
+    auto it = m_ramp.find(src);
+    if (it == m_ramp.end())
       return src;
-
-    if (m_left) {
-      if (i > 0)
-        --i;
-    }
-    else {
-      if (i < m_shadePalette.size()-1)
-        ++i;
-    }
-    return m_shadePalette.getEntry(i);
+    return it->second;
   }
 
 private:
   Palette m_shadePalette;
   bool m_left;
+  std::unordered_map<pixel_t, pixel_t> m_ramp;
 };
 
 template<>
@@ -811,6 +913,23 @@ public:
       m_shadePalette.setEntry(
         i++, color_utils::color_for_target(color, target));
     }
+
+    // Precalculate the next/previous color of each gray color in the
+    // shade (only RGB colors with r=g=b can match a gray pixel).
+    const int n = m_shadePalette.size();
+    m_ramp.reserve(n);
+    for (i=0; i<n; ++i) {
+      const color_t c = m_shadePalette.getEntry(i);
+      if (rgba_getr(c) != rgba_getg(c) ||
+          rgba_getr(c) != rgba_getb(c))
+        continue;
+
+      const int j = (m_left ? std::max(i-1, 0):
+                              std::min(i+1, n-1));
+      const color_t rgba = m_shadePalette.getEntry(j);
+      m_ramp.emplace(graya(rgba_getr(c), rgba_geta(c)),
+                     graya(rgba_getr(rgba), rgba_geta(rgba)));
+    }
   }
 
   int findIndex(uint8_t r, uint8_t g, uint8_t b, uint8_t a) const {
@@ -818,29 +937,16 @@ public:
   }
 
   pixel_t operator()(const pixel_t src) const {
-    int i = findIndex(graya_getv(src),
-                      graya_getv(src),
-                      graya_getv(src),
-                      graya_geta(src));
-    if (i < 0)
+    auto it = m_ramp.find(src);
+    if (it == m_ramp.end())
       return src;
-
-    if (m_left) {
-      if (i > 0)
-        --i;
-    }
-    else {
-      if (i < m_shadePalette.size()-1)
-        ++i;
-    }
-
-    color_t rgba = m_shadePalette.getEntry(i);
-    return graya(rgba_getr(rgba), rgba_geta(rgba));
+    return it->second;
   }
 
 private:
   Palette m_shadePalette;
   bool m_left;
+  std::unordered_map<pixel_t, pixel_t> m_ramp;
 };
 
 template<>
@@ -1216,7 +1322,51 @@ public:
     // Do nothing
   }
 
+  void initIterators(ToolLoop* loop, int x1, int y) {
+    DoubleInkProcessing<BrushInkProcessingBase<ImageTraits>, ImageTraits>::initIterators(loop, x1, y);
+    m_spanX = x1;
+    m_spanY = y;
+  }
+
+  // Same as processPixel(), the brush inks that can stamp a whole
+  // span of the brush image override this function.
+  virtual bool processSpan(int w) {
+    return false;
+  }
+
 protected:
+  // Calls func(dstAddress, brushPixel) for each pixel of the current
+  // span that is inside the brush mask. The brush image position is
+  // calculated only for the first pixel (as in alignPixelPoint()),
+  // then it's incremented wrapping around the brush/pattern size.
+  template<typename BrushTraits, typename Func>
+  void forEachBrushSpanPixel(int w, Func&& func) {
+    int mx = wrap_coord(m_spanX - m_u, m_width);
+    const int my = wrap_coord(m_spanY - m_v, m_height);
+    int ix = mx;
+    int iy = my;
+    int iw = m_width;
+    if (const Image* pattern = m_brush->patternImage()) {
+      iw = pattern->width();
+      ix = wrap_coord(m_spanX, iw);
+      iy = wrap_coord(m_spanY, pattern->height());
+    }
+
+    auto brushRow = get_pixel_address_fast<BrushTraits>(m_brushImage, 0, iy);
+    auto dstAddress = this->m_dstAddress;
+    for (int i=0; i<w; ++i, ++dstAddress) {
+      if (!m_brushMask || get_pixel_fast<BitmapTraits>(m_brushMask, mx, my))
+        func(dstAddress, brushRow[ix]);
+      if (++mx == m_width) mx = 0;
+      if (++ix == iw) ix = 0;
+    }
+  }
+
+  static int wrap_coord(int v, const int size) {
+    v %= size;
+    return (v < 0 ? v + size: v);
+  }
+
   bool alignPixelPoint(int& x0, int& y0) {
     int x = (x0 - m_u) % m_width;
     int y = (y0 - m_v) % m_height;
@@ -1249,6 +1399,7 @@ protected:
   BrushPattern m_patternAlign;
   int m_opacity;
   int m_u, m_v, m_width, m_height;
+  int m_spanX, m_spanY;
   // When we have a image brush from an INDEXED sprite, we need to know
   // which is the background color in order to translate to transparent color
   // in a RGBA sprite.
@@ -1422,6 +1573,10 @@ public:
   void processPixel(int x, int y) override {
     // Do nothing
   }
+
+  bool processSpan(int w) override {
+    return false;
+  }
 };
 
 template<>
@@ -1431,6 +1586,35 @@ void BrushSimpleInkProcessing<RgbTraits>::processPixel(int x, int y) {
     *m_dstAddress = c;
 }
 
+template<>
+bool BrushSimpleInkProcessing<RgbTraits>::processSpan(int w) {
+  // Same results as preProcessPixel() for each pixel, but without
+  // the modulo operations and the pixel format switch per pixel.
+  switch (m_brushImage->pixelFormat()) {
+    case IMAGE_RGB:
+      forEachBrushSpanPixel<RgbTraits>(
+        w, [this](RgbTraits::address_t dst, const color_t c){
+          *dst = rgba_blender_normal(*dst, c, m_opacity);
+        });
+      return true;
+    case IMAGE_INDEXED:
+      forEachBrushSpanPixel<IndexedTraits>(
+        w, [this](RgbTraits::address_t dst, const color_t i){
+          const color_t c = (m_transparentColor == i ? 0: m_palette->getEntry(i));
+          *dst = rgba_blender_normal(*dst, c, m_opacity);
+        });
+      return true;
+    case IMAGE_GRAYSCALE:
+      forEachBrushSpanPixel<GrayscaleTraits>(
+        w, [this](RgbTraits::address_t dst, const color_t g){
+          const color_t c = doc::rgba(graya_getv(g), graya_getv(g), graya_getv(g), graya_geta(g));
+          *dst = rgba_blender_normal(*dst, c, m_opacity);
+        });
+      return true;
+  }
+  return false;
+}
+
 template<>
 void BrushSimpleInkProcessing<IndexedTraits>::processPixel(int x, int y) {
   color_t c;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2020  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -69,16 +69,14 @@ void Intertwine::doPointshapeStrokePt(const Stroke::Pt& pt, ToolLoop* loop)
   Symmetry* symmetry = loop->getSymmetry();
   if (symmetry) {
     // Convert the point to the sprite position so we can apply the
-    // symmetry transformation.
-    Stroke main_stroke;
-    main_stroke.addPoint(pt);
-
-    Strokes strokes;
-    symmetry->generateStrokes(main_stroke, strokes, loop);
-    for (const auto& stroke : strokes) {
+    // symmetry transformation (without allocating strokes for each
+    // painted point).
+    Symmetry::Points pts;
+    const int n = symmetry->generatePoints(pt, pts, loop);
+    for (int i=0; i<n; ++i) {
       // We call transformPoint() moving back each point to the cel
       // origin.
-      doTransformPoint(stroke[0], loop);
+      doTransformPoint(pts[i], loop);
     }
   }
   else {
@@ -105,7 +103,8 @@ void Intertwine::doPointshapePointDynamics(int x, int y, Intertwine::LineData* d
 // static
 void Intertwine::doPointshapeHline(int x1, int y, int x2, ToolLoop* loop)
 {
-  algo_line_perfect(x1, y, x2, y, loop, (AlgoPixel)doPointshapePoint);
+  algo_line_perfect(x1, y, x2, y,
+                    [loop](int x, int y){ doPointshapePoint(x, y, loop); });
 }
 
 // static
@@ -121,15 +120,16 @@ void Intertwine::doPointshapeLineWithoutDynamics(int x1, int y1, int x2, int y2,
 void Intertwine::doPointshapeLine(const Stroke::Pt& a,
                                   const Stroke::Pt& b, ToolLoop* loop)
 {
-  doc::AlgoLineWithAlgoPixel algo = getLineAlgo(loop, a, b);
   LineData lineData(loop, a, b);
-  algo(a.x, a.y, b.x, b.y, (void*)&lineData, (AlgoPixel)doPointshapePointDynamics);
+  algo_line(getLineAlgo(loop, a, b),
+            a.x, a.y, b.x, b.y,
+            [&lineData](int x, int y){ doPointshapePointDynamics(x, y, &lineData); });
 }
 
 // static
-doc::AlgoLineWithAlgoPixel Intertwine::getLineAlgo(ToolLoop* loop,
-                                                   const Stroke::Pt& a,
-                                                   const Stroke::Pt& b)
+doc::LineAlgo Intertwine::getLineAlgo(ToolLoop* loop,
+                                      const Stroke::Pt& a,
+                                      const Stroke::Pt& b)
 {
   bool needsFixForLineBrush = false;
   if ((loop->getBrush()->type() == kLineBrushType) &&
@@ -156,14 +156,14 @@ doc::AlgoLineWithAlgoPixel Intertwine::getLineAlgo(ToolLoop* loop,
       // "Snap to Grid" is enabled
       (loop->getController()->canSnapToGrid() && loop->getSnapToGrid())) {
     // We prefer the perfect pixel lines that matches grid tiles
-    return (needsFixForLineBrush ? algo_line_perfect_with_fix_for_line_brush:
-                                   algo_line_perfect);
+    return (needsFixForLineBrush ? LineAlgo::PerfectWithFixForLineBrush:
+                                   LineAlgo::Perfect);
   }
   else {
     // In other case we use the regular algorithm that is useful to
     // draw continuous lines/strokes.
-    return (needsFixForLineBrush ? algo_line_continuous_with_fix_for_line_brush:
-                                   algo_line_continuous);
+    return (needsFixForLineBrush ? LineAlgo::ContinuousWithFixForLineBrush:
+                                   LineAlgo::Continuous);
   }
 }
 
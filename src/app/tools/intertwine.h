@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2021  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -28,6 +28,12 @@ namespace app {
       virtual bool snapByAngle() { return false; }
       virtual void prepareIntertwine(ToolLoop* loop) { }
 
+      // Returns true if joining a stroke with several new points in
+      // one joinStroke() call paints the same pixels as joining each
+      // pair of consecutive points in separated calls. Used by the
+      // ToolLoopManager to coalesce mouse/stylus movements.
+      virtual bool canJoinSeveralPoints() { return false; }
+
       // The given stroke must be relative to the cel origin.
       virtual void joinStroke(ToolLoop* loop, const Stroke& stroke) = 0;
       virtual void fillStroke(ToolLoop* loop, const Stroke& stroke) = 0;
@@ -59,9 +65,9 @@ namespace app {
       static void doPointshapeLine(const Stroke::Pt& a,
                                    const Stroke::Pt& b, ToolLoop* loop);
 
-      static doc::AlgoLineWithAlgoPixel getLineAlgo(ToolLoop* loop,
-                                                    const Stroke::Pt& a,
-                                                    const Stroke::Pt& b);
+      static doc::LineAlgo getLineAlgo(ToolLoop* loop,
+                                       const Stroke::Pt& a,
+                                       const Stroke::Pt& b);
     };
 
   } // namespace tools
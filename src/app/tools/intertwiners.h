@@ -32,6 +32,7 @@ static void addPointsWithoutDuplicatingLastOne(int x, int y, LineData2* data)
 
 class IntertwineNone : public Intertwine {
 public:
+  bool canJoinSeveralPoints() override { return true; }
 
   void joinStroke(ToolLoop* loop, const Stroke& stroke) override {
     for (int c=0; c<stroke.size(); ++c)
@@ -94,6 +95,7 @@ class IntertwineAsLines : public Intertwine {
 
 public:
   bool snapByAngle() override { return true; }
+  bool canJoinSeveralPoints() override { return true; }
 
   void prepareIntertwine(ToolLoop* loop) override {
     m_retainedTracePolicyLast = false;
@@ -117,12 +119,13 @@ public:
     else {
       Stroke pts;
       for (int c=0; c+1<stroke.size(); ++c) {
-        auto lineAlgo = getLineAlgo(loop, stroke[c], stroke[c+1]);
         LineData2 lineData(loop, stroke[c], stroke[c+1], pts);
-        lineAlgo(stroke[c].x, stroke[c].y,
-                 stroke[c+1].x, stroke[c+1].y,
-                 (void*)&lineData,
-                 (AlgoPixel)&addPointsWithoutDuplicatingLastOne);
+        algo_line(getLineAlgo(loop, stroke[c], stroke[c+1]),
+                  stroke[c].x, stroke[c].y,
+                  stroke[c+1].x, stroke[c+1].y,
+                  [&lineData](int x, int y){
+                    addPointsWithoutDuplicatingLastOne(x, y, &lineData);
+                  });
       }
 
       // Don't draw the first point in freehand tools (this is to
@@ -314,7 +317,8 @@ public:
 
         const double angle = loop->getController()->getShapeAngle();
         if (ABS(angle) < 0.001) {
-          algo_ellipse(x1, y1, x2, y2, 0, 0, loop, (AlgoPixel)doPointshapePoint);
+          algo_ellipse(x1, y1, x2, y2, 0, 0,
+                       [loop](int x, int y){ doPointshapePoint(x, y, loop); });
         }
         else {
           draw_rotated_ellipse((x1+x2)/2, (y1+y2)/2,
@@ -344,7 +348,8 @@ public:
 
       const double angle = loop->getController()->getShapeAngle();
       if (ABS(angle) < 0.001) {
-        algo_ellipsefill(x1, y1, x2, y2, 0, 0, loop, (AlgoHLine)doPointshapeHline);
+        algo_ellipsefill(x1, y1, x2, y2, 0, 0,
+                         [loop](int a, int y, int b){ doPointshapeHline(a, y, b, loop); });
       }
       else {
         fill_rotated_ellipse((x1+x2)/2, (y1+y2)/2,
@@ -513,19 +518,23 @@ public:
       if (stroke.firstPoint() == stroke.lastPoint())
         return;
 
+      // Only the new points (and the last two points of the previous
+      // step) can form a new L-shaped corner, so the pixel-perfect
+      // check below doesn't depend on the stroke length.
       nextPt = m_pts.size();
       thirdFromLastPt = (m_pts.size() > 2 ? m_pts.size() - 3 : m_pts.size() - 1);
 
       for (int c=0; c+1<stroke.size(); ++c) {
-        auto lineAlgo = getLineAlgo(loop, stroke[c], stroke[c+1]);
         LineData2 lineData(loop, stroke[c], stroke[c+1], m_pts);
-        lineAlgo(
+        algo_line(
+          getLineAlgo(loop, stroke[c], stroke[c+1]),
           stroke[c].x,
           stroke[c].y,
           stroke[c+1].x,
           stroke[c+1].y,
-          (void*)&lineData,
-          (AlgoPixel)&addPointsWithoutDuplicatingLastOne);
+          [&lineData](int x, int y){
+            addPointsWithoutDuplicatingLastOne(x, y, &lineData);
+          });
       }
     }
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -11,8 +11,10 @@
 #include "doc/algorithm/flip_image.h"
 #include "render/gradient.h"
 
+#include <algorithm>
 #include <array>
 #include <memory>
+#include <vector>
 
 namespace app {
 namespace tools {
@@ -62,10 +64,25 @@ public:
 };
 
 class BrushPointShape : public PointShape {
+  using CompressedImages = std::array<std::shared_ptr<CompressedImage>, 4>;
+
+  // Brushes generated for dynamics (size/angle changes with the
+  // pressure/velocity), so we don't regenerate the brush image and
+  // its compressed scanlines for each point of the stroke.
+  struct CachedBrush {
+    BrushType type;
+    int size;
+    int angle;
+    BrushRef brush;
+    CompressedImages compressedImages;
+  };
+  static constexpr int kBrushCacheSize = 16;
+
   bool m_firstPoint;
   Brush* m_lastBrush;
   BrushType m_origBrushType;
-  std::array<std::shared_ptr<CompressedImage>, 4> m_compressedImages;
+  CompressedImages m_compressedImages;
+  std::vector<CachedBrush> m_brushCache; // Most recently used first
   // For dynamics
   DynamicsOptions m_dynamics;
   bool m_useDynamics;
@@ -177,15 +194,16 @@ public:
       if ((brush->size() != size) ||
           (brush->angle() != angle && m_origBrushType != kCircleBrushType) ||
           (m_hasDynamicGradient && pt.gradient != m_lastGradientValue)) {
-        // TODO cache brushes
-        BrushRef newBrush = std::make_shared<Brush>(
-          m_origBrushType, size, angle);
+        BrushRef newBrush;
 
         // Dynamic gradient with dithering
         bool prepareInk = false;
         if (m_hasDynamicGradient && !ink->isEraser() &&
             (m_dynamics.ditheringMatrix.rows() > 1 ||
              m_dynamics.ditheringMatrix.cols() > 1)) {
+          // The brush image depends on the gradient value, so we
+          // cannot use the cache here.
+          newBrush = std::make_shared<Brush>(m_origBrushType, size, angle);
           convert_bitmap_brush_to_dithering_brush(
             newBrush.get(),
             loop->sprite()->pixelFormat(),
@@ -195,6 +213,9 @@ public:
             m_primaryColor);
           prepareInk = true;
         }
+        else {
+          newBrush = getCachedBrush(size, angle);
+        }
         m_lastGradientValue = pt.gradient;
 
         loop->setBrush(newBrush);
@@ -207,10 +228,9 @@ public:
       }
     }
 
-    // TODO cache compressed images (or remove them completelly)
     if (m_lastBrush != brush) {
+      swapCompressedImages(brush);
       m_lastBrush = brush;
-      m_compressedImages.fill(nullptr);
     }
 
     x += brush->bounds().x;
@@ -258,6 +278,52 @@ public:
   }
 
 private:
+  BrushRef getCachedBrush(int size, int angle) {
+    // The angle is not used in circular brushes
+    if (m_origBrushType == kCircleBrushType)
+      angle = 0;
+
+    auto it = std::find_if(
+      m_brushCache.begin(), m_brushCache.end(),
+      [this, size, angle](const CachedBrush& c){
+        return (c.type == m_origBrushType &&
+                c.size == size &&
+                c.angle == angle);
+      });
+
+    if (it == m_brushCache.end()) {
+      if (int(m_brushCache.size()) >= kBrushCacheSize)
+        m_brushCache.pop_back();
+
+      CachedBrush c;
+      c.type = m_origBrushType;
+      c.size = size;
+      c.angle = angle;
+      c.brush = std::make_shared<Brush>(m_origBrushType, size, angle);
+      m_brushCache.insert(m_brushCache.begin(), std::move(c));
+    }
+    else if (it != m_brushCache.begin()) {
+      std::rotate(m_brushCache.begin(), it, it+1);
+    }
+    return m_brushCache.front().brush;
+  }
+
+  // Keeps the compressed images of the previous brush in the cache
+  // (if it's a cached brush) and restores the ones of the new brush.
+  void swapCompressedImages(Brush* newBrush) {
+    for (auto& c : m_brushCache) {
+      if (c.brush.get() == m_lastBrush)
+        c.compressedImages = m_compressedImages;
+    }
+    m_compressedImages.fill(nullptr);
+    for (const auto& c : m_brushCache) {
+      if (c.brush.get() == newBrush) {
+        m_compressedImages = c.compressedImages;
+        break;
+      }
+    }
+  }
+
   CompressedImage& getCompressedImage(gen::SymmetryMode symmetryMode) {
     auto& compressPtr = m_compressedImages[int(symmetryMode)];
     if (!compressPtr) {
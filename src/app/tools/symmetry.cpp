@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2021  Igara Studio S.A.
+// Copyright (C) 2021-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -49,11 +49,49 @@ void Symmetry::generateStrokes(const Stroke& stroke, Strokes& strokes,
   }
 }
 
+int Symmetry::generatePoints(const Stroke::Pt& pt, Points& pts,
+                             ToolLoop* loop)
+{
+  int n = 0;
+  pts[n++] = pt;
+  gen::SymmetryMode symmetryMode = loop->getSymmetry()->mode();
+  switch (symmetryMode) {
+    case gen::SymmetryMode::NONE:
+      ASSERT(false);
+      break;
+
+    case gen::SymmetryMode::HORIZONTAL:
+    case gen::SymmetryMode::VERTICAL:
+      pts[n++] = calculateSymmetricalPoint(pt, loop, symmetryMode);
+      break;
+
+    case gen::SymmetryMode::BOTH: {
+      pts[n++] = calculateSymmetricalPoint(pt, loop, gen::SymmetryMode::HORIZONTAL);
+      pts[n] = calculateSymmetricalPoint(pt, loop, gen::SymmetryMode::VERTICAL);
+      pts[n+1] = calculateSymmetricalPoint(pts[n], loop, gen::SymmetryMode::BOTH);
+      n += 2;
+      break;
+    }
+  }
+  return n;
+}
+
 void Symmetry::calculateSymmetricalStroke(const Stroke& refStroke, Stroke& stroke,
                                           ToolLoop* loop, gen::SymmetryMode symmetryMode)
+{
+  for (const auto& pt : refStroke)
+    stroke.addPoint(calculateSymmetricalPoint(pt, loop, symmetryMode));
+}
+
+Stroke::Pt Symmetry::calculateSymmetricalPoint(const Stroke::Pt& refPt,
+                                               ToolLoop* loop, gen::SymmetryMode symmetryMode)
 {
   int brushSize, brushCenter;
-  if (loop->getPointShape()->isFloodFill()) {
+  if (loop->getDynamics().isDynamic()) {
+    brushSize = refPt.size;
+    brushCenter = (brushSize - brushSize % 2) / 2;
+  }
+  else if (loop->getPointShape()->isFloodFill()) {
     brushSize = 1;
     brushCenter = 0;
   }
@@ -71,20 +109,13 @@ void Symmetry::calculateSymmetricalStroke(const Stroke& refStroke, Stroke& strok
     }
   }
 
-  const bool isDynamic = loop->getDynamics().isDynamic();
-  for (const auto& pt : refStroke) {
-    if (isDynamic) {
-      brushSize = pt.size;
-      brushCenter = (brushSize - brushSize % 2) / 2;
-    }
-    Stroke::Pt pt2 = pt;
-    pt2.symmetry = symmetryMode;
-    if (symmetryMode == gen::SymmetryMode::HORIZONTAL || symmetryMode == gen::SymmetryMode::BOTH)
-      pt2.x = 2 * (m_x + brushCenter) - pt2.x - brushSize;
-    else
-      pt2.y = 2 * (m_y + brushCenter) - pt2.y - brushSize;
-    stroke.addPoint(pt2);
-  }
+  Stroke::Pt pt2 = refPt;
+  pt2.symmetry = symmetryMode;
+  if (symmetryMode == gen::SymmetryMode::HORIZONTAL || symmetryMode == gen::SymmetryMode::BOTH)
+    pt2.x = 2 * (m_x + brushCenter) - pt2.x - brushSize;
+  else
+    pt2.y = 2 * (m_y + brushCenter) - pt2.y - brushSize;
+  return pt2;
 }
 
 } // namespace tools
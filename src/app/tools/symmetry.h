@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2021  Igara Studio S.A.
+// Copyright (C) 2021-2024  Igara Studio S.A.
 // Copyright (C) 2015  David Capello
 //
 // This program is distributed under the terms of
@@ -12,6 +12,8 @@
 #include "app/tools/stroke.h"
 #include "app/pref/preferences.h"
 
+#include <array>
+
 namespace app {
 namespace tools {
 
@@ -25,13 +27,25 @@ public:
     , m_y(y) {
   }
 
+  // Maximum number of points/strokes generated by the symmetry
+  // (including the original one).
+  static constexpr int kMaxPoints = 4;
+  typedef std::array<Stroke::Pt, kMaxPoints> Points;
+
   void generateStrokes(const Stroke& stroke, Strokes& strokes, ToolLoop* loop);
 
+  // Same as generateStrokes() for just one point, but without
+  // allocating strokes (it's used for each point painted by the
+  // intertwiner). Returns the number of points in "pts".
+  int generatePoints(const Stroke::Pt& pt, Points& pts, ToolLoop* loop);
+
   gen::SymmetryMode mode() const { return m_symmetryMode; }
 
 private:
   void calculateSymmetricalStroke(const Stroke& refStroke, Stroke& stroke,
                                   ToolLoop* loop, gen::SymmetryMode symmetryMode);
+  Stroke::Pt calculateSymmetricalPoint(const Stroke::Pt& refPt,
+                                       ToolLoop* loop, gen::SymmetryMode symmetryMode);
 
   gen::SymmetryMode m_symmetryMode;
   double m_x, m_y;
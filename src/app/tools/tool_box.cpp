@@ -13,6 +13,7 @@
 
 #include "app/gui_xml.h"
 #include "app/i18n/strings.h"
+#include "app/perf_trace.h"
 #include "app/tools/controller.h"
 #include "app/tools/ink.h"
 #include "app/tools/intertwine.h"
@@ -112,6 +113,8 @@ struct deleter {
 
 ToolBox::ToolBox()
 {
+  PerfScope perf(PerfCategory::Startup, "ToolBox::ToolBox");
+
   m_xmlTranslator.setStringIdPrefix("tools");
 
   m_inks[WellKnownInks::Selection]       = new SelectionInk();
@@ -12,6 +12,7 @@
 #include "app/tools/tool_loop_manager.h"
 
 #include "app/context.h"
+#include "app/perf_trace.h"
 #include "app/snap_to_grid.h"
 #include "app/tools/controller.h"
 #include "app/tools/ink.h"
@@ -66,6 +67,9 @@ void ToolLoopManager::cancel()
 
 void ToolLoopManager::end()
 {
+  if (!m_canceled)
+    flushPendingPoints();
+
   if (m_canceled)
     m_toolLoop->rollback();
   else
@@ -76,6 +80,7 @@ void ToolLoopManager::prepareLoop(const Pointer& pointer)
 {
   // Start with no points at all
   m_stroke.reset();
+  m_pendingPoints = 0;
 
   // Prepare the ink
   m_toolLoop->getInk()->prepareInk(m_toolLoop);
@@ -152,6 +157,8 @@ bool ToolLoopManager::releaseButton(const Pointer& pointer)
   if (isCanceled())
     return false;
 
+  flushPendingPoints();
+
   Stroke::Pt spritePoint = getSpriteStrokePt(pointer);
   bool res = m_toolLoop->getController()->releaseButton(m_stroke, spritePoint);
 
@@ -200,6 +207,11 @@ void ToolLoopManager::movement(Pointer pointer)
   m_toolLoop->getController()->getStatusBarText(m_toolLoop, m_stroke, statusText);
   m_toolLoop->updateStatusBar(statusText.c_str());
 
+  if (canSkipLoopStep()) {
+    ++m_pendingPoints;
+    return;
+  }
+
   doLoopStep(false);
 }
 
@@ -209,15 +221,53 @@ void ToolLoopManager::disableMouseStabilizer()
   m_dynamics.stabilizer = false;
 }
 
+void ToolLoopManager::flushPendingPoints()
+{
+  if (m_pendingPoints > 0 && !isCanceled())
+    doLoopStep(false);
+}
+
+// Returns true if we can accumulate the last point of the stroke and
+// paint it in a future step. This is possible only when the
+// controller gives us the last two points of the stroke (freehand),
+// the previous painted traces are kept (TracePolicy::Accumulate),
+// and the intertwiner paints the same pixels joining several points
+// at once. We skip steps only when the previous step took more time
+// than the elapsed time since its end (i.e. we are receiving events
+// faster than we can paint them).
+bool ToolLoopManager::canSkipLoopStep() const
+{
+  return (m_coalesce &&
+          m_toolLoop->getController()->canCoalescePoints() &&
+          m_toolLoop->getTracePolicy() == TracePolicy::Accumulate &&
+          m_toolLoop->getIntertwine()->canJoinSeveralPoints() &&
+          m_stroke.size() > m_pendingPoints+2 &&
+          m_sinceLastStep.elapsed() < m_lastStepDuration);
+}
+
 void ToolLoopManager::doLoopStep(bool lastStep)
 {
+  PerfScope perf(PerfCategory::ToolLoop, "ToolLoopManager::doLoopStep");
+  base::Chrono chrono;
+
   // Original set of points to interwine (original user stroke,
   // relative to sprite origin).
   Stroke main_stroke;
-  if (!lastStep)
-    m_toolLoop->getController()->getStrokeToInterwine(m_stroke, main_stroke);
+  if (!lastStep) {
+    if (m_pendingPoints > 0) {
+      // Join the last painted point with all the pending points
+      // (this is like calling the controller getStrokeToInterwine()
+      // for each pending point).
+      const int n = std::min(m_pendingPoints+2, m_stroke.size());
+      for (int i=m_stroke.size()-n; i<m_stroke.size(); ++i)
+        main_stroke.addPoint(m_stroke[i]);
+    }
+    else
+      m_toolLoop->getController()->getStrokeToInterwine(m_stroke, main_stroke);
+  }
   else
     main_stroke = m_stroke;
+  m_pendingPoints = 0;
 
   // Calculate the area to be updated in all document observers.
   Symmetry* symmetry = m_toolLoop->getSymmetry();
@@ -293,6 +343,9 @@ void ToolLoopManager::doLoopStep(bool lastStep)
   }
 
   TOOL_TRACE("ToolLoopManager::doLoopStep dirtyArea", m_dirtyArea.bounds());
+
+  m_lastStepDuration = chrono.elapsed();
+  m_sinceLastStep.reset();
 }
 
 // Applies the grid settings to the specified sprite point.
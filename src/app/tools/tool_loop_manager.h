@@ -12,6 +12,7 @@
 #include "app/tools/dynamics.h"
 #include "app/tools/pointer.h"
 #include "app/tools/stroke.h"
+#include "base/chrono.h"
 #include "doc/brush.h"
 #include "gfx/point.h"
 #include "gfx/region.h"
@@ -84,7 +85,20 @@ public:
 
   const Pointer& lastPointer() const { return m_lastPointer; }
 
+  // Enables the coalescing of movements: when the mouse/stylus
+  // events are arriving faster than we can paint them, new points
+  // are accumulated in the stroke and joined in one step later
+  // (only for freehand tools where the final pixels are the same).
+  void setCoalesceMovements(bool state) { m_coalesce = state; }
+
+  // Returns true if there are accumulated points waiting to be
+  // painted. The caller should call flushPendingPoints() when no
+  // more movements are received (e.g. using a timer).
+  bool hasPendingPoints() const { return m_pendingPoints > 0; }
+  void flushPendingPoints();
+
 private:
+  bool canSkipLoopStep() const;
   void doLoopStep(bool lastStep);
   void snapToGrid(Stroke::Pt& pt);
   Stroke::Pt getSpriteStrokePt(const Pointer& pointer);
@@ -103,6 +117,12 @@ private:
   const int m_brushAngle0;
   DynamicsOptions m_dynamics;
   gfx::PointF m_stabilizerCenter;
+
+  // Coalescing of movements
+  bool m_coalesce = false;
+  int m_pendingPoints = 0;
+  base::Chrono m_sinceLastStep;
+  double m_lastStepDuration = 0.0;
 };
 
 } // namespace tools
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -17,6 +17,8 @@
 #include "app/doc_undo.h"
 #include "app/i18n/strings.h"
 #include "app/modules/palettes.h"
+#include "base/chrono.h"
+#include "base/scoped_value.h"
 #include "doc/sprite.h"
 #include "ui/manager.h"
 #include "ui/system.h"
@@ -75,6 +77,17 @@ Transaction::~Transaction()
   }
 
   m_doc->remove_observer(this);
+
+  if (m_batching)
+    m_doc->endBatchNotifications();
+}
+
+void Transaction::batchNotifications()
+{
+  if (!m_batching) {
+    m_batching = true;
+    m_doc->beginBatchNotifications();
+  }
 }
 
 // Used to set the document range after all the transaction is
@@ -166,7 +179,15 @@ void Transaction::execute(Cmd* cmd)
     // then execute it. This is because the execution can generate
     // some signals that could add/execute new actions to the undo
     // history/sequence.
-    m_cmds->addAndExecute(m_ctx, cmd);
+    if (m_executing) {
+      m_cmds->addAndExecute(m_ctx, cmd);
+    }
+    else {
+      base::ScopedValue executing(m_executing, true);
+      base::Chrono chrono;
+      m_cmds->addAndExecute(m_ctx, cmd);
+      m_cmds->addExecutionTime(chrono.elapsed());
+    }
   }
   catch (...) {
     delete cmd;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -98,6 +98,12 @@ namespace app {
     //      pointers-like structure only
     void execute(Cmd* cmd);
 
+    // Records the notifications about modified pixels/properties
+    // of the document until the transaction is destroyed, and sends
+    // them coalesced (see Doc::beginBatchNotifications()). Useful for
+    // commands that modify a lot of cels at once.
+    void batchNotifications();
+
     CmdTransaction* cmds() { return m_cmds; }
 
   private:
@@ -123,6 +129,13 @@ namespace app {
     DocUndo* m_undo;
     CmdTransaction* m_cmds;
     Changes m_changes;
+
+    // True while we are inside execute(), used to measure only the
+    // outermost call (a cmd can execute other cmds).
+    bool m_executing = false;
+
+    // True if batchNotifications() was called
+    bool m_batching = false;
   };
 
 } // namespace app
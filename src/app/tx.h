@@ -113,6 +113,10 @@ namespace app {
       m_transaction->rollbackAndStartAgain();
     }
 
+    void batchNotifications() {
+      m_transaction->batchNotifications();
+    }
+
     // If the command cannot be executed, it will be deleted anyway.
     void operator()(Cmd* cmd) {
       m_transaction->execute(cmd);
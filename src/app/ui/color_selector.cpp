@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -37,6 +37,7 @@
 #include <algorithm>
 #include <cmath>
 #include <condition_variable>
+#include <cstdint>
 #include <cstdio>
 #include <thread>
 
@@ -589,6 +590,46 @@ void ColorSelector::paintColorIndicator(ui::Graphics* g,
     pos.y-icon->height()/2);
 }
 
+// static
+void ColorSelector::putSurfaceRow(os::Surface* s, const int x, const int y,
+                                  const std::vector<gfx::Color>& colors)
+{
+  const int w = int(colors.size());
+
+  os::SurfaceFormatData fd;
+  s->getFormat(&fd);
+  if (fd.bitsPerPixel != 32) {
+    for (int u=0; u<w; ++u)
+      s->putPixel(colors[u], x+u, y);
+    return;
+  }
+
+  os::SurfaceLock lock(s);
+  auto dst = (uint32_t*)s->getData(x, y);
+  for (int u=0; u<w; ++u) {
+    const gfx::Color c = colors[u];
+    // Colors with alpha must be premultiplied by putPixel()
+    if (gfx::geta(c) != 255) {
+      s->putPixel(c, x+u, y);
+      continue;
+    }
+    dst[u] =
+      ((gfx::getr(c) << fd.redShift  ) & fd.redMask  ) |
+      ((gfx::getg(c) << fd.greenShift) & fd.greenMask) |
+      ((gfx::getb(c) << fd.blueShift ) & fd.blueMask ) |
+      ((gfx::geta(c) << fd.alphaShift) & fd.alphaMask);
+  }
+}
+
+// static
+void ColorSelector::fillSurfaceColumns(os::Surface* s, const gfx::Rect& rc,
+                                       const std::vector<gfx::Color>& colors)
+{
+  ASSERT(int(colors.size()) == rc.w);
+  for (int y=rc.y; y<rc.y2(); ++y)
+    putSurfaceRow(s, rc.x, y, colors);
+}
+
 int ColorSelector::getCurrentAlphaForNewColor() const
 {
   if (m_color.getType() != Color::MaskType)
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -20,6 +20,7 @@
 
 #include <atomic>
 #include <cmath>
+#include <vector>
 
 // TODO We should wrap the SkRuntimeEffect in laf-os, SkRuntimeEffect
 //      and SkRuntimeShaderBuilder might change in future Skia
@@ -90,6 +91,15 @@ namespace app {
                              const gfx::Point& pos,
                              const bool white);
 
+    // Used in onPaintSurfaceInBgThread() to paint a whole row of
+    // pixels (or the same row in all rows of "rc") directly in the
+    // surface memory, instead of calling putPixel()/drawRect() for
+    // each pixel/column.
+    static void putSurfaceRow(os::Surface* s, const int x, const int y,
+                              const std::vector<gfx::Color>& colors);
+    static void fillSurfaceColumns(os::Surface* s, const gfx::Rect& rc,
+                                   const std::vector<gfx::Color>& colors);
+
     // Returns the 255 if m_color is the mask color, or the
     // m_color.getAlpha() if it's really a color.
     int getCurrentAlphaForNewColor() const;
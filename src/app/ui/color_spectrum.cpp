@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2022  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -137,19 +137,19 @@ void ColorSpectrum::onPaintSurfaceInBgThread(
     int umax = std::max(1, main.w-1);
     int vmax = std::max(1, main.h-1);
 
+    std::vector<gfx::Color> row(main.w);
     for (int y=0; y<main.h && !stop; ++y) {
-      for (int x=0; x<main.w && !stop; ++x) {
+      double lit = 1.0 - double(y) / double(vmax);
+      for (int x=0; x<main.w; ++x) {
         double hue = 360.0 * double(x) / double(umax);
-        double lit = 1.0 - double(y) / double(vmax);
 
-        gfx::Color color = color_utils::color_for_ui(
+        row[x] = color_utils::color_for_ui(
           app::Color::fromHsl(
             std::clamp(hue, 0.0, 360.0),
             sat,
             std::clamp(lit, 0.0, 1.0)));
-
-        s->putPixel(color, main.x+x, main.y+y);
       }
+      putSurfaceRow(s, main.x, main.y+y, row);
     }
     if (stop)
       return;
@@ -159,13 +159,14 @@ void ColorSpectrum::onPaintSurfaceInBgThread(
   if (m_paintFlags & BottomBarFlag) {
     double lit = m_color.getHslLightness();
     double hue = m_color.getHslHue();
-    os::Paint paint;
+    std::vector<gfx::Color> row(bottom.w);
     for (int x=0; x<bottom.w && !stop; ++x) {
-      paint.color(
+      row[x] =
         color_utils::color_for_ui(
-          app::Color::fromHsl(hue, double(x) / double(bottom.w), lit)));
-      s->drawRect(gfx::Rect(bottom.x+x, bottom.y, 1, bottom.h), paint);
+          app::Color::fromHsl(hue, double(x) / double(bottom.w), lit));
     }
+    if (!stop)
+      fillSurfaceColumns(s, bottom, row);
     if (stop)
       return;
     m_paintFlags ^= BottomBarFlag;
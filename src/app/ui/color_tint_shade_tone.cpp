@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2022  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -162,19 +162,19 @@ void ColorTintShadeTone::onPaintSurfaceInBgThread(
   int vmax = std::max(1, main.h-1);
 
   if (m_paintFlags & MainAreaFlag) {
+    std::vector<gfx::Color> row(main.w);
     for (int y=0; y<main.h && !stop; ++y) {
-      for (int x=0; x<main.w && !stop; ++x) {
+      double val = 1.0 - double(y) / double(vmax);
+      for (int x=0; x<main.w; ++x) {
         double sat = double(x) / double(umax);
-        double val = 1.0 - double(y) / double(vmax);
 
-        gfx::Color color = color_utils::color_for_ui(
+        row[x] = color_utils::color_for_ui(
           app::Color::fromHsv(
             hue,
             std::clamp(sat, 0.0, 1.0),
             std::clamp(val, 0.0, 1.0)));
-
-        s->putPixel(color, main.x+x, main.y+y);
       }
+      putSurfaceRow(s, main.x, main.y+y, row);
     }
     if (stop)
       return;
@@ -182,7 +182,6 @@ void ColorTintShadeTone::onPaintSurfaceInBgThread(
   }
 
   if (m_paintFlags & BottomBarFlag) {
-    os::Paint paint;
     double sat, val;
 
     if (m_hueWithSatValue) {
@@ -194,14 +193,15 @@ void ColorTintShadeTone::onPaintSurfaceInBgThread(
       val = 1.0;
     }
 
+    std::vector<gfx::Color> row(bottom.w);
     for (int x=0; x<bottom.w && !stop; ++x) {
-      paint.color(
+      row[x] =
         color_utils::color_for_ui(
           app::Color::fromHsv(
-            (360.0 * x / bottom.w), sat, val)));
-
-      s->drawRect(gfx::Rect(bottom.x+x, bottom.y, 1, bottom.h), paint);
+            (360.0 * x / bottom.w), sat, val));
     }
+    if (!stop)
+      fillSurfaceColumns(s, bottom, row);
     if (stop)
       return;
     m_paintFlags ^= BottomBarFlag;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2022  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -417,23 +417,22 @@ void ColorWheel::onPaintSurfaceInBgThread(os::Surface* s,
     int umax = std::max(1, main.w-1);
     int vmax = std::max(1, main.h-1);
 
+    std::vector<gfx::Color> row(main.w);
     for (int y=0; y<main.h && !stop; ++y) {
-      for (int x=0; x<main.w && !stop; ++x) {
+      for (int x=0; x<main.w; ++x) {
         app::Color appColor =
           getMainAreaColor(x, umax,
                            y, vmax);
 
-        gfx::Color color;
         if (appColor.getType() != app::Color::MaskType) {
           appColor.setAlpha(255);
-          color = color_utils::color_for_ui(appColor);
+          row[x] = color_utils::color_for_ui(appColor);
         }
         else {
-          color = m_bgColor;
+          row[x] = m_bgColor;
         }
-
-        s->putPixel(color, main.x+x, main.y+y);
       }
+      putSurfaceRow(s, main.x, main.y+y, row);
     }
     if (stop)
       return;
@@ -443,14 +442,14 @@ void ColorWheel::onPaintSurfaceInBgThread(os::Surface* s,
   if (m_paintFlags & BottomBarFlag) {
     double hue = m_color.getHsvHue();
     double sat = m_color.getHsvSaturation();
-    os::Paint paint;
+    std::vector<gfx::Color> row(bottom.w);
     for (int x=0; x<bottom.w && !stop; ++x) {
-      paint.color(
+      row[x] =
         color_utils::color_for_ui(
-          app::Color::fromHsv(hue, sat, double(x) / double(bottom.w))));
-
-      s->drawRect(gfx::Rect(bottom.x+x, bottom.y, 1, bottom.h), paint);
+          app::Color::fromHsv(hue, sat, double(x) / double(bottom.w)));
     }
+    if (!stop)
+      fillSurfaceColumns(s, bottom, row);
     if (stop)
       return;
     m_paintFlags ^= BottomBarFlag;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2017  David Capello
 //
 // This program is distributed under the terms of
@@ -12,7 +12,6 @@
 #include "app/ui/dithering_selector.h"
 
 #include "app/app.h"
-#include "app/console.h"
 #include "app/extensions.h"
 #include "app/i18n/strings.h"
 #include "app/modules/palettes.h"
@@ -32,6 +31,7 @@
 #include "ui/size_hint_event.h"
 
 #include <algorithm>
+#include <optional>
 
 namespace app {
 
@@ -65,15 +65,46 @@ public:
   {
   }
 
+  // Items with a matrix from an extension, the matrix is loaded the
+  // first time it's needed (to paint the preview or to use it), not
+  // when the combobox is filled.
+  DitherItem(render::DitheringAlgorithm algo,
+             const Extension::DitheringMatrixInfo& matrixInfo,
+             const std::string& text)
+    : DitherItem(algo, render::DitheringMatrix(), text)
+  {
+    m_matrixInfo = matrixInfo;
+  }
+
+  DitherItem(const Extension::DitheringMatrixInfo& matrixInfo,
+             const std::string& text)
+    : DitherItem(render::DitheringMatrix(), text)
+  {
+    m_matrixInfo = matrixInfo;
+  }
+
   render::DitheringAlgorithm algo() const {
     return m_dithering.algorithm();
   }
 
-  render::DitheringMatrix matrix() const {
-    return m_dithering.matrix();
+  render::DitheringMatrix matrix() {
+    return dithering().matrix();
   }
 
 private:
+  const render::Dithering& dithering() {
+    if (m_matrixInfo) {
+      try {
+        m_dithering.matrix(m_matrixInfo->matrix());
+      }
+      catch (const std::exception& e) {
+        LOG(ERROR, "%s\n", e.what());
+      }
+      m_matrixInfo.reset();
+    }
+    return m_dithering;
+  }
+
   os::Surface* preview() {
     const doc::Palette* palette = get_current_palette();
     ASSERT(palette);
@@ -97,7 +128,7 @@ private:
       gfx::Point(w-1, 0),
       doc::rgba(0, 0, 0, 255),
       doc::rgba(255, 255, 255, 255),
-      (m_matrixOnly ? m_dithering.matrix():
+      (m_matrixOnly ? dithering().matrix():
                       render::DitheringMatrix()));
 
     doc::ImageRef image2;
@@ -109,7 +140,7 @@ private:
       doc::clear_image(image2.get(), 0);
       render::convert_pixel_format(
         image1.get(), image2.get(), IMAGE_INDEXED,
-        m_dithering, nullptr, palette, true, -1, nullptr);
+        dithering(), nullptr, palette, true, -1, nullptr);
     }
 
     m_preview = os::instance()->makeRgbaSurface(w, h);
@@ -169,6 +200,7 @@ private:
 
   bool m_matrixOnly;
   render::Dithering m_dithering;
+  std::optional<Extension::DitheringMatrixInfo> m_matrixInfo;
   os::SurfaceRef m_preview;
   doc::ObjectId m_palId;
   int m_palMods;
@@ -218,29 +250,17 @@ void DitheringSelector::regenerate(int selectedItemIndex)
                              render::DitheringMatrix(),
                              Strings::dithering_selector_no_dithering()));
       for (const auto& it : ditheringMatrices) {
-        try {
-          addItem(new DitherItem(
-            render::DitheringAlgorithm::Ordered,
-            it.matrix(),
-            Strings::dithering_selector_ordered_dithering() + it.name()));
-        }
-        catch (const std::exception& e) {
-          LOG(ERROR, "%s\n", e.what());
-          Console::showException(e);
-        }
+        addItem(new DitherItem(
+          render::DitheringAlgorithm::Ordered,
+          it,
+          Strings::dithering_selector_ordered_dithering() + it.name()));
       }
       for (const auto& it : ditheringMatrices) {
-        try {
-          addItem(
-            new DitherItem(
-              render::DitheringAlgorithm::Old,
-              it.matrix(),
-              Strings::dithering_selector_old_dithering() + it.name()));
-        }
-        catch (const std::exception& e) {
-          LOG(ERROR, "%s\n", e.what());
-          Console::showException(e);
-        }
+        addItem(
+          new DitherItem(
+            render::DitheringAlgorithm::Old,
+            it,
+            Strings::dithering_selector_old_dithering() + it.name()));
       }
       addItem(
         new DitherItem(
@@ -251,15 +271,8 @@ void DitheringSelector::regenerate(int selectedItemIndex)
     case SelectMatrix:
       addItem(new DitherItem(render::DitheringMatrix(),
                              Strings::dithering_selector_no_dithering()));
-      for (auto& it : ditheringMatrices) {
-        try {
-          addItem(new DitherItem(it.matrix(), it.name()));
-        }
-        catch (const std::exception& e) {
-          LOG(ERROR, "%s\n", e.what());
-          Console::showException(e);
-        }
-      }
+      for (auto& it : ditheringMatrices)
+        addItem(new DitherItem(it, it.name()));
       break;
   }
   selectedItemIndex = std::clamp(selectedItemIndex, 0, std::max(0, getItemCount()-1));
@@ -38,7 +38,10 @@
 #include "app/util/clipboard.h"
 #include "app/util/range_utils.h"
 #include "base/fs.h"
+#include "doc/cel.h"
 #include "doc/color.h"
+#include "doc/grid.h"
+#include "doc/image.h"
 #include "doc/layer.h"
 #include "doc/sprite.h"
 #include "fmt/format.h"
@@ -403,6 +406,31 @@ void DocView::onGeneralUpdate(DocEvent& ev)
     m_editor->updateEditor(true);
 }
 
+void DocView::onImagePixelsModified(DocEvent& ev)
+{
+  if (!m_editor->isVisible() || !ev.image() || !ev.sprite())
+    return;
+
+  // Convert the modified region of the image to canvas coordinates
+  // for each cel (linked cels included) that shows it in the
+  // current frame.
+  gfx::Region canvasRgn;
+  for (Cel* cel : ev.sprite()->cels(m_editor->frame())) {
+    if (cel->image() != ev.image())
+      continue;
+
+    gfx::Region rgn(ev.region());
+    if (cel->image()->pixelFormat() == IMAGE_TILEMAP)
+      rgn = cel->grid().tileToCanvas(rgn);
+    else
+      rgn.offset(cel->position());
+    canvasRgn |= rgn;
+  }
+
+  if (!canvasRgn.isEmpty())
+    m_editor->drawSpriteClipped(canvasRgn);
+}
+
 void DocView::onSpritePixelsModified(DocEvent& ev)
 {
   if (m_editor->isVisible() &&
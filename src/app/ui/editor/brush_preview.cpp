@@ -422,8 +422,9 @@ void BrushPreview::show(const gfx::Point& screenPos)
       createCrosshairCursor(&g, uiCursorColor);
     }
 
-    forEachBrushPixel(&g, spritePos, uiCursorColor, &BrushPreview::savePixelDelegate);
-    forEachBrushPixel(&g, spritePos, uiCursorColor, &BrushPreview::drawPixelDelegate);
+    calcCursorPixels(spritePos);
+    forEachBrushPixel(&g, uiCursorColor, &BrushPreview::savePixelDelegate);
+    forEachBrushPixel(&g, uiCursorColor, &BrushPreview::drawPixelDelegate);
     m_withModifiedPixels = true;
   }
 
@@ -468,7 +469,7 @@ void BrushPreview::hide()
     // Restore pixels
     ui::ScreenGraphics g(m_editor->display());
     ui::SetClip clip(&g);
-    forEachBrushPixel(&g, m_editorPosition, gfx::ColorNone,
+    forEachBrushPixel(&g, gfx::ColorNone,
                       &BrushPreview::clearPixelDelegate);
   }
 
@@ -490,6 +491,7 @@ void BrushPreview::hide()
   }
 
   m_onScreen = false;
+  m_cursorPixelsHidden = false;
 
   m_clippingRegion.clear();
   m_oldClippingRegion.clear();
@@ -514,6 +516,45 @@ void BrushPreview::redraw()
   }
 }
 
+void BrushPreview::hideCursorPixels()
+{
+  if (!m_onScreen || !m_withModifiedPixels)
+    return;
+
+  m_editor->getDrawableRegion(m_clippingRegion, ui::Widget::kCutTopWindows);
+  m_clippingRegion.createSubtraction(m_clippingRegion,
+                                     m_editor->getUpdateRegion());
+
+  ui::ScreenGraphics g(m_editor->display());
+  ui::SetClip clip(&g);
+  forEachBrushPixel(&g, gfx::ColorNone,
+                    &BrushPreview::clearPixelDelegate);
+
+  m_withModifiedPixels = false;
+  m_cursorPixelsHidden = true;
+}
+
+void BrushPreview::showCursorPixels()
+{
+  if (!m_onScreen || !m_cursorPixelsHidden)
+    return;
+
+  m_editor->getDrawableRegion(m_clippingRegion, ui::Widget::kCutTopWindows);
+  m_clippingRegion.createSubtraction(m_clippingRegion,
+                                     m_editor->getUpdateRegion());
+
+  ui::ScreenGraphics g(m_editor->display());
+  ui::SetClip clip(&g);
+  const gfx::Color uiCursorColor =
+    color_utils::color_for_ui(Preferences::instance().cursor.cursorColor());
+  forEachBrushPixel(&g, uiCursorColor, &BrushPreview::savePixelDelegate);
+  forEachBrushPixel(&g, uiCursorColor, &BrushPreview::drawPixelDelegate);
+
+  m_oldClippingRegion = m_clippingRegion;
+  m_withModifiedPixels = true;
+  m_cursorPixelsHidden = false;
+}
+
 void BrushPreview::invalidateRegion(const gfx::Region& region)
 {
   m_clippingRegion.createSubtraction(m_clippingRegion, region);
@@ -527,6 +568,7 @@ void BrushPreview::calculateTileBoundariesOrigin(const doc::Grid& grid,
   gfx::Point canvasPos = grid.tileToCanvas(grid.canvasToTile(spritePos));
   m_brushBoundaries.offset(canvasPos.x - spritePos.x,
                            canvasPos.y - spritePos.y);
+  ++m_brushBoundariesVer;
 }
 
 void BrushPreview::generateBoundaries(const Site& site,
@@ -577,6 +619,7 @@ void BrushPreview::generateBoundaries(const Site& site,
   }
 
   m_brushBoundaries.regen(mask ? mask: brushImage);
+  ++m_brushBoundariesVer;
   if (tilemapMode == TilemapMode::Pixels) {
     if (!isOnePixel)
       m_brushBoundaries.offset(-brush->center().x,
@@ -760,28 +803,34 @@ void BrushPreview::createCrosshairCursor(ui::Graphics* g,
   }
 }
 
+void BrushPreview::calcCursorPixels(const gfx::Point& spritePos)
+{
+  m_cursorPixels.clear();
+
+  if (m_type & SELECTION_CROSSHAIR)
+    traceSelectionCrossPixels(spritePos, 1);
+
+  if (m_type & BRUSH_BOUNDARIES)
+    traceBrushBoundaries(spritePos);
+}
+
 void BrushPreview::forEachBrushPixel(
   ui::Graphics* g,
-  const gfx::Point& spritePos,
   gfx::Color color,
   PixelDelegate pixelDelegate)
 {
   m_savedPixelsIterator = 0;
 
-  if (m_type & SELECTION_CROSSHAIR)
-    traceSelectionCrossPixels(g, spritePos, color, 1, pixelDelegate);
-
-  if (m_type & BRUSH_BOUNDARIES)
-    traceBrushBoundaries(g, spritePos, color, pixelDelegate);
+  for (const gfx::Point& pt : m_cursorPixels)
+    (this->*pixelDelegate)(g, pt, color);
 
   m_savedPixelsLimit = m_savedPixelsIterator;
 }
 
 // Old thick cross (used for selection tools)
 void BrushPreview::traceSelectionCrossPixels(
-  ui::Graphics* g,
-  const gfx::Point& pt, gfx::Color color,
-  int thickness, PixelDelegate pixelDelegate)
+  const gfx::Point& pt,
+  int thickness)
 {
   static int cross[6*6] = {
     0, 0, 1, 1, 0, 0,
@@ -809,22 +858,17 @@ void BrushPreview::traceSelectionCrossPixels(
       out.x += ((u<3) ? u-size.w-3: u-size.w-3+size2.w);
       out.y += ((v<3) ? v-size.h-3: v-size.h-3+size2.h);
 
-      (this->*pixelDelegate)(g, out, color);
+      m_cursorPixels.push_back(out);
     }
   }
 }
 
 // Current brush edges
-void BrushPreview::traceBrushBoundaries(ui::Graphics* g,
-                                        gfx::Point pos,
-                                        gfx::Color color,
-                                        PixelDelegate pixelDelegate)
+void BrushPreview::traceBrushBoundaries(gfx::Point pos)
 {
-  for (const auto& seg : m_brushBoundaries) {
-    gfx::Rect bounds = seg.bounds();
-    bounds.offset(pos);
-    bounds = m_editor->editorToScreen(bounds);
-
+  auto addSegmentPixels = [](const doc::MaskBoundaries::Segment& seg,
+                             gfx::Rect bounds,
+                             std::vector<gfx::Point>& pixels) {
     if (seg.open()) {
       if (seg.vertical()) --bounds.x;
       else --bounds.y;
@@ -833,12 +877,46 @@ void BrushPreview::traceBrushBoundaries(ui::Graphics* g,
     gfx::Point pt(bounds.x, bounds.y);
     if (seg.vertical()) {
       for (; pt.y<bounds.y+bounds.h; ++pt.y)
-        (this->*pixelDelegate)(g, pt, color);
+        pixels.push_back(pt);
     }
     else {
       for (; pt.x<bounds.x+bounds.w; ++pt.x)
-        (this->*pixelDelegate)(g, pt, color);
+        pixels.push_back(pt);
     }
+  };
+
+  const render::Projection& proj = m_editor->projection();
+  const render::Zoom& zoom = proj.zoom();
+
+  // With integer zoom levels the screen position of each segment is
+  // the screen position of the brush plus the projected segment.
+  if (zoom.isSimpleZoomLevel() && zoom.scale() >= 1.0) {
+    const int zoomScale = int(zoom.scale());
+    if (m_boundariesPixelsVer != m_brushBoundariesVer ||
+        m_boundariesPixelsZoom != zoomScale ||
+        m_boundariesPixelsRatioW != proj.pixelRatio().w ||
+        m_boundariesPixelsRatioH != proj.pixelRatio().h) {
+      m_boundariesPixels.clear();
+      for (const auto& seg : m_brushBoundaries)
+        addSegmentPixels(seg, proj.apply(seg.bounds()), m_boundariesPixels);
+
+      m_boundariesPixelsVer = m_brushBoundariesVer;
+      m_boundariesPixelsZoom = zoomScale;
+      m_boundariesPixelsRatioW = proj.pixelRatio().w;
+      m_boundariesPixelsRatioH = proj.pixelRatio().h;
+    }
+
+    const gfx::Point origin = m_editor->editorToScreen(pos);
+    m_cursorPixels.reserve(m_cursorPixels.size() + m_boundariesPixels.size());
+    for (const gfx::Point& pt : m_boundariesPixels)
+      m_cursorPixels.push_back(pt + origin);
+    return;
+  }
+
+  for (const auto& seg : m_brushBoundaries) {
+    gfx::Rect bounds = seg.bounds();
+    bounds.offset(pos);
+    addSegmentPixels(seg, m_editor->editorToScreen(bounds), m_cursorPixels);
   }
 }
 
@@ -81,6 +81,13 @@ namespace app {
     void show(const gfx::Point& screenPos);
     void hide();
     void redraw();
+
+    // Restores/draws again only the cursor pixels modified in the
+    // display (selection crosshair and brush boundaries), keeping the
+    // real preview of the brush in the sprite. Used to draw
+    // something below the cursor without rendering the sprite again.
+    void hideCursorPixels();
+    void showCursorPixels();
     void discardBrushPreview();
 
     void invalidateRegion(const gfx::Region& region);
@@ -102,14 +109,17 @@ namespace app {
     // Creates a little native cursor to draw the CROSSHAIR
     void createCrosshairCursor(ui::Graphics* g, const gfx::Color cursorColor);
 
+    // Calculates the screen pixels of the selection crosshair and
+    // brush boundaries (m_cursorPixels) in the given sprite position.
+    void calcCursorPixels(const gfx::Point& spritePos);
+
     void forEachBrushPixel(
       ui::Graphics* g,
-      const gfx::Point& spritePos,
       gfx::Color color,
       PixelDelegate pixelDelegate);
 
-    void traceSelectionCrossPixels(ui::Graphics* g, const gfx::Point& pt, gfx::Color color, int thickness, PixelDelegate pixel);
-    void traceBrushBoundaries(ui::Graphics* g, gfx::Point pos, gfx::Color color, PixelDelegate pixel);
+    void traceSelectionCrossPixels(const gfx::Point& pt, int thickness);
+    void traceBrushBoundaries(gfx::Point pos);
 
     void savePixelDelegate(ui::Graphics* g, const gfx::Point& pt, gfx::Color color);
     void drawPixelDelegate(ui::Graphics* g, const gfx::Point& pt, gfx::Color color);
@@ -132,10 +142,30 @@ namespace app {
     // Information about current brush
     doc::MaskBoundaries m_brushBoundaries;
     int m_brushGen;
+    // Incremented each time m_brushBoundaries is modified.
+    int m_brushBoundariesVer = 0;
+
+    // Screen pixels of the cursor that we save/draw/restore on the
+    // screen, calculated only one time in show().
+    std::vector<gfx::Point> m_cursorPixels;
+
+    // Pixels of the brush boundaries relative to the brush position
+    // on the screen for integer zoom levels (where the projection of
+    // the boundaries doesn't depend on the position), so we don't
+    // need to project each segment on each mouse movement.
+    std::vector<gfx::Point> m_boundariesPixels;
+    int m_boundariesPixelsVer = -1;
+    int m_boundariesPixelsZoom = 0;
+    int m_boundariesPixelsRatioW = 0;
+    int m_boundariesPixelsRatioH = 0;
 
     // True if we've modified pixels in the display surface
     // (e.g. drawing the selection crosshair or the brush edges).
     bool m_withModifiedPixels = false;
+    // True if the modified pixels were restored with
+    // hideCursorPixels() and must be drawn again in
+    // showCursorPixels().
+    bool m_cursorPixelsHidden = false;
     std::vector<gfx::Color> m_savedPixels;
     int m_savedPixelsIterator;
     int m_savedPixelsLimit;
@@ -175,6 +205,21 @@ namespace app {
     bool m_onScreen;
   };
 
+  class HideBrushPreviewPixels {
+  public:
+    HideBrushPreviewPixels(BrushPreview& brushPreview)
+      : m_brushPreview(brushPreview) {
+      m_brushPreview.hideCursorPixels();
+    }
+
+    ~HideBrushPreviewPixels() {
+      m_brushPreview.showCursorPixels();
+    }
+
+  private:
+    BrushPreview& m_brushPreview;
+  };
+
 } // namespace app
 
 #endif
@@ -71,10 +71,18 @@ DrawingState::DrawingState(Editor* editor,
   , m_mouseMoveReceived(false)
   , m_mousePressedReceived(false)
   , m_processScrollChange(true)
+  , m_flushTimer(10)
 {
+  m_toolLoopManager->setCoalesceMovements(true);
+  m_flushTimer.Tick.connect([this]{ onFlushPendingPoints(); });
+
   m_beforeCmdConn =
     UIContext::instance()->BeforeCommandExecution.connect(
       &DrawingState::onBeforeCommandExecution, this);
+
+  // The tool loop needs all the mouse positions (and pressure
+  // values) to draw the whole stroke
+  editor->enableFlags(FULL_MOUSE_HISTORY);
 }
 
 DrawingState::~DrawingState()
@@ -151,6 +159,7 @@ void DrawingState::notifyToolLoopModifiersChange(Editor* editor)
 void DrawingState::onBeforePopState(Editor* editor)
 {
   m_beforeCmdConn.disconnect();
+  editor->disableFlags(FULL_MOUSE_HISTORY);
   StandbyState::onBeforePopState(editor);
 }
 
@@ -393,6 +402,20 @@ void DrawingState::handleMouseMovement()
   // Notify mouse movement to the tool
   ASSERT(m_toolLoopManager);
   m_toolLoopManager->movement(m_lastPointer);
+
+  if (m_toolLoopManager->hasPendingPoints()) {
+    if (!m_flushTimer.isRunning())
+      m_flushTimer.start();
+  }
+  else if (m_flushTimer.isRunning())
+    m_flushTimer.stop();
+}
+
+void DrawingState::onFlushPendingPoints()
+{
+  m_flushTimer.stop();
+  if (m_toolLoopManager)
+    m_toolLoopManager->flushPendingPoints();
 }
 
 bool DrawingState::canInterpretMouseMovementAsJustOneClick()
@@ -456,6 +479,8 @@ void DrawingState::destroyLoop(Editor* editor)
   if (editor)
     editor->renderEngine().removePreviewImage();
 
+  m_flushTimer.stop();
+
   if (m_toolLoopManager)
     m_toolLoopManager->end();
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -15,6 +15,8 @@
 #include "app/ui/editor/standby_state.h"
 #include "base/time.h"
 #include "obs/connection.h"
+#include "ui/timer.h"
+
 #include <memory>
 
 namespace app {
@@ -72,6 +74,7 @@ namespace app {
 
   private:
     void handleMouseMovement();
+    void onFlushPendingPoints();
     bool canInterpretMouseMovementAsJustOneClick();
     bool canExecuteCommands();
     void onBeforeCommandExecution(CommandExecutionEvent& ev);
@@ -117,6 +120,11 @@ namespace app {
     // Locks the scroll
     bool m_processScrollChange;
 
+    // Used to paint the points accumulated by the ToolLoopManager
+    // when the mouse stops moving (events are coalesced when they
+    // arrive faster than we can paint them).
+    ui::Timer m_flushTimer;
+
     obs::scoped_connection m_beforeCmdConn;
   };
 
@@ -26,6 +26,7 @@
 #include "app/modules/gfx.h"
 #include "app/modules/gui.h"
 #include "app/modules/palettes.h"
+#include "app/perf_trace.h"
 #include "app/pref/preferences.h"
 #include "app/snap_to_grid.h"
 #include "app/tools/active_tool.h"
@@ -38,6 +39,7 @@
 #include "app/ui/doc_view.h"
 #include "app/ui/editor/drawing_state.h"
 #include "app/ui/editor/editor_customization_delegate.h"
+#include "app/ui/editor/editor_async_render.h"
 #include "app/ui/editor/editor_decorator.h"
 #include "app/ui/editor/editor_render.h"
 #include "app/ui/editor/glue.h"
@@ -71,8 +73,11 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <iterator>
 #include <limits>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace app {
 
@@ -349,6 +354,9 @@ void Editor::getInvalidDecoratoredRegion(gfx::Region& region)
       region |= gfx::Region(m_perfInfoBounds);
   }
 #endif // ENABLE_DEVMODE
+
+  if (!m_perfHudBounds.isEmpty())
+    region |= gfx::Region(m_perfHudBounds);
 }
 
 void Editor::setLayer(const Layer* layer)
@@ -582,8 +590,46 @@ void Editor::updateEditor(const bool restoreScrollPos)
   View::getView(this)->updateView(restoreScrollPos);
 }
 
+// Shows the time of the last operation of each measured category
+// (PerfScope) in the bottom-left corner of the editor viewport.
+void Editor::drawPerfHud(ui::Graphics* g)
+{
+  View* view = View::getView(this);
+  const gfx::Rect vp = view->viewportBounds();
+
+  std::vector<std::string> lines;
+  if (is_perf_trace_recording())
+    lines.push_back("Recording trace...");
+  for (int i=0; i<int(PerfCategory::Count); ++i) {
+    const auto category = PerfCategory(i);
+    const PerfStats stats = get_perf_stats(category);
+    lines.push_back(
+      fmt::format("{} {:.2f}ms avg={:.2f}ms max={:.2f}ms n={}",
+                  perf_category_name(category),
+                  stats.last * 1000.0,
+                  stats.avg() * 1000.0,
+                  stats.max * 1000.0,
+                  stats.count));
+  }
+
+  const int lineHeight = g->measureUIText("Xy").h;
+  gfx::Point pt(vp.x, vp.y2() - lineHeight*int(lines.size()));
+  m_perfHudBounds = gfx::Rect(pt, gfx::Size(0, 0));
+  for (const std::string& line : lines) {
+    g->drawText(
+      line,
+      gfx::rgba(255, 255, 255, 255),
+      gfx::rgba(0, 0, 0, 255),
+      pt - bounds().origin());
+    m_perfHudBounds |= gfx::Rect(pt, g->measureUIText(line));
+    pt.y += lineHeight;
+  }
+}
+
 void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& spriteRectToDraw, int dx, int dy)
 {
+  PerfScope perf(PerfCategory::Render, "Editor::drawOneSpriteUnclippedRect");
+
   // Clip from sprite and apply zoom
   gfx::Rect rc = m_sprite->bounds().createIntersection(spriteRectToDraw);
   rc = m_proj.apply(rc);
@@ -591,8 +637,11 @@ void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& sprite
   gfx::Rect dest(dx + m_padding.x + rc.x,
                  dy + m_padding.y + rc.y, 0, 0);
 
-  // Clip from graphics/screen
-  const gfx::Rect& clip = g->getClipBounds();
+  // Clip from graphics/screen (or from the visible area of all
+  // copies when we render the area for all copies of the tiled mode)
+  const gfx::Rect clip = (m_tiledRender.enabled && !m_tiledRender.valid ?
+                          gfx::Rect(m_tiledRender.clip).offset(dx, dy):
+                          g->getClipBounds());
   if (dest.x < clip.x) {
     rc.x += clip.x - dest.x;
     rc.w -= clip.x - dest.x;
@@ -645,10 +694,31 @@ void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& sprite
     return;
 
   // rc2 is the rectangle used to create a temporal rendered image of the sprite
-  const auto& pref = Preferences::instance();
   const bool newEngine = isUsingNewRenderEngine();
+  const int reduction = (newEngine ? renderReduction(): 1);
+  render::Projection renderProj;
   gfx::Rect rc2;
-  if (newEngine) {
+  if (newEngine && reduction > 1) {
+    // Zoomed out sprite, the exposed rectangle is rendered scaled
+    // down (1:reduction) and then the GPU scales it down the rest of
+    // the zoom level (so it's not needed to render the whole sprite
+    // at 100% to see it at 10%).
+    renderProj.setZoom(render::Zoom(1, reduction));
+    rc2.x = expose.x / reduction;
+    rc2.y = expose.y / reduction;
+    rc2.w = (expose.x2() + reduction - 1) / reduction - rc2.x;
+    rc2.h = (expose.y2() + reduction - 1) / reduction - rc2.y;
+
+    const gfx::Rect spriteRc = (gfx::Rect(rc2.x * reduction,
+                                          rc2.y * reduction,
+                                          rc2.w * reduction,
+                                          rc2.h * reduction) & m_sprite->bounds());
+    dest.x = dx + m_padding.x + m_proj.applyX(spriteRc.x);
+    dest.y = dy + m_padding.y + m_proj.applyY(spriteRc.y);
+    dest.w = m_proj.applyX(spriteRc.w);
+    dest.h = m_proj.applyY(spriteRc.h);
+  }
+  else if (newEngine) {
     rc2 = expose;               // New engine, exposed rectangle (without zoom)
     dest.x = dx + m_padding.x + m_proj.applyX(rc2.x);
     dest.y = dy + m_padding.y + m_proj.applyY(rc2.y);
@@ -661,140 +731,109 @@ void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& sprite
     dest.h = rc.h;
   }
 
-  // Convert the render to a os::Surface
-  static os::SurfaceRef rendered = nullptr; // TODO move this to other centralized place
-  const auto& renderProperties = m_renderEngine->properties();
-  try {
-    // Generate a "expose sprite pixels" notification. This is used by
-    // tool managers that need to validate this region (copy pixels from
-    // the original cel) before it can be used by the RenderEngine.
-    m_document->notifyExposeSpritePixels(m_sprite, gfx::Region(expose));
-
-    m_renderEngine->setNewBlendMethod(pref.experimental.newBlend());
-    m_renderEngine->setRefLayersVisiblity(true);
-    m_renderEngine->setSelectedLayer(m_layer);
-    m_renderEngine->setNonactiveLayersOpacity(otherLayersOpacity());
-    m_renderEngine->setupBackground(m_document, IMAGE_RGB);
-    m_renderEngine->disableOnionskin();
-
-    if ((m_flags & kShowOnionskin) == kShowOnionskin) {
-      if (m_docPref.onionskin.active()) {
-        OnionskinOptions opts(
-          (m_docPref.onionskin.type() == app::gen::OnionskinType::MERGE ?
-           render::OnionskinType::MERGE:
-           (m_docPref.onionskin.type() == app::gen::OnionskinType::RED_BLUE_TINT ?
-            render::OnionskinType::RED_BLUE_TINT:
-            render::OnionskinType::NONE)));
-
-        opts.position(m_docPref.onionskin.position());
-        opts.prevFrames(m_docPref.onionskin.prevFrames());
-        opts.nextFrames(m_docPref.onionskin.nextFrames());
-        opts.opacityBase(m_docPref.onionskin.opacityBase());
-        opts.opacityStep(m_docPref.onionskin.opacityStep());
-        opts.layer(m_docPref.onionskin.currentLayer() ? m_layer: nullptr);
-
-        Tag* tag = nullptr;
-        if (m_docPref.onionskin.loopTag())
-          tag = m_sprite->tags().innerTag(m_frame);
-        opts.loopTag(tag);
-
-        m_renderEngine->setOnionskin(opts);
-      }
-    }
-
-    ExtraCelRef extraCel = m_document->extraCel();
-    if (extraCel &&
-        extraCel->type() != render::ExtraType::NONE) {
-      m_renderEngine->setExtraImage(
-        extraCel->type(),
-        extraCel->cel(),
-        extraCel->image(),
-        extraCel->blendMode(),
-        m_layer, m_frame);
-    }
+  // Reuse the area rendered for the first copy of the tiled mode
+  const bool reuseTiledRender =
+    (m_tiledRender.valid && m_tiledRender.bounds.contains(rc2));
 
-    // Render background first (e.g. new ShaderRenderer will paint the
-    // background on the screen first and then composite the rendered
-    // sprite on it.)
-    if (renderProperties.renderBgOnScreen) {
-      m_renderEngine->setProjection(m_proj);
-      m_renderEngine->renderCheckeredBackground(
-        g->getInternalSurface(),
-        m_sprite,
-        gfx::Clip(dest.x + g->getInternalDeltaX(),
-                  dest.y + g->getInternalDeltaY(),
-                  m_proj.apply(rc2)));
-    }
-
-    // Create a temporary surface to draw the sprite on it
-    if (!rendered ||
-        rendered->width() < rc2.w ||
-        rendered->height() < rc2.h ||
-        rendered->colorSpace() != m_document->osColorSpace()) {
-      const int maxw = std::max(rc2.w, rendered ? rendered->width(): 0);
-      const int maxh = std::max(rc2.h, rendered ? rendered->height(): 0);
-      rendered = os::instance()->makeRgbaSurface(
-        maxw, maxh, m_document->osColorSpace());
-    }
-
-    m_renderEngine->setProjection(
-      newEngine ? render::Projection(): m_proj);
-    m_renderEngine->renderSprite(
-      rendered.get(), m_sprite, m_frame, gfx::Clip(0, 0, rc2));
+  // Big areas can be rendered in a background thread
+  if (!newEngine || reduction > 1 || reuseTiledRender ||
+      !drawAsyncRender(g, rc2, dest, dx, dy)) {
+    // Convert the render to a os::Surface
+    static os::SurfaceRef rendered = nullptr; // TODO move this to other centralized place
+    const auto& renderProperties = m_renderEngine->properties();
+    try {
+      if (!reuseTiledRender) {
+        // Generate a "expose sprite pixels" notification. This is used by
+        // tool managers that need to validate this region (copy pixels from
+        // the original cel) before it can be used by the RenderEngine.
+        m_document->notifyExposeSpritePixels(m_sprite, gfx::Region(expose));
+      }
 
-    m_renderEngine->removeExtraImage();
+      setupRenderEngine(*m_renderEngine);
+
+      // Render background first (e.g. new ShaderRenderer will paint the
+      // background on the screen first and then composite the rendered
+      // sprite on it.)
+      if (renderProperties.renderBgOnScreen) {
+        m_renderEngine->setProjection(m_proj);
+        m_renderEngine->renderCheckeredBackground(
+          g->getInternalSurface(),
+          m_sprite,
+          gfx::Clip(dest.x + g->getInternalDeltaX(),
+                    dest.y + g->getInternalDeltaY(),
+                    m_proj.apply(rc2)));
+      }
 
-    // If the checkered background is visible in this sprite, we save
-    // all settings of the background for this document.
-    if (!m_sprite->isOpaque())
-      m_docPref.bg.forceSection();
-  }
-  catch (const std::exception& e) {
-    Console::showException(e);
-  }
+      if (!reuseTiledRender) {
+        ExtraCelRef extraCel = m_document->extraCel();
+        if (extraCel &&
+            extraCel->type() != render::ExtraType::NONE) {
+          m_renderEngine->setExtraImage(
+            extraCel->type(),
+            extraCel->cel(),
+            extraCel->image(),
+            extraCel->blendMode(),
+            m_layer, m_frame);
+        }
 
-  if (rendered && rendered->nativeHandle()) {
-    os::Paint p;
-    if (newEngine) {
-      os::Sampling sampling;
-      p.srcEdges(os::Paint::SrcEdges::Fast); // Enable mipmaps if possible
+        // Create a temporary surface to draw the sprite on it
+        if (!rendered ||
+            rendered->width() < rc2.w ||
+            rendered->height() < rc2.h ||
+            rendered->colorSpace() != m_document->osColorSpace()) {
+          const int maxw = std::max(rc2.w, rendered ? rendered->width(): 0);
+          const int maxh = std::max(rc2.h, rendered ? rendered->height(): 0);
+          rendered = os::instance()->makeRgbaSurface(
+            maxw, maxh, m_document->osColorSpace());
+        }
 
-      if (m_proj.scaleX() < 1.0) {
-        switch (pref.editor.downsampling()) {
-          case gen::Downsampling::NEAREST:
-            sampling = os::Sampling(os::Sampling::Filter::Nearest);
-            break;
-          case gen::Downsampling::BILINEAR:
-            sampling = os::Sampling(os::Sampling::Filter::Linear);
-            break;
-          case gen::Downsampling::BILINEAR_MIPMAP:
-            sampling = os::Sampling(os::Sampling::Filter::Linear,
-                                    os::Sampling::Mipmap::Nearest);
-            break;
-          case gen::Downsampling::TRILINEAR_MIPMAP:
-            sampling = os::Sampling(os::Sampling::Filter::Linear,
-                                    os::Sampling::Mipmap::Linear);
-            break;
+        // The box filter is used to render the scaled down sprite if
+        // the GPU is going to interpolate pixels too (it uses the
+        // cached mipmaps of the cels)
+        m_renderEngine->setBoxFilterScaleDown(
+          Preferences::instance().experimental.zoomOutBoxFilter() ||
+          (reduction > 1 &&
+           Preferences::instance().editor.downsampling() != gen::Downsampling::NEAREST));
+        m_renderEngine->setProjection(
+          newEngine ? renderProj: m_proj);
+        m_renderEngine->renderSprite(
+          rendered.get(), m_sprite, m_frame, gfx::Clip(0, 0, rc2));
+
+        m_renderEngine->removeExtraImage();
+
+        // The other copies of the tiled mode can use this render
+        if (m_tiledRender.enabled) {
+          m_tiledRender.valid = true;
+          m_tiledRender.bounds = rc2;
         }
       }
 
-      if (renderProperties.requiresRgbaBackbuffer)
-        p.blendMode(os::BlendMode::SrcOver);
-      else
-        p.blendMode(os::BlendMode::Src);
-
-      g->drawSurface(rendered.get(),
-                     gfx::Rect(0, 0, rc2.w, rc2.h),
-                     dest,
-                     sampling,
-                     &p);
+      // If the checkered background is visible in this sprite, we save
+      // all settings of the background for this document.
+      if (!m_sprite->isOpaque())
+        m_docPref.bg.forceSection();
     }
-    else {
-      g->drawSurface(rendered.get(),
-                     gfx::Rect(0, 0, dest.w, dest.h),
-                     gfx::Rect(dest.x, dest.y, dest.w, dest.h),
-                     os::Sampling(os::Sampling::Filter::Nearest),
-                     &p);
+    catch (const std::exception& e) {
+      Console::showException(e);
+    }
+
+    if (rendered && rendered->nativeHandle()) {
+      // Position of rc2 in the rendered surface
+      const gfx::Point src = (reuseTiledRender ?
+                              rc2.origin() - m_tiledRender.bounds.origin():
+                              gfx::Point(0, 0));
+      if (newEngine) {
+        drawRenderedSurface(g, rendered.get(),
+                            gfx::Rect(src, rc2.size()), dest);
+      }
+      else {
+        os::Paint p;
+        g->drawSurface(rendered.get(),
+                       gfx::Rect(src.x, src.y, dest.w, dest.h),
+                       gfx::Rect(dest.x, dest.y, dest.w, dest.h),
+                       os::Sampling(os::Sampling::Filter::Nearest),
+                       &p);
+      }
     }
   }
 
@@ -856,6 +895,229 @@ void Editor::drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& sprite
   }
 }
 
+void Editor::drawRenderedSurface(ui::Graphics* g,
+                                 os::Surface* surface,
+                                 const gfx::Rect& srcRect,
+                                 const gfx::Rect& dest)
+{
+  const auto& pref = Preferences::instance();
+  os::Paint p;
+  os::Sampling sampling;
+  p.srcEdges(os::Paint::SrcEdges::Fast); // Enable mipmaps if possible
+
+  if (m_proj.scaleX() < 1.0) {
+    switch (pref.editor.downsampling()) {
+      case gen::Downsampling::NEAREST:
+        sampling = os::Sampling(os::Sampling::Filter::Nearest);
+        break;
+      case gen::Downsampling::BILINEAR:
+        sampling = os::Sampling(os::Sampling::Filter::Linear);
+        break;
+      case gen::Downsampling::BILINEAR_MIPMAP:
+        sampling = os::Sampling(os::Sampling::Filter::Linear,
+                                os::Sampling::Mipmap::Nearest);
+        break;
+      case gen::Downsampling::TRILINEAR_MIPMAP:
+        sampling = os::Sampling(os::Sampling::Filter::Linear,
+                                os::Sampling::Mipmap::Linear);
+        break;
+    }
+  }
+
+  if (m_renderEngine->properties().requiresRgbaBackbuffer)
+    p.blendMode(os::BlendMode::SrcOver);
+  else
+    p.blendMode(os::BlendMode::Src);
+
+  g->drawSurface(surface, srcRect, dest, sampling, &p);
+}
+
+// Maximum scale down factor used to render zoomed out sprites with
+// the new render engine (see Editor::renderReduction()).
+static constexpr int kMaxRenderReduction = 64;
+
+// Areas smaller than this are rendered in the UI thread even if the
+// async render is enabled (e.g. small areas modified by a tool).
+static constexpr int kAsyncRenderMinPixels = 256*256;
+
+// Maximum size of the visible area rendered in a background thread
+// (the surface uses 4 bytes per pixel).
+static constexpr int kAsyncRenderMaxPixels = 8192*8192;
+
+bool Editor::drawAsyncRender(ui::Graphics* g,
+                             const gfx::Rect& rc,
+                             const gfx::Rect& dest,
+                             int dx, int dy)
+{
+  if (!Preferences::instance().experimental.asyncRender() ||
+      rc.w*rc.h < kAsyncRenderMinPixels ||
+      // Each frame of the animation must be shown in time
+      isPlaying() ||
+      m_renderEngine->properties().renderBgOnScreen ||
+      // The sprite is being modified (we need each change on the
+      // screen as soon as possible)
+      m_renderEngine->hasPreviewImage()) {
+    return false;
+  }
+
+  ExtraCelRef extraCel = m_document->extraCel();
+  if (extraCel &&
+      extraCel->type() != render::ExtraType::NONE)
+    return false;
+
+  // Everything that can change the rendered pixels
+  const auto& pref = Preferences::instance();
+  EditorAsyncRender::Key key;
+  key.spriteId = m_sprite->id();
+  key.frame = m_frame;
+  key.colorSpace = m_document->osColorSpace();
+  key.options = {
+    pref.experimental.newBlend(),
+    int(m_layer ? m_layer->id(): 0),
+    otherLayersOpacity(),
+    int(m_sprite->pixelFormat()),
+    int(m_sprite->transparentColor()),
+    int(m_docPref.bg.type()),
+    m_docPref.bg.zoom(),
+    m_docPref.bg.size().w,
+    m_docPref.bg.size().h,
+    int(color_utils::color_for_ui(m_docPref.bg.color1())),
+    int(color_utils::color_for_ui(m_docPref.bg.color2())),
+  };
+
+  frame_t fromFrame = m_frame;
+  frame_t toFrame = m_frame;
+  if ((m_flags & kShowOnionskin) == kShowOnionskin &&
+      m_docPref.onionskin.active()) {
+    const Tag* tag = (m_docPref.onionskin.loopTag() ?
+                      m_sprite->tags().innerTag(m_frame): nullptr);
+    key.options.insert(
+      key.options.end(),
+      { int(m_docPref.onionskin.type()),
+        int(m_docPref.onionskin.position()),
+        m_docPref.onionskin.prevFrames(),
+        m_docPref.onionskin.nextFrames(),
+        m_docPref.onionskin.opacityBase(),
+        m_docPref.onionskin.opacityStep(),
+        m_docPref.onionskin.currentLayer(),
+        int(tag ? tag->id(): 0) });
+
+    if (tag) {
+      fromFrame = tag->fromFrame();
+      toFrame = tag->toFrame();
+    }
+    else {
+      fromFrame = std::max<frame_t>(0, m_frame - m_docPref.onionskin.prevFrames());
+      toFrame = std::min<frame_t>(m_sprite->lastFrame(),
+                                  m_frame + m_docPref.onionskin.nextFrames());
+    }
+  }
+  EditorAsyncRender::collectVersions(m_sprite, fromFrame, toFrame,
+                                     key.versions);
+
+  if (!m_asyncRender) {
+    m_asyncRender = std::make_unique<EditorAsyncRender>(
+      [this]{ invalidate(); });
+  }
+
+  gfx::Rect bounds;
+  if (os::Surface* surface = m_asyncRender->get(key, rc, bounds)) {
+    drawRenderedSurface(g, surface,
+                        gfx::Rect(rc).offset(-bounds.origin()), dest);
+    return true;
+  }
+
+  // Render the whole visible area, so we don't need to render the
+  // sprite again for each small scroll movement
+  gfx::Rect visible = getVisibleSpriteBounds();
+  visible.enlarge(1);
+  visible |= rc;
+  visible &= m_sprite->bounds();
+  if (visible.w*visible.h > kAsyncRenderMaxPixels)
+    return false;
+
+  m_document->notifyExposeSpritePixels(m_sprite, gfx::Region(visible));
+
+  auto renderEngine = std::make_unique<EditorRender>();
+  setupRenderEngine(*renderEngine);
+  renderEngine->setProjection(render::Projection());
+  m_asyncRender->render(std::move(key), visible,
+                        m_document, m_sprite, std::move(renderEngine));
+
+  if (!m_sprite->isOpaque())
+    m_docPref.bg.forceSection();
+
+  // Show the last rendered area (e.g. the previous frame) until the
+  // new render is finished
+  g->fillRect(color_utils::color_for_ui(m_docPref.bg.color1()), dest);
+
+  if (os::Surface* surface = m_asyncRender->placeholder(m_sprite->id(), bounds)) {
+    const gfx::Rect area = (rc & bounds);
+    if (!area.isEmpty()) {
+      drawRenderedSurface(
+        g, surface,
+        gfx::Rect(area).offset(-bounds.origin()),
+        gfx::Rect(dx + m_padding.x + m_proj.applyX(area.x),
+                  dy + m_padding.y + m_proj.applyY(area.y),
+                  m_proj.applyX(area.w),
+                  m_proj.applyY(area.h)));
+    }
+  }
+  return true;
+}
+
+int Editor::renderReduction() const
+{
+  // The ShaderRenderer renders the sprite directly with the GPU
+  if (m_renderEngine->type() != EditorRender::Type::kSimpleRenderer)
+    return 1;
+
+  // Maximum power of two that can be used to scale down the sprite
+  // (the rest of the zoom level is applied by the GPU)
+  int reduction = 1;
+  while (reduction < kMaxRenderReduction &&
+         m_proj.scaleX() * 2 * reduction <= 1.0 &&
+         m_proj.scaleY() * 2 * reduction <= 1.0) {
+    reduction *= 2;
+  }
+  return reduction;
+}
+
+void Editor::setupRenderEngine(EditorRender& renderEngine)
+{
+  renderEngine.setNewBlendMethod(Preferences::instance().experimental.newBlend());
+  renderEngine.setRefLayersVisiblity(true);
+  renderEngine.setSelectedLayer(m_layer);
+  renderEngine.setNonactiveLayersOpacity(otherLayersOpacity());
+  renderEngine.setupBackground(m_document, IMAGE_RGB);
+  renderEngine.disableOnionskin();
+
+  if ((m_flags & kShowOnionskin) == kShowOnionskin) {
+    if (m_docPref.onionskin.active()) {
+      OnionskinOptions opts(
+        (m_docPref.onionskin.type() == app::gen::OnionskinType::MERGE ?
+         render::OnionskinType::MERGE:
+         (m_docPref.onionskin.type() == app::gen::OnionskinType::RED_BLUE_TINT ?
+          render::OnionskinType::RED_BLUE_TINT:
+          render::OnionskinType::NONE)));
+
+      opts.position(m_docPref.onionskin.position());
+      opts.prevFrames(m_docPref.onionskin.prevFrames());
+      opts.nextFrames(m_docPref.onionskin.nextFrames());
+      opts.opacityBase(m_docPref.onionskin.opacityBase());
+      opts.opacityStep(m_docPref.onionskin.opacityStep());
+      opts.layer(m_docPref.onionskin.currentLayer() ? m_layer: nullptr);
+
+      Tag* tag = nullptr;
+      if (m_docPref.onionskin.loopTag())
+        tag = m_sprite->tags().innerTag(m_frame);
+      opts.loopTag(tag);
+
+      renderEngine.setOnionskin(opts);
+    }
+  }
+}
+
 void Editor::drawBackground(ui::Graphics* g)
 {
   if (!(m_flags & kShowOutside))
@@ -896,6 +1158,19 @@ void Editor::drawSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& _rc)
     m_proj.applyY(m_sprite->height()));
   gfx::Rect enclosingRect = spriteRect;
 
+  // With the tiled mode the sprite area is rendered one time (in the
+  // first copy) and drawn in all copies.
+  m_tiledRender.enabled = (m_docPref.tiled.mode() != filters::TiledMode::NONE);
+  m_tiledRender.valid = false;
+  if (m_tiledRender.enabled) {
+    const gfx::Rect clip = g->getClipBounds();
+    const int nx = (int(m_docPref.tiled.mode()) & int(filters::TiledMode::X_AXIS) ? 3: 1);
+    const int ny = (int(m_docPref.tiled.mode()) & int(filters::TiledMode::Y_AXIS) ? 3: 1);
+    for (int v=0; v<ny; ++v)
+      for (int u=0; u<nx; ++u)
+        m_tiledRender.clip |= gfx::Rect(clip).offset(-u*spriteRect.w, -v*spriteRect.h);
+  }
+
   // Draw the main sprite at the center.
   drawOneSpriteUnclippedRect(g, rc, 0, 0);
 
@@ -925,6 +1200,8 @@ void Editor::drawSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& _rc)
       spriteRect.w*3, spriteRect.h*3);
   }
 
+  m_tiledRender = TiledRender();
+
   // Draw slices
   if (m_docPref.show.slices())
     drawSlices(g);
@@ -1027,22 +1304,33 @@ void Editor::drawMask(Graphics* g)
   pt.x = m_padding.x + m_proj.applyX(pt.x);
   pt.y = m_padding.y + m_proj.applyY(pt.y);
 
-  // Create the mask boundaries path
+  // Create the mask boundaries path in editor coordinates. We
+  // translate the path instead of applying a matrix to the
+  // ui::Graphics so the "checkered" pattern is not scaled too. The
+  // result is cached so each tick of the marching ants only draws
+  // the same path with a different pattern offset.
   auto& segs = m_document->maskBoundaries();
-  segs.createPathIfNeeeded();
+  if (m_maskPath.version != segs.version() ||
+      m_maskPath.scaleX != m_proj.scaleX() ||
+      m_maskPath.scaleY != m_proj.scaleY() ||
+      m_maskPath.origin != pt) {
+    segs.createPathIfNeeeded();
+
+    m_maskPath.version = segs.version();
+    m_maskPath.scaleX = m_proj.scaleX();
+    m_maskPath.scaleY = m_proj.scaleY();
+    m_maskPath.origin = pt;
+    m_maskPath.path = gfx::Path();
+    segs.path().transform(m_proj.scaleMatrix(), &m_maskPath.path);
+    m_maskPath.path.offset(pt.x, pt.y);
+  }
 
   ui::Paint paint;
   paint.style(ui::Paint::Stroke);
   set_checkered_paint_mode(paint, m_antsOffset,
                            gfx::rgba(0, 0, 0, 255),
                            gfx::rgba(255, 255, 255, 255));
-
-  // We translate the path instead of applying a matrix to the
-  // ui::Graphics so the "checkered" pattern is not scaled too.
-  gfx::Path path;
-  segs.path().transform(m_proj.scaleMatrix(), &path);
-  path.offset(pt.x, pt.y);
-  g->drawPath(path, paint);
+  g->drawPath(m_maskPath.path, paint);
 }
 
 void Editor::drawMaskSafe()
@@ -1057,7 +1345,10 @@ void Editor::drawMaskSafe()
     getDrawableRegion(region, kCutTopWindows);
     region.offset(-bounds().origin());
 
-    HideBrushPreview hide(m_brushPreview);
+    // Only the cursor pixels are hidden, the real preview of the
+    // brush (extra cel) is kept so the sprite doesn't need to be
+    // rendered again on each tick of the marching ants.
+    HideBrushPreviewPixels hide(m_brushPreview);
     GraphicsPtr g = getGraphics(clientBounds());
 
     for (const gfx::Rect& rc : region) {
@@ -1108,21 +1399,55 @@ void Editor::drawGrid(Graphics* g, const gfx::Rect& spriteBounds, const Rect& gr
     gfx::getg(grid_color),
     gfx::getb(grid_color), alpha);
 
-  // Draw horizontal lines
-  int x1 = spriteBounds.x;
-  int y1 = gridF.y;
-  int x2 = spriteBounds.x + spriteBounds.w;
-  int y2 = spriteBounds.y + spriteBounds.h;
+  // Only the visible part of the sprite needs lines
+  const gfx::Rect area = (spriteBounds & clientBounds());
+  if (area.isEmpty())
+    return;
+
+  // All the lines are added to one path and drawn with one call. The
+  // path only depends on the grid (zoom/scroll position) and the
+  // visible area, so it's cached between paints.
+  GridPath* gridPath = nullptr;
+  for (GridPath& gp : m_gridPaths) {
+    if (gp.grid == gridF && gp.area == area) {
+      gridPath = &gp;
+      break;
+    }
+  }
+  if (!gridPath) {
+    gridPath = &m_gridPaths[m_nextGridPath];
+    m_nextGridPath = (m_nextGridPath + 1) % int(std::size(m_gridPaths));
+
+    gridPath->grid = gridF;
+    gridPath->area = area;
 
-  for (double c=y1; c<=y2; c+=gridF.h)
-    g->drawHLine(grid_color, x1, c, spriteBounds.w);
+    gfx::Path& path = gridPath->path;
+    path = gfx::Path();
 
-  // Draw vertical lines
-  x1 = gridF.x;
-  y1 = spriteBounds.y;
+    // Horizontal lines (at the center of each row of pixels)
+    for (double c=int(gridF.y); c<=spriteBounds.y2(); c+=gridF.h) {
+      const int y = int(c);
+      if (y >= area.y && y < area.y2()) {
+        path.moveTo(area.x, y+0.5);
+        path.lineTo(area.x2(), y+0.5);
+      }
+    }
+
+    // Vertical lines
+    for (double c=int(gridF.x); c<=spriteBounds.x2(); c+=gridF.w) {
+      const int x = int(c);
+      if (x >= area.x && x < area.x2()) {
+        path.moveTo(x+0.5, area.y);
+        path.lineTo(x+0.5, area.y2());
+      }
+    }
+  }
 
-  for (double c=x1; c<=x2; c+=gridF.w)
-    g->drawVLine(grid_color, c, y1, spriteBounds.h);
+  ui::Paint paint;
+  paint.style(ui::Paint::Stroke);
+  paint.antialias(false);
+  paint.color(grid_color);
+  g->drawPath(gridPath->path, paint);
 }
 
 void Editor::drawSlices(ui::Graphics* g)
@@ -1875,11 +2200,12 @@ void Editor::selectSlice(const doc::Slice* slice)
 bool Editor::selectSliceBox(const gfx::Rect& box)
 {
   m_selectedSlices.clear();
-  for (auto slice : m_sprite->slices()) {
-    auto key = slice->getByFrame(m_frame);
-    if (key && key->bounds().intersects(box))
-      m_selectedSlices.insert(slice->id());
-  }
+
+  std::vector<doc::Slice*> slices;
+  m_sprite->slices().getByBounds(m_frame, box, slices);
+  for (auto slice : slices)
+    m_selectedSlices.insert(slice->id());
+
   invalidate();
 
   if (isActive())
@@ -2296,6 +2622,11 @@ void Editor::onPaint(ui::PaintEvent& ev)
       }
 #endif // ENABLE_DEVMODE
 
+      if (is_perf_hud_enabled())
+        drawPerfHud(g);
+      else
+        m_perfHudBounds = gfx::Rect();
+
       // Draw the mask boundaries
       if (m_document->hasMaskBoundaries()) {
         drawMask(g);
@@ -2522,7 +2853,18 @@ EditorHit Editor::calcHit(const gfx::Point& mouseScreenPos)
       if (m_docPref.show.slices()) {
         gfx::Point mainOffset(mainTilePosition());
 
-        for (auto slice : m_sprite->slices()) {
+        // Only slices near the mouse position can be hit (the
+        // borders of bounds and center are 5*guiscale() pixels width)
+        gfx::Rect spriteBounds =
+          screenToEditor(gfx::Rect(mouseScreenPos, gfx::Size(1, 1))
+                         .enlarge(5*guiscale()));
+        spriteBounds.offset(-mainOffset);
+        spriteBounds.enlarge(1);
+
+        std::vector<doc::Slice*> slices;
+        m_sprite->slices().getByBounds(m_frame, spriteBounds, slices);
+
+        for (auto slice : slices) {
           auto key = slice->getByFrame(m_frame);
           if (key) {
             gfx::Rect bounds = key->bounds();
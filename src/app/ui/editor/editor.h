@@ -29,6 +29,8 @@
 #include "doc/selected_objects.h"
 #include "filters/tiled_mode.h"
 #include "gfx/fwd.h"
+#include "gfx/path.h"
+#include "gfx/rect.h"
 #include "obs/connection.h"
 #include "os/color_space.h"
 #include "render/projection.h"
@@ -49,6 +51,9 @@ namespace doc {
 namespace gfx {
   class Region;
 }
+namespace os {
+  class Surface;
+}
 namespace ui {
   class Cursor;
   class Graphics;
@@ -59,6 +64,7 @@ namespace app {
   class Context;
   class DocView;
   class EditorCustomizationDelegate;
+  class EditorAsyncRender;
   class EditorRender;
   class PixelsMovement;
   class Site;
@@ -395,6 +401,25 @@ namespace app {
     // You should setup the clip of the screen before calling this
     // routine.
     void drawOneSpriteUnclippedRect(ui::Graphics* g, const gfx::Rect& rc, int dx, int dy);
+    void drawPerfHud(ui::Graphics* g);
+    void drawRenderedSurface(ui::Graphics* g, os::Surface* surface,
+                             const gfx::Rect& srcRect, const gfx::Rect& dest);
+
+    // Draws the "rc" area of the sprite (without zoom) rendered in a
+    // background thread (or the last rendered area while it's being
+    // rendered). Returns false if the area must be rendered in the
+    // UI thread (e.g. when the sprite is being modified).
+    bool drawAsyncRender(ui::Graphics* g, const gfx::Rect& rc,
+                         const gfx::Rect& dest, int dx, int dy);
+
+    // Returns the power of two used to scale down the sprite when
+    // it's rendered zoomed out with the new render engine (1 if the
+    // sprite is rendered at 100%).
+    int renderReduction() const;
+
+    // Configures the render engine to render the sprite as it's
+    // shown in this editor (without the extra cel)
+    void setupRenderEngine(EditorRender& renderEngine);
 
     gfx::Point calcExtraPadding(const render::Projection& proj);
 
@@ -424,6 +449,40 @@ namespace app {
     // Helper functions affected by the current Tiled Mode.
     app::TiledModeHelper m_tiledModeHelper;
 
+    // With the tiled mode, drawSpriteUnclippedRect() draws the same
+    // sprite area in each copy of the sprite, so the area is rendered
+    // in the first copy and the rendered surface is reused for the
+    // other ones.
+    struct TiledRender {
+      bool enabled = false;     // Drawing the copies of the tiled mode
+      bool valid = false;       // The rendered surface can be reused
+      gfx::Rect bounds;         // Rendered area (rc2 in drawOneSpriteUnclippedRect)
+      gfx::Rect clip;           // Visible area of all copies (relative to the main one)
+    };
+    TiledRender m_tiledRender;
+
+    // Paths with the lines of the last grids drawn by drawGrid()
+    // (usually the pixel grid and the tile grid).
+    struct GridPath {
+      gfx::RectF grid;          // First grid tile in client coordinates
+      gfx::Rect area;           // Area covered by the lines
+      gfx::Path path;
+    };
+    GridPath m_gridPaths[2];
+    int m_nextGridPath = 0;
+
+    // Selection boundaries in editor coordinates drawn by
+    // drawMask(). It's created again only when the boundaries, the
+    // zoom, or the scroll change.
+    struct MaskPath {
+      int version = -1;         // MaskBoundaries::version()
+      double scaleX = 0.0;
+      double scaleY = 0.0;
+      gfx::Point origin;
+      gfx::Path path;
+    };
+    MaskPath m_maskPath;
+
     // Brush preview
     BrushPreview m_brushPreview;
 
@@ -488,6 +547,9 @@ namespace app {
     gfx::Rect m_perfInfoBounds;
 #endif
 
+    // Bounds of the performance HUD (in display coordinates)
+    gfx::Rect m_perfHudBounds;
+
     // For slices
     doc::SelectedObjects m_selectedSlices;
 
@@ -499,6 +561,10 @@ namespace app {
     // same document can show the same preview image/stroke being drawn
     // (search for Render::setPreviewImage()).
     static std::unique_ptr<EditorRender> m_renderEngine;
+
+    // Used to render big sprites in a background thread (created
+    // when experimental.async_render is enabled)
+    std::unique_ptr<EditorAsyncRender> m_asyncRender;
   };
 
 } // namespace app
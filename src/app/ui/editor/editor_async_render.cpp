@@ -0,0 +1,253 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/ui/editor/editor_async_render.h"
+
+#include "app/doc.h"
+#include "app/doc_access.h"
+#include "app/ui/editor/editor_render.h"
+#include "doc/cel.h"
+#include "doc/cel_data.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/palette.h"
+#include "doc/render_plan.h"
+#include "doc/sprite.h"
+#include "doc/tileset.h"
+#include "doc/tilesets.h"
+#include "os/system.h"
+#include "ui/system.h"
+
+#include <algorithm>
+
+namespace app {
+
+using namespace doc;
+
+// Number of pixels rendered between checks of the cancel flag (the
+// document is unlocked between bands too)
+static constexpr int kBandPixels = 512*1024;
+
+bool EditorAsyncRender::Key::operator==(const Key& other) const
+{
+  return (spriteId == other.spriteId &&
+          frame == other.frame &&
+          colorSpace == other.colorSpace &&
+          options == other.options &&
+          versions == other.versions);
+}
+
+// static
+void EditorAsyncRender::collectVersions(const Sprite* sprite,
+                                        const frame_t fromFrame,
+                                        const frame_t toFrame,
+                                        std::vector<uint64_t>& versions)
+{
+  auto add = [&versions](const ObjectId id, const ObjectVersion version) {
+    versions.push_back((uint64_t(id) << 32) | uint64_t(version));
+  };
+
+  for (frame_t frame=fromFrame; frame<=toFrame; ++frame) {
+    RenderPlan plan;
+    plan.addLayer(sprite->root(), frame);
+    for (const RenderPlan::Item& item : plan.items()) {
+      add(item.layer->id(), item.layer->version());
+      if (const Cel* cel = item.cel) {
+        add(cel->id(), cel->version());
+        add(cel->data()->id(), cel->data()->version());
+        if (const Image* image = cel->image())
+          add(image->id(), image->version());
+      }
+    }
+    if (const Palette* pal = sprite->palette(frame))
+      add(pal->id(), pal->version());
+  }
+
+  // Tiles can be modified without changing the tilemap version
+  if (sprite->hasTilesets()) {
+    for (const Tileset* tileset : *sprite->tilesets()) {
+      if (!tileset)
+        continue;
+      add(tileset->id(), tileset->version());
+      for (const auto& tile : *tileset) {
+        if (tile.image)
+          add(tile.image->id(), tile.image->version());
+      }
+    }
+  }
+}
+
+EditorAsyncRender::EditorAsyncRender(std::function<void()>&& onRendered)
+  : m_onRendered(std::move(onRendered))
+  , m_alive(std::make_shared<bool>(true))
+{
+}
+
+EditorAsyncRender::~EditorAsyncRender()
+{
+  m_alive.reset();
+
+  if (m_thread.joinable()) {
+    {
+      const std::lock_guard lock(m_mutex);
+      m_exit = true;
+      m_cancel = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+  }
+}
+
+os::Surface* EditorAsyncRender::get(const Key& key,
+                                    const gfx::Rect& rc,
+                                    gfx::Rect& bounds)
+{
+  fetchFinished();
+
+  if (m_result.surface &&
+      m_result.bounds.contains(rc) &&
+      m_result.key == key) {
+    bounds = m_result.bounds;
+    return m_result.surface.get();
+  }
+  return nullptr;
+}
+
+os::Surface* EditorAsyncRender::placeholder(const ObjectId spriteId,
+                                            gfx::Rect& bounds)
+{
+  fetchFinished();
+
+  if (m_result.surface &&
+      m_result.key.spriteId == spriteId) {
+    bounds = m_result.bounds;
+    return m_result.surface.get();
+  }
+  return nullptr;
+}
+
+void EditorAsyncRender::render(Key&& key,
+                               const gfx::Rect& bounds,
+                               Doc* doc,
+                               const Sprite* sprite,
+                               std::unique_ptr<EditorRender>&& engine)
+{
+  ASSERT(!bounds.isEmpty());
+  {
+    const std::lock_guard lock(m_mutex);
+    if (m_pending &&
+        m_pendingBounds.contains(bounds) &&
+        m_pendingKey == key) {
+      return;
+    }
+  }
+
+  // The surface is created in the UI thread, and it's only used from
+  // the background thread until the job is finished
+  os::SurfaceRef surface = os::instance()->makeRgbaSurface(
+    bounds.w, bounds.h, key.colorSpace);
+  if (!surface)
+    return;
+
+  {
+    const std::lock_guard lock(m_mutex);
+    m_pending = true;
+    m_pendingKey = key;
+    m_pendingBounds = bounds;
+
+    // Replace the previous job (if it's still running it's cancelled)
+    m_job = std::make_unique<Job>(
+      Job{ Result{ std::move(key), bounds, surface },
+           doc, sprite, std::move(engine),
+           sprite->structureVersion(),
+           sprite->tags().version() });
+    m_cancel = true;
+  }
+  m_cv.notify_all();
+
+  if (!m_thread.joinable()) {
+    m_thread = std::thread(
+      [this, alive = std::weak_ptr<bool>(m_alive)]{
+        renderThread(alive);
+      });
+  }
+}
+
+void EditorAsyncRender::fetchFinished()
+{
+  const std::lock_guard lock(m_mutex);
+  if (m_finished) {
+    m_result = std::move(*m_finished);
+    m_finished.reset();
+  }
+}
+
+bool EditorAsyncRender::renderJob(Job& job)
+{
+  const gfx::Rect& bounds = job.result.bounds;
+  const int bandH = std::max(1, kBandPixels / bounds.w);
+
+  for (int y=0; y<bounds.h; y+=bandH) {
+    if (m_cancel)
+      return false;
+
+    const int h = std::min(bandH, bounds.h-y);
+    try {
+      // Lock the document to read it (if it's being modified we stop
+      // rendering, the editor will be invalidated to ask for a new
+      // render anyway)
+      const DocReader docReader(job.doc, 50);
+
+      // Layers/cels/frames/tags could be deleted between two bands
+      // (the document is unlocked), and the engine would use
+      // dangling pointers.
+      if (job.sprite->structureVersion() != job.structureVersion ||
+          job.sprite->tags().version() != job.tagsVersion)
+        return false;
+
+      job.engine->renderSprite(
+        job.result.surface.get(), job.sprite, job.result.key.frame,
+        gfx::ClipF(0, y, bounds.x, bounds.y+y, bounds.w, h));
+    }
+    catch (const std::exception&) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void EditorAsyncRender::renderThread(const std::weak_ptr<bool> alive)
+{
+  std::unique_lock lock(m_mutex);
+  while (true) {
+    m_cv.wait(lock, [this]{ return m_job || m_exit; });
+    if (m_exit)
+      break;
+
+    std::unique_ptr<Job> job = std::move(m_job);
+    m_cancel = false;
+    lock.unlock();
+
+    const bool done = renderJob(*job);
+
+    lock.lock();
+    if (!m_job)
+      m_pending = false;
+    if (done) {
+      m_finished = std::make_unique<Result>(std::move(job->result));
+      ui::execute_from_ui_thread([this, alive]{
+        if (alive.lock())
+          m_onRendered();
+      });
+    }
+  }
+}
+
+} // namespace app
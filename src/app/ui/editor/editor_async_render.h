@@ -0,0 +1,138 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_UI_EDITOR_ASYNC_RENDER_H_INCLUDED
+#define APP_UI_EDITOR_ASYNC_RENDER_H_INCLUDED
+#pragma once
+
+#include "doc/frame.h"
+#include "doc/object_id.h"
+#include "gfx/rect.h"
+#include "os/color_space.h"
+#include "os/surface.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace doc {
+  class Sprite;
+}
+
+namespace app {
+  class Doc;
+  class EditorRender;
+
+  // Renders the visible area of a big sprite in a background thread,
+  // so the editor doesn't block the UI while it's scrolled/zoomed or
+  // the active frame is changed (used when the
+  // experimental.async_render option is enabled).
+  //
+  // While the new area is being rendered, the editor shows the last
+  // rendered one (e.g. the previous frame or the previous scroll
+  // position). Each new request cancels the previous one if it
+  // wasn't finished yet.
+  class EditorAsyncRender {
+  public:
+    // Everything that affects the rendered pixels
+    struct Key {
+      doc::ObjectId spriteId = 0;
+      doc::frame_t frame = 0;
+      os::ColorSpaceRef colorSpace;
+      // Render options (preferences, selected layer, flags, etc.)
+      std::vector<int> options;
+      // IDs+versions of the layers/cels/images/palettes/tilesets
+      std::vector<uint64_t> versions;
+
+      bool operator==(const Key& other) const;
+      bool operator!=(const Key& other) const { return !operator==(other); }
+    };
+
+    // Adds to "versions" the ID+version of all the objects that can
+    // be rendered in the given range of frames (inclusive range).
+    static void collectVersions(const doc::Sprite* sprite,
+                                const doc::frame_t fromFrame,
+                                const doc::frame_t toFrame,
+                                std::vector<uint64_t>& versions);
+
+    // "onRendered" is called from the UI thread each time a new area
+    // is rendered
+    explicit EditorAsyncRender(std::function<void()>&& onRendered);
+    ~EditorAsyncRender();
+
+    // Returns the rendered surface if it was rendered with the given
+    // key and contains the "rc" rectangle (in sprite coordinates).
+    // "bounds" is the area of the sprite in the surface.
+    os::Surface* get(const Key& key,
+                     const gfx::Rect& rc,
+                     gfx::Rect& bounds);
+
+    // Returns the last rendered surface of the given sprite (even if
+    // it's outdated) to show it until the new render is finished.
+    os::Surface* placeholder(const doc::ObjectId spriteId,
+                             gfx::Rect& bounds);
+
+    // Starts rendering the "bounds" of the sprite with the given
+    // render engine (which must be already configured to render the
+    // sprite at 1:1). Does nothing if the same area is already
+    // being rendered.
+    void render(Key&& key,
+                const gfx::Rect& bounds,
+                Doc* doc,
+                const doc::Sprite* sprite,
+                std::unique_ptr<EditorRender>&& engine);
+
+  private:
+    struct Result {
+      Key key;
+      gfx::Rect bounds;
+      os::SurfaceRef surface;
+    };
+
+    struct Job {
+      Result result;
+      Doc* doc;
+      const doc::Sprite* sprite;
+      std::unique_ptr<EditorRender> engine;
+      // The engine has pointers to layers/cels/tags of the sprite, the
+      // job is cancelled if these versions change between two bands.
+      uint32_t structureVersion;
+      int tagsVersion;
+    };
+
+    void fetchFinished();
+    bool renderJob(Job& job);
+    void renderThread(const std::weak_ptr<bool> alive);
+
+    std::function<void()> m_onRendered;
+    // Used to know if "this" is still alive when the notification
+    // from the background thread arrives to the UI thread
+    std::shared_ptr<bool> m_alive;
+
+    // Last rendered area (only used from the UI thread)
+    Result m_result;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::unique_ptr<Job> m_job;         // Next job to render
+    std::unique_ptr<Result> m_finished; // Finished job to fetch
+    // Key/bounds of the job that is waiting or being rendered
+    bool m_pending = false;
+    Key m_pendingKey;
+    gfx::Rect m_pendingBounds;
+    bool m_exit = false;
+    std::atomic<bool> m_cancel = false;
+  };
+
+} // namespace app
+
+#endif
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 //
 // This program is distributed under the terms of
@@ -16,9 +16,20 @@
 #include "app/render/shader_renderer.h"
 #include "app/render/simple_renderer.h"
 
+#include <algorithm>
+#include <thread>
+
 namespace app {
 
-static doc::ImageBufferPtr g_renderBuffer;
+// Number of threads to render the sprite in the editor (0 = one per
+// CPU core).
+static int get_render_threads()
+{
+  const int threads = Preferences::instance().experimental.renderThreads();
+  if (threads > 0)
+    return threads;
+  return std::max(1, int(std::thread::hardware_concurrency()));
+}
 
 EditorRender::EditorRender()
   // TODO create a switch in the preferences
@@ -26,6 +37,9 @@ EditorRender::EditorRender()
 {
   m_renderer->setNewBlendMethod(
     Preferences::instance().experimental.newBlend());
+  m_renderer->setMaxThreads(get_render_threads());
+  m_renderer->setBoxFilterScaleDown(
+    Preferences::instance().experimental.zoomOutBoxFilter());
 }
 
 EditorRender::~EditorRender()
@@ -45,7 +59,12 @@ void EditorRender::setType(const Type type)
 {
 #if SK_ENABLE_SKSL && ENABLE_DEVMODE
   if (type == Type::kShaderRenderer) {
-    m_renderer = std::make_unique<ShaderRenderer>();
+    auto renderer = std::make_unique<ShaderRenderer>();
+    // Preference value is in megabytes
+    renderer->setTexturesCacheSize(
+      std::size_t(std::max(0, Preferences::instance().experimental.shaderTexturesCacheSize()))
+      * 1024 * 1024);
+    m_renderer = std::move(renderer);
   }
   else
 #endif
@@ -55,6 +74,9 @@ void EditorRender::setType(const Type type)
 
   m_renderer->setNewBlendMethod(
     Preferences::instance().experimental.newBlend());
+  m_renderer->setMaxThreads(get_render_threads());
+  m_renderer->setBoxFilterScaleDown(
+    Preferences::instance().experimental.zoomOutBoxFilter());
 }
 
 void EditorRender::setRefLayersVisiblity(const bool visible)
@@ -72,6 +94,11 @@ void EditorRender::setNewBlendMethod(const bool newBlend)
   m_renderer->setNewBlendMethod(newBlend);
 }
 
+void EditorRender::setBoxFilterScaleDown(const bool state)
+{
+  m_renderer->setBoxFilterScaleDown(state);
+}
+
 void EditorRender::setProjection(const render::Projection& projection)
 {
   m_renderer->setProjection(projection);
@@ -142,11 +169,13 @@ void EditorRender::setPreviewImage(const doc::Layer* layer,
 {
   m_renderer->setPreviewImage(layer, frame, image, tileset,
                               pos, blendMode);
+  m_hasPreviewImage = true;
 }
 
 void EditorRender::removePreviewImage()
 {
   m_renderer->removePreviewImage();
+  m_hasPreviewImage = false;
 }
 
 void EditorRender::setExtraImage(
@@ -205,12 +234,19 @@ void EditorRender::renderImage(
   m_renderer->renderImage(dst_image, src_image, pal,
                           x, y, opacity, blendMode);
 }
-// static
-doc::ImageBufferPtr EditorRender::getRenderImageBuffer()
+
+void EditorRender::prerenderFrames(const doc::Sprite* sprite,
+                                   const std::vector<doc::frame_t>& frames)
+{
+  // Preference value is in megabytes (0 = disabled)
+  const int size = Preferences::instance().experimental.playbackCacheSize();
+  if (size > 0)
+    m_renderer->prerenderFrames(sprite, frames, std::size_t(size) * 1024 * 1024);
+}
+
+void EditorRender::stopPrerender()
 {
-  if (!g_renderBuffer)
-    g_renderBuffer.reset(new doc::ImageBuffer);
-  return g_renderBuffer;
+  m_renderer->stopPrerender();
 }
 
 } // namespace app
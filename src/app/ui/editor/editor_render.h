@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 //
 // This program is distributed under the terms of
@@ -21,6 +21,8 @@
 #include "render/onionskin_options.h"
 #include "render/projection.h"
 
+#include <vector>
+
 namespace doc {
   class Cel;
   class Image;
@@ -57,6 +59,7 @@ namespace app {
     void setRefLayersVisiblity(const bool visible);
     void setNonactiveLayersOpacity(const int opacity);
     void setNewBlendMethod(const bool newBlend);
+    void setBoxFilterScaleDown(const bool state);
 
     void setProjection(const render::Projection& projection);
 
@@ -72,6 +75,7 @@ namespace app {
                          const gfx::Point& pos,
                          const doc::BlendMode blendMode);
     void removePreviewImage();
+    bool hasPreviewImage() const { return m_hasPreviewImage; }
 
     void setExtraImage(
       render::ExtraType type,
@@ -103,10 +107,16 @@ namespace app {
       const int opacity,
       const doc::BlendMode blendMode);
 
-    static doc::ImageBufferPtr getRenderImageBuffer();
+    // Pre-renders the next frames of the animation that is being
+    // played (the memory used is limited by the
+    // experimental.playback_cache_size preference).
+    void prerenderFrames(const doc::Sprite* sprite,
+                         const std::vector<doc::frame_t>& frames);
+    void stopPrerender();
 
   private:
     std::unique_ptr<Renderer> m_renderer;
+    bool m_hasPreviewImage = false;
   };
 
 } // namespace app
@@ -130,6 +130,8 @@ PixelsMovement::PixelsMovement(
   , m_canHandleFrameChange(false)
   , m_fastMode(false)
   , m_needsRotSpriteRedraw(false)
+  , m_rotSpriteTimer(250)
+  , m_rotSpriteDoneTimer(50)
 {
   double cornerThick = (m_site.tilemapMode() == TilemapMode::Tiles) ?
                           CORNER_THICK_FOR_TILEMAP_MODE :
@@ -154,6 +156,9 @@ PixelsMovement::PixelsMovement(
     Preferences::instance().selection.rotationAlgorithm.AfterChange.connect(
       [this]{ onRotationAlgorithmChange(); });
 
+  m_rotSpriteTimer.Tick.connect([this]{ startRotSpriteTask(); });
+  m_rotSpriteDoneTimer.Tick.connect([this]{ onRotSpriteTaskCompleted(); });
+
   // The extra cel must be null, because if it's not null, it means
   // that someone else is using it (e.g. the editor brush preview),
   // and its owner could destroy our new "extra cel".
@@ -172,6 +177,18 @@ PixelsMovement::PixelsMovement(
   }
 }
 
+PixelsMovement::~PixelsMovement()
+{
+  m_rotSpriteTimer.stop();
+  m_rotSpriteDoneTimer.stop();
+
+  // RotSprite cannot be stopped in the middle, so we have to wait the
+  // task (it doesn't access this PixelsMovement anyway)
+  m_rotSpriteTask.cancel();
+  if (m_rotSpriteTask.running())
+    m_rotSpriteTask.wait();
+}
+
 bool PixelsMovement::editMultipleCels() const
 {
   return
@@ -189,6 +206,12 @@ void PixelsMovement::setFastMode(const bool fastMode)
 {
   bool redraw = (m_fastMode && !fastMode);
   m_fastMode = fastMode;
+  if (redraw) {
+    m_rotSpriteTimer.stop();
+    // Use the result of the background task if it's already done
+    if (m_rotSpriteTask.completed())
+      onRotSpriteTaskCompleted();
+  }
   if (m_needsRotSpriteRedraw && redraw) {
     redrawExtraImage();
     update_screen_for_document(m_document);
@@ -1029,6 +1052,89 @@ void PixelsMovement::redrawExtraImage(Transformation* transformation)
     drawImage(*transformation, m_extraCel->image(),
               gfx::PointF(bounds.origin()), true);
   }
+
+  // Any RotSprite result from a previous transformation is outdated
+  ++m_extraCelVersion;
+  if (m_fastMode &&
+      m_needsRotSpriteRedraw &&
+      transformation == &m_currentData) {
+    m_rotSpriteTimer.start();
+  }
+}
+
+void PixelsMovement::startRotSpriteTask()
+{
+  m_rotSpriteTimer.stop();
+
+  if (!m_fastMode ||
+      !m_needsRotSpriteRedraw ||
+      !m_extraCel ||
+      !m_extraCel->image() ||
+      m_site.tilemapMode() == TilemapMode::Tiles) {
+    return;
+  }
+
+  // Cancel the previous job (its result will be discarded), and try
+  // again when it's finished
+  if (m_rotSpriteTask.running()) {
+    m_rotSpriteTask.cancel();
+    m_rotSpriteTimer.start();
+    return;
+  }
+
+  // Prepare copies of all the images used by RotSprite, so the
+  // background task doesn't access the document or this object
+  const gfx::Rect bounds = m_currentData.transformedBounds();
+  auto job = std::make_shared<RotSpriteJob>();
+  job->version = m_extraCelVersion;
+  job->leftTop = gfx::PointF(bounds.origin());
+  job->corners = m_currentData.transformedCorners();
+  job->dst.reset(Image::create(m_extraCel->image()->spec()));
+  clearImageToDraw(job->dst.get(), bounds, job->leftTop, true);
+  job->src.reset(Image::createCopy(m_originalImage.get()));
+  if (m_initialMask->bitmap())
+    job->mask.reset(Image::createCopy(m_initialMask->bitmap()));
+
+  m_rotSpriteJob = job;
+  m_rotSpriteTask.run([job](base::task_token& token){
+    const auto& c = job->corners;
+    const gfx::PointF& pt = job->leftTop;
+    try {
+      doc::algorithm::rotsprite_image(
+        job->dst.get(), job->src.get(), job->mask.get(),
+        int(c.leftTop().x-pt.x), int(c.leftTop().y-pt.y),
+        int(c.rightTop().x-pt.x), int(c.rightTop().y-pt.y),
+        int(c.rightBottom().x-pt.x), int(c.rightBottom().y-pt.y),
+        int(c.leftBottom().x-pt.x), int(c.leftBottom().y-pt.y));
+      job->done = !token.canceled();
+    }
+    catch (const std::bad_alloc&) {
+      // Keep the fast version of the image
+    }
+  });
+  m_rotSpriteDoneTimer.start();
+}
+
+void PixelsMovement::onRotSpriteTaskCompleted()
+{
+  if (!m_rotSpriteTask.completed())
+    return;
+
+  m_rotSpriteDoneTimer.stop();
+
+  std::shared_ptr<RotSpriteJob> job = std::move(m_rotSpriteJob);
+  if (job &&
+      job->done &&
+      job->version == m_extraCelVersion &&
+      m_needsRotSpriteRedraw &&
+      m_extraCel &&
+      m_extraCel->image() &&
+      m_extraCel->image()->bounds() == job->dst->bounds()) {
+    m_extraCel->image()->copy(job->dst.get(),
+                              gfx::Clip(job->dst->bounds()));
+    m_needsRotSpriteRedraw = false;
+    update_screen_for_document(m_document);
+  }
 }
 
 void PixelsMovement::redrawCurrentMask()
@@ -1036,6 +1142,40 @@ void PixelsMovement::redrawCurrentMask()
   drawMask(m_currentMask.get(), true);
 }
 
+// Clears the "dst" image (rendering the original layer if needed) and
+// sets the mask color of the original image to draw it on "dst".
+void PixelsMovement::clearImageToDraw(doc::Image* dst,
+                                      const gfx::Rect& bounds,
+                                      const gfx::PointF& pt,
+                                      const bool renderOriginalLayer)
+{
+  dst->setMaskColor(m_site.sprite()->transparentColor());
+  dst->clear(dst->maskColor());
+
+  if (renderOriginalLayer) {
+    render::Render render;
+    render.renderLayer(
+      dst, m_site.layer(), m_site.frame(),
+      gfx::Clip(bounds.x-pt.x, bounds.y-pt.y, bounds),
+      BlendMode::SRC);
+  }
+
+  color_t maskColor = m_maskColor;
+
+  // In case that Opaque option is enabled, or if we are drawing the
+  // image for the clipboard (renderOriginalLayer is false), we use a
+  // dummy mask color to call drawParallelogram(). In this way all
+  // pixels will be opaqued (all colors are copied)
+  if (m_opaque ||
+      !renderOriginalLayer) {
+    if (m_originalImage->pixelFormat() == IMAGE_INDEXED)
+      maskColor = -1;
+    else
+      maskColor = 0;
+  }
+  m_originalImage->setMaskColor(maskColor);
+}
+
 void PixelsMovement::drawImage(
   const Transformation& transformation,
   doc::Image* dst, const gfx::PointF& pt,
@@ -1062,32 +1202,7 @@ void PixelsMovement::drawImage(
       m_initialMask.get());
   }
   else {
-    dst->setMaskColor(m_site.sprite()->transparentColor());
-    dst->clear(dst->maskColor());
-
-    if (renderOriginalLayer) {
-      render::Render render;
-      render.renderLayer(
-        dst, m_site.layer(), m_site.frame(),
-        gfx::Clip(bounds.x-pt.x, bounds.y-pt.y, bounds),
-        BlendMode::SRC);
-    }
-
-    color_t maskColor = m_maskColor;
-
-    // In case that Opaque option is enabled, or if we are drawing the
-    // image for the clipboard (renderOriginalLayer is false), we use a
-    // dummy mask color to call drawParallelogram(). In this way all
-    // pixels will be opaqued (all colors are copied)
-    if (m_opaque ||
-        !renderOriginalLayer) {
-      if (m_originalImage->pixelFormat() == IMAGE_INDEXED)
-        maskColor = -1;
-      else
-        maskColor = 0;
-    }
-    m_originalImage->setMaskColor(maskColor);
-
+    clearImageToDraw(dst, bounds, pt, renderOriginalLayer);
     drawParallelogram(
       transformation,
       dst, m_originalImage.get(),
@@ -1108,9 +1223,9 @@ void PixelsMovement::drawMask(doc::Mask* mask, bool shrink)
   mask->replace(bounds);
   if (shrink)
     mask->freeze();
-  clear_image(mask->bitmap(), 0);
+  clear_image(mask->editableBitmap(), 0);
   drawParallelogram(m_currentData,
-                    mask->bitmap(),
+                    mask->editableBitmap(),
                     m_initialMask->bitmap(),
                     nullptr,
                     corners,
@@ -1284,7 +1399,7 @@ void PixelsMovement::flipOriginalImage(const doc::algorithm::FlipType flipType)
 
   // Flip the mask.
   doc::algorithm::flip_image(
-    m_initialMask->bitmap(),
+    m_initialMask->editableBitmap(),
     gfx::Rect(gfx::Point(0, 0), m_initialMask->bounds().size()),
     flipType);
 }
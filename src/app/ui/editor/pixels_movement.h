@@ -12,6 +12,7 @@
 #include "app/context_access.h"
 #include "app/extra_cel.h"
 #include "app/site.h"
+#include "app/task.h"
 #include "app/transformation.h"
 #include "app/tx.h"
 #include "app/ui/editor/handle_type.h"
@@ -20,7 +21,9 @@
 #include "doc/image_ref.h"
 #include "gfx/size.h"
 #include "obs/connection.h"
+#include "ui/timer.h"
 
+#include <atomic>
 #include <memory>
 
 namespace doc {
@@ -74,6 +77,7 @@ namespace app {
                    const Image* moveThis,
                    const Mask* mask,
                    const char* operationName);
+    ~PixelsMovement();
 
     const Site& site() { return m_site; }
 
@@ -140,6 +144,12 @@ namespace app {
     void onRotationAlgorithmChange();
     void redrawExtraImage(Transformation* transformation = nullptr);
     void redrawCurrentMask();
+    void startRotSpriteTask();
+    void onRotSpriteTaskCompleted();
+    void clearImageToDraw(doc::Image* dst,
+                          const gfx::Rect& bounds,
+                          const gfx::PointF& pt,
+                          const bool renderOriginalLayer);
     void drawImage(
       const Transformation& transformation,
       doc::Image* dst, const gfx::PointF& pt,
@@ -192,6 +202,23 @@ namespace app {
     bool m_fastMode;
     bool m_needsRotSpriteRedraw;
 
+    // In fast mode, when the mouse stops moving, the RotSprite
+    // version of the extra cel image is rendered in a background
+    // task and then copied to the extra cel (if the transformation
+    // didn't change in the meantime).
+    struct RotSpriteJob {
+      int version;              // m_extraCelVersion of this job
+      std::unique_ptr<doc::Image> dst, src, mask;
+      Transformation::Corners corners;
+      gfx::PointF leftTop;
+      std::atomic<bool> done = false;
+    };
+    int m_extraCelVersion = 0;  // Incremented on each extra cel redraw
+    std::shared_ptr<RotSpriteJob> m_rotSpriteJob;
+    app::Task m_rotSpriteTask;
+    ui::Timer m_rotSpriteTimer;     // Waits the mouse to stop
+    ui::Timer m_rotSpriteDoneTimer; // Waits the task to complete
+
     // Commands used in the interaction with the transformed pixels.
     // This is used to re-create the whole interaction on each
     // modified cel when we are modifying multiples cels at the same
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2023  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -18,18 +18,66 @@
 #include "app/tools/ink.h"
 #include "app/ui/editor/editor.h"
 #include "app/ui/editor/editor_customization_delegate.h"
+#include "app/ui/editor/editor_render.h"
 #include "app/ui/editor/scrolling_state.h"
 #include "app/ui/skin/skin_theme.h"
 #include "app/ui_context.h"
+#include "doc/sprite.h"
 #include "doc/tag.h"
 #include "ui/manager.h"
 #include "ui/message.h"
 #include "ui/system.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace app {
 
 using namespace ui;
 
+namespace {
+
+// Number of frames to pre-render ahead of the current frame
+const int kPrerenderFrames = 16;
+
+// Predicts the next frames of the animation to pre-render them. It
+// doesn't need to be exact (e.g. with nested tags or tags with
+// repeat), a wrong prediction just renders a frame that is not used.
+std::vector<doc::frame_t> predict_next_frames(const doc::Sprite* sprite,
+                                              const doc::Tag* tag,
+                                              doc::frame_t frame,
+                                              int step,
+                                              const int n)
+{
+  doc::frame_t first = 0;
+  doc::frame_t last = sprite->lastFrame();
+  bool pingPong = false;
+  if (tag) {
+    first = tag->fromFrame();
+    last = tag->toFrame();
+    pingPong = (tag->aniDir() == doc::AniDir::PING_PONG ||
+                tag->aniDir() == doc::AniDir::PING_PONG_REVERSE);
+  }
+
+  std::vector<doc::frame_t> frames;
+  const int nframes = std::min<int>(n, last - first + 1);
+  for (int i=0; i<nframes; ++i) {
+    frame += step;
+    if (frame < first || frame > last) {
+      if (pingPong && first < last) {
+        step = -step;
+        frame += 2*step;
+      }
+      else
+        frame = (step > 0 ? first: last);
+    }
+    frames.push_back(std::clamp(frame, first, last));
+  }
+  return frames;
+}
+
+} // anonymous namespace
+
 PlayState::PlayState(const bool playOnce,
                      const bool playAll,
                      const bool playSubtags)
@@ -40,6 +88,7 @@ PlayState::PlayState(const bool playOnce,
   , m_toScroll(false)
   , m_playTimer(10)
   , m_nextFrameTime(-1)
+  , m_step(1)
   , m_refFrame(0)
   , m_tag(nullptr)
 {
@@ -126,6 +175,7 @@ EditorState::LeaveAction PlayState::onLeaveState(Editor* editor, EditorState* ne
   // (we keep playing the animation).
   if (!m_toScroll) {
     m_playTimer.stop();
+    Editor::renderEngine().stopPrerender();
 
     if (m_playOnce || Preferences::instance().general.rewindOnStop())
       m_editor->setFrame(m_refFrame);
@@ -231,8 +281,25 @@ void PlayState::onPlaybackTick()
       m_editor->stop();
       break;
     }
+
+    // Direction of the playback (used to predict the next frames)
+    const doc::frame_t delta = frame - m_editor->frame();
+    if (delta == 1 || delta == -1)
+      m_step = delta;
+
     m_editor->setFrame(frame);
     m_nextFrameTime += getNextFrameTime();
+
+    // The next frames are pre-rendered after the editor paints this
+    // one (with the same render configuration)
+    if (m_nextFrameTime > 0) {
+      Editor::renderEngine().prerenderFrames(
+        m_editor->sprite(),
+        predict_next_frames(m_editor->sprite(),
+                            m_playback.tag(),
+                            frame, m_step,
+                            kPrerenderFrames));
+    }
   }
 
   m_curFrameTick = base::current_tick();
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2022  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -64,6 +64,9 @@ namespace app {
     double m_nextFrameTime;
     base::tick_t m_curFrameTick;
 
+    // Last direction of the playback (+1 or -1)
+    doc::frame_t m_step;
+
     doc::frame_t m_refFrame;
     doc::Tag* m_tag;
 
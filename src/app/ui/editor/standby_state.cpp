@@ -618,20 +618,21 @@ bool StandbyState::onUpdateStatusBar(Editor* editor)
     }
 
     if (editor->docPref().show.slices()) {
-      int count = 0;
-      for (auto slice : editor->document()->sprite()->slices()) {
-        auto key = slice->getByFrame(editor->frame());
-        if (key &&
-            key->bounds().contains(
-              int(std::floor(spritePos.x)),
-              int(std::floor(spritePos.y)))) {
-          if (++count == 3) {
-            buf += fmt::format(" :slice: ...");
-            break;
-          }
+      std::vector<doc::Slice*> slices;
+      editor->document()->sprite()->slices().getByBounds(
+        editor->frame(),
+        gfx::Rect(int(std::floor(spritePos.x)),
+                  int(std::floor(spritePos.y)), 1, 1),
+        slices);
 
-          buf += fmt::format(" :slice: {}", slice->name());
+      int count = 0;
+      for (auto slice : slices) {
+        if (++count == 3) {
+          buf += fmt::format(" :slice: ...");
+          break;
         }
+
+        buf += fmt::format(" :slice: {}", slice->name());
       }
     }
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -26,6 +26,9 @@
 
 #define ISEARCH_KEYPRESS_INTERVAL_MSECS 500
 
+// Time to wait the listing of a folder before showing it partially
+#define LISTING_WAIT_MSECS              100
+
 namespace app {
 
 using namespace app::skin;
@@ -37,6 +40,7 @@ FileList::FileList()
   , m_currentFolder(FileSystemModule::instance()->getRootFileItem())
   , m_req_valid(false)
   , m_selected(nullptr)
+  , m_itemToSelect(nullptr)
   , m_isearchClock(0)
   , m_generateThumbnailTimer(200, this)
   , m_monitoringTimer(50, this)
@@ -52,6 +56,7 @@ FileList::FileList()
   m_monitoringTimer.Tick.connect(&FileList::onMonitoringTick, this);
   m_monitoringTimer.start();
 
+  m_currentFolder->loadChildren(LISTING_WAIT_MSECS);
   regenerateList();
 }
 
@@ -82,7 +87,11 @@ void FileList::setCurrentFolder(IFileItem* folder)
   m_currentFolder = folder;
   m_req_valid = false;
   m_selected = nullptr;
+  m_itemToSelect = nullptr;
 
+  // Big folders (or slow network drives) are listed in background,
+  // the list is completed in onMonitoringTick().
+  folder->loadChildren(LISTING_WAIT_MSECS);
   regenerateList();
 
   // As now we are in other folder, we can stop the generation of all
@@ -148,11 +157,9 @@ void FileList::goUp()
   if (parent) {
     setCurrentFolder(parent);
 
-    m_selected = folder;
-    deselectedFileItems();
-
-    // Make the selected item visible.
-    makeSelectedFileitemVisible();
+    // Select the folder where we were (when it's listed)
+    m_itemToSelect = folder;
+    selectListedItem();
   }
 }
 
@@ -661,13 +668,21 @@ void FileList::onCurrentFolderChanged()
 
 void FileList::onMonitoringTick()
 {
+  // Add the items found by the background listing of the folder
+  if (m_currentFolder->updateChildren())
+    updateListedItems();
+
   auto start = base::current_tick();
   while (!m_generateThumbnailsForTheseItems.empty() &&
          // No more than 200ms launching thumbnail generators
          base::current_tick() - start < 200) {
     auto fi = m_generateThumbnailsForTheseItems.front();
     m_generateThumbnailsForTheseItems.pop_front();
-    ThumbnailGenerator::instance()->generateThumbnail(fi);
+
+    // Don't waste time with items that are not visible anymore
+    // (e.g. the user scrolled the list)
+    if (isItemVisible(fi))
+      ThumbnailGenerator::instance()->generateThumbnail(fi);
   }
 
   if (ThumbnailGenerator::instance()->checkWorkers())
@@ -848,8 +863,8 @@ void FileList::makeSelectedFileitemVisible()
 
 void FileList::regenerateList()
 {
-  // get the children of the current folder
-  m_list = m_currentFolder->children();
+  // get the children of the current folder (listed so far)
+  m_list = m_currentFolder->loadedChildren();
 
   // filter the list by the available extensions
   if (!m_exts.empty()) {
@@ -879,6 +894,69 @@ void FileList::regenerateList()
     m_selectedItems.clear();
 }
 
+// Called when new items are added to the current folder (or old
+// items are removed) by the background listing.
+void FileList::updateListedItems()
+{
+  const FileItemList& children = m_currentFolder->loadedChildren();
+  auto contains = [](const FileItemList& list, const IFileItem* fi) {
+    return (std::find(list.begin(), list.end(), fi) != list.end());
+  };
+
+  // Forget items that were removed
+  if (m_selected && !contains(children, m_selected))
+    m_selected = nullptr;
+  if (m_itemToGenerateThumbnail && !contains(children, m_itemToGenerateThumbnail))
+    m_itemToGenerateThumbnail = nullptr;
+
+  const FileItemList selected =
+    (m_multiselect ? selectedFileItems(): FileItemList());
+
+  m_req_valid = false;
+  regenerateList();
+
+  // Restore the multiple selection
+  if (m_multiselect) {
+    for (int i=0; i<int(m_list.size()); ++i)
+      if (contains(selected, m_list[i]))
+        m_selectedItems[i] = true;
+  }
+
+  selectListedItem();
+  invalidate();
+  if (View* view = View::getView(this))
+    view->updateView();
+}
+
+void FileList::selectListedItem()
+{
+  if (!m_itemToSelect ||
+      std::find(m_list.begin(), m_list.end(), m_itemToSelect) == m_list.end())
+    return;
+
+  m_selected = m_itemToSelect;
+  m_itemToSelect = nullptr;
+  deselectedFileItems();
+
+  // Make the selected item visible.
+  makeSelectedFileitemVisible();
+}
+
+bool FileList::isItemVisible(IFileItem* fi) const
+{
+  auto it = std::find(m_list.begin(), m_list.end(), fi);
+  if (it == m_list.end())
+    return false;
+
+  View* view = View::getView(this);
+  if (!view)
+    return true;
+
+  gfx::Rect rc = getFileItemInfo(it - m_list.begin()).bounds;
+  rc.offset(bounds().origin());
+  return view->viewportBounds().intersects(rc);
+}
+
 int FileList::selectedIndex() const
 {
   for (auto it = m_list.begin(), end = m_list.end();
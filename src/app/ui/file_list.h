@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -87,6 +87,9 @@ namespace app {
     ItemInfo getFileItemInfo(int i) const;
     void makeSelectedFileitemVisible();
     void regenerateList();
+    void updateListedItems();
+    void selectListedItem();
+    bool isItemVisible(IFileItem* fi) const;
     int selectedIndex() const;
     void selectIndex(int index);
     void generateThumbnailForFileItem(IFileItem* fi);
@@ -106,6 +109,10 @@ namespace app {
     bool m_req_valid;
     int m_req_w, m_req_h;
     IFileItem* m_selected;
+
+    // Item to be selected when it's listed (the current folder can
+    // be listed in background).
+    IFileItem* m_itemToSelect;
     std::vector<bool> m_selectedItems;
     base::paths m_exts;
 
@@ -884,6 +884,8 @@ void FileSelector::onRefreshFolder()
   auto fs = FileSystemModule::instance();
   fs->refresh();
 
+  // List the folder again even if it wasn't modified
+  m_fileList->currentFolder()->invalidateChildren();
   m_fileList->setCurrentFolder(m_fileList->currentFolder());
 }
 
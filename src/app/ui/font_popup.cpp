@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2022  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -72,15 +72,18 @@ private:
     ListItem::onPaint(ev);
 
     if (m_image) {
-      Graphics* g = ev.graphics();
-      os::SurfaceRef sur = os::instance()->makeRgbaSurface(m_image->width(),
-                                                           m_image->height());
-
-      convert_image_to_surface(
-        m_image.get(), nullptr, sur.get(),
-        0, 0, 0, 0, m_image->width(), m_image->height());
+      // Convert the thumbnail to a surface only one time (and not in
+      // each paint event)
+      if (!m_surface) {
+        m_surface = os::instance()->makeRgbaSurface(m_image->width(),
+                                                    m_image->height());
+        convert_image_to_surface(
+          m_image.get(), nullptr, m_surface.get(),
+          0, 0, 0, 0, m_image->width(), m_image->height());
+      }
 
-      g->drawRgbaSurface(sur.get(), textWidth()+4, 0);
+      Graphics* g = ev.graphics();
+      g->drawRgbaSurface(m_surface.get(), textWidth()+4, 0);
     }
   }
 
@@ -115,6 +118,7 @@ private:
                     gfx::getb(color),
                     gfx::geta(color)),
           true));                   // antialias
+      m_surface.reset();
 
       View* view = View::getView(listbox);
       view->updateView();
@@ -130,6 +134,7 @@ private:
 
 private:
   doc::ImageRef m_image;
+  os::SurfaceRef m_surface;
   std::string m_filename;
 };
 
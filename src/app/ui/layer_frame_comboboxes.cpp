@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2016-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -250,19 +250,15 @@ doc::Tag* calculate_frames_sequence(const Site& site,
       }
     }
 
-    auto playback = doc::Playback(
+    const doc::PlaybackSequence playback(
       site.document()->sprite(),
       site.document()->sprite()->tags().getInternalList(),
       start,
       doc::Playback::PlayAll,
       tag,
       forward);
-    framesSeq.insert(playback.frame());
-    auto frame = playback.nextFrame();
-    while(!playback.isStopped()) {
+    for (const doc::frame_t frame : playback.frames())
       framesSeq.insert(frame);
-      frame = playback.nextFrame();
-    }
 
     if (framesValue == kAllFrames) {
       // If the user is playing all frames and selected some of the ping-pong
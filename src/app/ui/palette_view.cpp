@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2022  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -51,6 +51,7 @@
 #include "ui/widget.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <set>
@@ -89,6 +90,10 @@ public:
                          gfx::Rect& box,
                          gfx::Color& negColor) = 0;
   virtual doc::Tileset* tileset() const { return nullptr; }
+
+  // Returns a value that changes each time the entries must be
+  // redrawn, or 0 if the entries cannot be cached in a surface.
+  virtual uint64_t entriesVersion() const { return 0; }
 };
 
 // This default adapter uses the default behavior to use the
@@ -190,6 +195,11 @@ public:
       rgba_geta(palColor));
     negColor = color_utils::blackandwhite_neg(gfxColor);
   }
+  uint64_t entriesVersion() const override {
+    const doc::Palette* pal = palette();
+    return ((uint64_t(pal->id()) << 32) |
+            uint32_t(pal->getModifications()));
+  }
 private:
   doc::Palette* palette() const {
     return get_current_palette();
@@ -362,7 +372,10 @@ PaletteView::PaletteView(bool editable, PaletteViewStyle style, PaletteViewDeleg
 
   m_palConn = App::instance()->PaletteChange.connect(&PaletteView::onAppPaletteChange, this);
   m_csConn = App::instance()->ColorSpaceChange.connect(
-    [this]{ invalidate(); });
+    [this]{
+      m_entriesSurface.reset();
+      invalidate();
+    });
 
   {
     auto& entriesSep = Preferences::instance().colorBar.entriesSeparator;
@@ -841,6 +854,14 @@ void PaletteView::onPaint(ui::PaintEvent& ev)
   if (dragging && !m_copy) palSize -= picksCount;
   if (resizing) palSize = m_hot.color;
 
+  // In the regular case (not dragging/resizing entries) all entries
+  // are drawn from the cached surface and we only paint the
+  // decorations above each entry.
+  const bool cachedEntries =
+    (!dragging && !resizing && updateEntriesSurface(theme));
+  if (cachedEntries)
+    g->drawSurface(m_entriesSurface.get(), 0, 0);
+
   for (int i=0; i<palSize; ++i) {
     if (dragging) {
       if (!m_copy) {
@@ -855,8 +876,13 @@ void PaletteView::onPaint(ui::PaintEvent& ev)
 
     gfx::Rect box = getPaletteEntryBounds(i + boxOffset);
     gfx::Color negColor;
-    m_adapter->drawEntry(g, theme, i + idxOffset, i + boxOffset,
-                         childSpacing(), box, negColor);
+    if (cachedEntries) {
+      negColor = m_entriesNegColors[i];
+    }
+    else {
+      m_adapter->drawEntry(g, theme, i + idxOffset, i + boxOffset,
+                           childSpacing(), box, negColor);
+    }
     const int boxsize = boxSizePx();
     const int scale = guiscale();
 
@@ -987,6 +1013,48 @@ void PaletteView::onPaint(ui::PaintEvent& ev)
   }
 }
 
+bool PaletteView::updateEntriesSurface(SkinTheme* theme)
+{
+  const uint64_t version = m_adapter->entriesVersion();
+  const gfx::Size size = clientBounds().size();
+  ui::Display* display = this->display();
+  if (!version || !display || size.w < 1 || size.h < 1) {
+    m_entriesSurface.reset();
+    return false;
+  }
+
+  const EntriesKey key{ version,
+                        m_adapter->size(),
+                        m_columns,
+                        boxSizePx(),
+                        size };
+  const os::ColorSpaceRef& cs = display->surface()->colorSpace();
+  if (m_entriesSurface &&
+      m_entriesSurface->colorSpace() == cs &&
+      m_entriesKey == key)
+    return true;
+
+  if (!m_entriesSurface ||
+      m_entriesSurface->width() != size.w ||
+      m_entriesSurface->height() != size.h ||
+      m_entriesSurface->colorSpace() != cs) {
+    // Use the same color space as the screen to avoid conversions
+    // when we draw this surface
+    m_entriesSurface = os::instance()->makeSurface(size.w, size.h, cs);
+  }
+  m_entriesKey = key;
+  m_entriesNegColors.resize(key.entries);
+
+  ui::Graphics g(display, m_entriesSurface, 0, 0);
+  g.fillRect(theme->colors.editorFace(), gfx::Rect(size));
+  for (int i=0; i<key.entries; ++i) {
+    gfx::Rect box = getPaletteEntryBounds(i);
+    m_adapter->drawEntry(&g, theme, i, i, childSpacing(),
+                         box, m_entriesNegColors[i]);
+  }
+  return true;
+}
+
 void PaletteView::onResize(ui::ResizeEvent& ev)
 {
   if (!m_isUpdatingColumns) {
@@ -1365,6 +1433,7 @@ void PaletteView::updateBorderAndChildSpacing()
   const int dim = theme->dimensions.paletteEntriesSeparator();
   setBorder(gfx::Border(dim));
   setChildSpacing(m_withSeparator ? dim: 0);
+  m_entriesSurface.reset();
 
   View* view = View::getView(this);
   if (view)
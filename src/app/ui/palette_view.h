@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2021  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -18,10 +18,12 @@
 #include "doc/tile.h"
 #include "obs/connection.h"
 #include "obs/signal.h"
+#include "os/surface.h"
 #include "ui/event.h"
 #include "ui/mouse_button.h"
 #include "ui/widget.h"
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -31,6 +33,9 @@ namespace doc {
 }
 
 namespace app {
+  namespace skin {
+    class SkinTheme;
+  }
 
   enum class PaletteViewModification {
     CLEAR,
@@ -185,6 +190,24 @@ namespace app {
                        PaletteViewModification mod);
     int boxSizePx() const;
     void updateBorderAndChildSpacing();
+    bool updateEntriesSurface(skin::SkinTheme* theme);
+
+    // Values used to know if m_entriesSurface must be redrawn.
+    struct EntriesKey {
+      uint64_t version = 0;
+      int entries = 0;
+      int columns = 0;
+      int boxsize = 0;
+      gfx::Size size;
+
+      bool operator==(const EntriesKey& o) const {
+        return (version == o.version &&
+                entries == o.entries &&
+                columns == o.columns &&
+                boxsize == o.boxsize &&
+                size == o.size);
+      }
+    };
 
     State m_state;
     bool m_editable;
@@ -203,6 +226,13 @@ namespace app {
     Hit m_hot;
     bool m_copy;
     bool m_withSeparator;
+
+    // Surface with all the entries drawn (without selection/hot
+    // decorations), and the color to draw decorations above each
+    // entry.
+    os::SurfaceRef m_entriesSurface;
+    EntriesKey m_entriesKey;
+    std::vector<gfx::Color> m_entriesNegColors;
   };
 
 } // namespace app
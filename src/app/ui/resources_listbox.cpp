@@ -212,19 +212,25 @@ void ResourcesListBox::onTick()
   m_loadingItem->makeProgress();
 
   std::unique_ptr<Resource> resource;
-  std::string name;
+  bool added = false;
 
   while (m_resourcesLoader->next(resource)) {
     std::unique_ptr<ResourceListItem> listItem(onCreateResourceItem(resource.get()));
     insertChild(getItemsCount()-1, listItem.get());
+    added = true;
+
+    resource.release();
+    listItem.release();
+  }
+
+  // Sort and layout the list once for all the new items of this tick
+  // (big palette libraries can add hundreds of items each time).
+  if (added) {
     sortItems();
     layout();
 
     if (View* view = View::getView(this))
       view->updateView();
-
-    resource.release();
-    listItem.release();
   }
 
   if (m_resourcesLoader->isDone()) {
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,8 @@
 
 #include "app/ui/skin/font_data.h"
 
+#include "app/font_path.h"
+#include "base/log.h"
 #include "os/font.h"
 #include "os/system.h"
 #include "ui/scale.h"
@@ -39,6 +41,9 @@ os::FontRef FontData::getFont(int size, int uiscale)
   if (it != m_fonts.end())
     return it->second;
 
+  if (!m_filesToFind.empty())
+    findFile();
+
   os::FontRef font = nullptr;
 
   switch (m_type) {
@@ -71,5 +76,17 @@ os::FontRef FontData::getFont(int size)
   return getFont(size, ui::guiscale());
 }
 
+void FontData::findFile()
+{
+  for (const std::string& fn : m_filesToFind) {
+    m_filename = app::find_font(m_firstDir, fn);
+    if (!m_filename.empty()) {
+      LOG(VERBOSE, "THEME: Font file '%s' found\n", m_filename.c_str());
+      break;
+    }
+  }
+  m_filesToFind.clear();
+}
+
 } // namespace skin
 } // namespace app
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2017  David Capello
 //
 // This program is distributed under the terms of
@@ -10,6 +10,7 @@
 #pragma once
 
 #include "base/disable_copying.h"
+#include "base/paths.h"
 #include "os/font.h"
 
 #include <map>
@@ -22,6 +23,16 @@ namespace skin {
     FontData(os::FontType type);
 
     void setFilename(const std::string& filename) { m_filename = filename; }
+
+    // Sets the possible files of a TrueType font. They are searched
+    // (in "firstDir" and then in the system font directories) when
+    // the font is used for first time, so we don't look for fonts
+    // that are not used.
+    void setFilesToFind(const std::string& firstDir,
+                        const base::paths& filenames) {
+      m_firstDir = firstDir;
+      m_filesToFind = filenames;
+    }
     void setAntialias(bool antialias) { m_antialias = antialias; }
     void setFallback(FontData* fallback, int fallbackSize) {
       m_fallback = fallback;
@@ -32,8 +43,12 @@ namespace skin {
     os::FontRef getFont(int size);
 
   private:
+    void findFile();
+
     os::FontType m_type;
     std::string m_filename;
+    std::string m_firstDir;
+    base::paths m_filesToFind;
     bool m_antialias;
     std::map<int, os::FontRef> m_fonts; // key=font size, value=real font
     FontData* m_fallback;
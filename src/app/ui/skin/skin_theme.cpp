@@ -14,8 +14,8 @@
 #include "app/app.h"
 #include "app/console.h"
 #include "app/extensions.h"
-#include "app/font_path.h"
 #include "app/modules/gui.h"
+#include "app/perf_trace.h"
 #include "app/pref/preferences.h"
 #include "app/resource_finder.h"
 #include "app/ui/app_menuitem.h"
@@ -216,21 +216,18 @@ static FontData* load_font(std::map<std::string, FontData*>& fonts,
     if (xmlFont->Attribute("antialias"))
       antialias = bool_attr(xmlFont, "antialias", false);
 
-    std::string fontFilename;
+    base::paths filesToFind;
     if (platformFileStr)
-      fontFilename = app::find_font(xmlDir, platformFileStr);
-    if (fileStr && fontFilename.empty())
-      fontFilename = app::find_font(xmlDir, fileStr);
+      filesToFind.push_back(platformFileStr);
+    if (fileStr)
+      filesToFind.push_back(fileStr);
 
     // The filename can be empty if the font was not found, anyway we
     // want to keep the font information (e.g. to use the fallback
     // information of this font).
     font.reset(new FontData(os::FontType::FreeType));
-    font->setFilename(fontFilename);
+    font->setFilesToFind(xmlDir, filesToFind);
     font->setAntialias(antialias);
-
-    if (!fontFilename.empty())
-      LOG(VERBOSE, "THEME: Font file '%s' found\n", fontFilename.c_str());
   }
   else {
     throw base::Exception("Invalid type=\"%s\" in '%s' for <font name=\"%s\" ...>\n",
@@ -367,6 +364,7 @@ void SkinTheme::loadAll(const std::string& themeId,
                         BackwardCompatibility* backward)
 {
   LOG("THEME: Loading theme %s\n", themeId.c_str());
+  PerfScope perf(PerfCategory::Startup, "SkinTheme::loadAll");
 
   if (m_fonts.empty())
     loadFontData();
@@ -288,6 +288,9 @@ Timeline::~Timeline()
   m_context->documents().remove_observer(this);
   m_context->remove_observer(this);
   m_confPopup.reset();
+
+  // Release the cached surfaces before the os::System is destroyed
+  thumb::clear_thumbnails_cache();
 }
 
 void Timeline::setZoom(const double zoom)
@@ -1732,6 +1735,25 @@ void Timeline::onPaint(ui::PaintEvent& ev)
     getDrawableLayers(&firstLayer, &lastLayer);
     getDrawableFrames(&firstFrame, &lastFrame);
 
+    // Only paint the layers/frames that intersect the clipping region
+    // (e.g. when a cel or a frame header is invalidated)
+    {
+      const gfx::Rect clip = g->getClipBounds();
+      auto rowVisible = [this, &clip](const layer_t layer) {
+        const gfx::Rect rc = getPartBounds(Hit(PART_ROW, layer));
+        return (rc.y < clip.y2() && rc.y2() > clip.y);
+      };
+      auto columnVisible = [this, &clip](const frame_t frame) {
+        const gfx::Rect rc = getPartBounds(Hit(PART_HEADER_FRAME, firstLayer(), frame));
+        return (rc.x < clip.x2() && rc.x2() > clip.x);
+      };
+      // Layers are painted from the bottom (lastLayer) to the top
+      while (firstLayer <= lastLayer && !rowVisible(firstLayer)) ++firstLayer;
+      while (lastLayer >= firstLayer && !rowVisible(lastLayer)) --lastLayer;
+      while (firstFrame <= lastFrame && !columnVisible(firstFrame)) ++firstFrame;
+      while (lastFrame >= firstFrame && !columnVisible(lastFrame)) --lastFrame;
+    }
+
     drawTop(g);
 
     // Draw the header for layers.
@@ -2021,7 +2043,8 @@ void Timeline::onTagRename(DocEvent& ev)
 
 void Timeline::onLayerCollapsedChanged(DocEvent& ev)
 {
-  regenerateRows();
+  if (!regenerateGroupRows(ev.layer()))
+    regenerateRows();
   invalidate();
 }
 
@@ -3238,29 +3261,55 @@ void Timeline::regenerateRows()
   ASSERT(m_document);
   ASSERT(m_sprite);
 
-  size_t nlayers = 0;
+  // Clearing the vector keeps its capacity, so rows are not
+  // reallocated each time.
+  m_rows.clear();
   for_each_expanded_layer(
     m_sprite->root(),
-    [&nlayers](Layer* layer, int level, LayerFlags flags) {
-      ++nlayers;
+    [this](Layer* layer, int level, LayerFlags flags) {
+      m_rows.emplace_back(layer, level, flags);
     });
 
-  if (m_rows.size() != nlayers) {
-    if (nlayers > 0)
-      m_rows.resize(nlayers);
-    else
-      m_rows.clear();
-  }
+  regenerateTagBands();
+  updateScrollBars();
+}
 
-  size_t i = 0;
-  for_each_expanded_layer(
-    m_sprite->root(),
-    [&i, this](Layer* layer, int level, LayerFlags flags) {
-      m_rows[i++] = Row(layer, level, flags);
-    });
+// Updates only the rows of the children of the given group when it's
+// expanded/collapsed. Returns false if the group doesn't have a row
+// (e.g. it's inside a collapsed group) and regenerateRows() must be
+// used instead.
+bool Timeline::regenerateGroupRows(Layer* group)
+{
+  if (!group || !group->isGroup())
+    return false;
+
+  auto it = std::find_if(m_rows.begin(), m_rows.end(),
+                         [group](const Row& row){ return row.layer() == group; });
+  if (it == m_rows.end())
+    return false;
+
+  // The rows of the expanded children are just before the group row
+  // (with a greater level)
+  const int level = it->level();
+  const LayerFlags flags = it->inheritedFlags();
+  auto first = it;
+  while (first != m_rows.begin() && (first-1)->level() > level)
+    --first;
+  it = m_rows.erase(first, it);
+
+  if (!group->isCollapsed()) {
+    std::vector<Row> rows;
+    for_each_expanded_layer(
+      static_cast<LayerGroup*>(group),
+      [&rows](Layer* layer, int level, LayerFlags flags) {
+        rows.emplace_back(layer, level, flags);
+      },
+      level+1, flags);
+    m_rows.insert(it, rows.begin(), rows.end());
+  }
 
-  regenerateTagBands();
   updateScrollBars();
+  return true;
 }
 
 void Timeline::regenerateTagBands()
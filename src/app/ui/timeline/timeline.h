@@ -247,6 +247,7 @@ namespace app {
 
       Layer* layer() const { return m_layer; }
       int level() const { return m_level; }
+      LayerFlags inheritedFlags() const { return m_inheritedFlags; }
 
       bool parentVisible() const;
       bool parentEditable() const;
@@ -319,6 +320,7 @@ namespace app {
     void invalidateFrame(const frame_t frame);
     void invalidateRange();
     void regenerateRows();
+    bool regenerateGroupRows(Layer* group);
     void regenerateTagBands();
     int visibleTagBands() const;
     void updateScrollBars();
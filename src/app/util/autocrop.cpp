@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -12,14 +12,25 @@
 #include "app/util/autocrop.h"
 
 #include "app/snap_to_grid.h"
+#include "app/util/parallel_tasks.h"
 #include "doc/algorithm/shrink_bounds.h"
+#include "doc/cel.h"
 #include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/layer_tilemap.h"
 #include "doc/mask.h"
+#include "doc/palette.h"
 #include "doc/sprite.h"
+#include "doc/tileset.h"
 #include "render/render.h"
 
 #include <algorithm>
+#include <atomic>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace app {
 
@@ -27,6 +38,78 @@ using namespace doc;
 
 namespace {
 
+// Trimmed bounds of each frame of the last trimmed sprites, so
+// trimming the same sprite again only needs to render the frames
+// that were modified.
+struct TrimmedFrame {
+  // Everything that affects the rendered frame (ids and versions of
+  // the layers/cels/images and their rendering properties)
+  std::vector<uint64_t> signature;
+  bool hasBounds = false;
+  gfx::Rect bounds;
+};
+
+struct TrimmedSprite {
+  ObjectId spriteId = 0;
+  std::vector<TrimmedFrame> frames;
+};
+
+constexpr int kMaxTrimmedSprites = 8;
+std::mutex g_trimmedMutex;
+std::list<TrimmedSprite> g_trimmedSprites; // Most recently used first
+
+void add_layer_signature(const Layer* layer,
+                         const frame_t frame,
+                         std::vector<uint64_t>& sig)
+{
+  sig.push_back(layer->id());
+  sig.push_back(layer->version());
+  sig.push_back(uint64_t(layer->flags()));
+
+  if (layer->isImage()) {
+    auto imgLayer = static_cast<const LayerImage*>(layer);
+    sig.push_back(imgLayer->opacity());
+    sig.push_back(uint64_t(imgLayer->blendMode()));
+
+    if (layer->isTilemap()) {
+      const Tileset* tileset = static_cast<const LayerTilemap*>(layer)->tileset();
+      sig.push_back(tileset ? tileset->id(): 0);
+      sig.push_back(tileset ? tileset->version(): 0);
+    }
+
+    if (const Cel* cel = layer->cel(frame)) {
+      sig.push_back(cel->id());
+      sig.push_back(cel->version());
+      sig.push_back(cel->data()->version());
+      sig.push_back(cel->image()->id());
+      sig.push_back(cel->image()->version());
+      sig.push_back(uint64_t(uint32_t(cel->x())) << 32 | uint32_t(cel->y()));
+      sig.push_back(cel->opacity());
+      sig.push_back(uint64_t(uint32_t(cel->zIndex())));
+    }
+    else
+      sig.push_back(0);
+  }
+  else if (layer->isGroup()) {
+    for (const Layer* child : static_cast<const LayerGroup*>(layer)->layers())
+      add_layer_signature(child, frame, sig);
+  }
+}
+
+void get_frame_signature(const Sprite* sprite,
+                         const frame_t frame,
+                         std::vector<uint64_t>& sig)
+{
+  sig.clear();
+  const Palette* pal = sprite->palette(frame);
+  sig.push_back(uint64_t(sprite->pixelFormat()));
+  sig.push_back(uint64_t(uint32_t(sprite->width())) << 32 | uint32_t(sprite->height()));
+  sig.push_back(sprite->transparentColor());
+  sig.push_back(pal ? pal->id(): 0);
+  sig.push_back(pal ? pal->version(): 0);
+  add_layer_signature(sprite->root(), frame, sig);
+}
+
 // We call a "solid border" when a specific color is repeated in every
 // pixel of the image edge.  This will return isBorder1Solid=true if
 // the top (when topBottomLookUp=true) or left edge (when
@@ -263,22 +346,80 @@ gfx::Rect get_trimmed_bounds(
   const doc::Sprite* sprite,
   const bool byGrid)
 {
-  gfx::Rect bounds;
-
-  std::unique_ptr<Image> image_wrap(Image::create(sprite->spec()));
-  Image* image = image_wrap.get();
+  const frame_t nframes = sprite->totalFrames();
+  std::vector<TrimmedFrame> frames(nframes);
+
+  // Get the bounds of the frames that weren't modified since the last
+  // time this sprite was trimmed.
+  std::vector<TrimmedFrame> cached;
+  {
+    const std::lock_guard lock(g_trimmedMutex);
+    for (auto& trimmed : g_trimmedSprites) {
+      if (trimmed.spriteId == sprite->id()) {
+        cached = trimmed.frames;
+        break;
+      }
+    }
+  }
 
-  render::Render render;
+  std::vector<frame_t> pending;
+  for (frame_t frame(0); frame<nframes; ++frame) {
+    TrimmedFrame& tf = frames[frame];
+    get_frame_signature(sprite, frame, tf.signature);
+    if (frame < frame_t(cached.size()) &&
+        cached[frame].signature == tf.signature) {
+      tf.hasBounds = cached[frame].hasBounds;
+      tf.bounds = cached[frame].bounds;
+    }
+    else
+      pending.push_back(frame);
+  }
 
-  for (frame_t frame(0); frame<sprite->totalFrames(); ++frame) {
-    render.renderSprite(image, sprite, frame);
+  // Render the modified frames in parallel (each task with its own
+  // Render and image)
+  if (!pending.empty()) {
+    const int npending = int(pending.size());
+    std::atomic<int> next(0);
+
+    run_parallel_tasks(
+      std::clamp<int>(std::thread::hardware_concurrency(), 1, npending),
+      [&](const std::atomic<bool>& stop){
+        std::unique_ptr<Image> image(Image::create(sprite->spec()));
+        render::Render render;
+
+        while (!stop) {
+          const int i = next++;
+          if (i >= npending)
+            break;
+
+          TrimmedFrame& tf = frames[pending[i]];
+          render.renderSprite(image.get(), sprite, pending[i]);
+
+          doc::color_t refColor;
+          tf.hasBounds =
+            (get_best_refcolor_for_trimming(image.get(), refColor) &&
+             doc::algorithm::shrink_bounds(image.get(), refColor, nullptr, tf.bounds));
+        }
+      },
+      []{ return true; });
+
+    const std::lock_guard lock(g_trimmedMutex);
+    auto it = std::find_if(g_trimmedSprites.begin(), g_trimmedSprites.end(),
+                           [sprite](const TrimmedSprite& trimmed){
+                             return trimmed.spriteId == sprite->id();
+                           });
+    if (it != g_trimmedSprites.end())
+      g_trimmedSprites.erase(it);
+
+    g_trimmedSprites.push_front(TrimmedSprite{ sprite->id(), frames });
+    if (int(g_trimmedSprites.size()) > kMaxTrimmedSprites)
+      g_trimmedSprites.pop_back();
+  }
 
-    gfx::Rect frameBounds;
-    doc::color_t refColor;
-    if (get_best_refcolor_for_trimming(image, refColor) &&
-        doc::algorithm::shrink_bounds(image, refColor, nullptr, frameBounds)) {
-      bounds = bounds.createUnion(frameBounds);
-    }
+  gfx::Rect bounds;
+  for (frame_t frame(0); frame<nframes; ++frame) {
+    if (frames[frame].hasBounds)
+      bounds = bounds.createUnion(frames[frame].bounds);
 
     // TODO merge this code with the code in DocExporter::captureSamples()
     if (byGrid) {
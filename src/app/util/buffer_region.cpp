@@ -10,9 +10,12 @@
 
 #include "app/util/buffer_region.h"
 
+#include "base/exception.h"
 #include "doc/image.h"
 #include "gfx/region.h"
 
+#include "zlib.h"
+
 #include <algorithm>
 
 namespace app {
@@ -60,4 +63,36 @@ void swap_image_region_with_buffer(
   }
 }
 
+bool compress_buffer(base::buffer& buffer)
+{
+  if (buffer.empty())
+    return false;
+
+  uLongf compressedSize = compressBound(uLong(buffer.size()));
+  base::buffer compressed(compressedSize);
+  if (compress2(&compressed[0], &compressedSize,
+                &buffer[0], uLong(buffer.size()),
+                Z_BEST_SPEED) != Z_OK ||
+      compressedSize >= buffer.size()) {
+    return false;
+  }
+
+  compressed.resize(compressedSize);
+  compressed.shrink_to_fit();
+  buffer.swap(compressed);
+  return true;
+}
+
+void uncompress_buffer(base::buffer& buffer, const size_t rawSize)
+{
+  base::buffer output(rawSize);
+  uLongf outputSize = uLongf(rawSize);
+  if (uncompress(&output[0], &outputSize,
+                 &buffer[0], uLong(buffer.size())) != Z_OK ||
+      outputSize != rawSize) {
+    throw base::Exception("Invalid compressed undo data");
+  }
+  buffer.swap(output);
+}
+
 } // namespace app
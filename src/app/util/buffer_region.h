@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -28,6 +28,15 @@ namespace app {
     doc::Image* image,
     base::buffer& buffer);
 
+  // Compresses the buffer in-place with a fast compression level.
+  // Returns false (and keeps the buffer untouched) if the compressed
+  // data wouldn't be smaller than the original data.
+  bool compress_buffer(base::buffer& buffer);
+
+  // Uncompresses a buffer compressed with compress_buffer(), rawSize
+  // must be the size of the buffer before the compression.
+  void uncompress_buffer(base::buffer& buffer, const size_t rawSize);
+
 } // namespace app
 
 #endif
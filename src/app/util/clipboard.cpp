@@ -38,6 +38,8 @@
 #include "render/dithering.h"
 #include "render/ordered_dither.h"
 #include "render/quantization.h"
+#include "ui/manager.h"
+#include "ui/system.h"
 
 #include <memory>
 #include <stdexcept>
@@ -125,6 +127,15 @@ struct Clipboard::Data {
   // Selected set of layers/layers/cels
   ClipboardRange range;
 
+  // True if the image/tilemap must be converted to the native
+  // clipboard yet. The conversion is deferred to the next iteration
+  // of the UI loop so copy commands return immediately, several
+  // consecutive copies are converted just once, and a paste inside
+  // Aseprite uses this data directly instead of decoding the native
+  // clipboard.
+  bool nativePending = false;
+  bool nativeSourceIsTransparent = false;
+
   Data() {
     range.observeUIContext();
   }
@@ -143,6 +154,7 @@ struct Clipboard::Data {
     picks.clear();
     mask.reset();
     range.invalidate();
+    nativePending = false;
   }
 
   ClipboardFormat format() const {
@@ -191,6 +203,8 @@ Clipboard::~Clipboard()
 void Clipboard::setClipboardText(const std::string& text)
 {
   if (use_native_clipboard()) {
+    // Don't overwrite this text with a pending image later
+    m_data->nativePending = false;
     clip::set_text(text);
   }
   else {
@@ -229,25 +243,56 @@ void Clipboard::setData(Image* image,
 
   if (set_native_clipboard &&
       use_native_clipboard()) {
-    // Copy tilemap to the native clipboard
-    if (isTilemap) {
-      ASSERT(tileset);
-      setNativeBitmap(image, mask, palette, tileset);
+    m_data->nativePending = true;
+    m_data->nativeSourceIsTransparent = image_source_is_transparent;
+
+#ifdef ENABLE_UI
+    if (ui::Manager::getDefault()) {
+      ui::execute_from_ui_thread([]{
+        if (Clipboard* clipboard = Clipboard::instance())
+          clipboard->flushNativeBitmap();
+      });
     }
-    // Copy non-tilemap images to the native clipboard
-    else {
-      color_t oldMask = 0;
-      if (image) {
-        oldMask = image->maskColor();
-        if (!image_source_is_transparent)
-          image->setMaskColor(-1);
-      }
+    else
+#endif
+    {
+      flushNativeBitmap();
+    }
+  }
+}
 
-      setNativeBitmap(image, mask, palette);
+void Clipboard::flushNativeBitmap()
+{
+  if (!m_data->nativePending)
+    return;
 
-      if (image && !image_source_is_transparent)
-        image->setMaskColor(oldMask);
+  m_data->nativePending = false;
+
+  // Copy tilemap to the native clipboard
+  if (m_data->tilemap) {
+    ASSERT(m_data->tileset);
+    setNativeBitmap(m_data->tilemap.get(),
+                    m_data->mask.get(),
+                    m_data->palette.get(),
+                    m_data->tileset.get());
+  }
+  // Copy non-tilemap images to the native clipboard
+  else {
+    Image* image = m_data->image.get();
+    const bool transparent = m_data->nativeSourceIsTransparent;
+    color_t oldMask = 0;
+    if (image) {
+      oldMask = image->maskColor();
+      if (!transparent)
+        image->setMaskColor(-1);
     }
+
+    setNativeBitmap(image,
+                    m_data->mask.get(),
+                    m_data->palette.get());
+
+    if (image && !transparent)
+      image->setMaskColor(oldMask);
   }
 }
 
@@ -298,8 +343,11 @@ bool Clipboard::copyFromDocument(const Site& site, bool merged)
 
 ClipboardFormat Clipboard::format() const
 {
-  // Check if the native clipboard has an image
-  if (use_native_clipboard() && hasNativeBitmap()) {
+  // Check if the native clipboard has an image (if our own copy
+  // wasn't converted yet, the native clipboard is outdated)
+  if (use_native_clipboard() &&
+      !m_data->nativePending &&
+      hasNativeBitmap()) {
     return ClipboardFormat::Image;
   }
   else {
@@ -783,7 +831,7 @@ void Clipboard::paste(Context* ctx,
 ImageRef Clipboard::getImage(Palette* palette)
 {
   // Get the image from the native clipboard.
-  if (use_native_clipboard()) {
+  if (use_native_clipboard() && !m_data->nativePending) {
     Image* native_image = nullptr;
     Mask* native_mask = nullptr;
     Palette* native_palette = nullptr;
@@ -807,7 +855,9 @@ ImageRef Clipboard::getImage(Palette* palette)
 
 bool Clipboard::getImageSize(gfx::Size& size)
 {
-  if (use_native_clipboard() && getNativeBitmapSize(&size))
+  if (use_native_clipboard() &&
+      !m_data->nativePending &&
+      getNativeBitmapSize(&size))
     return true;
 
   if (m_data->image) {
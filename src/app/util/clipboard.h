@@ -100,6 +100,10 @@ namespace app {
                  bool image_source_is_transparent);
     bool copyFromDocument(const Site& site, bool merged = false);
 
+    // Converts the image/tilemap in the clipboard to the native
+    // clipboard if it wasn't converted yet.
+    void flushNativeBitmap();
+
     // Native clipboard
     void clearNativeContent();
     void registerNativeFormats();
@@ -11,6 +11,7 @@
 
 #include "app/util/conversion_to_surface.h"
 
+#include "app/perf_trace.h"
 #include "base/24bits.h"
 #include "doc/algo.h"
 #include "doc/color_scales.h"
@@ -27,6 +28,10 @@
 #include <algorithm>
 #include <stdexcept>
 
+#if defined(__x86_64__) || defined(_WIN64)
+  #include <emmintrin.h>
+#endif
+
 namespace app {
 
 using namespace doc;
@@ -99,6 +104,99 @@ void convert_image_to_surface_templ(const Image* image, os::Surface* dst,
   }
 }
 
+// Converts a color from RgbTraits to the 32bpp surface format
+inline uint32_t rgba_to_surface(const color_t c, const os::SurfaceFormatData* fd)
+{
+  return
+    ((rgba_getr(c) << fd->redShift  ) & fd->redMask  ) |
+    ((rgba_getg(c) << fd->greenShift) & fd->greenMask) |
+    ((rgba_getb(c) << fd->blueShift ) & fd->blueMask ) |
+    ((rgba_geta(c) << fd->alphaShift) & fd->alphaMask);
+}
+
+// Fast path for RGB images to 32bpp surfaces where the red and blue
+// channels are swapped (e.g. BGRA surfaces)
+void convert_rgb_row_to_bgra(const uint32_t* src, uint32_t* dst, int w)
+{
+#if defined(__x86_64__) || defined(_WIN64)
+  const __m128i agMask = _mm_set1_epi32(int(0xff00ff00));
+  const __m128i rbMask = _mm_set1_epi32(0x00ff00ff);
+  for (; w >= 4; w -= 4, src += 4, dst += 4) {
+    const __m128i c = _mm_loadu_si128((const __m128i*)src);
+    // Swap the 16-bit words of each 32-bit pixel (0x00BB00RR -> 0x00RR00BB)
+    __m128i rb = _mm_and_si128(c, rbMask);
+    rb = _mm_shufflelo_epi16(rb, _MM_SHUFFLE(2, 3, 0, 1));
+    rb = _mm_shufflehi_epi16(rb, _MM_SHUFFLE(2, 3, 0, 1));
+    _mm_storeu_si128((__m128i*)dst,
+                     _mm_or_si128(_mm_and_si128(c, agMask), rb));
+  }
+#endif
+  for (; w > 0; --w, ++src, ++dst) {
+    const uint32_t c = *src;
+    *dst = ((c & 0xff00ff00) |
+            ((c & 0x000000ff) << 16) |
+            ((c & 0x00ff0000) >> 16));
+  }
+}
+
+// Converts RGB/indexed images to 32bpp surfaces row by row (without
+// the generic per-pixel conversion of convert_image_to_surface_templ).
+// Returns false if there is no fast path for this format.
+bool convert_image_to_surface32(const Image* image, os::Surface* surface,
+                                int src_x, int src_y, int dst_x, int dst_y, int w, int h,
+                                const Palette* palette, const os::SurfaceFormatData* fd)
+{
+  if (fd->bitsPerPixel != 32)
+    return false;
+
+  switch (image->pixelFormat()) {
+
+    case IMAGE_RGB: {
+      const bool swapRB =
+        (fd->redShift == gfx::ColorBShift &&
+         fd->greenShift == gfx::ColorGShift &&
+         fd->blueShift == gfx::ColorRShift &&
+         fd->alphaShift == gfx::ColorAShift);
+
+      for (int v=0; v<h; ++v, ++src_y, ++dst_y) {
+        auto src = (const uint32_t*)image->getPixelAddress(src_x, src_y);
+        auto dst = (uint32_t*)surface->getData(dst_x, dst_y);
+        if (swapRB)
+          convert_rgb_row_to_bgra(src, dst, w);
+        else {
+          for (int u=0; u<w; ++u)
+            dst[u] = rgba_to_surface(src[u], fd);
+        }
+      }
+      return true;
+    }
+
+    case IMAGE_INDEXED: {
+      // Convert the palette to the surface format only once (instead
+      // of converting each pixel)
+      uint32_t lut[256];
+      const color_t maskColor = image->maskColor();
+      for (int i=0; i<256; ++i) {
+        lut[i] = (color_t(i) == maskColor ?
+                  rgba_to_surface(0, fd):
+                  rgba_to_surface(palette->getEntry(i), fd));
+      }
+
+      for (int v=0; v<h; ++v, ++src_y, ++dst_y) {
+        const uint8_t* src = image->getPixelAddress(src_x, src_y);
+        auto dst = (uint32_t*)surface->getData(dst_x, dst_y);
+        for (int u=0; u<w; ++u)
+          dst[u] = lut[src[u]];
+      }
+      return true;
+    }
+
+    default:
+      break;
+  }
+  return false;
+}
+
 struct Address24bpp
 {
   uint8_t* m_ptr;
@@ -147,6 +245,8 @@ void convert_image_to_surface(
   int dst_x, int dst_y,
   int w, int h)
 {
+  PerfScope perf(PerfCategory::Surface, "convert_image_to_surface");
+
   gfx::Rect srcBounds(src_x, src_y, w, h);
   srcBounds = srcBounds.createIntersection(image->bounds());
   if (srcBounds.isEmpty())
@@ -190,7 +290,8 @@ void convert_image_to_surface(
         }
         return;
       }
-      convert_image_to_surface_selector<RgbTraits>(image, surface, src_x, src_y, dst_x, dst_y, w, h, palette, &fd);
+      if (!convert_image_to_surface32(image, surface, src_x, src_y, dst_x, dst_y, w, h, palette, &fd))
+        convert_image_to_surface_selector<RgbTraits>(image, surface, src_x, src_y, dst_x, dst_y, w, h, palette, &fd);
       break;
 
     case IMAGE_GRAYSCALE:
@@ -198,7 +299,8 @@ void convert_image_to_surface(
       break;
 
     case IMAGE_INDEXED:
-      convert_image_to_surface_selector<IndexedTraits>(image, surface, src_x, src_y, dst_x, dst_y, w, h, palette, &fd);
+      if (!convert_image_to_surface32(image, surface, src_x, src_y, dst_x, dst_y, w, h, palette, &fd))
+        convert_image_to_surface_selector<IndexedTraits>(image, surface, src_x, src_y, dst_x, dst_y, w, h, palette, &fd);
       break;
 
     case IMAGE_BITMAP:
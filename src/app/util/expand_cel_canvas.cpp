@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -228,6 +228,11 @@ void ExpandCelCanvas::commit()
     ASSERT(m_cel);
     ASSERT(!m_celImage);
 
+    // Pixels can be modified only inside the valid region, the rest
+    // of m_dstImage is transparent, so we trim just this area
+    // (instead of scanning the whole canvas).
+    const gfx::Rect modifiedBounds = m_validDstRegion.bounds();
+
     // Validate the whole m_dstImage (invalid areas are cleared, as we
     // don't have a m_celImage)
     validateDestCanvas(gfx::Region(m_bounds));
@@ -236,7 +241,7 @@ void ExpandCelCanvas::commit()
       // We can temporary remove the cel.
       static_cast<LayerImage*>(m_layer)->removeCel(m_cel);
 
-      gfx::Rect trimBounds = getTrimDstImageBounds();
+      gfx::Rect trimBounds = getTrimDstImageBounds(modifiedBounds);
       if (!trimBounds.isEmpty()) {
         // Convert the image to tiles
         if (m_layer->isTilemap() &&
@@ -471,7 +476,9 @@ Image* ExpandCelCanvas::getSourceCanvas()
                                      m_bounds.w, m_bounds.h, src_buffer));
       m_srcImage->setMaskColor(m_sprite->transparentColor());
     }
-    m_srcImage->clear(m_srcImage->maskColor());
+    // New images are filled with zeros
+    if (m_srcImage->maskColor() != 0)
+      m_srcImage->clear(m_srcImage->maskColor());
   }
   return m_srcImage.get();
 }
@@ -489,7 +496,9 @@ Image* ExpandCelCanvas::getDestCanvas()
                                      m_bounds.w, m_bounds.h, dst_buffer));
       m_dstImage->setMaskColor(m_sprite->transparentColor());
     }
-    m_dstImage->clear(m_dstImage->maskColor());
+    // New images are filled with zeros
+    if (m_dstImage->maskColor() != 0)
+      m_dstImage->clear(m_dstImage->maskColor());
   }
   return m_dstImage.get();
 }
@@ -722,14 +731,15 @@ void ExpandCelCanvas::copyValidDestToSourceCanvas(const gfx::Region& rgn)
   m_canCompareSrcVsDst = false;
 }
 
-gfx::Rect ExpandCelCanvas::getTrimDstImageBounds() const
+gfx::Rect ExpandCelCanvas::getTrimDstImageBounds(const gfx::Rect& startBounds) const
 {
   if (m_layer->isBackground())
     return m_dstImage->bounds();
   else {
     gfx::Rect bounds;
     algorithm::shrink_bounds(m_dstImage.get(),
-                             m_dstImage->maskColor(), m_layer, bounds);
+                             m_dstImage->maskColor(), m_layer,
+                             startBounds, bounds);
     return bounds;
   }
 }
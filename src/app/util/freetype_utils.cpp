@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022  Igara Studio S.A.
+// Copyright (C) 2022-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -15,93 +15,211 @@
 #include "doc/blend_internals.h"
 #include "doc/color.h"
 #include "doc/image.h"
+#include "doc/image_ref.h"
 #include "doc/primitives.h"
 #include "ft/algorithm.h"
 #include "ft/face.h"
 #include "ft/hb_shaper.h"
 #include "ft/lib.h"
 
+#include <list>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <vector>
 
 namespace app {
 
-doc::Image* render_text(const std::string& fontfile, int fontsize,
-                        const std::string& text,
-                        doc::color_t color,
-                        bool antialias)
+namespace {
+
+// Number of font faces kept open, and number of rendered texts kept
+// in memory (e.g. the previews of the FontPopup, or the same text
+// pasted several times).
+constexpr std::size_t kMaxFaces = 8;
+constexpr std::size_t kMaxTexts = 32;
+
+struct TextKey {
+  std::string fontfile;
+  int fontsize;
+  std::string text;
+  doc::color_t color;
+  bool antialias;
+
+  bool operator==(const TextKey& other) const {
+    return (fontsize == other.fontsize &&
+            color == other.color &&
+            antialias == other.antialias &&
+            fontfile == other.fontfile &&
+            text == other.text);
+  }
+};
+
+// Alpha values of one glyph (already converted from 1-bit bitmaps
+// when antialias is disabled).
+struct GlyphMask {
+  gfx::Rect bounds;
+  std::vector<uint8_t> alpha;
+};
+
+// Keeps the FreeType library initialized and the last used faces
+// open, so we don't have to initialize FreeType and parse the font
+// file each time a text is rendered.
+class FontCache {
+public:
+  std::mutex& mutex() { return m_mutex; }
+
+  ft::Face* face(const std::string& fontfile) {
+    auto it = m_faces.find(fontfile);
+    if (it != m_faces.end())
+      return it->second.get();
+
+    auto face = std::make_unique<ft::Face>(m_lib.open(fontfile));
+    if (!face->isValid())
+      return nullptr;
+
+    if (m_faces.size() >= kMaxFaces)
+      m_faces.clear();
+
+    return (m_faces[fontfile] = std::move(face)).get();
+  }
+
+  doc::ImageRef text(const TextKey& key) {
+    for (auto it=m_texts.begin(); it!=m_texts.end(); ++it) {
+      if (it->first == key) {
+        // Move to the front as the most recently used text
+        m_texts.splice(m_texts.begin(), m_texts, it);
+        return m_texts.front().second;
+      }
+    }
+    return nullptr;
+  }
+
+  void addText(TextKey&& key, const doc::ImageRef& image) {
+    m_texts.emplace_front(std::move(key), image);
+    if (m_texts.size() > kMaxTexts)
+      m_texts.pop_back();
+  }
+
+private:
+  std::mutex m_mutex;
+  // The library must be destroyed after all faces
+  ft::Lib m_lib;
+  std::map<std::string, std::unique_ptr<ft::Face>> m_faces;
+  std::list<std::pair<TextKey, doc::ImageRef>> m_texts;
+};
+
+FontCache& font_cache()
+{
+  static FontCache cache;
+  return cache;
+}
+
+doc::Image* render_text_image(ft::Face& face,
+                              const std::string& text,
+                              doc::color_t color,
+                              bool antialias)
 {
-  std::unique_ptr<doc::Image> image(nullptr);
-  ft::Lib ft;
-
-  ft::Face face(ft.open(fontfile));
-  if (face.isValid()) {
-    // Set font size
-    face.setSize(fontsize);
-    face.setAntialias(antialias);
-
-    // Calculate text size
-    gfx::Rect bounds = ft::calc_text_bounds(face, text);
-
-    // Render the image and copy it to the clipboard
-    if (!bounds.isEmpty()) {
-      image.reset(doc::Image::create(doc::IMAGE_RGB, bounds.w, bounds.h));
-      doc::clear_image(image.get(), 0);
-
-      ft::ForEachGlyph<ft::Face> feg(face, text);
-      while (feg.next()) {
-        auto glyph = feg.glyph();
-        if (!glyph)
-          continue;
-
-        int t, yimg = - bounds.y + int(glyph->y);
-
-        for (int v=0; v<int(glyph->bitmap->rows); ++v, ++yimg) {
-          const uint8_t* p = glyph->bitmap->buffer + v*glyph->bitmap->pitch;
-          int ximg = - bounds.x + int(glyph->x);
-          int bit = 0;
-
-          for (int u=0; u<int(glyph->bitmap->width); ++u, ++ximg) {
-            int alpha;
-
-            if (antialias) {
-              alpha = *(p++);
-            }
-            else {
-              alpha = ((*p) & (1 << (7 - (bit++))) ? 255: 0);
-              if (bit == 8) {
-                bit = 0;
-                ++p;
-              }
-            }
-
-            int output_alpha = MUL_UN8(doc::rgba_geta(color), alpha, t);
-            if (output_alpha) {
-              doc::color_t output_color =
-                doc::rgba(doc::rgba_getr(color),
-                          doc::rgba_getg(color),
-                          doc::rgba_getb(color),
-                          output_alpha);
-
-              doc::put_pixel(
-                image.get(), ximg, yimg,
-                doc::rgba_blender_normal(
-                  doc::get_pixel(image.get(), ximg, yimg),
-                  output_color));
-            }
+  // Shape and render the text just one time, collecting the glyphs
+  // and the bounds of the whole text.
+  std::vector<GlyphMask> glyphs;
+  gfx::Rect bounds;
+
+  ft::ForEachGlyph<ft::Face> feg(face, text);
+  while (feg.next()) {
+    auto glyph = feg.glyph();
+    if (!glyph)
+      continue;
+
+    GlyphMask mask;
+    mask.bounds = gfx::Rect(int(glyph->x),
+                            int(glyph->y),
+                            int(glyph->bitmap->width),
+                            int(glyph->bitmap->rows));
+    mask.alpha.resize(std::size_t(mask.bounds.w) * mask.bounds.h);
+
+    auto dst = mask.alpha.begin();
+    for (int v=0; v<mask.bounds.h; ++v) {
+      const uint8_t* p = glyph->bitmap->buffer + v*glyph->bitmap->pitch;
+      int bit = 0;
+
+      for (int u=0; u<mask.bounds.w; ++u, ++dst) {
+        if (antialias) {
+          *dst = *(p++);
+        }
+        else {
+          *dst = ((*p) & (1 << (7 - (bit++))) ? 255: 0);
+          if (bit == 8) {
+            bit = 0;
+            ++p;
           }
         }
       }
     }
-    else {
-      throw std::runtime_error("There is no text");
+
+    bounds |= mask.bounds;
+    glyphs.push_back(std::move(mask));
+  }
+
+  if (bounds.isEmpty())
+    throw std::runtime_error("There is no text");
+
+  std::unique_ptr<doc::Image> image(
+    doc::Image::create(doc::IMAGE_RGB, bounds.w, bounds.h));
+  doc::clear_image(image.get(), 0);
+
+  for (const GlyphMask& mask : glyphs) {
+    auto src = mask.alpha.begin();
+    const int ximg = mask.bounds.x - bounds.x;
+    int yimg = mask.bounds.y - bounds.y;
+
+    for (int v=0; v<mask.bounds.h; ++v, ++yimg) {
+      auto dst = (doc::color_t*)image->getPixelAddress(ximg, yimg);
+
+      for (int u=0; u<mask.bounds.w; ++u, ++src, ++dst) {
+        int t;
+        const int output_alpha = MUL_UN8(doc::rgba_geta(color), *src, t);
+        if (output_alpha) {
+          const doc::color_t output_color =
+            doc::rgba(doc::rgba_getr(color),
+                      doc::rgba_getg(color),
+                      doc::rgba_getb(color),
+                      output_alpha);
+
+          *dst = doc::rgba_blender_normal(*dst, output_color);
+        }
+      }
     }
   }
-  else {
+
+  return image.release();
+}
+
+} // anonymous namespace
+
+doc::Image* render_text(const std::string& fontfile, int fontsize,
+                        const std::string& text,
+                        doc::color_t color,
+                        bool antialias)
+{
+  FontCache& cache = font_cache();
+  const std::lock_guard lock(cache.mutex());
+
+  TextKey key{ fontfile, fontsize, text, color, antialias };
+  if (doc::ImageRef image = cache.text(key))
+    return doc::Image::createCopy(image.get());
+
+  ft::Face* face = cache.face(fontfile);
+  if (!face)
     throw std::runtime_error("Error loading font face");
-  }
 
-  return (image ? image.release(): nullptr);
+  // Set font size
+  face->setSize(fontsize);
+  face->setAntialias(antialias);
+
+  doc::ImageRef image(render_text_image(*face, text, color, antialias));
+  cache.addText(std::move(key), image);
+  return doc::Image::createCopy(image.get());
 }
 
 } // namespace app
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -18,6 +19,9 @@ namespace doc {
 
 namespace app {
 
+  // Returns a new RGB image with the given text. The font faces and
+  // the last rendered texts are cached, so rendering the same text
+  // again (or other text with the same font) is faster.
   doc::Image* render_text(const std::string& fontfile, int fontsize,
                           const std::string& text,
                           doc::color_t color,
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2018  David Capello
 //
 // This program is distributed under the terms of
@@ -24,10 +24,89 @@
 #include "doc/layer.h"
 #include "doc/mask.h"
 
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_WIN64)
+  #include <emmintrin.h>
+#endif
+
 using namespace doc;
 
 namespace app {
 
+namespace {
+
+// Each function fills one row of the mask bitmap ("dst", 8 pixels per
+// byte, the first pixel in the less significant bit) with the pixels
+// of "src" that must be selected.
+
+void rgb_row_to_mask(const uint32_t* src, uint8_t* dst, const int w)
+{
+  int x = 0;
+#if defined(__x86_64__) || defined(_WIN64)
+  // The most significant bit of each pixel is the alpha >= 128 test
+  for (; x+8 <= w; x+=8, src+=8) {
+    const __m128i a = _mm_loadu_si128((const __m128i*)src);
+    const __m128i b = _mm_loadu_si128((const __m128i*)(src+4));
+    *(dst++) = uint8_t(_mm_movemask_ps(_mm_castsi128_ps(a)) |
+                       (_mm_movemask_ps(_mm_castsi128_ps(b)) << 4));
+  }
+#endif
+  for (; x<w; ++dst) {
+    uint8_t bits = 0;
+    for (int bit=0; bit<8 && x<w; ++bit, ++x, ++src) {
+      if (rgba_geta(*src) >= 128) // TODO configurable threshold
+        bits |= (1 << bit);
+    }
+    *dst = bits;
+  }
+}
+
+void gray_row_to_mask(const uint16_t* src, uint8_t* dst, const int w)
+{
+  int x = 0;
+#if defined(__x86_64__) || defined(_WIN64)
+  // The signed pack keeps the sign bit of each pixel (alpha >= 128)
+  for (; x+8 <= w; x+=8, src+=8) {
+    const __m128i a = _mm_loadu_si128((const __m128i*)src);
+    *(dst++) = uint8_t(_mm_movemask_epi8(_mm_packs_epi16(a, a)) & 0xff);
+  }
+#endif
+  for (; x<w; ++dst) {
+    uint8_t bits = 0;
+    for (int bit=0; bit<8 && x<w; ++bit, ++x, ++src) {
+      if (graya_geta(*src) >= 128) // TODO configurable threshold
+        bits |= (1 << bit);
+    }
+    *dst = bits;
+  }
+}
+
+void indexed_row_to_mask(const uint8_t* src, uint8_t* dst, const int w,
+                         const uint8_t maskColor)
+{
+  int x = 0;
+#if defined(__x86_64__) || defined(_WIN64)
+  const __m128i mc = _mm_set1_epi8(char(maskColor));
+  for (; x+16 <= w; x+=16, src+=16) {
+    const __m128i a = _mm_loadu_si128((const __m128i*)src);
+    const int bits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(a, mc));
+    *(dst++) = uint8_t(bits & 0xff);
+    *(dst++) = uint8_t((bits >> 8) & 0xff);
+  }
+#endif
+  for (; x<w; ++dst) {
+    uint8_t bits = 0;
+    for (int bit=0; bit<8 && x<w; ++bit, ++x, ++src) {
+      if (*src != maskColor)
+        bits |= (1 << bit);
+    }
+    *dst = bits;
+  }
+}
+
+} // anonymous namespace
+
 void select_layer_boundaries(Layer* layer,
                              const frame_t frame,
                              const SelectLayerBoundariesOp op)
@@ -41,55 +120,26 @@ void select_layer_boundaries(Layer* layer,
       newMask.replace(cel->bounds());
       newMask.freeze();
       {
-        LockImageBits<BitmapTraits> maskBits(newMask.bitmap());
-        auto maskIt = maskBits.begin();
-        auto maskEnd = maskBits.end();
-
-        switch (image->pixelFormat()) {
-
-          case IMAGE_RGB: {
-            LockImageBits<RgbTraits> rgbBits(image);
-            auto rgbIt = rgbBits.begin();
-#if _DEBUG
-            auto rgbEnd = rgbBits.end();
-#endif
-            for (; maskIt != maskEnd; ++maskIt, ++rgbIt) {
-              ASSERT(rgbIt != rgbEnd);
-              color_t c = *rgbIt;
-              *maskIt = (rgba_geta(c) >= 128); // TODO configurable threshold
-            }
-            break;
-          }
-
-          case IMAGE_GRAYSCALE: {
-            LockImageBits<GrayscaleTraits> grayBits(image);
-            auto grayIt = grayBits.begin();
-#if _DEBUG
-            auto grayEnd = grayBits.end();
-#endif
-            for (; maskIt != maskEnd; ++maskIt, ++grayIt) {
-              ASSERT(grayIt != grayEnd);
-              color_t c = *grayIt;
-              *maskIt = (graya_geta(c) >= 128); // TODO configurable threshold
-            }
-            break;
+        Image* bitmap = newMask.editableBitmap();
+        ASSERT(bitmap->width() == image->width());
+        ASSERT(bitmap->height() == image->height());
+
+        // Fill each row of the mask directly (8 pixels per byte)
+        const int w = image->width();
+        for (int y=0; y<image->height(); ++y) {
+          uint8_t* dst = bitmap->getPixelAddress(0, y);
+          switch (image->pixelFormat()) {
+            case IMAGE_RGB:
+              rgb_row_to_mask((const uint32_t*)image->getPixelAddress(0, y), dst, w);
+              break;
+            case IMAGE_GRAYSCALE:
+              gray_row_to_mask((const uint16_t*)image->getPixelAddress(0, y), dst, w);
+              break;
+            case IMAGE_INDEXED:
+              indexed_row_to_mask(image->getPixelAddress(0, y), dst, w,
+                                  uint8_t(image->maskColor()));
+              break;
           }
-
-          case IMAGE_INDEXED: {
-            const doc::color_t maskColor = image->maskColor();
-            LockImageBits<IndexedTraits> idxBits(image);
-            auto idxIt = idxBits.begin();
-#if _DEBUG
-            auto idxEnd = idxBits.end();
-#endif
-            for (; maskIt != maskEnd; ++maskIt, ++idxIt) {
-              ASSERT(idxIt != idxEnd);
-              color_t c = *idxIt;
-              *maskIt = (c != maskColor);
-            }
-            break;
-          }
-
         }
       }
       newMask.unfreeze();
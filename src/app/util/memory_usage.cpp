@@ -0,0 +1,145 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/util/memory_usage.h"
+
+#include "app/doc.h"
+#include "app/doc_undo.h"
+#include "app/extra_cel.h"
+#include "base/mem_utils.h"
+#include "doc/cel.h"
+#include "doc/cel_data.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/mask.h"
+#include "doc/palette.h"
+#include "doc/sprite.h"
+#include "doc/tileset.h"
+#include "doc/tilesets.h"
+#include "fmt/format.h"
+
+#include <unordered_set>
+
+namespace app {
+
+using namespace doc;
+
+// Sizes are accumulated as std::size_t because Object::getMemSize()
+// returns an int (which is enough for one image, but not for the
+// whole document).
+
+static void add_cels_memory_usage(const Layer* layer,
+                                  std::unordered_set<ObjectId>& visited,
+                                  std::size_t& images,
+                                  std::size_t& cels)
+{
+  if (layer->isImage()) {
+    auto imageLayer = static_cast<const LayerImage*>(layer);
+    for (auto it=imageLayer->getCelBegin(),
+              end=imageLayer->getCelEnd(); it!=end; ++it) {
+      const Cel* cel = *it;
+      cels += sizeof(Cel);
+
+      // Linked cels share the same CelData/image
+      const CelData* celData = cel->data();
+      if (visited.insert(celData->id()).second) {
+        cels += sizeof(CelData);
+        if (const Image* image = celData->image())
+          images += image->getMemSize();
+      }
+    }
+  }
+  else if (layer->isGroup()) {
+    for (const Layer* child : static_cast<const LayerGroup*>(layer)->layers())
+      add_cels_memory_usage(child, visited, images, cels);
+  }
+}
+
+DocMemoryUsage get_doc_memory_usage(const Doc* doc)
+{
+  DocMemoryUsage usage;
+  const Sprite* sprite = doc->sprite();
+
+  std::unordered_set<ObjectId> visited;
+  add_cels_memory_usage(sprite->root(), visited, usage.images, usage.cels);
+
+  if (sprite->hasTilesets()) {
+    for (const Tileset* tileset : *sprite->tilesets()) {
+      if (!tileset)
+        continue;
+
+      usage.tilesets += sizeof(Tileset);
+      for (const auto& tile : *tileset) {
+        if (tile.image)
+          usage.tilesets += tile.image->getMemSize();
+      }
+    }
+  }
+
+  for (const Palette* palette : sprite->getPalettes())
+    usage.palettes += palette->getMemSize();
+
+  if (const Mask* mask = doc->mask())
+    usage.masks += mask->getMemSize();
+
+  if (const DocUndo* undo = doc->undoHistory())
+    usage.undo += undo->totalUndoSize();
+
+  if (const ExtraCelRef extraCel = doc->extraCel()) {
+    if (const Image* image = extraCel->image())
+      usage.extra += image->getMemSize();
+  }
+
+  return usage;
+}
+
+std::size_t get_layer_memory_usage(const Layer* layer)
+{
+  std::unordered_set<ObjectId> visited;
+  std::size_t images = 0;
+  std::size_t cels = 0;
+  add_cels_memory_usage(layer, visited, images, cels);
+  return images + cels;
+}
+
+std::string get_doc_memory_report(const Doc* doc)
+{
+  const DocMemoryUsage usage = get_doc_memory_usage(doc);
+  auto size = [](const std::size_t bytes) {
+    return base::get_pretty_memory_size(bytes);
+  };
+
+  std::string report =
+    fmt::format("Memory usage of \"{}\": {}\n"
+                "  Images: {}\n"
+                "  Cels: {}\n"
+                "  Tilesets: {}\n"
+                "  Palettes: {}\n"
+                "  Selection: {}\n"
+                "  Undo history: {}\n"
+                "  Extra cel: {}\n",
+                doc->name(), size(usage.total()),
+                size(usage.images),
+                size(usage.cels),
+                size(usage.tilesets),
+                size(usage.palettes),
+                size(usage.masks),
+                size(usage.undo),
+                size(usage.extra));
+
+  for (const Layer* layer : doc->sprite()->root()->layers()) {
+    report += fmt::format("  Layer \"{}\": {}\n",
+                          layer->name(),
+                          size(get_layer_memory_usage(layer)));
+  }
+  return report;
+}
+
+} // namespace app
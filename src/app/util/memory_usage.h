@@ -0,0 +1,49 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_UTIL_MEMORY_USAGE_H_INCLUDED
+#define APP_UTIL_MEMORY_USAGE_H_INCLUDED
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace doc {
+  class Layer;
+}
+
+namespace app {
+
+  class Doc;
+
+  // Approximated memory (in bytes) used by each part of a document.
+  struct DocMemoryUsage {
+    std::size_t images = 0;   // Cel images (linked cels are counted once)
+    std::size_t cels = 0;     // Cel/CelData structures
+    std::size_t tilesets = 0; // Tiles of all tilesets
+    std::size_t palettes = 0;
+    std::size_t masks = 0;    // Selection of the document
+    std::size_t undo = 0;     // Undo history kept in memory (not spilled to disk)
+    std::size_t extra = 0;    // Extra cel (brush preview, moving pixels, etc.)
+
+    std::size_t total() const {
+      return images + cels + tilesets + palettes + masks + undo + extra;
+    }
+  };
+
+  DocMemoryUsage get_doc_memory_usage(const Doc* doc);
+
+  // Memory used by the cels of the given layer (or all the layers
+  // inside the group).
+  std::size_t get_layer_memory_usage(const doc::Layer* layer);
+
+  // Returns a human readable report of the memory used by the
+  // document (one line per item).
+  std::string get_doc_memory_report(const Doc* doc);
+
+} // namespace app
+
+#endif
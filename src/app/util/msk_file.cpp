@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -46,7 +47,7 @@ Mask* load_msk_file(const char* filename)
     if (image != NULL && (image->pixelFormat() == IMAGE_BITMAP)) {
       mask = new Mask();
       mask->replace(gfx::Rect(x, y, image->width(), image->height()));
-      mask->bitmap()->copy(image.get(), gfx::Clip(image->bounds()));
+      mask->editableBitmap()->copy(image.get(), gfx::Clip(image->bounds()));
       mask->shrink();
     }
   }
@@ -59,7 +60,7 @@ Mask* load_msk_file(const char* filename)
     for (i=0; i<8000; i++) {
       byte = getc(f);
       for (c=0; c<8; c++) {
-        mask->bitmap()->putPixel(u, v, byte & (1<<(7-c)));
+        mask->editableBitmap()->putPixel(u, v, byte & (1<<(7-c)));
         u++;
         if (u == 320) {
           u = 0;
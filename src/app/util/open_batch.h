@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020-2021  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -21,9 +21,26 @@ namespace app {
   public:
     void open(Context* ctx,
               const std::string& fn,
-              const bool oneFrame) {
+              const bool oneFrame,
+              const bool metadataOnly = false) {
+      open(ctx, base::paths{ fn }, oneFrame, metadataOnly);
+    }
+
+    // Opens several files at the same time (they are loaded in
+    // parallel).
+    void open(Context* ctx,
+              const base::paths& fns,
+              const bool oneFrame,
+              const bool metadataOnly = false) {
+      if (fns.empty())
+        return;
+
       Params params;
-      params.set("filename", fn.c_str());
+      params.set("filename", fns.front().c_str());
+      m_cmd.setExtraFilenames(base::paths(fns.begin()+1, fns.end()));
+
+      if (metadataOnly)
+        params.set("metadata_only", "true");
 
       if (oneFrame)
         params.set("oneframe", "true");
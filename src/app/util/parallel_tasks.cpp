@@ -0,0 +1,72 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/util/parallel_tasks.h"
+
+#include "doc/task_scheduler.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace app {
+
+void run_parallel_tasks(
+  const int ntasks,
+  const std::function<void(const std::atomic<bool>& stop)>& task,
+  const std::function<bool()>& onWait)
+{
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::atomic<bool> stop(false);
+  int pending = ntasks;
+
+  auto done = [&mutex, &cv, &pending]{
+    const std::lock_guard lock(mutex);
+    if (--pending == 0)
+      cv.notify_one();
+  };
+
+  // Exceptions are re-thrown by group.wait()
+  doc::TaskGroup group(doc::TaskPriority::Normal);
+  for (int i=0; i<ntasks; ++i) {
+    group.run(
+      [&]{
+        try {
+          task(stop);
+        }
+        catch (...) {
+          stop = true;
+          done();
+          throw;
+        }
+        done();
+      });
+  }
+
+  // Wait the tasks calling onWait() periodically (the tasks are
+  // executed by the scheduler threads)
+  {
+    std::unique_lock lock(mutex);
+    while (!cv.wait_for(lock, std::chrono::milliseconds(50),
+                        [&pending]{ return pending == 0; })) {
+      if (!stop) {
+        lock.unlock();
+        if (!onWait())
+          stop = true;
+        lock.lock();
+      }
+    }
+  }
+
+  group.wait();
+}
+
+} // namespace app
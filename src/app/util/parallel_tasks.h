@@ -0,0 +1,30 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_UTIL_PARALLEL_TASKS_H_INCLUDED
+#define APP_UTIL_PARALLEL_TASKS_H_INCLUDED
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+namespace app {
+
+  // Runs "ntasks" copies of "task" in the doc::TaskGroup scheduler
+  // and waits for them. "onWait" is called periodically from the
+  // calling thread (to report progress), and it can return false to
+  // set the "stop" flag given to the tasks (e.g. when the user
+  // cancels the process). Exceptions thrown by tasks are re-thrown in
+  // the calling thread. As the calling thread doesn't execute tasks
+  // while it waits, this must not be called from a scheduler task.
+  void run_parallel_tasks(
+    const int ntasks,
+    const std::function<void(const std::atomic<bool>& stop)>& task,
+    const std::function<bool()>& onWait);
+
+} // namespace app
+
+#endif
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (c) 2019-2021  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -10,6 +10,7 @@
 
 #include "doc/algorithm/resize_image.h"
 #include "doc/color.h"
+#include "doc/image_ref.h"
 #include "gfx/point.h"
 #include "gfx/size.h"
 
@@ -30,11 +31,25 @@ namespace app {
     const doc::Palette* pal,
     const doc::RgbMap* rgbmap);
 
+  // Returns a resized version of the cel image (the cel isn't
+  // modified). It can be called from several threads at the same
+  // time for different cels if each thread uses its own "rgbmap".
+  doc::ImageRef create_resized_cel_image(
+    const doc::Cel* cel,
+    const gfx::SizeF& scale,
+    const doc::algorithm::ResizeMethod method,
+    const doc::RgbMap* rgbmap);
+
+  // Resizes the cel image (or the cel bounds for reference layers)
+  // adding the commands to "tx". If "newImage" is specified, it's
+  // used as the already resized image (from
+  // create_resized_cel_image()).
   void resize_cel_image(
     Tx& tx, doc::Cel* cel,
     const gfx::SizeF& scale,
     const doc::algorithm::ResizeMethod method,
-    const gfx::PointF& pivot);
+    const gfx::PointF& pivot,
+    doc::ImageRef newImage = doc::ImageRef());
 
 } // namespace app
 
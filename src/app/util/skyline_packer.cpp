@@ -0,0 +1,304 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/util/skyline_packer.h"
+
+#include "base/debug.h"
+#include "base/time.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace app {
+
+namespace {
+
+// A horizontal segment of the skyline (the top of the already packed
+// rectangles).
+struct Node {
+  int x, y, w;
+};
+
+} // anonymous namespace
+
+SkylinePacker::SkylinePacker(const int borderPadding,
+                             const int shapePadding)
+  : m_borderPadding(borderPadding)
+  , m_shapePadding(shapePadding)
+{
+}
+
+void SkylinePacker::add(const gfx::Size& size)
+{
+  const int i = int(m_rects.size());
+  m_rects.push_back(gfx::Rect(size));
+
+  // Keep the packing order sorted by height/width (the stable
+  // insertion makes the result deterministic)
+  auto it = std::upper_bound(
+    m_order.begin(), m_order.end(), i,
+    [this](const int a, const int b){
+      const gfx::Rect& ra = m_rects[a];
+      const gfx::Rect& rb = m_rects[b];
+      if (ra.h != rb.h)
+        return ra.h > rb.h;
+      return ra.w > rb.w;
+    });
+  m_order.insert(it, i);
+}
+
+gfx::Size SkylinePacker::bestFit(base::task_token& token,
+                                 const int fixedWidth,
+                                 const int fixedHeight,
+                                 const int timeBudgetMsecs)
+{
+  const int border2 = 2*m_borderPadding;
+  if (m_rects.empty())
+    return gfx::Size(std::max(1, fixedWidth > 0 ? fixedWidth: border2),
+                     std::max(1, fixedHeight > 0 ? fixedHeight: border2));
+
+  if (fixedWidth > 0 && fixedHeight > 0) {
+    pack(gfx::Size(fixedWidth, fixedHeight), token);
+    return gfx::Size(fixedWidth, fixedHeight);
+  }
+
+  Rects rects;
+  if (fixedWidth > 0) {
+    const int h = packWithWidth(fixedWidth, 0, rects);
+    m_rects = rects;
+    return gfx::Size(fixedWidth, std::max(1, h - m_shapePadding + border2));
+  }
+
+  int maxWidth = 0;
+  int sumWidth = 0;
+  double area = 0.0;
+  for (const gfx::Rect& rc : m_rects) {
+    maxWidth = std::max(maxWidth, rc.w);
+    sumWidth += rc.w + m_shapePadding;
+    area += double(rc.w + m_shapePadding) * double(rc.h + m_shapePadding);
+  }
+  const int minTextureWidth = maxWidth + border2;
+  const int maxTextureWidth = std::max(minTextureWidth, sumWidth + border2);
+
+  // With a fixed height we look for the narrowest texture where all
+  // rectangles fit.
+  if (fixedHeight > 0) {
+    int lo = minTextureWidth;
+    int hi = maxTextureWidth;
+    Rects best;
+    if (packWithWidth(hi, fixedHeight, best) < 0) {
+      // They don't fit, use the widest texture anyway
+      packWithWidth(hi, 0, best);
+    }
+    else {
+      while (lo < hi && !token.canceled()) {
+        const int mid = lo + (hi - lo) / 2;
+        if (packWithWidth(mid, fixedHeight, rects) >= 0) {
+          hi = mid;
+          best = rects;
+        }
+        else
+          lo = mid+1;
+      }
+    }
+    m_rects = best;
+    return gfx::Size(hi, fixedHeight);
+  }
+
+  // Try several widths around the square root of the total area
+  // (to get square-ish textures) and keep the one with the smallest
+  // texture area.
+  const base::tick_t startTick = base::current_tick();
+  const int side = int(std::ceil(std::sqrt(area))) + border2;
+  const int fromWidth = std::clamp(side*3/4, minTextureWidth, maxTextureWidth);
+  const int toWidth = std::clamp(side*3/2, minTextureWidth, maxTextureWidth);
+  const int kSteps = 32;
+
+  Rects best;
+  gfx::Size bestSize;
+  double bestArea = 0.0;
+  int prevWidth = -1;
+  for (int step=0; step<=kSteps; ++step) {
+    if (token.canceled())
+      break;
+
+    // Start from the square width (the most probable best solution)
+    // in case that we run out of time.
+    const int k = (step == 0 ? kSteps/3: (step <= kSteps/3 ? step-1: step));
+    const int width = fromWidth + (toWidth - fromWidth) * k / kSteps;
+    if (width == prevWidth)
+      continue;
+    prevWidth = width;
+
+    const int h = packWithWidth(width, 0, rects);
+    if (h < 0)
+      continue;
+
+    // Use the real width of the packed rectangles
+    int usedWidth = 0;
+    for (const gfx::Rect& rc : rects)
+      usedWidth = std::max(usedWidth, rc.x2());
+
+    const gfx::Size size(usedWidth + m_borderPadding,
+                         std::max(1, h - m_shapePadding + border2));
+    const double a = double(size.w) * double(size.h);
+    if (best.empty() ||
+        a < bestArea ||
+        (a == bestArea && std::max(size.w, size.h) < std::max(bestSize.w, bestSize.h))) {
+      best = rects;
+      bestSize = size;
+      bestArea = a;
+    }
+
+    token.set_progress(float(step) / kSteps);
+    if (base::current_tick() - startTick > base::tick_t(timeBudgetMsecs))
+      break;
+  }
+
+  if (best.empty()) {
+    packWithWidth(maxTextureWidth, 0, best);
+    bestSize = gfx::Size(maxTextureWidth, 1);
+    for (const gfx::Rect& rc : best)
+      bestSize.h = std::max(bestSize.h, rc.y2() + m_borderPadding);
+  }
+
+  m_rects = best;
+  return bestSize;
+}
+
+bool SkylinePacker::pack(const gfx::Size& size,
+                         base::task_token& token)
+{
+  Rects rects;
+  if (packWithWidth(size.w, size.h, rects) >= 0) {
+    m_rects = rects;
+    return true;
+  }
+
+  // Rectangles that don't fit in the height are placed at the origin
+  packWithWidth(size.w, 0, rects);
+  for (gfx::Rect& rc : rects) {
+    if (rc.x2() > size.w - m_borderPadding ||
+        rc.y2() > size.h - m_borderPadding) {
+      rc.setOrigin(gfx::Point(m_borderPadding, m_borderPadding));
+    }
+  }
+  m_rects = rects;
+  return false;
+}
+
+int SkylinePacker::packWithWidth(const int width,
+                                 const int maxHeight,
+                                 Rects& output) const
+{
+  // Each rectangle uses its size + the shape padding, so the
+  // available space includes the shape padding of the last
+  // row/column.
+  const int binW = width - 2*m_borderPadding + m_shapePadding;
+  const int binH = (maxHeight > 0 ? maxHeight - 2*m_borderPadding + m_shapePadding:
+                                    INT_MAX);
+  if (binW <= 0 || binH <= 0)
+    return -1;
+
+  std::vector<Node> skyline;
+  skyline.push_back(Node{ 0, 0, binW });
+
+  int usedH = 0;
+  output = m_rects;
+  for (const int i : m_order) {
+    const int rw = m_rects[i].w + m_shapePadding;
+    const int rh = m_rects[i].h + m_shapePadding;
+
+    // Find the position where the rectangle top is the lowest
+    // (bottom-left heuristic)
+    int bestNode = -1;
+    int bestX = 0;
+    int bestY = 0;
+    int bestTop = INT_MAX;
+    for (int j=0; j<int(skyline.size()); ++j) {
+      const int x = skyline[j].x;
+      if (x + rw > binW)
+        break;
+
+      int y = 0;
+      int remaining = rw;
+      for (int k=j; remaining > 0; ++k) {
+        ASSERT(k < int(skyline.size()));
+        y = std::max(y, skyline[k].y);
+        remaining -= skyline[k].w;
+      }
+
+      const int top = y + rh;
+      if (top > binH)
+        continue;
+
+      if (top < bestTop || (top == bestTop && x < bestX)) {
+        bestNode = j;
+        bestX = x;
+        bestY = y;
+        bestTop = top;
+      }
+    }
+    if (bestNode < 0) {
+      if (maxHeight > 0)
+        return -1;
+
+      // The rectangle is wider than the texture, we put it in its
+      // own row (it will be clipped by the texture bounds).
+      int y = 0;
+      for (const Node& node : skyline)
+        y = std::max(y, node.y);
+      output[i] = gfx::Rect(m_borderPadding,
+                            m_borderPadding + y,
+                            m_rects[i].w, m_rects[i].h);
+      usedH = std::max(usedH, y + rh);
+      skyline.clear();
+      skyline.push_back(Node{ 0, y + rh, binW });
+      continue;
+    }
+
+    output[i] = gfx::Rect(m_borderPadding + bestX,
+                          m_borderPadding + bestY,
+                          m_rects[i].w, m_rects[i].h);
+    usedH = std::max(usedH, bestTop);
+
+    // Add the new segment and remove/shrink the covered ones
+    skyline.insert(skyline.begin()+bestNode, Node{ bestX, bestTop, rw });
+    const int x2 = bestX + rw;
+    for (int j=bestNode+1; j<int(skyline.size()); ) {
+      Node& node = skyline[j];
+      if (node.x >= x2)
+        break;
+      const int overlap = x2 - node.x;
+      if (overlap >= node.w) {
+        skyline.erase(skyline.begin()+j);
+      }
+      else {
+        node.x += overlap;
+        node.w -= overlap;
+        break;
+      }
+    }
+
+    // Merge contiguous segments with the same height
+    for (int j=0; j+1<int(skyline.size()); ) {
+      if (skyline[j].y == skyline[j+1].y) {
+        skyline[j].w += skyline[j+1].w;
+        skyline.erase(skyline.begin()+j+1);
+      }
+      else
+        ++j;
+    }
+  }
+  return usedH;
+}
+
+} // namespace app
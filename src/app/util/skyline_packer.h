@@ -0,0 +1,73 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_UTIL_SKYLINE_PACKER_H_INCLUDED
+#define APP_UTIL_SKYLINE_PACKER_H_INCLUDED
+#pragma once
+
+#include "base/task.h"
+#include "gfx/rect.h"
+#include "gfx/size.h"
+
+#include <vector>
+
+namespace app {
+
+  // Packs rectangles in a texture using the skyline bottom-left
+  // heuristic. It's a faster (and less tight) alternative to
+  // gfx::PackingRects with the same interface: each packing pass is
+  // O(n*s) (where "s" is the number of segments of the skyline)
+  // instead of subtracting regions of free space.
+  class SkylinePacker {
+  public:
+    typedef std::vector<gfx::Rect> Rects;
+    typedef Rects::const_iterator const_iterator;
+
+    SkylinePacker(const int borderPadding = 0,
+                  const int shapePadding = 0);
+
+    // Iterate over the packed rectangles (in the same order they
+    // were added).
+    const_iterator begin() const { return m_rects.begin(); }
+    const_iterator end() const { return m_rects.end(); }
+    int size() const { return int(m_rects.size()); }
+
+    void add(const gfx::Size& size);
+
+    // Returns the size of the smallest texture found where all the
+    // rectangles fit. The search over texture widths stops when it
+    // takes more than "timeBudgetMsecs" (keeping the best size found
+    // at that moment).
+    gfx::Size bestFit(base::task_token& token,
+                      const int fixedWidth = 0,
+                      const int fixedHeight = 0,
+                      const int timeBudgetMsecs = 1000);
+
+    // Packs the rectangles in a texture of the given size. Returns
+    // false if some rectangles didn't fit (they are placed at the
+    // texture origin).
+    bool pack(const gfx::Size& size,
+              base::task_token& token);
+
+  private:
+    // Packs all rectangles in "output" with the given texture width,
+    // returns the used height or -1 if they don't fit in
+    // "maxHeight".
+    int packWithWidth(const int width,
+                      const int maxHeight,
+                      Rects& output) const;
+
+    int m_borderPadding;
+    int m_shapePadding;
+    Rects m_rects;
+    // Indexes of m_rects sorted by height (higher first), which is
+    // the order used to pack them.
+    std::vector<int> m_order;
+  };
+
+} // namespace app
+
+#endif
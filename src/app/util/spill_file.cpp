@@ -0,0 +1,125 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/util/spill_file.h"
+
+#include "base/debug.h"
+#include "base/exception.h"
+#include "base/fs.h"
+#include "base/fstream_path.h"
+#include "base/log.h"
+#include "base/process.h"
+#include "fmt/format.h"
+#include "ver/info.h"
+
+#include "zlib.h"
+
+#include <atomic>
+#include <limits>
+
+namespace app {
+
+SpillFile::SpillFile()
+{
+}
+
+SpillFile::~SpillFile()
+{
+  if (m_file.is_open()) {
+    m_file.close();
+    try {
+      base::delete_file(m_filename);
+    }
+    catch (const std::exception& ex) {
+      LOG(ERROR, "SPILL: Cannot delete %s: %s\n",
+          m_filename.c_str(), ex.what());
+    }
+  }
+}
+
+SpillFile::Chunk SpillFile::write(const uint8_t* data, size_t size)
+{
+  if (size > std::numeric_limits<uint32_t>::max())
+    throw base::Exception("Too much data to write in a spill file");
+
+  if (!m_file.is_open())
+    open();
+
+  uLongf compressedSize = compressBound(uLong(size));
+  base::buffer compressed(compressedSize);
+  if (compress2(&compressed[0], &compressedSize,
+                data, uLong(size), Z_BEST_SPEED) != Z_OK)
+    throw base::Exception("Error compressing data for %s",
+                          m_filename.c_str());
+
+  Chunk chunk;
+  chunk.offset = m_fileSize;
+  chunk.size = uint32_t(compressedSize);
+  chunk.rawSize = uint32_t(size);
+
+  m_file.seekp(std::streamoff(chunk.offset));
+  m_file.write((const char*)&compressed[0], compressedSize);
+  m_file.flush();
+  if (!m_file.good()) {
+    m_file.clear();
+    throw base::Exception("Error writing data in %s",
+                          m_filename.c_str());
+  }
+
+  m_fileSize += compressedSize;
+  return chunk;
+}
+
+void SpillFile::read(const Chunk& chunk, base::buffer& output)
+{
+  ASSERT(m_file.is_open());
+  ASSERT(chunk.offset + chunk.size <= m_fileSize);
+
+  base::buffer compressed(chunk.size);
+  m_file.seekg(std::streamoff(chunk.offset));
+  m_file.read((char*)&compressed[0], chunk.size);
+  if (!m_file.good()) {
+    m_file.clear();
+    throw base::Exception("Error reading data from %s",
+                          m_filename.c_str());
+  }
+
+  output.resize(chunk.rawSize);
+  uLongf outputSize = chunk.rawSize;
+  if (uncompress(&output[0], &outputSize,
+                 &compressed[0], chunk.size) != Z_OK ||
+      outputSize != chunk.rawSize) {
+    throw base::Exception("Invalid data read from %s",
+                          m_filename.c_str());
+  }
+}
+
+void SpillFile::open()
+{
+  // Counter to use a different file for each SpillFile instance
+  static std::atomic<int> counter(0);
+
+  const std::string dir =
+    base::join_path(base::get_temp_path(), get_app_name());
+  base::make_all_directories(dir);
+
+  m_filename = base::join_path(
+    dir, fmt::format("spill-{}-{}.tmp",
+                     base::get_current_process_id(), ++counter));
+
+  m_file.open(FSTREAM_PATH(m_filename),
+              std::ios::in | std::ios::out |
+              std::ios::trunc | std::ios::binary);
+  if (!m_file.is_open())
+    throw base::Exception("Cannot create temporary file %s",
+                          m_filename.c_str());
+}
+
+} // namespace app
@@ -0,0 +1,62 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_UTIL_SPILL_FILE_H_INCLUDED
+#define APP_UTIL_SPILL_FILE_H_INCLUDED
+#pragma once
+
+#include "base/buffer.h"
+#include "base/disable_copying.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+namespace app {
+
+  // Temporary file used to move data out of memory (e.g. pixels of
+  // old undo states). Each chunk of data is compressed and appended
+  // at the end of the file. The file is created the first time some
+  // data is written, and deleted when the SpillFile is destroyed.
+  class SpillFile {
+  public:
+    // Chunks smaller than this are not worth moving to disk.
+    static constexpr size_t kMinChunkSize = 4096;
+
+    // Position of a chunk of data inside the file.
+    struct Chunk {
+      uint64_t offset = 0;
+      uint32_t size = 0;         // Compressed size in the file
+      uint32_t rawSize = 0;      // Original size of the data
+    };
+
+    SpillFile();
+    ~SpillFile();
+
+    const std::string& filename() const { return m_filename; }
+    uint64_t fileSize() const { return m_fileSize; }
+
+    // Compresses and appends the given data to the file. Throws a
+    // base::Exception if the data cannot be written.
+    Chunk write(const uint8_t* data, size_t size);
+
+    // Reads the given chunk from the file and uncompresses it in the
+    // output buffer. Throws a base::Exception in case of error.
+    void read(const Chunk& chunk, base::buffer& output);
+
+  private:
+    void open();
+
+    std::string m_filename;
+    std::fstream m_file;
+    uint64_t m_fileSize = 0;
+
+    DISABLE_COPYING(SpillFile);
+  };
+
+} // namespace app
+
+#endif
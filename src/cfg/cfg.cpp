@@ -1,5 +1,5 @@
 // Aseprite Config Library
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2014-2017  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -17,6 +17,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <list>
+#include <optional>
 
 #include "SimpleIni.h"
 
@@ -64,28 +65,42 @@ public:
     return m_ini.GetDoubleValue(section, name, defaultValue);
   }
 
+  bool isModified() const {
+    return m_modified;
+  }
+
   void setValue(const char* section, const char* name, const char* value) {
+    const auto oldValue = currentValue(section, name);
     m_ini.SetValue(section, name, value);
+    updateModified(section, name, oldValue);
   }
 
   void setBoolValue(const char* section, const char* name, bool value) {
+    const auto oldValue = currentValue(section, name);
     m_ini.SetBoolValue(section, name, value);
+    updateModified(section, name, oldValue);
   }
 
   void setIntValue(const char* section, const char* name, int value) {
+    const auto oldValue = currentValue(section, name);
     m_ini.SetLongValue(section, name, value);
+    updateModified(section, name, oldValue);
   }
 
   void setDoubleValue(const char* section, const char* name, double value) {
+    const auto oldValue = currentValue(section, name);
     m_ini.SetDoubleValue(section, name, value);
+    updateModified(section, name, oldValue);
   }
 
   void deleteValue(const char* section, const char* name) {
-    m_ini.Delete(section, name, true);
+    if (m_ini.Delete(section, name, true))
+      m_modified = true;
   }
 
   void deleteSection(const char* section) {
-    m_ini.Delete(section, nullptr, true);
+    if (m_ini.Delete(section, nullptr, true))
+      m_modified = true;
   }
 
   bool load(const std::string& filename) {
@@ -100,7 +115,11 @@ public:
             (int)err, m_filename.c_str());
         return false;
       }
+      m_modified = false;
     }
+    // A file that doesn't exist yet is created in the next save()
+    else
+      m_modified = true;
     return true;
   }
 
@@ -113,11 +132,44 @@ public:
             (int)err, m_filename.c_str());
       }
     }
+    m_modified = false;
+  }
+
+  std::string saveToString() {
+    std::string data;
+    SI_Error err = m_ini.Save(data);
+    if (err != SI_OK) {
+      LOG(ERROR, "CFG: Error %d saving configuration of %s\n",
+          (int)err, m_filename.c_str());
+    }
+    m_modified = false;
+    return data;
   }
 
 private:
+  // Returns the current value of the given key (if it exists) to
+  // know if a set*Value() call modifies it.
+  std::optional<std::string> currentValue(const char* section, const char* name) const {
+    if (m_modified)     // We don't need to compare anything
+      return std::nullopt;
+    const char* value = m_ini.GetValue(section, name, nullptr);
+    if (value)
+      return std::string(value);
+    return std::nullopt;
+  }
+
+  void updateModified(const char* section, const char* name,
+                      const std::optional<std::string>& oldValue) {
+    if (!m_modified &&
+        (!oldValue || *oldValue != m_ini.GetValue(section, name, ""))) {
+      m_modified = true;
+    }
+  }
+
   std::string m_filename;
   CSimpleIniA m_ini;
+  // True if some value was changed since the last load()/save()
+  bool m_modified = false;
 };
 
 CfgFile::CfgFile()
@@ -205,4 +257,14 @@ void CfgFile::save()
   m_impl->save();
 }
 
+std::string CfgFile::saveToString()
+{
+  return m_impl->saveToString();
+}
+
+bool CfgFile::isModified() const
+{
+  return m_impl->isModified();
+}
+
 } // namespace cfg
@@ -1,5 +1,5 @@
 // Aseprite Document IO Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -21,13 +21,16 @@
 #include "dio/file_interface.h"
 #include "dio/pixel_io.h"
 #include "doc/doc.h"
+#include "doc/task_scheduler.h"
 #include "doc/util.h"
 #include "fixmath/fixmath.h"
 #include "fmt/format.h"
 #include "gfx/color_space.h"
 #include "zlib.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <mutex>
 #include <vector>
 
 namespace dio {
@@ -90,6 +93,11 @@ bool AsepriteDecoder::decode()
 
   m_allLayers.clear();
 
+  // Decompress cels in background threads
+  if (delegate()->decodeCelsInParallel() &&
+      doc::task_scheduler_threads() > 1)
+    m_celsInflater = std::make_unique<CelsInflater>();
+
   int current_level = -1;
   AsepriteExternalFiles extFiles;
 
@@ -98,6 +106,9 @@ bool AsepriteDecoder::decode()
   if (nframes > 1 && delegate()->decodeOneFrame())
     nframes = 1;
 
+  // Skip pixel data (cel chunks are skipped using their chunk size)
+  const bool metadataOnly = delegate()->decodeMetadataOnly();
+
   // Read frame by frame to end-of-file
   for (doc::frame_t frame=0; frame<nframes; ++frame) {
     // Start frame position
@@ -170,6 +181,12 @@ bool AsepriteDecoder::decode()
           }
 
           case ASE_FILE_CHUNK_CEL: {
+            if (metadataOnly) {
+              last_cel = nullptr;
+              last_object_with_user_data = nullptr;
+              break;
+            }
+
             doc::Cel* cel =
               readCelChunk(sprite.get(), frame,
                            sprite->pixelFormat(), &header,
@@ -310,6 +327,11 @@ bool AsepriteDecoder::decode()
       break;
   }
 
+  if (m_celsInflater) {
+    m_celsInflater->wait(delegate());
+    m_celsInflater.reset();
+  }
+
   delegate()->onSprite(sprite.release());
   return true;
 }
@@ -700,12 +722,86 @@ void read_raw_image(FileInterface* f,
 // Compressed Image
 //////////////////////////////////////////////////////////////////////
 
-template<typename ImageTraits>
-void read_compressed_image_templ(FileInterface* f,
-                                 DecodeDelegate* delegate,
-                                 doc::Image* image,
-                                 const AsepriteHeader* header,
-                                 const size_t chunk_end)
+// Reads the compressed data of a chunk directly from the file.
+class FileCompressedInput {
+public:
+  FileCompressedInput(FileInterface* f,
+                      DecodeDelegate* delegate,
+                      const AsepriteHeader* header,
+                      const size_t chunk_end)
+    : m_f(f)
+    , m_delegate(delegate)
+    , m_header(header)
+    , m_chunkEnd(chunk_end) {
+  }
+
+  // Returns 0 when there is no more compressed data
+  size_t read(std::vector<uint8_t>& compressed) {
+    size_t input_bytes;
+
+    if (m_f->tell()+compressed.size() > m_chunkEnd) {
+      input_bytes = m_chunkEnd - m_f->tell(); // Remaining bytes
+      ASSERT(input_bytes < compressed.size());
+
+      if (input_bytes == 0)
+        return 0;               // Done, we consumed all chunk
+    }
+    else {
+      input_bytes = compressed.size();
+    }
+
+    size_t bytes_read = m_f->readBytes(&compressed[0], input_bytes);
+
+    // Error reading "input_bytes" bytes, broken file? chunk without
+    // enough compressed data?
+    if (bytes_read == 0) {
+      m_delegate->error(
+        fmt::format("Error reading {} bytes of compressed data",
+                    input_bytes));
+    }
+    return bytes_read;
+  }
+
+  void progress() {
+    m_delegate->progress((float)m_f->tell() / (float)m_header->size);
+  }
+
+private:
+  FileInterface* m_f;
+  DecodeDelegate* m_delegate;
+  const AsepriteHeader* m_header;
+  size_t m_chunkEnd;
+};
+
+// Reads compressed data that is already in memory (a memory mapped
+// file, or data loaded to inflate cels from background threads).
+class MemoryCompressedInput {
+public:
+  MemoryCompressedInput(const uint8_t* data, const size_t size)
+    : m_data(data)
+    , m_size(size) {
+  }
+
+  size_t read(std::vector<uint8_t>& compressed) {
+    const size_t n = std::min(compressed.size(), m_size - m_pos);
+    std::copy(m_data+m_pos,
+              m_data+m_pos+n,
+              compressed.begin());
+    m_pos += n;
+    return n;
+  }
+
+  void progress() { }
+
+private:
+  const uint8_t* m_data;
+  size_t m_size;
+  size_t m_pos = 0;
+};
+
+template<typename ImageTraits, typename Input>
+void read_compressed_image_templ(Input& input,
+                                 doc::Image* image)
 {
   PixelIO<ImageTraits> pixel_io;
   z_stream zstream;
@@ -726,29 +822,9 @@ void read_compressed_image_templ(FileInterface* f,
   int y = 0;
 
   while (true) {
-    size_t input_bytes;
-
-    if (f->tell()+compressed.size() > chunk_end) {
-      input_bytes = chunk_end - f->tell(); // Remaining bytes
-      ASSERT(input_bytes < compressed.size());
-
-      if (input_bytes == 0)
-        break;                  // Done, we consumed all chunk
-    }
-    else {
-      input_bytes = compressed.size();
-    }
-
-    size_t bytes_read = f->readBytes(&compressed[0], input_bytes);
-
-    // Error reading "input_bytes" bytes, broken file? chunk without
-    // enough compressed data?
-    if (bytes_read == 0) {
-      delegate->error(
-        fmt::format("Error reading {} bytes of compressed data",
-                    input_bytes));
+    size_t bytes_read = input.read(compressed);
+    if (bytes_read == 0)
       break;
-    }
 
     zstream.next_in = (Bytef*)&compressed[0];
     zstream.avail_in = bytes_read;
@@ -758,8 +834,10 @@ void read_compressed_image_templ(FileInterface* f,
       zstream.avail_out = uncompressed.size();
 
       err = inflate(&zstream, Z_NO_FLUSH);
-      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR) {
+        inflateEnd(&zstream);
         throw base::Exception("ZLib error %d in inflate().", err);
+      }
 
       size_t uncompressed_bytes = uncompressed.size() - zstream.avail_out;
       if (uncompressed_bytes > 0) {
@@ -793,7 +871,7 @@ void read_compressed_image_templ(FileInterface* f,
       }
     } while (zstream.avail_in != 0 && zstream.avail_out == 0);
 
-    delegate->progress((float)f->tell() / (float)header->size);
+    input.progress();
   }
 
   err = inflateEnd(&zstream);
@@ -801,6 +879,30 @@ void read_compressed_image_templ(FileInterface* f,
     throw base::Exception("ZLib error %d in inflateEnd().", err);
 }
 
+template<typename Input>
+void read_compressed_image_from_input(Input& input,
+                                      doc::Image* image)
+{
+  switch (image->pixelFormat()) {
+
+    case doc::IMAGE_RGB:
+      read_compressed_image_templ<doc::RgbTraits>(input, image);
+      break;
+
+    case doc::IMAGE_GRAYSCALE:
+      read_compressed_image_templ<doc::GrayscaleTraits>(input, image);
+      break;
+
+    case doc::IMAGE_INDEXED:
+      read_compressed_image_templ<doc::IndexedTraits>(input, image);
+      break;
+
+    case doc::IMAGE_TILEMAP:
+      read_compressed_image_templ<doc::TilemapTraits>(input, image);
+      break;
+  }
+}
+
 void read_compressed_image(FileInterface* f,
                            DecodeDelegate* delegate,
                            doc::Image* image,
@@ -809,27 +911,20 @@ void read_compressed_image(FileInterface* f,
 {
   // Try to read pixel data
   try {
-    switch (image->pixelFormat()) {
-
-      case doc::IMAGE_RGB:
-        read_compressed_image_templ<doc::RgbTraits>(
-          f, delegate, image, header, chunk_end);
-        break;
-
-      case doc::IMAGE_GRAYSCALE:
-        read_compressed_image_templ<doc::GrayscaleTraits>(
-          f, delegate, image, header, chunk_end);
-        break;
-
-      case doc::IMAGE_INDEXED:
-        read_compressed_image_templ<doc::IndexedTraits>(
-          f, delegate, image, header, chunk_end);
-        break;
-
-      case doc::IMAGE_TILEMAP:
-        read_compressed_image_templ<doc::TilemapTraits>(
-          f, delegate, image, header, chunk_end);
-        break;
+    const size_t pos = f->tell();
+    const uint8_t* data = (pos < chunk_end ? f->mappedData(pos, chunk_end - pos): nullptr);
+
+    // Inflate directly from the mapped file (without copying the
+    // compressed data in a temporary buffer)
+    if (data) {
+      MemoryCompressedInput input(data, chunk_end - pos);
+      read_compressed_image_from_input(input, image);
+      f->seek(chunk_end);
+      delegate->progress((float)chunk_end / (float)header->size);
+    }
+    else {
+      FileCompressedInput input(f, delegate, header, chunk_end);
+      read_compressed_image_from_input(input, image);
     }
   }
   // OK, in case of error we can show the problem, but continue
@@ -839,8 +934,118 @@ void read_compressed_image(FileInterface* f,
   }
 }
 
+// Returns the zlib level used to compress the given data, guessed
+// from the FLEVEL field of the zlib header. It's enough to know if the
+// data was compressed with the level used to save the file (FAST,
+// DEFAULT, or BEST).
+int zlib_compression_level(const uint8_t* data, const size_t size)
+{
+  if (size < 2)
+    return Z_DEFAULT_COMPRESSION;
+
+  switch ((data[1] >> 6) & 3) {
+    case 0: return Z_BEST_SPEED;
+    case 1: return 5;                    // Levels 2 to 5
+    case 3: return Z_BEST_COMPRESSION;   // Levels 7 to 9
+    default: return Z_DEFAULT_COMPRESSION;
+  }
+}
+
+// Inflates the given compressed data of a cel in the image, and
+// keeps a copy of the compressed data in the image if "cacheData" is
+// true (so the cel can be saved without re-compressing it).
+void inflate_cel_image(doc::Image* image,
+                       const uint8_t* data,
+                       const size_t size,
+                       const bool cacheData,
+                       DecodeDelegate* delegate)
+{
+  try {
+    MemoryCompressedInput input(data, size);
+    read_compressed_image_from_input(input, image);
+
+    if (cacheData)
+      image->setCompressedData(base::buffer(data, data+size),
+                               zlib_compression_level(data, size));
+  }
+  catch (const std::exception& e) {
+    delegate->error(e.what());
+  }
+}
+
 } // anonymous namespace
 
+//////////////////////////////////////////////////////////////////////
+// Cels Inflater
+//////////////////////////////////////////////////////////////////////
+
+// Inflates the pixels of compressed cels in background threads. The
+// compressed data is read by the decoder (in the main thread) and
+// the decompression is done in parallel while the decoder continues
+// reading the rest of the file.
+class AsepriteDecoder::CelsInflater {
+public:
+  ~CelsInflater() {
+    wait();
+  }
+
+  // Inflates the given compressed data, "owner" can be used to keep
+  // the data alive until the image is inflated (or nullptr if the
+  // data is in a memory mapped file).
+  void inflate(const doc::ImageRef& image,
+               const uint8_t* data,
+               const size_t size,
+               const bool cacheData,
+               const std::shared_ptr<std::vector<uint8_t>>& owner = nullptr) {
+    m_group.run(
+      [this, image, data, size, cacheData, owner]{
+        std::string error;
+        try {
+          MemoryCompressedInput input(data, size);
+          read_compressed_image_from_input(input, image.get());
+
+          if (cacheData)
+            image->setCompressedData(base::buffer(data, data+size),
+                                     zlib_compression_level(data, size));
+        }
+        catch (const std::exception& e) {
+          error = e.what();
+        }
+
+        if (!error.empty()) {
+          const std::lock_guard lock(m_mutex);
+          m_errors.push_back(error);
+        }
+      });
+  }
+
+  // Waits all the pending cels and reports the errors to the
+  // delegate (if it's specified).
+  void wait(DecodeDelegate* delegate = nullptr) {
+    m_group.wait();
+
+    const std::lock_guard lock(m_mutex);
+    if (delegate) {
+      for (const std::string& error : m_errors)
+        delegate->error(error);
+      m_errors.clear();
+    }
+  }
+
+private:
+  std::mutex m_mutex;
+  std::vector<std::string> m_errors;
+  doc::TaskGroup m_group;
+};
+
+AsepriteDecoder::AsepriteDecoder()
+{
+}
+
+AsepriteDecoder::~AsepriteDecoder()
+{
+}
+
 //////////////////////////////////////////////////////////////////////
 // Cel Chunk
 //////////////////////////////////////////////////////////////////////
@@ -913,6 +1118,10 @@ doc::Cel* AsepriteDecoder::readCelChunk(doc::Sprite* sprite,
           cel.reset(doc::Cel::MakeLink(frame, link));
         }
         else {
+          // We need the pixels of the linked cel to make a copy
+          if (m_celsInflater)
+            m_celsInflater->wait(delegate());
+
           cel.reset(doc::Cel::MakeCopy(frame, link));
           cel->setPosition(x, y);
           cel->setOpacity(opacity);
@@ -933,7 +1142,40 @@ doc::Cel* AsepriteDecoder::readCelChunk(doc::Sprite* sprite,
 
       if (w > 0 && h > 0) {
         doc::ImageRef image(doc::Image::create(pixelFormat, w, h));
-        read_compressed_image(f(), delegate(), image.get(), header, chunk_end);
+        const size_t pos = f()->tell();
+        bool cacheData = delegate()->cacheCompressedCels();
+        if ((m_celsInflater || cacheData) && pos < chunk_end) {
+          const size_t size = chunk_end - pos;
+          const uint8_t* data = f()->mappedData(pos, size);
+          std::shared_ptr<std::vector<uint8_t>> owner;
+          if (data) {
+            f()->seek(chunk_end);
+          }
+          else {
+            owner = std::make_shared<std::vector<uint8_t>>(size);
+            owner->resize(f()->readBytes(owner->data(), size));
+            data = owner->data();
+
+            // Don't cache incomplete data (broken file?)
+            if (owner->size() != size) {
+              delegate()->error(
+                fmt::format("Error reading {} bytes of compressed data", size));
+              cacheData = false;
+            }
+          }
+
+          if (m_celsInflater) {
+            m_celsInflater->inflate(image, data, (owner ? owner->size(): size),
+                                    cacheData, owner);
+          }
+          else {
+            inflate_cel_image(image.get(), data, (owner ? owner->size(): size),
+                              cacheData, delegate());
+          }
+        }
+        else {
+          read_compressed_image(f(), delegate(), image.get(), header, chunk_end);
+        }
 
         cel = std::make_unique<doc::Cel>(frame, image);
         cel->setPosition(x, y);
@@ -1136,7 +1378,7 @@ doc::Mask* AsepriteDecoder::readMaskChunk()
     for (u=0; u<(w+7)/8; u++) {
       byte = read8();
       for (c=0; c<8; c++)
-        doc::put_pixel(mask->bitmap(), u*8+c, v, byte & (1<<(7-c)));
+        doc::put_pixel(mask->editableBitmap(), u*8+c, v, byte & (1<<(7-c)));
     }
 
   return mask;
@@ -1306,7 +1548,8 @@ doc::Tileset* AsepriteDecoder::readTilesetChunk(
   }
 
   if (flags & ASE_TILESET_FLAG_EMBEDDED) {
-    if (ntiles > 0) {
+    // Skip the tiles data when we need the metadata only
+    if (ntiles > 0 && !delegate()->decodeMetadataOnly()) {
       const size_t dataSize = read32(); // Size of compressed data
       const size_t dataBeg = f()->tell();
       const size_t dataEnd = dataBeg+dataSize;
@@ -1335,7 +1578,8 @@ doc::Tileset* AsepriteDecoder::readTilesetChunk(
         doc::fix_old_tileset(tileset);
 
       if (!compressed.empty())
-        tileset->setCompressedData(compressed);
+        tileset->setCompressedData(
+          compressed, zlib_compression_level(&compressed[0], compressed.size()));
     }
     sprite->tilesets()->set(id, tileset);
   }
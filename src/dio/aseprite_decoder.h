@@ -1,5 +1,5 @@
 // Aseprite Document IO Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -18,6 +18,7 @@
 #include "doc/tileset.h"
 #include "doc/user_data.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -39,9 +40,14 @@ class AsepriteExternalFiles;
 
 class AsepriteDecoder : public Decoder {
 public:
+  AsepriteDecoder();
+  ~AsepriteDecoder();
+
   bool decode() override;
 
 private:
+  class CelsInflater;
+
   bool readHeader(AsepriteHeader* header);
   void readFrameHeader(AsepriteFrameHeader* frame_header);
   void readPadding(const int bytes);
@@ -76,6 +82,7 @@ private:
 
   doc::LayerList m_allLayers;
   std::vector<uint32_t> m_tilesetFlags;
+  std::unique_ptr<CelsInflater> m_celsInflater;
 };
 
 } // namespace dio
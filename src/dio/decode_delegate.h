@@ -1,5 +1,5 @@
 // Aseprite Document IO Library
-// Copyright (c) 2023 Igara Studio S.A.
+// Copyright (c) 2023-2024 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -38,6 +38,12 @@ public:
   // to generate a thumbnail)
   virtual bool decodeOneFrame() { return false; }
 
+  // Return true if you want to read just the sprite structure and
+  // metadata (layers, tags, slices, user data, etc.), skipping the
+  // pixels of cels and tilesets (e.g. useful to list the layers of
+  // a lot of files)
+  virtual bool decodeMetadataOnly() { return false; }
+
   // Default color for slices without user data
   virtual doc::color_t defaultSliceColor() {
     return doc::rgba(0, 0, 255, 255);
@@ -56,6 +62,18 @@ public:
   virtual bool cacheCompressedTilesets() const {
     return false;
   }
+
+  // Returns true if we want to cache the read compressed data of
+  // cels (so we can save them again without re-compressing).
+  virtual bool cacheCompressedCels() const {
+    return false;
+  }
+
+  // Returns true if the compressed cels can be decompressed in
+  // background threads while the rest of the file is read.
+  virtual bool decodeCelsInParallel() const {
+    return false;
+  }
 };
 
 } // namespace dio
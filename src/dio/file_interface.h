@@ -1,4 +1,5 @@
 // Aseprite Document IO Library
+// Copyright (c) 2024 Igara Studio S.A.
 // Copyright (c) 2017-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -11,6 +12,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <string>
 
 namespace dio {
 
@@ -34,6 +36,14 @@ public:
   // Writes one byte in the file (or do nothing if ok() = false)
   virtual void write8(uint8_t value) = 0;
 
+  // Returns a pointer to the "n" bytes starting at the given position
+  // if the file is mapped in memory, or nullptr if the bytes must be
+  // read with readBytes(). The pointer is valid while this
+  // FileInterface is alive.
+  virtual const uint8_t* mappedData(size_t absPos, size_t n) {
+    return nullptr;
+  }
+
 };
 
 class StdioFileInterface : public FileInterface {
@@ -50,6 +60,33 @@ private:
   bool m_ok;
 };
 
+// Read-only access to a file mapped in memory (mmap() or
+// MapViewOfFile()). If the file cannot be mapped isMapped() returns
+// false, and you should fallback to StdioFileInterface.
+class MappedFileInterface : public FileInterface {
+public:
+  MappedFileInterface(const std::string& filename);
+  ~MappedFileInterface();
+  bool isMapped() const { return m_data != nullptr; }
+  size_t size() const { return m_size; }
+  bool ok() const override;
+  size_t tell() override;
+  void seek(size_t absPos) override;
+  uint8_t read8() override;
+  size_t readBytes(uint8_t* buf, size_t n) override;
+  void write8(uint8_t value) override;
+  const uint8_t* mappedData(size_t absPos, size_t n) override;
+private:
+  const uint8_t* m_data;
+  size_t m_size;
+  size_t m_pos;
+  bool m_ok;
+#ifdef _WIN32
+  void* m_file;
+  void* m_mapping;
+#endif
+};
+
 } // namespace dio
 
 #endif
@@ -0,0 +1,155 @@
+// Aseprite Document IO Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "dio/file_interface.h"
+
+#include "base/string.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace dio {
+
+#ifdef _WIN32
+
+MappedFileInterface::MappedFileInterface(const std::string& filename)
+  : m_data(nullptr)
+  , m_size(0)
+  , m_pos(0)
+  , m_ok(false)
+  , m_file(INVALID_HANDLE_VALUE)
+  , m_mapping(nullptr)
+{
+  HANDLE file = CreateFileW(base::from_utf8(filename).c_str(),
+                            GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return;
+  m_file = file;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    return;
+
+  HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping)
+    return;
+  m_mapping = mapping;
+
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!data)
+    return;
+
+  m_data = (const uint8_t*)data;
+  m_size = size_t(size.QuadPart);
+  m_ok = true;
+}
+
+MappedFileInterface::~MappedFileInterface()
+{
+  if (m_data)
+    UnmapViewOfFile(m_data);
+  if (m_mapping)
+    CloseHandle((HANDLE)m_mapping);
+  if (m_file != INVALID_HANDLE_VALUE)
+    CloseHandle((HANDLE)m_file);
+}
+
+#else
+
+MappedFileInterface::MappedFileInterface(const std::string& filename)
+  : m_data(nullptr)
+  , m_size(0)
+  , m_pos(0)
+  , m_ok(false)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+
+  struct stat sb;
+  if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+    void* data = mmap(nullptr, size_t(sb.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      m_data = (const uint8_t*)data;
+      m_size = size_t(sb.st_size);
+      m_ok = true;
+    }
+  }
+
+  // The mapping is still valid after closing the file descriptor
+  close(fd);
+}
+
+MappedFileInterface::~MappedFileInterface()
+{
+  if (m_data)
+    munmap((void*)m_data, m_size);
+}
+
+#endif
+
+bool MappedFileInterface::ok() const
+{
+  return m_ok;
+}
+
+size_t MappedFileInterface::tell()
+{
+  return m_pos;
+}
+
+void MappedFileInterface::seek(size_t absPos)
+{
+  // Like fseek(), we can go beyond the end of the file, but the next
+  // read will fail.
+  m_pos = absPos;
+}
+
+uint8_t MappedFileInterface::read8()
+{
+  if (m_pos < m_size)
+    return m_data[m_pos++];
+
+  m_ok = false;
+  return 0;
+}
+
+size_t MappedFileInterface::readBytes(uint8_t* buf, size_t n)
+{
+  const size_t n2 = (m_pos < m_size ? std::min(n, m_size - m_pos): 0);
+  if (n2 > 0) {
+    std::memcpy(buf, m_data + m_pos, n2);
+    m_pos += n2;
+  }
+  if (n2 != n)
+    m_ok = false;
+  return n2;
+}
+
+void MappedFileInterface::write8(uint8_t value)
+{
+  // Read-only file
+  m_ok = false;
+}
+
+const uint8_t* MappedFileInterface::mappedData(size_t absPos, size_t n)
+{
+  if (absPos > m_size || n > m_size - absPos)
+    return nullptr;
+  return m_data + absPos;
+}
+
+} // namespace dio
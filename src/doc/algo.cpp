@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2022 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -22,296 +22,42 @@ namespace doc {
 
 void algo_line_perfect(int x1, int y1, int x2, int y2, void* data, AlgoPixel proc)
 {
-  bool yaxis;
-
-  // If the height if the line is bigger than the width, we'll iterate
-  // over the y-axis.
-  if (ABS(y2-y1) > ABS(x2-x1)) {
-    std::swap(x1, y1);
-    std::swap(x2, y2);
-    yaxis = true;
-  }
-  else
-    yaxis = false;
-
-  const int w = ABS(x2-x1)+1;
-  const int h = ABS(y2-y1)+1;
-  const int dx = SGN(x2-x1);
-  const int dy = SGN(y2-y1);
-
-  int e = 0;
-  int y = y1;
-
-  // Move x2 one extra pixel to the dx direction so we can use
-  // operator!=() instead of operator<(). Here I prefer operator!=()
-  // instead of swapping x1 with x2 so the error always start from 0
-  // in the origin (x1,y1).
-  x2 += dx;
-
-  for (int x=x1; x!=x2; x+=dx) {
-    if (yaxis)
-      proc(y, x, data);
-    else
-      proc(x, y, data);
-
-    // The error advances "h/w" per each "x" step. As we're using a
-    // integer value for "e", we use "w" as the unit.
-    e += h;
-    if (e >= w) {
-      y += dy;
-      e -= w;
-    }
-  }
+  algo_line_perfect(x1, y1, x2, y2,
+                    [data, proc](int x, int y){ proc(x, y, data); });
 }
 
-// Special version of the perfect line algorithm specially done for
-// kLineBrushType so the whole line looks continuous without holes.
-//
-// TOOD in a future we should convert lines into scanlines and render
-//      scanlines instead of drawing the brush on each pixel, that
-//      would fix all cases
 void algo_line_perfect_with_fix_for_line_brush(int x1, int y1, int x2, int y2, void* data, AlgoPixel proc)
 {
-  bool yaxis;
-
-  if (ABS(y2-y1) > ABS(x2-x1)) {
-    std::swap(x1, y1);
-    std::swap(x2, y2);
-    yaxis = true;
-  }
-  else
-    yaxis = false;
-
-  const int w = ABS(x2-x1)+1;
-  const int h = ABS(y2-y1)+1;
-  const int dx = SGN(x2-x1);
-  const int dy = SGN(y2-y1);
-
-  int e = 0;
-  int y = y1;
-
-  x2 += dx;
-
-  for (int x=x1; x!=x2; x+=dx) {
-    if (yaxis)
-      proc(y, x, data);
-    else
-      proc(x, y, data);
-
-    e += h;
-    if (e >= w) {
-      y += dy;
-      e -= w;
-      if (x+dx != x2) {
-        if (yaxis)
-          proc(y, x, data);
-        else
-          proc(x, y, data);
-      }
-    }
-  }
+  algo_line_perfect_with_fix_for_line_brush(x1, y1, x2, y2,
+                                            [data, proc](int x, int y){ proc(x, y, data); });
 }
 
-// Line code based on Alois Zingl work released under the
-// MIT license http://members.chello.at/easyfilter/bresenham.html
 void algo_line_continuous(int x0, int y0, int x1, int y1, void* data, AlgoPixel proc)
 {
-  int dx =  ABS(x1-x0), sx = (x0 < x1 ? 1: -1);
-  int dy = -ABS(y1-y0), sy = (y0 < y1 ? 1: -1);
-  int err = dx+dy, e2;                                  // error value e_xy
-
-  for (;;) {
-    proc(x0, y0, data);
-    e2 = 2*err;
-    if (e2 >= dy) {                                       // e_xy+e_x > 0
-      if (x0 == x1)
-        break;
-      err += dy;
-      x0 += sx;
-    }
-    if (e2 <= dx) {                                       // e_xy+e_y < 0
-      if (y0 == y1)
-        break;
-      err += dx;
-      y0 += sy;
-    }
-  }
+  algo_line_continuous(x0, y0, x1, y1,
+                       [data, proc](int x, int y){ proc(x, y, data); });
 }
 
-// Special version of the continuous line algorithm specially done for
-// kLineBrushType so the whole line looks continuous without holes.
 void algo_line_continuous_with_fix_for_line_brush(int x0, int y0, int x1, int y1, void* data, AlgoPixel proc)
 {
-  int dx =  ABS(x1-x0), sx = (x0 < x1 ? 1: -1);
-  int dy = -ABS(y1-y0), sy = (y0 < y1 ? 1: -1);
-  int err = dx+dy, e2;                                  // error value e_xy
-  bool x_changed;
-
-  for (;;) {
-    x_changed = false;
-
-    proc(x0, y0, data);
-    e2 = 2*err;
-    if (e2 >= dy) {                                       // e_xy+e_x > 0
-      if (x0 == x1)
-        break;
-      err += dy;
-      x0 += sx;
-      x_changed = true;
-    }
-    if (e2 <= dx) {                                       // e_xy+e_y < 0
-      if (y0 == y1)
-        break;
-      err += dx;
-      if (x_changed)
-        proc(x0, y0, data);
-      y0 += sy;
-    }
-  }
+  algo_line_continuous_with_fix_for_line_brush(x0, y0, x1, y1,
+                                               [data, proc](int x, int y){ proc(x, y, data); });
 }
 
-static int adjust_ellipse_args(int& x0, int& y0, int& x1, int& y1,
-                               int& hPixels, int& vPixels)
-{
-  // hPixels : straight horizontal pixels added to mid region of the ellipse.
-  hPixels = std::max(hPixels, 0);
-  // vPixels : straight vertical pixels added to mid region of the ellipse.
-  vPixels = std::max(vPixels, 0);
-
-  // Conditioning swapped points
-  if (x0 > x1)
-    std::swap(x0, x1);
-  if (y0 > y1)
-    std::swap(y0, y1);
-  int w = x1 - x0 + 1;
-  int h = y1 - y0 + 1;
-
-  // hDiameter is the horizontal diameter of a circunference
-  // without the addition of straight pixels.
-  int hDiameter = w - hPixels;
-  // vDiameter is the vertical diameter of a circunference
-  // without the addition of straight pixels.
-  int vDiameter = h - vPixels;
-
-  // Manual adjustment
-  if (w == 8 || w == 12 || w == 22)
-    hPixels++;
-  if (h == 8 || h == 12 || h == 22)
-    vPixels++;
-
-  hPixels = (hDiameter > 5 ? hPixels : 0);
-  vPixels = (vDiameter > 5 ? vPixels : 0);
-
-  if ((hDiameter % 2 == 0) && (hDiameter > 5))
-    hPixels--;
-  if ((vDiameter % 2 == 0) && (vDiameter > 5))
-    vPixels--;
-
-  x1 -= hPixels;
-  y1 -= vPixels;
-
-  return h;
-}
-
-// Ellipse code based on Alois Zingl work released under the MIT
-// license http://members.chello.at/easyfilter/bresenham.html
-//
-// Adapted for Aseprite by David Capello
-
 void algo_ellipse(int x0, int y0, int x1, int y1,
                   int hPixels, int vPixels,
                   void* data, AlgoPixel proc)
 {
-  int h = adjust_ellipse_args(x0, y0, x1, y1, hPixels, vPixels);
-
-  long a = abs(x1-x0);
-  long b = abs(y1-y0);                // diameter
-  long b1 = b&1;
-  double dx = 4*(1.0-a)*b*b;          // error increment
-  double dy = 4*(b1+1)*a*a;           // error increment
-  double err = dx + dy + b1*a*a;      // error of 1.step
-  double e2;
-
-  y0 += (b+1)/2;
-  y1 = y0-b1;           // starting pixel
-  a = 8*a*a;
-  b1 = 8*b*b;
-
-  int initialY0 = y0;
-  int initialY1 = y1;
-  int initialX0 = x0;
-  int initialX1 = x1 + hPixels;
-  do {
-    proc(x1 + hPixels, y0 + vPixels, data);                //   I. Quadrant
-    proc(x0, y0 + vPixels, data);                          //  II. Quadrant
-    proc(x0, y1, data);                                    // III. Quadrant
-    proc(x1 + hPixels, y1, data);                          //  IV. Quadrant
-
-    e2 = 2*err;
-    if (e2 <= dy) { y0++; y1--; err += dy += a; }                 // y step
-    if (e2 >= dx || 2*err > dy) { x0++; x1--; err += dx += b1; }  // x step
-  } while (x0 <= x1);
-
-  while (y0 + vPixels - y1 + 1 <= h) {          // too early stop of flat ellipses a=1
-    proc(x0 - 1, y0 + vPixels, data);          // -> finish tip of ellipse
-    proc(x1 + 1 + hPixels, y0++ + vPixels, data);
-    proc(x0 - 1, y1, data);
-    proc(x1 + 1 + hPixels, y1--, data);
-  }
-
-  // Extra horizontal straight pixels
-  if (hPixels > 0) {
-    for (int i = x0; i < x1 + hPixels + 1; i++) {
-      proc(i, y1 + 1, data);
-      proc(i, y0 + vPixels - 1, data);
-    }
-  }
-  // Extra vertical straight pixels
-  if (vPixels > 0) {
-    for (int i = initialY1 + 1; i < initialY0 + vPixels; i++) {
-      proc(initialX0, i, data);
-      proc(initialX1, i, data);
-    }
-  }
+  algo_ellipse(x0, y0, x1, y1, hPixels, vPixels,
+               [data, proc](int x, int y){ proc(x, y, data); });
 }
 
 void algo_ellipsefill(int x0, int y0, int x1, int y1,
                       int hPixels, int vPixels,
                       void* data, AlgoHLine proc)
 {
-  int h = adjust_ellipse_args(x0, y0, x1, y1, hPixels, vPixels);
-
-  long a = abs(x1-x0), b = abs(y1-y0), b1 = b&1;          // diameter
-  double dx = 4*(1.0-a)*b*b, dy = 4*(b1+1)*a*a;           // error increment
-  double err = dx+dy+b1*a*a, e2;                          // error of 1.step
-
-  y0 += (b+1)/2; y1 = y0-b1;                              // starting pixel
-  a = 8*a*a; b1 = 8*b*b;
-
-  int initialY0 = y0;
-  int initialY1 = y1;
-  int initialX0 = x0;
-  int initialX1 = x1 + hPixels;
-
-  do {
-    proc(x0, y0 + vPixels, x1 + hPixels, data);
-    proc(x0, y1, x1 + hPixels, data);
-    e2 = 2*err;
-    if (e2 <= dy) { y0++; y1--; err += dy += a; }                 // y step
-    if (e2 >= dx || 2*err > dy) { x0++; x1--; err += dx += b1; }  // x step
-  } while (x0 <= x1);
-
-  while (y0 + vPixels - y1 + 1 < h) {             // too early stop of flat ellipses a=1
-    proc(x0-1, ++y0 + vPixels, x0-1, data);       // -> finish tip of ellipse
-    proc(x1+1 + hPixels, y0 + vPixels, x1+1 + hPixels, data);
-    proc(x0-1, --y1, x0-1, data);
-    proc(x1+1 + hPixels, y1, x1+1 + hPixels, data);
-  }
-
-  if (vPixels > 0) {
-    for (int i = initialY1 + 1; i < initialY0 + vPixels; i++)
-      proc(initialX0, i, initialX1, data);
-  }
+  algo_ellipsefill(x0, y0, x1, y1, hPixels, vPixels,
+                   [data, proc](int a, int y, int b){ proc(a, y, b, data); });
 }
 
 static void draw_quad_rational_bezier_seg(int x0, int y0,
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2023 Igara Studio S.A.
+// Copyright (c) 2023-2024 Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -11,6 +11,7 @@
 #include "doc/algorithm/flip_image.h"
 
 #include "doc/image.h"
+#include "doc/primitives.h"
 
 #include <benchmark/benchmark.h>
 
@@ -38,6 +39,20 @@ void BM_FlipRawPtr(benchmark::State& state) {
   }
 }
 
+void BM_Rotate(benchmark::State& state) {
+  const auto pf = (PixelFormat)state.range(0);
+  const int w = state.range(1);
+  const int h = state.range(2);
+  const int angle = state.range(3);
+  std::unique_ptr<Image> src(Image::create(pf, w, h));
+  std::unique_ptr<Image> dst(Image::create(pf,
+                                           angle == 180 ? w: h,
+                                           angle == 180 ? h: w));
+  while (state.KeepRunning()) {
+    rotate_image(src.get(), dst.get(), angle);
+  }
+}
+
 #define DEFARGS()                                                       \
   ->Args({ IMAGE_RGB, 8192, 8192, doc::algorithm::FlipHorizontal })     \
   ->Args({ IMAGE_RGB, 8192, 8192, doc::algorithm::FlipVertical })       \
@@ -48,7 +63,9 @@ void BM_FlipRawPtr(benchmark::State& state) {
   ->Args({ IMAGE_BITMAP, 8192, 8192, doc::algorithm::FlipHorizontal })  \
   ->Args({ IMAGE_BITMAP, 8192, 8192, doc::algorithm::FlipVertical })    \
   ->Args({ IMAGE_TILEMAP, 8192, 8192, doc::algorithm::FlipHorizontal }) \
-  ->Args({ IMAGE_TILEMAP, 8192, 8192, doc::algorithm::FlipVertical })
+  ->Args({ IMAGE_TILEMAP, 8192, 8192, doc::algorithm::FlipVertical })   \
+  ->Args({ IMAGE_RGB, 4096, 4096, doc::algorithm::FlipDiagonal })       \
+  ->Args({ IMAGE_INDEXED, 4096, 4096, doc::algorithm::FlipDiagonal })
 
 BENCHMARK(BM_FlipSlow)
   DEFARGS()
@@ -60,4 +77,14 @@ BENCHMARK(BM_FlipRawPtr)
   ->Unit(benchmark::kMicrosecond)
   ->UseRealTime();
 
+BENCHMARK(BM_Rotate)
+  ->Args({ IMAGE_RGB, 8192, 8192, 90 })
+  ->Args({ IMAGE_RGB, 8192, 8192, -90 })
+  ->Args({ IMAGE_RGB, 8192, 8192, 180 })
+  ->Args({ IMAGE_GRAYSCALE, 8192, 8192, 90 })
+  ->Args({ IMAGE_INDEXED, 8192, 8192, 90 })
+  ->Args({ IMAGE_BITMAP, 8192, 8192, 90 })
+  ->Unit(benchmark::kMicrosecond)
+  ->UseRealTime();
+
 BENCHMARK_MAIN();
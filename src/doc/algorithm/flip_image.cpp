@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2023 Igara Studio S.A.
+// Copyright (c) 2023-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -11,6 +11,7 @@
 
 #include "doc/algorithm/flip_image.h"
 
+#include "doc/algorithm/parallel_bands.h"
 #include "doc/dispatch.h"
 #include "doc/image.h"
 #include "doc/image_impl.h"
@@ -58,13 +59,13 @@ void flip_image_with_put_pixel_fast_templ(Image* image, const gfx::Rect& bounds,
     }
 
     case FlipDiagonal: {
-      int d = std::min(bounds.w, bounds.h);
-      for (int y=bounds.y; y<bounds.y+d; ++y) {
-        for (int x=bounds.x+y; x<bounds.x+d; ++x) {
-          uint32_t c1 = get_pixel_fast<ImageTraits>(image, x, y);
-          uint32_t c2 = get_pixel_fast<ImageTraits>(image, y, x);
-          put_pixel_fast<ImageTraits>(image, x, y, c2);
-          put_pixel_fast<ImageTraits>(image, y, x, c1);
+      const int d = std::min(bounds.w, bounds.h);
+      for (int v=0; v<d; ++v) {
+        for (int u=v+1; u<d; ++u) {
+          uint32_t c1 = get_pixel_fast<ImageTraits>(image, bounds.x+u, bounds.y+v);
+          uint32_t c2 = get_pixel_fast<ImageTraits>(image, bounds.x+v, bounds.y+u);
+          put_pixel_fast<ImageTraits>(image, bounds.x+u, bounds.y+v, c2);
+          put_pixel_fast<ImageTraits>(image, bounds.x+v, bounds.y+u, c1);
         }
       }
       break;
@@ -80,34 +81,47 @@ void flip_image_with_rawptr_templ(Image* image, const gfx::Rect& bounds, FlipTyp
   switch (flipType) {
 
     case FlipHorizontal:
-      for (int y=bounds.y; y<bounds.y2(); ++y) {
-        const int n = bounds.w/2;
-        auto l = (address_t)image->getPixelAddress(bounds.x, y);
-        auto r = (address_t)image->getPixelAddress(bounds.x2()-1, y);
-
-        for (int x=0; x<n; ++x, ++l, --r) {
-          std::swap(*l, *r);
+      // Each band flips different rows
+      for_each_band(bounds.h, [=](const int y0, const int h){
+        for (int y=bounds.y+y0; y<bounds.y+y0+h; ++y) {
+          auto l = (address_t)image->getPixelAddress(bounds.x, y);
+          std::reverse(l, l+bounds.w);
         }
-      }
+      });
       break;
 
-    case FlipVertical: {
-      const int n = bounds.w;
-      int v = bounds.y2()-1;
-      for (int y=bounds.y; y<bounds.y+bounds.h/2; ++y, --v) {
-        auto t = (address_t)image->getPixelAddress(bounds.x, y);
-        auto b = (address_t)image->getPixelAddress(bounds.x, v);
+    case FlipVertical:
+      // Each band swaps different pairs of rows
+      for_each_band(bounds.h/2, [=](const int y0, const int h){
+        for (int y=bounds.y+y0; y<bounds.y+y0+h; ++y) {
+          auto t = (address_t)image->getPixelAddress(bounds.x, y);
+          auto b = (address_t)image->getPixelAddress(bounds.x, bounds.y2()-1-(y-bounds.y));
+          std::swap_ranges(t, t+bounds.w, b);
+        }
+      });
+      break;
 
-        for (int x=0; x<n; ++x, ++t, ++b) {
-          std::swap(*t, *b);
+    case FlipDiagonal: {
+      // Transpose the square in tiles of kTileSize x kTileSize so
+      // the rows of both tiles that are swapped are kept in the cache
+      constexpr int kTileSize = 32;
+      const int d = std::min(bounds.w, bounds.h);
+      std::vector<address_t> rows(d);
+      for (int v=0; v<d; ++v)
+        rows[v] = (address_t)image->getPixelAddress(bounds.x, bounds.y+v);
+
+      for (int tv=0; tv<d; tv+=kTileSize) {
+        const int tv2 = std::min(tv+kTileSize, d);
+        for (int tu=tv; tu<d; tu+=kTileSize) {
+          const int tu2 = std::min(tu+kTileSize, d);
+          for (int v=tv; v<tv2; ++v) {
+            for (int u=std::max(tu, v+1); u<tu2; ++u)
+              std::swap(rows[v][u], rows[u][v]);
+          }
         }
       }
       break;
     }
-
-    case FlipDiagonal:
-      flip_image_with_put_pixel_fast_templ<ImageTraits>(image, bounds, flipType);
-      break;
   }
 }
 
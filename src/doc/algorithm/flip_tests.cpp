@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2023  Igara Studio S.A.
+// Copyright (c) 2023-2024  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -32,7 +32,8 @@ TEST(Flip, Image)
         ASSERT_TRUE(is_same_image(b.get(), c.get()));
 
         for (auto ft : { doc::algorithm::FlipHorizontal,
-                         doc::algorithm::FlipVertical }) {
+                         doc::algorithm::FlipVertical,
+                         doc::algorithm::FlipDiagonal }) {
           doc::algorithm::flip_image(b.get(), b->bounds(), ft);
           doc::algorithm::flip_image_slow(c.get(), c->bounds(), ft);
 
@@ -51,6 +52,39 @@ TEST(Flip, Image)
   }
 }
 
+TEST(Flip, ImageBounds)
+{
+  for (auto pf : { IMAGE_RGB, IMAGE_INDEXED, IMAGE_BITMAP }) {
+    ImageRef a(Image::create(pf, 300, 250));
+    doc::algorithm::random_image(a.get());
+
+    for (const Rect bounds : { Rect(3, 5, 70, 90), Rect(100, 20, 150, 200) }) {
+      for (auto ft : { doc::algorithm::FlipHorizontal,
+                       doc::algorithm::FlipVertical,
+                       doc::algorithm::FlipDiagonal }) {
+        ImageRef b(Image::createCopy(a.get()));
+        ImageRef c(Image::createCopy(a.get()));
+        doc::algorithm::flip_image(b.get(), bounds, ft);
+        doc::algorithm::flip_image_slow(c.get(), bounds, ft);
+        ASSERT_TRUE(is_same_image(b.get(), c.get()))
+          << "Pixel format=" << pf << " Flip type=" << ft;
+
+        // Pixels outside the bounds aren't modified
+        const int u = bounds.x + bounds.w/2 + 1;
+        const int v = bounds.y + bounds.h/2;
+        if (ft != doc::algorithm::FlipDiagonal) {
+          EXPECT_EQ(get_pixel(a.get(), u, v),
+                    get_pixel(b.get(),
+                              ft == doc::algorithm::FlipHorizontal ? bounds.x2()-1-(u-bounds.x): u,
+                              ft == doc::algorithm::FlipVertical ? bounds.y2()-1-(v-bounds.y): v));
+        }
+        EXPECT_EQ(get_pixel(a.get(), 0, 0), get_pixel(b.get(), 0, 0));
+        EXPECT_EQ(get_pixel(a.get(), 299, 249), get_pixel(b.get(), 299, 249));
+      }
+    }
+  }
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
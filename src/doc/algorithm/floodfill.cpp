@@ -1,50 +1,36 @@
-// The floodfill routine.
-// By Shawn Hargreaves.
-//
-// Changes by David Capello:
-// - Adapted to Aseprite
-// - Added non-contiguous mode
-// - Added mask parameter
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+// Copyright (c) 2001-2017 David Capello
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
-//
-// TODO rewrite this algorithm from scratch
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+#include "doc/algorithm/floodfill.h"
+
 #include "base/base.h"
-#include "doc/algo.h"
 #include "doc/image.h"
+#include "doc/image_impl.h"
 #include "doc/mask.h"
 #include "doc/primitives.h"
 #include "doc/primitives_fast.h"
 
-#include <climits>
-#include <cmath>
-#include <limits>
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
+#if defined(__x86_64__) || defined(_WIN64)
+  #include <emmintrin.h>
+  #define FLOODFILL_SSE2 1
+#endif
+
 namespace doc {
 namespace algorithm {
 
-struct FLOODED_LINE {   // store segments which have been flooded
-  char flags;           // status of the segment
-  int lpos, rpos;       // left and right ends of segment
-  int y;                // y coordinate of the segment
-  int next;             // linked list if several per line
-};
-
-static std::vector<FLOODED_LINE> flood_buf;
-static int flood_count;          /* number of flooded segments */
-
-#define FLOOD_IN_USE             1
-#define FLOOD_TODO_ABOVE         2
-#define FLOOD_TODO_BELOW         4
-
-#define FLOOD_LINE(c)            (&flood_buf[c])
+namespace {
 
 static inline bool color_equal_32_raw(color_t c1, color_t c2)
 {
@@ -126,256 +112,360 @@ inline bool color_equal<IndexedTraits>(color_t c1, color_t c2, int tolerance)
   return color_equal_8(c1, c2, tolerance);
 }
 
+template<>
+inline bool color_equal<BitmapTraits>(color_t c1, color_t c2, int tolerance)
+{
+  return (c1 == c2);
+}
+
 template<>
 inline bool color_equal<TilemapTraits>(color_t c1, color_t c2, int tolerance)
 {
   return color_equal_32_raw(c1, c2);
 }
 
+#ifdef FLOODFILL_SSE2
 
+template<typename ImageTraits>
+__m128i simd_set1(typename ImageTraits::pixel_t pixel);
+template<typename ImageTraits>
+__m128i simd_cmpeq(__m128i a, __m128i b);
 
-/* flooder:
- *  Fills a horizontal line around the specified position, and adds it
- *  to the list of drawn segments. Returns the first x coordinate after
- *  the part of the line which it has dealt with.
- */
-static int flooder(const Image* image,
-                   const Mask* mask,
-                   int x, int y,
-                   const gfx::Rect& bounds,
-                   color_t src_color, int tolerance, void *data, AlgoHLine proc)
-{
-#define MASKED(u, v)                                                    \
-        (mask &&                                                        \
-         (!mask->bounds().contains(u, v) ||                             \
-          (mask->bitmap() &&                                            \
-           !get_pixel_fast<BitmapTraits>(mask->bitmap(),                \
-                                         (u)-mask->bounds().x,          \
-                                         (v)-mask->bounds().y))))
-
-  FLOODED_LINE *p;
-  int left = 0, right = 0;
-  int c;
+template<> __m128i simd_set1<RgbTraits>(uint32_t pixel) { return _mm_set1_epi32(int(pixel)); }
+template<> __m128i simd_set1<GrayscaleTraits>(uint16_t pixel) { return _mm_set1_epi16(short(pixel)); }
+template<> __m128i simd_set1<IndexedTraits>(uint8_t pixel) { return _mm_set1_epi8(char(pixel)); }
+template<> __m128i simd_set1<TilemapTraits>(uint32_t pixel) { return _mm_set1_epi32(int(pixel)); }
+template<> __m128i simd_cmpeq<RgbTraits>(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+template<> __m128i simd_cmpeq<GrayscaleTraits>(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+template<> __m128i simd_cmpeq<IndexedTraits>(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+template<> __m128i simd_cmpeq<TilemapTraits>(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
 
-  switch (image->pixelFormat()) {
+#endif
 
-    case IMAGE_RGB:
-      {
-        uint32_t* address = reinterpret_cast<uint32_t*>(image->getPixelAddress(0, y));
-
-        // Check start pixel
-        if (!color_equal_32((int)*(address+x), src_color, tolerance) || MASKED(x, y))
-          return x+1;
-
-        // Work left from starting point
-        for (left=x-1; left>=bounds.x; left--) {
-          if (!color_equal_32((int)*(address+left), src_color, tolerance) || MASKED(left, y))
-            break;
-        }
-
-        // Work right from starting point
-        for (right=x+1; right<bounds.x2(); right++) {
-          if (!color_equal_32((int)*(address+right), src_color, tolerance) || MASKED(right, y))
-            break;
-        }
+// Compares pixels against the color of the starting point (with the
+// same criteria as color_equal<ImageTraits>()).
+template<typename ImageTraits>
+class ColorMatcher {
+public:
+  using pixel_t = typename ImageTraits::pixel_t;
+
+  ColorMatcher(const color_t refColor, const int tolerance)
+    : m_ref(refColor)
+    , m_tolerance(tolerance) {
+#ifdef FLOODFILL_SSE2
+    if constexpr (ImageTraits::pixel_format != IMAGE_BITMAP) {
+      // Tiles are compared without tolerance
+      m_exact = (tolerance == 0 ||
+                 ImageTraits::pixel_format == IMAGE_TILEMAP);
+      // All channels are compared byte by byte, so a tolerance of
+      // 255 or greater matches any pixel
+      m_refv = simd_set1<ImageTraits>(pixel_t(refColor));
+      m_tolv = _mm_set1_epi8(char(std::clamp(tolerance, 0, 255)));
+
+      // Transparent pixels match any other transparent pixel
+      if constexpr (ImageTraits::pixel_format == IMAGE_RGB) {
+        m_transparent = (rgba_geta(refColor) == 0);
+        m_alphav = simd_set1<ImageTraits>(rgba_a_mask);
       }
-      break;
-
-    case IMAGE_GRAYSCALE:
-      {
-        uint16_t* address = reinterpret_cast<uint16_t*>(image->getPixelAddress(0, y));
-
-        // Check start pixel
-        if (!color_equal_16((int)*(address+x), src_color, tolerance) || MASKED(x, y))
-          return x+1;
-
-        // Work left from starting point
-        for (left=x-1; left>=bounds.x; left--) {
-          if (!color_equal_16((int)*(address+left), src_color, tolerance) || MASKED(left, y))
-            break;
-        }
-
-        // Work right from starting point
-        for (right=x+1; right<bounds.x2(); right++) {
-          if (!color_equal_16((int)*(address+right), src_color, tolerance) || MASKED(right, y))
-            break;
-        }
+      else if constexpr (ImageTraits::pixel_format == IMAGE_GRAYSCALE) {
+        m_transparent = (graya_geta(refColor) == 0);
+        m_alphav = simd_set1<ImageTraits>(graya_a_mask);
       }
-      break;
+    }
+#endif
+  }
 
-    case IMAGE_INDEXED:
-      {
-        uint8_t* address = image->getPixelAddress(0, y);
-
-        // Check start pixel
-        if (!color_equal_8((int)*(address+x), src_color, tolerance) || MASKED(x, y))
-          return x+1;
-
-        // Work left from starting point
-        for (left=x-1; left>=bounds.x; left--) {
-          if (!color_equal_8((int)*(address+left), src_color, tolerance) || MASKED(left, y))
-            break;
-        }
-
-        // Work right from starting point
-        for (right=x+1; right<bounds.x2(); right++) {
-          if (!color_equal_8((int)*(address+right), src_color, tolerance) || MASKED(right, y))
-            break;
-        }
-      }
-      break;
+  bool match(const pixel_t pixel) const {
+    return color_equal<ImageTraits>(pixel, m_ref, m_tolerance);
+  }
 
-    case IMAGE_TILEMAP:
-      {
-        // TODO add support for mask
-
-        uint32_t* address = reinterpret_cast<uint32_t*>(image->getPixelAddress(0, y));
-
-        // Check start pixel
-        if (!color_equal_32_raw((int)*(address+x), src_color))
-          return x+1;
-
-        // Work left from starting point
-        for (left=x-1; left>=bounds.x; left--) {
-          if (!color_equal_32_raw((int)*(address+left), src_color))
-            break;
-        }
-
-        // Work right from starting point
-        for (right=x+1; right<bounds.x2(); right++) {
-          if (!color_equal_32_raw((int)*(address+right), src_color))
-            break;
-        }
-      }
-      break;
+#ifdef FLOODFILL_SSE2
+  // Returns all bits set for each matching pixel of "pixels"
+  __m128i match(const __m128i pixels) const {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i r;
+    if (m_exact) {
+      r = simd_cmpeq<ImageTraits>(pixels, m_refv);
+    }
+    else {
+      // Absolute difference of each byte <= tolerance
+      const __m128i diff = _mm_or_si128(_mm_subs_epu8(pixels, m_refv),
+                                        _mm_subs_epu8(m_refv, pixels));
+      r = simd_cmpeq<ImageTraits>(_mm_subs_epu8(diff, m_tolv), zero);
+    }
+    if (m_transparent) {
+      r = _mm_or_si128(
+        r, simd_cmpeq<ImageTraits>(_mm_and_si128(pixels, m_alphav), zero));
+    }
+    return r;
+  }
+#endif
 
-    default:
-      // Check start pixel
-      if (get_pixel(image, x, y) != src_color || MASKED(x, y))
-        return x+1;
+private:
+  color_t m_ref;
+  int m_tolerance;
+#ifdef FLOODFILL_SSE2
+  bool m_exact = true;
+  bool m_transparent = false;
+  __m128i m_refv, m_tolv, m_alphav;
+#endif
+};
 
-      // Work left from starting point
-      for (left=x-1; left>=bounds.x; left--) {
-        if (get_pixel(image, left, y) != src_color || MASKED(left, y))
+// Returns the first "x" in [x, x2) of the row "y" where the pixel
+// matches (or doesn't match if "matching" is false), or x2 if there
+// is no such pixel.
+template<typename ImageTraits>
+int find_first(const Image* image, const int y, int x, const int x2,
+               const ColorMatcher<ImageTraits>& matcher,
+               const bool matching)
+{
+#ifdef FLOODFILL_SSE2
+  if constexpr (ImageTraits::pixel_format != IMAGE_BITMAP) {
+    if (x < x2) {
+      // Compare 16 bytes (4, 8, or 16 pixels) at once, skipping the
+      // blocks where all pixels match (or don't match)
+      constexpr int N = 16 / ImageTraits::bytes_per_pixel;
+      const int skip = (matching ? 0: 0xffff);
+      auto ptr = (typename ImageTraits::const_address_t)image->getPixelAddress(x, y);
+      for (; x+N<=x2; x+=N, ptr+=N) {
+        const __m128i r = matcher.match(_mm_loadu_si128((const __m128i*)ptr));
+        if (_mm_movemask_epi8(r) != skip)
           break;
       }
+    }
+  }
+#endif
+
+  for (; x<x2; ++x) {
+    if (matcher.match(get_pixel_fast<ImageTraits>(image, x, y)) == matching)
+      return x;
+  }
+  return x2;
+}
 
-      // Work right from starting point
-      for (right=x+1; right<bounds.x2(); right++) {
-        if (get_pixel(image, right, y) != src_color || MASKED(right, y))
+// Returns the last "x" in [x1, x2) of the row "y" where the pixel
+// matches (or doesn't match if "matching" is false), or x1-1 if
+// there is no such pixel.
+template<typename ImageTraits>
+int find_last(const Image* image, const int y, const int x1, int x2,
+              const ColorMatcher<ImageTraits>& matcher,
+              const bool matching)
+{
+#ifdef FLOODFILL_SSE2
+  if constexpr (ImageTraits::pixel_format != IMAGE_BITMAP) {
+    if (x1 < x2) {
+      constexpr int N = 16 / ImageTraits::bytes_per_pixel;
+      const int skip = (matching ? 0: 0xffff);
+      // Pointer to the pixel at x2 (which can be outside the row)
+      auto ptr = (typename ImageTraits::const_address_t)image->getPixelAddress(x1, y);
+      ptr += (x2 - x1);
+      for (; x2-N>=x1; x2-=N, ptr-=N) {
+        const __m128i r = matcher.match(_mm_loadu_si128((const __m128i*)(ptr-N)));
+        if (_mm_movemask_epi8(r) != skip)
           break;
       }
-      break;
+    }
   }
+#endif
 
-  left++;
-  right--;
+  for (--x2; x2>=x1; --x2) {
+    if (matcher.match(get_pixel_fast<ImageTraits>(image, x2, y)) == matching)
+      return x2;
+  }
+  return x1-1;
+}
 
-  /* draw the line */
-  (*proc)(left, y, right, data);
+// Horizontal segment of filled pixels
+struct Span {
+  int x1, x2, y;                // Inclusive range [x1, x2]
+};
 
-  /* store it in the list of flooded segments */
-  c = y;
-  p = FLOOD_LINE(c);
+// Span-based flood fill: each segment is filled completely (finding
+// its extents comparing several pixels at once), and then the rows
+// above and below the segment are scanned to find new segments to
+// fill. A bitset of visited pixels avoids filling a segment twice.
+template<typename ImageTraits>
+class Flooder {
+public:
+  Flooder(const Image* image,
+          const Mask* mask,
+          const gfx::Rect& bounds,
+          const color_t srcColor,
+          const int tolerance,
+          const bool isEightConnected,
+          void* data,
+          AlgoHLine proc)
+    : m_image(image)
+    , m_mask(mask && mask->bitmap() ? mask: nullptr)
+    , m_emptyMask(mask && !mask->bitmap())
+    , m_bounds(bounds)
+    , m_matcher(srcColor, tolerance)
+    , m_eightConnected(isEightConnected)
+    , m_data(data)
+    , m_proc(proc)
+    , m_rowWords((bounds.w+63) / 64)
+    , m_visited(std::size_t(m_rowWords) * bounds.h, 0) {
+  }
 
-  if (p->flags) {
-    while (p->next) {
-      c = p->next;
-      p = FLOOD_LINE(c);
+  void fill(const int x, const int y) {
+    // An empty mask doesn't let us fill anything
+    if (m_emptyMask || !canFill(x, y))
+      return;
+
+    m_stack.push_back(fillSpan(x, y));
+    while (!m_stack.empty()) {
+      const Span span = m_stack.back();
+      m_stack.pop_back();
+
+      const int x1 = std::max(m_bounds.x, span.x1 - (m_eightConnected ? 1: 0));
+      const int x2 = std::min(m_bounds.x2()-1, span.x2 + (m_eightConnected ? 1: 0));
+      if (span.y > m_bounds.y)
+        checkRow(span.y-1, x1, x2);
+      if (span.y+1 < m_bounds.y2())
+        checkRow(span.y+1, x1, x2);
     }
-
-    p->next = c = flood_count++;
-    flood_buf.resize(flood_count);
-    p = FLOOD_LINE(c);
   }
 
-  p->flags = FLOOD_IN_USE;
-  p->lpos = left;
-  p->rpos = right;
-  p->y = y;
-  p->next = 0;
-
-  if (y > bounds.y)
-    p->flags |= FLOOD_TODO_ABOVE;
-
-  if (y+1 < bounds.y2())
-    p->flags |= FLOOD_TODO_BELOW;
+private:
+  bool isMasked(const int x, const int y) const {
+    if (!m_mask)
+      return false;
+    const gfx::Rect& maskBounds = m_mask->bounds();
+    return (!maskBounds.contains(x, y) ||
+            !get_pixel_fast<BitmapTraits>(m_mask->bitmap(),
+                                          x-maskBounds.x,
+                                          y-maskBounds.y));
+  }
 
-  return right+2;
-}
+  uint64_t* visitedRow(const int y) {
+    return &m_visited[std::size_t(y-m_bounds.y) * m_rowWords];
+  }
 
+  bool isVisited(const int x, const int y) {
+    const int u = x - m_bounds.x;
+    return (visitedRow(y)[u / 64] & (uint64_t(1) << (u % 64))) != 0;
+  }
 
+  void setVisited(const int y, const int x1, const int x2) {
+    uint64_t* row = visitedRow(y);
+    for (int u=x1-m_bounds.x, u2=x2-m_bounds.x; u<=u2; ) {
+      if ((u % 64) == 0 && u+63 <= u2) {
+        row[u / 64] = ~uint64_t(0);
+        u += 64;
+      }
+      else {
+        row[u / 64] |= (uint64_t(1) << (u % 64));
+        ++u;
+      }
+    }
+  }
 
-/* check_flood_line:
- *  Checks a line segment, using the scratch buffer is to store a list of
- *  segments which have already been drawn in order to minimise the required
- *  number of tests.
- */
-static int check_flood_line(const Image* image,
-                            const Mask* mask,
-                            int y, int left, int right,
-                            const gfx::Rect& bounds,
-                            int src_color, int tolerance, void *data, AlgoHLine proc)
-{
-  int c;
-  FLOODED_LINE *p;
-  int ret = false;
+  bool canFill(const int x, const int y) {
+    return (!isVisited(x, y) &&
+            m_matcher.match(get_pixel_fast<ImageTraits>(m_image, x, y)) &&
+            !isMasked(x, y));
+  }
 
-  while (left <= right) {
-    c = y;
+  // Fills the whole segment of matching pixels around (x, y), which
+  // must be a pixel that can be filled.
+  Span fillSpan(const int x, const int y) {
+    int x1 = find_last(m_image, y, m_bounds.x, x, m_matcher, false) + 1;
+    int x2 = find_first(m_image, y, x+1, m_bounds.x2(), m_matcher, false) - 1;
+
+    if (m_mask) {
+      int u = x;
+      while (u > x1 && !isMasked(u-1, y))
+        --u;
+      x1 = u;
+      for (u=x; u < x2 && !isMasked(u+1, y); )
+        ++u;
+      x2 = u;
+    }
 
-    for (;;) {
-      p = FLOOD_LINE(c);
+    setVisited(y, x1, x2);
+    (*m_proc)(x1, y, x2, m_data);
+    return Span{ x1, x2, y };
+  }
 
-      if ((left >= p->lpos) && (left <= p->rpos)) {
-        left = p->rpos+2;
-        break;
+  // Finds segments to fill in the [x1, x2] range of the row "y"
+  void checkRow(const int y, int x, const int x2) {
+    while (x <= x2) {
+      // Skip 64 visited pixels at once
+      const int u = x - m_bounds.x;
+      if ((u % 64) == 0 && visitedRow(y)[u / 64] == ~uint64_t(0)) {
+        x += 64;
+        continue;
       }
 
-      c = p->next;
-
-      if (!c) {
-        left = flooder(image, mask, left, y, bounds, src_color, tolerance, data, proc);
-        ret = true;
-        break;
+      if (canFill(x, y)) {
+        const Span span = fillSpan(x, y);
+        m_stack.push_back(span);
+        // The pixel at span.x2+1 cannot be filled
+        x = span.x2+2;
       }
+      else
+        ++x;
     }
   }
 
-  return ret;
+  const Image* m_image;
+  const Mask* m_mask;
+  const bool m_emptyMask;
+  const gfx::Rect m_bounds;
+  const ColorMatcher<ImageTraits> m_matcher;
+  const bool m_eightConnected;
+  void* m_data;
+  AlgoHLine m_proc;
+  const int m_rowWords;
+  std::vector<uint64_t> m_visited;
+  std::vector<Span> m_stack;
+};
+
+template<typename ImageTraits>
+void flood(const Image* image,
+           const Mask* mask,
+           const int x, const int y,
+           const gfx::Rect& bounds,
+           const color_t srcColor,
+           const int tolerance,
+           const bool isEightConnected,
+           void* data,
+           AlgoHLine proc)
+{
+  Flooder<ImageTraits> flooder(image, mask, bounds, srcColor, tolerance,
+                               isEightConnected, data, proc);
+  flooder.fill(x, y);
 }
 
 template<typename ImageTraits>
-static void replace_color(const Image* image, const gfx::Rect& bounds, int src_color, int tolerance, void* data, AlgoHLine proc)
+void replace_color(const Image* image,
+                   const gfx::Rect& bounds,
+                   const color_t srcColor,
+                   const int tolerance,
+                   void* data,
+                   AlgoHLine proc)
 {
-  typename ImageTraits::address_t address;
+  const ColorMatcher<ImageTraits> matcher(srcColor, tolerance);
 
   for (int y=bounds.y; y<bounds.y2(); ++y) {
-    address = reinterpret_cast<typename ImageTraits::address_t>(image->getPixelAddress(bounds.x, y));
-
-    for (int x=bounds.x; x<bounds.x2(); ++x, ++address) {
-      int right = -1;
-
-      if (color_equal<ImageTraits>((int)(*address), src_color, tolerance)) {
-        ++address;
-        for (right=x+1; right<bounds.x2(); ++right, ++address) {
-          if (!color_equal<ImageTraits>((int)(*address), src_color, tolerance))
-            break;
-        }
-        (*proc)(x, y, right-1, data);
-        x = right;
-      }
+    for (int x=bounds.x; x<bounds.x2(); ) {
+      x = find_first(image, y, x, bounds.x2(), matcher, true);
+      if (x == bounds.x2())
+        break;
+
+      const int right = find_first(image, y, x+1, bounds.x2(), matcher, false);
+      (*proc)(x, y, right-1, data);
+      x = right+1;
     }
   }
 }
 
-/* floodfill:
- *  Fills an enclosed area (starting at point x, y) with the specified color.
- */
+} // anonymous namespace
+
 void floodfill(const Image* image,
                const Mask* mask,
                const int x, const int y,
-               const gfx::Rect& bounds,
+               const gfx::Rect& boundsArg,
                const doc::color_t src_color,
                const int tolerance,
                const bool contiguous,
@@ -383,9 +473,10 @@ void floodfill(const Image* image,
                void* data,
                AlgoHLine proc)
 {
+  const gfx::Rect bounds = (boundsArg & image->bounds());
+
   // Make sure we have a valid starting point
-  if ((x < 0) || (x >= image->width()) ||
-      (y < 0) || (y >= image->height()))
+  if (!bounds.contains(x, y))
     return;
 
   // Non-contiguous case, we replace colors in the whole image.
@@ -407,116 +498,29 @@ void floodfill(const Image* image,
     return;
   }
 
-  /* set up the list of flooded segments */
-  flood_buf.resize(image->height());
-  flood_count = image->height();
-  FLOODED_LINE* p = (FLOODED_LINE*)&flood_buf[0];
-  for (int c=0; c<flood_count; c++) {
-    p[c].flags = 0;
-    p[c].lpos = std::numeric_limits<int>::max();
-    p[c].rpos = std::numeric_limits<int>::min();
-    p[c].y = y;
-    p[c].next = 0;
+  switch (image->pixelFormat()) {
+    case IMAGE_RGB:
+      flood<RgbTraits>(image, mask, x, y, bounds, src_color, tolerance,
+                       isEightConnected, data, proc);
+      break;
+    case IMAGE_GRAYSCALE:
+      flood<GrayscaleTraits>(image, mask, x, y, bounds, src_color, tolerance,
+                             isEightConnected, data, proc);
+      break;
+    case IMAGE_INDEXED:
+      flood<IndexedTraits>(image, mask, x, y, bounds, src_color, tolerance,
+                           isEightConnected, data, proc);
+      break;
+    case IMAGE_BITMAP:
+      flood<BitmapTraits>(image, mask, x, y, bounds, src_color, tolerance,
+                          isEightConnected, data, proc);
+      break;
+    case IMAGE_TILEMAP:
+      // TODO add support for mask
+      flood<TilemapTraits>(image, nullptr, x, y, bounds, src_color, tolerance,
+                           isEightConnected, data, proc);
+      break;
   }
-
-  // Start up the flood algorithm
-  flooder(image, mask, x, y, bounds, src_color, tolerance, data, proc);
-
-  // Continue as long as there are some segments still to test
-  bool done;
-  do {
-    done = true;
-
-    // For each line on the screen
-    for (int c=0; c<flood_count; c++) {
-      p = FLOOD_LINE(c);
-
-      // Check below the segment?
-      if (p->flags & FLOOD_TODO_BELOW) {
-        p->flags &= ~FLOOD_TODO_BELOW;
-
-        if (isEightConnected) {
-          if (p->lpos+1 < bounds.x2() &&
-              check_flood_line(image, mask, p->y+1, p->lpos+1, p->rpos, bounds,
-                               src_color, tolerance, data, proc)) {
-            done = false;
-            p = FLOOD_LINE(c);
-          }
-
-          if (p->lpos-1 >= bounds.x &&
-              check_flood_line(image, mask, p->y+1, p->lpos-1, p->rpos, bounds,
-                               src_color, tolerance, data, proc)) {
-            done = false;
-            p = FLOOD_LINE(c);
-          }
-
-          if (p->rpos+1 < bounds.x2() &&
-              check_flood_line(image, mask, p->y+1, p->lpos, p->rpos+1, bounds,
-                               src_color, tolerance, data, proc)) {
-            done = false;
-            p = FLOOD_LINE(c);
-          }
-
-          if (p->rpos-1 >= bounds.x &&
-              check_flood_line(image, mask, p->y+1, p->lpos, p->rpos-1, bounds,
-                               src_color, tolerance, data, proc)) {
-            done = false;
-            p = FLOOD_LINE(c);
-          }
-        }
-
-        if (check_flood_line(image, mask, p->y+1, p->lpos, p->rpos, bounds,
-                             src_color, tolerance, data, proc)) {
-          done = false;
-          p = FLOOD_LINE(c);
-        }
-      }
-
-      // Check above the segment?
-      if (p->flags & FLOOD_TODO_ABOVE) {
-        p->flags &= ~FLOOD_TODO_ABOVE;
-
-        if (isEightConnected) {
-          if (p->lpos+1 < bounds.x2() &&
-              check_flood_line(image, mask, p->y-1, p->lpos+1, p->rpos, bounds,
-                               src_color, tolerance, data, proc)) {
-            done = false;
-            p = FLOOD_LINE(c);
-          }
-
-          if (p->lpos-1 >= bounds.x &&
-              check_flood_line(image, mask, p->y-1, p->lpos-1, p->rpos, bounds,
-                               src_color, tolerance, data, proc)) {
-            done = false;
-            p = FLOOD_LINE(c);
-          }
-
-          if (p->rpos+1 < bounds.x2() &&
-              check_flood_line(image, mask, p->y-1, p->lpos, p->rpos+1, bounds,
-                               src_color, tolerance, data, proc)) {
-            done = false;
-            p = FLOOD_LINE(c);
-          }
-
-          if (p->rpos-1 >= bounds.x &&
-              check_flood_line(image, mask, p->y-1, p->lpos, p->rpos-1, bounds,
-                               src_color, tolerance, data, proc)) {
-            done = false;
-            p = FLOOD_LINE(c);
-          }
-        }
-
-        if (check_flood_line(image, mask, p->y-1, p->lpos, p->rpos, bounds,
-                             src_color, tolerance, data, proc)) {
-          done = false;
-
-          // Special case shortcut for going backwards
-          if ((c > bounds.y) && (c < bounds.y2()))
-            c -= 2;
-        }
-      }
-    }
-  } while (!done);
 }
 
 } // namespace algorithm
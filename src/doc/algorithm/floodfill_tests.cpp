@@ -0,0 +1,173 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "gtest/gtest.h"
+
+#include "doc/algorithm/floodfill.h"
+
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/mask.h"
+#include "doc/primitives.h"
+
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace doc;
+using namespace gfx;
+
+namespace {
+
+struct FillData {
+  ImageRef filled;              // Times that each pixel was filled
+};
+
+void count_hline(int x1, int y, int x2, void* data)
+{
+  Image* filled = static_cast<FillData*>(data)->filled.get();
+  for (int x=x1; x<=x2; ++x)
+    put_pixel(filled, x, y, get_pixel(filled, x, y)+1);
+}
+
+// Reference flood fill (pixel by pixel) for indexed images
+ImageRef reference_fill(const Image* image, const Rect& bounds,
+                        int x, int y, int tolerance, bool eightConnected,
+                        const Mask* mask)
+{
+  ImageRef result(Image::create(IMAGE_INDEXED, image->width(), image->height()));
+  clear_image(result.get(), 0);
+
+  auto canFill = [&](int u, int v) {
+    if (!bounds.contains(u, v) || get_pixel(result.get(), u, v))
+      return false;
+    if (mask && !mask->containsPoint(u, v))
+      return false;
+    return std::abs(int(get_pixel(image, u, v)) -
+                    int(get_pixel(image, x, y))) <= tolerance;
+  };
+
+  std::vector<Point> stack;
+  if (canFill(x, y)) {
+    put_pixel(result.get(), x, y, 1);
+    stack.push_back(Point(x, y));
+  }
+  while (!stack.empty()) {
+    const Point pt = stack.back();
+    stack.pop_back();
+    for (int dy=-1; dy<=1; ++dy) {
+      for (int dx=-1; dx<=1; ++dx) {
+        if ((dx == 0 && dy == 0) ||
+            (!eightConnected && dx != 0 && dy != 0))
+          continue;
+        if (canFill(pt.x+dx, pt.y+dy)) {
+          put_pixel(result.get(), pt.x+dx, pt.y+dy, 1);
+          stack.push_back(Point(pt.x+dx, pt.y+dy));
+        }
+      }
+    }
+  }
+  return result;
+}
+
+} // anonymous namespace
+
+TEST(FloodFill, CompareWithReference)
+{
+  std::srand(1);
+
+  for (int test=0; test<200; ++test) {
+    const int w = 1 + (std::rand() % 90);
+    const int h = 1 + (std::rand() % 40);
+    const int ncolors = 2 + (std::rand() % 3);
+    ImageRef image(Image::create(IMAGE_INDEXED, w, h));
+    for (int y=0; y<h; ++y)
+      for (int x=0; x<w; ++x)
+        put_pixel(image.get(), x, y, std::rand() % ncolors);
+
+    const int x = std::rand() % w;
+    const int y = std::rand() % h;
+    const int tolerance = std::rand() % 2;
+    const bool eightConnected = (std::rand() % 2) == 1;
+    const Rect bounds(std::rand() % (x+1), std::rand() % (y+1), w, h);
+
+    std::unique_ptr<Mask> mask;
+    if (std::rand() % 3 == 0) {
+      mask.reset(new Mask);
+      mask->replace(Rect(0, 0, w, h));
+      for (int v=0; v<h; ++v)
+        for (int u=0; u<w; ++u)
+          put_pixel(mask->editableBitmap(), u, v, (std::rand() % 5) != 0);
+    }
+
+    FillData data;
+    data.filled.reset(Image::create(IMAGE_INDEXED, w, h));
+    clear_image(data.filled.get(), 0);
+
+    doc::algorithm::floodfill(
+      image.get(), mask.get(), x, y, bounds,
+      get_pixel(image.get(), x, y), tolerance,
+      true, eightConnected, &data, count_hline);
+
+    ImageRef expected = reference_fill(image.get(), bounds & image->bounds(),
+                                       x, y, tolerance, eightConnected,
+                                       mask.get());
+    ASSERT_TRUE(is_same_image(expected.get(), data.filled.get()))
+      << "Test " << test << " size=" << w << "x" << h
+      << " tolerance=" << tolerance << " eightConnected=" << eightConnected;
+  }
+}
+
+TEST(FloodFill, RgbTolerance)
+{
+  ImageRef image(Image::create(IMAGE_RGB, 37, 3));
+  clear_image(image.get(), rgba(100, 100, 100, 255));
+  put_pixel(image.get(), 20, 1, rgba(104, 100, 100, 255));
+  put_pixel(image.get(), 30, 1, rgba(110, 100, 100, 255));
+
+  for (int tolerance : { 0, 4, 10 }) {
+    FillData data;
+    data.filled.reset(Image::create(IMAGE_INDEXED, 37, 3));
+    clear_image(data.filled.get(), 0);
+
+    doc::algorithm::floodfill(
+      image.get(), nullptr, 0, 1, image->bounds(),
+      get_pixel(image.get(), 0, 1), tolerance,
+      false, false, &data, count_hline);
+
+    EXPECT_EQ(tolerance >= 4 ? 1: 0, get_pixel(data.filled.get(), 20, 1));
+    EXPECT_EQ(tolerance >= 10 ? 1: 0, get_pixel(data.filled.get(), 30, 1));
+    EXPECT_EQ(1, get_pixel(data.filled.get(), 36, 1));
+  }
+}
+
+TEST(FloodFill, TransparentRgb)
+{
+  // All transparent pixels are equal (whatever the RGB values are)
+  ImageRef image(Image::create(IMAGE_RGB, 40, 1));
+  for (int x=0; x<40; ++x)
+    put_pixel(image.get(), x, 0, rgba(x, 2*x, 3*x, 0));
+  put_pixel(image.get(), 35, 0, rgba(0, 0, 0, 255));
+
+  FillData data;
+  data.filled.reset(Image::create(IMAGE_INDEXED, 40, 1));
+  clear_image(data.filled.get(), 0);
+
+  doc::algorithm::floodfill(
+    image.get(), nullptr, 0, 0, image->bounds(),
+    get_pixel(image.get(), 0, 0), 0,
+    true, false, &data, count_hline);
+
+  EXPECT_EQ(1, get_pixel(data.filled.get(), 34, 0));
+  EXPECT_EQ(0, get_pixel(data.filled.get(), 35, 0));
+  EXPECT_EQ(0, get_pixel(data.filled.get(), 36, 0));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2021 Igara Studio S.A.
+// Copyright (c) 2021-2024 Igara Studio S.A.
 // Copyright (c) 2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -14,81 +14,191 @@
 #include "doc/image_impl.h"
 #include "doc/mask.h"
 #include "doc/primitives.h"
+#include "doc/primitives_fast.h"
 
-#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
 
 namespace doc {
 namespace algorithm {
 
+namespace {
+
+// Number of columns processed at the same time (the memory used by
+// the distance transform is proportional to the width of the strip
+// plus the radius by the height of the mask)
+constexpr int kStripWidth = 256;
+
+// Squared distance transform of one row (Felzenszwalb & Huttenlocher
+// lower envelope of parabolas). "f" contains the squared vertical
+// distances, "d" receives the squared euclidean distances from
+// "begin" to "end".
+void distance_transform_1d(const int* f, const int n,
+                           const int begin, const int end,
+                           std::vector<int>& v,
+                           std::vector<double>& z,
+                           int* d)
+{
+  v.resize(n);
+  z.resize(n+1);
+
+  int k = 0;
+  v[0] = 0;
+  z[0] = -std::numeric_limits<double>::infinity();
+  z[1] = std::numeric_limits<double>::infinity();
+  for (int q=1; q<n; ++q) {
+    double s;
+    while (true) {
+      const int p = v[k];
+      s = (double(f[q] + q*q) - double(f[p] + p*p)) / double(2*(q-p));
+      if (s > z[k])
+        break;
+      --k;
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k+1] = std::numeric_limits<double>::infinity();
+  }
+
+  k = 0;
+  for (int q=begin; q<end; ++q) {
+    while (z[k+1] < q)
+      ++k;
+    const int p = v[k];
+    d[q] = (q-p)*(q-p) + f[p];
+  }
+}
+
+} // anonymous namespace
+
 // TODO create morphological operators/functions in "doc" namespace
-// TODO the impl is not optimal, but is good enough as a first version
 void modify_selection(const SelectionModifier modifier,
                       const Mask* srcMask,
                       Mask* dstMask,
                       const int radius,
                       const doc::BrushType brush)
 {
+  ASSERT(radius >= 0 && radius < std::numeric_limits<uint16_t>::max());
+
   const doc::Image* srcImage = srcMask->bitmap();
-  doc::Image* dstImage = dstMask->bitmap();
+  doc::Image* dstImage = dstMask->editableBitmap();
   const gfx::Point offset =
     srcMask->bounds().origin() -
     dstMask->bounds().origin();
 
-  // Image bounds to clip get/put pixels
-  const gfx::Rect srcBounds = srcImage->bounds();
-
-  // Create a kernel
-  const int size = 2*radius+1;
-  std::unique_ptr<doc::Image> kernel(doc::Image::create(IMAGE_BITMAP, size, size));
-  doc::clear_image(kernel.get(), 0);
-  if (brush == doc::kCircleBrushType)
-    doc::fill_ellipse(kernel.get(), 0, 0, size-1, size-1, 0, 0, 1);
-  else
-    doc::fill_rect(kernel.get(), 0, 0, size-1, size-1, 1);
-  doc::put_pixel(kernel.get(), radius, radius, 0);
-
-  int total = 0;                // Number of 1s in the kernel image
-  for (int v=0; v<size; ++v)
-    for (int u=0; u<size; ++u)
-      total += kernel->getPixel(u, v);
-
-  for (int y=-radius; y<srcBounds.h+radius; ++y) {
-    for (int x=-radius; x<srcBounds.w+radius; ++x) {
-      doc::color_t c;
-      if (srcBounds.contains(x, y))
-        c = srcImage->getPixel(x, y);
-      else
-        c = 0;
-
-      int accum = 0;
-      for (int v=0; v<size; ++v) {
-        for (int u=0; u<size; ++u) {
-          if (kernel->getPixel(u, v)) {
-            if (srcBounds.contains(x+u-radius, y+v-radius))
-              accum += srcImage->getPixel(x-radius+u, y-radius+v);
-          }
-        }
+  const int w = srcImage->width();
+  const int h = srcImage->height();
+  const int r = radius;
+  const bool expand = (modifier == SelectionModifier::Expand);
+  const bool circle = (brush == doc::kCircleBrushType);
+
+  // Squared radius of the circle brush (a slightly bigger radius
+  // than "r" so the circle doesn't have single pixels in each side)
+  const int circleLimit = r*r + r;
+
+  auto getPixel = [srcImage, w, h](const int x, const int y) -> bool {
+    return (x >= 0 && y >= 0 && x < w && y < h &&
+            get_pixel_fast<BitmapTraits>(srcImage, x, y));
+  };
+
+  // Instead of checking the whole brush around each pixel, we look
+  // for the distance to the nearest "target" pixel: a selected pixel
+  // to expand the selection, or a non-selected one (including the
+  // outside of the mask) to contract it or to create the border.
+  auto isTarget = [getPixel, expand](const int x, const int y) -> bool {
+    return (getPixel(x, y) == expand);
+  };
+
+  // Area of the result (in source bitmap coordinates)
+  const gfx::Rect area =
+    (expand ? gfx::Rect(-r, -r, w+2*r, h+2*r):
+              gfx::Rect(0, 0, w, h));
+
+  // Vertical distance to the nearest target pixel (up to r+1) of each
+  // pixel in the strip
+  const int maxDist = r+1;
+  std::vector<uint16_t> vdist;
+  std::vector<int> f, d, v, count;
+  std::vector<double> z;
+
+  for (int sx=area.x; sx<area.x2(); sx+=kStripWidth) {
+    const int sx2 = std::min(sx+kStripWidth, area.x2());
+
+    // Pixels that can be inside the brush of the strip pixels
+    const int cx = sx-r;
+    const int cy = area.y-r;
+    const int cw = sx2-sx + 2*r;
+    const int ch = area.h + 2*r;
+    vdist.resize(size_t(cw)*ch);
+
+    for (int y=0; y<ch; ++y) {
+      uint16_t* row = &vdist[size_t(y)*cw];
+      const uint16_t* prev = (y > 0 ? row-cw: nullptr);
+      for (int x=0; x<cw; ++x) {
+        if (isTarget(cx+x, cy+y))
+          row[x] = 0;
+        else
+          row[x] = (prev ? std::min(prev[x]+1, maxDist): maxDist);
       }
+    }
+    for (int y=ch-2; y>=0; --y) {
+      uint16_t* row = &vdist[size_t(y)*cw];
+      const uint16_t* next = row+cw;
+      for (int x=0; x<cw; ++x)
+        row[x] = std::min<int>(row[x], next[x]+1);
+    }
 
-      switch (modifier) {
-        case SelectionModifier::Border: {
-          c = (c && accum < total) ? 1: 0;
-          break;
-        }
-        case SelectionModifier::Expand: {
-          c = (c || accum > 0) ? 1: 0;
-          break;
-        }
-        case SelectionModifier::Contract: {
-          c = (c && accum == total) ? 1: 0;
-          break;
-        }
+    f.resize(cw);
+    d.resize(cw);
+    count.resize(cw+1);
+
+    for (int y=area.y; y<area.y2(); ++y) {
+      const uint16_t* row = &vdist[size_t(y-cy)*cw];
+
+      // Square brush: count target pixels inside each row of the
+      // brush (vertical distance <= r) with a prefix sum
+      if (!circle) {
+        count[0] = 0;
+        for (int x=0; x<cw; ++x)
+          count[x+1] = count[x] + (row[x] <= r ? 1: 0);
+      }
+      // Circle brush: squared euclidean distance
+      else {
+        for (int x=0; x<cw; ++x)
+          f[x] = int(row[x])*int(row[x]);
+        distance_transform_1d(f.data(), cw, r, cw-r, v, z, d.data());
       }
 
-      if (c)
-        doc::put_pixel(dstImage,
-                       offset.x+x,
-                       offset.y+y, 1);
+      for (int x=sx; x<sx2; ++x) {
+        const int i = x-cx;
+        const bool nearTarget =
+          (circle ? d[i] <= circleLimit:
+                    count[i+r+1] - count[i-r] > 0);
+
+        bool c;
+        switch (modifier) {
+          case SelectionModifier::Border:
+            c = (getPixel(x, y) && nearTarget);
+            break;
+          case SelectionModifier::Expand:
+            c = nearTarget;
+            break;
+          case SelectionModifier::Contract:
+            c = (getPixel(x, y) && !nearTarget);
+            break;
+          default:
+            c = false;
+            break;
+        }
+
+        if (c)
+          doc::put_pixel(dstImage,
+                         offset.x+x,
+                         offset.y+y, 1);
+      }
     }
   }
 }
@@ -0,0 +1,78 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "gtest/gtest.h"
+
+#include "doc/algorithm/modify_selection.h"
+#include "doc/mask.h"
+#include "doc/primitives.h"
+
+#include <cstdlib>
+
+using namespace doc;
+using namespace doc::algorithm;
+
+// Applies the brush to each pixel (the slow but obvious way)
+static bool expected_pixel(const Mask& src, const SelectionModifier modifier,
+                           const int radius, const BrushType brush,
+                           const int x, const int y)
+{
+  const bool c = src.containsPoint(x, y);
+  int accum = 0, total = 0;
+  for (int v=-radius; v<=radius; ++v) {
+    for (int u=-radius; u<=radius; ++u) {
+      if ((u == 0 && v == 0) ||
+          (brush == kCircleBrushType && u*u + v*v > radius*radius + radius))
+        continue;
+      ++total;
+      accum += (src.containsPoint(x+u, y+v) ? 1: 0);
+    }
+  }
+  switch (modifier) {
+    case SelectionModifier::Border: return (c && accum < total);
+    case SelectionModifier::Expand: return (c || accum > 0);
+    case SelectionModifier::Contract: return (c && accum == total);
+  }
+  return false;
+}
+
+TEST(ModifySelection, CompareWithBrush)
+{
+  std::srand(1);
+
+  for (int test=0; test<100; ++test) {
+    Mask src;
+    src.replace(gfx::Rect(5, 5, 30, 30));
+    for (int i=0; i<5; ++i)
+      src.subtract(gfx::Rect(std::rand() % 40, std::rand() % 40,
+                             1 + std::rand() % 10, 1 + std::rand() % 10));
+    if (src.isEmpty())
+      continue;
+
+    const auto modifier = SelectionModifier(std::rand() % 3);
+    const auto brush = (std::rand() % 2 ? kCircleBrushType: kSquareBrushType);
+    const int radius = 1 + std::rand() % 10;
+
+    Mask dst;
+    dst.reserve(gfx::Rect(0, 0, 60, 60));
+    dst.freeze();
+    modify_selection(modifier, &src, &dst, radius, brush);
+
+    for (int y=0; y<60; ++y)
+      for (int x=0; x<60; ++x)
+        ASSERT_EQ(expected_pixel(src, modifier, radius, brush, x, y),
+                  get_pixel(dst.bitmap(), x, y) ? true: false)
+          << "Test " << test << " pixel " << x << "," << y;
+
+    dst.unfreeze();
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
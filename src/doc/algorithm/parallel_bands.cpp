@@ -0,0 +1,69 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/algorithm/parallel_bands.h"
+
+#include "doc/task_scheduler.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace doc {
+namespace algorithm {
+
+void for_each_band(const int height,
+                   const std::function<void(int y, int h)>& func)
+{
+  const int nbands =
+    std::clamp(height / kMinBandHeight, 1, task_scheduler_threads());
+  if (nbands == 1) {
+    func(0, height);
+    return;
+  }
+
+  TaskGroup group(TaskPriority::High);
+
+  const int bandH = height / nbands;
+  for (int i=1; i<nbands; ++i) {
+    const int y = i*bandH;
+    const int h = (i < nbands-1 ? bandH: height-y);
+    group.run([&func, y, h]{ func(y, h); });
+  }
+
+  func(0, bandH);
+  group.wait();
+}
+
+void for_each_index(const int n,
+                    const std::function<void(int i)>& func)
+{
+  const int nthreads = std::min(n, task_scheduler_threads());
+  if (nthreads <= 1) {
+    for (int i=0; i<n; ++i)
+      func(i);
+    return;
+  }
+
+  std::atomic<int> next(0);
+  auto loop = [&func, &next, n]{
+    for (int i=next++; i<n; i=next++)
+      func(i);
+  };
+
+  TaskGroup group(TaskPriority::High);
+  for (int t=1; t<nthreads; ++t)
+    group.run(loop);
+
+  loop();
+  group.wait();
+}
+
+} // namespace algorithm
+} // namespace doc
@@ -0,0 +1,37 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_ALGORITHM_PARALLEL_BANDS_H_INCLUDED
+#define DOC_ALGORITHM_PARALLEL_BANDS_H_INCLUDED
+#pragma once
+
+#include <functional>
+
+namespace doc {
+  namespace algorithm {
+
+    // Minimum number of rows processed by each thread
+    constexpr int kMinBandHeight = 64;
+
+    // Calls func(y, h) for bands of rows that cover [0, height) in
+    // parallel using the doc::TaskGroup scheduler (the first band is
+    // processed in the current thread). Returns when all bands are
+    // processed.
+    void for_each_band(const int height,
+                       const std::function<void(int y, int h)>& func);
+
+    // Calls func(i) for each i in [0, n) in parallel (as
+    // for_each_band()). Items are given to the threads one by one as
+    // they finish the previous one (so it's useful when the cost of
+    // each item is different, e.g. to process each image of a
+    // sprite).
+    void for_each_index(const int n,
+                        const std::function<void(int i)>& func);
+
+  } // namespace algorithm
+} // namespace doc
+
+#endif
@@ -0,0 +1,45 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "gtest/gtest.h"
+
+#include "doc/algorithm/parallel_bands.h"
+
+#include <atomic>
+#include <vector>
+
+using namespace doc::algorithm;
+
+TEST(ParallelBands, ForEachBand)
+{
+  for (int height : { 0, 1, 63, 64, 129, 1000, 4321 }) {
+    std::vector<std::atomic<int>> rows(height);
+    for_each_band(height, [&rows](const int y, const int h){
+      for (int i=y; i<y+h; ++i)
+        ++rows[i];
+    });
+    for (int i=0; i<height; ++i)
+      ASSERT_EQ(1, rows[i]) << "height=" << height << " row=" << i;
+  }
+}
+
+TEST(ParallelBands, ForEachIndex)
+{
+  for (int n : { 0, 1, 2, 7, 1000 }) {
+    std::vector<std::atomic<int>> items(n);
+    for_each_index(n, [&items](const int i){
+      ++items[i];
+    });
+    for (int i=0; i<n; ++i)
+      ASSERT_EQ(1, items[i]) << "n=" << n << " item=" << i;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
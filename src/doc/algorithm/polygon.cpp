@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2020 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2014 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -142,8 +142,9 @@ void algorithm::polygon(int vertices, const int* points, void* data, AlgoHLine p
                            verts[verts.size()-1].y,
                            verts[0].x,
                            verts[0].y,
-                           (void*)&pts,
-                           (AlgoPixel)&addPointsWithoutDuplicatingLastOne);
+                           [&pts](int x, int y){
+                             addPointsWithoutDuplicatingLastOne(x, y, &pts);
+                           });
       // Consideration when we want to draw a simple pixel with contour tool
       // dragging the cursor inside of a pixel (in this case pts contains
       // just one element, which want to preserve).
@@ -157,59 +158,86 @@ void algorithm::polygon(int vertices, const int* points, void* data, AlgoHLine p
                            verts[c].y,
                            verts[c+1].x,
                            verts[c+1].y,
-                           (void*)&pts,
-                           (AlgoPixel)&addPointsWithoutDuplicatingLastOne);
+                           [&pts](int x, int y){
+                             addPointsWithoutDuplicatingLastOne(x, y, &pts);
+                           });
     }
   }
 
-  // Scan Line Loop:
-  int y;
-  int x1, y1;
-  int x2, y2;
-  int ind1, ind2;
-  int ints;
-  std::vector<int> polyInts(pts.size());
-  for (y = ymin; y <= ymax; y++) {
-    ints = 0;
+  // Edge table: as "pts" is a closed 8-connected path, each edge
+  // between two consecutive points crosses at most one scan line (or
+  // two if it touches "ymax"), so we can distribute the intersections
+  // (and the points of each row to join with createUnion()) in
+  // buckets by row. In this way each row only visits its own edges
+  // instead of iterating all the points of the polygon contour.
+  const int rows = ymax - ymin + 1;
+  std::vector<int> intsStart(rows+1, 0);
+  std::vector<int> ptsStart(rows+1, 0);
+
+  auto forEachIntersection = [&pts, ymax](auto&& callback) {
     for (int i=0; i < pts.size(); i++) {
-      if (!i) {
-        ind1 = pts.size() - 1;
-        ind2 = 0;
-      }
-      else {
-        ind1 = i - 1;
-        ind2 = i;
-      }
-      y1 = pts[ind1].y;
-      y2 = pts[ind2].y;
-      if (y1 < y2) {
-        x1 = pts[ind1].x;
-        x2 = pts[ind2].x;
+      const int ind1 = (i ? i - 1: pts.size() - 1);
+      const int ind2 = i;
+      int x1, y1, x2, y2;
+      if (pts[ind1].y < pts[ind2].y) {
+        x1 = pts[ind1].x; y1 = pts[ind1].y;
+        x2 = pts[ind2].x; y2 = pts[ind2].y;
       }
-      else if (y1 > y2) {
-        y2 = pts[ind1].y;
-        y1 = pts[ind2].y;
-        x2 = pts[ind1].x;
-        x1 = pts[ind2].x;
+      else if (pts[ind1].y > pts[ind2].y) {
+        x1 = pts[ind2].x; y1 = pts[ind2].y;
+        x2 = pts[ind1].x; y2 = pts[ind1].y;
       }
       else
         continue;
 
-      if ((y >= y1 && y < y2) ||
-          (y == ymax && y > y1 && y <= y2)) {
-        polyInts[ints] = (int) ((float)((y - y1)*(x2 - x1)) / (float)(y2 - y1) + 0.5f + (float)x1);
-        ints++;
-      }
+      auto intersection = [=](const int y) {
+        return (int) ((float)((y - y1)*(x2 - x1)) / (float)(y2 - y1) + 0.5f + (float)x1);
+      };
+      // Scan lines that satisfy "y >= y1 && y < y2" or
+      // "y == ymax && y > y1 && y <= y2"
+      for (int y=y1; y < y2; ++y)
+        callback(y, intersection(y));
+      if (y2 == ymax)
+        callback(ymax, intersection(ymax));
     }
+  };
+
+  // Count the intersections/points of each row
+  forEachIntersection([&intsStart, ymin](int y, int){ ++intsStart[y - ymin + 1]; });
+  for (const auto& pt : pts)
+    ++ptsStart[pt.y - ymin + 1];
+  for (int i=0; i < rows; ++i) {
+    intsStart[i+1] += intsStart[i];
+    ptsStart[i+1] += ptsStart[i];
+  }
 
-    std::sort(polyInts.begin(), polyInts.begin() + ints);
+  // Fill the buckets (the points keep their order in "pts")
+  std::vector<int> edgeInts(intsStart[rows]);
+  std::vector<int> rowPts(ptsStart[rows]);
+  {
+    std::vector<int> intsPos(intsStart.begin(), intsStart.end()-1);
+    std::vector<int> ptsPos(ptsStart.begin(), ptsStart.end()-1);
+    forEachIntersection([&edgeInts, &intsPos, ymin](int y, int x){
+      edgeInts[intsPos[y - ymin]++] = x;
+    });
+    for (const auto& pt : pts)
+      rowPts[ptsPos[pt.y - ymin]++] = pt.x;
+  }
 
-    for (int i=0; i < pts.size(); i++) {
-      if (pts[i].y == y)
-        createUnion(polyInts, pts[i].x, ints);
-    }
+  // Scan Line Loop:
+  std::vector<int> polyInts;
+  for (int y = ymin; y <= ymax; y++) {
+    const int row = y - ymin;
+    polyInts.assign(edgeInts.begin() + intsStart[row],
+                    edgeInts.begin() + intsStart[row+1]);
+    int ints = polyInts.size();
+
+    std::sort(polyInts.begin(), polyInts.end());
+
+    for (int i=ptsStart[row]; i < ptsStart[row+1]; i++)
+      createUnion(polyInts, rowPts[i], ints);
 
-    for (int i=0; i < ints; i+=2)
+    for (int i=0; i+1 < ints; i+=2)
       proc(polyInts[i], y, polyInts[i+1], data);
   }
 }
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -497,6 +497,31 @@ TEST(Polygon, Polygon2Test)
   }
 }
 
+TEST(Polygon, CrossedSquare)
+{
+  //  P3    P1
+  //  P0    P2
+  // Joining the points of the last scan line with createUnion()
+  // must work even when the previous scan line merged segments.
+  int points[8] = { 0, 1,
+                    1, 0,
+                    1, 1,
+                    0, 0 };
+  int n = 4;
+  ScanLineResult results;
+  doc::algorithm::polygon(n, points, (void *) &results, captureHscanSegment);
+  EXPECT_EQ(results.scanLines.size(), 2);
+  if (results.scanLines.size() == 2) {
+    EXPECT_EQ(results.scanLines[0].x1, 0);
+    EXPECT_EQ(results.scanLines[0].x2, 1);
+    EXPECT_EQ(results.scanLines[0].y, 0);
+
+    EXPECT_EQ(results.scanLines[1].x1, 0);
+    EXPECT_EQ(results.scanLines[1].x2, 1);
+    EXPECT_EQ(results.scanLines[1].y, 1);
+  }
+}
+
 // createUnion() function TESTS:
 // =============================
 // Function Tests to ensure correct results when:
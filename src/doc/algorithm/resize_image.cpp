@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -11,6 +11,7 @@
 
 #include "doc/algorithm/resize_image.h"
 
+#include "doc/algorithm/parallel_bands.h"
 #include "doc/algorithm/rotsprite.h"
 #include "doc/image_impl.h"
 #include "doc/palette.h"
@@ -18,27 +19,219 @@
 #include "doc/rgbmap.h"
 #include "gfx/point.h"
 
+#include <algorithm>
 #include <cmath>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_WIN64)
+  #include <emmintrin.h>
+  #define RESIZE_IMAGE_SSE2 1
+#endif
 
 namespace doc {
 namespace algorithm {
 
+namespace {
+
+// Source pixels used to interpolate each destination column/row
+struct BilinearSample {
+  int i1, i2;                   // Source columns/rows to mix
+  double w;                     // Weight of "i2"
+};
+
+std::vector<BilinearSample> bilinear_samples(const int srcSize,
+                                             const int dstSize)
+{
+  std::vector<BilinearSample> samples(dstSize);
+  const double d = (dstSize > 1 ? (srcSize-1) * 1.0 / (dstSize-1): 0.0);
+  for (int i=0; i<dstSize; ++i) {
+    const double u = i * d;
+    int i1 = int(std::floor(u));
+    int i2;
+    if (i1 > srcSize-1) {
+      i1 = srcSize-1;
+      i2 = srcSize-1;
+    }
+    else if (i1 == srcSize-1)
+      i2 = i1;
+    else
+      i2 = i1+1;
+    samples[i] = { i1, i2, u - i1 };
+  }
+  return samples;
+}
+
+#ifdef RESIZE_IMAGE_SSE2
+
+inline __m128 rgba_to_m128(const uint32_t c)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i v = _mm_cvtsi32_si128(int(c));
+  v = _mm_unpacklo_epi8(v, zero);
+  v = _mm_unpacklo_epi16(v, zero);
+  return _mm_cvtepi32_ps(v);
+}
+
+// Interpolates the 4 RGBA channels at the same time
+inline uint32_t bilinear_rgba(const uint32_t c0, const uint32_t c1,
+                              const uint32_t c2, const uint32_t c3,
+                              const float u, const float v)
+{
+  const __m128 f0 = rgba_to_m128(c0);
+  const __m128 f2 = rgba_to_m128(c2);
+  const __m128 mu = _mm_set1_ps(u);
+  const __m128 top = _mm_add_ps(f0, _mm_mul_ps(_mm_sub_ps(rgba_to_m128(c1), f0), mu));
+  const __m128 bottom = _mm_add_ps(f2, _mm_mul_ps(_mm_sub_ps(rgba_to_m128(c3), f2), mu));
+  const __m128 r = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), _mm_set1_ps(v)));
+  __m128i i = _mm_cvttps_epi32(r);
+  i = _mm_packs_epi32(i, i);
+  i = _mm_packus_epi16(i, i);
+  return uint32_t(_mm_cvtsi128_si32(i));
+}
+
+#else
+
+inline int bilinear_channel(const int c0, const int c1,
+                            const int c2, const int c3,
+                            const float u, const float v)
+{
+  const float top = c0 + (c1-c0)*u;
+  const float bottom = c2 + (c3-c2)*u;
+  return std::clamp(int(top + (bottom-top)*v), 0, 255);
+}
+
+// Same results as the SSE2 version
+inline uint32_t bilinear_rgba(const uint32_t c0, const uint32_t c1,
+                              const uint32_t c2, const uint32_t c3,
+                              const float u, const float v)
+{
+  return rgba(
+    bilinear_channel(rgba_getr(c0), rgba_getr(c1), rgba_getr(c2), rgba_getr(c3), u, v),
+    bilinear_channel(rgba_getg(c0), rgba_getg(c1), rgba_getg(c2), rgba_getg(c3), u, v),
+    bilinear_channel(rgba_getb(c0), rgba_getb(c1), rgba_getb(c2), rgba_getb(c3), u, v),
+    bilinear_channel(rgba_geta(c0), rgba_geta(c1), rgba_geta(c2), rgba_geta(c3), u, v));
+}
+
+#endif
+
+} // anonymous namespace
+
 template<typename ImageTraits>
 void resize_image_nearest(const Image* src, Image* dst)
 {
   double x_ratio = double(src->width()) / double(dst->width());
   double y_ratio = double(src->height()) / double(dst->height());
-  double px, py;
 
-  LockImageBits<ImageTraits> dstBits(dst);
-  auto dstIt = dstBits.begin();
+  std::vector<int> srcX(dst->width());
+  for (int x=0; x<dst->width(); ++x)
+    srcX[x] = int(std::floor(x * x_ratio));
+
+  // Each band writes different rows of "dst"
+  for_each_band(dst->height(), [&](const int y0, const int h){
+    for (int y=y0; y<y0+h; ++y) {
+      const int py = int(std::floor(y * y_ratio));
+      for (int x=0; x<dst->width(); ++x)
+        put_pixel_fast<ImageTraits>(
+          dst, x, y, get_pixel_fast<ImageTraits>(src, srcX[x], py));
+    }
+  });
+}
 
-  for (int y=0; y<dst->height(); ++y) {
-    py = std::floor(y * y_ratio);
-    for (int x=0; x<dst->width(); ++x, ++dstIt) {
-      px = std::floor(x * x_ratio);
-      *dstIt = get_pixel_fast<ImageTraits>(src, int(px), int(py));
+static void resize_image_bilinear(const Image* src,
+                                  Image* dst,
+                                  const Palette* pal,
+                                  const RgbMap* rgbmap,
+                                  const color_t maskColor)
+{
+  const std::vector<BilinearSample> cols =
+    bilinear_samples(src->width(), dst->width());
+  const std::vector<BilinearSample> rows =
+    bilinear_samples(src->height(), dst->height());
+
+  switch (dst->pixelFormat()) {
+
+    case IMAGE_RGB:
+      for_each_band(dst->height(), [&](const int y0, const int h){
+        for (int y=y0; y<y0+h; ++y) {
+          const BilinearSample& row = rows[y];
+          const uint32_t* src1 = (const uint32_t*)src->getPixelAddress(0, row.i1);
+          const uint32_t* src2 = (const uint32_t*)src->getPixelAddress(0, row.i2);
+          uint32_t* dstPtr = (uint32_t*)dst->getPixelAddress(0, y);
+          const float v1 = float(row.w);
+
+          for (int x=0; x<dst->width(); ++x, ++dstPtr) {
+            const BilinearSample& col = cols[x];
+            *dstPtr = bilinear_rgba(src1[col.i1], src1[col.i2],
+                                    src2[col.i1], src2[col.i2],
+                                    float(col.w), v1);
+          }
+        }
+      });
+      break;
+
+    case IMAGE_GRAYSCALE:
+      for_each_band(dst->height(), [&](const int y0, const int h){
+        for (int y=y0; y<y0+h; ++y) {
+          const BilinearSample& row = rows[y];
+          const double v1 = row.w;
+          const double v2 = 1 - v1;
+
+          for (int x=0; x<dst->width(); ++x) {
+            const BilinearSample& col = cols[x];
+            const double u1 = col.w;
+            const double u2 = 1 - u1;
+            const uint16_t c0 = get_pixel_fast<GrayscaleTraits>(src, col.i1, row.i1);
+            const uint16_t c1 = get_pixel_fast<GrayscaleTraits>(src, col.i2, row.i1);
+            const uint16_t c2 = get_pixel_fast<GrayscaleTraits>(src, col.i1, row.i2);
+            const uint16_t c3 = get_pixel_fast<GrayscaleTraits>(src, col.i2, row.i2);
+
+            int v = int((graya_getv(c0)*u2 + graya_getv(c1)*u1)*v2 +
+                        (graya_getv(c2)*u2 + graya_getv(c3)*u1)*v1);
+            int a = int((graya_geta(c0)*u2 + graya_geta(c1)*u1)*v2 +
+                        (graya_geta(c2)*u2 + graya_geta(c3)*u1)*v1);
+            put_pixel_fast<GrayscaleTraits>(dst, x, y, graya(v, a));
+          }
+        }
+      });
+      break;
+
+    // The RgbMap cache isn't thread-safe, so indexed images are
+    // interpolated in the current thread
+    case IMAGE_INDEXED: {
+      uint32_t color[4];
+      for (int y=0; y<dst->height(); ++y) {
+        const BilinearSample& row = rows[y];
+        for (int x=0; x<dst->width(); ++x) {
+          const BilinearSample& col = cols[x];
+          color[0] = get_pixel_fast<IndexedTraits>(src, col.i1, row.i1);
+          color[1] = get_pixel_fast<IndexedTraits>(src, col.i2, row.i1);
+          color[2] = get_pixel_fast<IndexedTraits>(src, col.i1, row.i2);
+          color[3] = get_pixel_fast<IndexedTraits>(src, col.i2, row.i2);
+
+          // Convert index to RGBA values
+          for (int i=0; i<4; ++i) {
+            if (color[i] == maskColor)
+              color[i] = pal->getEntry(color[i]) & rgba_rgb_mask; // Set alpha = 0
+            else
+              color[i] = pal->getEntry(color[i]);
+          }
+
+          const uint32_t c = bilinear_rgba(color[0], color[1],
+                                           color[2], color[3],
+                                           float(col.w), float(row.w));
+          put_pixel_fast<IndexedTraits>(
+            dst, x, y,
+            rgbmap->mapColor(rgba_getr(c), rgba_getg(c),
+                             rgba_getb(c), rgba_geta(c)));
+        }
+      }
+      break;
     }
+
+    // There is nothing to interpolate in bitmaps
+    case IMAGE_BITMAP:
+      resize_image_nearest<BitmapTraits>(src, dst);
+      break;
   }
 }
 
@@ -51,7 +244,6 @@ void resize_image(const Image* src,
 {
   switch (method) {
 
-    // TODO optimize this
     case RESIZE_METHOD_NEAREST_NEIGHBOR: {
       ASSERT(src->pixelFormat() == dst->pixelFormat());
 
@@ -64,14 +256,7 @@ void resize_image(const Image* src,
       break;
     }
 
-    // TODO optimize this
     case RESIZE_METHOD_BILINEAR: {
-      uint32_t color[4], dst_color = 0;
-      double u, v, du, dv;
-      int u_floor, u_floor2;
-      int v_floor, v_floor2;
-      int x, y;
-
       // We cannot do interpolations between RGB values on indexed
       // images without a palette/rgbmap.
       if (dst->pixelFormat() == IMAGE_INDEXED &&
@@ -83,93 +268,8 @@ void resize_image(const Image* src,
         return;
       }
 
-      u = v = 0.0;
-      du = (src->width()-1) * 1.0 / (dst->width()-1);
-      dv = (src->height()-1) * 1.0 / (dst->height()-1);
-      for (y=0; y<dst->height(); ++y) {
-        for (x=0; x<dst->width(); ++x) {
-          u_floor = (int)std::floor(u);
-          v_floor = (int)std::floor(v);
-
-          if (u_floor > src->width()-1) {
-            u_floor = src->width()-1;
-            u_floor2 = src->width()-1;
-          }
-          else if (u_floor == src->width()-1)
-            u_floor2 = u_floor;
-          else
-            u_floor2 = u_floor+1;
-
-          if (v_floor > src->height()-1) {
-            v_floor = src->height()-1;
-            v_floor2 = src->height()-1;
-          }
-          else if (v_floor == src->height()-1)
-            v_floor2 = v_floor;
-          else
-            v_floor2 = v_floor+1;
-
-          // get the four colors
-          color[0] = src->getPixel(u_floor,  v_floor);
-          color[1] = src->getPixel(u_floor2, v_floor);
-          color[2] = src->getPixel(u_floor,  v_floor2);
-          color[3] = src->getPixel(u_floor2, v_floor2);
-
-          // calculate the interpolated color
-          double u1 = u - u_floor;
-          double v1 = v - v_floor;
-          double u2 = 1 - u1;
-          double v2 = 1 - v1;
-
-          switch (dst->pixelFormat()) {
-            case IMAGE_RGB: {
-              int r = int((rgba_getr(color[0])*u2 + rgba_getr(color[1])*u1)*v2 +
-                          (rgba_getr(color[2])*u2 + rgba_getr(color[3])*u1)*v1);
-              int g = int((rgba_getg(color[0])*u2 + rgba_getg(color[1])*u1)*v2 +
-                          (rgba_getg(color[2])*u2 + rgba_getg(color[3])*u1)*v1);
-              int b = int((rgba_getb(color[0])*u2 + rgba_getb(color[1])*u1)*v2 +
-                          (rgba_getb(color[2])*u2 + rgba_getb(color[3])*u1)*v1);
-              int a = int((rgba_geta(color[0])*u2 + rgba_geta(color[1])*u1)*v2 +
-                          (rgba_geta(color[2])*u2 + rgba_geta(color[3])*u1)*v1);
-              dst_color = rgba(r, g, b, a);
-              break;
-            }
-            case IMAGE_GRAYSCALE: {
-              int v = int((graya_getv(color[0])*u2 + graya_getv(color[1])*u1)*v2 +
-                          (graya_getv(color[2])*u2 + graya_getv(color[3])*u1)*v1);
-              int a = int((graya_geta(color[0])*u2 + graya_geta(color[1])*u1)*v2 +
-                          (graya_geta(color[2])*u2 + graya_geta(color[3])*u1)*v1);
-              dst_color = graya(v, a);
-              break;
-            }
-            case IMAGE_INDEXED: {
-              // Convert index to RGBA values
-              for (int i=0; i<4; ++i) {
-                if (color[i] == maskColor)
-                  color[i] = pal->getEntry(color[i]) & rgba_rgb_mask; // Set alpha = 0
-                else
-                  color[i] = pal->getEntry(color[i]);
-              }
-
-              int r = int((rgba_getr(color[0])*u2 + rgba_getr(color[1])*u1)*v2 +
-                          (rgba_getr(color[2])*u2 + rgba_getr(color[3])*u1)*v1);
-              int g = int((rgba_getg(color[0])*u2 + rgba_getg(color[1])*u1)*v2 +
-                          (rgba_getg(color[2])*u2 + rgba_getg(color[3])*u1)*v1);
-              int b = int((rgba_getb(color[0])*u2 + rgba_getb(color[1])*u1)*v2 +
-                          (rgba_getb(color[2])*u2 + rgba_getb(color[3])*u1)*v1);
-              int a = int((rgba_geta(color[0])*u2 + rgba_geta(color[1])*u1)*v2 +
-                          (rgba_geta(color[2])*u2 + rgba_geta(color[3])*u1)*v1);
-              dst_color = rgbmap->mapColor(r, g, b, a);
-              break;
-            }
-          }
-
-          dst->putPixel(x, y, dst_color);
-          u += du;
-        }
-        u = 0.0;
-        v += dv;
-      }
+      ASSERT(src->pixelFormat() == dst->pixelFormat());
+      resize_image_bilinear(src, dst, pal, rgbmap, maskColor);
       break;
     }
 
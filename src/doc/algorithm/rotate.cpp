@@ -28,7 +28,8 @@ using namespace fixmath;
 
 static void ase_parallelogram_map_standard(
   Image* bmp, const Image* sprite, const Image* mask,
-  fixed xs[4], fixed ys[4]);
+  fixed xs[4], fixed ys[4],
+  int clip_y, int clip_h);
 
 static void ase_rotate_scale_flip_coordinates(
   fixed w, fixed h,
@@ -163,7 +164,7 @@ void rotate_image(Image* dst, const Image* src, int x, int y, int w, int h,
                                     fixdiv(itofix(h), itofix(src->height())),
                                     false, false, xs, ys);
 
-  ase_parallelogram_map_standard(dst, src, nullptr, xs, ys);
+  ase_parallelogram_map_standard(dst, src, nullptr, xs, ys, 0, -1);
 }
 
 /*    1-----2
@@ -172,7 +173,8 @@ void rotate_image(Image* dst, const Image* src, int x, int y, int w, int h,
  */
 void parallelogram(Image* bmp, const Image* sprite, const Image* mask,
   int x1, int y1, int x2, int y2,
-  int x3, int y3, int x4, int y4)
+  int x3, int y3, int x4, int y4,
+  int clip_y, int clip_h)
 {
   fixed xs[4], ys[4];
 
@@ -185,7 +187,7 @@ void parallelogram(Image* bmp, const Image* sprite, const Image* mask,
   xs[3] = itofix(x4);
   ys[3] = itofix(y4);
 
-  ase_parallelogram_map_standard(bmp, sprite, mask, xs, ys);
+  ase_parallelogram_map_standard(bmp, sprite, mask, xs, ys, clip_y, clip_h);
 }
 
 // Scanline drawers.
@@ -342,7 +344,8 @@ template<class Traits, class Delegate>
 static void ase_parallelogram_map(
   Image* bmp, const Image* spr, const Image* mask,
   fixed xs[4], fixed ys[4],
-  int sub_pixel_accuracy, Delegate delegate)
+  int sub_pixel_accuracy, Delegate delegate,
+  int clip_y, int clip_h)
 {
   /* Index in xs[] and ys[] to topmost point. */
   int top_index;
@@ -467,6 +470,10 @@ static void ase_parallelogram_map(
 
   if (clip_bottom_i > bmp->height())
     clip_bottom_i = bmp->height();
+  /* Only scanlines in [clip_y, clip_y+clip_h) are drawn (clip_h < 0
+     means all scanlines until the bottom of bmp). */
+  if (clip_h >= 0 && clip_bottom_i > clip_y+clip_h)
+    clip_bottom_i = clip_y+clip_h;
 
   /* Calculate y coordinate of first scanline. */
   if (sub_pixel_accuracy)
@@ -623,8 +630,10 @@ static void ase_parallelogram_map(
     if (r_bmp_x_rounded > clip_right)
       r_bmp_x_rounded = clip_right;
 
-    /* Draw! */
-    if (l_bmp_x_rounded <= r_bmp_x_rounded) {
+    /* Draw! (scanlines above clip_y are just skipped as the edges of
+       the scanline are calculated incrementally) */
+    if (bmp_y_i >= clip_y &&
+        l_bmp_x_rounded <= r_bmp_x_rounded) {
       if (!sub_pixel_accuracy) {
         /* The bodies of these ifs are only reached extremely seldom,
            it's an ugly hack to avoid reading outside the sprite when
@@ -746,31 +755,32 @@ static void ase_parallelogram_map(
  */
 static void ase_parallelogram_map_standard(
   Image* bmp, const Image* sprite, const Image* mask,
-  fixed xs[4], fixed ys[4])
+  fixed xs[4], fixed ys[4],
+  int clip_y, int clip_h)
 {
   switch (bmp->pixelFormat()) {
 
     case IMAGE_RGB: {
       RgbDelegate delegate(sprite->maskColor());
-      ase_parallelogram_map<RgbTraits, RgbDelegate>(bmp, sprite, mask, xs, ys, false, delegate);
+      ase_parallelogram_map<RgbTraits, RgbDelegate>(bmp, sprite, mask, xs, ys, false, delegate, clip_y, clip_h);
       break;
     }
 
     case IMAGE_GRAYSCALE: {
       GrayscaleDelegate delegate(sprite->maskColor());
-      ase_parallelogram_map<GrayscaleTraits, GrayscaleDelegate>(bmp, sprite, mask, xs, ys, false, delegate);
+      ase_parallelogram_map<GrayscaleTraits, GrayscaleDelegate>(bmp, sprite, mask, xs, ys, false, delegate, clip_y, clip_h);
       break;
     }
 
     case IMAGE_INDEXED: {
       IndexedDelegate delegate(sprite->maskColor());
-      ase_parallelogram_map<IndexedTraits, IndexedDelegate>(bmp, sprite, mask, xs, ys, false, delegate);
+      ase_parallelogram_map<IndexedTraits, IndexedDelegate>(bmp, sprite, mask, xs, ys, false, delegate, clip_y, clip_h);
       break;
     }
 
     case IMAGE_BITMAP: {
       BitmapDelegate delegate;
-      ase_parallelogram_map<BitmapTraits, BitmapDelegate>(bmp, sprite, mask, xs, ys, false, delegate);
+      ase_parallelogram_map<BitmapTraits, BitmapDelegate>(bmp, sprite, mask, xs, ys, false, delegate, clip_y, clip_h);
       break;
     }
   }
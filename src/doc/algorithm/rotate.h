@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
 // Copyright (c) 2001-2015 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -21,9 +22,14 @@ namespace doc {
       int x, int y, int w, int h,
       int cx, int cy, double angle);
 
+    // Draws "src" in the given parallelogram of "dst". Only the rows
+    // in [clipY, clipY+clipH) of "dst" are modified (clipH < 0 means
+    // all rows from clipY), so different threads can draw different
+    // bands of the same parallelogram.
     void parallelogram(Image* dst, const Image* src, const Image* mask,
       int x1, int y1, int x2, int y2,
-      int x3, int y3, int x4, int y4);
+      int x3, int y3, int x4, int y4,
+      int clipY = 0, int clipH = -1);
 
   } // namespace algorithm
 } // namespace doc
@@ -0,0 +1,53 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "gtest/gtest.h"
+
+#include "doc/algorithm/rotate.h"
+
+#include "doc/algorithm/random_image.h"
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/primitives.h"
+
+using namespace doc;
+using namespace gfx;
+
+TEST(Rotate, ParallelogramBands)
+{
+  for (auto pf : { IMAGE_RGB, IMAGE_GRAYSCALE, IMAGE_INDEXED }) {
+    ImageRef src(Image::create(pf, 37, 23));
+    doc::algorithm::random_image(src.get());
+
+    ImageRef a(Image::create(pf, 64, 64));
+    ImageRef b(Image::create(pf, 64, 64));
+    clear_image(a.get(), 0);
+    clear_image(b.get(), 0);
+
+    // Rotated parallelogram
+    const int x1 = 20, y1 = 2, x2 = 60, y2 = 18;
+    const int x3 = 44, y3 = 58, x4 = 4, y4 = 42;
+    doc::algorithm::parallelogram(a.get(), src.get(), nullptr,
+                                  x1, y1, x2, y2, x3, y3, x4, y4);
+
+    // Draw the same parallelogram in bands of different heights
+    for (int y=0, h=1; y<b->height(); y+=h, h=(h % 7)+1) {
+      doc::algorithm::parallelogram(b.get(), src.get(), nullptr,
+                                    x1, y1, x2, y2, x3, y3, x4, y4,
+                                    y, h);
+    }
+
+    ASSERT_FALSE(is_plain_image(a.get(), 0));
+    ASSERT_TRUE(is_same_image(a.get(), b.get()))
+      << "Pixel format=" << pf;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
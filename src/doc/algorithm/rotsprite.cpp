@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2020-2023  Igara Studio S.A.
+// Copyright (c) 2020-2024  Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,6 +9,7 @@
 #include "config.h"
 #endif
 
+#include "doc/algorithm/parallel_bands.h"
 #include "doc/algorithm/rotate.h"
 #include "doc/image_impl.h"
 #include "doc/primitives.h"
@@ -23,8 +24,10 @@ namespace algorithm {
 // http://en.wikipedia.org/wiki/Pixel_art_scaling_algorithms#EPX.2FScale2.C3.97.2FAdvMAME2.C3.97
 // http://scale2x.sourceforge.net/algorithm.html
 // http://scale2x.sourceforge.net/scale2xandepx.html
+// Scales the [y0, y1) rows of the src_w x src_h area of "src".
 template<typename ImageTraits>
-static void image_scale2x_tpl(Image* dst, const Image* src, int src_w, int src_h)
+static void image_scale2x_tpl(Image* dst, const Image* src, int src_w, int src_h,
+                              int y0, int y1)
 {
 #if 0      // TODO complete this implementation that should be faster
            // than using a lot of get/put_pixel_fast calls.
@@ -124,12 +127,12 @@ static void image_scale2x_tpl(Image* dst, const Image* src, int src_w, int src_h
 #define D c[3]
 #define P c[4]
 
-  LockImageBits<ImageTraits> dstBits(dst, gfx::Rect(0, 0, src_w*2, src_h*2));
+  LockImageBits<ImageTraits> dstBits(dst, gfx::Rect(0, y0*2, src_w*2, (y1-y0)*2));
   auto dstIt = dstBits.begin();
   auto dstIt2 = dstIt;
 
   color_t c[5];
-  for (int y=0; y<src_h; ++y) {
+  for (int y=y0; y<y1; ++y) {
     dstIt2 += src_w*2;
     for (int x=0; x<src_w; ++x) {
       P = get_pixel_fast<ImageTraits>(src, x, y);
@@ -156,21 +159,27 @@ static void image_scale2x_tpl(Image* dst, const Image* src, int src_w, int src_h
 
 static void image_scale2x(Image* dst, const Image* src, int src_w, int src_h)
 {
-  switch (src->pixelFormat()) {
-    case IMAGE_RGB:       image_scale2x_tpl<RgbTraits>(dst, src, src_w, src_h); break;
-    case IMAGE_GRAYSCALE: image_scale2x_tpl<GrayscaleTraits>(dst, src, src_w, src_h); break;
-    case IMAGE_INDEXED:   image_scale2x_tpl<IndexedTraits>(dst, src, src_w, src_h); break;
-    case IMAGE_BITMAP:    image_scale2x_tpl<BitmapTraits>(dst, src, src_w, src_h); break;
-  }
+  // Each band writes different rows of "dst"
+  for_each_band(src_h, [=](const int y, const int h){
+    switch (src->pixelFormat()) {
+      case IMAGE_RGB:       image_scale2x_tpl<RgbTraits>(dst, src, src_w, src_h, y, y+h); break;
+      case IMAGE_GRAYSCALE: image_scale2x_tpl<GrayscaleTraits>(dst, src, src_w, src_h, y, y+h); break;
+      case IMAGE_INDEXED:   image_scale2x_tpl<IndexedTraits>(dst, src, src_w, src_h, y, y+h); break;
+      case IMAGE_BITMAP:    image_scale2x_tpl<BitmapTraits>(dst, src, src_w, src_h, y, y+h); break;
+    }
+  });
 }
 
 void rotsprite_image(Image* bmp, const Image* spr, const Image* mask,
   int x1, int y1, int x2, int y2,
   int x3, int y3, int x4, int y4)
 {
-  static ImageBufferPtr buf[3]; // TODO non-thread safe
+  // Buffers per thread (RotSprite can be used from background
+  // threads), they are reused between calls to avoid allocating the
+  // big intermediate images each time
+  static thread_local ImageBufferPtr buf[4];
 
-  for (int i=0; i<3; ++i)
+  for (int i=0; i<4; ++i)
     if (!buf[i])
       buf[i].reset(new ImageBuffer(1));
 
@@ -199,15 +208,15 @@ void rotsprite_image(Image* bmp, const Image* spr, const Image* mask,
   spr_copy->clear(maskColor);
   spr_copy->copy(spr, gfx::Clip(spr->bounds()));
 
+  // Scale 2x three times swapping the source/destination images
+  // (instead of copying the whole result in each pass)
   for (int i=0; i<3; ++i) {
-    // clear_image(tmp_copy, maskColor);
     image_scale2x(tmp_copy.get(), spr_copy.get(), spr->width()*(1<<i), spr->height()*(1<<i));
-    spr_copy->copy(tmp_copy.get(), gfx::Clip(tmp_copy->bounds()));
+    std::swap(tmp_copy, spr_copy);
   }
 
   if (mask) {
-    // Same ImageBuffer than tmp_copy
-    msk_copy.reset(Image::create(IMAGE_BITMAP, mask->width()*scale, mask->height()*scale, buf[1]));
+    msk_copy.reset(Image::create(IMAGE_BITMAP, mask->width()*scale, mask->height()*scale, buf[3]));
     clear_image(msk_copy.get(), 0);
     scale_image(msk_copy.get(), mask,
                 0, 0, msk_copy->width(), msk_copy->height(),
@@ -215,10 +224,15 @@ void rotsprite_image(Image* bmp, const Image* spr, const Image* mask,
   }
 
   clear_image(bmp_copy.get(), maskColor);
-  parallelogram(
-    bmp_copy.get(), spr_copy.get(), msk_copy.get(),
-    (x1-xmin)*scale, (y1-ymin)*scale, (x2-xmin)*scale, (y2-ymin)*scale,
-    (x3-xmin)*scale, (y3-ymin)*scale, (x4-xmin)*scale, (y4-ymin)*scale);
+
+  // Each band draws different rows of "bmp_copy"
+  for_each_band(bmp_copy->height(), [&](const int y, const int h){
+    parallelogram(
+      bmp_copy.get(), spr_copy.get(), msk_copy.get(),
+      (x1-xmin)*scale, (y1-ymin)*scale, (x2-xmin)*scale, (y2-ymin)*scale,
+      (x3-xmin)*scale, (y3-ymin)*scale, (x4-xmin)*scale, (y4-ymin)*scale,
+      y, h);
+  });
 
   scale_image(bmp, bmp_copy.get(),
               std::max(0, xmin),
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2023 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -21,150 +21,220 @@
 #include "doc/primitives_fast.h"
 #include "doc/tileset.h"
 
-#include <thread>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_WIN64)
+  #include <emmintrin.h>
+#endif
 
 namespace doc {
 namespace algorithm {
 
 namespace {
 
+#if defined(__x86_64__) || defined(_WIN64)
+
 template<typename ImageTraits>
-bool is_same_pixel(color_t pixel1, color_t pixel2)
-{
-  static_assert(false && sizeof(ImageTraits), "No is_same_pixel impl");
-  return false;
-}
+__m128i simd_set1(typename ImageTraits::pixel_t pixel);
+template<typename ImageTraits>
+__m128i simd_cmpeq(__m128i a, __m128i b);
 
-template<>
-bool is_same_pixel<RgbTraits>(color_t pixel1, color_t pixel2)
-{
-  return (rgba_geta(pixel1) == 0 && rgba_geta(pixel2) == 0) || (pixel1 == pixel2);
-}
+template<> __m128i simd_set1<RgbTraits>(uint32_t pixel) { return _mm_set1_epi32(int(pixel)); }
+template<> __m128i simd_set1<GrayscaleTraits>(uint16_t pixel) { return _mm_set1_epi16(short(pixel)); }
+template<> __m128i simd_set1<IndexedTraits>(uint8_t pixel) { return _mm_set1_epi8(char(pixel)); }
+template<> __m128i simd_cmpeq<RgbTraits>(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+template<> __m128i simd_cmpeq<GrayscaleTraits>(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+template<> __m128i simd_cmpeq<IndexedTraits>(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
 
-template<>
-bool is_same_pixel<GrayscaleTraits>(color_t pixel1, color_t pixel2)
-{
-  return (graya_geta(pixel1) == 0 && graya_geta(pixel2) == 0) || (pixel1 == pixel2);
-}
+#endif
+
+// A pixel matches the reference pixel when (pixel & mask) == value,
+// i.e. it's equal to the reference pixel, or both are transparent
+// (RGB/Grayscale).
+template<typename ImageTraits>
+class PixelMatcher {
+public:
+  using pixel_t = typename ImageTraits::pixel_t;
+
+  PixelMatcher(const color_t refpixel) {
+    m_mask = ImageTraits::max_value;
+    m_value = pixel_t(refpixel);
+    m_valid = (refpixel <= ImageTraits::max_value);
+  }
+
+  // False if no pixel of the image can match the reference pixel
+  bool isValid() const { return m_valid; }
+  pixel_t mask() const { return m_mask; }
+  pixel_t value() const { return m_value; }
+
+  bool match(const pixel_t pixel) const {
+    return ((pixel & m_mask) == m_value);
+  }
+
+protected:
+  pixel_t m_mask;
+  pixel_t m_value;
+  bool m_valid;
+};
 
 template<>
-bool is_same_pixel<IndexedTraits>(color_t pixel1, color_t pixel2)
+PixelMatcher<RgbTraits>::PixelMatcher(const color_t refpixel)
 {
-  return pixel1 == pixel2;
+  if (rgba_geta(refpixel) == 0) {
+    m_mask = rgba_a_mask;
+    m_value = 0;
+  }
+  else {
+    m_mask = RgbTraits::max_value;
+    m_value = refpixel;
+  }
+  m_valid = true;
 }
 
 template<>
-bool is_same_pixel<BitmapTraits>(color_t pixel1, color_t pixel2)
+PixelMatcher<GrayscaleTraits>::PixelMatcher(const color_t refpixel)
 {
-  return pixel1 == pixel2;
+  if (graya_geta(refpixel) == 0) {
+    m_mask = graya_a_mask;
+    m_value = 0;
+    m_valid = true;
+  }
+  else {
+    m_mask = GrayscaleTraits::max_value;
+    m_value = pixel_t(refpixel);
+    m_valid = (refpixel <= GrayscaleTraits::max_value);
+  }
 }
 
+// Returns the first "x" in [x, x2) of the given row where the pixel
+// doesn't match, or x2 if all pixels match.
 template<typename ImageTraits>
-bool shrink_bounds_left_templ(const Image* image, gfx::Rect& bounds, color_t refpixel, int rowPixels)
+int find_first_mismatch(const Image* image, const int y, int x, const int x2,
+                        const PixelMatcher<ImageTraits>& matcher)
 {
-  int u, v;
-  // Shrink left side
-  for (u=bounds.x; u<bounds.x2(); ++u) {
-    auto ptr = get_pixel_address_fast<ImageTraits>(image, u, v=bounds.y);
-    for (; v<bounds.y2(); ++v, ptr+=rowPixels) {
-      ASSERT(ptr == get_pixel_address_fast<ImageTraits>(image, u, v));
-      if (!is_same_pixel<ImageTraits>(*ptr, refpixel))
-        return (!bounds.isEmpty());
-    }
-    ++bounds.x;
-    --bounds.w;
+  if (x >= x2)
+    return x2;
+
+  auto ptr = (typename ImageTraits::const_address_t)image->getPixelAddress(x, y);
+
+#if defined(__x86_64__) || defined(_WIN64)
+  // Use SSE2 to compare 16 bytes (4, 8, or 16 pixels) at once
+  constexpr int N = 16 / ImageTraits::bytes_per_pixel;
+  const __m128i mask = simd_set1<ImageTraits>(matcher.mask());
+  const __m128i value = simd_set1<ImageTraits>(matcher.value());
+  for (; x+N<=x2; x+=N, ptr+=N) {
+    const __m128i r = simd_cmpeq<ImageTraits>(
+      _mm_and_si128(_mm_loadu_si128((const __m128i*)ptr), mask), value);
+    if (_mm_movemask_epi8(r) != 0xffff)
+      break;
   }
-  return (!bounds.isEmpty());
+#endif
+
+  for (; x<x2; ++x, ++ptr) {
+    ASSERT(ptr == get_pixel_address_fast<ImageTraits>(image, x, y));
+    if (!matcher.match(*ptr))
+      return x;
+  }
+  return x2;
 }
 
+// Returns the last "x" in [x1, x2) of the given row where the pixel
+// doesn't match, or x1-1 if all pixels match.
 template<typename ImageTraits>
-bool shrink_bounds_right_templ(const Image* image, gfx::Rect& bounds, color_t refpixel, int rowPixels)
+int find_last_mismatch(const Image* image, const int y, const int x1, int x2,
+                       const PixelMatcher<ImageTraits>& matcher)
 {
-  int u, v;
-  // Shrink right side
-  for (u=bounds.x2()-1; u>=bounds.x; --u) {
-    auto ptr = get_pixel_address_fast<ImageTraits>(image, u, v=bounds.y);
-    for (; v<bounds.y2(); ++v, ptr+=rowPixels) {
-      ASSERT(ptr == get_pixel_address_fast<ImageTraits>(image, u, v));
-      if (!is_same_pixel<ImageTraits>(*ptr, refpixel))
-        return (!bounds.isEmpty());
-    }
-    --bounds.w;
+  if (x1 >= x2)
+    return x1-1;
+
+  // Pointer to the pixel at x2 (which can be outside the row)
+  auto ptr = (typename ImageTraits::const_address_t)image->getPixelAddress(x1, y);
+  ptr += (x2 - x1);
+
+#if defined(__x86_64__) || defined(_WIN64)
+  constexpr int N = 16 / ImageTraits::bytes_per_pixel;
+  const __m128i mask = simd_set1<ImageTraits>(matcher.mask());
+  const __m128i value = simd_set1<ImageTraits>(matcher.value());
+  for (; x2-N>=x1; x2-=N, ptr-=N) {
+    const __m128i r = simd_cmpeq<ImageTraits>(
+      _mm_and_si128(_mm_loadu_si128((const __m128i*)(ptr-N)), mask), value);
+    if (_mm_movemask_epi8(r) != 0xffff)
+      break;
   }
-  return (!bounds.isEmpty());
+#endif
+
+  for (--ptr; x2>x1; --x2, --ptr) {
+    ASSERT(ptr == get_pixel_address_fast<ImageTraits>(image, x2-1, y));
+    if (!matcher.match(*ptr))
+      return x2-1;
+  }
+  return x1-1;
 }
 
-template<typename ImageTraits>
-bool shrink_bounds_top_templ(const Image* image, gfx::Rect& bounds, color_t refpixel)
+// Bitmaps don't have one pixel per byte, we compare each pixel.
+template<>
+int find_first_mismatch<BitmapTraits>(const Image* image, const int y, int x, const int x2,
+                                      const PixelMatcher<BitmapTraits>& matcher)
 {
-  int u, v;
-  // Shrink top side
-  for (v=bounds.y; v<bounds.y2(); ++v) {
-    auto ptr = get_pixel_address_fast<ImageTraits>(image, u=bounds.x, v);
-    for (; u<bounds.x2(); ++u, ++ptr) {
-      ASSERT(ptr == get_pixel_address_fast<ImageTraits>(image, u, v));
-      if (!is_same_pixel<ImageTraits>(*ptr, refpixel))
-        return (!bounds.isEmpty());
-    }
-    ++bounds.y;
-    --bounds.h;
+  for (; x<x2; ++x) {
+    if (!matcher.match(get_pixel_fast<BitmapTraits>(image, x, y)))
+      return x;
   }
-  return (!bounds.isEmpty());
+  return x2;
 }
 
-template<typename ImageTraits>
-bool shrink_bounds_bottom_templ(const Image* image, gfx::Rect& bounds, color_t refpixel)
+template<>
+int find_last_mismatch<BitmapTraits>(const Image* image, const int y, const int x1, int x2,
+                                     const PixelMatcher<BitmapTraits>& matcher)
 {
-  int u, v;
-  // Shrink bottom side
-  for (v=bounds.y2()-1; v>=bounds.y; --v) {
-    auto ptr = get_pixel_address_fast<ImageTraits>(image, u=bounds.x, v);
-    for (; u<bounds.x2(); ++u, ++ptr) {
-      ASSERT(ptr == get_pixel_address_fast<ImageTraits>(image, u, v));
-      if (!is_same_pixel<ImageTraits>(*ptr, refpixel))
-        return (!bounds.isEmpty());
-    }
-    --bounds.h;
+  for (--x2; x2>=x1; --x2) {
+    if (!matcher.match(get_pixel_fast<BitmapTraits>(image, x2, y)))
+      return x2;
   }
-  return (!bounds.isEmpty());
+  return x1-1;
 }
 
+// All borders are shrunk scanning rows (which are contiguous in
+// memory) instead of columns: first the top/bottom rows, and then
+// each row of the remaining area from the left/right sides until
+// the current left/right limits (so most of the pixels inside the
+// final bounds are never visited).
 template<typename ImageTraits>
 bool shrink_bounds_templ(const Image* image, gfx::Rect& bounds, color_t refpixel)
 {
-  // Pixels per row
-  const int rowPixels = image->rowPixels();
-  const int canvasSize = image->width()*image->height();
-  if ((std::thread::hardware_concurrency() >= 4) &&
-      ((image->pixelFormat() == IMAGE_RGB && canvasSize >= 800*800) ||
-       (image->pixelFormat() != IMAGE_RGB && canvasSize >= 500*500))) {
-    gfx::Rect
-      leftBounds(bounds), rightBounds(bounds),
-      topBounds(bounds), bottomBounds(bounds);
-
-    // TODO use a base::thread_pool and a base::task for each border
-
-    std::thread left  ([&]{ shrink_bounds_left_templ  <ImageTraits>(image, leftBounds, refpixel, rowPixels); });
-    std::thread right ([&]{ shrink_bounds_right_templ <ImageTraits>(image, rightBounds, refpixel, rowPixels); });
-    std::thread top   ([&]{ shrink_bounds_top_templ   <ImageTraits>(image, topBounds, refpixel); });
-    std::thread bottom([&]{ shrink_bounds_bottom_templ<ImageTraits>(image, bottomBounds, refpixel); });
-    left.join();
-    right.join();
-    top.join();
-    bottom.join();
-    bounds = leftBounds;
-    bounds &= rightBounds;
-    bounds &= topBounds;
-    bounds &= bottomBounds;
-    return !bounds.isEmpty();
+  const PixelMatcher<ImageTraits> matcher(refpixel);
+  if (!matcher.isValid())
+    return (!bounds.isEmpty());
+
+  const int x1 = bounds.x;
+  const int x2 = bounds.x2();
+
+  // Shrink top side
+  for (; bounds.h > 0; ++bounds.y, --bounds.h) {
+    if (find_first_mismatch<ImageTraits>(image, bounds.y, x1, x2, matcher) < x2)
+      break;
   }
-  else {
-    return
-      shrink_bounds_left_templ<ImageTraits>(image, bounds, refpixel, rowPixels) &&
-      shrink_bounds_right_templ<ImageTraits>(image, bounds, refpixel, rowPixels) &&
-      shrink_bounds_top_templ<ImageTraits>(image, bounds, refpixel) &&
-      shrink_bounds_bottom_templ<ImageTraits>(image, bounds, refpixel);
+  if (bounds.isEmpty())
+    return false;
+
+  // Shrink bottom side (it stops at least in the top row)
+  while (find_first_mismatch<ImageTraits>(image, bounds.y2()-1, x1, x2, matcher) == x2)
+    --bounds.h;
+
+  // Shrink left/right sides
+  int left = x2;
+  int right = x1-1;
+  for (int y=bounds.y; y<bounds.y2(); ++y) {
+    left = find_first_mismatch<ImageTraits>(image, y, x1, left, matcher);
+    right = std::max(right, find_last_mismatch<ImageTraits>(image, y, right+1, x2, matcher));
+    if (left == x1 && right == x2-1)
+      break;
   }
+  ASSERT(left <= right);
+
+  bounds.x = left;
+  bounds.w = right - left + 1;
+  return (!bounds.isEmpty());
 }
 
 template<typename ImageTraits>
@@ -363,11 +433,32 @@ bool shrink_bounds(const Image* image,
   return shrink_bounds(image, refpixel, layer, image->bounds(), bounds);
 }
 
+bool shrink_bounds_cached(const Image* image,
+                          const color_t refpixel,
+                          const Layer* layer,
+                          gfx::Rect& bounds)
+{
+  // Shrinking tilemaps depends on the tileset too
+  if (image->isTilemap())
+    return shrink_bounds(image, refpixel, layer, bounds);
+
+  bool nonEmpty;
+  if (image->getCachedShrinkBounds(refpixel, nonEmpty, bounds))
+    return nonEmpty;
+
+  nonEmpty = shrink_bounds(image, refpixel, layer, bounds);
+  image->setCachedShrinkBounds(refpixel, nonEmpty, bounds);
+  return nonEmpty;
+}
+
 bool shrink_cel_bounds(const Cel* cel,
                        const color_t refpixel,
-                       gfx::Rect& bounds)
+                       gfx::Rect& bounds,
+                       const bool useCache)
 {
-  if (shrink_bounds(cel->image(), refpixel, cel->layer(), bounds)) {
+  if (useCache ?
+      shrink_bounds_cached(cel->image(), refpixel, cel->layer(), bounds):
+      shrink_bounds(cel->image(), refpixel, cel->layer(), bounds)) {
     // For tilemaps, we have to convert imgBounds (in tiles
     // coordinates) to canvas coordinates using the Grid specs.
     if (cel->layer()->isTilemap()) {
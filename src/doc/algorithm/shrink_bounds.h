@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -32,9 +32,20 @@ namespace doc {
                        const Layer* layer,
                        gfx::Rect& bounds);
 
+    // Like shrink_bounds() for the whole image, but the result is
+    // cached in the image until its version changes. Use it only for
+    // images whose modifications increment their version (e.g. cel
+    // images modified through cmds), not for temporary images that
+    // are modified directly.
+    bool shrink_bounds_cached(const Image* image,
+                              const color_t refpixel,
+                              const Layer* layer,
+                              gfx::Rect& bounds);
+
     bool shrink_cel_bounds(const Cel* cel,
                            const color_t refpixel,
-                           gfx::Rect& bounds);
+                           gfx::Rect& bounds,
+                           const bool useCache = false);
 
     bool shrink_bounds2(const Image* a,
                         const Image* b,
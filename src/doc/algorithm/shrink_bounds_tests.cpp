@@ -0,0 +1,102 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "gtest/gtest.h"
+
+#include "doc/algorithm/shrink_bounds.h"
+
+#include "doc/color.h"
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/primitives.h"
+
+using namespace doc;
+using namespace gfx;
+
+TEST(ShrinkBounds, Pixels)
+{
+  for (auto pf : { IMAGE_RGB, IMAGE_GRAYSCALE, IMAGE_INDEXED, IMAGE_BITMAP }) {
+    for (int w=1; w<70; w+=3) {
+      for (int h=1; h<20; h+=3) {
+        ImageRef img(Image::create(pf, w, h));
+        clear_image(img.get(), 0);
+
+        Rect bounds;
+        EXPECT_FALSE(algorithm::shrink_bounds(img.get(), 0, nullptr, bounds));
+
+        const color_t c = (pf == IMAGE_RGB ? rgba(255, 0, 0, 255):
+                           pf == IMAGE_GRAYSCALE ? graya(255, 255): 1);
+        put_pixel(img.get(), w/2, h-1, c);
+        put_pixel(img.get(), w-1, h/3, c);
+        EXPECT_TRUE(algorithm::shrink_bounds(img.get(), 0, nullptr, bounds));
+        EXPECT_EQ(Rect(w/2, h/3, w-w/2, h-h/3), bounds)
+          << "Pixel format=" << pf << " Size=" << w << "x" << h;
+
+        // Use start bounds that don't include the last column
+        if (w > 1 && w/2 < w-1) {
+          EXPECT_TRUE(algorithm::shrink_bounds(img.get(), 0, nullptr,
+                                               Rect(0, 0, w-1, h), bounds));
+          EXPECT_EQ(Rect(w/2, h-1, 1, 1), bounds);
+        }
+      }
+    }
+  }
+}
+
+TEST(ShrinkBounds, TransparentPixels)
+{
+  ImageRef img(Image::create(IMAGE_RGB, 40, 10));
+  clear_image(img.get(), rgba(255, 255, 255, 0));
+  put_pixel(img.get(), 3, 2, rgba(0, 0, 0, 0));
+  put_pixel(img.get(), 30, 7, rgba(0, 0, 0, 1));
+
+  // Transparent pixels match any other transparent pixel
+  Rect bounds;
+  EXPECT_TRUE(algorithm::shrink_bounds(img.get(), 0, nullptr, bounds));
+  EXPECT_EQ(Rect(30, 7, 1, 1), bounds);
+
+  // Opaque reference pixels must be equal
+  clear_image(img.get(), rgba(255, 255, 255, 255));
+  put_pixel(img.get(), 3, 2, rgba(255, 255, 254, 255));
+  EXPECT_TRUE(algorithm::shrink_bounds(img.get(), rgba(255, 255, 255, 255),
+                                       nullptr, bounds));
+  EXPECT_EQ(Rect(3, 2, 1, 1), bounds);
+}
+
+TEST(ShrinkBounds, Cached)
+{
+  ImageRef img(Image::create(IMAGE_RGB, 32, 16));
+  clear_image(img.get(), 0);
+  put_pixel(img.get(), 4, 5, rgba(255, 0, 0, 255));
+
+  Rect bounds;
+  EXPECT_TRUE(algorithm::shrink_bounds_cached(img.get(), 0, nullptr, bounds));
+  EXPECT_EQ(Rect(4, 5, 1, 1), bounds);
+
+  // The cached bounds are used while the version is the same
+  put_pixel(img.get(), 8, 9, rgba(255, 0, 0, 255));
+  EXPECT_TRUE(algorithm::shrink_bounds_cached(img.get(), 0, nullptr, bounds));
+  EXPECT_EQ(Rect(4, 5, 1, 1), bounds);
+
+  img->incrementVersion();
+  EXPECT_TRUE(algorithm::shrink_bounds_cached(img.get(), 0, nullptr, bounds));
+  EXPECT_EQ(Rect(4, 5, 5, 5), bounds);
+
+  // Other reference color
+  EXPECT_TRUE(algorithm::shrink_bounds_cached(img.get(), rgba(255, 0, 0, 255),
+                                              nullptr, bounds));
+  EXPECT_EQ(Rect(0, 0, 32, 16), bounds);
+
+  clear_image(img.get(), 0);
+  img->incrementVersion();
+  EXPECT_FALSE(algorithm::shrink_bounds_cached(img.get(), 0, nullptr, bounds));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2023 Igara Studio S.A.
+// Copyright (c) 2023-2024 Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -15,13 +15,26 @@
 //#define DOC_USE_ALIGNED_PIXELS 1
 
 #if DOC_USE_ALIGNED_PIXELS
-  #define doc_align_size(size)    (base_align_size(size))
-  #define doc_aligned_alloc(size) base_aligned_alloc(size)
-  #define doc_aligned_free(ptr)   base_aligned_free(ptr)
+  #include <cstring>
+
+  #define doc_align_size(size)     (base_align_size(size))
+  #define doc_aligned_alloc(size)  base_aligned_alloc(size)
+  #define doc_aligned_calloc(size) doc_aligned_calloc_impl(size)
+  #define doc_aligned_free(ptr)    base_aligned_free(ptr)
+
+  inline void* doc_aligned_calloc_impl(std::size_t size) {
+    void* ptr = base_aligned_alloc(size);
+    if (ptr)
+      std::memset(ptr, 0, size);
+    return ptr;
+  }
 #else
-  #define doc_align_size(size)    (size)
-  #define doc_aligned_alloc(size) malloc(size)
-  #define doc_aligned_free(ptr)   free(ptr)
+  // calloc() can return pages that are zeroed by the OS on demand
+  // for big blocks, so we don't touch all the memory to clear it
+  #define doc_align_size(size)     (size)
+  #define doc_aligned_alloc(size)  malloc(size)
+  #define doc_aligned_calloc(size) calloc(1, size)
+  #define doc_aligned_free(ptr)    free(ptr)
 #endif
 
 #endif
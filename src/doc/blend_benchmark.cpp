@@ -12,6 +12,8 @@
 
 #include <benchmark/benchmark.h>
 
+#include <vector>
+
 using namespace doc;
 
 static void CustomArguments(benchmark::internal::Benchmark* b) {
@@ -53,4 +55,24 @@ BENCHMARK_TEMPLATE(BM_Rgba, rgba_blender_hsl_saturation)->Apply(CustomArguments)
 BENCHMARK_TEMPLATE(BM_Rgba, rgba_blender_hsl_color)->Apply(CustomArguments);
 BENCHMARK_TEMPLATE(BM_Rgba, rgba_blender_hsl_luminosity)->Apply(CustomArguments);
 
+template<BlendMode M>
+void BM_RgbaRow(benchmark::State& state) {
+  const int w = state.range(0);
+  const int opacity = state.range(1);
+  std::vector<color_t> src(w), dst(w);
+  for (int x=0; x<w; ++x) {
+    src[x] = rgba(x & 255, 128, 64, (x*7) & 255);
+    dst[x] = rgba(32, x & 255, 200, 255);
+  }
+  BlendRowFunc func = get_rgba_row_blender(M, true);
+  while (state.KeepRunning())
+    func(dst.data(), src.data(), w, opacity, 0);
+}
+
+BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::NORMAL)->Args({ 1920, 255 })->Args({ 1920, 128 });
+BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::MULTIPLY)->Args({ 1920, 255 })->Args({ 1920, 128 });
+BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::SCREEN)->Args({ 1920, 255 })->Args({ 1920, 128 });
+BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::ADDITION)->Args({ 1920, 255 })->Args({ 1920, 128 });
+BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::DIFFERENCE)->Args({ 1920, 255 })->Args({ 1920, 128 });
+
 BENCHMARK_MAIN();
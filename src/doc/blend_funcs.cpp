@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2022 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -25,6 +25,11 @@
 #include <algorithm>
 #include <cmath>
 
+#if defined(__x86_64__) || defined(_WIN64)
+  #include <emmintrin.h>
+  #define DOC_BLEND_ROWS_SSE2 1
+#endif
+
 namespace  {
 
 #define blend_multiply(b, s, t)   (MUL_UN8((b), (s), (t)))
@@ -754,6 +759,342 @@ color_t indexed_blender_src(color_t dst, color_t src, int opacity)
   return src;
 }
 
+//////////////////////////////////////////////////////////////////////
+// RGB row blenders
+//
+// These blend a whole scanline at once so the compiler can inline the
+// blend function (and we can use SSE2 on x86-64 to process 4 pixels
+// at the same time). The results must be exactly the same as the
+// per-pixel rgba_blender_*() functions.
+
+namespace {
+
+#if DOC_BLEND_ROWS_SSE2
+
+// Four RGBA pixels unpacked in 32-bit lanes (one register per channel)
+struct Rgba4 {
+  __m128i r, g, b, a;
+
+  explicit Rgba4(const __m128i p) {
+    const __m128i ff = _mm_set1_epi32(0xff);
+    r = _mm_and_si128(p, ff);
+    g = _mm_and_si128(_mm_srli_epi32(p, rgba_g_shift), ff);
+    b = _mm_and_si128(_mm_srli_epi32(p, rgba_b_shift), ff);
+    a = _mm_srli_epi32(p, rgba_a_shift);
+  }
+};
+
+inline __m128i pack_rgba4(const __m128i r, const __m128i g,
+                          const __m128i b, const __m128i a)
+{
+  return _mm_or_si128(
+    _mm_or_si128(r, _mm_slli_epi32(g, rgba_g_shift)),
+    _mm_or_si128(_mm_slli_epi32(b, rgba_b_shift),
+                 _mm_slli_epi32(a, rgba_a_shift)));
+}
+
+// Returns (mask ? a: b) for each lane
+inline __m128i select_si128(const __m128i mask, const __m128i a, const __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a),
+                      _mm_andnot_si128(mask, b));
+}
+
+// a*b for 32-bit lanes where values fit in 16 bits and "b" is
+// positive (_mm_mullo_epi32() is SSE4.1)
+inline __m128i mul_epi32_16(const __m128i a, const __m128i b)
+{
+  return _mm_madd_epi16(a, b);
+}
+
+// Same as MUL_UN8() for 32-bit lanes ("a" can be negative)
+inline __m128i mul_un8_epi32(const __m128i a, const __m128i b)
+{
+  const __m128i t = _mm_add_epi32(mul_epi32_16(a, b), _mm_set1_epi32(0x80));
+  return _mm_srai_epi32(_mm_add_epi32(_mm_srai_epi32(t, 8), t), 8);
+}
+
+// Integer division truncated toward zero. As |n| <= 255*255 and
+// 0 < d <= 255, the float division is exact enough to get the same
+// result as the int division.
+inline __m128i div_epi32(const __m128i n, const __m128 d)
+{
+  return _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(n), d));
+}
+
+inline __m128i rgba_blender_normal_sse2(const __m128i backdrop,
+                                        const __m128i src,
+                                        const __m128i opacity)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const Rgba4 B(backdrop);
+  const Rgba4 S(src);
+
+  const __m128i Sa = mul_un8_epi32(S.a, opacity);
+
+  // Backdrop alpha == 0
+  const __m128i res0 = _mm_or_si128(
+    _mm_and_si128(src, _mm_set1_epi32(rgba_rgb_mask)),
+    _mm_slli_epi32(Sa, rgba_a_shift));
+
+  const __m128i Ra = _mm_sub_epi32(_mm_add_epi32(Sa, B.a),
+                                   mul_un8_epi32(B.a, Sa));
+
+  // Avoid dividing by zero in lanes that will be discarded anyway
+  // (the high 16 bits of each lane are zero, so max_epi16 works).
+  const __m128 RaF = _mm_cvtepi32_ps(_mm_max_epi16(Ra, _mm_set1_epi32(1)));
+
+  const __m128i Rr = _mm_add_epi32(B.r, div_epi32(mul_epi32_16(_mm_sub_epi32(S.r, B.r), Sa), RaF));
+  const __m128i Rg = _mm_add_epi32(B.g, div_epi32(mul_epi32_16(_mm_sub_epi32(S.g, B.g), Sa), RaF));
+  const __m128i Rb = _mm_add_epi32(B.b, div_epi32(mul_epi32_16(_mm_sub_epi32(S.b, B.b), Sa), RaF));
+
+  __m128i res = pack_rgba4(Rr, Rg, Rb, Ra);
+  res = select_si128(_mm_cmpeq_epi32(S.a, zero), backdrop, res);
+  res = select_si128(_mm_cmpeq_epi32(B.a, zero), res0, res);
+  return res;
+}
+
+inline __m128i rgba_blender_merge_sse2(const __m128i backdrop,
+                                       const __m128i src,
+                                       const __m128i opacity)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const Rgba4 B(backdrop);
+  const Rgba4 S(src);
+
+  __m128i Rr = _mm_add_epi32(B.r, mul_un8_epi32(_mm_sub_epi32(S.r, B.r), opacity));
+  __m128i Rg = _mm_add_epi32(B.g, mul_un8_epi32(_mm_sub_epi32(S.g, B.g), opacity));
+  __m128i Rb = _mm_add_epi32(B.b, mul_un8_epi32(_mm_sub_epi32(S.b, B.b), opacity));
+  const __m128i Ra = _mm_add_epi32(B.a, mul_un8_epi32(_mm_sub_epi32(S.a, B.a), opacity));
+
+  const __m128i Sa0 = _mm_cmpeq_epi32(S.a, zero);
+  Rr = select_si128(Sa0, B.r, Rr);
+  Rg = select_si128(Sa0, B.g, Rg);
+  Rb = select_si128(Sa0, B.b, Rb);
+
+  const __m128i Ba0 = _mm_cmpeq_epi32(B.a, zero);
+  Rr = select_si128(Ba0, S.r, Rr);
+  Rg = select_si128(Ba0, S.g, Rg);
+  Rb = select_si128(Ba0, S.b, Rb);
+
+  const __m128i res = pack_rgba4(Rr, Rg, Rb, Ra);
+  return select_si128(_mm_cmpeq_epi32(Ra, zero), zero, res);
+}
+
+// Each blend mode converts the source RGB channels using the backdrop
+// channels, then composites the result with the normal blender.
+template<typename Mode>
+inline __m128i rgba_blender_mode_sse2(const __m128i backdrop,
+                                      const __m128i src,
+                                      const __m128i opacity)
+{
+  const Rgba4 B(backdrop);
+  const Rgba4 S(src);
+  const __m128i blended =
+    pack_rgba4(Mode::channel(B.r, S.r),
+               Mode::channel(B.g, S.g),
+               Mode::channel(B.b, S.b), S.a);
+  return rgba_blender_normal_sse2(backdrop, blended, opacity);
+}
+
+// Same as RGBA_BLENDER_N() macro
+template<typename Mode>
+inline __m128i rgba_blender_mode_n_sse2(const __m128i backdrop,
+                                        const __m128i src,
+                                        const __m128i opacity)
+{
+  const __m128i normal = rgba_blender_normal_sse2(backdrop, src, opacity);
+  const __m128i blend = rgba_blender_mode_sse2<Mode>(backdrop, src, opacity);
+  const __m128i Ba = _mm_srli_epi32(backdrop, rgba_a_shift);
+  const __m128i normalToBlendMerge = rgba_blender_merge_sse2(normal, blend, Ba);
+  const __m128i srcTotalAlpha = mul_un8_epi32(_mm_srli_epi32(src, rgba_a_shift), opacity);
+  const __m128i compositeAlpha = mul_un8_epi32(Ba, srcTotalAlpha);
+  const __m128i res = rgba_blender_merge_sse2(normalToBlendMerge, blend, compositeAlpha);
+  return select_si128(_mm_cmpeq_epi32(Ba, _mm_setzero_si128()), normal, res);
+}
+
+struct ModeMultiply {
+  static __m128i channel(const __m128i b, const __m128i s) {
+    return mul_un8_epi32(b, s);
+  }
+};
+
+struct ModeScreen {
+  static __m128i channel(const __m128i b, const __m128i s) {
+    return _mm_sub_epi32(_mm_add_epi32(b, s), mul_un8_epi32(b, s));
+  }
+};
+
+struct ModeAddition {
+  static __m128i channel(const __m128i b, const __m128i s) {
+    // Values are <= 510, so the high 16 bits of each lane are zero
+    return _mm_min_epi16(_mm_add_epi32(b, s), _mm_set1_epi32(255));
+  }
+};
+
+struct ModeDifference {
+  static __m128i channel(const __m128i b, const __m128i s) {
+    const __m128i d = _mm_sub_epi32(b, s);
+    const __m128i sign = _mm_srai_epi32(d, 31);
+    return _mm_sub_epi32(_mm_xor_si128(d, sign), sign);
+  }
+};
+
+struct Sse2Normal {
+  static __m128i blend(__m128i b, __m128i s, __m128i opacity) {
+    return rgba_blender_normal_sse2(b, s, opacity);
+  }
+};
+
+struct Sse2Merge {
+  static __m128i blend(__m128i b, __m128i s, __m128i opacity) {
+    return rgba_blender_merge_sse2(b, s, opacity);
+  }
+};
+
+template<typename Mode>
+struct Sse2Mode {
+  static __m128i blend(__m128i b, __m128i s, __m128i opacity) {
+    return rgba_blender_mode_sse2<Mode>(b, s, opacity);
+  }
+};
+
+template<typename Mode>
+struct Sse2ModeN {
+  static __m128i blend(__m128i b, __m128i s, __m128i opacity) {
+    return rgba_blender_mode_n_sse2<Mode>(b, s, opacity);
+  }
+};
+
+template<typename Sse2Blender, color_t (*ScalarBlender)(color_t, color_t, int)>
+void rgba_row_blender_sse2(color_t* dst, const color_t* src, int w,
+                           int opacity, color_t maskColor)
+{
+  const __m128i opacity4 = _mm_set1_epi32(opacity);
+  const __m128i maskColor4 = _mm_set1_epi32(maskColor);
+  int x = 0;
+
+  for (; x+4<=w; x+=4, dst+=4, src+=4) {
+    const __m128i s = _mm_loadu_si128((const __m128i*)src);
+    const __m128i skip = _mm_cmpeq_epi32(s, maskColor4);
+    if (_mm_movemask_epi8(skip) == 0xffff)
+      continue;
+
+    const __m128i b = _mm_loadu_si128((const __m128i*)dst);
+    const __m128i r = Sse2Blender::blend(b, s, opacity4);
+    _mm_storeu_si128((__m128i*)dst, select_si128(skip, b, r));
+  }
+
+  for (; x<w; ++x, ++dst, ++src) {
+    if (*src != maskColor)
+      *dst = ScalarBlender(*dst, *src, opacity);
+  }
+}
+
+#endif // DOC_BLEND_ROWS_SSE2
+
+// Scalar fallback, at least the blend function can be inlined
+template<color_t (*ScalarBlender)(color_t, color_t, int)>
+void rgba_row_blender_scalar(color_t* dst, const color_t* src, int w,
+                             int opacity, color_t maskColor)
+{
+  for (int x=0; x<w; ++x, ++dst, ++src) {
+    if (*src != maskColor)
+      *dst = ScalarBlender(*dst, *src, opacity);
+  }
+}
+
+template<color_t (*ScalarBlender)(color_t, color_t, int), bool LockAlpha>
+void rgba_color_row_blender_scalar(color_t* dst, const color_t* src, int w,
+                                   color_t color, int opacity)
+{
+  for (int x=0; x<w; ++x, ++dst, ++src) {
+    color_t c = ScalarBlender(*src, color, opacity);
+    if (LockAlpha)
+      c = (c & rgba_rgb_mask) | (*src & rgba_a_mask);
+    *dst = c;
+  }
+}
+
+#if DOC_BLEND_ROWS_SSE2
+
+template<typename Sse2Blender, color_t (*ScalarBlender)(color_t, color_t, int), bool LockAlpha>
+void rgba_color_row_blender_sse2(color_t* dst, const color_t* src, int w,
+                                 color_t color, int opacity)
+{
+  const __m128i color4 = _mm_set1_epi32(color);
+  const __m128i opacity4 = _mm_set1_epi32(opacity);
+  const __m128i alphaMask4 = _mm_set1_epi32(rgba_a_mask);
+  int x = 0;
+
+  for (; x+4<=w; x+=4, dst+=4, src+=4) {
+    const __m128i b = _mm_loadu_si128((const __m128i*)src);
+    __m128i r = Sse2Blender::blend(b, color4, opacity4);
+    if (LockAlpha)
+      r = select_si128(alphaMask4, b, r);
+    _mm_storeu_si128((__m128i*)dst, r);
+  }
+
+  rgba_color_row_blender_scalar<ScalarBlender, LockAlpha>(dst, src, w-x, color, opacity);
+}
+
+  #define COLOR_ROW_BLENDER(sse2, scalar, lockAlpha) \
+    rgba_color_row_blender_sse2<sse2, scalar, lockAlpha>
+#else
+  #define COLOR_ROW_BLENDER(sse2, scalar, lockAlpha) \
+    rgba_color_row_blender_scalar<scalar, lockAlpha>
+#endif
+
+// Minimum number of consecutive opaque pixels to copy them directly
+// instead of passing them to the row blender (short runs are cheaper
+// to blend than to split the row).
+const int kMinOpaqueRun = 8;
+
+inline bool is_opaque_src(const color_t c, const color_t maskColor)
+{
+  return ((c & rgba_a_mask) == rgba_a_mask && c != maskColor);
+}
+
+// NORMAL blend mode with opacity=255: a fully opaque source pixel
+// replaces the backdrop (rgba_blender_normal() returns "src" as it
+// is), so long runs of opaque pixels (e.g. background layers) are
+// just copied.
+template<BlendRowFunc RowBlender>
+void rgba_row_blender_normal(color_t* dst, const color_t* src, int w,
+                             int opacity, color_t maskColor)
+{
+  if (opacity < 255) {
+    RowBlender(dst, src, w, opacity, maskColor);
+    return;
+  }
+
+  int blendFrom = 0;
+  int x = 0;
+  while (x < w) {
+    if (!is_opaque_src(src[x], maskColor)) {
+      ++x;
+      continue;
+    }
+
+    int end = x+1;
+    while (end < w && is_opaque_src(src[end], maskColor))
+      ++end;
+
+    if (end - x >= kMinOpaqueRun) {
+      if (x > blendFrom)
+        RowBlender(dst+blendFrom, src+blendFrom, x-blendFrom, opacity, maskColor);
+      std::copy(src+x, src+end, dst+x);
+      blendFrom = end;
+    }
+    x = end;
+  }
+
+  if (w > blendFrom)
+    RowBlender(dst+blendFrom, src+blendFrom, w-blendFrom, opacity, maskColor);
+}
+
+} // anonymous namespace
+
 //////////////////////////////////////////////////////////////////////
 // getters
 
@@ -830,4 +1171,64 @@ BlendFunc get_indexed_blender(BlendMode blendmode, const bool newBlend)
   return indexed_blender_src;
 }
 
+void rgba_blend_color_row_normal(color_t* dst, const color_t* src, int w,
+                                 color_t color, int opacity)
+{
+  // An opaque color replaces each pixel
+  if (opacity == 255 && (color & rgba_a_mask) == rgba_a_mask) {
+    std::fill(dst, dst+w, color);
+    return;
+  }
+  COLOR_ROW_BLENDER(Sse2Normal, rgba_blender_normal, false)(dst, src, w, color, opacity);
+}
+
+void rgba_blend_color_row_merge(color_t* dst, const color_t* src, int w,
+                                color_t color, int opacity)
+{
+  if (opacity == 255 && (color & rgba_a_mask) == rgba_a_mask) {
+    std::fill(dst, dst+w, color);
+    return;
+  }
+  COLOR_ROW_BLENDER(Sse2Merge, rgba_blender_merge, false)(dst, src, w, color, opacity);
+}
+
+void rgba_blend_color_row_lock_alpha(color_t* dst, const color_t* src, int w,
+                                     color_t color, int opacity)
+{
+  COLOR_ROW_BLENDER(Sse2Normal, rgba_blender_normal, true)(dst, src, w, color, opacity);
+}
+
+#undef COLOR_ROW_BLENDER
+
+BlendRowFunc get_rgba_row_blender(BlendMode blendmode, const bool newBlend)
+{
+#if DOC_BLEND_ROWS_SSE2
+  #define ROW_BLENDER(sse2, scalar) rgba_row_blender_sse2<sse2, scalar>
+#else
+  #define ROW_BLENDER(sse2, scalar) rgba_row_blender_scalar<scalar>
+#endif
+
+  switch (blendmode) {
+    case BlendMode::NORMAL:
+      return rgba_row_blender_normal<ROW_BLENDER(Sse2Normal, rgba_blender_normal)>;
+    case BlendMode::MULTIPLY:
+      return (newBlend ? ROW_BLENDER(Sse2ModeN<ModeMultiply>, rgba_blender_multiply_n):
+                         ROW_BLENDER(Sse2Mode<ModeMultiply>, rgba_blender_multiply));
+    case BlendMode::SCREEN:
+      return (newBlend ? ROW_BLENDER(Sse2ModeN<ModeScreen>, rgba_blender_screen_n):
+                         ROW_BLENDER(Sse2Mode<ModeScreen>, rgba_blender_screen));
+    case BlendMode::ADDITION:
+      return (newBlend ? ROW_BLENDER(Sse2ModeN<ModeAddition>, rgba_blender_addition_n):
+                         ROW_BLENDER(Sse2Mode<ModeAddition>, rgba_blender_addition));
+    case BlendMode::DIFFERENCE:
+      return (newBlend ? ROW_BLENDER(Sse2ModeN<ModeDifference>, rgba_blender_difference_n):
+                         ROW_BLENDER(Sse2Mode<ModeDifference>, rgba_blender_difference));
+    default:
+      // Use the per-pixel BlendFunc
+      return nullptr;
+  }
+
+#undef ROW_BLENDER
+}
+
 } // namespace doc
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (c) 2001-2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -16,6 +16,11 @@ namespace doc {
 
   typedef color_t (*BlendFunc)(color_t backdrop, color_t src, int opacity);
 
+  // Blends a whole row of "w" RGBA pixels from "src" into "dst".
+  // Source pixels equal to "maskColor" are skipped.
+  typedef void (*BlendRowFunc)(color_t* dst, const color_t* src, int w,
+                               int opacity, color_t maskColor);
+
   color_t rgba_blender_src(color_t backdrop, color_t src, int opacity);
   color_t rgba_blender_merge(color_t backdrop, color_t src, int opacity);
   color_t rgba_blender_neg_bw(color_t backdrop, color_t src, int opacity);
@@ -68,6 +73,22 @@ namespace doc {
   BlendFunc get_graya_blender(BlendMode blendmode, const bool newBlend);
   BlendFunc get_indexed_blender(BlendMode blendmode, const bool newBlend);
 
+  // Returns a vectorized row blender for the given blend mode, or
+  // nullptr if the mode is only available as a per-pixel BlendFunc.
+  BlendRowFunc get_rgba_row_blender(BlendMode blendmode, const bool newBlend);
+
+  // Blend the same "color" over each one of the "w" RGBA pixels of
+  // "src" and put the results in "dst" ("dst" can be equal to
+  // "src"). The results are the same as calling the per-pixel
+  // blender, e.g. rgba_blender_normal(src[i], color, opacity).
+  void rgba_blend_color_row_normal(color_t* dst, const color_t* src, int w,
+                                   color_t color, int opacity);
+  void rgba_blend_color_row_merge(color_t* dst, const color_t* src, int w,
+                                  color_t color, int opacity);
+  // Same as rgba_blend_color_row_normal() keeping the alpha of "src".
+  void rgba_blend_color_row_lock_alpha(color_t* dst, const color_t* src, int w,
+                                       color_t color, int opacity);
+
 } // namespace doc
 
 #endif
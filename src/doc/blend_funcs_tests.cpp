@@ -0,0 +1,178 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/blend_funcs.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace doc;
+
+// Row blenders must give exactly the same results as the per-pixel
+// BlendFunc for the same blend mode.
+TEST(BlendFuncs, RowBlendersMatchPixelBlenders)
+{
+  const BlendMode modes[] = {
+    BlendMode::NORMAL,
+    BlendMode::MULTIPLY,
+    BlendMode::SCREEN,
+    BlendMode::ADDITION,
+    BlendMode::DIFFERENCE,
+  };
+
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<color_t> color(0, 0xffffffff);
+  std::uniform_int_distribution<int> opacity(0, 255);
+  std::uniform_int_distribution<int> kind(0, 4);
+
+  // Use an odd width to test the non-vectorized tail too
+  const int w = 37;
+  std::vector<color_t> src(w), dst1(w), dst2(w);
+
+  for (const BlendMode mode : modes) {
+    for (const bool newBlend : { false, true }) {
+      BlendFunc blender = get_rgba_blender(mode, newBlend);
+      BlendRowFunc rowBlender = get_rgba_row_blender(mode, newBlend);
+      ASSERT_TRUE(rowBlender != nullptr);
+
+      for (int i=0; i<500; ++i) {
+        for (int x=0; x<w; ++x) {
+          color_t b = color(gen);
+          color_t s = color(gen);
+          // Test special cases (transparent/opaque pixels)
+          switch (kind(gen)) {
+            case 0: b &= rgba_rgb_mask; break;
+            case 1: s &= rgba_rgb_mask; break;
+            case 2: b |= rgba_a_mask; break;
+            case 3: s |= rgba_a_mask; break;
+          }
+          dst1[x] = dst2[x] = b;
+          src[x] = s;
+        }
+
+        const int op = (i == 0 ? 255: i == 1 ? 0: opacity(gen));
+        const color_t maskColor = src[i % w];
+
+        for (int x=0; x<w; ++x) {
+          if (src[x] != maskColor)
+            dst1[x] = blender(dst1[x], src[x], op);
+        }
+        rowBlender(dst2.data(), src.data(), w, op, maskColor);
+
+        for (int x=0; x<w; ++x)
+          ASSERT_EQ(dst1[x], dst2[x]) << "blend mode " << int(mode)
+                                      << " newBlend " << newBlend
+                                      << " opacity " << op;
+      }
+    }
+  }
+}
+
+// NORMAL row blender copies runs of opaque pixels directly, the
+// result must be the same as blending them.
+TEST(BlendFuncs, NormalRowBlenderWithOpaqueRuns)
+{
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<color_t> color(0, 0xffffffff);
+  std::uniform_int_distribution<int> runLength(1, 20);
+
+  const int w = 301;
+  std::vector<color_t> src(w), dst1(w), dst2(w);
+
+  for (const bool newBlend : { false, true }) {
+    BlendFunc blender = get_rgba_blender(BlendMode::NORMAL, newBlend);
+    BlendRowFunc rowBlender = get_rgba_row_blender(BlendMode::NORMAL, newBlend);
+
+    for (int i=0; i<100; ++i) {
+      // Alternate runs of opaque and semi-transparent pixels
+      bool opaque = (i & 1);
+      for (int x=0; x<w; ) {
+        const int n = std::min(w-x, runLength(gen));
+        for (int j=0; j<n; ++j, ++x) {
+          color_t s = color(gen);
+          if (opaque)
+            s |= rgba_a_mask;
+          src[x] = s;
+          dst1[x] = dst2[x] = color(gen);
+        }
+        opaque = !opaque;
+      }
+
+      const color_t maskColor = (i & 2 ? src[i % w]: 0);
+      for (int x=0; x<w; ++x) {
+        if (src[x] != maskColor)
+          dst1[x] = blender(dst1[x], src[x], 255);
+      }
+      rowBlender(dst2.data(), src.data(), w, 255, maskColor);
+
+      for (int x=0; x<w; ++x)
+        ASSERT_EQ(dst1[x], dst2[x]) << "newBlend " << newBlend << " x " << x;
+    }
+  }
+}
+
+// Color row blenders (used by inks) must give the same results as
+// blending the color with the per-pixel blenders.
+TEST(BlendFuncs, ColorRowBlendersMatchPixelBlenders)
+{
+  std::mt19937 gen(2);
+  std::uniform_int_distribution<color_t> color(0, 0xffffffff);
+  std::uniform_int_distribution<int> opacity(0, 255);
+  std::uniform_int_distribution<int> kind(0, 2);
+
+  const int w = 37;
+  std::vector<color_t> src(w), dst1(w), dst2(w);
+
+  for (int i=0; i<1000; ++i) {
+    for (int x=0; x<w; ++x) {
+      color_t s = color(gen);
+      switch (kind(gen)) {
+        case 0: s &= rgba_rgb_mask; break;
+        case 1: s |= rgba_a_mask; break;
+      }
+      src[x] = s;
+    }
+
+    color_t c = color(gen);
+    switch (i % 3) {
+      case 0: c &= rgba_rgb_mask; break;
+      case 1: c |= rgba_a_mask; break;
+    }
+    const int op = (i % 5 == 0 ? 255: opacity(gen));
+
+    for (int x=0; x<w; ++x)
+      dst1[x] = rgba_blender_normal(src[x], c, op);
+    rgba_blend_color_row_normal(dst2.data(), src.data(), w, c, op);
+    ASSERT_EQ(dst1, dst2) << "normal opacity " << op;
+
+    for (int x=0; x<w; ++x)
+      dst1[x] = rgba_blender_merge(src[x], c, op);
+    rgba_blend_color_row_merge(dst2.data(), src.data(), w, c, op);
+    ASSERT_EQ(dst1, dst2) << "merge opacity " << op;
+
+    for (int x=0; x<w; ++x) {
+      const color_t r = rgba_blender_normal(src[x], c, op);
+      dst1[x] = (r & rgba_rgb_mask) | (src[x] & rgba_a_mask);
+    }
+    // In-place blending
+    dst2 = src;
+    rgba_blend_color_row_lock_alpha(dst2.data(), dst2.data(), w, c, op);
+    ASSERT_EQ(dst1, dst2) << "lock alpha opacity " << op;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
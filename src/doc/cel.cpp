@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2023 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -69,6 +69,10 @@ void Cel::setDataRef(const CelDataRef& celData)
 {
   ASSERT(celData);
   m_data = celData;
+
+  // Linking/unlinking cels changes the list of unique cels
+  if (m_layer)
+    m_layer->sprite()->incrementStructureVersion();
 }
 
 void Cel::setPosition(int x, int y)
@@ -98,7 +102,14 @@ void Cel::setOpacity(int opacity)
 
 void Cel::setZIndex(int zindex)
 {
+  if (m_zIndex == zindex)
+    return;
+
   m_zIndex = zindex;
+
+  // The z-index changes the render order of cels
+  if (m_layer && m_layer->sprite())
+    m_layer->sprite()->incrementStructureVersion();
 }
 
 Document* Cel::document() const
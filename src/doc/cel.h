@@ -80,6 +80,9 @@ namespace doc {
     CelDataRef m_data;
     int m_zIndex = 0;
 
+    // To change m_frame of all cels at once in permuteFrames()
+    friend class LayerImage;
+
     Cel();
     DISABLE_COPYING(Cel);
   };
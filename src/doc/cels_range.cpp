@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -26,6 +26,13 @@ CelsRange::CelsRange(const Sprite* sprite,
 {
 }
 
+CelsRange::CelsRange(const std::shared_ptr<const CelList>& cels)
+  : m_cels(cels)
+  , m_begin(m_selFrames, m_cels.get())
+  , m_end(m_selFrames)
+{
+}
+
 CelsRange::iterator::iterator(const SelectedFrames& selFrames)
   : m_cel(nullptr)
   , m_selFrames(selFrames)
@@ -62,11 +69,30 @@ CelsRange::iterator::iterator(const Sprite* sprite,
     m_visited.insert(m_cel->data()->id());
 }
 
+CelsRange::iterator::iterator(const SelectedFrames& selFrames,
+                              const CelList* cels)
+  : m_cel(nullptr)
+  , m_selFrames(selFrames)
+  , m_frameIterator(selFrames.begin())
+  , m_flags(CelsRange::ALL)
+  , m_cels(cels)
+  , m_celsIterator(cels->begin())
+{
+  if (m_celsIterator != m_cels->end())
+    m_cel = *m_celsIterator;
+}
+
 CelsRange::iterator& CelsRange::iterator::operator++()
 {
   if (!m_cel)
     return *this;
 
+  if (m_cels) {
+    ++m_celsIterator;
+    m_cel = (m_celsIterator != m_cels->end() ? *m_celsIterator: nullptr);
+    return *this;
+  }
+
   auto endFrame = m_selFrames.end();
   if (m_frameIterator != endFrame)
     ++m_frameIterator;
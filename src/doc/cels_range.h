@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
 // Copyright (c) 2001-2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -8,10 +9,12 @@
 #define DOC_CELS_RANGE_H_INCLUDED
 #pragma once
 
+#include "doc/cel_list.h"
 #include "doc/frame.h"
 #include "doc/object_id.h"
 #include "doc/selected_frames.h"
 
+#include <memory>
 #include <set>
 
 namespace doc {
@@ -32,6 +35,10 @@ namespace doc {
               const SelectedFrames& selFrames,
               const Flags flags = ALL);
 
+    // Iterates an already calculated list of cels (e.g. the cached
+    // list of unique cels of the sprite).
+    CelsRange(const std::shared_ptr<const CelList>& cels);
+
     class iterator {
     public:
       typedef Cel* value_type;
@@ -44,6 +51,8 @@ namespace doc {
       iterator(const Sprite* sprite,
                const SelectedFrames& selFrames,
                const Flags flags);
+      iterator(const SelectedFrames& selFrames,
+               const CelList* cels);
 
       bool operator==(const iterator& other) const {
         return m_cel == other.m_cel;
@@ -65,12 +74,18 @@ namespace doc {
       frames::const_iterator m_frameIterator;
       Flags m_flags;
       std::set<ObjectId> m_visited;
+      // Used when we iterate a list of cels
+      const CelList* m_cels = nullptr;
+      CelConstIterator m_celsIterator;
     };
 
     iterator begin() { return m_begin; }
     iterator end() { return m_end; }
 
     int size() {
+      if (m_cels)
+        return int(m_cels->size());
+
       int count = 0;
       for (auto it=begin(), e=end(); it!=e; ++it)
         ++count;
@@ -79,6 +94,7 @@ namespace doc {
 
   private:
     SelectedFrames m_selFrames;
+    std::shared_ptr<const CelList> m_cels;
     iterator m_begin, m_end;
   };
 
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2020 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -18,8 +18,14 @@
 #include "doc/primitives.h"
 #include "doc/rgbmap.h"
 
+#include <mutex>
+
 namespace doc {
 
+// The cached shrink bounds can be read/written from several threads
+// (e.g. linked cels processed in parallel)
+static std::mutex g_shrinkBoundsMutex;
+
 Image::Image(const ImageSpec& spec)
   : Object(ObjectType::Image)
   , m_spec(spec)
@@ -32,7 +38,48 @@ Image::~Image()
 
 int Image::getMemSize() const
 {
-  return sizeof(Image) + rowBytes()*height();
+  return sizeof(Image) + rowBytes()*height() + int(m_compressedData.size());
+}
+
+void Image::discardCompressedData()
+{
+  m_compressedData.clear();
+  m_compressedDataVersion = 0;
+}
+
+void Image::setCompressedData(const base::buffer& buffer,
+                              const int level) const
+{
+  if (!buffer.empty()) {
+    m_compressedData = buffer;
+    m_compressedDataVersion = version();
+    m_compressedDataLevel = level;
+  }
+}
+
+bool Image::getCachedShrinkBounds(const color_t refColor,
+                                  bool& nonEmpty,
+                                  gfx::Rect& bounds) const
+{
+  const std::lock_guard lock(g_shrinkBoundsMutex);
+  if (m_shrinkBoundsVersion != version()+1 ||
+      m_shrinkBoundsRefColor != refColor)
+    return false;
+
+  nonEmpty = m_shrinkBoundsNonEmpty;
+  bounds = m_shrinkBounds;
+  return true;
+}
+
+void Image::setCachedShrinkBounds(const color_t refColor,
+                                  const bool nonEmpty,
+                                  const gfx::Rect& bounds) const
+{
+  const std::lock_guard lock(g_shrinkBoundsMutex);
+  m_shrinkBoundsVersion = version()+1;
+  m_shrinkBoundsRefColor = refColor;
+  m_shrinkBoundsNonEmpty = nonEmpty;
+  m_shrinkBounds = bounds;
 }
 
 // static
@@ -64,8 +111,22 @@ Image* Image::create(const ImageSpec& spec,
 Image* Image::createCopy(const Image* image, const ImageBufferPtr& buffer)
 {
   ASSERT(image);
-  return crop_image(image, 0, 0, image->width(), image->height(),
-                    image->maskColor(), buffer);
+
+  Image* copy = Image::create(image->pixelFormat(),
+                              image->width(), image->height(), buffer);
+  if (!copy)
+    return nullptr;
+
+  copy->setMaskColor(image->maskColor());
+
+  // Both images store their rows contiguously with the same stride,
+  // so we can copy all pixels at once (instead of clearing the new
+  // image and copying it row by row)
+  ASSERT(copy->rowBytes() == image->rowBytes());
+  const uint8_t* src = image->getPixelAddress(0, 0);
+  std::copy(src, src + image->rowBytes()*image->height(),
+            copy->getPixelAddress(0, 0));
+  return copy;
 }
 
 } // namespace doc
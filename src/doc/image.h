@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,6 +9,7 @@
 #define DOC_IMAGE_H_INCLUDED
 #pragma once
 
+#include "base/buffer.h"
 #include "doc/color.h"
 #include "doc/color_mode.h"
 #include "doc/image_buffer.h"
@@ -72,6 +73,31 @@ namespace doc {
 
     virtual int getMemSize() const override;
 
+    // Cached compressed pixels read/written directly from .aseprite
+    // files. It's valid only while compressedDataVersion() is equal
+    // to version() (i.e. the image wasn't modified) and we want the
+    // same zlib compression level used to compress the data.
+    void discardCompressedData();
+    void setCompressedData(const base::buffer& buffer, int level) const;
+    const base::buffer& compressedData() const { return m_compressedData; }
+    ObjectVersion compressedDataVersion() const { return m_compressedDataVersion; }
+    int compressedDataLevel() const { return m_compressedDataLevel; }
+    bool hasValidCompressedData(const int level) const {
+      return (!m_compressedData.empty() &&
+              m_compressedDataVersion == version() &&
+              m_compressedDataLevel == level);
+    }
+
+    // Cached result of doc::algorithm::shrink_bounds_cached() for the
+    // whole image and one reference color. It's valid only while the
+    // image version is the same (see shrink_bounds_cached()).
+    bool getCachedShrinkBounds(const color_t refColor,
+                               bool& nonEmpty,
+                               gfx::Rect& bounds) const;
+    void setCachedShrinkBounds(const color_t refColor,
+                               const bool nonEmpty,
+                               const gfx::Rect& bounds) const;
+
     template<typename ImageTraits>
     ImageBits<ImageTraits> lockBits(LockType lockType, const gfx::Rect& bounds) {
       return ImageBits<ImageTraits>(this, bounds);
@@ -107,6 +133,19 @@ namespace doc {
 
   private:
     ImageSpec m_spec;
+
+    // Used to save the image again without re-compressing it when
+    // it's not modified (see AseFormat::onSave()).
+    mutable base::buffer m_compressedData;
+    mutable ObjectVersion m_compressedDataVersion = 0;
+    mutable int m_compressedDataLevel = 0;
+
+    // Cached shrink bounds (m_shrinkBoundsVersion is the version()+1
+    // when the bounds were calculated, 0 if there is no cache)
+    mutable ObjectVersion m_shrinkBoundsVersion = 0;
+    mutable color_t m_shrinkBoundsRefColor = 0;
+    mutable bool m_shrinkBoundsNonEmpty = false;
+    mutable gfx::Rect m_shrinkBounds;
   };
 
 } // namespace doc
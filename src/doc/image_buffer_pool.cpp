@@ -0,0 +1,180 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/image_buffer_pool.h"
+
+#include "doc/aligned_memory.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace doc {
+
+namespace {
+
+// Small blocks are handled well enough by malloc()
+constexpr std::size_t kMinPooledSize = 4096;
+
+constexpr std::size_t kDefaultLimit = 64*1024*1024;
+
+// Set when the pool is destroyed (at exit) so the ImageBuffers that
+// are destroyed after it (e.g. from static variables) are freed
+// directly.
+bool g_destroyed = false;
+
+class Pool {
+public:
+  ~Pool() {
+    clear();
+    g_destroyed = true;
+  }
+
+  void* allocBlock(std::size_t& size, const bool zeroed) {
+    if (size >= kMinPooledSize) {
+      const std::lock_guard lock(m_mutex);
+
+      // Reuse a free block if it's not much bigger than the
+      // requested size (up to 12.5% more)
+      auto it = m_bySize.lower_bound(size);
+      if (it != m_bySize.end() && it->first <= size + size/8) {
+        void* ptr = it->second->ptr;
+        size = it->first;
+        m_cachedBytes -= size;
+        m_lru.erase(it->second);
+        m_bySize.erase(it);
+        ++m_stats.hits;
+        if (zeroed)
+          std::memset(ptr, 0, size);
+        return ptr;
+      }
+      ++m_stats.misses;
+    }
+    return (zeroed ? doc_aligned_calloc(size):
+                     doc_aligned_alloc(size));
+  }
+
+  void freeBlock(void* ptr, const std::size_t size) {
+    if (size >= kMinPooledSize) {
+      const std::lock_guard lock(m_mutex);
+      // Big blocks would evict all the other ones
+      if (size <= m_limit/4) {
+        addBlock(ptr, size);
+        return;
+      }
+    }
+    doc_aligned_free(ptr);
+  }
+
+  void setLimit(const std::size_t limit) {
+    const std::lock_guard lock(m_mutex);
+    m_limit = limit;
+    shrinkToLimit();
+  }
+
+  void clear() {
+    const std::lock_guard lock(m_mutex);
+    for (Block& block : m_lru)
+      doc_aligned_free(block.ptr);
+    m_lru.clear();
+    m_bySize.clear();
+    m_cachedBytes = 0;
+  }
+
+  ImageBufferPoolStats stats() {
+    const std::lock_guard lock(m_mutex);
+    ImageBufferPoolStats stats = m_stats;
+    stats.cachedBlocks = m_lru.size();
+    stats.cachedBytes = m_cachedBytes;
+    return stats;
+  }
+
+private:
+  struct Block {
+    void* ptr;
+    std::size_t size;
+  };
+  using Blocks = std::list<Block>;
+
+  void addBlock(void* ptr, const std::size_t size) {
+    m_lru.push_front(Block{ ptr, size });
+    m_bySize.emplace(size, m_lru.begin());
+    m_cachedBytes += size;
+    shrinkToLimit();
+  }
+
+  // Frees the least recently returned blocks
+  void shrinkToLimit() {
+    while (m_cachedBytes > m_limit) {
+      const Block& block = m_lru.back();
+      auto range = m_bySize.equal_range(block.size);
+      for (auto it=range.first; it!=range.second; ++it) {
+        if (it->second->ptr == block.ptr) {
+          m_bySize.erase(it);
+          break;
+        }
+      }
+      m_cachedBytes -= block.size;
+      doc_aligned_free(block.ptr);
+      m_lru.pop_back();
+    }
+  }
+
+  std::mutex m_mutex;
+  Blocks m_lru;         // Most recently returned blocks first
+  std::multimap<std::size_t, Blocks::iterator> m_bySize;
+  std::size_t m_cachedBytes = 0;
+  std::size_t m_limit = kDefaultLimit;
+  ImageBufferPoolStats m_stats;
+};
+
+Pool& pool()
+{
+  static Pool pool;
+  return pool;
+}
+
+} // anonymous namespace
+
+void* image_buffer_pool_alloc(std::size_t& size, const bool zeroed)
+{
+  if (g_destroyed)
+    return (zeroed ? doc_aligned_calloc(size):
+                     doc_aligned_alloc(size));
+  return pool().allocBlock(size, zeroed);
+}
+
+void image_buffer_pool_free(void* ptr, std::size_t size)
+{
+  if (g_destroyed) {
+    doc_aligned_free(ptr);
+    return;
+  }
+  pool().freeBlock(ptr, size);
+}
+
+void set_image_buffer_pool_limit(std::size_t bytes)
+{
+  pool().setLimit(bytes);
+}
+
+void clear_image_buffer_pool()
+{
+  pool().clear();
+}
+
+ImageBufferPoolStats get_image_buffer_pool_stats()
+{
+  return pool().stats();
+}
+
+} // namespace doc
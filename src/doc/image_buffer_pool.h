@@ -0,0 +1,52 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_IMAGE_BUFFER_POOL_H_INCLUDED
+#define DOC_IMAGE_BUFFER_POOL_H_INCLUDED
+#pragma once
+
+#include <cstddef>
+
+namespace doc {
+
+  // The memory of destroyed ImageBuffers is kept in a pool to be
+  // reused by the next ImageBuffers of a similar size (temporary
+  // images of the same size are created/destroyed constantly, e.g. to
+  // render thumbnails, previews, brushes, export samples, etc.).
+  //
+  // All these functions can be called from any thread.
+
+  struct ImageBufferPoolStats {
+    std::size_t hits = 0;          // Allocations that reused a block
+    std::size_t misses = 0;        // Allocations that used malloc()
+    std::size_t cachedBlocks = 0;  // Free blocks in the pool
+    std::size_t cachedBytes = 0;   // Memory of the free blocks
+  };
+
+  // Returns a block of at least "size" bytes. "size" is updated
+  // with the real size of the block (it can be a little bigger when
+  // a free block is reused). Returns nullptr without memory. If
+  // "zeroed" is true the whole block is filled with zeros (new blocks
+  // are allocated with calloc()).
+  void* image_buffer_pool_alloc(std::size_t& size,
+                                const bool zeroed = false);
+
+  // Returns to the pool the given block allocated with
+  // image_buffer_pool_alloc() (it's freed if the pool is full).
+  void image_buffer_pool_free(void* ptr, std::size_t size);
+
+  // Maximum memory used by free blocks in the pool (0 disables the
+  // pool).
+  void set_image_buffer_pool_limit(std::size_t bytes);
+
+  // Frees all blocks cached in the pool.
+  void clear_image_buffer_pool();
+
+  ImageBufferPoolStats get_image_buffer_pool_stats();
+
+} // namespace doc
+
+#endif
@@ -0,0 +1,122 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image_buffer.h"
+#include "doc/image_buffer_pool.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace doc;
+
+TEST(ImageBufferPool, ReuseBlocks)
+{
+  clear_image_buffer_pool();
+  const ImageBufferPoolStats s0 = get_image_buffer_pool_stats();
+  EXPECT_EQ(0, s0.cachedBlocks);
+
+  uint8_t* ptr;
+  {
+    ImageBuffer buf(64*1024);
+    ptr = buf.buffer();
+  }
+  const ImageBufferPoolStats s1 = get_image_buffer_pool_stats();
+  EXPECT_EQ(s0.misses+1, s1.misses);
+  EXPECT_EQ(1, s1.cachedBlocks);
+  EXPECT_EQ(64*1024, s1.cachedBytes);
+
+  // A little smaller buffer reuses the same block
+  {
+    ImageBuffer buf(60*1024);
+    EXPECT_EQ(ptr, buf.buffer());
+    EXPECT_EQ(64*1024, buf.size());
+    EXPECT_EQ(0, get_image_buffer_pool_stats().cachedBlocks);
+  }
+  EXPECT_EQ(s1.hits+1, get_image_buffer_pool_stats().hits);
+
+  // A much smaller buffer doesn't use the block
+  {
+    ImageBuffer buf(16*1024);
+    EXPECT_EQ(1, get_image_buffer_pool_stats().cachedBlocks);
+  }
+  EXPECT_EQ(2, get_image_buffer_pool_stats().cachedBlocks);
+
+  clear_image_buffer_pool();
+  EXPECT_EQ(0, get_image_buffer_pool_stats().cachedBlocks);
+  EXPECT_EQ(0, get_image_buffer_pool_stats().cachedBytes);
+}
+
+TEST(ImageBufferPool, Limit)
+{
+  clear_image_buffer_pool();
+  set_image_buffer_pool_limit(256*1024);
+
+  {
+    // Bigger than limit/4, it's not cached
+    ImageBuffer big(128*1024);
+  }
+  EXPECT_EQ(0, get_image_buffer_pool_stats().cachedBlocks);
+
+  {
+    std::vector<std::unique_ptr<ImageBuffer>> bufs;
+    for (int i=0; i<8; ++i)
+      bufs.push_back(std::make_unique<ImageBuffer>(64*1024));
+  }
+  // Only 4 blocks of 64k fit in the pool
+  EXPECT_EQ(4, get_image_buffer_pool_stats().cachedBlocks);
+  EXPECT_EQ(256*1024, get_image_buffer_pool_stats().cachedBytes);
+
+  set_image_buffer_pool_limit(128*1024);
+  EXPECT_EQ(2, get_image_buffer_pool_stats().cachedBlocks);
+
+  set_image_buffer_pool_limit(0);
+  EXPECT_EQ(0, get_image_buffer_pool_stats().cachedBlocks);
+}
+
+TEST(ImageBufferPool, ZeroedBlocks)
+{
+  clear_image_buffer_pool();
+  set_image_buffer_pool_limit(1024*1024);
+
+  uint8_t* ptr;
+  {
+    ImageBuffer buf(64*1024);
+    ptr = buf.buffer();
+    std::fill(buf.buffer(), buf.buffer()+buf.size(), 0xff);
+  }
+
+  // The reused block must be cleared
+  {
+    ImageBuffer buf(64*1024, true);
+    EXPECT_EQ(ptr, buf.buffer());
+    EXPECT_EQ(buf.buffer()+buf.size(),
+              std::find_if(buf.buffer(), buf.buffer()+buf.size(),
+                           [](uint8_t v){ return v != 0; }));
+  }
+
+  // A new block too
+  {
+    ImageBuffer buf(512*1024, true);
+    EXPECT_EQ(buf.buffer()+buf.size(),
+              std::find_if(buf.buffer(), buf.buffer()+buf.size(),
+                           [](uint8_t v){ return v != 0; }));
+  }
+
+  set_image_buffer_pool_limit(0);
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -68,13 +68,16 @@ namespace doc {
       const std::size_t for_pixels = m_rowBytes * height();
       const std::size_t required_size = for_pixels + for_rows;
 
-      if (!m_buffer)
-        m_buffer = std::make_shared<ImageBuffer>(required_size);
-      else
+      // A new buffer is allocated already zeroed, so the memory of
+      // big images is not touched until the pixels are used
+      if (!m_buffer) {
+        m_buffer = std::make_shared<ImageBuffer>(required_size, true);
+      }
+      else {
         m_buffer->resizeIfNecessary(required_size);
-
-      std::fill(m_buffer->buffer(),
-                m_buffer->buffer()+required_size, 0);
+        std::fill(m_buffer->buffer(),
+                  m_buffer->buffer()+required_size, 0);
+      }
 
       m_rows = (address_t*)m_buffer->buffer();
       m_bits = (address_t)(m_buffer->buffer() + for_rows);
@@ -152,7 +155,7 @@ namespace doc {
       // Copy all other lines
       address_t first = address(x1, y1);
       int w = x2 - x1 + 1;
-      for (int y=y1; y<=y2; ++y)
+      for (int y=y1+1; y<=y2; ++y)
         std::copy(first, first+w, address(x1, y));
     }
 
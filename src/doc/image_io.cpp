@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 namespace doc {
 
@@ -28,78 +29,179 @@ using namespace base::serialization::little_endian;
 
 // TODO Create a zlib wrapper for iostreams
 
-bool write_image(std::ostream& os, const Image* image, CancelIO* cancel)
+// Number of bytes for visible pixels on each row of the given bounds
+static int bounds_width_bytes(const Image* image, const gfx::Rect& bounds)
 {
-  write32(os, image->id());
-  write8(os, image->pixelFormat());    // Pixel format
-  write16(os, image->width());         // Width
-  write16(os, image->height());        // Height
-  write32(os, image->maskColor());     // Mask color
+  if (bounds.w == image->width())
+    return image->widthBytes();
 
-  // Number of bytes for visible pixels on each row
-  const int widthBytes = image->widthBytes();
+  // Regions are not supported for bitmaps (pixels are packed)
+  ASSERT(image->pixelFormat() != IMAGE_BITMAP);
+  return image->bytesPerPixel() * bounds.w;
+}
 
-#if 0
-  {
-    for (int c=0; c<image->height(); c++)
-      os.write((char*)image->getPixelAddress(0, c), widthBytes);
-  }
-#else
-  {
-    std::ostream::pos_type total_output_pos = os.tellp();
-    write32(os, 0);    // Compressed size (we update this value later)
-
-    z_stream zstream;
-    zstream.zalloc = (alloc_func)0;
-    zstream.zfree  = (free_func)0;
-    zstream.opaque = (voidpf)0;
-    int err = deflateInit(&zstream, Z_DEFAULT_COMPRESSION);
-    if (err != Z_OK)
-      throw base::Exception("ZLib error %d in deflateInit().", err);
-
-    std::vector<uint8_t> compressed(4096);
-    int total_output_bytes = 0;
-
-    for (int y=0; y<image->height(); y++) {
-      if (cancel && cancel->isCanceled()) {
-        deflateEnd(&zstream);
-        return false;
+// Writes the compressed pixels of the given bounds of the image
+// (preceded by the compressed size).
+static bool write_compressed_rows(std::ostream& os,
+                                  const Image* image,
+                                  const gfx::Rect& bounds,
+                                  CancelIO* cancel)
+{
+  const int widthBytes = bounds_width_bytes(image, bounds);
+
+  std::ostream::pos_type total_output_pos = os.tellp();
+  write32(os, 0);    // Compressed size (we update this value later)
+
+  z_stream zstream;
+  zstream.zalloc = (alloc_func)0;
+  zstream.zfree  = (free_func)0;
+  zstream.opaque = (voidpf)0;
+  int err = deflateInit(&zstream, Z_DEFAULT_COMPRESSION);
+  if (err != Z_OK)
+    throw base::Exception("ZLib error %d in deflateInit().", err);
+
+  std::vector<uint8_t> compressed(4096);
+  int total_output_bytes = 0;
+
+  for (int y=0; y<bounds.h; y++) {
+    if (cancel && cancel->isCanceled()) {
+      deflateEnd(&zstream);
+      return false;
+    }
+
+    zstream.next_in = (Bytef*)image->getPixelAddress(bounds.x, bounds.y+y);
+    zstream.avail_in = widthBytes;
+    int flush = (y == bounds.h-1 ? Z_FINISH: Z_NO_FLUSH);
+
+    do {
+      zstream.next_out = (Bytef*)&compressed[0];
+      zstream.avail_out = compressed.size();
+
+      // Compress
+      err = deflate(&zstream, flush);
+      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+        throw base::Exception("ZLib error %d in deflate().", err);
+
+      int output_bytes = compressed.size() - zstream.avail_out;
+      if (output_bytes > 0) {
+        if (os.write((char*)&compressed[0], output_bytes).fail())
+          throw base::Exception("Error writing compressed image pixels.\n");
+
+        total_output_bytes += output_bytes;
       }
+    } while (zstream.avail_out == 0);
+  }
 
-      zstream.next_in = (Bytef*)image->getPixelAddress(0, y);
-      zstream.avail_in = widthBytes;
-      int flush = (y == image->height()-1 ? Z_FINISH: Z_NO_FLUSH);
+  err = deflateEnd(&zstream);
+  if (err != Z_OK)
+    throw base::Exception("ZLib error %d in deflateEnd().", err);
 
-      do {
-        zstream.next_out = (Bytef*)&compressed[0];
-        zstream.avail_out = compressed.size();
+  std::ostream::pos_type bak = os.tellp();
+  os.seekp(total_output_pos);
+  write32(os, total_output_bytes);
+  os.seekp(bak);
+  return true;
+}
 
-        // Compress
-        err = deflate(&zstream, flush);
-        if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
-          throw base::Exception("ZLib error %d in deflate().", err);
+// Reads the compressed pixels (written with write_compressed_rows())
+// in the given bounds of the image.
+static void read_compressed_rows(std::istream& is,
+                                 Image* image,
+                                 const gfx::Rect& bounds)
+{
+  const int widthBytes = bounds_width_bytes(image, bounds);
 
-        int output_bytes = compressed.size() - zstream.avail_out;
-        if (output_bytes > 0) {
-          if (os.write((char*)&compressed[0], output_bytes).fail())
-            throw base::Exception("Error writing compressed image pixels.\n");
+  int avail_bytes = read32(is);
 
-          total_output_bytes += output_bytes;
-        }
-      } while (zstream.avail_out == 0);
+  z_stream zstream;
+  zstream.zalloc = (alloc_func)0;
+  zstream.zfree  = (free_func)0;
+  zstream.opaque = (voidpf)0;
+
+  int err = inflateInit(&zstream);
+  if (err != Z_OK)
+    throw base::Exception("ZLib error %d in inflateInit().", err);
+
+  int remain = avail_bytes;
+
+  std::vector<uint8_t> compressed(4096);
+  int y = 0;
+  uint8_t* address = nullptr;
+  uint8_t* address_end = nullptr;
+
+  while (remain > 0) {
+    int len = std::min(remain, int(compressed.size()));
+    if (is.read((char*)&compressed[0], len).fail()) {
+      ASSERT(false);
+      throw base::Exception("Error reading stream to restore image");
     }
 
-    err = deflateEnd(&zstream);
-    if (err != Z_OK)
-      throw base::Exception("ZLib error %d in deflateEnd().", err);
+    int bytes_read = (int)is.gcount();
+    if (bytes_read == 0) {
+      ASSERT(remain == 0);
+      break;
+    }
+
+    remain -= bytes_read;
 
-    std::ostream::pos_type bak = os.tellp();
-    os.seekp(total_output_pos);
-    write32(os, total_output_bytes);
-    os.seekp(bak);
+    zstream.next_in = (Bytef*)&compressed[0];
+    zstream.avail_in = (uInt)bytes_read;
+
+    do {
+      if (address == address_end) {
+        if (y < bounds.h) {
+          address = image->getPixelAddress(bounds.x, bounds.y + y++);
+          address_end = address + widthBytes;
+        }
+        else {
+          // Special reported case where we just fill the whole
+          // output image buffer (avail_out == 0), and more input
+          // was previously reported as available (avail_in != 0).
+          //
+          // Not sure why zlib reports this in certain cases, where
+          // avail_in != 0 and err == Z_OK instead of err ==
+          // Z_STREAM_END and we have to do a final inflate() call
+          // (even w/avail_out=0) to get the final Z_STREAM_END
+          // result.
+          ASSERT(y == bounds.h);
+          ASSERT(err == Z_OK);
+        }
+      }
+
+      zstream.next_out = (Bytef*)address;
+      zstream.avail_out = address_end - address;
+
+      err = inflate(&zstream, Z_NO_FLUSH);
+      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+        throw base::Exception("ZLib error %d in inflate().", err);
+
+      int uncompressed_bytes = (int)((address_end - address) - zstream.avail_out);
+      if (uncompressed_bytes > 0) {
+        address += uncompressed_bytes;
+      }
+    } while (zstream.avail_in != 0 && zstream.avail_out == 0);
   }
-#endif
-  return true;
+
+  err = inflateEnd(&zstream);
+  if (err != Z_OK)
+    throw base::Exception("ZLib error %d in inflateEnd().", err);
+}
+
+bool write_image(std::ostream& os, const Image* image, CancelIO* cancel)
+{
+  return write_image_as(os, image, image->id(), cancel);
+}
+
+bool write_image_as(std::ostream& os, const Image* image,
+                    const ObjectId id, CancelIO* cancel)
+{
+  write32(os, id);
+  write8(os, image->pixelFormat());    // Pixel format
+  write16(os, image->width());         // Width
+  write16(os, image->height());        // Height
+  write32(os, image->maskColor());     // Mask color
+
+  return write_compressed_rows(os, image, image->bounds(), cancel);
 }
 
 Image* read_image(std::istream& is, const bool setId)
@@ -122,91 +224,7 @@ Image* read_image(std::istream& is, const bool setId)
   std::unique_ptr<Image> image(
     Image::create(static_cast<PixelFormat>(pixelFormat), width, height));
 
-  const int widthBytes = image->widthBytes();
-
-#if 0
-  {
-    for (int c=0; c<image->height(); c++)
-      is.read((char*)image->getPixelAddress(0, c), widthBytes);
-  }
-#else
-  {
-    int avail_bytes = read32(is);
-
-    z_stream zstream;
-    zstream.zalloc = (alloc_func)0;
-    zstream.zfree  = (free_func)0;
-    zstream.opaque = (voidpf)0;
-
-    int err = inflateInit(&zstream);
-    if (err != Z_OK)
-      throw base::Exception("ZLib error %d in inflateInit().", err);
-
-    int remain = avail_bytes;
-
-    std::vector<uint8_t> compressed(4096);
-    int y = 0;
-    uint8_t* address = nullptr;
-    uint8_t* address_end = nullptr;
-
-    while (remain > 0) {
-      int len = std::min(remain, int(compressed.size()));
-      if (is.read((char*)&compressed[0], len).fail()) {
-        ASSERT(false);
-        throw base::Exception("Error reading stream to restore image");
-      }
-
-      int bytes_read = (int)is.gcount();
-      if (bytes_read == 0) {
-        ASSERT(remain == 0);
-        break;
-      }
-
-      remain -= bytes_read;
-
-      zstream.next_in = (Bytef*)&compressed[0];
-      zstream.avail_in = (uInt)bytes_read;
-
-      do {
-        if (address == address_end) {
-          if (y < image->height()) {
-            address = image->getPixelAddress(0, y++);
-            address_end = address + widthBytes;
-          }
-          else {
-            // Special reported case where we just fill the whole
-            // output image buffer (avail_out == 0), and more input
-            // was previously reported as available (avail_in != 0).
-            //
-            // Not sure why zlib reports this in certain cases, where
-            // avail_in != 0 and err == Z_OK instead of err ==
-            // Z_STREAM_END and we have to do a final inflate() call
-            // (even w/avail_out=0) to get the final Z_STREAM_END
-            // result.
-            ASSERT(y == image->height());
-            ASSERT(err == Z_OK);
-          }
-        }
-
-        zstream.next_out = (Bytef*)address;
-        zstream.avail_out = address_end - address;
-
-        err = inflate(&zstream, Z_NO_FLUSH);
-        if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
-          throw base::Exception("ZLib error %d in inflate().", err);
-
-        int uncompressed_bytes = (int)((address_end - address) - zstream.avail_out);
-        if (uncompressed_bytes > 0) {
-          address += uncompressed_bytes;
-        }
-      } while (zstream.avail_in != 0 && zstream.avail_out == 0);
-    }
-
-    err = inflateEnd(&zstream);
-    if (err != Z_OK)
-      throw base::Exception("ZLib error %d in inflateEnd().", err);
-  }
-#endif
+  read_compressed_rows(is, image.get(), image->bounds());
 
   image->setMaskColor(maskColor);
   if (setId)
@@ -214,4 +232,32 @@ Image* read_image(std::istream& is, const bool setId)
   return image.release();
 }
 
+bool write_image_region(std::ostream& os,
+                        const Image* image,
+                        const gfx::Rect& bounds,
+                        CancelIO* cancel)
+{
+  ASSERT(image->bounds().contains(bounds));
+  write16(os, bounds.x);
+  write16(os, bounds.y);
+  write16(os, bounds.w);
+  write16(os, bounds.h);
+  return write_compressed_rows(os, image, bounds, cancel);
+}
+
+bool read_image_region(std::istream& is, Image* image)
+{
+  gfx::Rect bounds;
+  bounds.x = read16(is);
+  bounds.y = read16(is);
+  bounds.w = read16(is);
+  bounds.h = read16(is);
+  if (bounds.isEmpty() ||
+      !image->bounds().contains(bounds))
+    return false;
+
+  read_compressed_rows(is, image, bounds);
+  return true;
+}
+
 }
@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -8,6 +9,9 @@
 #define DOC_IMAGE_IO_H_INCLUDED
 #pragma once
 
+#include "doc/object_id.h"
+#include "gfx/rect.h"
+
 #include <iosfwd>
 
 namespace doc {
@@ -16,8 +20,21 @@ namespace doc {
   class Image;
 
   bool write_image(std::ostream& os, const Image* image, CancelIO* cancel = nullptr);
+
+  // Writes the image with the given ID (e.g. to write a copy of an
+  // image with the ID of the original one).
+  bool write_image_as(std::ostream& os, const Image* image,
+                      ObjectId id, CancelIO* cancel = nullptr);
   Image* read_image(std::istream& is, bool setId = true);
 
+  // Writes/reads the pixels of a region of the image (e.g. to save
+  // only the modified parts of an image). read_image_region() reads
+  // the pixels in the same position of the given image and returns
+  // false if the region is outside the image bounds.
+  bool write_image_region(std::ostream& os, const Image* image,
+                          const gfx::Rect& bounds, CancelIO* cancel = nullptr);
+  bool read_image_region(std::istream& is, Image* image);
+
 } // namespace doc
 
 #endif
@@ -0,0 +1,84 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image_io.h"
+
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/primitives.h"
+
+#include <sstream>
+
+using namespace doc;
+
+static ImageRef make_test_image(const PixelFormat pixelFormat)
+{
+  ImageRef image(Image::create(pixelFormat, 100, 80));
+  for (int y=0; y<image->height(); ++y)
+    for (int x=0; x<image->width(); ++x)
+      put_pixel(image.get(), x, y, (x*3 + y*7) & 0xff);
+  return image;
+}
+
+TEST(ImageIO, WriteReadImage)
+{
+  for (PixelFormat pf : { IMAGE_RGB, IMAGE_GRAYSCALE, IMAGE_INDEXED, IMAGE_BITMAP }) {
+    ImageRef image = make_test_image(pf);
+
+    std::stringstream s;
+    EXPECT_TRUE(write_image(s, image.get()));
+
+    ImageRef copy(read_image(s, false));
+    ASSERT_TRUE(copy != nullptr);
+    EXPECT_EQ(pf, copy->pixelFormat());
+    EXPECT_EQ(0, count_diff_between_images(image.get(), copy.get()));
+  }
+}
+
+TEST(ImageIO, WriteReadRegion)
+{
+  for (PixelFormat pf : { IMAGE_RGB, IMAGE_GRAYSCALE, IMAGE_INDEXED }) {
+    ImageRef image = make_test_image(pf);
+    ImageRef copy(Image::create(pf, image->width(), image->height()));
+    clear_image(copy.get(), 0);
+
+    const gfx::Rect bounds(10, 20, 30, 15);
+    std::stringstream s;
+    EXPECT_TRUE(write_image_region(s, image.get(), bounds));
+    EXPECT_TRUE(read_image_region(s, copy.get()));
+
+    for (int y=0; y<image->height(); ++y) {
+      for (int x=0; x<image->width(); ++x) {
+        if (bounds.contains(gfx::Point(x, y)))
+          EXPECT_EQ(get_pixel(image.get(), x, y), get_pixel(copy.get(), x, y));
+        else
+          EXPECT_EQ(0, get_pixel(copy.get(), x, y));
+      }
+    }
+  }
+}
+
+TEST(ImageIO, RegionOutsideImage)
+{
+  ImageRef image = make_test_image(IMAGE_RGB);
+  ImageRef small(Image::create(IMAGE_RGB, 16, 16));
+
+  std::stringstream s;
+  EXPECT_TRUE(write_image_region(s, image.get(), gfx::Rect(20, 20, 10, 10)));
+  EXPECT_FALSE(read_image_region(s, small.get()));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
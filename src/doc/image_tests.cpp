@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -225,6 +225,30 @@ TYPED_TEST(ImageAllTypes, FillRect)
   }
 }
 
+TYPED_TEST(ImageAllTypes, CreateCopy)
+{
+  typedef TypeParam ImageTraits;
+
+  for (int w : { 1, 7, 8, 9, 33 }) {
+    for (int h : { 1, 5, 32 }) {
+      std::unique_ptr<Image> image(Image::create(ImageTraits::pixel_format, w, h));
+      image->setMaskColor(1);
+      for (int y=0; y<h; ++y)
+        for (int x=0; x<w; ++x)
+          put_pixel_fast<ImageTraits>(image.get(), x, y, rand() % ImageTraits::max_value);
+
+      std::unique_ptr<Image> copy(Image::createCopy(image.get()));
+      ASSERT_EQ(w, copy->width());
+      ASSERT_EQ(h, copy->height());
+      EXPECT_EQ(1, copy->maskColor());
+      for (int y=0; y<h; ++y)
+        for (int x=0; x<w; ++x)
+          EXPECT_EQ(get_pixel_fast<ImageTraits>(image.get(), x, y),
+                    get_pixel_fast<ImageTraits>(copy.get(), x, y));
+    }
+  }
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -12,6 +12,7 @@
 #include "doc/image_ref.h"
 #include "doc/primitives.h"
 
+#include <cstdint>
 #include <unordered_map>
 
 namespace doc {
@@ -19,7 +20,12 @@ namespace doc {
 
     struct image_hash {
       size_t operator()(const ImageRef& i) const {
-        return calculate_image_hash(i.get(), i->bounds());
+        // Use all the bits of size_t to avoid collisions (and
+        // is_same_image() comparisons) between similar images
+        if constexpr (sizeof(size_t) == sizeof(uint64_t))
+          return size_t(calculate_image_hash64(i.get(), i->bounds()));
+        else
+          return calculate_image_hash(i.get(), i->bounds());
       }
     };
 
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019-2021  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -158,6 +158,16 @@ Layer* Layer::getNextInWholeHierarchy() const
   return nullptr;
 }
 
+void Layer::setFlags(LayerFlags flags)
+{
+  // Only visible layers are included in render plans
+  if (m_sprite &&
+      ((int(m_flags) ^ int(flags)) & int(LayerFlags::Visible))) {
+    m_sprite->incrementStructureVersion();
+  }
+  m_flags = flags;
+}
+
 bool Layer::isVisibleHierarchy() const
 {
   const Layer* layer = this;
@@ -270,10 +280,19 @@ void LayerImage::destroyAllCels()
     delete cel;
   }
   m_cels.clear();
+  m_celsIndex.clear();
+  m_celsIndexEnabled = true;
 }
 
 Cel* LayerImage::cel(frame_t frame) const
 {
+  if (m_celsIndexEnabled) {
+    if (frame >= 0 && frame < frame_t(m_celsIndex.size()))
+      return m_celsIndex[frame];
+    else
+      return nullptr;
+  }
+
   CelConstIterator it = findCelIterator(frame);
   if (it != getCelEnd())
     return *it;
@@ -349,6 +368,8 @@ void LayerImage::addCel(Cel* cel)
 
   CelIterator it = findFirstCelIteratorAfter(cel->frame());
   m_cels.insert(it, cel);
+  addToCelsIndex(cel);
+  sprite()->incrementStructureVersion();
 
   cel->setParentLayer(this);
 }
@@ -366,6 +387,8 @@ void LayerImage::removeCel(Cel* cel)
   ASSERT(it != m_cels.end());
 
   m_cels.erase(it);
+  removeFromCelsIndex(cel);
+  sprite()->incrementStructureVersion();
 
   cel->setParentLayer(NULL);
 }
@@ -378,6 +401,63 @@ void LayerImage::moveCel(Cel* cel, frame_t frame)
   addCel(cel);
 }
 
+// The index is used while the number of frames until the last cel
+// isn't too big compared to the number of cels (so a layer with a
+// few cels in a sprite with a lot of frames doesn't use too much
+// memory).
+static bool is_dense_enough(const int ncels, const frame_t nframes)
+{
+  return (nframes <= 4*ncels + 64);
+}
+
+void LayerImage::addToCelsIndex(Cel* cel)
+{
+  const frame_t frame = cel->frame();
+  if (!m_celsIndexEnabled ||
+      !is_dense_enough(int(m_cels.size()), frame+1)) {
+    rebuildCelsIndex();
+    return;
+  }
+
+  if (frame >= frame_t(m_celsIndex.size()))
+    m_celsIndex.resize(frame+1, nullptr);
+  m_celsIndex[frame] = cel;
+}
+
+void LayerImage::removeFromCelsIndex(Cel* cel)
+{
+  if (!m_celsIndexEnabled) {
+    rebuildCelsIndex();
+    return;
+  }
+
+  const frame_t frame = cel->frame();
+  ASSERT(frame >= 0 && frame < frame_t(m_celsIndex.size()));
+  ASSERT(m_celsIndex[frame] == cel);
+  m_celsIndex[frame] = nullptr;
+
+  while (!m_celsIndex.empty() && !m_celsIndex.back())
+    m_celsIndex.pop_back();
+
+  if (!is_dense_enough(int(m_cels.size()), frame_t(m_celsIndex.size())))
+    rebuildCelsIndex();
+}
+
+void LayerImage::rebuildCelsIndex()
+{
+  const frame_t nframes = (m_cels.empty() ? 0: m_cels.back()->frame()+1);
+  m_celsIndexEnabled = is_dense_enough(int(m_cels.size()), nframes);
+  m_celsIndex.clear();
+
+  if (m_celsIndexEnabled) {
+    m_celsIndex.resize(nframes, nullptr);
+    for (Cel* cel : m_cels)
+      m_celsIndex[cel->frame()] = cel;
+  }
+  else
+    m_celsIndex.shrink_to_fit();
+}
+
 /**
  * Configures some properties of the specified layer to make it as the
  * "Background" of the sprite.
@@ -414,6 +494,34 @@ void LayerImage::displaceFrames(frame_t fromThis, frame_t delta)
   }
 }
 
+void LayerImage::permuteFrames(const std::vector<frame_t>& newFrames)
+{
+  const frame_t n = frame_t(newFrames.size());
+  bool moved = false;
+
+  // Change the frame of each cel directly (without removing/adding
+  // it to the list) and sort the list just once.
+  for (Cel* cel : m_cels) {
+    const frame_t frame = cel->frame();
+    if (frame >= 0 && frame < n && newFrames[frame] != frame) {
+      ASSERT(newFrames[frame] >= 0 && newFrames[frame] < n);
+      cel->m_frame = newFrames[frame];
+      cel->incrementVersion();
+      moved = true;
+    }
+  }
+
+  if (!moved)
+    return;
+
+  std::sort(m_cels.begin(), m_cels.end(),
+            [](const Cel* a, const Cel* b){
+              return a->frame() < b->frame();
+            });
+  rebuildCelsIndex();
+  sprite()->incrementStructureVersion();
+}
+
 //////////////////////////////////////////////////////////////////////
 // LayerGroup class
 
@@ -564,6 +672,7 @@ void LayerGroup::addLayer(Layer* layer)
 {
   m_layers.push_back(layer);
   layer->setParent(this);
+  sprite()->incrementStructureVersion();
 }
 
 void LayerGroup::removeLayer(Layer* layer)
@@ -573,6 +682,7 @@ void LayerGroup::removeLayer(Layer* layer)
   m_layers.erase(it);
 
   layer->setParent(nullptr);
+  sprite()->incrementStructureVersion();
 }
 
 void LayerGroup::insertLayer(Layer* layer, Layer* after)
@@ -586,6 +696,7 @@ void LayerGroup::insertLayer(Layer* layer, Layer* after)
   m_layers.insert(after_it, layer);
 
   layer->setParent(this);
+  sprite()->incrementStructureVersion();
 }
 
 void LayerGroup::stackLayer(Layer* layer, Layer* after)
@@ -604,4 +715,10 @@ void LayerGroup::displaceFrames(frame_t fromThis, frame_t delta)
     layer->displaceFrames(fromThis, delta);
 }
 
+void LayerGroup::permuteFrames(const std::vector<frame_t>& newFrames)
+{
+  for (Layer* layer : m_layers)
+    layer->permuteFrames(newFrames);
+}
+
 } // namespace doc
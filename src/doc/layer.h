@@ -17,6 +17,7 @@
 #include "doc/with_user_data.h"
 
 #include <string>
+#include <vector>
 
 namespace doc {
 
@@ -114,15 +115,13 @@ namespace doc {
       return (int(m_flags) & int(flags)) == int(flags);
     }
 
-    void setFlags(LayerFlags flags) {
-      m_flags = flags;
-    }
+    void setFlags(LayerFlags flags);
 
     void switchFlags(LayerFlags flags, bool state) {
       if (state)
-        m_flags = LayerFlags(int(m_flags) | int(flags));
+        setFlags(LayerFlags(int(m_flags) | int(flags)));
       else
-        m_flags = LayerFlags(int(m_flags) & ~int(flags));
+        setFlags(LayerFlags(int(m_flags) & ~int(flags)));
     }
 
     virtual Grid grid() const;
@@ -130,6 +129,11 @@ namespace doc {
     virtual void getCels(CelList& cels) const = 0;
     virtual void displaceFrames(frame_t fromThis, frame_t delta) = 0;
 
+    // Moves the cel of each frame "f" to the frame "newFrames[f]"
+    // ("newFrames" must be a permutation of [0, newFrames.size()),
+    // cels in frames after that range aren't moved).
+    virtual void permuteFrames(const std::vector<frame_t>& newFrames) = 0;
+
   private:
     std::string m_name;           // layer name
     Sprite* m_sprite;             // owner of the layer
@@ -164,6 +168,7 @@ namespace doc {
     Cel* cel(frame_t frame) const override;
     void getCels(CelList& cels) const override;
     void displaceFrames(frame_t fromThis, frame_t delta) override;
+    void permuteFrames(const std::vector<frame_t>& newFrames) override;
 
     Cel* getLastCel() const;
     CelConstIterator findCelIterator(frame_t frame) const;
@@ -180,10 +185,20 @@ namespace doc {
 
   private:
     void destroyAllCels();
+    void addToCelsIndex(Cel* cel);
+    void removeFromCelsIndex(Cel* cel);
+    void rebuildCelsIndex();
 
     BlendMode m_blendmode;
     int m_opacity;
     CelList m_cels;   // List of all cels inside this layer used by frames.
+
+    // Cel of each frame (nullptr for empty frames) to get the cel of
+    // a frame in O(1). It's used only when the cels are dense enough
+    // (m_celsIndexEnabled = true), in other case we use a binary
+    // search in m_cels.
+    CelList m_celsIndex;
+    bool m_celsIndexEnabled = true;
   };
 
   //////////////////////////////////////////////////////////////////////
@@ -219,6 +234,7 @@ namespace doc {
 
     void getCels(CelList& cels) const override;
     void displaceFrames(frame_t fromThis, frame_t delta) override;
+    void permuteFrames(const std::vector<frame_t>& newFrames) override;
 
     bool isBrowsable() const override {
       return isGroup() && isExpanded() && !m_layers.empty();
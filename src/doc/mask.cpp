@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -12,11 +12,18 @@
 #include "doc/mask.h"
 
 #include "base/memory.h"
+#include "doc/algorithm/parallel_bands.h"
 #include "doc/image_impl.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
+#if defined(__x86_64__) || defined(_WIN64)
+  #include <emmintrin.h>
+  #define MASK_SSE2 1
+#endif
+
 namespace doc {
 
 namespace {
@@ -26,7 +33,7 @@ namespace {
     a.reserve(b.bounds());
 
     {
-      LockImageBits<BitmapTraits> aBits(a.bitmap());
+      LockImageBits<BitmapTraits> aBits(a.editableBitmap());
       auto aIt = aBits.begin();
 
       auto bounds = a.bounds();
@@ -43,6 +50,193 @@ namespace {
     a.shrink();
   }
 
+  // Maximum difference between the channels of two colors
+  template<typename ImageTraits>
+  int color_distance(const color_t a, const color_t b);
+
+  template<>
+  int color_distance<RgbTraits>(const color_t a, const color_t b) {
+    return std::max(std::max(std::abs(int(rgba_getr(a)) - int(rgba_getr(b))),
+                             std::abs(int(rgba_getg(a)) - int(rgba_getg(b)))),
+                    std::max(std::abs(int(rgba_getb(a)) - int(rgba_getb(b))),
+                             std::abs(int(rgba_geta(a)) - int(rgba_geta(b)))));
+  }
+
+  template<>
+  int color_distance<GrayscaleTraits>(const color_t a, const color_t b) {
+    return std::max(std::abs(int(graya_getv(a)) - int(graya_getv(b))),
+                    std::abs(int(graya_geta(a)) - int(graya_geta(b))));
+  }
+
+  template<>
+  int color_distance<IndexedTraits>(const color_t a, const color_t b) {
+    return std::abs(int(a) - int(b));
+  }
+
+#ifdef MASK_SSE2
+
+  // Number of pixels in a __m128i
+  template<typename ImageTraits>
+  constexpr int simd_pixels() { return 16 / sizeof(typename ImageTraits::pixel_t); }
+
+  template<typename ImageTraits>
+  __m128i simd_set1(color_t color);
+
+  template<>
+  __m128i simd_set1<RgbTraits>(color_t color) { return _mm_set1_epi32(int(color)); }
+  template<>
+  __m128i simd_set1<GrayscaleTraits>(color_t color) { return _mm_set1_epi16(short(color)); }
+  template<>
+  __m128i simd_set1<IndexedTraits>(color_t color) { return _mm_set1_epi8(char(color)); }
+
+  inline __m128i simd_absdiff(const __m128i a, const __m128i b) {
+    return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+  }
+
+  // Returns a byte for each pixel with the maximum difference of its
+  // channels (for RGB and grayscale pixels the result is a
+  // 16-bit/32-bit value in the range [0, 255])
+  template<typename ImageTraits>
+  __m128i simd_distance(const __m128i pixels, const __m128i color);
+
+  template<>
+  __m128i simd_distance<RgbTraits>(const __m128i pixels, const __m128i color) {
+    __m128i d = simd_absdiff(pixels, color);
+    d = _mm_max_epu8(d, _mm_srli_epi32(d, 8));
+    d = _mm_max_epu8(d, _mm_srli_epi32(d, 16));
+    return _mm_and_si128(d, _mm_set1_epi32(0xff));
+  }
+
+  template<>
+  __m128i simd_distance<GrayscaleTraits>(const __m128i pixels, const __m128i color) {
+    __m128i d = simd_absdiff(pixels, color);
+    d = _mm_max_epu8(d, _mm_srli_epi16(d, 8));
+    return _mm_and_si128(d, _mm_set1_epi16(0xff));
+  }
+
+  template<>
+  __m128i simd_distance<IndexedTraits>(const __m128i pixels, const __m128i color) {
+    return simd_absdiff(pixels, color);
+  }
+
+  // Converts the distances of 16 pixels (in 16/sizeof(pixel_t)
+  // registers) to 16 bytes
+  template<typename ImageTraits>
+  __m128i simd_pack_distances(const __m128i* d);
+
+  template<>
+  __m128i simd_pack_distances<RgbTraits>(const __m128i* d) {
+    return _mm_packus_epi16(_mm_packs_epi32(d[0], d[1]),
+                            _mm_packs_epi32(d[2], d[3]));
+  }
+
+  template<>
+  __m128i simd_pack_distances<GrayscaleTraits>(const __m128i* d) {
+    return _mm_packus_epi16(d[0], d[1]);
+  }
+
+  template<>
+  __m128i simd_pack_distances<IndexedTraits>(const __m128i* d) {
+    return d[0];
+  }
+
+  // Returns the distances of the 16 pixels starting at "src"
+  template<typename ImageTraits>
+  __m128i simd_distances16(const typename ImageTraits::pixel_t* src,
+                           const __m128i colorv) {
+    constexpr int n = 16 / simd_pixels<ImageTraits>();
+    __m128i d[n];
+    for (int i=0; i<n; ++i) {
+      d[i] = simd_distance<ImageTraits>(
+        _mm_loadu_si128((const __m128i*)(src + i*simd_pixels<ImageTraits>())),
+        colorv);
+    }
+    return simd_pack_distances<ImageTraits>(d);
+  }
+
+  // Returns 16 bits (one for each byte) of the bytes <= fuzziness
+  inline int simd_match_bits(const __m128i distances, const __m128i fuzzv) {
+    return _mm_movemask_epi8(
+      _mm_cmpeq_epi8(_mm_subs_epu8(distances, fuzzv),
+                     _mm_setzero_si128()));
+  }
+
+#endif
+
+  // Fills a row of the bitmap "dst" (1 bit per pixel) with the pixels
+  // of "src" that are similar to "color"
+  template<typename ImageTraits>
+  void match_row(const typename ImageTraits::pixel_t* src,
+                 uint8_t* dst, const int w,
+                 const color_t color, const int fuzziness) {
+    int x = 0;
+#ifdef MASK_SSE2
+    const __m128i colorv = simd_set1<ImageTraits>(color);
+    const __m128i fuzzv = _mm_set1_epi8(char(fuzziness));
+    for (; x+16<=w; x+=16, src+=16, dst+=2) {
+      const int bits = simd_match_bits(
+        simd_distances16<ImageTraits>(src, colorv), fuzzv);
+      dst[0] = uint8_t(bits);
+      dst[1] = uint8_t(bits >> 8);
+    }
+#endif
+    uint8_t bits = 0;
+    for (int i=0; x<w; ++x, ++src) {
+      if (color_distance<ImageTraits>(*src, color) <= fuzziness)
+        bits |= (1 << i);
+      if (++i == 8) {
+        *(dst++) = bits;
+        bits = 0;
+        i = 0;
+      }
+    }
+    if (w & 7)
+      *dst = bits;
+  }
+
+  // Fills a row of "dst" with the distance between each pixel of
+  // "src" and "color"
+  template<typename ImageTraits>
+  void distance_row(const typename ImageTraits::pixel_t* src,
+                    uint8_t* dst, const int w, const color_t color) {
+    int x = 0;
+#ifdef MASK_SSE2
+    const __m128i colorv = simd_set1<ImageTraits>(color);
+    for (; x+16<=w; x+=16, src+=16, dst+=16)
+      _mm_storeu_si128((__m128i*)dst,
+                       simd_distances16<ImageTraits>(src, colorv));
+#endif
+    for (; x<w; ++x, ++src, ++dst)
+      *dst = uint8_t(color_distance<ImageTraits>(*src, color));
+  }
+
+  // Fills a row of the bitmap "dst" with the distances <= fuzziness
+  void threshold_row(const uint8_t* src, uint8_t* dst,
+                     const int w, const int fuzziness) {
+    int x = 0;
+#ifdef MASK_SSE2
+    const __m128i fuzzv = _mm_set1_epi8(char(fuzziness));
+    for (; x+16<=w; x+=16, src+=16, dst+=2) {
+      const int bits = simd_match_bits(
+        _mm_loadu_si128((const __m128i*)src), fuzzv);
+      dst[0] = uint8_t(bits);
+      dst[1] = uint8_t(bits >> 8);
+    }
+#endif
+    uint8_t bits = 0;
+    for (int i=0; x<w; ++x, ++src) {
+      if (*src <= fuzziness)
+        bits |= (1 << i);
+      if (++i == 8) {
+        *(dst++) = bits;
+        bits = 0;
+        i = 0;
+      }
+    }
+    if (w & 7)
+      *dst = bits;
+  }
+
 } // namespace namespace
 
 Mask::Mask()
@@ -67,6 +261,26 @@ void Mask::initialize()
 {
   m_freeze_count = 0;
   m_bounds = gfx::Rect(0, 0, 0, 0);
+  m_rectangle = false;
+}
+
+void Mask::createRectangleBitmap() const
+{
+  ASSERT(m_rectangle);
+  ASSERT(!m_bounds.isEmpty());
+
+  m_bitmap.reset(Image::create(IMAGE_BITMAP, m_bounds.w, m_bounds.h));
+  clear_image(m_bitmap.get(), 1);
+}
+
+void Mask::convertToBitmap()
+{
+  if (!m_rectangle)
+    return;
+
+  if (!m_bitmap)
+    createRectangleBitmap();
+  m_rectangle = false;
 }
 
 int Mask::getMemSize() const
@@ -97,6 +311,9 @@ void Mask::unfreeze()
 
 bool Mask::isRectangular() const
 {
+  if (m_rectangle)
+    return true;
+
   if (!m_bitmap)
     return false;
 
@@ -118,14 +335,15 @@ void Mask::copyFrom(const Mask* sourceMask)
   clear();
   setName(sourceMask->name().c_str());
 
-  if (sourceMask->bitmap()) {
-    // Add all the area of "mask"
-    add(sourceMask->bounds());
-
-    // And copy the "mask" bitmap (m_bitmap can be nullptr if this is
-    // frozen, so add() doesn't created the bitmap)
-    if (m_bitmap)
-      copy_image(m_bitmap.get(), sourceMask->m_bitmap.get());
+  // Rectangles are copied without the bitmap
+  if (sourceMask->m_rectangle) {
+    m_bounds = sourceMask->bounds();
+    m_rectangle = true;
+  }
+  else if (sourceMask->m_bitmap) {
+    // Create a bitmap for all the area of "mask" and copy the bitmap
+    reserve(sourceMask->bounds());
+    copy_image(m_bitmap.get(), sourceMask->m_bitmap.get());
   }
 }
 
@@ -138,10 +356,19 @@ void Mask::clear()
 {
   m_bitmap.reset();
   m_bounds = gfx::Rect(0, 0, 0, 0);
+  m_rectangle = false;
 }
 
 void Mask::invert()
 {
+  // Inverting a full rectangle (inside its own bounds) gives nothing
+  if (m_rectangle) {
+    if (m_freeze_count == 0)
+      clear();
+    else
+      convertToBitmap();
+  }
+
   if (!m_bitmap)
     return;
 
@@ -161,14 +388,19 @@ void Mask::replace(const gfx::Rect& bounds)
     return;
   }
 
+  // The bitmap is created only when it's needed
+  m_bitmap.reset();
   m_bounds = bounds;
-
-  m_bitmap.reset(Image::create(IMAGE_BITMAP, bounds.w, bounds.h, m_buffer));
-  clear_image(m_bitmap.get(), 1);
+  m_rectangle = true;
 }
 
 void Mask::add(const doc::Mask& mask)
 {
+  if (mask.m_rectangle && m_freeze_count == 0) {
+    add(mask.bounds());
+    return;
+  }
+
   for_each_mask_pixel(
     *this, mask,
     [](color_t a, color_t b) -> color_t {
@@ -178,6 +410,11 @@ void Mask::add(const doc::Mask& mask)
 
 void Mask::subtract(const doc::Mask& mask)
 {
+  if (mask.m_rectangle && m_freeze_count == 0) {
+    subtract(mask.bounds());
+    return;
+  }
+
   for_each_mask_pixel(
     *this, mask,
     [](color_t a, color_t b) -> color_t {
@@ -190,6 +427,11 @@ void Mask::subtract(const doc::Mask& mask)
 
 void Mask::intersect(const doc::Mask& mask)
 {
+  if (mask.m_rectangle && m_freeze_count == 0) {
+    intersect(mask.bounds());
+    return;
+  }
+
   for_each_mask_pixel(
     *this, mask,
     [](color_t a, color_t b) -> color_t {
@@ -199,8 +441,28 @@ void Mask::intersect(const doc::Mask& mask)
 
 void Mask::add(const gfx::Rect& bounds)
 {
-  if (m_freeze_count == 0)
+  if (m_freeze_count == 0) {
+    // Keep the rectangle representation if the result is a
+    // rectangle too
+    if (isEmpty()) {
+      replace(bounds);
+      return;
+    }
+    if (m_rectangle) {
+      const gfx::Rect rc = m_bounds.createUnion(bounds);
+      if (m_bounds.contains(bounds))
+        return;
+      if (bounds.contains(m_bounds) ||
+          (bounds.x == m_bounds.x && bounds.w == m_bounds.w &&
+           bounds.y <= m_bounds.y2() && m_bounds.y <= bounds.y2()) ||
+          (bounds.y == m_bounds.y && bounds.h == m_bounds.h &&
+           bounds.x <= m_bounds.x2() && m_bounds.x <= bounds.x2())) {
+        replace(rc);
+        return;
+      }
+    }
     reserve(bounds);
+  }
 
   // m_bitmap can be nullptr if we have m_freeze_count > 0
   if (!m_bitmap)
@@ -215,6 +477,42 @@ void Mask::add(const gfx::Rect& bounds)
 
 void Mask::subtract(const gfx::Rect& bounds)
 {
+  if (m_rectangle && m_freeze_count == 0) {
+    const gfx::Rect rc = m_bounds.createIntersection(bounds);
+    if (rc.isEmpty())
+      return;
+    if (rc == m_bounds) {
+      clear();
+      return;
+    }
+
+    // Cut a complete side of the rectangle
+    const gfx::Rect& b = m_bounds;
+    if (rc.x == b.x && rc.w == b.w) {
+      if (rc.y == b.y) {
+        replace(gfx::Rect(b.x, rc.y2(), b.w, b.y2()-rc.y2()));
+        return;
+      }
+      if (rc.y2() == b.y2()) {
+        replace(gfx::Rect(b.x, b.y, b.w, rc.y-b.y));
+        return;
+      }
+    }
+    else if (rc.y == b.y && rc.h == b.h) {
+      if (rc.x == b.x) {
+        replace(gfx::Rect(rc.x2(), b.y, b.x2()-rc.x2(), b.h));
+        return;
+      }
+      if (rc.x2() == b.x2()) {
+        replace(gfx::Rect(b.x, b.y, rc.x-b.x, b.h));
+        return;
+      }
+    }
+  }
+
+  if (m_rectangle)
+    convertToBitmap();
+
   if (!m_bitmap)
     return;
 
@@ -229,6 +527,12 @@ void Mask::subtract(const gfx::Rect& bounds)
 
 void Mask::intersect(const gfx::Rect& bounds)
 {
+  // The intersection of two rectangles is a rectangle
+  if (m_rectangle) {
+    replace(m_bounds.createIntersection(bounds));
+    return;
+  }
+
   if (!m_bitmap)
     return;
 
@@ -251,107 +555,113 @@ void Mask::intersect(const gfx::Rect& bounds)
   shrink();
 }
 
-void Mask::byColor(const Image *src, int color, int fuzziness)
+void Mask::byColor(const Image* src, int color, int fuzziness)
 {
   replace(src->bounds());
 
-  Image* dst = m_bitmap.get();
+  // Nothing matches a negative fuzziness
+  if (fuzziness < 0) {
+    clear();
+    return;
+  }
+  fuzziness = std::min(fuzziness, 255);
+
+  Image* dst = editableBitmap();
+  const int w = src->width();
+
+  auto matchRows = [src, dst, w, color, fuzziness](auto traits,
+                                                   const int y1,
+                                                   const int h) {
+    using Traits = decltype(traits);
+    for (int y=y1; y<y1+h; ++y) {
+      match_row<Traits>(
+        (const typename Traits::pixel_t*)src->getPixelAddress(0, y),
+        dst->getPixelAddress(0, y), w, color, fuzziness);
+    }
+  };
 
   switch (src->pixelFormat()) {
-
-    case IMAGE_RGB: {
-      const LockImageBits<RgbTraits> srcBits(src);
-      LockImageBits<BitmapTraits> dstBits(dst, Image::WriteLock);
-      LockImageBits<RgbTraits>::const_iterator src_it = srcBits.begin(), src_end = srcBits.end();
-      LockImageBits<BitmapTraits>::iterator dst_it = dstBits.begin();
-#ifdef _DEBUG
-      LockImageBits<BitmapTraits>::iterator dst_end = dstBits.end();
-#endif
-      int src_r, src_g, src_b, src_a;
-      int dst_r, dst_g, dst_b, dst_a;
-      color_t c;
-
-      dst_r = rgba_getr(color);
-      dst_g = rgba_getg(color);
-      dst_b = rgba_getb(color);
-      dst_a = rgba_geta(color);
-
-      for (; src_it != src_end; ++src_it, ++dst_it) {
-        ASSERT(dst_it != dst_end);
-        c = *src_it;
-
-        src_r = rgba_getr(c);
-        src_g = rgba_getg(c);
-        src_b = rgba_getb(c);
-        src_a = rgba_geta(c);
-
-        if (!((src_r >= dst_r-fuzziness) && (src_r <= dst_r+fuzziness) &&
-              (src_g >= dst_g-fuzziness) && (src_g <= dst_g+fuzziness) &&
-              (src_b >= dst_b-fuzziness) && (src_b <= dst_b+fuzziness) &&
-              (src_a >= dst_a-fuzziness) && (src_a <= dst_a+fuzziness)))
-          *dst_it = 0;
-      }
-      ASSERT(dst_it == dst_end);
+    case IMAGE_RGB:
+      algorithm::for_each_band(src->height(), [&](const int y, const int h){
+        matchRows(RgbTraits(), y, h);
+      });
       break;
-    }
-
-    case IMAGE_GRAYSCALE: {
-      const LockImageBits<GrayscaleTraits> srcBits(src);
-      LockImageBits<BitmapTraits> dstBits(dst, Image::WriteLock);
-      LockImageBits<GrayscaleTraits>::const_iterator src_it = srcBits.begin(), src_end = srcBits.end();
-      LockImageBits<BitmapTraits>::iterator dst_it = dstBits.begin();
-#ifdef _DEBUG
-      LockImageBits<BitmapTraits>::iterator dst_end = dstBits.end();
-#endif
-      int src_k, src_a;
-      int dst_k, dst_a;
-      color_t c;
-
-      dst_k = graya_getv(color);
-      dst_a = graya_geta(color);
-
-      for (; src_it != src_end; ++src_it, ++dst_it) {
-        ASSERT(dst_it != dst_end);
-        c = *src_it;
+    case IMAGE_GRAYSCALE:
+      algorithm::for_each_band(src->height(), [&](const int y, const int h){
+        matchRows(GrayscaleTraits(), y, h);
+      });
+      break;
+    case IMAGE_INDEXED:
+      algorithm::for_each_band(src->height(), [&](const int y, const int h){
+        matchRows(IndexedTraits(), y, h);
+      });
+      break;
+  }
 
-        src_k = graya_getv(c);
-        src_a = graya_geta(c);
+  shrink();
+}
 
-        if (!((src_k >= dst_k-fuzziness) && (src_k <= dst_k+fuzziness) &&
-              (src_a >= dst_a-fuzziness) && (src_a <= dst_a+fuzziness)))
-          *dst_it = 0;
-      }
-      ASSERT(dst_it == dst_end);
-      break;
+// static
+ImageRef Mask::createColorDistanceMap(const Image* src, int color)
+{
+  const int w = src->width();
+  ImageRef map(Image::create(IMAGE_INDEXED, w, src->height()));
+
+  auto distanceRows = [src, &map, w, color](auto traits,
+                                            const int y1,
+                                            const int h) {
+    using Traits = decltype(traits);
+    for (int y=y1; y<y1+h; ++y) {
+      distance_row<Traits>(
+        (const typename Traits::pixel_t*)src->getPixelAddress(0, y),
+        map->getPixelAddress(0, y), w, color);
     }
+  };
 
-    case IMAGE_INDEXED: {
-      const LockImageBits<IndexedTraits> srcBits(src);
-      LockImageBits<BitmapTraits> dstBits(dst, Image::WriteLock);
-      LockImageBits<IndexedTraits>::const_iterator src_it = srcBits.begin(), src_end = srcBits.end();
-      LockImageBits<BitmapTraits>::iterator dst_it = dstBits.begin();
-#ifdef _DEBUG
-      LockImageBits<BitmapTraits>::iterator dst_end = dstBits.end();
-#endif
-      color_t c, min, max;
+  switch (src->pixelFormat()) {
+    case IMAGE_RGB:
+      algorithm::for_each_band(src->height(), [&](const int y, const int h){
+        distanceRows(RgbTraits(), y, h);
+      });
+      break;
+    case IMAGE_GRAYSCALE:
+      algorithm::for_each_band(src->height(), [&](const int y, const int h){
+        distanceRows(GrayscaleTraits(), y, h);
+      });
+      break;
+    case IMAGE_INDEXED:
+      algorithm::for_each_band(src->height(), [&](const int y, const int h){
+        distanceRows(IndexedTraits(), y, h);
+      });
+      break;
+    default:
+      // Other formats are selected completely (as in byColor())
+      clear_image(map.get(), 0);
+      break;
+  }
+  return map;
+}
 
-      for (; src_it != src_end; ++src_it, ++dst_it) {
-        ASSERT(dst_it != dst_end);
-        c = *src_it;
+void Mask::byColorDistance(const Image* distanceMap, int fuzziness)
+{
+  ASSERT(distanceMap->pixelFormat() == IMAGE_INDEXED);
 
-        if (color > fuzziness)
-          min = color-fuzziness;
-        else
-          min = 0;
-        max = color + fuzziness;
+  replace(distanceMap->bounds());
 
-        if (!((c >= min) && (c <= max)))
-          *dst_it = 0;
-      }
-      ASSERT(dst_it == dst_end);
-      break;
-    }
+  if (fuzziness < 0) {
+    clear();
+    return;
   }
+  fuzziness = std::min(fuzziness, 255);
+
+  Image* dst = editableBitmap();
+  const int w = distanceMap->width();
+  algorithm::for_each_band(distanceMap->height(), [&](const int y1, const int h){
+    for (int y=y1; y<y1+h; ++y) {
+      threshold_row(distanceMap->getPixelAddress(0, y),
+                    dst->getPixelAddress(0, y), w, fuzziness);
+    }
+  });
 
   shrink();
 }
@@ -383,7 +693,7 @@ void Mask::crop(const Image *image)
   int done;
   color_t old_color;
 
-  if (!m_bitmap)
+  if (isEmpty())
     return;
 
   beg_x1 = m_bounds.x;
@@ -425,6 +735,9 @@ void Mask::reserve(const gfx::Rect& bounds)
 {
   ASSERT(!bounds.isEmpty());
 
+  if (m_rectangle)
+    convertToBitmap();
+
   if (!m_bitmap) {
     m_bounds = bounds;
     m_bitmap.reset(Image::create(IMAGE_BITMAP, bounds.w, bounds.h, m_buffer));
@@ -452,6 +765,10 @@ void Mask::shrink()
   if (m_freeze_count > 0)
     return;
 
+  // A rectangle is already shrunk
+  if (m_rectangle)
+    return;
+
 #define SHRINK_SIDE(u_begin, u_op, u_final, u_add,                      \
                     v_begin, v_op, v_final, v_add, U, V, var)           \
   {                                                                     \
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2020 Igara Studio S.A.
+// Copyright (c) 2020-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -34,17 +34,31 @@ namespace doc {
     void setName(const char *name);
     const std::string& name() const { return m_name; }
 
-    const Image* bitmap() const { return m_bitmap.get(); }
-    Image* bitmap() { return m_bitmap.get(); }
+    // Rectangular masks are stored without a bitmap, so bitmap()
+    // creates it the first time it's needed (the mask is still
+    // rectangular). Use editableBitmap() to modify the pixels, it
+    // converts the mask to a bitmap mask.
+    const Image* bitmap() const {
+      if (m_rectangle && !m_bitmap)
+        createRectangleBitmap();
+      return m_bitmap.get();
+    }
+    Image* editableBitmap() {
+      if (m_rectangle)
+        convertToBitmap();
+      return m_bitmap.get();
+    }
 
     // Returns true if the mask is completely empty (i.e. nothing
     // selected)
     bool isEmpty() const {
-      return (!m_bitmap ? true: false);
+      return (!m_rectangle && !m_bitmap);
     }
 
     // Returns true if the point is inside the mask
     bool containsPoint(int u, int v) const {
+      if (m_rectangle)
+        return m_bounds.contains(u, v);
       return (m_bitmap.get() &&
               u >= m_bounds.x && u < m_bounds.x+m_bounds.w &&
               v >= m_bounds.y && v < m_bounds.y+m_bounds.h &&
@@ -71,6 +85,11 @@ namespace doc {
     // Returns true if the mask is a rectangular region.
     bool isRectangular() const;
 
+    // Returns true if the mask is stored as a rectangle (without a
+    // bitmap). Unlike isRectangular() the bitmap is not checked, so
+    // it can return false for bitmap masks that are rectangular.
+    bool isKnownRectangle() const { return m_rectangle; }
+
     // Clears the mask.
     void clear();
 
@@ -93,6 +112,14 @@ namespace doc {
     void intersect(const gfx::Rect& bounds);
 
     void byColor(const Image* image, int color, int fuzziness);
+
+    // Creates an 8-bit image (IMAGE_INDEXED) with the maximum
+    // difference between the channels of each pixel and the given
+    // color. It can be used with byColorDistance() to create the
+    // mask of several fuzziness values without checking the colors
+    // again (e.g. from a dialog with a tolerance slider).
+    static ImageRef createColorDistanceMap(const Image* image, int color);
+    void byColorDistance(const Image* distanceMap, int fuzziness);
     void crop(const Image* image);
 
     // Reserves a rectangle to draw onto the bitmap (you should call
@@ -108,11 +135,16 @@ namespace doc {
 
   private:
     void initialize();
+    void createRectangleBitmap() const;
+    void convertToBitmap();
 
     int m_freeze_count;
     std::string m_name;           // Mask name
     gfx::Rect m_bounds;           // Region bounds
-    ImageRef m_bitmap;            // Bitmapped image mask
+    // True if the whole m_bounds is selected (in this case m_bitmap
+    // is just a cache of the rectangle, created when it's needed)
+    bool m_rectangle;
+    mutable ImageRef m_bitmap;    // Bitmapped image mask
     ImageBufferPtr m_buffer;      // Buffer used in m_bitmap
 
     Mask& operator=(const Mask& mask);
@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
 // Copyright (c) 2001-2015 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -12,6 +13,9 @@
 
 #include "doc/image_impl.h"
 
+#include <algorithm>
+#include <cstdint>
+
 namespace doc {
 
 void MaskBoundaries::reset()
@@ -19,324 +23,293 @@ void MaskBoundaries::reset()
   m_segs.clear();
   if (!m_path.isEmpty())
     m_path.rewind();
+  m_bitmap.reset();
+  ++m_version;
+}
+
+namespace {
+
+inline const uint8_t* row_address(const Image* bitmap, const int y)
+{
+  if (y < 0 || y >= bitmap->height())
+    return nullptr;
+  return bitmap->getPixelAddress(0, y);
+}
+
+inline bool get_bit(const uint8_t* row, const int x)
+{
+  return (row && (row[x >> 3] & (1 << (x & 7))));
+}
+
+// Mask of valid bits of the last byte of a row
+inline uint8_t last_byte_mask(const int width)
+{
+  return ((width & 7) ? uint8_t((1 << (width & 7)) - 1): uint8_t(0xff));
+}
+
+inline uint8_t get_byte(const uint8_t* row, const int i,
+                        const int widthBytes, const uint8_t lastMask)
+{
+  if (!row || i >= widthBytes)
+    return 0;
+  return (i == widthBytes-1 ? row[i] & lastMask: row[i]);
 }
 
+} // anonymous namespace
+
 void MaskBoundaries::regen(const Image* bitmap)
 {
   reset();
 
-  int x, y, w = bitmap->width(), h = bitmap->height();
+  list_type vert;
+  regenLines(bitmap, gfx::Point(0, 0),
+             0, bitmap->height(),
+             0, bitmap->width(),
+             m_segs, vert);
+  m_segs.insert(m_segs.end(), vert.begin(), vert.end());
+}
 
-  const LockImageBits<BitmapTraits> bits(bitmap);
-  auto it = bits.begin();       // Current pixel iterator
-#if _DEBUG
-  auto prevIt = bits.begin();   // Previous row iterator (same X pos)
-#endif
+void MaskBoundaries::regen(const Image* bitmap, const gfx::Point& origin)
+{
+  ASSERT(bitmap->pixelFormat() == IMAGE_BITMAP);
 
-  // Vertical segments being expanded from the previous row.
-  std::vector<int> vertSegs(w+1, -1);
+  const int w = bitmap->width();
+  const int h = bitmap->height();
+  gfx::Rect area;
 
-  // Horizontal segment being expanded from the previous column.
-  int horzSeg;
+  if (m_bitmap && findModifiedArea(bitmap, origin, area)) {
+    // Nothing to do, same bitmap
+    if (area.isEmpty())
+      return;
 
-#define new_hseg(open) {                                        \
-    m_segs.push_back(Segment(open, gfx::Rect(x, y, 1, 0)));     \
-    horzSeg = int(m_segs.size()-1);                             \
-  }
-#define new_vseg(open) {                                        \
-    m_segs.push_back(Segment(open, gfx::Rect(x, y, 0, 1)));     \
-    vertSegs[x] = int(m_segs.size()-1);                         \
-  }
-#define expand_hseg() { \
-    ASSERT(hseg);       \
-    ++hseg->m_bounds.w; \
-  }
-#define expand_vseg() { \
-    ASSERT(vseg);       \
-    ++vseg->m_bounds.h; \
-  }
-#define stop_expanding_hseg() {                 \
-    horzSeg = -1;                               \
-  }
-#define stop_expanding_vseg() {                 \
-    vertSegs[x] = -1;                           \
+    // Horizontal lines (in Y) and vertical lines (in X) in bitmap
+    // coordinates crossing the modified area
+    const int y1 = area.y - origin.y, y2 = area.y2() - origin.y;
+    const int x1 = area.x - origin.x, x2 = area.x2() - origin.x;
+    const int hlines = std::max(0, std::min(y2, h) - std::max(y1, 0) + 1);
+    const int vlines = std::max(0, std::min(x2, w) - std::max(x1, 0) + 1);
+
+    // Regenerate only if it's cheaper than a full regeneration
+    if (int64_t(hlines)*w + int64_t(vlines)*h < int64_t(w)*h) {
+      list_type horz, vert;
+      regenLines(bitmap, origin, y1, y2, x1, x2, horz, vert);
+
+      // Replace the old segments of those lines with the new ones
+      const int ay1 = area.y, ay2 = area.y2();
+      const int ax1 = area.x, ax2 = area.x2();
+      auto it = m_segs.begin(), end = m_segs.end();
+      auto hBegin = std::partition_point(
+        it, end, [ay1](const Segment& seg){
+          return seg.horizontal() && seg.bounds().y < ay1;
+        });
+      auto hEnd = std::partition_point(
+        hBegin, end, [ay2](const Segment& seg){
+          return seg.horizontal() && seg.bounds().y <= ay2;
+        });
+      auto vStart = std::partition_point(
+        hEnd, end, [](const Segment& seg){
+          return seg.horizontal();
+        });
+      auto vBegin = std::partition_point(
+        vStart, end, [ax1](const Segment& seg){
+          return seg.bounds().x < ax1;
+        });
+      auto vEnd = std::partition_point(
+        vBegin, end, [ax2](const Segment& seg){
+          return seg.bounds().x <= ax2;
+        });
+
+      list_type segs;
+      segs.reserve(m_segs.size() - (hEnd - hBegin) - (vEnd - vBegin)
+                   + horz.size() + vert.size());
+      segs.insert(segs.end(), it, hBegin);
+      segs.insert(segs.end(), horz.begin(), horz.end());
+      segs.insert(segs.end(), hEnd, vBegin);
+      segs.insert(segs.end(), vert.begin(), vert.end());
+      segs.insert(segs.end(), vEnd, end);
+      m_segs.swap(segs);
+
+      if (!m_path.isEmpty())
+        m_path.rewind();
+      ++m_version;
+
+      m_bitmap.reset(Image::createCopy(bitmap));
+      m_origin = origin;
+      return;
+    }
   }
 
-  for (y=0; y<=h; ++y) {
-    bool prevColor = false;         // Previous color (X-1) same Y row
-    horzSeg = -1;
+  regen(bitmap);
+  offset(origin.x, origin.y);
 
-    for (x=0; x<=w; ++x) {
-      bool color = (x < w && y < h && *it ? true: false);
-#if _DEBUG
-      bool prevRowColor = (x < w && y > 0 && *prevIt ? true: false);
-#endif
-      Segment* hseg = (horzSeg >= 0 ? &m_segs[horzSeg]: nullptr);
-      Segment* vseg = (vertSegs[x] >= 0 ? &m_segs[vertSegs[x]]: nullptr);
-
-      //
-      // -   -
-      //
-      // -   1
-      //
-      if (color) {
-        //
-        // - | -
-        //   o
-        // -   1
-        //
-        if (vseg) {
-          //
-          // 0 | 1
-          //   o
-          // -   1
-          //
-          if (vseg->open()) {
-            ASSERT(prevRowColor);
-
-            //
-            // 0 | 1
-            // --x
-            // 1   1
-            //
-            if (hseg) {
-              ASSERT(hseg->open());
-              ASSERT(prevColor);
-              stop_expanding_hseg();
-              stop_expanding_vseg();
-            }
-            //
-            // 0 | 1
-            //   |
-            // 0 | 1
-            //   o
-            else {
-              ASSERT(!prevColor);
-              expand_vseg();
-            }
-          }
-          //
-          // 1 | 0
-          //   x--o
-          // -   1
-          //
-          else {
-            ASSERT(!prevRowColor);
-
-            //
-            // 1 | 0
-            // --x--o
-            // 0 | 1
-            //   o
-            if (hseg) {
-              ASSERT(!prevColor);
-              ASSERT(!hseg->open());
-              new_hseg(true);
-              new_vseg(true);
-            }
-            //
-            // 1 | 0
-            //   x--o
-            // 1   1
-            //
-            else {
-              ASSERT(prevColor);
-              new_hseg(true);
-              stop_expanding_vseg();
-            }
-          }
-        }
-        //
-        // -   -  (there is no vertical segment in this row, both colors are equal)
-        //
-        // -   1
-        //
-        else {
-          //
-          // -   -
-          // --o
-          // -   1
-          //
-          if (hseg) {
-            //
-            // 0   0
-            // -----o
-            // 1   1
-            //
-            if (hseg->open()) {
-              ASSERT(prevColor);
-              expand_hseg();
-            }
-            //
-            // 1   1
-            // --x
-            // 0 | 1
-            //   o
-            else {
-              ASSERT(!prevColor);
-              stop_expanding_hseg();
-              new_vseg(true);
-            }
-          }
-          else {
-            //
-            // 1   1
-            //
-            // 1   1
-            //
-            if (prevColor) {
-              // Do nothing, we are inside boundaries
-            }
-            //
-            // 0   0
-            //    --o
-            // 0 | 1
-            //   o
-            else {
-              // First two segments of a corner
-              new_hseg(true);
-              new_vseg(true);
-            }
-          }
-        }
+  m_bitmap.reset(Image::createCopy(bitmap));
+  m_origin = origin;
+}
+
+void MaskBoundaries::regen(const gfx::Rect& bounds)
+{
+  reset();
+
+  if (bounds.isEmpty())
+    return;
+
+  m_segs.push_back(Segment(true, gfx::Rect(bounds.x, bounds.y, bounds.w, 0)));
+  m_segs.push_back(Segment(false, gfx::Rect(bounds.x, bounds.y2(), bounds.w, 0)));
+  m_segs.push_back(Segment(true, gfx::Rect(bounds.x, bounds.y, 0, bounds.h)));
+  m_segs.push_back(Segment(false, gfx::Rect(bounds.x2(), bounds.y, 0, bounds.h)));
+}
+
+// Generates the segments of the horizontal lines [y1, y2] and
+// vertical lines [x1, x2] (in bitmap coordinates, a horizontal line
+// "y" is the edge between rows y-1 and y, a vertical line "x" is the
+// edge between columns x-1 and x). The segments are sorted and
+// translated to the given origin.
+void MaskBoundaries::regenLines(const Image* bitmap,
+                                const gfx::Point& origin,
+                                int y1, int y2,
+                                int x1, int x2,
+                                list_type& horz,
+                                list_type& vert) const
+{
+  const int w = bitmap->width();
+  const int h = bitmap->height();
+  y1 = std::max(y1, 0);
+  y2 = std::min(y2, h);
+  x1 = std::max(x1, 0);
+  x2 = std::min(x2, w);
+
+  // Horizontal segments, "open" when the pixel below is inside
+  for (int y=y1; y<=y2; ++y) {
+    const uint8_t* above = row_address(bitmap, y-1);
+    const uint8_t* below = row_address(bitmap, y);
+    int start = -1;
+    bool startOpen = false;
+
+    for (int x=0; x<=w; ++x) {
+      // Skip whole bytes without edges
+      if (start < 0 && (x & 7) == 0 && x+8 <= w &&
+          (above ? above[x >> 3]: 0) == (below ? below[x >> 3]: 0)) {
+        x += 7;
+        continue;
       }
-      //
-      // -   -
-      //
-      // -   0
-      //
-      else {
-        //
-        // - | -
-        //   o
-        // -   0
-        //
-        if (vseg) {
-          //
-          // 0 | 1
-          //   o
-          // -   0
-          //
-          if (vseg->open()) {
-            ASSERT(prevRowColor);
-
-            //
-            // 0 | 1
-            // --x--o
-            // 1 | 0
-            //   o
-            if (hseg) {
-              ASSERT(hseg->open());
-              ASSERT(prevColor);
-              new_hseg(false);
-              new_vseg(false);
-            }
-            //
-            // 0 | 1
-            //   x--o
-            // 0   0
-            //
-            else {
-              ASSERT(!prevColor);
-              new_hseg(false);
-              stop_expanding_vseg();
-            }
-          }
-          //
-          // 1 | 0
-          //   o
-          // -   0
-          //
-          else {
-            ASSERT(!prevRowColor);
-
-            //
-            // 1 | 0
-            // --x
-            // 0   0
-            //
-            if (hseg) {
-              ASSERT(!prevColor);
-              stop_expanding_hseg();
-              stop_expanding_vseg();
-            }
-            //
-            // 1 | 0
-            //   |
-            // 1 | 0
-            //   o
-            else {
-              ASSERT(prevColor);
-              expand_vseg();
-            }
-          }
-        }
-        //
-        // -   -  (there is no vertical segment in this row, both colors are equal)
-        //
-        // -   0
-        //
+
+      const bool a = (x < w && get_bit(above, x));
+      const bool b = (x < w && get_bit(below, x));
+      const bool edge = (a != b);
+
+      if (start >= 0 && (!edge || b != startOpen)) {
+        horz.push_back(Segment(startOpen,
+                               gfx::Rect(origin.x+start, origin.y+y,
+                                         x-start, 0)));
+        start = -1;
+      }
+      if (edge && start < 0) {
+        start = x;
+        startOpen = b;
+      }
+    }
+  }
+
+  if (x1 > x2)
+    return;
+
+  // Vertical segments, "open" when the pixel at the right is
+  // inside. Rows are iterated in order (instead of columns) to read
+  // the bitmap sequentially, so the segments are sorted at the end.
+  const size_t firstVert = vert.size();
+  std::vector<int> active(x2-x1+1, -1);
+
+  for (int y=0; y<h; ++y) {
+    const uint8_t* row = row_address(bitmap, y);
+
+    for (int x=x1; x<=x2; ++x) {
+      const bool left = (x > 0 && get_bit(row, x-1));
+      const bool right = (x < w && get_bit(row, x));
+      const bool edge = (left != right);
+      int& seg = active[x-x1];
+
+      if (seg >= 0 && (!edge || vert[seg].open() != right))
+        seg = -1;
+      if (edge) {
+        if (seg >= 0)
+          ++vert[seg].m_bounds.h;
         else {
-          //
-          // -   -
-          // --o
-          // -   0
-          //
-          if (hseg) {
-            //
-            // 0   0
-            // --x
-            // 1 | 0
-            //   o
-            if (hseg->open()) {
-              ASSERT(prevColor);
-              stop_expanding_hseg();
-              new_vseg(false);
-            }
-            //
-            // 1   1
-            // -----o
-            // 0   0
-            //
-            else {
-              ASSERT(!prevColor);
-              expand_hseg();
-            }
-          }
-          else {
-            //
-            // 1   1
-            //    --o
-            // 1 | 0
-            //   o
-            if (prevColor) {
-              new_hseg(false);
-              new_vseg(false);
-            }
-            //
-            // 0   0
-            //
-            // 0   0
-            //
-            else {
-              // Do nothing, we are inside boundaries
-            }
-          }
+          vert.push_back(Segment(right,
+                                 gfx::Rect(origin.x+x, origin.y+y, 0, 1)));
+          seg = int(vert.size()-1);
         }
       }
+    }
+  }
 
-      prevColor = color;
-      if (x < w) {
-#if _DEBUG
-        if (y > 0) ++prevIt;
-#endif
-        if (y < h) ++it;
-      }
+  std::sort(vert.begin()+firstVert, vert.end(),
+            [](const Segment& a, const Segment& b){
+              return (a.bounds().x < b.bounds().x ||
+                      (a.bounds().x == b.bounds().x &&
+                       a.bounds().y < b.bounds().y));
+            });
+}
+
+// Returns the modified area between the cached bitmap and the given
+// one (in absolute coordinates, an empty rectangle if they are
+// equal). Returns false if the area cannot be calculated comparing
+// bytes (the bitmaps are not aligned in the X axis).
+bool MaskBoundaries::findModifiedArea(const Image* bitmap,
+                                      const gfx::Point& origin,
+                                      gfx::Rect& area) const
+{
+  if (m_origin.x != origin.x)
+    return false;
+
+  const Image* oldBitmap = m_bitmap.get();
+  const int oldWidthBytes = BitmapTraits::width_bytes(oldBitmap->width());
+  const int newWidthBytes = BitmapTraits::width_bytes(bitmap->width());
+  const int widthBytes = std::max(oldWidthBytes, newWidthBytes);
+  const uint8_t oldLastMask = last_byte_mask(oldBitmap->width());
+  const uint8_t newLastMask = last_byte_mask(bitmap->width());
+  const int yBegin = std::min(m_origin.y, origin.y);
+  const int yEnd = std::max(m_origin.y + oldBitmap->height(),
+                            origin.y + bitmap->height());
+
+  int minI = widthBytes, maxI = -1;
+  int minY = yEnd, maxY = yBegin-1;
+
+  for (int y=yBegin; y<yEnd; ++y) {
+    const uint8_t* oldRow = row_address(oldBitmap, y - m_origin.y);
+    const uint8_t* newRow = row_address(bitmap, y - origin.y);
+
+    auto differ = [&](const int i) {
+      return (get_byte(oldRow, i, oldWidthBytes, oldLastMask) !=
+              get_byte(newRow, i, newWidthBytes, newLastMask));
+    };
+
+    int i = 0;
+    // Fast comparison for rows with the same width
+    if (oldRow && newRow && oldWidthBytes == newWidthBytes &&
+        std::equal(oldRow, oldRow+oldWidthBytes-1, newRow)) {
+      i = oldWidthBytes-1;
     }
+    while (i < widthBytes && !differ(i))
+      ++i;
+    if (i == widthBytes)
+      continue;
+
+    int j = widthBytes-1;
+    while (j > i && !differ(j))
+      --j;
+
+    minI = std::min(minI, i);
+    maxI = std::max(maxI, j);
+    minY = std::min(minY, y);
+    maxY = std::max(maxY, y);
   }
 
-  ASSERT(it == bits.end());
-  ASSERT(prevIt == bits.end());
+  if (maxI < 0)
+    area = gfx::Rect();
+  else
+    area = gfx::Rect(origin.x + minI*8, minY,
+                     (maxI-minI+1)*8, maxY-minY+1);
+  return true;
 }
 
 void MaskBoundaries::offset(int x, int y)
@@ -345,6 +318,9 @@ void MaskBoundaries::offset(int x, int y)
     seg.offset(x, y);
 
   m_path.offset(x, y);
+  m_origin.x += x;
+  m_origin.y += y;
+  ++m_version;
 }
 
 void MaskBoundaries::createPathIfNeeeded()
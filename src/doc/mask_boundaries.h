@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2020 Igara Studio S.A.
+// Copyright (c) 2020-2024 Igara Studio S.A.
 // Copyright (c) 2001-2015 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,7 +9,9 @@
 #define DOC_MASK_BOUNDARIES_H_INCLUDED
 #pragma once
 
+#include "doc/image_ref.h"
 #include "gfx/path.h"
+#include "gfx/point.h"
 #include "gfx/rect.h"
 
 #include <vector>
@@ -45,8 +47,21 @@ namespace doc {
 
     bool isEmpty() const { return m_segs.empty(); }
     void reset();
+
+    // Generates the boundaries of the whole bitmap (segments are in
+    // bitmap coordinates).
     void regen(const Image* bitmap);
 
+    // Generates the boundaries of a bitmap located at the given
+    // origin (e.g. the bitmap of a doc::Mask). A copy of the bitmap
+    // is kept, so the next call only regenerates the horizontal and
+    // vertical lines that cross the modified area of the bitmap
+    // (e.g. when a small rectangle is added to a big selection).
+    void regen(const Image* bitmap, const gfx::Point& origin);
+
+    // Generates the boundaries of a rectangle (without a bitmap).
+    void regen(const gfx::Rect& bounds);
+
     const_iterator begin() const { return m_segs.begin(); }
     const_iterator end() const { return m_segs.end(); }
     iterator begin() { return m_segs.begin(); }
@@ -55,11 +70,31 @@ namespace doc {
     void offset(int x, int y);
     gfx::Path& path() { return m_path; }
 
+    // Incremented each time the segments are modified.
+    int version() const { return m_version; }
+
     void createPathIfNeeeded();
 
   private:
+    void regenLines(const Image* bitmap,
+                    const gfx::Point& origin,
+                    int y1, int y2,
+                    int x1, int x2,
+                    list_type& horz,
+                    list_type& vert) const;
+    bool findModifiedArea(const Image* bitmap,
+                          const gfx::Point& origin,
+                          gfx::Rect& area) const;
+
+    // Horizontal segments first (sorted by Y, X), then vertical
+    // segments (sorted by X, Y).
     list_type m_segs;
     gfx::Path m_path;
+    int m_version = 0;
+
+    // Bitmap used in the last regen(bitmap, origin) call.
+    ImageRef m_bitmap;
+    gfx::Point m_origin;
   };
 
 } // namespace doc
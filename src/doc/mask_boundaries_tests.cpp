@@ -0,0 +1,89 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "gtest/gtest.h"
+
+#include "doc/mask.h"
+#include "doc/mask_boundaries.h"
+
+#include <cstdlib>
+#include <vector>
+
+using namespace doc;
+
+static void expect_same_boundaries(const MaskBoundaries& a,
+                                   const MaskBoundaries& b)
+{
+  std::vector<MaskBoundaries::Segment> as(a.begin(), a.end());
+  std::vector<MaskBoundaries::Segment> bs(b.begin(), b.end());
+  ASSERT_EQ(as.size(), bs.size());
+  for (size_t i=0; i<as.size(); ++i) {
+    EXPECT_EQ(as[i].open(), bs[i].open());
+    EXPECT_EQ(as[i].bounds(), bs[i].bounds());
+  }
+}
+
+TEST(MaskBoundaries, Rectangle)
+{
+  Mask mask;
+  mask.replace(gfx::Rect(2, 3, 4, 5));
+
+  MaskBoundaries segs;
+  segs.regen(mask.bitmap(), mask.bounds().origin());
+
+  std::vector<MaskBoundaries::Segment> v(segs.begin(), segs.end());
+  ASSERT_EQ(4, v.size());
+  EXPECT_EQ(gfx::Rect(2, 3, 4, 0), v[0].bounds()); EXPECT_TRUE(v[0].open());
+  EXPECT_EQ(gfx::Rect(2, 8, 4, 0), v[1].bounds()); EXPECT_FALSE(v[1].open());
+  EXPECT_EQ(gfx::Rect(2, 3, 0, 5), v[2].bounds()); EXPECT_TRUE(v[2].open());
+  EXPECT_EQ(gfx::Rect(6, 3, 0, 5), v[3].bounds()); EXPECT_FALSE(v[3].open());
+}
+
+TEST(MaskBoundaries, IncrementalRegen)
+{
+  std::srand(1);
+
+  Mask mask;
+  mask.replace(gfx::Rect(10, 10, 100, 60));
+
+  MaskBoundaries incremental;
+  incremental.regen(mask.bitmap(), mask.bounds().origin());
+
+  for (int i=0; i<300; ++i) {
+    const gfx::Rect rc(std::rand() % 150 - 20,
+                       std::rand() % 100 - 20,
+                       1 + std::rand() % 20,
+                       1 + std::rand() % 20);
+    if (std::rand() % 3 == 0)
+      mask.subtract(rc);
+    else
+      mask.add(rc);
+
+    if (mask.isEmpty()) {
+      mask.replace(rc);
+    }
+
+    // Moving the boundaries with the mask must keep them valid
+    if (std::rand() % 10 == 0) {
+      mask.offsetOrigin(3, -2);
+      incremental.offset(3, -2);
+    }
+
+    incremental.regen(mask.bitmap(), mask.bounds().origin());
+
+    MaskBoundaries full;
+    full.regen(mask.bitmap());
+    full.offset(mask.bounds().x, mask.bounds().y);
+
+    expect_same_boundaries(full, incremental);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2023 Igara Studio S.A.
+// Copyright (c) 2023-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -62,7 +62,7 @@ Mask* read_mask(std::istream& is)
 
     mask->add(gfx::Rect(x, y, w, h));
     for (int c=0; c<mask->bounds().h; c++)
-      is.read((char*)mask->bitmap()->getPixelAddress(0, c), size);
+      is.read((char*)mask->editableBitmap()->getPixelAddress(0, c), size);
   }
 
   return mask.release();
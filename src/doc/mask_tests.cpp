@@ -0,0 +1,164 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "gtest/gtest.h"
+
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/mask.h"
+#include "doc/primitives.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace doc;
+using namespace gfx;
+
+static void expect_same_mask(const Mask& a, const Mask& b)
+{
+  ASSERT_EQ(a.isEmpty(), b.isEmpty());
+  EXPECT_EQ(a.bounds(), b.bounds());
+  for (int v=-5; v<60; ++v)
+    for (int u=-5; u<60; ++u)
+      ASSERT_EQ(a.containsPoint(u, v), b.containsPoint(u, v))
+        << "Point " << u << "," << v;
+}
+
+TEST(Mask, RectangleWithoutBitmap)
+{
+  Mask mask;
+  mask.replace(Rect(0, 0, 16000, 16000));
+  EXPECT_TRUE(mask.isKnownRectangle());
+  EXPECT_TRUE(mask.isRectangular());
+  EXPECT_EQ(int(sizeof(Mask)), mask.getMemSize());
+
+  mask.intersect(Rect(10, 20, 30, 40));
+  EXPECT_TRUE(mask.isKnownRectangle());
+  EXPECT_EQ(Rect(10, 20, 30, 40), mask.bounds());
+
+  mask.add(Rect(10, 60, 30, 5));
+  EXPECT_TRUE(mask.isKnownRectangle());
+  EXPECT_EQ(Rect(10, 20, 30, 45), mask.bounds());
+
+  mask.subtract(Rect(0, 0, 15, 100));
+  EXPECT_TRUE(mask.isKnownRectangle());
+  EXPECT_EQ(Rect(15, 20, 25, 45), mask.bounds());
+
+  Mask copy(mask);
+  EXPECT_TRUE(copy.isKnownRectangle());
+  EXPECT_EQ(mask.bounds(), copy.bounds());
+
+  // The bitmap is only a cache
+  ASSERT_TRUE(mask.bitmap() != nullptr);
+  EXPECT_EQ(25, mask.bitmap()->width());
+  EXPECT_EQ(1, get_pixel(mask.bitmap(), 0, 0));
+  EXPECT_TRUE(mask.isKnownRectangle());
+
+  // The editable one can be modified
+  put_pixel(mask.editableBitmap(), 0, 0, 0);
+  EXPECT_FALSE(mask.isKnownRectangle());
+  EXPECT_FALSE(mask.containsPoint(15, 20));
+  EXPECT_TRUE(mask.containsPoint(16, 20));
+
+  mask.replace(Rect(0, 0, 4, 4));
+  mask.invert();
+  EXPECT_TRUE(mask.isEmpty());
+}
+
+TEST(Mask, RectangleOperationsMatchBitmap)
+{
+  std::srand(1);
+
+  for (int test=0; test<500; ++test) {
+    const Rect rc1(std::rand() % 30, std::rand() % 30,
+                   1 + std::rand() % 25, 1 + std::rand() % 25);
+    const Rect rc2(std::rand() % 30, std::rand() % 30,
+                   1 + std::rand() % 25, 1 + std::rand() % 25);
+
+    Mask a, b;
+    a.replace(rc1);
+    b.replace(rc1);
+    b.editableBitmap();        // Convert "b" to a bitmap mask
+    ASSERT_FALSE(b.isKnownRectangle());
+
+    switch (std::rand() % 3) {
+      case 0: a.add(rc2); b.add(rc2); break;
+      case 1: a.subtract(rc2); b.subtract(rc2); break;
+      case 2: a.intersect(rc2); b.intersect(rc2); break;
+    }
+    expect_same_mask(a, b);
+
+    Mask c;
+    c.replace(rc2);
+    a.add(c);
+    b.add(c);
+    expect_same_mask(a, b);
+  }
+}
+
+TEST(Mask, ByColor)
+{
+  std::srand(2);
+
+  for (const PixelFormat format : { IMAGE_RGB, IMAGE_GRAYSCALE, IMAGE_INDEXED }) {
+    ImageRef image(Image::create(format, 77, 300));
+    const color_t color =
+      (format == IMAGE_RGB ? rgba(100, 120, 140, 255):
+       format == IMAGE_GRAYSCALE ? graya(100, 255): 100);
+    for (int y=0; y<image->height(); ++y) {
+      for (int x=0; x<image->width(); ++x) {
+        color_t c;
+        switch (format) {
+          case IMAGE_RGB:
+            c = rgba(95 + std::rand() % 10, 120, 140 + std::rand() % 10, 255);
+            break;
+          case IMAGE_GRAYSCALE:
+            c = graya(95 + std::rand() % 10, 250 + std::rand() % 6);
+            break;
+          default:
+            c = 95 + std::rand() % 10;
+            break;
+        }
+        put_pixel(image.get(), x, y, c);
+      }
+    }
+
+    ImageRef distanceMap = Mask::createColorDistanceMap(image.get(), color);
+    for (int fuzziness : { 0, 2, 5 }) {
+      Mask a, b;
+      a.byColor(image.get(), color, fuzziness);
+      b.byColorDistance(distanceMap.get(), fuzziness);
+      expect_same_mask(a, b);
+
+      for (int y=0; y<image->height(); ++y) {
+        for (int x=0; x<image->width(); ++x) {
+          const color_t c = get_pixel(image.get(), x, y);
+          int d;
+          switch (format) {
+            case IMAGE_RGB:
+              d = std::max(std::abs(int(rgba_getr(c)) - 100),
+                           std::abs(int(rgba_getb(c)) - 140));
+              break;
+            case IMAGE_GRAYSCALE:
+              d = std::max(std::abs(int(graya_getv(c)) - 100),
+                           std::abs(int(graya_geta(c)) - 255));
+              break;
+            default:
+              d = std::abs(int(c) - 100);
+              break;
+          }
+          ASSERT_EQ(d <= fuzziness, a.containsPoint(x, y));
+        }
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
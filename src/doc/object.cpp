@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -13,15 +13,34 @@
 
 #include "base/debug.h"
 
-#include <map>
+#include <atomic>
 #include <mutex>
+#include <unordered_map>
 
 namespace doc {
 
-static std::mutex g_mutex;
-static ObjectId newId = 0;
-// TODO Profile this and see if an unordered_map is better
-static std::map<ObjectId, Object*> objects;
+namespace {
+
+// Objects are registered in several shards (each one with its own
+// mutex) so threads creating/looking up objects at the same time
+// rarely wait for each other. IDs are consecutive, so using the
+// lowest bits of the ID distributes objects evenly between shards.
+constexpr ObjectId kShards = 64;
+
+struct alignas(64) Shard {
+  std::mutex mutex;
+  std::unordered_map<ObjectId, Object*> objects;
+};
+
+std::atomic<ObjectId> newId(0);
+Shard shards[kShards];
+
+inline Shard& shard_for(const ObjectId id)
+{
+  return shards[id % kShards];
+}
+
+} // anonymous namespace
 
 Object::Object(ObjectType type)
   : m_type(type)
@@ -53,31 +72,36 @@ const ObjectId Object::id() const
   // The first time the ID is request, we store the object in the
   // "objects" hash table.
   if (!m_id) {
-    const std::lock_guard lock(g_mutex);
-    m_id = ++newId;
-    objects.insert(std::make_pair(m_id, const_cast<Object*>(this)));
+    const ObjectId id = ++newId;
+    Shard& shard = shard_for(id);
+    const std::lock_guard lock(shard.mutex);
+    shard.objects.insert(std::make_pair(id, const_cast<Object*>(this)));
+    m_id = id;
   }
   return m_id;
 }
 
 void Object::setId(ObjectId id)
 {
-  const std::lock_guard lock(g_mutex);
-
   if (m_id) {
-    auto it = objects.find(m_id);
-    ASSERT(it != objects.end());
+    Shard& shard = shard_for(m_id);
+    const std::lock_guard lock(shard.mutex);
+    auto it = shard.objects.find(m_id);
+    ASSERT(it != shard.objects.end());
     ASSERT(it->second == this);
-    if (it != objects.end())
-      objects.erase(it);
+    if (it != shard.objects.end())
+      shard.objects.erase(it);
   }
 
   m_id = id;
 
   if (m_id) {
+    Shard& shard = shard_for(m_id);
+    const std::lock_guard lock(shard.mutex);
 #ifdef _DEBUG
-    if (objects.find(m_id) != objects.end()) {
-      Object* obj = objects.find(m_id)->second;
+    auto it = shard.objects.find(m_id);
+    if (it != shard.objects.end()) {
+      Object* obj = it->second;
       if (obj) {
         TRACEARGS("ASSERT FAILED: Object with id", m_id,
                   "of kind", int(obj->type()),
@@ -88,9 +112,9 @@ void Object::setId(ObjectId id)
                   "registered as nullptr should not exist");
       }
     }
-    ASSERT(objects.find(m_id) == objects.end());
+    ASSERT(it == shard.objects.end());
 #endif
-    objects.insert(std::make_pair(m_id, this));
+    shard.objects.insert(std::make_pair(m_id, this));
   }
 }
 
@@ -101,9 +125,10 @@ void Object::setVersion(ObjectVersion version)
 
 Object* get_object(ObjectId id)
 {
-  const std::lock_guard lock(g_mutex);
-  auto it = objects.find(id);
-  if (it != objects.end())
+  Shard& shard = shard_for(id);
+  const std::lock_guard lock(shard.mutex);
+  auto it = shard.objects.find(id);
+  if (it != shard.objects.end())
     return it->second;
   else
     return nullptr;
@@ -0,0 +1,104 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/object.h"
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace doc;
+
+// The previous registry (one std::map guarded by one mutex) to
+// compare it with the registry used by doc::Object.
+static std::mutex g_mapMutex;
+static std::map<ObjectId, Object*> g_map;
+static ObjectId g_mapNewId = 0;
+
+static ObjectId map_register(Object* obj)
+{
+  const std::lock_guard lock(g_mapMutex);
+  const ObjectId id = ++g_mapNewId;
+  g_map.insert(std::make_pair(id, obj));
+  return id;
+}
+
+static void map_unregister(const ObjectId id)
+{
+  const std::lock_guard lock(g_mapMutex);
+  g_map.erase(id);
+}
+
+static Object* map_get(const ObjectId id)
+{
+  const std::lock_guard lock(g_mapMutex);
+  auto it = g_map.find(id);
+  return (it != g_map.end() ? it->second: nullptr);
+}
+
+// Creates/destroys objects (asking for their IDs so they are
+// registered)
+void BM_ObjectCreateMap(benchmark::State& state) {
+  Object obj(ObjectType::Image);
+  while (state.KeepRunning()) {
+    const ObjectId id = map_register(&obj);
+    benchmark::DoNotOptimize(id);
+    map_unregister(id);
+  }
+}
+
+void BM_ObjectCreate(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    Object obj(ObjectType::Image);
+    benchmark::DoNotOptimize(obj.id());
+  }
+}
+
+// Looks up objects by ID
+void BM_ObjectLookupMap(benchmark::State& state) {
+  Object obj(ObjectType::Image);
+  std::vector<ObjectId> ids(state.range(0));
+  for (auto& id : ids)
+    id = map_register(&obj);
+
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(map_get(ids[i]));
+    i = (i+1) % ids.size();
+  }
+
+  for (auto id : ids)
+    map_unregister(id);
+}
+
+void BM_ObjectLookup(benchmark::State& state) {
+  std::vector<std::unique_ptr<Object>> objs(state.range(0));
+  std::vector<ObjectId> ids(objs.size());
+  for (std::size_t j=0; j<objs.size(); ++j) {
+    objs[j] = std::make_unique<Object>(ObjectType::Image);
+    ids[j] = objs[j]->id();
+  }
+
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(get_object(ids[i]));
+    i = (i+1) % ids.size();
+  }
+}
+
+BENCHMARK(BM_ObjectCreateMap)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_ObjectCreate)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_ObjectLookupMap)->Arg(100000)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_ObjectLookup)->Arg(100000)->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK_MAIN();
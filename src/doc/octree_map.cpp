@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (c) 2020-2023 Igara Studio S.A.
+// Copyright (c) 2020-2024 Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -271,6 +271,18 @@ int OctreeMap::mapColor(color_t rgba) const
                          m_palette, 0);
 }
 
+void OctreeMap::mapColors(const color_t* src, uint8_t* dst, const int n) const
+{
+  for (int i=0; i<n; ++i) {
+    // Reuse the previous index for runs of the same color (each
+    // lookup has to walk 8 levels of the octree)
+    if (i > 0 && src[i] == src[i-1])
+      dst[i] = dst[i-1];
+    else
+      dst[i] = OctreeMap::mapColor(src[i]);
+  }
+}
+
 void OctreeMap::regenerateMap(const Palette* palette, const int maskIndex)
 {
   ASSERT(palette);
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2020-2023 Igara Studio S.A.
+// Copyright (c) 2020-2024 Igara Studio S.A.
 // Copyright (c) 2001-2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -127,6 +127,14 @@ bool Palette::hasSemiAlpha() const
   return false;
 }
 
+int Palette::getMemSize() const
+{
+  int size = sizeof(Palette) + sizeof(color_t)*m_colors.size();
+  for (const std::string& name : m_names)
+    size += sizeof(std::string) + name.size();
+  return size;
+}
+
 void Palette::setFrame(frame_t frame)
 {
   ASSERT(frame >= 0);
@@ -415,6 +423,180 @@ static void rgbToOtherSpace(double& r, double& g, double& b, FitCriteria fc)
   }
 }
 
+// With less colors than this a linear search is faster than using
+// the BestfitIndex.
+static constexpr size_t kMinColorsForBestfitIndex = 32;
+
+// Weights of each component used in the col_diff tables (in the
+// same order the components are stored in BestfitIndex nodes).
+static constexpr int kBestfitWeights[4] = { 59*59, 30*30, 11*11, 8*8 };
+
+// k-d tree of the palette colors (with 5 bits per component) to find
+// the best fit color without comparing it with each palette entry.
+// It returns exactly the same result as findBestfitLinear() (using
+// the same distance and returning the lowest index in case of ties).
+class Palette::BestfitIndex {
+public:
+  BestfitIndex(const std::vector<color_t>& colors, const int modifications)
+    : m_modifications(modifications) {
+    const int size = std::min(256, int(colors.size()));
+    m_nodes.resize(size);
+    for (int i=0; i<size; ++i) {
+      const color_t c = colors[i];
+      Node& node = m_nodes[i];
+      node.c[0] = rgba_getg(c)>>3;
+      node.c[1] = rgba_getr(c)>>3;
+      node.c[2] = rgba_getb(c)>>3;
+      node.c[3] = rgba_geta(c)>>3;
+      node.axis = 0;
+      node.index = i;
+    }
+    build(0, size);
+  }
+
+  int modifications() const { return m_modifications; }
+
+  int find(const int r, const int g, const int b, const int a,
+           const int mask_index) const {
+    const int q[4] = { g, r, b, a };
+    int lowest = std::numeric_limits<int>::max();
+    int bestfit = 0;
+    search(0, int(m_nodes.size()), q, mask_index, lowest, bestfit);
+    return bestfit;
+  }
+
+private:
+  struct Node {
+    uint8_t c[4];               // Components in 5 bits (g, r, b, a)
+    uint8_t axis;               // Component used to split this node
+    int index;                  // Palette index
+  };
+
+  // The tree is stored implicitly: the node in the middle of the
+  // [lo,hi) range splits the range in two sub-trees.
+  void build(const int lo, const int hi) {
+    if (hi - lo <= 1)
+      return;
+
+    // Split by the component with the largest weighted spread
+    int axis = 0;
+    int maxSpread = -1;
+    for (int k=0; k<4; ++k) {
+      int lower = 255, upper = 0;
+      for (int i=lo; i<hi; ++i) {
+        lower = std::min<int>(lower, m_nodes[i].c[k]);
+        upper = std::max<int>(upper, m_nodes[i].c[k]);
+      }
+      const int spread = kBestfitWeights[k] * (upper - lower) * (upper - lower);
+      if (spread > maxSpread) {
+        maxSpread = spread;
+        axis = k;
+      }
+    }
+
+    const int mid = (lo + hi) / 2;
+    std::nth_element(m_nodes.begin()+lo,
+                     m_nodes.begin()+mid,
+                     m_nodes.begin()+hi,
+                     [axis](const Node& a, const Node& b){
+                       return a.c[axis] < b.c[axis];
+                     });
+    m_nodes[mid].axis = axis;
+
+    build(lo, mid);
+    build(mid+1, hi);
+  }
+
+  void search(const int lo, const int hi, const int q[4],
+              const int mask_index, int& lowest, int& bestfit) const {
+    if (lo >= hi)
+      return;
+
+    const int mid = (lo + hi) / 2;
+    const Node& node = m_nodes[mid];
+
+    if (node.index != mask_index) {
+      int diff = 0;
+      for (int k=0; k<4; ++k) {
+        const int d = q[k] - node.c[k];
+        diff += kBestfitWeights[k] * d * d;
+      }
+      if (diff < lowest ||
+          (diff == lowest && node.index < bestfit)) {
+        lowest = diff;
+        bestfit = node.index;
+      }
+    }
+
+    const int d = q[node.axis] - node.c[node.axis];
+    if (d < 0) {
+      search(lo, mid, q, mask_index, lowest, bestfit);
+      // We use <= to find colors with the same distance too (ties
+      // must return the lowest index)
+      if (kBestfitWeights[node.axis] * d * d <= lowest)
+        search(mid+1, hi, q, mask_index, lowest, bestfit);
+    }
+    else {
+      search(mid+1, hi, q, mask_index, lowest, bestfit);
+      if (kBestfitWeights[node.axis] * d * d <= lowest)
+        search(lo, mid, q, mask_index, lowest, bestfit);
+    }
+  }
+
+  std::vector<Node> m_nodes;
+  int m_modifications;
+};
+
+std::shared_ptr<const Palette::BestfitIndex> Palette::bestfitIndex() const
+{
+  std::scoped_lock lock(m_bestfitMutex);
+  if (!m_bestfitIndex ||
+      m_bestfitIndex->modifications() != m_modifications) {
+    m_bestfitIndex = std::make_shared<BestfitIndex>(m_colors, m_modifications);
+  }
+  return m_bestfitIndex;
+}
+
+int Palette::findBestfitLinear(int r, int g, int b, int a, int mask_index) const
+{
+  r >>= 3;
+  g >>= 3;
+  b >>= 3;
+  a >>= 3;
+
+  // Mask index is like alpha = 0, so we can use it as transparent color.
+  if (a == 0 && mask_index >= 0)
+    return mask_index;
+
+  int bestfit = 0;
+  int lowest = std::numeric_limits<int>::max();
+  int size = std::min(256, int(m_colors.size()));
+
+  for (int i=0; i<size; ++i) {
+    color_t rgb = m_colors[i];
+
+    int coldiff = col_diff_g[((rgba_getg(rgb)>>3) - g) & 127];
+    if (coldiff < lowest) {
+      coldiff += col_diff_r[(((rgba_getr(rgb)>>3) - r) & 127)];
+      if (coldiff < lowest) {
+        coldiff += col_diff_b[(((rgba_getb(rgb)>>3) - b) & 127)];
+        if (coldiff < lowest) {
+          coldiff += col_diff_a[(((rgba_geta(rgb)>>3) - a) & 127)];
+          if (coldiff < lowest && i != mask_index) {
+            if (coldiff == 0)
+              return i;
+
+            bestfit = i;
+            lowest = coldiff;
+          }
+        }
+      }
+    }
+  }
+
+  return bestfit;
+}
+
 int Palette::findBestfit(int r, int g, int b, int a, int mask_index) const
 {
   ASSERT(r >= 0 && r <= 255);
@@ -427,42 +609,14 @@ int Palette::findBestfit(int r, int g, int b, int a, int mask_index) const
   if (fc == FitCriteria::OLD) {
     ASSERT(!col_diff.empty());
 
-    r >>= 3;
-    g >>= 3;
-    b >>= 3;
-    a >>= 3;
-
     // Mask index is like alpha = 0, so we can use it as transparent color.
-    if (a == 0 && mask_index >= 0)
+    if ((a>>3) == 0 && mask_index >= 0)
       return mask_index;
 
-    int bestfit = 0;
-    int lowest = std::numeric_limits<int>::max();
-    int size = std::min(256, int(m_colors.size()));
-
-    for (int i=0; i<size; ++i) {
-      color_t rgb = m_colors[i];
+    if (m_colors.size() >= kMinColorsForBestfitIndex)
+      return bestfitIndex()->find(r>>3, g>>3, b>>3, a>>3, mask_index);
 
-      int coldiff = col_diff_g[((rgba_getg(rgb)>>3) - g) & 127];
-      if (coldiff < lowest) {
-        coldiff += col_diff_r[(((rgba_getr(rgb)>>3) - r) & 127)];
-        if (coldiff < lowest) {
-          coldiff += col_diff_b[(((rgba_getb(rgb)>>3) - b) & 127)];
-          if (coldiff < lowest) {
-            coldiff += col_diff_a[(((rgba_geta(rgb)>>3) - a) & 127)];
-            if (coldiff < lowest && i != mask_index) {
-              if (coldiff == 0)
-                return i;
-
-              bestfit = i;
-              lowest = coldiff;
-            }
-          }
-        }
-      }
-    }
-
-    return bestfit;
+    return findBestfitLinear(r, g, b, a, mask_index);
   }
 
   if (a == 0 && mask_index >= 0)
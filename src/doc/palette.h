@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2020-2023  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -15,8 +15,10 @@
 #include "doc/object.h"
 #include "doc/palette_gradient_type.h"
 
-#include <vector>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace doc {
 
@@ -36,6 +38,8 @@ namespace doc {
 
     static Palette* createGrayscale();
 
+    int getMemSize() const override;
+
     int size() const { return (int)m_colors.size(); }
     void resize(int ncolors, color_t color = doc::rgba(0, 0, 0, 255));
 
@@ -115,12 +119,22 @@ namespace doc {
     const std::string& getEntryName(const int i) const;
 
   private:
+    class BestfitIndex;
+
+    int findBestfitLinear(int r, int g, int b, int a, int mask_index) const;
+    std::shared_ptr<const BestfitIndex> bestfitIndex() const;
+
     frame_t m_frame;
     std::vector<color_t> m_colors;
     std::vector<std::string> m_names;
     int m_modifications;
     std::string m_filename; // If the palette is associated with a file.
     std::string m_comment; // Some extra comment from the .gpl file (author, website, etc.).
+
+    // Index to accelerate findBestfit() calls, it's re-created when
+    // the palette is modified (m_modifications changes).
+    mutable std::mutex m_bestfitMutex;
+    mutable std::shared_ptr<const BestfitIndex> m_bestfitIndex;
   };
 
 } // namespace doc
@@ -0,0 +1,93 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/palette.h"
+
+#include <limits>
+#include <random>
+
+using namespace doc;
+
+// Reference implementation of the "old" bestfit criteria (same as
+// Palette::findBestfit without any acceleration structure).
+static int bestfit_reference(const Palette& pal,
+                             int r, int g, int b, int a,
+                             const int mask_index)
+{
+  r >>= 3; g >>= 3; b >>= 3; a >>= 3;
+  if (a == 0 && mask_index >= 0)
+    return mask_index;
+
+  int bestfit = 0;
+  int lowest = std::numeric_limits<int>::max();
+  for (int i=0; i<std::min(256, pal.size()); ++i) {
+    const color_t c = pal.getEntry(i);
+    const int dr = (rgba_getr(c)>>3) - r;
+    const int dg = (rgba_getg(c)>>3) - g;
+    const int db = (rgba_getb(c)>>3) - b;
+    const int da = (rgba_geta(c)>>3) - a;
+    const int diff =
+      dg*dg*59*59 + dr*dr*30*30 + db*db*11*11 + da*da*8*8;
+    if (diff < lowest && i != mask_index) {
+      bestfit = i;
+      lowest = diff;
+    }
+  }
+  return bestfit;
+}
+
+TEST(Palette, FindBestfitMatchesLinearSearch)
+{
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> dist(0, 255);
+
+  for (int ncolors : { 4, 16, 32, 100, 256 }) {
+    Palette pal(frame_t(0), ncolors);
+    for (int i=0; i<ncolors; ++i) {
+      pal.setEntry(i, rgba(dist(rng), dist(rng), dist(rng),
+                           (i % 3 == 0 ? dist(rng): 255)));
+    }
+    // Repeated entries (ties must return the lowest index)
+    pal.setEntry(ncolors-1, pal.getEntry(ncolors/2));
+
+    for (int mask : { -1, 0, ncolors/2 }) {
+      for (int j=0; j<2000; ++j) {
+        const int r = dist(rng), g = dist(rng), b = dist(rng), a = dist(rng);
+        EXPECT_EQ(bestfit_reference(pal, r, g, b, a, mask),
+                  pal.findBestfit(r, g, b, a, mask))
+          << "ncolors=" << ncolors << " mask=" << mask
+          << " rgba=" << r << "," << g << "," << b << "," << a;
+      }
+    }
+  }
+}
+
+TEST(Palette, FindBestfitAfterModifications)
+{
+  Palette pal(frame_t(0), 64);
+  for (int i=0; i<64; ++i)
+    pal.setEntry(i, rgba(i*4, 0, 0, 255));
+  EXPECT_EQ(10, pal.findBestfit(40, 0, 0, 255, -1));
+
+  pal.setEntry(20, rgba(0, 0, 255, 255));
+  EXPECT_EQ(20, pal.findBestfit(0, 0, 255, 255, -1));
+
+  pal.resize(40);
+  EXPECT_EQ(38, pal.findBestfit(255, 0, 0, 255, -1));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  doc::Palette::initBestfit();
+  return RUN_ALL_TESTS();
+}
@@ -15,6 +15,7 @@
 #include "doc/sprite.h"
 #include "doc/tag.h"
 
+#include <algorithm>
 #include <limits>
 
 #define PLAY_TRACE(...) // TRACEARGS
@@ -648,4 +649,68 @@ int Playback::getParentForward() const
     return m_playing.back()->forward;
 }
 
+//////////////////////////////////////////////////////////////////////
+// PlaybackSequence
+
+PlaybackSequence::PlaybackSequence(const Sprite* sprite,
+                                   const TagsList& tagsList,
+                                   const frame_t frame,
+                                   const Playback::Mode playMode,
+                                   const Tag* tag,
+                                   const int forward)
+{
+  Playback playback(sprite, tagsList, frame, playMode, tag, forward);
+  build(playback);
+}
+
+PlaybackSequence::PlaybackSequence(const Sprite* sprite,
+                                   const frame_t frame,
+                                   const Playback::Mode playMode,
+                                   const Tag* tag)
+{
+  Playback playback(sprite, frame, playMode, tag);
+  build(playback);
+}
+
+bool PlaybackSequence::isValid(const Sprite* sprite) const
+{
+  return (sprite == m_sprite &&
+          sprite &&
+          sprite->tags().version() == m_tagsVersion &&
+          sprite->totalFrames() == m_totalFrames);
+}
+
+int PlaybackSequence::stepAtTime(const int msecs) const
+{
+  if (m_frames.empty())
+    return 0;
+
+  // m_times is sorted, the step is the last one that starts before
+  // (or at) the given time.
+  auto it = std::upper_bound(m_times.begin(), m_times.end()-1, msecs);
+  return std::clamp(int(it - m_times.begin()) - 1, 0, size()-1);
+}
+
+void PlaybackSequence::build(Playback& playback)
+{
+  // Infinite playbacks cannot be flattened
+  ASSERT(playback.isStopped() ||
+         playback.mode() == Playback::PlayAll ||
+         playback.mode() == Playback::PlayOnce);
+
+  m_sprite = playback.sprite();
+  if (!m_sprite)
+    return;
+
+  m_tagsVersion = m_sprite->tags().version();
+  m_totalFrames = m_sprite->totalFrames();
+
+  frame_t frame = playback.frame();
+  do {
+    m_frames.push_back(frame);
+    m_times.push_back(m_times.back() + m_sprite->frameDuration(frame));
+    frame = playback.nextFrame();
+  } while (!playback.isStopped());
+}
+
 } // namespace doc
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2021-2022  Igara Studio S.A.
+// Copyright (C) 2021-2024  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -58,6 +58,8 @@ namespace doc {
              const Mode playMode = PlayAll,
              const Tag* tag = nullptr);
 
+    const Sprite* sprite() const { return m_sprite; }
+    Mode mode() const { return m_playMode; }
     frame_t initialFrame() const { return m_initialFrame; }
     frame_t frame() const { return m_frame; }
 
@@ -136,6 +138,60 @@ namespace doc {
     std::set<const Tag*> m_played;
   };
 
+  // Flattened play order of a Playback that stops (PlayAll or
+  // PlayOnce modes). It's calculated iterating the Playback just
+  // once, so then we can get the frame of each step, or the step
+  // that is displayed at a specific time (to seek the animation, or
+  // to know which frames will be played next), without walking the
+  // tags again. The sequence must be re-created when isValid()
+  // returns false because the tags/frames of the sprite were changed
+  // (frame durations are copied when the sequence is created).
+  class PlaybackSequence {
+  public:
+    PlaybackSequence() { }
+
+    PlaybackSequence(const Sprite* sprite,
+                     const TagsList& tagsList,
+                     const frame_t frame,
+                     const Playback::Mode playMode,
+                     const Tag* tag,
+                     const int forward = 1);
+
+    PlaybackSequence(const Sprite* sprite,
+                     const frame_t frame = 0,
+                     const Playback::Mode playMode = Playback::PlayAll,
+                     const Tag* tag = nullptr);
+
+    bool isValid(const Sprite* sprite) const;
+
+    bool empty() const { return m_frames.empty(); }
+    int size() const { return int(m_frames.size()); }
+    const std::vector<frame_t>& frames() const { return m_frames; }
+
+    // Returns the frame to display in the given step of the sequence.
+    frame_t frame(const int step) const { return m_frames[step]; }
+
+    // Returns the time (in milliseconds) when the given step starts
+    // (step=size() is the total duration of the sequence).
+    int stepTime(const int step) const { return m_times[step]; }
+    int duration() const { return m_times.back(); }
+
+    // Returns the step that is displayed at the given time
+    // (O(log n)). The time is clamped to the sequence duration.
+    int stepAtTime(const int msecs) const;
+
+  private:
+    void build(Playback& playback);
+
+    const Sprite* m_sprite = nullptr;
+    int m_tagsVersion = -1;
+    frame_t m_totalFrames = 0;
+    std::vector<frame_t> m_frames;
+    // Start time of each step (with one extra element at the end with
+    // the total duration).
+    std::vector<int> m_times = { 0 };
+  };
+
 } // namespace doc
 
 #endif
@@ -1052,6 +1052,80 @@ TEST(Playback, InnerCascades)
   EXPECT_FALSE(play.isStopped());
 }
 
+TEST(PlaybackSequence, MatchesPlayback)
+{
+  //   A      C
+  // <--->  <--->
+  //     B
+  //   <--->
+  // 0 1 2 3 4 5 6
+
+  Tag* a = make_tag("A", 0, 2, AniDir::PING_PONG, 2);
+  Tag* b = make_tag("B", 1, 3, AniDir::REVERSE, 2);
+  Tag* c = make_tag("C", 4, 6, AniDir::FORWARD, 3);
+  auto sprite = make_sprite(7, { a, b, c });
+  for (frame_t f=0; f<7; ++f)
+    sprite->setFrameDuration(f, 10*(f+1));
+
+  for (const Playback::Mode mode : { Playback::PlayAll, Playback::PlayOnce }) {
+    for (const Tag* tag : { (const Tag*)nullptr, (const Tag*)b }) {
+      Playback play(sprite.get(), 0, mode, tag);
+      PlaybackSequence seq(sprite.get(), 0, mode, tag);
+
+      std::vector<frame_t> expected;
+      std::vector<int> times;
+      int time = 0;
+      do {
+        expected.push_back(play.frame());
+        times.push_back(time);
+        time += sprite->frameDuration(play.frame());
+        play.nextFrame();
+      } while (!play.isStopped());
+
+      EXPECT_EQ(expected, seq.frames());
+      EXPECT_EQ(time, seq.duration());
+      for (int i=0; i<seq.size(); ++i) {
+        EXPECT_EQ(times[i], seq.stepTime(i));
+        EXPECT_EQ(i, seq.stepAtTime(times[i]));
+        EXPECT_EQ(i, seq.stepAtTime(times[i] + sprite->frameDuration(seq.frame(i)) - 1));
+      }
+      EXPECT_EQ(0, seq.stepAtTime(-1));
+      EXPECT_EQ(seq.size()-1, seq.stepAtTime(time + 100));
+    }
+  }
+}
+
+TEST(PlaybackSequence, InvalidatedByTagChanges)
+{
+  Tag* a = make_tag("A", 1, 2, AniDir::FORWARD, 2);
+  auto sprite = make_sprite(4, { a });
+  PlaybackSequence seq(sprite.get());
+  EXPECT_EQ(std::vector<frame_t>({ 0, 1, 2, 1, 2, 3 }), seq.frames());
+  EXPECT_TRUE(seq.isValid(sprite.get()));
+
+  a->setRepeat(3);
+  EXPECT_FALSE(seq.isValid(sprite.get()));
+  seq = PlaybackSequence(sprite.get());
+  EXPECT_EQ(std::vector<frame_t>({ 0, 1, 2, 1, 2, 1, 2, 3 }), seq.frames());
+
+  a->setAniDir(AniDir::REVERSE);
+  EXPECT_FALSE(seq.isValid(sprite.get()));
+  seq = PlaybackSequence(sprite.get());
+
+  a->setFrameRange(2, 3);
+  EXPECT_FALSE(seq.isValid(sprite.get()));
+  seq = PlaybackSequence(sprite.get());
+
+  sprite->tags().remove(a);
+  delete a;
+  EXPECT_FALSE(seq.isValid(sprite.get()));
+  seq = PlaybackSequence(sprite.get());
+  EXPECT_EQ(std::vector<frame_t>({ 0, 1, 2, 3 }), seq.frames());
+
+  sprite->setTotalFrames(5);
+  EXPECT_FALSE(seq.isValid(sprite.get()));
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
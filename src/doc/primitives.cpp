@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -12,10 +12,12 @@
 #include "doc/primitives.h"
 
 #include "doc/algo.h"
+#include "doc/algorithm/parallel_bands.h"
 #include "doc/brush.h"
 #include "doc/dispatch.h"
 #include "doc/image_impl.h"
 #include "doc/palette.h"
+#include "doc/primitives_fast.h"
 #include "doc/remap.h"
 #include "doc/rgbmap.h"
 #include "doc/tile.h"
@@ -23,7 +25,10 @@
 
 #include <city.h>
 
+#include <algorithm>
+#include <bitset>
 #include <stdexcept>
+#include <vector>
 
 #if defined(__x86_64__) || defined(_WIN64)
   #include <emmintrin.h>
@@ -99,46 +104,165 @@ Image* crop_image(const Image* image, const gfx::Rect& bounds, color_t bg, const
   return crop_image(image, bounds.x, bounds.y, bounds.w, bounds.h, bg, buffer);
 }
 
+namespace {
+
+// Size of the square tiles used to rotate 90 degrees, so the source
+// rows that are read for each tile are kept in the cache
+constexpr int kRotateTileSize = 32;
+
+#if defined(__x86_64__) || defined(_WIN64)
+
+// Transposes a 4x4 block of 32-bit pixels
+inline void transpose4x4_sse2(__m128i& r0, __m128i& r1, __m128i& r2, __m128i& r3)
+{
+  const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+  const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+  const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+  const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+  r0 = _mm_unpacklo_epi64(t0, t1);
+  r1 = _mm_unpackhi_epi64(t0, t1);
+  r2 = _mm_unpacklo_epi64(t2, t3);
+  r3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+#endif
+
+// Rotates a non-bitmap image using raw pointers. The rows of "dst"
+// are processed in parallel bands.
+template<typename ImageTraits>
+void rotate_image_templ(const Image* src, Image* dst, const int angle)
+{
+  using pixel_t = typename ImageTraits::pixel_t;
+  const int sw = src->width();
+  const int sh = src->height();
+  const int dw = dst->width();
+
+  std::vector<const pixel_t*> srcRows(sh);
+  for (int y=0; y<sh; ++y)
+    srcRows[y] = (const pixel_t*)src->getPixelAddress(0, y);
+
+  if (angle == 180) {
+    algorithm::for_each_band(sh, [&](const int y0, const int h){
+      for (int y=y0; y<y0+h; ++y) {
+        std::reverse_copy(srcRows[y], srcRows[y]+sw,
+                          (pixel_t*)dst->getPixelAddress(0, sh-y-1));
+      }
+    });
+    return;
+  }
+
+  // Returns the source pixel of dst(x, y)
+  auto srcPixel = [&srcRows, sw, sh, angle](const int x, const int y) -> pixel_t {
+    if (angle == 90)
+      return srcRows[sh-x-1][y];
+    else
+      return srcRows[x][sw-y-1];
+  };
+
+  algorithm::for_each_band(dst->height(), [&](const int y0, const int h){
+    for (int ty=y0; ty<y0+h; ty+=kRotateTileSize) {
+      const int ty2 = std::min(ty+kRotateTileSize, y0+h);
+
+      for (int tx=0; tx<dw; tx+=kRotateTileSize) {
+        const int tx2 = std::min(tx+kRotateTileSize, dw);
+        int y = ty;
+
+#if defined(__x86_64__) || defined(_WIN64)
+        if constexpr (sizeof(pixel_t) == 4) {
+          // Blocks of 4x4 pixels
+          for (; y+4<=ty2; y+=4) {
+            pixel_t* d[4];
+            for (int i=0; i<4; ++i)
+              d[i] = (pixel_t*)dst->getPixelAddress(0, y+i);
+
+            int x = tx;
+            for (; x+4<=tx2; x+=4) {
+              __m128i r[4];
+              if (angle == 90) {
+                // dst(x+j, y+i) = src(y+i, sh-x-j-1)
+                for (int j=0; j<4; ++j)
+                  r[j] = _mm_loadu_si128((const __m128i*)(srcRows[sh-x-j-1] + y));
+                transpose4x4_sse2(r[0], r[1], r[2], r[3]);
+                for (int i=0; i<4; ++i)
+                  _mm_storeu_si128((__m128i*)(d[i] + x), r[i]);
+              }
+              else {
+                // dst(x+j, y+i) = src(sw-y-i-1, x+j)
+                for (int j=0; j<4; ++j)
+                  r[j] = _mm_loadu_si128((const __m128i*)(srcRows[x+j] + sw-y-4));
+                transpose4x4_sse2(r[0], r[1], r[2], r[3]);
+                for (int i=0; i<4; ++i)
+                  _mm_storeu_si128((__m128i*)(d[i] + x), r[3-i]);
+              }
+            }
+            for (; x<tx2; ++x)
+              for (int i=0; i<4; ++i)
+                d[i][x] = srcPixel(x, y+i);
+          }
+        }
+#endif
+
+        for (; y<ty2; ++y) {
+          auto d = (pixel_t*)dst->getPixelAddress(0, y);
+          for (int x=tx; x<tx2; ++x)
+            d[x] = srcPixel(x, y);
+        }
+      }
+    }
+  });
+}
+
+template<typename ImageTraits>
+void rotate_image_with_put_pixel_fast_templ(const Image* src, Image* dst, const int angle)
+{
+  const int sw = src->width();
+  const int sh = src->height();
+  for (int y=0; y<sh; ++y) {
+    for (int x=0; x<sw; ++x) {
+      const color_t c = get_pixel_fast<ImageTraits>(src, x, y);
+      switch (angle) {
+        case 180: put_pixel_fast<ImageTraits>(dst, sw-x-1, sh-y-1, c); break;
+        case 90:  put_pixel_fast<ImageTraits>(dst, sh-y-1, x, c); break;
+        case -90: put_pixel_fast<ImageTraits>(dst, y, sw-x-1, c); break;
+      }
+    }
+  }
+}
+
+} // anonymous namespace
+
 void rotate_image(const Image* src, Image* dst, int angle)
 {
   ASSERT(src);
   ASSERT(dst);
-  int x, y;
+  ASSERT(src->pixelFormat() == dst->pixelFormat());
 
   switch (angle) {
 
     case 180:
       ASSERT(dst->width() == src->width());
       ASSERT(dst->height() == src->height());
-
-      for (y=0; y<src->height(); ++y)
-        for (x=0; x<src->width(); ++x)
-          dst->putPixel(src->width() - x - 1,
-                        src->height() - y - 1, src->getPixel(x, y));
       break;
 
     case 90:
-      ASSERT(dst->width() == src->height());
-      ASSERT(dst->height() == src->width());
-
-      for (y=0; y<src->height(); ++y)
-        for (x=0; x<src->width(); ++x)
-          dst->putPixel(src->height() - y - 1, x, src->getPixel(x, y));
-      break;
-
     case -90:
       ASSERT(dst->width() == src->height());
       ASSERT(dst->height() == src->width());
-
-      for (y=0; y<src->height(); ++y)
-        for (x=0; x<src->width(); ++x)
-          dst->putPixel(y, src->width() - x - 1, src->getPixel(x, y));
       break;
 
     // bad angle
     default:
       throw std::invalid_argument("Invalid angle specified to rotate the image");
   }
+
+  switch (src->pixelFormat()) {
+    case IMAGE_RGB:       rotate_image_templ<RgbTraits>(src, dst, angle); break;
+    case IMAGE_GRAYSCALE: rotate_image_templ<GrayscaleTraits>(src, dst, angle); break;
+    case IMAGE_INDEXED:   rotate_image_templ<IndexedTraits>(src, dst, angle); break;
+    case IMAGE_TILEMAP:   rotate_image_templ<TilemapTraits>(src, dst, angle); break;
+    // We cannot use raw pointers to iterate bits
+    case IMAGE_BITMAP:    rotate_image_with_put_pixel_fast_templ<BitmapTraits>(src, dst, angle); break;
+  }
 }
 
 void draw_hline(Image* image, int x1, int y, int x2, color_t color)
@@ -276,37 +400,31 @@ void blend_rect(Image* image, int x1, int y1, int x2, int y2, color_t color, int
   image->blendRect(x1, y1, x2, y2, color, opacity);
 }
 
-struct Data {
-  Image* image;
-  color_t color;
-};
-
-static void pixel_for_image(int x, int y, Data* data)
-{
-  put_pixel(data->image, x, y, data->color);
-}
-
-static void hline_for_image(int x1, int y, int x2, Data* data)
-{
-  draw_hline(data->image, x1, y, x2, data->color);
-}
-
 void draw_line(Image* image, int x1, int y1, int x2, int y2, color_t color)
 {
-  Data data = { image, color };
-  algo_line_continuous(x1, y1, x2, y2, &data, (AlgoPixel)pixel_for_image);
+  algo_line_continuous(
+    x1, y1, x2, y2,
+    [image, color](int x, int y){
+      put_pixel(image, x, y, color);
+    });
 }
 
 void draw_ellipse(Image* image, int x1, int y1, int x2, int y2, int extraXPxs, int extraYPxs, color_t color)
 {
-  Data data = { image, color };
-  algo_ellipse(x1, y1, x2, y2, extraXPxs, extraYPxs, &data, (AlgoPixel)pixel_for_image);
+  algo_ellipse(
+    x1, y1, x2, y2, extraXPxs, extraYPxs,
+    [image, color](int x, int y){
+      put_pixel(image, x, y, color);
+    });
 }
 
 void fill_ellipse(Image* image, int x1, int y1, int x2, int y2, int extraXPxs, int extraYPxs, color_t color)
 {
-  Data data = { image, color };
-  algo_ellipsefill(x1, y1, x2, y2, extraXPxs, extraYPxs, &data, (AlgoHLine)hline_for_image);
+  algo_ellipsefill(
+    x1, y1, x2, y2, extraXPxs, extraYPxs,
+    [image, color](int a, int y, int b){
+      draw_hline(image, a, y, b, color);
+    });
 }
 
 namespace {
@@ -430,16 +548,156 @@ bool is_same_image_simd_templ(const Image* i1, const Image* i2)
   return true;
 }
 
+// Alpha mask of the pixels of each format (pixels with alpha=0 are
+// the same color, see ImageTraits::same_color()), 0 for formats
+// without alpha.
+template<typename ImageTraits>
+constexpr typename ImageTraits::pixel_t alpha_mask()
+{
+  if constexpr (ImageTraits::pixel_format == IMAGE_RGB)
+    return rgba_a_mask;
+  else if constexpr (ImageTraits::pixel_format == IMAGE_GRAYSCALE)
+    return graya_a_mask;
+  else
+    return 0;
+}
+
+#if defined(__x86_64__) || defined(_WIN64)
+
+// Compares each pixel of the 16 bytes at "p" with "ref" using "mask"
+// ((pixel & mask) == ref) returning the _mm_movemask_epi8() result
+// (0xffff if all pixels are equal).
+template<typename ImageTraits>
+inline int cmpeq_pixels_sse2(const void* p, const __m128i mask, const __m128i ref)
+{
+  const __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i*)p), mask);
+  if constexpr (ImageTraits::bytes_per_pixel == 4)
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(v, ref));
+  else if constexpr (ImageTraits::bytes_per_pixel == 2)
+    return _mm_movemask_epi8(_mm_cmpeq_epi16(v, ref));
+  else
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, ref));
+}
+
+template<typename ImageTraits>
+inline __m128i set1_pixel_sse2(const typename ImageTraits::pixel_t c)
+{
+  if constexpr (ImageTraits::bytes_per_pixel == 4)
+    return _mm_set1_epi32(int(c));
+  else if constexpr (ImageTraits::bytes_per_pixel == 2)
+    return _mm_set1_epi16(short(c));
+  else
+    return _mm_set1_epi8(char(c));
+}
+
+#endif
+
+template<typename ImageTraits>
+bool is_plain_image_simd_templ(const Image* img, const color_t color)
+{
+  using pixel_t = typename ImageTraits::pixel_t;
+  using address_t = typename ImageTraits::const_address_t;
+  const int w = img->width();
+  const int h = img->height();
+
+  // Being "color" transparent, we just need to check that all pixels
+  // have alpha=0 too
+  pixel_t mask = pixel_t(~pixel_t(0));
+  pixel_t ref = pixel_t(color);
+  if constexpr (alpha_mask<ImageTraits>() != 0) {
+    if ((ref & alpha_mask<ImageTraits>()) == 0) {
+      mask = alpha_mask<ImageTraits>();
+      ref = 0;
+    }
+  }
+
+#if defined(__x86_64__) || defined(_WIN64)
+  constexpr int kPixelsPerBlock = 16 / ImageTraits::bytes_per_pixel;
+  const __m128i mask128 = set1_pixel_sse2<ImageTraits>(mask);
+  const __m128i ref128 = set1_pixel_sse2<ImageTraits>(ref);
+#endif
+
+  for (int y=0; y<h; ++y) {
+    auto p = (address_t)img->getPixelAddress(0, y);
+    int x = 0;
+
+#if defined(__x86_64__) || defined(_WIN64)
+    for (; x+kPixelsPerBlock<=w; x+=kPixelsPerBlock, p+=kPixelsPerBlock) {
+      if (cmpeq_pixels_sse2<ImageTraits>(p, mask128, ref128) != 0xffff)
+        return false;
+    }
+#endif
+
+    for (; x<w; ++x, ++p) {
+      if ((*p & mask) != ref)
+        return false;
+    }
+  }
+  return true;
+}
+
+template<typename ImageTraits>
+int count_diff_between_images_simd_templ(const Image* i1, const Image* i2)
+{
+  using address_t = typename ImageTraits::const_address_t;
+  const int w = i1->width();
+  const int h = i1->height();
+  int diff = 0;
+
+#if defined(__x86_64__) || defined(_WIN64)
+  constexpr int kPixelsPerBlock = 16 / ImageTraits::bytes_per_pixel;
+#endif
+
+  for (int y=0; y<h; ++y) {
+    auto p = (address_t)i1->getPixelAddress(0, y);
+    auto q = (address_t)i2->getPixelAddress(0, y);
+    int x = 0;
+
+#if defined(__x86_64__) || defined(_WIN64)
+    const __m128i ones = _mm_set1_epi8(-1);
+    for (; x+kPixelsPerBlock<=w; x+=kPixelsPerBlock, p+=kPixelsPerBlock, q+=kPixelsPerBlock) {
+      const int m = cmpeq_pixels_sse2<ImageTraits>(
+        p, ones, _mm_loadu_si128((const __m128i*)q));
+      if (m == 0xffff)
+        continue;
+
+      if constexpr (alpha_mask<ImageTraits>() == 0) {
+        // One bit per byte, i.e. one bit per pixel for 1 byte formats
+        if constexpr (ImageTraits::bytes_per_pixel == 1)
+          diff += 16 - int(std::bitset<16>(m).count());
+        else {
+          for (int i=0; i<kPixelsPerBlock; ++i)
+            if (p[i] != q[i])
+              ++diff;
+        }
+      }
+      else {
+        // Different pixels with alpha=0 are the same color
+        for (int i=0; i<kPixelsPerBlock; ++i)
+          if (!ImageTraits::same_color(p[i], q[i]))
+            ++diff;
+      }
+    }
+#endif
+
+    for (; x<w; ++x, ++p, ++q) {
+      if (!ImageTraits::same_color(*p, *q))
+        ++diff;
+    }
+  }
+  return diff;
+}
+
 } // anonymous namespace
 
 bool is_plain_image(const Image* img, color_t c)
 {
   switch (img->pixelFormat()) {
-    case IMAGE_RGB:       return is_plain_image_templ<RgbTraits>(img, c);
-    case IMAGE_GRAYSCALE: return is_plain_image_templ<GrayscaleTraits>(img, c);
-    case IMAGE_INDEXED:   return is_plain_image_templ<IndexedTraits>(img, c);
+    case IMAGE_RGB:       return is_plain_image_simd_templ<RgbTraits>(img, c);
+    case IMAGE_GRAYSCALE: return is_plain_image_simd_templ<GrayscaleTraits>(img, c);
+    case IMAGE_INDEXED:   return is_plain_image_simd_templ<IndexedTraits>(img, c);
     case IMAGE_BITMAP:    return is_plain_image_templ<BitmapTraits>(img, c);
-    case IMAGE_TILEMAP:   return is_plain_image_templ<TilemapTraits>(img, c);
+    case IMAGE_TILEMAP:   return is_plain_image_simd_templ<TilemapTraits>(img, c);
   }
   return false;
 }
@@ -460,11 +718,11 @@ int count_diff_between_images(const Image* i1, const Image* i2)
     return -1;
 
   switch (i1->pixelFormat()) {
-    case IMAGE_RGB:       return count_diff_between_images_templ<RgbTraits>(i1, i2);
-    case IMAGE_GRAYSCALE: return count_diff_between_images_templ<GrayscaleTraits>(i1, i2);
-    case IMAGE_INDEXED:   return count_diff_between_images_templ<IndexedTraits>(i1, i2);
+    case IMAGE_RGB:       return count_diff_between_images_simd_templ<RgbTraits>(i1, i2);
+    case IMAGE_GRAYSCALE: return count_diff_between_images_simd_templ<GrayscaleTraits>(i1, i2);
+    case IMAGE_INDEXED:   return count_diff_between_images_simd_templ<IndexedTraits>(i1, i2);
     case IMAGE_BITMAP:    return count_diff_between_images_templ<BitmapTraits>(i1, i2);
-    case IMAGE_TILEMAP:   return count_diff_between_images_templ<TilemapTraits>(i1, i2);
+    case IMAGE_TILEMAP:   return count_diff_between_images_simd_templ<TilemapTraits>(i1, i2);
   }
 
   ASSERT(false);
@@ -514,16 +772,24 @@ void remap_image(Image* image, const Remap& remap)
          image->pixelFormat() == IMAGE_TILEMAP);
 
   switch (image->pixelFormat()) {
-    case IMAGE_INDEXED:
-      transform_image<IndexedTraits>(
-        image, [&remap](color_t c) -> color_t {
-          auto to = remap[c];
-          if (to != Remap::kUnused)
-            return to;
-          else
-            return c;
-        });
+    case IMAGE_INDEXED: {
+      // Table with the result for each index (to avoid checking the
+      // Remap entries for each pixel)
+      uint8_t table[256];
+      for (int c=0; c<256; ++c) {
+        auto to = remap[c];
+        table[c] = uint8_t(to != Remap::kUnused ? to: c);
+      }
+
+      const int w = image->width();
+      const int h = image->height();
+      for (int y=0; y<h; ++y) {
+        auto p = (IndexedTraits::address_t)image->getPixelAddress(0, y);
+        for (int x=0; x<w; ++x, ++p)
+          *p = table[*p];
+      }
       break;
+    }
     case IMAGE_TILEMAP:
       transform_image<TilemapTraits>(
         image, [&remap](color_t c) -> color_t {
@@ -539,49 +805,106 @@ void remap_image(Image* image, const Remap& remap)
   }
 }
 
-// TODO test this hash routine and find a better alternative
-
-template <typename ImageTraits, uint32_t Mask>
-static uint32_t calculate_image_hash_templ(const Image* image,
-                                           const gfx::Rect& bounds)
+// Buffer used to pack the pixels of the rows to hash when they
+// aren't contiguous in memory (one per thread, reused between calls
+// to avoid allocating memory each time we hash an image)
+static std::vector<uint8_t>& hash_buffer(const size_t len)
 {
-#if defined(__LP64__) || defined(__x86_64__) || defined(_WIN64)
-  #define CITYHASH(buf, len) (CityHash64(buf, len) & 0xffffffff)
-  static_assert(sizeof(void*) == 8, "This CPU is not 64-bit");
-#else
-  #define CITYHASH(buf, len) CityHash32(buf, len)
-  static_assert(sizeof(void*) == 4, "This CPU is not 32-bit");
-#endif
+  static thread_local std::vector<uint8_t> buf;
+  if (buf.size() < len)
+    buf.resize(len);
+  return buf;
+}
 
-  const uint32_t widthBytes = ImageTraits::bytes_per_pixel * bounds.w;
+// The hash is calculated from the pixels inside "bounds" packed row
+// by row (without the rows padding), so it doesn't depend on the
+// image layout in memory.
+template <typename ImageTraits, typename HashFunc>
+static auto calculate_image_hash_templ(const Image* image,
+                                       const gfx::Rect& bounds,
+                                       HashFunc hashFunc)
+{
+  const uint32_t widthBytes = ImageTraits::width_bytes(bounds.w);
   const uint32_t len = widthBytes * bounds.h;
   if (bounds == image->bounds() &&
       widthBytes == image->rowBytes()) {
-    return CITYHASH((const char*)image->getPixelAddress(0, 0), len);
+    return hashFunc((const char*)image->getPixelAddress(0, 0), len);
   }
   else {
-    std::vector<uint8_t> buf(len);
-    uint8_t* dst = &buf[0];
+    std::vector<uint8_t>& buf = hash_buffer(len);
+    uint8_t* dst = buf.data();
     for (int y=0; y<bounds.h; ++y, dst+=widthBytes) {
       auto src = (const uint8_t*)image->getPixelAddress(bounds.x, bounds.y+y);
       std::copy(src, src+widthBytes, dst);
     }
-    return CITYHASH((const char*)&buf[0], buf.size());
+    return hashFunc((const char*)buf.data(), len);
   }
 }
 
-uint32_t calculate_image_hash(const Image* img, const gfx::Rect& bounds)
+// Bitmap rows are packed from their first pixel (which can be in
+// the middle of a byte), and the unused bits of the last byte of each
+// row are always zero.
+template <typename HashFunc>
+static auto calculate_bitmap_hash(const Image* image,
+                                  const gfx::Rect& bounds,
+                                  HashFunc hashFunc)
+{
+  const uint32_t widthBytes = BitmapTraits::width_bytes(bounds.w);
+  const uint32_t len = widthBytes * bounds.h;
+  std::vector<uint8_t>& buf = hash_buffer(len);
+  std::fill(buf.begin(), buf.begin()+len, 0);
+
+  uint8_t* dst = buf.data();
+  for (int y=0; y<bounds.h; ++y, dst+=widthBytes) {
+    for (int x=0; x<bounds.w; ++x) {
+      if (get_pixel_fast<BitmapTraits>(image, bounds.x+x, bounds.y+y))
+        dst[x / 8] |= (1 << (x % 8));
+    }
+  }
+  return hashFunc((const char*)buf.data(), len);
+}
+
+template <typename HashFunc>
+static auto calculate_image_hash_by_format(const Image* img,
+                                           const gfx::Rect& bounds,
+                                           HashFunc hashFunc)
+  -> decltype(hashFunc(nullptr, 0))
 {
   switch (img->pixelFormat()) {
-    case IMAGE_RGB:       return calculate_image_hash_templ<RgbTraits, rgba_rgb_mask>(img, bounds);
-    case IMAGE_GRAYSCALE: return calculate_image_hash_templ<GrayscaleTraits, graya_v_mask>(img, bounds);
-    case IMAGE_INDEXED:   return calculate_image_hash_templ<IndexedTraits, 0xff>(img, bounds);
-    case IMAGE_BITMAP:    return calculate_image_hash_templ<BitmapTraits, 1>(img, bounds);
+    case IMAGE_RGB:       return calculate_image_hash_templ<RgbTraits>(img, bounds, hashFunc);
+    case IMAGE_GRAYSCALE: return calculate_image_hash_templ<GrayscaleTraits>(img, bounds, hashFunc);
+    case IMAGE_INDEXED:   return calculate_image_hash_templ<IndexedTraits>(img, bounds, hashFunc);
+    case IMAGE_BITMAP:    return calculate_bitmap_hash(img, bounds, hashFunc);
+    case IMAGE_TILEMAP:   return calculate_image_hash_templ<TilemapTraits>(img, bounds, hashFunc);
   }
   ASSERT(false);
   return 0;
 }
 
+uint32_t calculate_image_hash(const Image* img, const gfx::Rect& bounds)
+{
+  return calculate_image_hash_by_format(
+    img, bounds,
+    [](const char* buf, const size_t len) -> uint32_t {
+#if defined(__LP64__) || defined(__x86_64__) || defined(_WIN64)
+      static_assert(sizeof(void*) == 8, "This CPU is not 64-bit");
+      return (CityHash64(buf, len) & 0xffffffff);
+#else
+      static_assert(sizeof(void*) == 4, "This CPU is not 32-bit");
+      return CityHash32(buf, len);
+#endif
+    });
+}
+
+uint64_t calculate_image_hash64(const Image* img, const gfx::Rect& bounds)
+{
+  return calculate_image_hash_by_format(
+    img, bounds,
+    [](const char* buf, const size_t len) -> uint64_t {
+      return CityHash64(buf, len);
+    });
+}
+
 void preprocess_transparent_pixels(Image* image)
 {
   switch (image->pixelFormat()) {
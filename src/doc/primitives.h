@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -53,6 +53,12 @@ namespace doc {
   uint32_t calculate_image_hash(const Image* image,
                                 const gfx::Rect& bounds);
 
+  // Like calculate_image_hash() but with a 64-bit hash, used where
+  // collisions between similar images must be very rare (e.g. to
+  // match tiles in tilesets).
+  uint64_t calculate_image_hash64(const Image* image,
+                                  const gfx::Rect& bounds);
+
   // Sets RGB values to 0 when alpha=0 (to match images with alpha=0
   // in tilesets/calculate_image_hash)
   void preprocess_transparent_pixels(Image* image);
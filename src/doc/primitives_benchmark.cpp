@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2023 Igara Studio S.A.
+// Copyright (c) 2023-2024 Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -10,8 +10,10 @@
 
 #include "doc/primitives.h"
 
+#include "doc/algo.h"
 #include "doc/algorithm/random_image.h"
 #include "doc/image_ref.h"
+#include "doc/remap.h"
 
 #include <benchmark/benchmark.h>
 
@@ -41,6 +43,97 @@ void BM_IsSameImageNew(benchmark::State& state) {
   }
 }
 
+void BM_IsPlainImage(benchmark::State& state) {
+  const auto pf = (PixelFormat)state.range(0);
+  const int w = state.range(1);
+  const int h = state.range(2);
+  ImageRef a(Image::create(pf, w, h));
+  clear_image(a.get(), 0);
+  while (state.KeepRunning()) {
+    is_empty_image(a.get());
+  }
+}
+
+void BM_CountDiffBetweenImages(benchmark::State& state) {
+  const auto pf = (PixelFormat)state.range(0);
+  const int w = state.range(1);
+  const int h = state.range(2);
+  ImageRef a(Image::create(pf, w, h));
+  doc::algorithm::random_image(a.get());
+  ImageRef b(Image::createCopy(a.get()));
+  while (state.KeepRunning()) {
+    count_diff_between_images(a.get(), b.get());
+  }
+}
+
+void BM_RemapImage(benchmark::State& state) {
+  const int w = state.range(1);
+  const int h = state.range(2);
+  ImageRef a(Image::create(IMAGE_INDEXED, w, h));
+  doc::algorithm::random_image(a.get());
+  Remap remap(256);
+  for (int i=0; i<256; ++i)
+    remap.map(i, 255-i);
+  while (state.KeepRunning()) {
+    remap_image(a.get(), remap);
+  }
+}
+
+struct PixelData {
+  Image* image;
+  color_t color;
+};
+
+static void pixel_for_image(int x, int y, void* data)
+{
+  auto d = (PixelData*)data;
+  put_pixel(d->image, x, y, d->color);
+}
+
+void BM_DrawLineAlgoPixel(benchmark::State& state) {
+  const auto pf = (PixelFormat)state.range(0);
+  const int w = state.range(1);
+  const int h = state.range(2);
+  ImageRef a(Image::create(pf, w, h));
+  PixelData data = { a.get(), 1 };
+  while (state.KeepRunning()) {
+    for (int x=0; x<w; x+=8)
+      algo_line_continuous(0, 0, x, h-1, &data, pixel_for_image);
+  }
+}
+
+void BM_DrawLine(benchmark::State& state) {
+  const auto pf = (PixelFormat)state.range(0);
+  const int w = state.range(1);
+  const int h = state.range(2);
+  ImageRef a(Image::create(pf, w, h));
+  while (state.KeepRunning()) {
+    for (int x=0; x<w; x+=8)
+      draw_line(a.get(), 0, 0, x, h-1, 1);
+  }
+}
+
+void BM_DrawEllipse(benchmark::State& state) {
+  const auto pf = (PixelFormat)state.range(0);
+  const int w = state.range(1);
+  const int h = state.range(2);
+  ImageRef a(Image::create(pf, w, h));
+  while (state.KeepRunning()) {
+    for (int x=0; x<w; x+=8)
+      draw_ellipse(a.get(), 0, 0, x, h-1, 0, 0, 1);
+  }
+}
+
+void BM_FillEllipse(benchmark::State& state) {
+  const auto pf = (PixelFormat)state.range(0);
+  const int w = state.range(1);
+  const int h = state.range(2);
+  ImageRef a(Image::create(pf, w, h));
+  while (state.KeepRunning()) {
+    fill_ellipse(a.get(), 0, 0, w-1, h-1, 0, 0, 1);
+  }
+}
+
 #define DEFARGS()                                                \
    ->Args({ IMAGE_RGB, 16, 16 })                                 \
    ->Args({ IMAGE_RGB, 1024, 1024 })                             \
@@ -60,4 +153,40 @@ BENCHMARK(BM_IsSameImageNew)
   DEFARGS()
   ->UseRealTime();
 
+BENCHMARK(BM_IsPlainImage)
+  DEFARGS()
+  ->UseRealTime();
+
+BENCHMARK(BM_CountDiffBetweenImages)
+  DEFARGS()
+  ->UseRealTime();
+
+BENCHMARK(BM_RemapImage)
+  ->Args({ IMAGE_INDEXED, 16, 16 })
+  ->Args({ IMAGE_INDEXED, 1024, 1024 })
+  ->Args({ IMAGE_INDEXED, 8192, 8192 })
+  ->UseRealTime();
+
+#define SHAPEARGS()                                              \
+   ->Args({ IMAGE_RGB, 64, 64 })                                 \
+   ->Args({ IMAGE_RGB, 1024, 1024 })                             \
+   ->Args({ IMAGE_INDEXED, 64, 64 })                             \
+   ->Args({ IMAGE_INDEXED, 1024, 1024 })
+
+BENCHMARK(BM_DrawLineAlgoPixel)
+  SHAPEARGS()
+  ->UseRealTime();
+
+BENCHMARK(BM_DrawLine)
+  SHAPEARGS()
+  ->UseRealTime();
+
+BENCHMARK(BM_DrawEllipse)
+  SHAPEARGS()
+  ->UseRealTime();
+
+BENCHMARK(BM_FillEllipse)
+  SHAPEARGS()
+  ->UseRealTime();
+
 BENCHMARK_MAIN();
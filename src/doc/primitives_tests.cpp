@@ -80,6 +80,105 @@ TYPED_TEST(Primitives, IsSameImage)
   }
 }
 
+TYPED_TEST(Primitives, ImageHashDoesntDependOnLayout)
+{
+  using ImageTraits = TypeParam;
+
+  for (int h=1; h<40; h+=7) {
+    for (int w=1; w<40; w+=3) {
+      ImageRef a(Image::create(ImageTraits::pixel_format, w+5, h+3));
+      doc::algorithm::random_image(a.get());
+
+      // Crop a region starting at a pixel that isn't byte-aligned in
+      // bitmaps, the crop has its own row stride
+      const Rect bounds(3, 2, w, h);
+      ImageRef b(crop_image(a.get(), bounds, 0));
+
+      EXPECT_EQ(calculate_image_hash64(b.get(), b->bounds()),
+                calculate_image_hash64(a.get(), bounds));
+      EXPECT_EQ(calculate_image_hash(b.get(), b->bounds()),
+                calculate_image_hash(a.get(), bounds));
+
+      ImageRef c(Image::createCopy(b.get()));
+      put_pixel_fast<ImageTraits>(
+        c.get(), w-1, h-1,
+        get_pixel_fast<ImageTraits>(c.get(), w-1, h-1) ? 0: 1);
+      EXPECT_NE(calculate_image_hash64(b.get(), b->bounds()),
+                calculate_image_hash64(c.get(), c->bounds()));
+    }
+  }
+}
+
+TYPED_TEST(Primitives, IsPlainImageAndCountDiff)
+{
+  using ImageTraits = TypeParam;
+
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<int> dist(0, 1 << 30);
+
+  for (int w=1; w<70; w+=13) {
+    const int h = 3;
+    ImageRef a(Image::create(ImageTraits::pixel_format, w, h));
+    ImageRef b(Image::create(ImageTraits::pixel_format, w, h));
+    const color_t c = ImageTraits::max_value;
+    clear_image(a.get(), c);
+    clear_image(b.get(), c);
+    EXPECT_TRUE(is_plain_image(a.get(), c));
+    EXPECT_EQ(0, count_diff_between_images(a.get(), b.get()));
+
+    // Change pixels in different positions of the SIMD blocks
+    int expected = 0;
+    for (int i=0; i<w*h; i+=1+dist(gen)%5) {
+      put_pixel_fast<ImageTraits>(b.get(), i % w, i / w, 0);
+      ++expected;
+    }
+    EXPECT_FALSE(is_plain_image(b.get(), c));
+    EXPECT_EQ(expected, count_diff_between_images(a.get(), b.get()));
+
+    // Transparent pixels with different RGB values are the same color
+    if constexpr (ImageTraits::pixel_format == IMAGE_RGB) {
+      clear_image(a.get(), rgba(0, 0, 0, 0));
+      for (int i=0; i<w*h; ++i)
+        put_pixel_fast<ImageTraits>(a.get(), i % w, i / w,
+                                    rgba(i & 255, 4, 5, 0));
+      EXPECT_TRUE(is_plain_image(a.get(), rgba(1, 2, 3, 0)));
+      EXPECT_FALSE(is_plain_image(a.get(), rgba(0, 4, 5, 0) | rgba_a_mask));
+
+      ImageRef t(Image::create(IMAGE_RGB, w, h));
+      clear_image(t.get(), rgba(9, 9, 9, 0));
+      EXPECT_EQ(0, count_diff_between_images(a.get(), t.get()));
+    }
+  }
+}
+
+TYPED_TEST(Primitives, RotateImage)
+{
+  using ImageTraits = TypeParam;
+
+  for (int h=1; h<90; h+=11) {
+    for (int w=1; w<90; w+=7) {
+      ImageRef a(Image::create(ImageTraits::pixel_format, w, h));
+      doc::algorithm::random_image(a.get());
+
+      ImageRef r180(Image::create(ImageTraits::pixel_format, w, h));
+      ImageRef r90(Image::create(ImageTraits::pixel_format, h, w));
+      ImageRef rm90(Image::create(ImageTraits::pixel_format, h, w));
+      rotate_image(a.get(), r180.get(), 180);
+      rotate_image(a.get(), r90.get(), 90);
+      rotate_image(a.get(), rm90.get(), -90);
+
+      for (int y=0; y<h; ++y) {
+        for (int x=0; x<w; ++x) {
+          const color_t c = get_pixel_fast<ImageTraits>(a.get(), x, y);
+          ASSERT_EQ(c, get_pixel_fast<ImageTraits>(r180.get(), w-x-1, h-y-1));
+          ASSERT_EQ(c, get_pixel_fast<ImageTraits>(r90.get(), h-y-1, x));
+          ASSERT_EQ(c, get_pixel_fast<ImageTraits>(rm90.get(), y, w-x-1));
+        }
+      }
+    }
+  }
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
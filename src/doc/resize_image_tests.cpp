@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2022 Igara Studio S.A.
+// Copyright (c) 2022-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -101,6 +101,66 @@ TEST(ResizeImage, BilinearInterpRGBType)
 }
 #endif
 
+TEST(ResizeImage, NearestNeighborBands)
+{
+  // Tall enough to be resized in several bands/threads
+  ImageRef src(Image::create(IMAGE_INDEXED, 3, 200));
+  for (int y=0; y<src->height(); ++y)
+    for (int x=0; x<src->width(); ++x)
+      put_pixel(src.get(), x, y, (x + y*3) & 0xff);
+
+  ImageRef dst(Image::create(IMAGE_INDEXED, 6, 400));
+  algorithm::resize_image(src.get(), dst.get(),
+                          algorithm::RESIZE_METHOD_NEAREST_NEIGHBOR,
+                          nullptr, nullptr, -1);
+
+  for (int y=0; y<dst->height(); ++y)
+    for (int x=0; x<dst->width(); ++x)
+      EXPECT_EQ(get_pixel(src.get(), x/2, y/2),
+                get_pixel(dst.get(), x, y)) << "x=" << x << " y=" << y;
+}
+
+TEST(ResizeImage, BilinearRgb)
+{
+  ImageRef src(Image::create(IMAGE_RGB, 2, 2));
+  put_pixel(src.get(), 0, 0, rgba(0, 0, 0, 255));
+  put_pixel(src.get(), 1, 0, rgba(200, 0, 0, 255));
+  put_pixel(src.get(), 0, 1, rgba(0, 100, 0, 255));
+  put_pixel(src.get(), 1, 1, rgba(200, 100, 40, 0));
+
+  ImageRef dst(Image::create(IMAGE_RGB, 3, 3));
+  algorithm::resize_image(src.get(), dst.get(),
+                          algorithm::RESIZE_METHOD_BILINEAR,
+                          nullptr, nullptr, -1);
+
+  // Corners are the same
+  EXPECT_EQ(rgba(0, 0, 0, 255), get_pixel(dst.get(), 0, 0));
+  EXPECT_EQ(rgba(200, 0, 0, 255), get_pixel(dst.get(), 2, 0));
+  EXPECT_EQ(rgba(0, 100, 0, 255), get_pixel(dst.get(), 0, 2));
+  EXPECT_EQ(rgba(200, 100, 40, 0), get_pixel(dst.get(), 2, 2));
+
+  // Middle points
+  EXPECT_EQ(rgba(100, 0, 0, 255), get_pixel(dst.get(), 1, 0));
+  EXPECT_EQ(rgba(0, 50, 0, 255), get_pixel(dst.get(), 0, 1));
+  EXPECT_EQ(rgba(100, 50, 10, 191), get_pixel(dst.get(), 1, 1));
+}
+
+TEST(ResizeImage, BilinearUniformImage)
+{
+  const color_t c = rgba(10, 20, 30, 40);
+  ImageRef src(Image::create(IMAGE_RGB, 7, 150));
+  clear_image(src.get(), c);
+
+  ImageRef dst(Image::create(IMAGE_RGB, 19, 333));
+  algorithm::resize_image(src.get(), dst.get(),
+                          algorithm::RESIZE_METHOD_BILINEAR,
+                          nullptr, nullptr, -1);
+
+  for (int y=0; y<dst->height(); ++y)
+    for (int x=0; x<dst->width(); ++x)
+      ASSERT_EQ(c, get_pixel(dst.get(), x, y)) << "x=" << x << " y=" << y;
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2020-2022 Igara Studio S.A.
+// Copyright (c) 2020-2024 Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -25,6 +25,14 @@ namespace doc {
     // Should return the best index in a palette that matches the given RGBA values.
     virtual int mapColor(const color_t rgba) const = 0;
 
+    // Maps "n" RGBA values to palette indexes. Implementations can
+    // override this to convert whole rows faster than calling
+    // mapColor() for each pixel.
+    virtual void mapColors(const color_t* src, uint8_t* dst, const int n) const {
+      for (int i=0; i<n; ++i)
+        dst[i] = mapColor(src[i]);
+    }
+
     virtual int maskIndex() const = 0;
 
     int mapColor(const int r,
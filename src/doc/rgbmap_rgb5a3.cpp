@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2020 Igara Studio S.A.
+// Copyright (c) 2020-2024 Igara Studio S.A.
 // Copyright (c) 2001-2015 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -47,6 +47,17 @@ void RgbMapRGB5A3::regenerateMap(const Palette* palette, int maskIndex)
     entry |= INVALID;
 }
 
+void RgbMapRGB5A3::mapColors(const color_t* src, uint8_t* dst, const int n) const
+{
+  for (int i=0; i<n; ++i) {
+    // Reuse the previous index for runs of the same color
+    if (i > 0 && src[i] == src[i-1])
+      dst[i] = dst[i-1];
+    else
+      dst[i] = RgbMapRGB5A3::mapColor(src[i]);
+  }
+}
+
 int RgbMapRGB5A3::generateEntry(int i, int r, int g, int b, int a) const
 {
   return m_map[i] =
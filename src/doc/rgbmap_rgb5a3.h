@@ -41,6 +41,7 @@ namespace doc {
       const uint16_t v = m_map[i];
       return (v & INVALID) ? generateEntry(i, r, g, b, a): v;
     }
+    void mapColors(const color_t* src, uint8_t* dst, const int n) const override;
 
     int maskIndex() const override { return m_maskIndex; }
 
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2020-2022 Igara Studio S.A.
+// Copyright (c) 2020-2024 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -63,11 +63,15 @@ int Slice::getMemSize() const
 void Slice::insert(const frame_t frame, const SliceKey& key)
 {
   m_keys.insert(frame, std::make_unique<SliceKey>(key));
+  if (m_owner)
+    m_owner->invalidateIndex();
 }
 
 void Slice::remove(const frame_t frame)
 {
   m_keys.remove(frame);
+  if (m_owner)
+    m_owner->invalidateIndex();
 }
 
 const SliceKey* Slice::getByFrame(const frame_t frame) const
@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -14,6 +15,7 @@
 #include "doc/slice.h"
 
 #include <algorithm>
+#include <cmath>
 
 namespace doc {
 
@@ -34,6 +36,7 @@ void Slices::add(Slice* slice)
 {
   m_slices.push_back(slice);
   slice->setOwner(this);
+  invalidateIndex();
 }
 
 void Slices::remove(Slice* slice)
@@ -44,6 +47,7 @@ void Slices::remove(Slice* slice)
     m_slices.erase(it);
 
   slice->setOwner(nullptr);
+  invalidateIndex();
 }
 
 Slice* Slices::getByName(const std::string& name) const
@@ -64,4 +68,77 @@ Slice* Slices::getById(ObjectId id) const
   return nullptr;
 }
 
+void Slices::getByBounds(const frame_t frame,
+                         const gfx::Rect& bounds,
+                         std::vector<Slice*>& output) const
+{
+  const FrameIndex& index = frameIndex(frame);
+  const gfx::Rect rc = (bounds & index.bounds);
+  if (rc.isEmpty())
+    return;
+
+  const int u1 = (rc.x - index.bounds.x) / index.cellSize.w;
+  const int v1 = (rc.y - index.bounds.y) / index.cellSize.h;
+  const int u2 = (rc.x2() - 1 - index.bounds.x) / index.cellSize.w;
+  const int v2 = (rc.y2() - 1 - index.bounds.y) / index.cellSize.h;
+
+  std::vector<int> found;
+  for (int v=v1; v<=v2; ++v)
+    for (int u=u1; u<=u2; ++u) {
+      const auto& cell = index.cells[v*index.cols + u];
+      found.insert(found.end(), cell.begin(), cell.end());
+    }
+
+  // Sort indexes to keep the order of the collection
+  std::sort(found.begin(), found.end());
+  found.erase(std::unique(found.begin(), found.end()), found.end());
+
+  for (int i : found) {
+    Slice* slice = m_slices[i];
+    const SliceKey* key = slice->getByFrame(frame);
+    if (key && key->bounds().intersects(bounds))
+      output.push_back(slice);
+  }
+}
+
+const Slices::FrameIndex& Slices::frameIndex(const frame_t frame) const
+{
+  auto it = m_index.find(frame);
+  if (it != m_index.end())
+    return it->second;
+
+  FrameIndex& index = m_index[frame];
+
+  std::vector<std::pair<int, gfx::Rect>> keys;
+  for (int i=0; i<int(m_slices.size()); ++i) {
+    const SliceKey* key = m_slices[i]->getByFrame(frame);
+    if (key && !key->bounds().isEmpty()) {
+      keys.emplace_back(i, key->bounds());
+      index.bounds |= key->bounds();
+    }
+  }
+  if (keys.empty())
+    return index;
+
+  // Around one cell per slice (limited to 64x64 cells, so big slices
+  // don't use too much memory)
+  const int n = std::clamp(int(std::ceil(std::sqrt(double(keys.size())))), 1, 64);
+  index.cellSize.w = std::max(1, (index.bounds.w + n - 1) / n);
+  index.cellSize.h = std::max(1, (index.bounds.h + n - 1) / n);
+  index.cols = (index.bounds.w + index.cellSize.w - 1) / index.cellSize.w;
+  index.rows = (index.bounds.h + index.cellSize.h - 1) / index.cellSize.h;
+  index.cells.resize(index.cols * index.rows);
+
+  for (const auto& [i, rc] : keys) {
+    const int u1 = (rc.x - index.bounds.x) / index.cellSize.w;
+    const int v1 = (rc.y - index.bounds.y) / index.cellSize.h;
+    const int u2 = (rc.x2() - 1 - index.bounds.x) / index.cellSize.w;
+    const int v2 = (rc.y2() - 1 - index.bounds.y) / index.cellSize.h;
+    for (int v=v1; v<=v2; ++v)
+      for (int u=u1; u<=u2; ++u)
+        index.cells[v*index.cols + u].push_back(i);
+  }
+  return index;
+}
+
 } // namespace doc
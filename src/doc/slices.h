@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,8 +10,11 @@
 #pragma once
 
 #include "base/disable_copying.h"
+#include "doc/frame.h"
 #include "doc/object_id.h"
+#include "gfx/rect.h"
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -37,6 +41,20 @@ namespace doc {
     Slice* getByName(const std::string& name) const;
     Slice* getById(const ObjectId id) const;
 
+    // Adds to "output" the slices with a key in the given frame that
+    // intersects the given bounds, in the same order as they are in
+    // this collection. A spatial index of each requested frame is
+    // created on demand (it's not thread-safe), so this is faster
+    // than iterating all slices when there are a lot of them (e.g.
+    // hit-testing slices in the editor).
+    void getByBounds(const frame_t frame,
+                     const gfx::Rect& bounds,
+                     std::vector<Slice*>& output) const;
+
+    // Discards the spatial index. Called when a slice is
+    // added/removed, or a key of a slice is changed.
+    void invalidateIndex() { m_index.clear(); }
+
     iterator begin() { return m_slices.begin(); }
     iterator end() { return m_slices.end(); }
     const_iterator begin() const { return m_slices.begin(); }
@@ -46,8 +64,21 @@ namespace doc {
     bool empty() const { return m_slices.empty(); }
 
   private:
+    // Uniform grid over the bounds of all slices of one frame, each
+    // cell has the indexes (in m_slices) of the slices that touch it.
+    struct FrameIndex {
+      gfx::Rect bounds;
+      gfx::Size cellSize;
+      int cols = 0;
+      int rows = 0;
+      std::vector<std::vector<int>> cells;
+    };
+
+    const FrameIndex& frameIndex(const frame_t frame) const;
+
     Sprite* m_sprite;
     List m_slices;
+    mutable std::map<frame_t, FrameIndex> m_index;
 
     DISABLE_COPYING(Slices);
   };
@@ -0,0 +1,97 @@
+// Aseprite Document Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/slice.h"
+#include "doc/slices.h"
+
+#include <cstdlib>
+#include <vector>
+
+using namespace doc;
+
+using SliceList = std::vector<Slice*>;
+
+static SliceList get_by_bounds(const Slices& slices,
+                               const frame_t frame,
+                               const gfx::Rect& bounds)
+{
+  SliceList output;
+  slices.getByBounds(frame, bounds, output);
+  return output;
+}
+
+TEST(Slices, GetByBounds)
+{
+  Slices slices(nullptr);
+  Slice* a = new Slice;
+  Slice* b = new Slice;
+  Slice* c = new Slice;
+  a->insert(0, SliceKey(gfx::Rect(0, 0, 10, 10)));
+  b->insert(0, SliceKey(gfx::Rect(5, 5, 10, 10)));
+  b->insert(2, SliceKey(gfx::Rect(100, 100, 4, 4)));
+  c->insert(1, SliceKey(gfx::Rect(-20, 0, 5, 5)));
+  slices.add(a);
+  slices.add(b);
+  slices.add(c);
+
+  EXPECT_EQ(SliceList({ a, b }), get_by_bounds(slices, 0, gfx::Rect(6, 6, 1, 1)));
+  EXPECT_EQ(SliceList({ a }), get_by_bounds(slices, 0, gfx::Rect(0, 0, 1, 1)));
+  EXPECT_EQ(SliceList({ b }), get_by_bounds(slices, 0, gfx::Rect(14, 14, 1, 1)));
+  EXPECT_EQ(SliceList(), get_by_bounds(slices, 0, gfx::Rect(15, 15, 1, 1)));
+  EXPECT_EQ(SliceList({ a, b, c }), get_by_bounds(slices, 1, gfx::Rect(-20, 0, 40, 40)));
+  EXPECT_EQ(SliceList({ a, c }), get_by_bounds(slices, 2, gfx::Rect(-20, 0, 40, 40)));
+  EXPECT_EQ(SliceList({ b }), get_by_bounds(slices, 3, gfx::Rect(101, 101, 1, 1)));
+
+  // Changing keys must update the index
+  a->insert(0, SliceKey(gfx::Rect(50, 50, 2, 2)));
+  EXPECT_EQ(SliceList({ b }), get_by_bounds(slices, 0, gfx::Rect(6, 6, 1, 1)));
+  EXPECT_EQ(SliceList({ a }), get_by_bounds(slices, 0, gfx::Rect(51, 51, 1, 1)));
+  a->remove(0);
+  EXPECT_EQ(SliceList(), get_by_bounds(slices, 0, gfx::Rect(51, 51, 1, 1)));
+
+  slices.remove(b);
+  delete b;
+  EXPECT_EQ(SliceList(), get_by_bounds(slices, 0, gfx::Rect(6, 6, 1, 1)));
+  EXPECT_EQ(SliceList({ c }), get_by_bounds(slices, 1, gfx::Rect(-20, 0, 40, 40)));
+}
+
+TEST(Slices, GetByBoundsMatchesLinearSearch)
+{
+  std::srand(1);
+
+  Slices slices(nullptr);
+  for (int i=0; i<500; ++i) {
+    Slice* slice = new Slice;
+    slice->insert(std::rand() % 3,
+                  SliceKey(gfx::Rect(std::rand() % 2000 - 500,
+                                     std::rand() % 2000 - 500,
+                                     std::rand() % (i % 10 == 0 ? 1000: 50),
+                                     std::rand() % 100)));
+    slices.add(slice);
+  }
+
+  for (int i=0; i<1000; ++i) {
+    const frame_t frame = std::rand() % 4;
+    const gfx::Rect bounds(std::rand() % 2400 - 600,
+                           std::rand() % 2400 - 600,
+                           std::rand() % (i % 2 ? 2: 300) + 1,
+                           std::rand() % 300 + 1);
+
+    SliceList expected;
+    for (Slice* slice : slices) {
+      const SliceKey* key = slice->getByFrame(frame);
+      if (key && key->bounds().intersects(bounds))
+        expected.push_back(slice);
+    }
+    EXPECT_EQ(expected, get_by_bounds(slices, frame, bounds));
+  }
+}
@@ -13,6 +13,7 @@
 
 #include "base/memory.h"
 #include "base/remove_from_container.h"
+#include "doc/algorithm/parallel_bands.h"
 #include "doc/cel.h"
 #include "doc/cels_range.h"
 #include "doc/image_impl.h"
@@ -156,9 +157,8 @@ Sprite* Sprite::MakeStdSprite(const ImageSpec& spec,
                               const int ncolors,
                               const ImageBufferPtr& imageBuf)
 {
-  // Create the main image.
+  // Create the main image (new images are already transparent)
   ImageRef image(Image::create(spec, imageBuf));
-  clear_image(image.get(), 0);
 
   auto makeLayer = [](Sprite* sprite) {
                      // Create a transparent layer.
@@ -180,7 +180,6 @@ Sprite* Sprite::MakeStdTilemapSpriteWithTileset(const ImageSpec& spec,
   ASSERT(tilemapspec.colorMode() == ColorMode::TILEMAP);
 
   ImageRef image(Image::create(tilemapspec, imageBuf));
-  clear_image(image.get(), 0);
 
   auto makeLayer = [&tileset](Sprite* sprite) {
                      // Create a tilemap layer.
@@ -337,24 +336,28 @@ bool Sprite::hasVisibleReferenceLayers() const
 //////////////////////////////////////////////////////////////////////
 // Palettes
 
+// Palettes are sorted by frame (they are only added/removed through
+// setPalette()/deletePalette()), so we can use a binary search
+static bool palette_frame_less(const Palette* pal, const frame_t frame)
+{
+  return pal->frame() < frame;
+}
+
 Palette* Sprite::palette(frame_t frame) const
 {
   ASSERT(frame >= 0);
-
-  Palette* found = NULL;
-
-  PalettesList::const_iterator end = m_palettes.end();
-  PalettesList::const_iterator it = m_palettes.begin();
-  for (; it != end; ++it) {
-    Palette* pal = *it;
-    if (frame < pal->frame())
-      break;
-
-    found = pal;
-    if (frame == pal->frame())
-      break;
-  }
-
+  ASSERT(!m_palettes.empty());
+
+  // Find the last palette with pal->frame() <= frame
+  auto it = std::upper_bound(
+    m_palettes.begin(), m_palettes.end(), frame,
+    [](const frame_t frame, const Palette* pal){
+      return frame < pal->frame();
+    });
+  if (it != m_palettes.begin())
+    --it;
+
+  Palette* found = *it;
   ASSERT(found != NULL);
   return found;
 }
@@ -373,19 +376,11 @@ void Sprite::setPalette(const Palette* pal, bool truncate)
     pal->copyColorsTo(sprite_pal);
   }
   else {
-    Palette* other;
-
-    PalettesList::iterator end = m_palettes.end();
-    PalettesList::iterator it = m_palettes.begin();
-    for (; it != end; ++it) {
-      other = *it;
-
-      if (pal->frame() == other->frame()) {
-        pal->copyColorsTo(other);
-        return;
-      }
-      else if (pal->frame() < other->frame())
-        break;
+    auto it = std::lower_bound(m_palettes.begin(), m_palettes.end(),
+                               pal->frame(), palette_frame_less);
+    if (it != m_palettes.end() && (*it)->frame() == pal->frame()) {
+      pal->copyColorsTo(*it);
+      return;
     }
 
     m_palettes.insert(it, new Palette(*pal));
@@ -409,15 +404,11 @@ void Sprite::resetPalettes()
 
 void Sprite::deletePalette(frame_t frame)
 {
-  auto it = m_palettes.begin(), end = m_palettes.end();
-  for (; it != end; ++it) {
-    Palette* pal = *it;
-
-    if (pal->frame() == frame) {
-      delete pal;                   // delete palette
-      m_palettes.erase(it);
-      break;
-    }
+  auto it = std::lower_bound(m_palettes.begin(), m_palettes.end(),
+                             frame, palette_frame_less);
+  if (it != m_palettes.end() && (*it)->frame() == frame) {
+    delete *it;                 // delete palette
+    m_palettes.erase(it);
   }
 }
 
@@ -440,34 +431,53 @@ RgbMap* Sprite::rgbMap(const frame_t frame,
                 g_rgbMapAlgorithm);
 }
 
+static RgbMap* make_rgbmap(const RgbMapAlgorithm mapAlgo)
+{
+  switch (mapAlgo) {
+    case RgbMapAlgorithm::RGB5A3: return new RgbMapRGB5A3;
+    case RgbMapAlgorithm::DEFAULT:
+    case RgbMapAlgorithm::OCTREE: return new OctreeMap;
+  }
+  ASSERT(false);
+  return nullptr;
+}
+
+static int rgbmap_mask_index(const Palette* palette,
+                             const RgbMapFor forLayer)
+{
+  if (forLayer == RgbMapFor::OpaqueLayer)
+    return -1;
+
+  const int maskIndex = palette->findMaskColor();
+  return (maskIndex == -1 ? 0: maskIndex);
+}
+
 RgbMap* Sprite::rgbMap(const frame_t frame,
                        const RgbMapFor forLayer,
                        RgbMapAlgorithm mapAlgo) const
 {
   if (!m_rgbMap || m_rgbMapAlgorithm != mapAlgo) {
     m_rgbMapAlgorithm = mapAlgo;
-    switch (m_rgbMapAlgorithm) {
-      case RgbMapAlgorithm::RGB5A3: m_rgbMap.reset(new RgbMapRGB5A3); break;
-      case RgbMapAlgorithm::DEFAULT:
-      case RgbMapAlgorithm::OCTREE: m_rgbMap.reset(new OctreeMap); break;
-      default:
-        m_rgbMap.reset(nullptr);
-        ASSERT(false);
-        return nullptr;
-    }
+    m_rgbMap.reset(make_rgbmap(m_rgbMapAlgorithm));
+    if (!m_rgbMap)
+      return nullptr;
   }
-  int maskIndex;
-  if (forLayer == RgbMapFor::OpaqueLayer)
-    maskIndex = -1;
-  else {
-    maskIndex = palette(frame)->findMaskColor();
-    if (maskIndex == -1)
-      maskIndex = 0;
-  }
-  m_rgbMap->regenerateMap(palette(frame), maskIndex);
+  m_rgbMap->regenerateMap(palette(frame),
+                          rgbmap_mask_index(palette(frame), forLayer));
   return m_rgbMap.get();
 }
 
+std::unique_ptr<RgbMap> Sprite::createRgbMap(const frame_t frame,
+                                             const RgbMapFor forLayer,
+                                             const RgbMapAlgorithm mapAlgo) const
+{
+  std::unique_ptr<RgbMap> rgbmap(make_rgbmap(mapAlgo));
+  if (rgbmap)
+    rgbmap->regenerateMap(palette(frame),
+                          rgbmap_mask_index(palette(frame), forLayer));
+  return rgbmap;
+}
+
 //////////////////////////////////////////////////////////////////////
 // Frames
 
@@ -492,6 +502,18 @@ void Sprite::removeFrame(frame_t frame)
   setTotalFrames(newTotal);
 }
 
+void Sprite::permuteFrames(const std::vector<frame_t>& newFrames)
+{
+  ASSERT(frame_t(newFrames.size()) <= m_frames);
+
+  std::vector<int> frlens(m_frlens);
+  for (frame_t i=0; i<frame_t(newFrames.size()); ++i)
+    frlens[newFrames[i]] = m_frlens[i];
+  m_frlens.swap(frlens);
+
+  root()->permuteFrames(newFrames);
+}
+
 void Sprite::setTotalFrames(frame_t frames)
 {
   frames = std::max(frame_t(1), frames);
@@ -503,6 +525,7 @@ void Sprite::setTotalFrames(frame_t frames)
   }
 
   m_frames = frames;
+  incrementStructureVersion();
 }
 
 int Sprite::frameDuration(frame_t frame) const
@@ -653,19 +676,47 @@ void Sprite::remapImages(const Remap& remap)
 
   std::vector<ImageRef> images;
   getImages(images);
-  for (ImageRef& image : images)
-    remap_image(image.get(), remap);
+
+  // The same image cannot be remapped twice (e.g. tiles that share
+  // the same image)
+  std::sort(images.begin(), images.end());
+  images.erase(std::unique(images.begin(), images.end()), images.end());
+
+  algorithm::for_each_index(
+    int(images.size()),
+    [&images, &remap](const int i){
+      remap_image(images[i].get(), remap);
+    });
+
+  // Tile images were modified in place, so their cached hashes must
+  // be re-calculated.
+  if (hasTilesets()) {
+    for (Tileset* tileset : *tilesets()) {
+      if (!tileset)
+        continue;
+
+      for (tile_index i=0; i<tileset->size(); ++i)
+        tileset->notifyTileContentChange(i);
+    }
+  }
 }
 
 void Sprite::remapTilemaps(const Tileset* tileset,
                            const Remap& remap)
 {
+  std::vector<Image*> images;
   for (Cel* cel : uniqueCels()) {
     if (cel->layer()->isTilemap() &&
         static_cast<LayerTilemap*>(cel->layer())->tileset() == tileset) {
-      remap_image(cel->image(), remap);
+      images.push_back(cel->image());
     }
   }
+
+  algorithm::for_each_index(
+    int(images.size()),
+    [&images, &remap](const int i){
+      remap_image(images[i], remap);
+    });
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -799,9 +850,7 @@ CelsRange Sprite::cels(const SelectedFrames& selFrames) const
 
 CelsRange Sprite::uniqueCels() const
 {
-  SelectedFrames selFrames;
-  selFrames.insert(0, lastFrame());
-  return CelsRange(this, selFrames, CelsRange::UNIQUE);
+  return CelsRange(uniqueCelList());
 }
 
 CelsRange Sprite::uniqueCels(const SelectedFrames& selFrames) const
@@ -809,6 +858,25 @@ CelsRange Sprite::uniqueCels(const SelectedFrames& selFrames) const
   return CelsRange(this, selFrames, CelsRange::UNIQUE);
 }
 
+std::shared_ptr<const CelList> Sprite::uniqueCelList() const
+{
+  // This can be called from several threads at the same time (with
+  // the document locked for reading)
+  const std::lock_guard lock(m_uniqueCelsMutex);
+  if (!m_uniqueCels || m_uniqueCelsVersion != m_structureVersion) {
+    SelectedFrames selFrames;
+    selFrames.insert(0, lastFrame());
+
+    auto cels = std::make_shared<CelList>();
+    for (Cel* cel : uniqueCels(selFrames))
+      cels->push_back(cel);
+
+    m_uniqueCels = std::move(cels);
+    m_uniqueCelsVersion = m_structureVersion;
+  }
+  return m_uniqueCels;
+}
+
 ////////////////////////////////////////
 // Tilesets
 
@@ -28,7 +28,9 @@
 #include "doc/with_user_data.h"
 #include "gfx/rect.h"
 
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -162,6 +164,13 @@ namespace doc {
                    const RgbMapFor forLayer,
                    RgbMapAlgorithm mapAlgo) const;
 
+    // Creates a new RgbMap for the palette of the given frame that is
+    // not shared with the sprite. RgbMaps are filled lazily so a
+    // thread must use its own RgbMap to map colors.
+    std::unique_ptr<RgbMap> createRgbMap(const frame_t frame,
+                                         const RgbMapFor forLayer,
+                                         const RgbMapAlgorithm mapAlgo) const;
+
     ////////////////////////////////////////
     // Frames
 
@@ -172,6 +181,10 @@ namespace doc {
     void removeFrame(frame_t frame);
     void setTotalFrames(frame_t frames);
 
+    // Reorders frames (cels of all layers and frame durations) moving
+    // each frame "f" to "newFrames[f]" (see Layer::permuteFrames()).
+    void permuteFrames(const std::vector<frame_t>& newFrames);
+
     int frameDuration(frame_t frame) const;
     int totalAnimationDuration() const;
     void setFrameDuration(frame_t frame, int msecs);
@@ -227,6 +240,19 @@ namespace doc {
     CelsRange uniqueCels() const;
     CelsRange uniqueCels(const SelectedFrames& selFrames) const;
 
+    // Returns the same cels as uniqueCels() in a vector (e.g. to
+    // process them in parallel). The list is cached until the
+    // structure of the sprite changes.
+    std::shared_ptr<const CelList> uniqueCelList() const;
+
+    // Incremented each time a cel/layer is added/removed/moved, a cel
+    // is linked/unlinked, the number of frames changes, a layer is
+    // shown/hidden, or the z-index of a cel changes (it's used to
+    // know when the cached list of unique cels and the cached render
+    // plans are outdated).
+    uint32_t structureVersion() const { return m_structureVersion; }
+    void incrementStructureVersion() { ++m_structureVersion; }
+
     ////////////////////////////////////////
     // Tilesets
 
@@ -265,6 +291,13 @@ namespace doc {
     // Tilesets
     mutable Tilesets* m_tilesets;
 
+    // Cached list of unique cels (calculated from uniqueCelList()
+    // when m_uniqueCelsVersion != m_structureVersion)
+    uint32_t m_structureVersion = 0;
+    mutable std::mutex m_uniqueCelsMutex;
+    mutable std::shared_ptr<const CelList> m_uniqueCels;
+    mutable uint32_t m_uniqueCelsVersion = 0;
+
     // Custom tile management plugin. This can be an ID that specifies
     // a custom plugin that will be used to handle tilesets and
     // tilemaps for this specific sprite. This property is saved
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2022 Igara Studio S.A.
+// Copyright (c) 2018-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -14,6 +14,7 @@
 #include "doc/cel.h"
 #include "doc/cels_range.h"
 #include "doc/layer.h"
+#include "doc/palette.h"
 #include "doc/pixel_format.h"
 #include "doc/sprite.h"
 
@@ -193,6 +194,180 @@ TEST(Sprite, CelsRange)
   EXPECT_EQ(3, i);
 }
 
+TEST(Sprite, LayerCelByFrame)
+{
+  std::shared_ptr<Sprite> sprPtr(std::make_shared<Sprite>(
+                                   ImageSpec(ColorMode::RGB, 4, 4), 256));
+  Sprite* spr = sprPtr.get();
+  spr->setTotalFrames(10000);
+
+  LayerImage* lay = new LayerImage(spr);
+  spr->root()->addLayer(lay);
+
+  // Checks that cel() returns the same cels as the binary search
+  auto check = [lay](){
+    for (frame_t f=-1; f<10001; ++f) {
+      auto it = lay->findCelIterator(f);
+      Cel* expected = (it != lay->getCelEnd() ? *it: nullptr);
+      ASSERT_EQ(expected, lay->cel(f)) << "frame=" << f;
+    }
+  };
+
+  ImageRef img(Image::create(IMAGE_RGB, 4, 4));
+  Cel* first = new Cel(frame_t(0), img);
+  lay->addCel(first);
+  for (frame_t f=2; f<100; f+=3)
+    lay->addCel(Cel::MakeLink(f, first));
+  check();
+
+  // Sparse cels
+  Cel* last = Cel::MakeLink(frame_t(9000), first);
+  lay->addCel(last);
+  check();
+  EXPECT_EQ(last, lay->cel(9000));
+
+  // Dense again
+  lay->moveCel(last, 101);
+  check();
+  EXPECT_EQ(last, lay->cel(101));
+  EXPECT_EQ(nullptr, lay->cel(9000));
+
+  lay->removeCel(last);
+  delete last;
+  check();
+  EXPECT_EQ(nullptr, lay->cel(101));
+}
+
+TEST(Sprite, PermuteFrames)
+{
+  std::shared_ptr<Sprite> sprPtr(std::make_shared<Sprite>(
+                                   ImageSpec(ColorMode::RGB, 4, 4), 256));
+  Sprite* spr = sprPtr.get();
+  spr->setTotalFrames(5);
+  for (frame_t f=0; f<5; ++f)
+    spr->setFrameDuration(f, 100+f);
+
+  LayerImage* lay = new LayerImage(spr);
+  spr->root()->addLayer(lay);
+
+  ImageRef img(Image::create(IMAGE_RGB, 4, 4));
+  Cel* cel0 = new Cel(frame_t(0), img);
+  Cel* cel1 = Cel::MakeLink(frame_t(1), cel0);
+  Cel* cel3 = new Cel(frame_t(3), ImageRef(Image::create(IMAGE_RGB, 4, 4)));
+  lay->addCel(cel0);
+  lay->addCel(cel1);
+  lay->addCel(cel3);
+
+  // Reverse all frames
+  spr->permuteFrames({ 4, 3, 2, 1, 0 });
+  EXPECT_EQ(cel0, lay->cel(4));
+  EXPECT_EQ(cel1, lay->cel(3));
+  EXPECT_EQ(nullptr, lay->cel(2));
+  EXPECT_EQ(cel3, lay->cel(1));
+  EXPECT_EQ(nullptr, lay->cel(0));
+  EXPECT_EQ(104, spr->frameDuration(0));
+  EXPECT_EQ(100, spr->frameDuration(4));
+  EXPECT_EQ(cel3, *lay->getCelBegin());
+  EXPECT_EQ(cel0, lay->getLastCel());
+
+  // Rotate the first three frames (other frames aren't moved)
+  spr->permuteFrames({ 1, 2, 0 });
+  EXPECT_EQ(cel3, lay->cel(2));
+  EXPECT_EQ(nullptr, lay->cel(1));
+  EXPECT_EQ(cel1, lay->cel(3));
+  EXPECT_EQ(cel0, lay->cel(4));
+  EXPECT_EQ(102, spr->frameDuration(0));
+  EXPECT_EQ(104, spr->frameDuration(1));
+  EXPECT_EQ(103, spr->frameDuration(2));
+}
+
+TEST(Sprite, PaletteByFrame)
+{
+  Sprite spr(ImageSpec(ColorMode::INDEXED, 4, 4), 256);
+  spr.setTotalFrames(100);
+
+  // Add palettes in any order (they must be kept sorted by frame)
+  for (frame_t f : { 50, 10, 90, 30 }) {
+    Palette pal(f, 256);
+    pal.setEntry(0, rgba(f, 0, 0, 255));
+    spr.setPalette(&pal, true);
+  }
+  ASSERT_EQ(5, int(spr.getPalettes().size()));
+
+  auto expectedFrame = [](const frame_t f) -> frame_t {
+    return (f >= 90 ? 90: f >= 50 ? 50: f >= 30 ? 30: f >= 10 ? 10: 0);
+  };
+  for (frame_t f=0; f<100; ++f)
+    EXPECT_EQ(expectedFrame(f), spr.palette(f)->frame()) << "frame=" << f;
+
+  // Replace an existing palette
+  Palette pal(30, 256);
+  pal.setEntry(0, rgba(1, 2, 3, 255));
+  spr.setPalette(&pal, true);
+  EXPECT_EQ(5, int(spr.getPalettes().size()));
+  EXPECT_EQ(rgba(1, 2, 3, 255), spr.palette(45)->getEntry(0));
+
+  spr.deletePalette(50);
+  spr.deletePalette(51);        // Doesn't exist
+  EXPECT_EQ(4, int(spr.getPalettes().size()));
+  EXPECT_EQ(30, spr.palette(60)->frame());
+  EXPECT_EQ(90, spr.palette(99)->frame());
+}
+
+TEST(Sprite, UniqueCelsCache)
+{
+  std::shared_ptr<Sprite> sprPtr(std::make_shared<Sprite>(
+                                   ImageSpec(ColorMode::RGB, 4, 4), 256));
+  Sprite* spr = sprPtr.get();
+  spr->setTotalFrames(3);
+
+  LayerImage* lay1 = new LayerImage(spr);
+  spr->root()->addLayer(lay1);
+
+  ImageRef imgA(Image::create(IMAGE_RGB, 4, 4));
+  Cel* celA = new Cel(frame_t(0), imgA);
+  Cel* celB = Cel::MakeLink(frame_t(1), celA);
+  lay1->addCel(celA);
+  lay1->addCel(celB);
+
+  auto cels = spr->uniqueCelList();
+  EXPECT_EQ(CelList({ celA }), *cels);
+  EXPECT_EQ(cels, spr->uniqueCelList()); // Cached
+  EXPECT_EQ(1, spr->uniqueCels().size());
+
+  // Unlink
+  celB->setDataRef(std::make_shared<CelData>(*celA->data()));
+  EXPECT_EQ(CelList({ celA, celB }), *spr->uniqueCelList());
+
+  // New layer
+  LayerImage* lay2 = new LayerImage(spr);
+  spr->root()->insertLayer(lay2, nullptr);
+  Cel* celC = new Cel(frame_t(2), ImageRef(Image::create(IMAGE_RGB, 4, 4)));
+  lay2->addCel(celC);
+  EXPECT_EQ(CelList({ celC, celA, celB }), *spr->uniqueCelList());
+
+  // Move/remove cels
+  lay1->moveCel(celA, 2);
+  EXPECT_EQ(CelList({ celC, celB, celA }), *spr->uniqueCelList());
+  lay1->removeCel(celB);
+  delete celB;
+  EXPECT_EQ(CelList({ celC, celA }), *spr->uniqueCelList());
+
+  // Less frames
+  spr->setTotalFrames(2);
+  EXPECT_EQ(CelList(), *spr->uniqueCelList());
+
+  // The old list is still valid
+  EXPECT_EQ(CelList({ celA }), *cels);
+
+  int i = 0;
+  for (Cel* cel : spr->uniqueCels()) {
+    (void)cel;
+    ++i;
+  }
+  EXPECT_EQ(0, i);
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
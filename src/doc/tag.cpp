@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -89,11 +89,15 @@ void Tag::setAniDir(AniDir aniDir)
          m_aniDir == AniDir::PING_PONG_REVERSE);
 
   m_aniDir = aniDir;
+  if (m_owner)
+    m_owner->incrementVersion();
 }
 
 void Tag::setRepeat(int repeat)
 {
   m_repeat = std::clamp(repeat, 0, kMaxRepeat);
+  if (m_owner)
+    m_owner->incrementVersion();
 }
 
 } // namespace doc
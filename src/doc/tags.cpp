@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -42,6 +42,7 @@ void Tags::add(Tag* tag)
   }
   m_tags.insert(it, tag);
   tag->setOwner(this);
+  ++m_version;
 }
 
 void Tags::remove(Tag* tag)
@@ -52,6 +53,7 @@ void Tags::remove(Tag* tag)
     m_tags.erase(it);
 
   tag->setOwner(nullptr);
+  ++m_version;
 }
 
 Tag* Tags::getByName(const std::string& name) const
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -52,9 +52,16 @@ namespace doc {
 
     const TagsList& getInternalList() const { return m_tags; }
 
+    // Incremented each time a tag is added/removed, or the frame
+    // range, direction, or repeat count of a tag is changed (i.e.
+    // when the play order of the frames could change).
+    int version() const { return m_version; }
+    void incrementVersion() { ++m_version; }
+
   private:
     Sprite* m_sprite;
     TagsList m_tags;
+    int m_version = 0;
 
     DISABLE_COPYING(Tags);
   };
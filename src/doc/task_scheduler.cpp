@@ -0,0 +1,170 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/task_scheduler.h"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace doc {
+
+class TaskScheduler {
+public:
+  static TaskScheduler& instance() {
+    static TaskScheduler scheduler;
+    return scheduler;
+  }
+
+  int threads() const {
+    return int(m_workers.size());
+  }
+
+  void add(TaskGroup* group, std::function<void()>&& func) {
+    {
+      const std::lock_guard lock(m_mutex);
+      ++group->m_pending;
+      m_queues[int(group->m_priority)].push_back(Item{ std::move(func), group });
+    }
+    m_cv.notify_one();
+  }
+
+  void wait(TaskGroup* group) {
+    std::unique_lock lock(m_mutex);
+    while (group->m_pending > 0) {
+      // Execute other tasks while we wait. Only tasks with the same
+      // (or higher) priority are executed so a high priority group
+      // doesn't wait a long batch task. We wait the condition
+      // variable only when there are no queued tasks, i.e. when all
+      // the tasks of this group are running in other threads.
+      Item item;
+      if (pop(item, group->m_priority))
+        execute(lock, item);
+      else
+        group->m_cv.wait(lock);
+    }
+  }
+
+private:
+  struct Item {
+    std::function<void()> func;
+    TaskGroup* group = nullptr;
+  };
+
+  TaskScheduler() {
+    const int n = int(std::max(1u, std::thread::hardware_concurrency()));
+    for (int i=0; i<n; ++i)
+      m_workers.emplace_back([this]{ workerLoop(); });
+  }
+
+  ~TaskScheduler() {
+    {
+      const std::lock_guard lock(m_mutex);
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& worker : m_workers)
+      worker.join();
+  }
+
+  void workerLoop() {
+    std::unique_lock lock(m_mutex);
+    while (true) {
+      Item item;
+      if (pop(item, TaskPriority::Normal))
+        execute(lock, item);
+      else if (m_stop)
+        break;
+      else
+        m_cv.wait(lock);
+    }
+  }
+
+  // Gets the next task with the given priority or a higher one.
+  bool pop(Item& item, const TaskPriority lowest) {
+    for (int p=0; p<=int(lowest); ++p) {
+      auto& queue = m_queues[p];
+      if (!queue.empty()) {
+        item = std::move(queue.front());
+        queue.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Executes the task with the mutex unlocked.
+  void execute(std::unique_lock<std::mutex>& lock, Item& item) {
+    TaskGroup* group = item.group;
+    std::exception_ptr error;
+
+    lock.unlock();
+    if (!group->canceled()) {
+      try {
+        item.func();
+      }
+      catch (...) {
+        error = std::current_exception();
+      }
+    }
+    // Destroy the captured values before the group is notified
+    item.func = nullptr;
+    lock.lock();
+
+    if (error && !group->m_error)
+      group->m_error = error;
+
+    // The group can be destroyed after this notification
+    if (--group->m_pending == 0)
+      group->m_cv.notify_all();
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<Item> m_queues[2];  // One queue for each TaskPriority
+  std::vector<std::thread> m_workers;
+  bool m_stop = false;
+};
+
+TaskGroup::TaskGroup(const TaskPriority priority)
+  : m_priority(priority)
+  , m_canceled(false)
+  , m_pending(0)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+  TaskScheduler::instance().wait(this);
+}
+
+void TaskGroup::run(std::function<void()>&& func)
+{
+  TaskScheduler::instance().add(this, std::move(func));
+}
+
+void TaskGroup::wait()
+{
+  TaskScheduler::instance().wait(this);
+
+  std::exception_ptr error;
+  std::swap(error, m_error);
+  if (error)
+    std::rethrow_exception(error);
+}
+
+int task_scheduler_threads()
+{
+  return TaskScheduler::instance().threads();
+}
+
+} // namespace doc
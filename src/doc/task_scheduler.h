@@ -0,0 +1,79 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_TASK_SCHEDULER_H_INCLUDED
+#define DOC_TASK_SCHEDULER_H_INCLUDED
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+
+namespace doc {
+
+  // All the parallel work (rendering, doc algorithms, quantization,
+  // file encoding/decoding, export, etc.) is executed by one
+  // process-wide set of worker threads (one per core), so running
+  // several of these processes at the same time doesn't create more
+  // threads than cores.
+  //
+  // Tasks are added to a TaskGroup to wait for them. The thread that
+  // waits a group executes pending tasks in the meantime, so a task
+  // can create and wait its own TaskGroup (e.g. an export task that
+  // renders a sprite in bands) without blocking the workers.
+
+  enum class TaskPriority {
+    // Work that the user is waiting in the UI (e.g. rendering the
+    // editor or a filter preview). These tasks are executed first.
+    High,
+    // Batch work (e.g. exporting or saving files).
+    Normal,
+  };
+
+  class TaskGroup {
+  public:
+    explicit TaskGroup(TaskPriority priority = TaskPriority::Normal);
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    // Waits the pending tasks (exceptions are ignored, call wait()
+    // to get them).
+    ~TaskGroup();
+
+    TaskPriority priority() const { return m_priority; }
+
+    // Adds a new task to the scheduler. It can be called from any
+    // thread (including other tasks).
+    void run(std::function<void()>&& func);
+
+    // Waits all tasks added with run(). Re-throws the first exception
+    // thrown by a task of this group.
+    void wait();
+
+    // Tasks of a canceled group that are not running yet will not be
+    // executed. Running tasks can check canceled() to stop their work.
+    void cancel() { m_canceled = true; }
+    bool canceled() const { return m_canceled; }
+
+  private:
+    friend class TaskScheduler;
+
+    TaskPriority m_priority;
+    std::atomic<bool> m_canceled;
+
+    // These fields are protected by the scheduler mutex
+    int m_pending;
+    std::exception_ptr m_error;
+    std::condition_variable m_cv;
+  };
+
+  // Returns the number of worker threads of the scheduler.
+  int task_scheduler_threads();
+
+} // namespace doc
+
+#endif
@@ -0,0 +1,71 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/task_scheduler.h"
+
+#include <atomic>
+#include <stdexcept>
+
+using namespace doc;
+
+TEST(TaskScheduler, RunAllTasks)
+{
+  std::atomic<int> count(0);
+  TaskGroup group;
+  for (int i=0; i<1000; ++i)
+    group.run([&count]{ ++count; });
+  group.wait();
+  EXPECT_EQ(1000, count);
+}
+
+TEST(TaskScheduler, NestedGroups)
+{
+  // More nested groups than worker threads must not block the
+  // scheduler (each wait() executes pending tasks).
+  const int n = 4*task_scheduler_threads();
+  std::atomic<int> count(0);
+  TaskGroup group(TaskPriority::Normal);
+  for (int i=0; i<n; ++i) {
+    group.run([&count, n]{
+      TaskGroup inner(TaskPriority::High);
+      for (int j=0; j<n; ++j)
+        inner.run([&count]{ ++count; });
+      inner.wait();
+    });
+  }
+  group.wait();
+  EXPECT_EQ(n*n, count);
+}
+
+TEST(TaskScheduler, Exceptions)
+{
+  TaskGroup group;
+  group.run([]{ throw std::runtime_error("error"); });
+  group.run([]{ });
+  EXPECT_THROW(group.wait(), std::runtime_error);
+
+  // The error is reported only once
+  group.run([]{ });
+  EXPECT_NO_THROW(group.wait());
+}
+
+TEST(TaskScheduler, Cancel)
+{
+  std::atomic<int> count(0);
+  TaskGroup group;
+  group.cancel();
+  for (int i=0; i<100; ++i)
+    group.run([&count]{ ++count; });
+  group.wait();
+  EXPECT_EQ(0, count);
+  EXPECT_TRUE(group.canceled());
+}
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2023  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -14,6 +14,7 @@
 #include "doc/layer.h"
 #include "doc/layer_tilemap.h"
 #include "base/mem_utils.h"
+#include "doc/algorithm/flip_image.h"
 #include "doc/primitives.h"
 #include "doc/remap.h"
 #include "doc/sprite.h"
@@ -24,6 +25,43 @@
 
 namespace doc {
 
+static_assert(tile_f_mask == (7u << 29), "Unexpected tile flags");
+
+// Order used to match flipped versions of a tile, indexed by the
+// flip variant (so a tile without flips is preferred, then X flip,
+// Y flip, X+Y flip, D flip, etc.)
+static const int kFlipVariantOrder[8] = { 0, 4, 2, 7, 1, 5, 3, 6 };
+
+static int flip_variant(const tile_flags tf)
+{
+  return int((tf & tile_f_mask) >> 29);
+}
+
+static tile_flags flip_variant_flags(const int variant)
+{
+  return (tile_flags(variant) << 29);
+}
+
+static uint64_t tile_image_hash(const ImageRef& image)
+{
+  return calculate_image_hash64(image.get(), image->bounds());
+}
+
+// Returns a copy of the image flipped in the same way that a tile
+// with "tf" flags is displayed in a tilemap.
+static ImageRef make_flipped_image(const ImageRef& image,
+                                   const tile_flags tf)
+{
+  ImageRef copy(Image::createCopy(image.get()));
+  if (tf & tile_f_dflip)
+    algorithm::flip_image(copy.get(), copy->bounds(), algorithm::FlipDiagonal);
+  if (tf & tile_f_yflip)
+    algorithm::flip_image(copy.get(), copy->bounds(), algorithm::FlipVertical);
+  if (tf & tile_f_xflip)
+    algorithm::flip_image(copy.get(), copy->bounds(), algorithm::FlipHorizontal);
+  return copy;
+}
+
 // static
 UserData Tileset::kNoUserData;
 
@@ -44,10 +82,16 @@ Tileset::Tileset(Sprite* sprite,
   //      clipboard
   //ASSERT(sprite);
 
+  // All empty tiles have the same pixels, so we can calculate the
+  // hash just one time.
+  uint64_t emptyHash = 0;
   for (tile_index ti=0; ti<ntiles; ++ti) {
     ImageRef tile = makeEmptyTile();
+    if (ti == 0)
+      emptyHash = tile_image_hash(tile);
     m_tiles[ti].image = tile;
-    hashImage(ti, tile);
+    m_tiles[ti].setHash(emptyHash);
+    hashTile(ti);
   }
 }
 
@@ -100,7 +144,8 @@ void Tileset::discardCompressedData()
   }
 }
 
-void Tileset::setCompressedData(const base::buffer& buffer) const
+void Tileset::setCompressedData(const base::buffer& buffer,
+                                const int level) const
 {
   if (!buffer.empty()) {
     TS_TRACE("TS: [%d] setCompressedData (%s)\n", id(),
@@ -108,6 +153,7 @@ void Tileset::setCompressedData(const base::buffer& buffer) const
 
     m_compressedData = buffer;
     m_compressedDataVersion = version();
+    m_compressedDataLevel = level;
   }
 }
 
@@ -125,8 +171,18 @@ void Tileset::resize(const tile_index ntiles)
 {
   int oldSize = m_tiles.size();
   m_tiles.resize(ntiles);
-  for (tile_index ti=oldSize; ti<ntiles; ++ti)
+
+  uint64_t emptyHash = 0;
+  for (tile_index ti=oldSize; ti<ntiles; ++ti) {
     m_tiles[ti].image = makeEmptyTile();
+    if (ti == oldSize)
+      emptyHash = tile_image_hash(m_tiles[ti].image);
+    m_tiles[ti].setHash(emptyHash);
+  }
+
+  // The hash table will be re-created from the cached hashes when
+  // it's needed (without reading pixels).
+  m_hash.clear();
 }
 
 void Tileset::remap(const Remap& remap)
@@ -152,6 +208,17 @@ void Tileset::remap(const Remap& remap)
   rehash();
 }
 
+void Tileset::setMatchFlags(const tile_flags tf)
+{
+  if (m_matchFlags != tf) {
+    m_matchFlags = tf;
+
+    // The hash table contains the flipped variants of each tile
+    // depending on the match flags.
+    m_hash.clear();
+  }
+}
+
 void Tileset::setTileData(const tile_index ti,
                           const UserData& userData)
 {
@@ -172,13 +239,15 @@ void Tileset::set(const tile_index ti,
   }
 #endif
 
-  removeFromHash(ti, false);
+  if (!m_hash.empty())
+    removeFromHash(ti);
 
   preprocess_transparent_pixels(image.get());
   m_tiles[ti].image = image;
+  m_tiles[ti].setHash(tile_image_hash(image));
 
   if (!m_hash.empty())
-    hashImage(ti, image);
+    hashTile(ti);
 }
 
 tile_index Tileset::add(const ImageRef& image,
@@ -189,11 +258,11 @@ tile_index Tileset::add(const ImageRef& image,
   ASSERT(image->height() == m_grid.tileSize().h);
 
   preprocess_transparent_pixels(image.get());
-  m_tiles.push_back(Tile(image, userData));
+  m_tiles.push_back(Tile(image, userData, tile_image_hash(image)));
 
   const tile_index newIndex = tile_index(m_tiles.size()-1);
   if (!m_hash.empty())
-    hashImage(newIndex, image);
+    hashTile(newIndex);
   return newIndex;
 }
 
@@ -213,24 +282,18 @@ void Tileset::insert(const tile_index ti,
 
   ASSERT(ti >= 0 && ti <= m_tiles.size()+1);
   preprocess_transparent_pixels(image.get());
-  m_tiles.insert(m_tiles.begin()+ti, Tile(image, userData));
-
-  if (!m_hash.empty()) {
-    // Fix all indexes in the hash that are greater than "ti"
-    for (auto& it : m_hash)
-      if (it.second >= ti)
-        ++it.second;
+  m_tiles.insert(m_tiles.begin()+ti,
+                 Tile(image, userData, tile_image_hash(image)));
 
-    // And now we can add the new image with the "ti" index
-    hashImage(ti, image);
-  }
+  // All indexes after "ti" were moved, instead of fixing each entry
+  // of the hash table, it will be re-created from the cached hashes
+  // when it's needed.
+  m_hash.clear();
 }
 
 void Tileset::erase(const tile_index ti)
 {
   ASSERT(ti >= 0 && ti < size());
-  // TODO check why this doesn't work
-  //removeFromHash(ti, true);
 
   m_tiles.erase(m_tiles.begin()+ti);
   rehash();
@@ -253,67 +316,80 @@ void Tileset::setExternal(const std::string& filename,
 bool Tileset::findTileIndex(const ImageRef& tileImage,
                             tile_index& ti)
 {
+  tile_flags tf;
+  return findTileIndex(tileImage, 0, ti, tf);
+}
+
+bool Tileset::findTileIndex(const ImageRef& tileImage,
+                            tile_index& ti,
+                            tile_flags& tf)
+{
+  return findTileIndex(tileImage, m_matchFlags, ti, tf);
+}
+
+bool Tileset::findTileIndex(const ImageRef& tileImage,
+                            const tile_flags matchFlags,
+                            tile_index& ti,
+                            tile_flags& tf)
+{
+  ti = notile;
+  tf = 0;
+
   ASSERT(tileImage);
-  if (!tileImage) {
-    ti = notile;
+  if (!tileImage)
     return false;
-  }
 
   auto& h = hashTable(); // Don't use m_hash directly in case that
                          // we've to regenerate the hash table.
 
-  auto it = h.find(tileImage);
-  if (it != h.end()) {
-    ti = it->second;
-    return true;
-  }
-  else {
-    ti = notile;
-    return false;
+  // Two or more tiles can be exactly the same, in that case we
+  // return the first one (the one with the lowest index) with
+  // the preferred flips.
+  bool found = false;
+  int foundOrder = 0;
+  auto range = h.equal_range(tile_image_hash(tileImage));
+  for (auto it=range.first; it!=range.second; ++it) {
+    const tile_index i = tile_geti(it->second);
+    const tile_flags f = tile_getf(it->second);
+    if ((f & ~matchFlags) != 0)
+      continue;
+
+    const int order = kFlipVariantOrder[flip_variant(f)];
+    if (found && (order > foundOrder ||
+                  (order == foundOrder && i >= ti)))
+      continue;
+
+    ASSERT(i < size());
+    const ImageRef& image = m_tiles[i].image;
+    if (f == 0 ? is_same_image(tileImage.get(), image.get()):
+                 is_same_image(tileImage.get(), make_flipped_image(image, f).get())) {
+      found = true;
+      foundOrder = order;
+      ti = i;
+      tf = f;
+    }
   }
+  return found;
 }
 
 void Tileset::notifyTileContentChange(const tile_index ti)
 {
-#if 0 // TODO Try to do less work
-
-  ASSERT(ti >= 0 && ti < size());
+  if (ti >= 0 && ti < size() && m_tiles[ti].image) {
+    // Remove the entry with the old hash, as the tile hash is cached
+    // we don't need to re-hash the other tiles.
+    if (!m_hash.empty())
+      removeFromHash(ti);
 
-  // If two or more tiles are exactly the same, they will have the
-  // same hash, so the m_hash table can be smaller than the m_tiles
-  // array.
-  if (m_hash.size() < m_tiles.size()) {
-    // Count how many hash elements are poiting to this tile index
-    int tilesWithSameHash = 0;
-    for (auto item : m_hash)
-      if (item.second == ti)
-        ++tilesWithSameHash;
-
-    // In this case we re-generate the whole hash table because one or
-    // more tiles tile are using the hash of the modified tile.
-    if (tilesWithSameHash >= 2) {
-      rehash();
-      return;
-    }
-  }
-
-  // In other case we can do a fast-path, just removing and
-  // re-adding the tile to the hash table.
-  removeFromHash(ti, false);
-  if (!m_hash.empty())
-    hashImage(ti, m_tiles[ti]);
-
-#else // Regenerate the whole hash map (at the moment this is the
-      // only way to make it work correctly)
-
-  (void)ti;                     // unused
-
-  if (ti >= 0 && ti < m_tiles.size() && m_tiles[ti].image)
     preprocess_transparent_pixels(m_tiles[ti].image.get());
+    m_tiles[ti].setHash(tile_image_hash(m_tiles[ti].image));
 
-  rehash();
+    if (!m_hash.empty())
+      hashTile(ti);
+  }
 
-#endif
+  // Reset the compressed data (just in case we have cached the data
+  // from a loaded .aseprite file or when saving the file).
+  discardCompressedData();
 }
 
 void Tileset::notifyRegenerateEmptyTile()
@@ -324,22 +400,38 @@ void Tileset::notifyRegenerateEmptyTile()
   ImageRef image = get(doc::notile);
   if (image)
     doc::clear_image(image.get(), image->maskColor());
-  rehash();
+  notifyTileContentChange(doc::notile);
 }
 
-void Tileset::removeFromHash(const tile_index ti,
-                             const bool adjustIndexes)
+uint64_t Tileset::tileHash(const tile_index ti, const int variant)
 {
-  auto end = m_hash.end();
-  for (auto it=m_hash.begin(); it!=end; ) {
-    if (it->second == ti) {
-      it = m_hash.erase(it);
-      end = m_hash.end();
-    }
-    else {
-      if (adjustIndexes && it->second > ti)
-        --it->second;
-      ++it;
+  Tile& tile = m_tiles[ti];
+  if ((tile.hashedVariants & (1 << variant)) == 0) {
+    if (variant == 0)
+      tile.hashes[0] = tile_image_hash(tile.image);
+    else
+      tile.hashes[variant] =
+        tile_image_hash(make_flipped_image(tile.image,
+                                           flip_variant_flags(variant)));
+    tile.hashedVariants |= (1 << variant);
+  }
+  return tile.hashes[variant];
+}
+
+void Tileset::removeFromHash(const tile_index ti)
+{
+  for (int v=0; v<8; ++v) {
+    const tile_flags tf = flip_variant_flags(v);
+    if ((tf & ~m_matchFlags) != 0)
+      continue;
+
+    const tile_t t = tile(ti, tf);
+    auto range = m_hash.equal_range(tileHash(ti, v));
+    for (auto it=range.first; it!=range.second; ++it) {
+      if (it->second == t) {
+        m_hash.erase(it);
+        break;
+      }
     }
   }
 }
@@ -352,46 +444,50 @@ void Tileset::assertValidHashTable()
   if (m_hash.empty())
     return;
 
-  // If two or more tiles are exactly the same, they will have the
-  // same hash, so the m_hash table can be smaller than the m_tiles
-  // array.
-  if (m_hash.size() < m_tiles.size()) {
-    for (tile_index ti=0; ti<tile_index(m_tiles.size()); ++ti) {
-      auto it = m_hash.find(m_tiles[ti].image);
-      ASSERT(it != m_hash.end());
-
-      // If the hash doesn't match, it is because other tile is equal
-      // to this one.
-      if (it->second != ti) {
-        ASSERT(is_same_image(it->first.get(), m_tiles[it->second].image.get()));
+  // Each tile has exactly one entry in the hash table for each flip
+  // variant that can be matched (even if two or more tiles are
+  // equal).
+  int variants = 0;
+  for (int v=0; v<8; ++v)
+    if ((flip_variant_flags(v) & ~m_matchFlags) == 0)
+      ++variants;
+  ASSERT(m_hash.size() == m_tiles.size() * variants);
+
+  for (tile_index ti=0; ti<tile_index(m_tiles.size()); ++ti) {
+    ASSERT(m_tiles[ti].hashedVariants & 1);
+    ASSERT(m_tiles[ti].hashes[0] == tile_image_hash(m_tiles[ti].image));
+
+    bool found = false;
+    auto range = m_hash.equal_range(m_tiles[ti].hashes[0]);
+    for (auto it=range.first; it!=range.second; ++it) {
+      if (it->second == tile(ti, 0)) {
+        found = true;
+        break;
       }
     }
-  }
-  else if (m_hash.size() == m_tiles.size()) {
-    for (tile_index ti=0; ti<tile_index(m_tiles.size()); ++ti) {
-      auto it = m_hash.find(m_tiles[ti].image);
-      ASSERT(it != m_hash.end());
-      ASSERT(it->second == ti);
-    }
-  }
-  else {
-    ASSERT(false && "The hash table cannot contain more tiles than the tileset");
+    ASSERT(found);
   }
 }
 #endif
 
-void Tileset::hashImage(const tile_index ti,
-                        const ImageRef& tileImage)
+void Tileset::hashTile(const tile_index ti)
 {
-  if (m_hash.find(tileImage) == m_hash.end())
-    m_hash[tileImage] = ti;
+  for (int v=0; v<8; ++v) {
+    const tile_flags tf = flip_variant_flags(v);
+    if ((tf & ~m_matchFlags) == 0)
+      m_hash.emplace(tileHash(ti, v), tile(ti, tf));
+  }
 }
 
 void Tileset::rehash()
 {
   // Clear the hash table, we'll lazy-rehash it when
-  // hashTable()/findTileIndex() is used.
+  // hashTable()/findTileIndex() is used. The cached hash of each tile
+  // is discarded too, because tile images could be modified in place
+  // without notifyTileContentChange().
   m_hash.clear();
+  for (Tile& tile : m_tiles)
+    tile.hashedVariants = 0;
 
   // Reset the compressed data (just in case we have cached the data
   // from a loaded .aseprite file or when saving the file).
@@ -401,10 +497,11 @@ void Tileset::rehash()
 TilesetHashTable& Tileset::hashTable()
 {
   if (m_hash.empty()) {
-    // Re-hash/create the whole hash table from scratch
-    tile_index ti = 0;
-    for (auto& tile : m_tiles)
-      hashImage(ti++, tile.image);
+    // Re-create the whole hash table from the cached hash of each
+    // tile (only tiles without a cached hash are read here)
+    m_hash.reserve(m_tiles.size());
+    for (tile_index ti=0; ti<tile_index(m_tiles.size()); ++ti)
+      hashTile(ti);
   }
   return m_hash;
 }
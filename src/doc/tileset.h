@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2023  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -16,6 +16,7 @@
 #include "doc/tileset_hash_table.h"
 #include "doc/with_user_data.h"
 
+#include <array>
 #include <string>
 #include <vector>
 
@@ -28,9 +29,24 @@ namespace doc {
     struct Tile {
       ImageRef image;
       UserData data;
+      // Cached hashes of the image pixels for each combination of
+      // flips (indexed by flip_variant()), re-calculated only when
+      // the image is replaced or notifyTileContentChange() is
+      // called. Flipped variants are calculated only when they are
+      // needed (bit N of "hashedVariants" is 1 if hashes[N] is
+      // valid).
+      std::array<uint64_t, 8> hashes = { };
+      uint8_t hashedVariants = 0;
       Tile() { }
       Tile(const ImageRef& image,
-           const UserData& data) : image(image), data(data) { }
+           const UserData& data,
+           const uint64_t hash) : image(image), data(data) {
+        setHash(hash);
+      }
+      void setHash(const uint64_t hash) {
+        hashes[0] = hash;
+        hashedVariants = 1;
+      }
     };
     static UserData kNoUserData;
 
@@ -62,14 +78,15 @@ namespace doc {
     // Allow to match tiles with the given flags/flips automatically
     // in Auto/Stack modes.
     tile_flags matchFlags() const { return m_matchFlags; }
-    void setMatchFlags(const tile_flags tf) { m_matchFlags = tf; }
+    void setMatchFlags(const tile_flags tf);
 
     // Cached compressed tileset read/writen directly from .aseprite
-    // files.
+    // files (with the given zlib compression level).
     void discardCompressedData();
-    void setCompressedData(const base::buffer& buffer) const;
+    void setCompressedData(const base::buffer& buffer, int level) const;
     const base::buffer& compressedData() const { return m_compressedData; }
     ObjectVersion compressedDataVersion() const { return m_compressedDataVersion; }
+    int compressedDataLevel() const { return m_compressedDataLevel; }
 
     int getMemSize() const override;
 
@@ -127,6 +144,14 @@ namespace doc {
     bool findTileIndex(const ImageRef& tileImage,
                        tile_index& ti);
 
+    // Same as findTileIndex() but it can match flipped versions of
+    // the tiles (depending on matchFlags()), the "tf" parameter
+    // returns the flags that must be used with the "ti" tile to get
+    // the given "tileImage".
+    bool findTileIndex(const ImageRef& tileImage,
+                       tile_index& ti,
+                       tile_flags& tf);
+
     // Must be called when a tile image was modified externally, so
     // the hash elements are re-calculated for that specific tile.
     void notifyTileContentChange(const tile_index ti);
@@ -143,10 +168,13 @@ namespace doc {
 #endif
 
   private:
-    void removeFromHash(const tile_index ti,
-                        const bool adjustIndexes);
-    void hashImage(const tile_index ti,
-                   const ImageRef& tileImage);
+    bool findTileIndex(const ImageRef& tileImage,
+                       const tile_flags matchFlags,
+                       tile_index& ti,
+                       tile_flags& tf);
+    uint64_t tileHash(const tile_index ti, const int variant);
+    void removeFromHash(const tile_index ti);
+    void hashTile(const tile_index ti);
     void rehash();
     TilesetHashTable& hashTable();
 
@@ -173,6 +201,7 @@ namespace doc {
     // contains several layers with tilesets).
     mutable base::buffer m_compressedData;
     mutable doc::ObjectVersion m_compressedDataVersion;
+    mutable int m_compressedDataLevel = 0;
   };
 
 } // namespace doc
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -10,19 +10,21 @@
 
 #include "doc/image.h"
 #include "doc/image_ref.h"
-#include "doc/images_map.h"
 #include "doc/primitives.h"
 #include "doc/tile.h"
 
+#include <cstdint>
 #include <unordered_map>
 
 namespace doc {
 
-  // A hash table used to match Image pixels data <-> tileset index
-  typedef std::unordered_map<ImageRef,
-                             tile_index,
-                             details::image_hash,
-                             details::image_eq> TilesetHashTable;
+  // A hash table used to match Image pixels data <-> tileset index.
+  // The key is the cached 64-bit hash of each tile image (or of a
+  // flipped version of it, see calculate_image_hash64()), and the
+  // value is the tile index + the flips used to get that image. As
+  // different tiles can have the same hash, the pixels must be
+  // compared to find the exact match.
+  typedef std::unordered_multimap<uint64_t, tile_t> TilesetHashTable;
 
 } // namespace doc
 
@@ -0,0 +1,173 @@
+// Aseprite Document Library
+// Copyright (c) 2024  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/grid.h"
+#include "doc/image.h"
+#include "doc/primitives.h"
+#include "doc/remap.h"
+#include "doc/sprite.h"
+#include "doc/tileset.h"
+#include "doc/tilesets.h"
+
+#include <memory>
+
+using namespace doc;
+
+static ImageRef make_tile(const color_t c)
+{
+  ImageRef image(Image::create(IMAGE_RGB, 4, 4));
+  clear_image(image.get(), 0);
+  put_pixel(image.get(), 1, 1, c);
+  return image;
+}
+
+TEST(Tileset, FindTileIndex)
+{
+  auto spr = std::make_unique<Sprite>(ImageSpec(ColorMode::RGB, 16, 16), 256);
+  Tileset tileset(spr.get(), Grid(gfx::Size(4, 4)), 1);
+
+  const color_t red = rgba(255, 0, 0, 255);
+  const color_t blue = rgba(0, 0, 255, 255);
+  const color_t green = rgba(0, 255, 0, 255);
+
+  EXPECT_EQ(1, tileset.add(make_tile(red)));
+  EXPECT_EQ(2, tileset.add(make_tile(blue)));
+  EXPECT_EQ(3, tileset.add(make_tile(red)));
+
+  tile_index ti;
+  EXPECT_TRUE(tileset.findTileIndex(make_tile(red), ti));
+  EXPECT_EQ(1, ti);
+  EXPECT_TRUE(tileset.findTileIndex(make_tile(blue), ti));
+  EXPECT_EQ(2, ti);
+  EXPECT_FALSE(tileset.findTileIndex(make_tile(green), ti));
+  EXPECT_EQ(notile, ti);
+
+  // Indexes after the inserted tile are moved
+  tileset.insert(1, make_tile(green));
+  EXPECT_TRUE(tileset.findTileIndex(make_tile(green), ti));
+  EXPECT_EQ(1, ti);
+  EXPECT_TRUE(tileset.findTileIndex(make_tile(red), ti));
+  EXPECT_EQ(2, ti);
+  EXPECT_TRUE(tileset.findTileIndex(make_tile(blue), ti));
+  EXPECT_EQ(3, ti);
+
+  // The duplicated red tile is found when the first one is erased
+  tileset.erase(2);
+  EXPECT_TRUE(tileset.findTileIndex(make_tile(red), ti));
+  EXPECT_EQ(3, ti);
+  EXPECT_TRUE(tileset.findTileIndex(make_tile(blue), ti));
+  EXPECT_EQ(2, ti);
+
+  // Modify the pixels of a tile
+  put_pixel(tileset.get(2).get(), 1, 1, green);
+  tileset.notifyTileContentChange(2);
+  EXPECT_TRUE(tileset.findTileIndex(make_tile(green), ti));
+  EXPECT_EQ(1, ti);
+  EXPECT_FALSE(tileset.findTileIndex(make_tile(blue), ti));
+
+  tileset.set(1, make_tile(blue));
+  EXPECT_TRUE(tileset.findTileIndex(make_tile(blue), ti));
+  EXPECT_EQ(1, ti);
+  EXPECT_TRUE(tileset.findTileIndex(make_tile(green), ti));
+  EXPECT_EQ(2, ti);
+}
+
+TEST(Tileset, FindFlippedTiles)
+{
+  auto spr = std::make_unique<Sprite>(ImageSpec(ColorMode::RGB, 16, 16), 256);
+  Tileset tileset(spr.get(), Grid(gfx::Size(4, 4)), 1);
+
+  const color_t red = rgba(255, 0, 0, 255);
+  ImageRef image(Image::create(IMAGE_RGB, 4, 4));
+  clear_image(image.get(), 0);
+  put_pixel(image.get(), 1, 0, red);
+  EXPECT_EQ(1, tileset.add(image));
+
+  ImageRef xflip(Image::create(IMAGE_RGB, 4, 4));
+  clear_image(xflip.get(), 0);
+  put_pixel(xflip.get(), 2, 0, red);
+
+  ImageRef dflip(Image::create(IMAGE_RGB, 4, 4));
+  clear_image(dflip.get(), 0);
+  put_pixel(dflip.get(), 0, 1, red);
+
+  ImageRef empty(Image::create(IMAGE_RGB, 4, 4));
+  clear_image(empty.get(), 0);
+
+  tile_index ti;
+  tile_flags tf;
+  EXPECT_TRUE(tileset.findTileIndex(empty, ti, tf));
+  EXPECT_EQ(notile, ti);
+  EXPECT_EQ(0, tf);
+  EXPECT_FALSE(tileset.findTileIndex(xflip, ti, tf));
+  EXPECT_FALSE(tileset.findTileIndex(dflip, ti, tf));
+
+  tileset.setMatchFlags(tile_f_xflip | tile_f_yflip);
+  EXPECT_TRUE(tileset.findTileIndex(xflip, ti, tf));
+  EXPECT_EQ(1, ti);
+  EXPECT_EQ(tile_f_xflip, tf);
+  EXPECT_FALSE(tileset.findTileIndex(dflip, ti, tf));
+  EXPECT_FALSE(tileset.findTileIndex(xflip, ti)); // Without flips
+
+  tileset.setMatchFlags(tile_f_dflip);
+  EXPECT_FALSE(tileset.findTileIndex(xflip, ti, tf));
+  EXPECT_TRUE(tileset.findTileIndex(dflip, ti, tf));
+  EXPECT_EQ(1, ti);
+  EXPECT_EQ(tile_f_dflip, tf);
+
+  // An exact match is preferred over a flipped one
+  EXPECT_EQ(2, tileset.add(dflip));
+  EXPECT_TRUE(tileset.findTileIndex(dflip, ti, tf));
+  EXPECT_EQ(2, ti);
+  EXPECT_EQ(0, tf);
+}
+
+TEST(Tileset, RemapImages)
+{
+  auto spr = std::make_unique<Sprite>(ImageSpec(ColorMode::INDEXED, 16, 16), 256);
+  auto tileset = new Tileset(spr.get(), Grid(gfx::Size(4, 4)), 1);
+  spr->tilesets()->add(tileset);
+
+  ImageRef tile(Image::create(IMAGE_INDEXED, 4, 4));
+  clear_image(tile.get(), 0);
+  put_pixel(tile.get(), 1, 1, 1);
+  EXPECT_EQ(1, tileset->add(tile));
+
+  tile_index ti;
+  EXPECT_TRUE(tileset->findTileIndex(ImageRef(Image::createCopy(tile.get())), ti));
+  EXPECT_EQ(1, ti);
+
+  // Tile images are remapped in place, 1 -> 2
+  Remap remap(256);
+  for (int i=0; i<256; ++i)
+    remap.map(i, i);
+  remap.map(1, 2);
+  spr->remapImages(remap);
+  EXPECT_EQ(2, get_pixel(tileset->get(1).get(), 1, 1));
+
+  ImageRef remapped(Image::create(IMAGE_INDEXED, 4, 4));
+  clear_image(remapped.get(), 0);
+  put_pixel(remapped.get(), 1, 1, 2);
+  EXPECT_TRUE(tileset->findTileIndex(remapped, ti));
+  EXPECT_EQ(1, ti);
+
+  ImageRef original(Image::create(IMAGE_INDEXED, 4, 4));
+  clear_image(original.get(), 0);
+  put_pixel(original.get(), 1, 1, 1);
+  EXPECT_FALSE(tileset->findTileIndex(original, ti));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
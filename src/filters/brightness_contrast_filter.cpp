@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2017  David Capello
 //
 // This program is distributed under the terms of
@@ -33,7 +33,6 @@ const char* BrightnessContrastFilter::getName()
 BrightnessContrastFilter::BrightnessContrastFilter()
   : m_brightness(0.0)
   , m_contrast(0.0)
-  , m_cmap(256)
 {
   updateMap();
 }
@@ -52,25 +51,30 @@ void BrightnessContrastFilter::setContrast(double contrast)
 
 void BrightnessContrastFilter::applyToRgba(FilterManager* filterMgr)
 {
+  if (!m_usePaletteOnRGB) {
+    const Target target = filterMgr->getTarget();
+    apply_luts_to_rgba_row(
+      filterMgr,
+      channel_lut_for_target(target, TARGET_RED_CHANNEL, m_cmap),
+      channel_lut_for_target(target, TARGET_GREEN_CHANNEL, m_cmap),
+      channel_lut_for_target(target, TARGET_BLUE_CHANNEL, m_cmap),
+      identity_channel_lut());
+    return;
+  }
+
   FilterIndexedData* fid = filterMgr->getIndexedData();
   const Palette* pal = fid->getPalette();
-  Palette* newPal = (m_usePaletteOnRGB ? fid->getNewPalette(): nullptr);
+  Palette* newPal = fid->getNewPalette();
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
     color_t c = *src_address;
-
-    if (newPal) {
-      int i =
-        pal->findExactMatch(rgba_getr(c),
-                            rgba_getg(c),
-                            rgba_getb(c),
-                            rgba_geta(c), -1);
-      if (i >= 0)
-        c = newPal->getEntry(i);
-    }
-    else {
-      applyFilterToRgb(target, c);
-    }
+    int i =
+      pal->findExactMatch(rgba_getr(c),
+                          rgba_getg(c),
+                          rgba_getb(c),
+                          rgba_geta(c), -1);
+    if (i >= 0)
+      c = newPal->getEntry(i);
 
     *dst_address = c;
   }
@@ -79,22 +83,15 @@ void BrightnessContrastFilter::applyToRgba(FilterManager* filterMgr)
 
 void BrightnessContrastFilter::applyToGrayscale(FilterManager* filterMgr)
 {
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
-    color_t c = *src_address;
-    int k = graya_getv(c);
-    int a = graya_geta(c);
-
-    if (target & TARGET_GRAY_CHANNEL) k = m_cmap[k];
-
-    *dst_address = graya(k, a);
-  }
-  FILTER_LOOP_THROUGH_ROW_END()
+  const Target target = filterMgr->getTarget();
+  apply_luts_to_grayscale_row(
+    filterMgr,
+    channel_lut_for_target(target, TARGET_GRAY_CHANNEL, m_cmap),
+    identity_channel_lut());
 }
 
 void BrightnessContrastFilter::applyToIndexed(FilterManager* filterMgr)
 {
-  FilterIndexedData* fid = filterMgr->getIndexedData();
-
   // Apply filter to pixels if there is selection (in other case, the
   // change is global, so we have already applied the filter to the
   // palette).
@@ -102,15 +99,10 @@ void BrightnessContrastFilter::applyToIndexed(FilterManager* filterMgr)
     return;
 
   // Apply filter to color region
-  const Palette* pal = fid->getPalette();
-  const RgbMap* rgbmap = fid->getRgbMap();
+  if (filterMgr->isFirstRow())
+    updateIndexMap(filterMgr);
 
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t) {
-    color_t c = pal->getEntry(*src_address);
-    applyFilterToRgb(target, c);
-    *dst_address = rgbmap->mapColor(c);
-  }
-  FILTER_LOOP_THROUGH_ROW_END()
+  apply_lut_to_indexed_row(filterMgr, m_indexMap);
 }
 
 void BrightnessContrastFilter::onApplyToPalette(FilterManager* filterMgr,
@@ -150,6 +142,23 @@ void BrightnessContrastFilter::applyFilterToRgb(
   c = rgba(r, g, b, a);
 }
 
+// Each index is converted to the nearest palette entry of its
+// filtered color, so the filter is calculated only once for each
+// palette entry.
+void BrightnessContrastFilter::updateIndexMap(FilterManager* filterMgr)
+{
+  FilterIndexedData* fid = filterMgr->getIndexedData();
+  const Target target = filterMgr->getTarget();
+  const Palette* pal = fid->getPalette();
+  const RgbMap* rgbmap = fid->getRgbMap();
+
+  for (int i=0; i<256; ++i) {
+    color_t c = pal->getEntry(i);
+    applyFilterToRgb(target, c);
+    m_indexMap[i] = rgbmap->mapColor(c);
+  }
+}
+
 void BrightnessContrastFilter::updateMap()
 {
   int max = int(m_cmap.size());
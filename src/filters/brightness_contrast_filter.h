@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2017  David Capello
 //
 // This program is distributed under the terms of
@@ -11,11 +11,10 @@
 
 #include "doc/color.h"
 #include "doc/palette_picks.h"
+#include "filters/color_lut.h"
 #include "filters/filter.h"
 #include "filters/target.h"
 
-#include <vector>
-
 namespace filters {
 
   class BrightnessContrastFilter : public FilterWithPalette {
@@ -29,6 +28,7 @@ namespace filters {
 
     // Filter implementation
     const char* getName() override;
+    bool canApplyRowsInParallel() const override { return true; }
     void applyToRgba(FilterManager* filterMgr) override;
     void applyToGrayscale(FilterManager* filterMgr) override;
     void applyToIndexed(FilterManager* filterMgr) override;
@@ -37,10 +37,12 @@ namespace filters {
     void onApplyToPalette(FilterManager* filterMgr,
                           const doc::PalettePicks& picks) override;
     void applyFilterToRgb(const Target target, doc::color_t& color);
+    void updateIndexMap(FilterManager* filterMgr);
     void updateMap();
 
     double m_brightness, m_contrast;
-    std::vector<int> m_cmap;
+    ChannelLut m_cmap;
+    ChannelLut m_indexMap;
   };
 
 } // namespace filters
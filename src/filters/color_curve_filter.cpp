@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -27,6 +27,7 @@ using namespace doc;
 
 ColorCurveFilter::ColorCurveFilter()
   : m_cmap(256)
+  , m_lut()
 {
 }
 
@@ -40,69 +41,27 @@ void ColorCurveFilter::generateMap()
 {
   // Generate the color convertion map
   m_curve.getValues(0, 255, m_cmap);
-  for (int c=0; c<256; c++)
+  for (int c=0; c<256; c++) {
     m_cmap[c] = std::clamp(m_cmap[c], 0, 255);
-}
-
-const char* ColorCurveFilter::getName()
-{
-  return "Color Curve";
-}
-
-void ColorCurveFilter::applyToRgba(FilterManager* filterMgr)
-{
-  int c, r, g, b, a;
-
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
-    c = *src_address;
-
-    r = rgba_getr(c);
-    g = rgba_getg(c);
-    b = rgba_getb(c);
-    a = rgba_geta(c);
-
-    if (target & TARGET_RED_CHANNEL) r = m_cmap[r];
-    if (target & TARGET_GREEN_CHANNEL) g = m_cmap[g];
-    if (target & TARGET_BLUE_CHANNEL) b = m_cmap[b];
-    if (target & TARGET_ALPHA_CHANNEL) a = m_cmap[a];
-
-    *dst_address = rgba(r, g, b, a);
+    m_lut[c] = m_cmap[c];
   }
-  FILTER_LOOP_THROUGH_ROW_END()
 }
 
-void ColorCurveFilter::applyToGrayscale(FilterManager* filterMgr)
-{
-  int c, k, a;
-
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
-    c = *src_address;
-
-    k = graya_getv(c);
-    a = graya_geta(c);
-
-    if (target & TARGET_GRAY_CHANNEL) k = m_cmap[k];
-    if (target & TARGET_ALPHA_CHANNEL) a = m_cmap[a];
-
-    *dst_address = graya(k, a);
-  }
-  FILTER_LOOP_THROUGH_ROW_END()
-}
-
-void ColorCurveFilter::applyToIndexed(FilterManager* filterMgr)
+// Converts each palette index to its final index, so the curve is
+// calculated only once for each palette entry.
+void ColorCurveFilter::generateIndexMap(FilterManager* filterMgr)
 {
+  const Target target = filterMgr->getTarget();
   const Palette* pal = filterMgr->getIndexedData()->getPalette();
   const RgbMap* rgbmap = filterMgr->getIndexedData()->getRgbMap();
   int c, r, g, b, a;
 
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t) {
-    c = *src_address;
-
+  for (int i=0; i<256; ++i) {
     if (target & TARGET_INDEX_CHANNEL) {
-      c = m_cmap[c];
+      c = m_cmap[i];
     }
     else {
-      c = pal->getEntry(c);
+      c = pal->getEntry(i);
       r = rgba_getr(c);
       g = rgba_getg(c);
       b = rgba_getb(c);
@@ -116,9 +75,41 @@ void ColorCurveFilter::applyToIndexed(FilterManager* filterMgr)
       c = rgbmap->mapColor(r, g, b, a);
     }
 
-    *dst_address = std::clamp(c, 0, pal->size()-1);
+    m_indexMap[i] = std::clamp(c, 0, pal->size()-1);
   }
-  FILTER_LOOP_THROUGH_ROW_END()
+}
+
+const char* ColorCurveFilter::getName()
+{
+  return "Color Curve";
+}
+
+void ColorCurveFilter::applyToRgba(FilterManager* filterMgr)
+{
+  const Target target = filterMgr->getTarget();
+  apply_luts_to_rgba_row(
+    filterMgr,
+    channel_lut_for_target(target, TARGET_RED_CHANNEL, m_lut),
+    channel_lut_for_target(target, TARGET_GREEN_CHANNEL, m_lut),
+    channel_lut_for_target(target, TARGET_BLUE_CHANNEL, m_lut),
+    channel_lut_for_target(target, TARGET_ALPHA_CHANNEL, m_lut));
+}
+
+void ColorCurveFilter::applyToGrayscale(FilterManager* filterMgr)
+{
+  const Target target = filterMgr->getTarget();
+  apply_luts_to_grayscale_row(
+    filterMgr,
+    channel_lut_for_target(target, TARGET_GRAY_CHANNEL, m_lut),
+    channel_lut_for_target(target, TARGET_ALPHA_CHANNEL, m_lut));
+}
+
+void ColorCurveFilter::applyToIndexed(FilterManager* filterMgr)
+{
+  if (filterMgr->isFirstRow())
+    generateIndexMap(filterMgr);
+
+  apply_lut_to_indexed_row(filterMgr, m_indexMap);
 }
 
 } // namespace filters
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -13,6 +13,7 @@
 
 #include "filters/filter.h"
 #include "filters/color_curve.h"
+#include "filters/color_lut.h"
 
 namespace filters {
 
@@ -25,15 +26,19 @@ namespace filters {
 
     // Filter implementation
     const char* getName();
+    bool canApplyRowsInParallel() const { return true; }
     void applyToRgba(FilterManager* filterMgr);
     void applyToGrayscale(FilterManager* filterMgr);
     void applyToIndexed(FilterManager* filterMgr);
 
   private:
     void generateMap();
+    void generateIndexMap(FilterManager* filterMgr);
 
     ColorCurve m_curve;
     std::vector<int> m_cmap;
+    ChannelLut m_lut;
+    ChannelLut m_indexMap;
   };
 
 } // namespace filters
@@ -0,0 +1,68 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "filters/color_lut.h"
+
+#include "doc/color.h"
+#include "filters/filter_manager.h"
+
+namespace filters {
+
+using namespace doc;
+
+const ChannelLut& identity_channel_lut()
+{
+  static const ChannelLut lut = []{
+    ChannelLut lut;
+    for (int i=0; i<256; ++i)
+      lut[i] = uint8_t(i);
+    return lut;
+  }();
+  return lut;
+}
+
+void apply_luts_to_rgba_row(FilterManager* filterMgr,
+                            const ChannelLut& r,
+                            const ChannelLut& g,
+                            const ChannelLut& b,
+                            const ChannelLut& a)
+{
+  FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
+    const color_t c = *src_address;
+    *dst_address = rgba(r[rgba_getr(c)],
+                        g[rgba_getg(c)],
+                        b[rgba_getb(c)],
+                        a[rgba_geta(c)]);
+  }
+  FILTER_LOOP_THROUGH_ROW_END()
+}
+
+void apply_luts_to_grayscale_row(FilterManager* filterMgr,
+                                 const ChannelLut& k,
+                                 const ChannelLut& a)
+{
+  FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
+    const color_t c = *src_address;
+    *dst_address = graya(k[graya_getv(c)],
+                         a[graya_geta(c)]);
+  }
+  FILTER_LOOP_THROUGH_ROW_END()
+}
+
+void apply_lut_to_indexed_row(FilterManager* filterMgr,
+                              const ChannelLut& index)
+{
+  FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t) {
+    *dst_address = index[*src_address];
+  }
+  FILTER_LOOP_THROUGH_ROW_END()
+}
+
+} // namespace filters
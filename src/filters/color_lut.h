@@ -0,0 +1,51 @@
+// Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef FILTERS_COLOR_LUT_H_INCLUDED
+#define FILTERS_COLOR_LUT_H_INCLUDED
+#pragma once
+
+#include "filters/target.h"
+
+#include <array>
+#include <cstdint>
+
+namespace filters {
+
+  class FilterManager;
+
+  // Table to transform each possible value (0-255) of one channel.
+  // Filters that modify each channel independently precompute these
+  // tables once (e.g. when their parameters change) so the rows are
+  // processed with simple lookups.
+  using ChannelLut = std::array<uint8_t, 256>;
+
+  // Table that doesn't modify the channel.
+  const ChannelLut& identity_channel_lut();
+
+  // Returns "lut" if the given channel is in the target, or the
+  // identity table in other case.
+  inline const ChannelLut& channel_lut_for_target(const Target target,
+                                                  const Target channel,
+                                                  const ChannelLut& lut) {
+    return ((target & channel) ? lut: identity_channel_lut());
+  }
+
+  // Apply the given tables to the current row of the filterMgr.
+  void apply_luts_to_rgba_row(FilterManager* filterMgr,
+                              const ChannelLut& r,
+                              const ChannelLut& g,
+                              const ChannelLut& b,
+                              const ChannelLut& a);
+  void apply_luts_to_grayscale_row(FilterManager* filterMgr,
+                                   const ChannelLut& k,
+                                   const ChannelLut& a);
+  void apply_lut_to_indexed_row(FilterManager* filterMgr,
+                                const ChannelLut& index);
+
+} // namespace filters
+
+#endif
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -19,12 +19,169 @@
 #include "doc/palette.h"
 #include "doc/rgbmap.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_WIN64)
+  #include <emmintrin.h>
+  #define FILTERS_CONVOLUTION_SSE2 1
+#endif
+
 namespace filters {
 
 using namespace doc;
 
 namespace {
 
+  // Returns true if the matrix is the outer product of a column
+  // vector "u" (height elements) and a row vector "v" (width
+  // elements), i.e. value(x, y) == u[y]*v[x]. In this case we can
+  // apply the matrix with two 1D passes (O(width+height) per pixel
+  // instead of O(width*height)).
+  bool separate_matrix(const ConvolutionMatrix* matrix,
+                       std::vector<int>& u,
+                       std::vector<int>& v)
+  {
+    const int w = matrix->getWidth();
+    const int h = matrix->getHeight();
+    if (w < 2 || h < 2)
+      return false;
+
+    // Use the first non-zero row as "v" (divided by the GCD of its
+    // elements, so any other row must be an integer multiple of it)
+    int row = 0;
+    int g = 0;
+    for (; row<h && g == 0; ++row) {
+      for (int x=0; x<w; ++x)
+        g = std::gcd(g, matrix->value(x, row));
+    }
+    if (g == 0)
+      return false;
+    --row;
+
+    v.resize(w);
+    int pivot = -1;
+    for (int x=0; x<w; ++x) {
+      v[x] = matrix->value(x, row) / g;
+      if (pivot < 0 && v[x] != 0)
+        pivot = x;
+    }
+
+    u.resize(h);
+    for (int y=0; y<h; ++y) {
+      const int k = matrix->value(pivot, y);
+      if (k % v[pivot] != 0)
+        return false;
+
+      u[y] = k / v[pivot];
+      for (int x=0; x<w; ++x) {
+        if (matrix->value(x, y) != u[y]*v[x])
+          return false;
+      }
+    }
+    return true;
+  }
+
+  // Applies a separable matrix (see separate_matrix()) to the
+  // current row of RGBA or grayscale images. First we calculate the
+  // vertical pass (with "u") for each column that is needed by the
+  // row, and then the horizontal pass (with "v") for each pixel. The
+  // sums are exactly the same as applying the whole matrix (integer
+  // arithmetic, transparent pixels don't contribute to color
+  // channels and their weight is subtracted from the divisor).
+  template<typename Traits>
+  void apply_separable_matrix_to_row(FilterManager* filterMgr,
+                                     const ConvolutionMatrix* matrix,
+                                     const std::vector<int>& u,
+                                     const std::vector<int>& v,
+                                     const TiledMode tiledMode)
+  {
+    // Number of channels (the last one is the alpha channel), and
+    // one extra element to accumulate the weights of transparent
+    // pixels.
+    constexpr int N = (Traits::pixel_format == IMAGE_RGB ? 4: 2);
+    constexpr int M = N+1;
+    static const Target targets[2][4] = {
+      { TARGET_GRAY_CHANNEL, TARGET_ALPHA_CHANNEL, 0, 0 },
+      { TARGET_RED_CHANNEL, TARGET_GREEN_CHANNEL,
+        TARGET_BLUE_CHANNEL, TARGET_ALPHA_CHANNEL } };
+    const Target* channelTargets = targets[N == 4 ? 1: 0];
+
+    const Image* src = filterMgr->getSourceImage();
+    const int w = matrix->getWidth();
+    const int h = matrix->getHeight();
+    const int x0 = filterMgr->x() - matrix->getCenterX();
+    const int y0 = filterMgr->y() - matrix->getCenterY();
+    const int ncols = filterMgr->getWidth() + w - 1;
+    const bool tiledX = (int(tiledMode) & int(TiledMode::X_AXIS));
+    const bool tiledY = (int(tiledMode) & int(TiledMode::Y_AXIS));
+
+    std::vector<typename Traits::const_address_t> rows(h);
+    for (int i=0; i<h; ++i) {
+      const int gety = get_neighboring_coord(y0+i, src->height(), tiledY);
+      rows[i] = (typename Traits::const_address_t)src->getPixelAddress(0, gety);
+    }
+
+    // Vertical pass
+    std::vector<int> cols(ncols*M, 0);
+    for (int k=0; k<ncols; ++k) {
+      const int getx = get_neighboring_coord(x0+k, src->width(), tiledX);
+      int* col = &cols[k*M];
+      for (int i=0; i<h; ++i) {
+        if (!u[i])
+          continue;
+
+        const typename Traits::pixel_t color = rows[i][getx];
+        if (((color >> (8*(N-1))) & 0xff) == 0)
+          col[N] += u[i];
+        else {
+          for (int c=0; c<N; ++c)
+            col[c] += u[i] * ((color >> (8*c)) & 0xff);
+        }
+      }
+    }
+
+    // Horizontal pass
+    const int div0 = matrix->getDiv();
+    const int bias = matrix->getBias();
+    const int firstX = filterMgr->x();
+
+    FILTER_LOOP_THROUGH_ROW_BEGIN(typename Traits::pixel_t) {
+      int sum[M] = { 0 };
+      const int* col = &cols[(x - firstX)*M];
+      for (int j=0; j<w; ++j, col += M) {
+        if (!v[j])
+          continue;
+        for (int c=0; c<M; ++c)
+          sum[c] += v[j] * col[c];
+      }
+
+      const typename Traits::pixel_t color = *src_address;
+      const int div = div0 - sum[N];
+      if (div == 0) {
+        *dst_address = color;
+        continue;
+      }
+
+      typename Traits::pixel_t result = 0;
+      for (int c=0; c<N; ++c) {
+        int value;
+        if (target & channelTargets[c]) {
+          // The alpha channel uses the original divisor
+          value = sum[c] / (c == N-1 ? div0: div) + bias;
+          value = std::clamp(value, 0, 255);
+        }
+        else
+          value = ((color >> (8*c)) & 0xff);
+        result |= (typename Traits::pixel_t(value) << (8*c));
+      }
+      *dst_address = result;
+    }
+    FILTER_LOOP_THROUGH_ROW_END()
+  }
+
   struct GetPixelsDelegate {
     int div;
     const int* matrixData;
@@ -43,6 +200,8 @@ namespace {
       r = g = b = a = 0;
     }
 
+    void finish() { }
+
     void operator()(RgbTraits::pixel_t color) {
       if (*matrixData) {
         if (rgba_geta(color) == 0)
@@ -58,6 +217,56 @@ namespace {
     }
   };
 
+#if FILTERS_CONVOLUTION_SSE2
+  // Same as GetPixelsDelegateRgba but accumulating the four channels
+  // in one SSE2 register. Each weight must fit in 16-bit (see
+  // matrix_fits_in_int16()).
+  struct GetPixelsDelegateRgbaSse2 : public GetPixelsDelegateRgba {
+    __m128i sum;
+
+    void reset(const ConvolutionMatrix* matrix) {
+      GetPixelsDelegateRgba::reset(matrix);
+      sum = _mm_setzero_si128();
+    }
+
+    // Copies the accumulated values to r, g, b, a fields
+    void finish() {
+      alignas(16) int v[4];
+      _mm_store_si128((__m128i*)v, sum);
+      r = v[0];
+      g = v[1];
+      b = v[2];
+      a = v[3];
+    }
+
+    void operator()(RgbTraits::pixel_t color) {
+      if (*matrixData) {
+        if (rgba_geta(color) == 0)
+          div -= *matrixData;
+        else {
+          // Each 32-bit lane has [channel, 0] as 16-bit values, so
+          // _mm_madd_epi16() gives us channel*weight in each lane.
+          const __m128i zero = _mm_setzero_si128();
+          __m128i c = _mm_cvtsi32_si128(int(color));
+          c = _mm_unpacklo_epi8(c, zero);
+          c = _mm_unpacklo_epi16(c, zero);
+          const __m128i k = _mm_set1_epi32(*matrixData & 0xffff);
+          sum = _mm_add_epi32(sum, _mm_madd_epi16(c, k));
+        }
+      }
+      matrixData++;
+    }
+  };
+
+  bool matrix_fits_in_int16(const ConvolutionMatrix* matrix) {
+    for (int y=0; y<matrix->getHeight(); ++y)
+      for (int x=0; x<matrix->getWidth(); ++x)
+        if (std::abs(matrix->value(x, y)) > 32767)
+          return false;
+    return true;
+  }
+#endif // FILTERS_CONVOLUTION_SSE2
+
   struct GetPixelsDelegateGrayscale : public GetPixelsDelegate {
     int v, a;
 
@@ -107,6 +316,64 @@ namespace {
     }
   };
 
+  template<typename Delegate>
+  void apply_matrix_to_rgba_row(FilterManager* filterMgr,
+                                const ConvolutionMatrix* matrix,
+                                const TiledMode tiledMode)
+  {
+    const Image* src = filterMgr->getSourceImage();
+    uint32_t color;
+    Delegate delegate;
+
+    FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
+      delegate.reset(matrix);
+      get_neighboring_pixels<RgbTraits>(src, x, y,
+                                        matrix->getWidth(),
+                                        matrix->getHeight(),
+                                        matrix->getCenterX(),
+                                        matrix->getCenterY(),
+                                        tiledMode, delegate);
+      delegate.finish();
+
+      color = get_pixel_fast<RgbTraits>(src, x, y);
+      if (delegate.div == 0) {
+        *dst_address = color;
+        continue;
+      }
+
+      if (target & TARGET_RED_CHANNEL) {
+        delegate.r = delegate.r / delegate.div + matrix->getBias();
+        delegate.r = std::clamp(delegate.r, 0, 255);
+      }
+      else
+        delegate.r = rgba_getr(color);
+
+      if (target & TARGET_GREEN_CHANNEL) {
+        delegate.g = delegate.g / delegate.div + matrix->getBias();
+        delegate.g = std::clamp(delegate.g, 0, 255);
+      }
+      else
+        delegate.g = rgba_getg(color);
+
+      if (target & TARGET_BLUE_CHANNEL) {
+        delegate.b = delegate.b / delegate.div + matrix->getBias();
+        delegate.b = std::clamp(delegate.b, 0, 255);
+      }
+      else
+        delegate.b = rgba_getb(color);
+
+      if (target & TARGET_ALPHA_CHANNEL) {
+        delegate.a = delegate.a / matrix->getDiv() + matrix->getBias();
+        delegate.a = std::clamp(delegate.a, 0, 255);
+      }
+      else
+        delegate.a = rgba_geta(color);
+
+      *dst_address = rgba(delegate.r, delegate.g, delegate.b, delegate.a);
+    }
+    FILTER_LOOP_THROUGH_ROW_END()
+  }
+
 }
 
 ConvolutionMatrixFilter::ConvolutionMatrixFilter()
@@ -135,56 +402,23 @@ void ConvolutionMatrixFilter::applyToRgba(FilterManager* filterMgr)
   if (!m_matrix)
     return;
 
-  const Image* src = filterMgr->getSourceImage();
-  uint32_t color;
-  GetPixelsDelegateRgba delegate;
-
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
-    delegate.reset(m_matrix.get());
-    get_neighboring_pixels<RgbTraits>(src, x, y,
-                                      m_matrix->getWidth(),
-                                      m_matrix->getHeight(),
-                                      m_matrix->getCenterX(),
-                                      m_matrix->getCenterY(),
-                                      m_tiledMode, delegate);
-
-    color = get_pixel_fast<RgbTraits>(src, x, y);
-    if (delegate.div == 0) {
-      *dst_address = color;
-      continue;
-    }
-
-    if (target & TARGET_RED_CHANNEL) {
-      delegate.r = delegate.r / delegate.div + m_matrix->getBias();
-      delegate.r = std::clamp(delegate.r, 0, 255);
-    }
-    else
-      delegate.r = rgba_getr(color);
-
-    if (target & TARGET_GREEN_CHANNEL) {
-      delegate.g = delegate.g / delegate.div + m_matrix->getBias();
-      delegate.g = std::clamp(delegate.g, 0, 255);
-    }
-    else
-      delegate.g = rgba_getg(color);
-
-    if (target & TARGET_BLUE_CHANNEL) {
-      delegate.b = delegate.b / delegate.div + m_matrix->getBias();
-      delegate.b = std::clamp(delegate.b, 0, 255);
-    }
-    else
-      delegate.b = rgba_getb(color);
-
-    if (target & TARGET_ALPHA_CHANNEL) {
-      delegate.a = delegate.a / m_matrix->getDiv() + m_matrix->getBias();
-      delegate.a = std::clamp(delegate.a, 0, 255);
-    }
-    else
-      delegate.a = rgba_geta(color);
+  std::vector<int> u, v;
+  if (separate_matrix(m_matrix.get(), u, v)) {
+    apply_separable_matrix_to_row<RgbTraits>(
+      filterMgr, m_matrix.get(), u, v, m_tiledMode);
+    return;
+  }
 
-    *dst_address = rgba(delegate.r, delegate.g, delegate.b, delegate.a);
+#if FILTERS_CONVOLUTION_SSE2
+  if (matrix_fits_in_int16(m_matrix.get())) {
+    apply_matrix_to_rgba_row<GetPixelsDelegateRgbaSse2>(
+      filterMgr, m_matrix.get(), m_tiledMode);
+    return;
   }
-  FILTER_LOOP_THROUGH_ROW_END()
+#endif
+
+  apply_matrix_to_rgba_row<GetPixelsDelegateRgba>(
+    filterMgr, m_matrix.get(), m_tiledMode);
 }
 
 void ConvolutionMatrixFilter::applyToGrayscale(FilterManager* filterMgr)
@@ -192,6 +426,13 @@ void ConvolutionMatrixFilter::applyToGrayscale(FilterManager* filterMgr)
   if (!m_matrix)
     return;
 
+  std::vector<int> u, v;
+  if (separate_matrix(m_matrix.get(), u, v)) {
+    apply_separable_matrix_to_row<GrayscaleTraits>(
+      filterMgr, m_matrix.get(), u, v, m_tiledMode);
+    return;
+  }
+
   const Image* src = filterMgr->getSourceImage();
   uint16_t color;
   GetPixelsDelegateGrayscale delegate;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -44,6 +44,12 @@ namespace filters {
 
     // Applies the filter to the color palette.
     virtual void applyToPalette(FilterManager* filterMgr) { }
+
+    // Returns true if each row can be processed independently of
+    // the others and from several threads at the same time (i.e. the
+    // applyTo*() member functions don't modify the filter state).
+    // Only used for RGB and grayscale images.
+    virtual bool canApplyRowsInParallel() const { return false; }
   };
 
   // Filter that support applying it only to palette colors.
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2017-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -39,6 +39,7 @@ HueSaturationFilter::HueSaturationFilter()
   , m_l(0.0)
   , m_a(0.0)
 {
+  updateGrayMaps();
 }
 
 void HueSaturationFilter::setMode(Mode mode)
@@ -59,11 +60,13 @@ void HueSaturationFilter::setSaturation(double s)
 void HueSaturationFilter::setLightness(double l)
 {
   m_l = l;
+  updateGrayMaps();
 }
 
 void HueSaturationFilter::setAlpha(double a)
 {
   m_a = a;
+  updateGrayMaps();
 }
 
 void HueSaturationFilter::applyToRgba(FilterManager* filterMgr)
@@ -72,6 +75,12 @@ void HueSaturationFilter::applyToRgba(FilterManager* filterMgr)
   const Palette* pal = fid->getPalette();
   Palette* newPal = (m_usePaletteOnRGB ? fid->getNewPalette(): nullptr);
 
+  // Consecutive pixels usually have the same color, so we can reuse
+  // the last converted color.
+  color_t lastSrc = 0;
+  color_t lastDst = 0;
+  applyFilterToRgb(filterMgr->getTarget(), lastDst);
+
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
     color_t c = *src_address;
 
@@ -84,8 +93,13 @@ void HueSaturationFilter::applyToRgba(FilterManager* filterMgr)
       if (i >= 0)
         c = newPal->getEntry(i);
     }
+    else if (c == lastSrc) {
+      c = lastDst;
+    }
     else {
+      lastSrc = c;
       applyFilterToRgb(target, c);
+      lastDst = c;
     }
 
     *dst_address = c;
@@ -95,31 +109,11 @@ void HueSaturationFilter::applyToRgba(FilterManager* filterMgr)
 
 void HueSaturationFilter::applyToGrayscale(FilterManager* filterMgr)
 {
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
-    color_t c = *src_address;
-    int k = graya_getv(c);
-    int a = graya_geta(c);
-
-    {
-      gfx::Hsl hsl(gfx::Rgb(k, k, k));
-
-      double l = hsl.lightness()*(1.0+m_l);
-      l = std::clamp(l, 0.0, 1.0);
-
-      hsl.lightness(l);
-      gfx::Rgb rgb(hsl);
-
-      if (target & TARGET_GRAY_CHANNEL) k = rgb.red();
-
-      if (a && (target & TARGET_ALPHA_CHANNEL)) {
-        a = a*(1.0+m_a);
-        a = std::clamp(a, 0, 255);
-      }
-    }
-
-    *dst_address = graya(k, a);
-  }
-  FILTER_LOOP_THROUGH_ROW_END()
+  const Target target = filterMgr->getTarget();
+  apply_luts_to_grayscale_row(
+    filterMgr,
+    channel_lut_for_target(target, TARGET_GRAY_CHANNEL, m_grayMap),
+    channel_lut_for_target(target, TARGET_ALPHA_CHANNEL, m_alphaMap));
 }
 
 void HueSaturationFilter::applyToIndexed(FilterManager* filterMgr)
@@ -131,16 +125,10 @@ void HueSaturationFilter::applyToIndexed(FilterManager* filterMgr)
     return;
 
   // Apply filter to color region
-  FilterIndexedData* fid = filterMgr->getIndexedData();
-  const Palette* pal = fid->getPalette();
-  const RgbMap* rgbmap = fid->getRgbMap();
+  if (filterMgr->isFirstRow())
+    updateIndexMap(filterMgr);
 
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t) {
-    color_t c = pal->getEntry(*src_address);
-    applyFilterToRgb(target, c);
-    *dst_address = rgbmap->mapColor(c);
-  }
-  FILTER_LOOP_THROUGH_ROW_END()
+  apply_lut_to_indexed_row(filterMgr, m_indexMap);
 }
 
 void HueSaturationFilter::onApplyToPalette(FilterManager* filterMgr,
@@ -165,6 +153,42 @@ void HueSaturationFilter::onApplyToPalette(FilterManager* filterMgr,
   }
 }
 
+// Each index is converted to the nearest palette entry of its
+// filtered color, so the filter is calculated only once for each
+// palette entry.
+void HueSaturationFilter::updateIndexMap(FilterManager* filterMgr)
+{
+  FilterIndexedData* fid = filterMgr->getIndexedData();
+  const Target target = filterMgr->getTarget();
+  const Palette* pal = fid->getPalette();
+  const RgbMap* rgbmap = fid->getRgbMap();
+
+  for (int i=0; i<256; ++i) {
+    color_t c = pal->getEntry(i);
+    applyFilterToRgb(target, c);
+    m_indexMap[i] = rgbmap->mapColor(c);
+  }
+}
+
+// Grayscale images are only affected by the lightness and alpha
+// parameters, so we can precalculate the result for each value.
+void HueSaturationFilter::updateGrayMaps()
+{
+  for (int k=0; k<256; ++k) {
+    gfx::Hsl hsl(gfx::Rgb(k, k, k));
+
+    double l = hsl.lightness()*(1.0+m_l);
+    l = std::clamp(l, 0.0, 1.0);
+
+    hsl.lightness(l);
+    m_grayMap[k] = gfx::Rgb(hsl).red();
+  }
+
+  m_alphaMap[0] = 0;
+  for (int a=1; a<256; ++a)
+    m_alphaMap[a] = std::clamp(int(a*(1.0+m_a)), 0, 255);
+}
+
 template<class T,
          double (T::*get_lightness)() const,
          void (T::*set_lightness)(double)>
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2017-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -10,6 +10,7 @@
 #pragma once
 
 #include "doc/color.h"
+#include "filters/color_lut.h"
 #include "filters/filter.h"
 #include "filters/target.h"
 
@@ -32,6 +33,7 @@ namespace filters {
 
     // Filter implementation
     const char* getName() override;
+    bool canApplyRowsInParallel() const override { return true; }
     void applyToRgba(FilterManager* filterMgr) override;
     void applyToGrayscale(FilterManager* filterMgr) override;
     void applyToIndexed(FilterManager* filterMgr) override;
@@ -45,9 +47,14 @@ namespace filters {
              void (T::*set_lightness)(double)>
     void applyFilterToRgbT(const Target target, doc::color_t& color, bool multiply);
     void applyFilterToRgb(const Target target, doc::color_t& color);
+    void updateIndexMap(FilterManager* filterMgr);
+    void updateGrayMaps();
 
     Mode m_mode;
     double m_h, m_s, m_l, m_a;
+    ChannelLut m_grayMap;
+    ChannelLut m_alphaMap;
+    ChannelLut m_indexMap;
   };
 
 } // namespace filters
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -25,59 +26,62 @@ const char* InvertColorFilter::getName()
   return "Invert Color";
 }
 
-void InvertColorFilter::applyToRgba(FilterManager* filterMgr)
+// Table to invert the value of a channel.
+static const ChannelLut& invert_channel_lut()
 {
-  int c, r, g, b, a;
-
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
-    c = *src_address;
-
-    r = rgba_getr(c);
-    g = rgba_getg(c);
-    b = rgba_getb(c);
-    a = rgba_geta(c);
-
-    if (target & TARGET_RED_CHANNEL) r ^= 0xff;
-    if (target & TARGET_GREEN_CHANNEL) g ^= 0xff;
-    if (target & TARGET_BLUE_CHANNEL) b ^= 0xff;
-    if (target & TARGET_ALPHA_CHANNEL) a ^= 0xff;
+  static const ChannelLut lut = []{
+    ChannelLut lut;
+    for (int i=0; i<256; ++i)
+      lut[i] = uint8_t(i ^ 0xff);
+    return lut;
+  }();
+  return lut;
+}
 
-    *dst_address = rgba(r, g, b, a);
-  }
-  FILTER_LOOP_THROUGH_ROW_END()
+void InvertColorFilter::applyToRgba(FilterManager* filterMgr)
+{
+  const Target target = filterMgr->getTarget();
+  const ChannelLut& lut = invert_channel_lut();
+  apply_luts_to_rgba_row(
+    filterMgr,
+    channel_lut_for_target(target, TARGET_RED_CHANNEL, lut),
+    channel_lut_for_target(target, TARGET_GREEN_CHANNEL, lut),
+    channel_lut_for_target(target, TARGET_BLUE_CHANNEL, lut),
+    channel_lut_for_target(target, TARGET_ALPHA_CHANNEL, lut));
 }
 
 void InvertColorFilter::applyToGrayscale(FilterManager* filterMgr)
 {
-  int c, k, a;
-
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
-    c = *src_address;
-
-    k = graya_getv(c);
-    a = graya_geta(c);
+  const Target target = filterMgr->getTarget();
+  const ChannelLut& lut = invert_channel_lut();
+  apply_luts_to_grayscale_row(
+    filterMgr,
+    channel_lut_for_target(target, TARGET_GRAY_CHANNEL, lut),
+    channel_lut_for_target(target, TARGET_ALPHA_CHANNEL, lut));
+}
 
-    if (target & TARGET_GRAY_CHANNEL) k ^= 0xff;
-    if (target & TARGET_ALPHA_CHANNEL) a ^= 0xff;
+void InvertColorFilter::applyToIndexed(FilterManager* filterMgr)
+{
+  if (filterMgr->isFirstRow())
+    generateIndexMap(filterMgr);
 
-    *dst_address = graya(k, a);
-  }
-  FILTER_LOOP_THROUGH_ROW_END()
+  apply_lut_to_indexed_row(filterMgr, m_indexMap);
 }
 
-void InvertColorFilter::applyToIndexed(FilterManager* filterMgr)
+// Converts each palette index to its final index, so the inverted
+// color is calculated only once for each palette entry.
+void InvertColorFilter::generateIndexMap(FilterManager* filterMgr)
 {
+  const Target target = filterMgr->getTarget();
   const Palette* pal = filterMgr->getIndexedData()->getPalette();
   const RgbMap* rgbmap = filterMgr->getIndexedData()->getRgbMap();
   int c, r, g, b, a;
 
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t) {
-    c = *src_address;
-
+  for (int i=0; i<256; ++i) {
     if (target & TARGET_INDEX_CHANNEL)
-      c ^= 0xff;
+      c = i ^ 0xff;
     else {
-      c = pal->getEntry(c);
+      c = pal->getEntry(i);
       r = rgba_getr(c);
       g = rgba_getg(c);
       b = rgba_getb(c);
@@ -91,9 +95,8 @@ void InvertColorFilter::applyToIndexed(FilterManager* filterMgr)
       c = rgbmap->mapColor(r, g, b, a);
     }
 
-    *dst_address = c;
+    m_indexMap[i] = c;
   }
-  FILTER_LOOP_THROUGH_ROW_END()
 }
 
 } // namespace filters
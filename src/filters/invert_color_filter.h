@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -8,6 +9,7 @@
 #define FILTERS_INVERT_COLOR_FILTER_H_INCLUDED
 #pragma once
 
+#include "filters/color_lut.h"
 #include "filters/filter.h"
 
 namespace filters {
@@ -16,9 +18,15 @@ namespace filters {
   public:
     // Filter implementation
     const char* getName();
+    bool canApplyRowsInParallel() const { return true; }
     void applyToRgba(FilterManager* filterMgr);
     void applyToGrayscale(FilterManager* filterMgr);
     void applyToIndexed(FilterManager* filterMgr);
+
+  private:
+    void generateIndexMap(FilterManager* filterMgr);
+
+    ChannelLut m_indexMap;
   };
 
 } // namespace filters
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020  Igara Studio S.A.
+// Copyright (C) 2020-2024  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -21,11 +21,189 @@
 #include "filters/tiled_mode.h"
 
 #include <algorithm>
+#include <array>
+#include <cstring>
 
 namespace filters {
 
 using namespace doc;
 
+// Kernels with less pixels than this are processed sorting the
+// neighborhood of each pixel (faster for small kernels).
+static constexpr int kMinSlidingMedianSize = 49;
+
+// Median filter in constant time per pixel using sliding histograms
+// (Perreault and Hébert, "Median Filtering in Constant Time", 2007).
+//
+// We keep a histogram for each column of the source image with the
+// "height" pixels of the kernel, updated when we move from one row to
+// the next one (removing the top pixel and adding the new bottom
+// one). Then the histogram of the kernel is updated for each pixel
+// adding the column histogram that enters the kernel and subtracting
+// the one that leaves it. Each histogram has 256 fine bins and 16
+// coarse bins (to find the median bin quickly).
+//
+// Pixels outside the image are handled in the same way as
+// get_neighboring_pixels() (see get_neighboring_coord()), so the
+// result is the same as sorting the neighborhood.
+class MedianFilter::SlidingMedian {
+public:
+  static constexpr int kBins = 256;
+  static constexpr int kCoarse = 16;
+
+  // Processes a row of the filter. "Traits" must be RgbTraits or
+  // GrayscaleTraits, where channel "c" is in bits [8*c, 8*c+8).
+  template<typename Traits>
+  void applyToRow(FilterManager* filterMgr,
+                  const MedianFilter& filter,
+                  const int nchannels) {
+    const Image* src = filterMgr->getSourceImage();
+    const int row = filterMgr->y();
+    const int w = filter.m_width;
+    const int h = filter.m_height;
+    const int cx = w/2;
+    const int cy = h/2;
+    const bool tiledX = (int(filter.m_tiledMode) & int(TiledMode::X_AXIS));
+    const bool tiledY = (int(filter.m_tiledMode) & int(TiledMode::Y_AXIS));
+    const int half = filter.m_ncolors/2;
+
+    // Prepare the column histograms for this row
+    if (src != m_image ||
+        nchannels != m_nchannels ||
+        row != m_y+1 ||
+        filterMgr->isFirstRow()) {
+      resetColumns<Traits>(src, row, h, cy, tiledY, nchannels);
+    }
+    else {
+      const int oldRow = get_neighboring_coord(row-1-cy, src->height(), tiledY);
+      const int newRow = get_neighboring_coord(row-cy+h-1, src->height(), tiledY);
+      if (oldRow != newRow) {
+        auto oldAddr = (typename Traits::const_address_t)src->getPixelAddress(0, oldRow);
+        auto newAddr = (typename Traits::const_address_t)src->getPixelAddress(0, newRow);
+        for (int u=0; u<m_width; ++u) {
+          addPixelToColumn(u, oldAddr[u], -1);
+          addPixelToColumn(u, newAddr[u], +1);
+        }
+      }
+    }
+    m_y = row;
+
+    // Prepare the kernel histogram for the first pixel of the row
+    int winX = filterMgr->x();
+    clearKernel();
+    for (int dx=0; dx<w; ++dx)
+      addColumnToKernel(get_neighboring_coord(winX-cx+dx, m_width, tiledX), +1);
+
+    FILTER_LOOP_THROUGH_ROW_BEGIN(typename Traits::pixel_t) {
+      // Slide the kernel to the current "x" (skipped pixels must
+      // move the kernel too)
+      for (; winX < x; ++winX) {
+        addColumnToKernel(get_neighboring_coord(winX-cx, m_width, tiledX), -1);
+        addColumnToKernel(get_neighboring_coord(winX-cx+w, m_width, tiledX), +1);
+      }
+
+      typename Traits::pixel_t color = *src_address;
+      for (int c=0; c<nchannels; ++c) {
+        if (target & channelTarget<Traits>(c)) {
+          const int shift = 8*c;
+          color &= ~(typename Traits::pixel_t(0xff) << shift);
+          color |= (typename Traits::pixel_t(median(c, half)) << shift);
+        }
+      }
+      *dst_address = color;
+    }
+    FILTER_LOOP_THROUGH_ROW_END()
+  }
+
+private:
+  template<typename Traits>
+  static Target channelTarget(const int c) {
+    if (Traits::pixel_format == IMAGE_GRAYSCALE)
+      return (c == 0 ? TARGET_GRAY_CHANNEL: TARGET_ALPHA_CHANNEL);
+    static const Target targets[] = {
+      TARGET_RED_CHANNEL, TARGET_GREEN_CHANNEL,
+      TARGET_BLUE_CHANNEL, TARGET_ALPHA_CHANNEL };
+    return targets[c];
+  }
+
+  template<typename Traits>
+  void resetColumns(const Image* src, const int y,
+                    const int h, const int cy, const bool tiledY,
+                    const int nchannels) {
+    m_image = src;
+    m_nchannels = nchannels;
+    m_width = src->width();
+    m_fine.assign(m_width * m_nchannels * kBins, 0);
+    m_coarse.assign(m_width * m_nchannels * kCoarse, 0);
+
+    for (int dy=0; dy<h; ++dy) {
+      const int v = get_neighboring_coord(y-cy+dy, src->height(), tiledY);
+      auto addr = (typename Traits::const_address_t)src->getPixelAddress(0, v);
+      for (int u=0; u<m_width; ++u)
+        addPixelToColumn(u, addr[u], +1);
+    }
+  }
+
+  void addPixelToColumn(const int u, const uint32_t pixel, const int delta) {
+    for (int c=0; c<m_nchannels; ++c) {
+      const int value = ((pixel >> (8*c)) & 0xff);
+      m_fine[(u*m_nchannels + c)*kBins + value] += delta;
+      m_coarse[(u*m_nchannels + c)*kCoarse + value/kCoarse] += delta;
+    }
+  }
+
+  void clearKernel() {
+    for (int c=0; c<m_nchannels; ++c) {
+      m_kernelFine[c].fill(0);
+      m_kernelCoarse[c].fill(0);
+    }
+  }
+
+  void addColumnToKernel(const int u, const int delta) {
+    for (int c=0; c<m_nchannels; ++c) {
+      const uint16_t* fine = &m_fine[(u*m_nchannels + c)*kBins];
+      const uint16_t* coarse = &m_coarse[(u*m_nchannels + c)*kCoarse];
+      uint16_t* kernelFine = m_kernelFine[c].data();
+      uint16_t* kernelCoarse = m_kernelCoarse[c].data();
+      if (delta > 0) {
+        for (int i=0; i<kBins; ++i) kernelFine[i] += fine[i];
+        for (int i=0; i<kCoarse; ++i) kernelCoarse[i] += coarse[i];
+      }
+      else {
+        for (int i=0; i<kBins; ++i) kernelFine[i] -= fine[i];
+        for (int i=0; i<kCoarse; ++i) kernelCoarse[i] -= coarse[i];
+      }
+    }
+  }
+
+  // Returns the value in the position "half" of the sorted kernel.
+  int median(const int c, const int half) const {
+    int acc = 0;
+    int k = 0;
+    for (; k<kCoarse-1; ++k) {
+      if (acc + m_kernelCoarse[c][k] > half)
+        break;
+      acc += m_kernelCoarse[c][k];
+    }
+    int v = k*kCoarse;
+    for (; v<kBins-1; ++v) {
+      acc += m_kernelFine[c][v];
+      if (acc > half)
+        break;
+    }
+    return v;
+  }
+
+  const Image* m_image = nullptr;
+  int m_nchannels = 0;
+  int m_width = 0;
+  int m_y = 0;
+  std::vector<uint16_t> m_fine;   // [column][channel][kBins]
+  std::vector<uint16_t> m_coarse; // [column][channel][kCoarse]
+  std::array<std::array<uint16_t, kBins>, 4> m_kernelFine;
+  std::array<std::array<uint16_t, kCoarse>, 4> m_kernelCoarse;
+};
+
 namespace {
   struct GetPixelsDelegateRgba {
     std::vector<std::vector<uint8_t> >& channel;
@@ -98,9 +276,14 @@ MedianFilter::MedianFilter()
 {
 }
 
+MedianFilter::~MedianFilter()
+{
+}
+
 void MedianFilter::setTiledMode(TiledMode tiled)
 {
   m_tiledMode = tiled;
+  m_sliding.reset();
 }
 
 void MedianFilter::setSize(int width, int height)
@@ -114,6 +297,8 @@ void MedianFilter::setSize(int width, int height)
 
   for (int c = 0; c < 4; ++c)
     m_channel[c].resize(m_ncolors);
+
+  m_sliding.reset();
 }
 
 const char* MedianFilter::getName()
@@ -121,8 +306,20 @@ const char* MedianFilter::getName()
   return "Median Blur";
 }
 
+bool MedianFilter::useSlidingMedian() const
+{
+  return (m_ncolors >= kMinSlidingMedianSize);
+}
+
 void MedianFilter::applyToRgba(FilterManager* filterMgr)
 {
+  if (useSlidingMedian()) {
+    if (!m_sliding)
+      m_sliding = std::make_unique<SlidingMedian>();
+    m_sliding->applyToRow<RgbTraits>(filterMgr, *this, 4);
+    return;
+  }
+
   const Image* src = filterMgr->getSourceImage();
   int color, r, g, b, a;
   GetPixelsDelegateRgba delegate(m_channel);
@@ -169,6 +366,13 @@ void MedianFilter::applyToRgba(FilterManager* filterMgr)
 
 void MedianFilter::applyToGrayscale(FilterManager* filterMgr)
 {
+  if (useSlidingMedian()) {
+    if (!m_sliding)
+      m_sliding = std::make_unique<SlidingMedian>();
+    m_sliding->applyToRow<GrayscaleTraits>(filterMgr, *this, 2);
+    return;
+  }
+
   const Image* src = filterMgr->getSourceImage();
   int color, k, a;
   GetPixelsDelegateGrayscale delegate(m_channel);
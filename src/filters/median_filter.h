@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -12,6 +13,7 @@
 #include "filters/filter.h"
 #include "filters/tiled_mode.h"
 
+#include <memory>
 #include <vector>
 
 namespace filters {
@@ -19,6 +21,7 @@ namespace filters {
   class MedianFilter : public Filter {
   public:
     MedianFilter();
+    ~MedianFilter();
 
     void setTiledMode(TiledMode tiled);
     void setSize(int width, int height);
@@ -34,11 +37,16 @@ namespace filters {
     void applyToIndexed(FilterManager* filterMgr);
 
   private:
+    class SlidingMedian;
+
+    bool useSlidingMedian() const;
+
     TiledMode m_tiledMode;
     int m_width;
     int m_height;
     int m_ncolors;
     std::vector<std::vector<uint8_t> > m_channel;
+    std::unique_ptr<SlidingMedian> m_sliding;
   };
 
 } // namespace filters
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2024  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -12,11 +13,25 @@
 #include "doc/image.h"
 #include "doc/image_traits.h"
 
+#include <algorithm>
 #include <vector>
 
 namespace filters {
   using namespace doc;
 
+  // Returns the coordinate of the pixel used by
+  // get_neighboring_pixels() for the given "v" coordinate in an axis
+  // of the given "size": wrapped in tiled mode, or clamped to the
+  // image edges otherwise.
+  inline int get_neighboring_coord(int v, const int size, const bool tiled)
+  {
+    if (tiled) {
+      v %= size;
+      return (v < 0 ? v+size: v);
+    }
+    return std::clamp(v, 0, size-1);
+  }
+
   // Calls the specified "delegate" for all neighboring pixels in a 2D
   // (width*height) matrix located in (x,y) where its center is the
   // (centerX,centerY) element of the matrix.
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -18,6 +18,12 @@
 #include "filters/neighboring_pixels.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_WIN64)
+  #include <emmintrin.h>
+#endif
 
 namespace filters {
 
@@ -25,59 +31,140 @@ using namespace doc;
 
 namespace {
 
-  struct GetPixelsDelegate {
-    color_t bgColor;
-    int transparent;    // Transparent pixels
-    int opaque;         // Opaque pixels
-    int matrix;
-    int bit;
-
-    void init(const color_t bgColor,
-              const OutlineFilter::Matrix matrix) {
-      this->bgColor = bgColor;
-      this->matrix = (int)matrix;
-    }
+  // Functors to know if a pixel is "opaque" for the outline filter
+  // (i.e. it's not transparent and it's not the background color).
 
-    void reset() {
-      transparent = opaque = 0;
-      bit = 1;
+  struct IsOpaqueRgba {
+    color_t bgColor;
+    bool operator()(RgbTraits::pixel_t color) const {
+      return (rgba_geta(color) != 0 && color != bgColor);
     }
   };
 
-  struct GetPixelsDelegateRgba : public GetPixelsDelegate {
-    void operator()(RgbTraits::pixel_t color) {
-      if (rgba_geta(color) == 0 || color == bgColor)
-        transparent += (matrix & bit ? 1: 0);
-      else
-        opaque += (matrix & bit ? 1: 0);
-      bit <<= 1;
+  struct IsOpaqueGrayscale {
+    color_t bgColor;
+    bool operator()(GrayscaleTraits::pixel_t color) const {
+      return (graya_geta(color) != 0 && color != bgColor);
     }
   };
 
-  struct GetPixelsDelegateGrayscale : public GetPixelsDelegate {
-    void operator()(GrayscaleTraits::pixel_t color) {
-      if (graya_geta(color) == 0 || color == bgColor)
-        transparent += (matrix & bit ? 1: 0);
-      else
-        opaque += (matrix & bit ? 1: 0);
-      bit <<= 1;
+  struct IsOpaqueIndexed {
+    color_t bgColor;
+    const Palette* pal;
+    bool operator()(IndexedTraits::pixel_t color) const {
+      return (rgba_geta(pal->getEntry(color)) != 0 && color != bgColor);
     }
   };
 
-  struct GetPixelsDelegateIndexed : public GetPixelsDelegate {
-    const Palette* pal;
+  // Stores 1 in "dst" for each opaque pixel of "src" and 0 for each
+  // transparent pixel.
+  template<typename PixelType, typename IsOpaque>
+  void get_opaque_pixels(const PixelType* src, const int n,
+                         const IsOpaque& isOpaque, uint8_t* dst)
+  {
+    for (int u=0; u<n; ++u)
+      dst[u] = (isOpaque(src[u]) ? 1: 0);
+  }
+
+#if defined(__x86_64__) || defined(_WIN64)
+  void get_opaque_pixels(const uint32_t* src, const int n,
+                         const IsOpaqueRgba& isOpaque, uint8_t* dst)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i bg = _mm_set1_epi32(int(isOpaque.bgColor));
+
+    // 0xffffffff for each transparent pixel (alpha=0 or bgColor)
+    auto transparent = [zero, bg](const uint32_t* p) {
+      const __m128i v = _mm_loadu_si128((const __m128i*)p);
+      return _mm_or_si128(_mm_cmpeq_epi32(_mm_srli_epi32(v, 24), zero),
+                          _mm_cmpeq_epi32(v, bg));
+    };
+
+    int u = 0;
+    for (; u+16<=n; u+=16) {
+      const __m128i t =
+        _mm_packs_epi16(
+          _mm_packs_epi32(transparent(src+u),   transparent(src+u+4)),
+          _mm_packs_epi32(transparent(src+u+8), transparent(src+u+12)));
+      _mm_storeu_si128((__m128i*)(dst+u), _mm_andnot_si128(t, one));
+    }
+    for (; u<n; ++u)
+      dst[u] = (isOpaque(src[u]) ? 1: 0);
+  }
+#endif
 
-    GetPixelsDelegateIndexed(const Palette* pal) : pal(pal) { }
+  // Returns a 9-bit mask for each pixel of the row that the
+  // filterMgr is processing. Each bit is 1 if the pixel of its 3x3
+  // neighborhood is opaque, where bit 0 is the top-left pixel and bit
+  // 8 the bottom-right one (this is the same order used in
+  // OutlineFilter::Matrix).
+  template<typename Traits, typename IsOpaque>
+  const uint16_t* get_neighbors_masks(FilterManager* filterMgr,
+                                      const TiledMode tiledMode,
+                                      const IsOpaque& isOpaque)
+  {
+    using pixel_t = typename Traits::pixel_t;
+
+    // Buffers to avoid allocating memory for each row (one per
+    // thread as the rows are processed in parallel)
+    static thread_local std::vector<uint8_t> opaque;
+    static thread_local std::vector<uint16_t> masks;
+
+    const Image* src = filterMgr->getSourceImage();
+    const int x = filterMgr->x();
+    const int y = filterMgr->y();
+    const int w = filterMgr->getWidth();
+    const int rowLen = w+2;
+    const bool tiledX = (int(tiledMode) & int(TiledMode::X_AXIS));
+    const bool tiledY = (int(tiledMode) & int(TiledMode::Y_AXIS));
+
+    if (opaque.size() < size_t(3*rowLen))
+      opaque.resize(3*rowLen);
+    if (masks.size() < size_t(w))
+      masks.resize(w);
+
+    // Opaque pixels of the 3 rows from x-1 to x+w (including the
+    // neighbors outside the image, wrapped or clamped as in
+    // get_neighboring_pixels())
+    for (int dy=0; dy<3; ++dy) {
+      const int v = get_neighboring_coord(y-1+dy, src->height(), tiledY);
+      auto row = (const pixel_t*)src->getPixelAddress(0, v);
+      uint8_t* dst = &opaque[dy*rowLen];
+
+      dst[0] = isOpaque(row[get_neighboring_coord(x-1, src->width(), tiledX)]);
+      get_opaque_pixels(row+x, w, isOpaque, dst+1);
+      dst[w+1] = isOpaque(row[get_neighboring_coord(x+w, src->width(), tiledX)]);
+    }
 
-    void operator()(IndexedTraits::pixel_t color) {
-      color_t rgba = pal->getEntry(color);
-      if (rgba_geta(rgba) == 0 || color == bgColor)
-        transparent += (matrix & bit ? 1: 0);
-      else
-        opaque += (matrix & bit ? 1: 0);
-      bit <<= 1;
+    // Combine the columns of 3 pixels to get the mask of each pixel
+    const uint8_t* r0 = &opaque[0];
+    const uint8_t* r1 = r0 + rowLen;
+    const uint8_t* r2 = r1 + rowLen;
+    auto column = [r0, r1, r2](const int u) -> int {
+      return r0[u] | (r1[u] << 3) | (r2[u] << 6);
+    };
+
+    int c0 = column(0);
+    int c1 = column(1);
+    for (int u=0; u<w; ++u) {
+      const int c2 = column(u+2);
+      masks[u] = c0 | (c1 << 1) | (c2 << 2);
+      c0 = c1;
+      c1 = c2;
     }
-  };
+    return &masks[0];
+  }
+
+  // Returns the number of pixels in the matrix that are opaque (for
+  // the Outside place) or transparent (for Inside place), but only
+  // != 0 is important.
+  inline int count_neighbors(const int mask,
+                             const OutlineFilter::Matrix matrix,
+                             const OutlineFilter::Place place)
+  {
+    return (place == OutlineFilter::Place::Outside ? mask: ~mask) & int(matrix);
+  }
 
 }
 
@@ -97,20 +184,17 @@ const char* OutlineFilter::getName()
 
 void OutlineFilter::applyToRgba(FilterManager* filterMgr)
 {
-  const Image* src = filterMgr->getSourceImage();
   int r, g, b, a, n;
   color_t c;
   bool isTransparent;
 
-  GetPixelsDelegateRgba delegate;
-  delegate.init(m_bgColor, m_matrix);
+  const uint16_t* masks = get_neighbors_masks<RgbTraits>(
+    filterMgr, m_tiledMode, IsOpaqueRgba{ m_bgColor });
+  const int x0 = filterMgr->x();
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t) {
-    delegate.reset();
-    get_neighboring_pixels<RgbTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
-
     c = *src_address;
-    n = (m_place == Place::Outside ? delegate.opaque: delegate.transparent);
+    n = count_neighbors(masks[x-x0], m_matrix, m_place);
     isTransparent = (rgba_geta(c) == 0 || c == m_bgColor);
 
     if ((n >= 1) &&
@@ -130,20 +214,17 @@ void OutlineFilter::applyToRgba(FilterManager* filterMgr)
 
 void OutlineFilter::applyToGrayscale(FilterManager* filterMgr)
 {
-  const Image* src = filterMgr->getSourceImage();
   int k, a, n;
   color_t c;
   bool isTransparent;
 
-  GetPixelsDelegateGrayscale delegate;
-  delegate.init(m_bgColor, m_matrix);
+  const uint16_t* masks = get_neighbors_masks<GrayscaleTraits>(
+    filterMgr, m_tiledMode, IsOpaqueGrayscale{ m_bgColor });
+  const int x0 = filterMgr->x();
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t) {
-    delegate.reset();
-    get_neighboring_pixels<GrayscaleTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
-
     c = *src_address;
-    n = (m_place == Place::Outside ? delegate.opaque: delegate.transparent);
+    n = count_neighbors(masks[x-x0], m_matrix, m_place);
     isTransparent = (graya_geta(c) == 0 || c == m_bgColor);
 
     if ((n >= 1) &&
@@ -161,22 +242,19 @@ void OutlineFilter::applyToGrayscale(FilterManager* filterMgr)
 
 void OutlineFilter::applyToIndexed(FilterManager* filterMgr)
 {
-  const Image* src = filterMgr->getSourceImage();
   const Palette* pal = filterMgr->getIndexedData()->getPalette();
   const RgbMap* rgbmap = filterMgr->getIndexedData()->getRgbMap();
   int r, g, b, a, n;
   color_t c;
   bool isTransparent;
 
-  GetPixelsDelegateIndexed delegate(pal);
-  delegate.init(m_bgColor, m_matrix);
+  const uint16_t* masks = get_neighbors_masks<IndexedTraits>(
+    filterMgr, m_tiledMode, IsOpaqueIndexed{ m_bgColor, pal });
+  const int x0 = filterMgr->x();
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t) {
-    delegate.reset();
-    get_neighboring_pixels<IndexedTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
-
     c = *src_address;
-    n = (m_place == Place::Outside ? delegate.opaque: delegate.transparent);
+    n = count_neighbors(masks[x-x0], m_matrix, m_place);
 
     if (target & TARGET_INDEX_CHANNEL) {
       isTransparent = (c == m_bgColor);
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,7 @@
 
 #include "app/app.h"
 #include "app/cli/app_options.h"
+#include "app/cli/default_cli_delegate.h"
 #include "app/console.h"
 #include "app/resource_finder.h"
 #include "app/send_crash.h"
@@ -125,6 +126,19 @@ int app_main(int argc, char* argv[])
     MemLeak memleak;
     base::SystemConsole systemConsole;
     app::AppOptions options(argc, const_cast<const char**>(argv));
+
+    // --help and --version don't need to initialize anything else
+    // (the os::System, preferences, extensions, etc.), so we can
+    // answer them as fast as possible.
+    if (options.showHelp() || options.showVersion()) {
+      app::DefaultCliDelegate delegate;
+      if (options.showHelp())
+        delegate.showHelp(options);
+      else
+        delegate.showVersion();
+      return 0;
+    }
+
     os::SystemRef system(os::make_system());
     doc::Palette::initBestfit();
     app::App app;
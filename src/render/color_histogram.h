@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c)      2020 Igara Studio S.A.
+// Copyright (c) 2020-2024 Igara Studio S.A.
 // Copyright (c) 2001-2015 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,6 +9,7 @@
 #define RENDER_COLOR_HISTOGRAM_H_INCLUDED
 #pragma once
 
+#include <algorithm>
 #include <limits>
 #include <vector>
 
@@ -51,29 +52,48 @@ namespace render {
     // Add the specified "color" in the histogram as many times as the
     // specified value in "count".
     void addSamples(doc::color_t color, std::size_t count = 1) {
-      int i = histogramIndex(color);
-
-      if (m_histogram[i] < std::numeric_limits<std::size_t>::max()-count) // Avoid overflow
-        m_histogram[i] += count;
-      else
-        m_histogram[i] = std::numeric_limits<std::size_t>::max();
+      addCount(color, count);
 
       // Accurate colors are used only for less than 256 colors.  If the
       // image has more than 256 colors the m_histogram is used
       // instead.
-      if (m_useHighPrecision) {
-        std::vector<doc::color_t>::iterator it =
-          std::find(m_highPrecision.begin(), m_highPrecision.end(), color);
-
-        // The color is not in the high-precision table
-        if (it == m_highPrecision.end()) {
-          if (m_highPrecision.size() < 256) {
-            m_highPrecision.push_back(color);
-          }
-          else {
-            // In this case we reach the limit for the high-precision histogram.
-            m_useHighPrecision = false;
-          }
+      if (m_useHighPrecision)
+        addHighPrecisionColor(color);
+    }
+
+    // Same as addSamples() but without updating the high-precision
+    // table (e.g. for histograms that are merged later with
+    // addCounts()).
+    void addCount(doc::color_t color, std::size_t count = 1) {
+      addCountAt(histogramIndex(color), count);
+    }
+
+    // Adds the counts of "other" histogram to this one (the
+    // high-precision table of "other" is not used).
+    void addCounts(const ColorHistogram& other) {
+      for (std::size_t i=0; i<m_histogram.size(); ++i) {
+        if (other.m_histogram[i])
+          addCountAt(i, other.m_histogram[i]);
+      }
+    }
+
+    // Adds the given color to the high-precision table (if it's still
+    // being used).
+    void addHighPrecisionColor(doc::color_t color) {
+      if (!m_useHighPrecision)
+        return;
+
+      std::vector<doc::color_t>::iterator it =
+        std::find(m_highPrecision.begin(), m_highPrecision.end(), color);
+
+      // The color is not in the high-precision table
+      if (it == m_highPrecision.end()) {
+        if (m_highPrecision.size() < 256) {
+          m_highPrecision.push_back(color);
+        }
+        else {
+          // In this case we reach the limit for the high-precision histogram.
+          m_useHighPrecision = false;
         }
       }
     }
@@ -107,6 +127,13 @@ namespace render {
     int highPrecisionSize() { return m_highPrecision.size(); }
 
   private:
+    void addCountAt(std::size_t i, std::size_t count) {
+      if (m_histogram[i] < std::numeric_limits<std::size_t>::max()-count) // Avoid overflow
+        m_histogram[i] += count;
+      else
+        m_histogram[i] = std::numeric_limits<std::size_t>::max();
+    }
+
     // Converts input color in a index for the histogram. It reduces
     // each 8-bit component to the resolution given in the template
     // parameters.
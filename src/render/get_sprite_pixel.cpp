@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,9 +9,14 @@
 #include "config.h"
 #endif
 
+#include "render/get_sprite_pixel.h"
+
 #include "doc/doc.h"
 #include "gfx/clip.h"
 #include "render/render.h"
+#include "render/render_cache.h"
+
+#include <cmath>
 
 namespace render {
 
@@ -22,7 +27,8 @@ color_t get_sprite_pixel(const Sprite* sprite,
                          const double y,
                          const frame_t frame,
                          const Projection& proj,
-                         const bool newBlend)
+                         const bool newBlend,
+                         RenderCache* cache)
 {
   color_t color = 0;
 
@@ -34,9 +40,19 @@ color_t get_sprite_pixel(const Sprite* sprite,
     render.setNewBlend(newBlend);
     render.setRefLayersVisiblity(true);
     render.setProjection(proj);
+
+    double u = proj.applyX(x);
+    double v = proj.applyY(y);
+    if (cache) {
+      // The cached sprite can be used only in integer positions
+      render.setCache(cache);
+      u = std::floor(u);
+      v = std::floor(v);
+    }
+
     render.renderSprite(
       image.get(), sprite, frame,
-      gfx::ClipF(0, 0, proj.applyX(x), proj.applyY(y), 1, 1));
+      gfx::ClipF(0, 0, u, v, 1, 1));
 
     color = get_pixel(image.get(), 0, 0);
   }
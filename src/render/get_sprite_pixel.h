@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -19,16 +19,23 @@ namespace render {
   using namespace doc;
 
   class Projection;
+  class RenderCache;
 
   // Gets a pixel from the sprite in the specified position. If in the
   // specified coordinates there're background this routine will
   // return the 0 color (the mask-color).
+  //
+  // If "cache" is specified, the pixel is taken from the projected
+  // pixel position of the cached flattened sprite (useful to pick
+  // several pixels from the same frame without compositing all
+  // layers again).
   color_t get_sprite_pixel(const Sprite* sprite,
                            const double x,
                            const double y,
                            const frame_t frame,
                            const Projection& proj,
-                           const bool newBlend);
+                           const bool newBlend,
+                           RenderCache* cache = nullptr);
 
 } // namespace render
 
@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2020 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -16,6 +16,13 @@
 #include "doc/image_impl.h"
 #include "render/dithering_matrix.h"
 
+#include <cmath>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_WIN64)
+  #include <emmintrin.h>
+#endif
+
 namespace render {
 
 void render_rgba_gradient(
@@ -38,34 +45,18 @@ void render_rgba_gradient(
   }
 }
 
-void render_rgba_linear_gradient(
+namespace {
+
+// Renders the gradient row by row. "rowF" fills the "f" value
+// (0.0=c0, 1.0=c1) of each pixel of the given row.
+template<typename RowF>
+void render_rgba_gradient_rows(
   doc::Image* img,
-  const gfx::Point imgPos,
-  const gfx::Point p0,
-  const gfx::Point p1,
   doc::color_t c0,
   doc::color_t c1,
-  const render::DitheringMatrix& matrix)
+  const render::DitheringMatrix& matrix,
+  RowF rowF)
 {
-  ASSERT(img->pixelFormat() == doc::IMAGE_RGB);
-  if (img->pixelFormat() != doc::IMAGE_RGB) {
-    return;
-  }
-
-  // If there is no vector defining the gradient (just one point),
-  // the "gradient" will be just "c0"
-  if (p0 == p1) {
-    img->clear(c0);
-    return;
-  }
-
-  base::Vector2d<double>
-    u(p0.x, p0.y),
-    v(p1.x, p1.y), w;
-  w = v - u;
-  const double wmag = w.magnitude();
-  w = w.normalize();
-
   // As we use non-premultiplied RGB values, we need correct RGB
   // values on each stop. So in case that one color has alpha=0
   // (complete transparent), use the RGB values of the
@@ -89,18 +80,48 @@ void render_rgba_linear_gradient(
   const uint8_t b1 = doc::rgba_getb(c1);
   const uint8_t a1 = doc::rgba_geta(c1);
 
-  doc::LockImageBits<doc::RgbTraits> bits(img);
-  auto it = bits.begin();
   const int width = img->width();
   const int height = img->height();
+  std::vector<double> fs(width);
 
   if (matrix.rows() == 1 && matrix.cols() == 1) {
+#if defined(__x86_64__) || defined(_WIN64)
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d eps = _mm_set1_pd(1e-7);
+    const __m128d vr0 = _mm_set1_pd(r0), vdr = _mm_set1_pd(r1-r0);
+    const __m128d vg0 = _mm_set1_pd(g0), vdg = _mm_set1_pd(g1-g0);
+    const __m128d vb0 = _mm_set1_pd(b0), vdb = _mm_set1_pd(b1-b0);
+    const __m128d va0 = _mm_set1_pd(a0), vda = _mm_set1_pd(a1-a0);
+#endif
+
     for (int y=0; y<height; ++y) {
-      for (int x=0; x<width; ++x, ++it) {
-        base::Vector2d<double> q(imgPos.x+x,
-                                 imgPos.y+y);
-        q -= u;
-        double f = (q * w) / wmag;
+      rowF(y, fs.data());
+
+      auto dst = (doc::RgbTraits::address_t)img->getPixelAddress(0, y);
+      int x = 0;
+
+#if defined(__x86_64__) || defined(_WIN64)
+      // Two pixels at the same time, clamping "f" to [0, 1] gives
+      // exactly c0 and c1 outside the gradient.
+      for (; x+2<=width; x+=2, dst+=2) {
+        const __m128d f = _mm_max_pd(zero, _mm_min_pd(one, _mm_loadu_pd(&fs[x])));
+        const __m128i r = _mm_cvttpd_epi32(_mm_add_pd(_mm_add_pd(vr0, _mm_mul_pd(f, vdr)), eps));
+        const __m128i g = _mm_cvttpd_epi32(_mm_add_pd(_mm_add_pd(vg0, _mm_mul_pd(f, vdg)), eps));
+        const __m128i b = _mm_cvttpd_epi32(_mm_add_pd(_mm_add_pd(vb0, _mm_mul_pd(f, vdb)), eps));
+        const __m128i a = _mm_cvttpd_epi32(_mm_add_pd(_mm_add_pd(va0, _mm_mul_pd(f, vda)), eps));
+        const __m128i c =
+          _mm_or_si128(
+            _mm_or_si128(_mm_slli_epi32(r, doc::rgba_r_shift),
+                         _mm_slli_epi32(g, doc::rgba_g_shift)),
+            _mm_or_si128(_mm_slli_epi32(b, doc::rgba_b_shift),
+                         _mm_slli_epi32(a, doc::rgba_a_shift)));
+        _mm_storel_epi64((__m128i*)dst, c);
+      }
+#endif
+
+      for (; x<width; ++x, ++dst) {
+        const double f = fs[x];
 
         doc::color_t c;
         if (f < 0.0) c = c0;
@@ -112,24 +133,91 @@ void render_rgba_linear_gradient(
                         int(a0 + f*(a1-a0) + 1e-7));
         }
 
-        *it = c;
+        *dst = c;
       }
     }
   }
   else {
+    // One row of the dithering matrix is repeated horizontally on
+    // the whole row of the image.
+    const int cols = matrix.cols();
+    const double maxValue = matrix.maxValue()+2;
+    std::vector<int> thresholds(cols);
+
     for (int y=0; y<height; ++y) {
-      for (int x=0; x<width; ++x, ++it) {
-        base::Vector2d<double> q(imgPos.x+x,
-                                 imgPos.y+y);
-        q -= u;
-        double f = (q * w) / wmag;
+      rowF(y, fs.data());
 
-        *it = (f*(matrix.maxValue()+2) < matrix(y, x)+1 ? c0: c1);
+      for (int i=0; i<cols; ++i)
+        thresholds[i] = matrix(y, i)+1;
+
+      auto dst = (doc::RgbTraits::address_t)img->getPixelAddress(0, y);
+      for (int x=0, i=0; x<width; ++x, ++dst) {
+        *dst = (fs[x]*maxValue < thresholds[i] ? c0: c1);
+        if (++i == cols)
+          i = 0;
       }
     }
   }
 }
 
+} // anonymous namespace
+
+void render_rgba_linear_gradient(
+  doc::Image* img,
+  const gfx::Point imgPos,
+  const gfx::Point p0,
+  const gfx::Point p1,
+  doc::color_t c0,
+  doc::color_t c1,
+  const render::DitheringMatrix& matrix)
+{
+  ASSERT(img->pixelFormat() == doc::IMAGE_RGB);
+  if (img->pixelFormat() != doc::IMAGE_RGB) {
+    return;
+  }
+
+  // If there is no vector defining the gradient (just one point),
+  // the "gradient" will be just "c0"
+  if (p0 == p1) {
+    img->clear(c0);
+    return;
+  }
+
+  base::Vector2d<double>
+    u(p0.x, p0.y),
+    v(p1.x, p1.y), w;
+  w = v - u;
+  const double wmag = w.magnitude();
+  w = w.normalize();
+
+  // f = ((q-u) * w) / wmag, the y term is the same for the whole
+  // row and x is incremented by one on each pixel.
+  const int width = img->width();
+  render_rgba_gradient_rows(
+    img, c0, c1, matrix,
+    [&](const int y, double* fs){
+      const double qy = double(imgPos.y+y) - u.y;
+      const double fy = qy * w.y;
+      int x = 0;
+#if defined(__x86_64__) || defined(_WIN64)
+      const __m128d vfy = _mm_set1_pd(fy);
+      const __m128d vux = _mm_set1_pd(u.x);
+      const __m128d vwx = _mm_set1_pd(w.x);
+      const __m128d vwmag = _mm_set1_pd(wmag);
+      const __m128d two = _mm_set1_pd(2.0);
+      __m128d qx = _mm_set_pd(imgPos.x+1, imgPos.x);
+      for (; x+2<=width; x+=2) {
+        _mm_storeu_pd(fs+x, _mm_div_pd(_mm_add_pd(_mm_mul_pd(_mm_sub_pd(qx, vux), vwx), vfy), vwmag));
+        qx = _mm_add_pd(qx, two);
+      }
+#endif
+      for (; x<width; ++x) {
+        const double qx = double(imgPos.x+x) - u.x;
+        fs[x] = (qx*w.x + fy) / wmag;
+      }
+    });
+}
+
 void render_rgba_radial_gradient(
   doc::Image* img,
   const gfx::Point imgPos,
@@ -157,72 +245,35 @@ void render_rgba_radial_gradient(
     return;
   }
 
-  // As we use non-premultiplied RGB values, we need correct RGB
-  // values on each stop. So in case that one color has alpha=0
-  // (complete transparent), use the RGB values of the
-  // non-transparent color in the other stop point.
-  if (doc::rgba_geta(c0) == 0 &&
-      doc::rgba_geta(c1) != 0) {
-    c0 = (c1 & doc::rgba_rgb_mask);
-  }
-  else if (doc::rgba_geta(c0) != 0 &&
-           doc::rgba_geta(c1) == 0) {
-    c1 = (c0 & doc::rgba_rgb_mask);
-  }
+  const base::Vector2d<double> center = (u+v)/2;
+  const double wx = std::fabs(w.x);
+  const double wy = std::fabs(w.y);
 
-  const uint8_t r0 = doc::rgba_getr(c0);
-  const uint8_t g0 = doc::rgba_getg(c0);
-  const uint8_t b0 = doc::rgba_getb(c0);
-  const uint8_t a0 = doc::rgba_geta(c0);
-
-  const uint8_t r1 = doc::rgba_getr(c1);
-  const uint8_t g1 = doc::rgba_getg(c1);
-  const uint8_t b1 = doc::rgba_getb(c1);
-  const uint8_t a1 = doc::rgba_geta(c1);
-
-  doc::LockImageBits<doc::RgbTraits> bits(img);
-  auto it = bits.begin();
+  // f = |(q-center) / w|, the y term is the same for the whole row.
   const int width = img->width();
-  const int height = img->height();
-
-  if (matrix.rows() == 1 && matrix.cols() == 1) {
-    for (int y=0; y<height; ++y) {
-      for (int x=0; x<width; ++x, ++it) {
-        base::Vector2d<double> q(imgPos.x+x,
-                                 imgPos.y+y);
-        q -= (u+v)/2;
-        q.x /= std::fabs(w.x);
-        q.y /= std::fabs(w.y);
-        double f = std::sqrt(q.x*q.x + q.y*q.y);
-
-        doc::color_t c;
-        if (f < 0.0) c = c0;
-        else if (f > 1.0) c = c1;
-        else {
-          c = doc::rgba(int(r0 + f*(r1-r0) + 1e-7),
-                        int(g0 + f*(g1-g0) + 1e-7),
-                        int(b0 + f*(b1-b0) + 1e-7),
-                        int(a0 + f*(a1-a0) + 1e-7));
-        }
-
-        *it = c;
+  render_rgba_gradient_rows(
+    img, c0, c1, matrix,
+    [&](const int y, double* fs){
+      const double qy = (double(imgPos.y+y) - center.y) / wy;
+      const double qy2 = qy*qy;
+      int x = 0;
+#if defined(__x86_64__) || defined(_WIN64)
+      const __m128d vqy2 = _mm_set1_pd(qy2);
+      const __m128d vcx = _mm_set1_pd(center.x);
+      const __m128d vwx = _mm_set1_pd(wx);
+      const __m128d two = _mm_set1_pd(2.0);
+      __m128d px = _mm_set_pd(imgPos.x+1, imgPos.x);
+      for (; x+2<=width; x+=2) {
+        const __m128d qx = _mm_div_pd(_mm_sub_pd(px, vcx), vwx);
+        _mm_storeu_pd(fs+x, _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(qx, qx), vqy2)));
+        px = _mm_add_pd(px, two);
       }
-    }
-  }
-  else {
-    for (int y=0; y<height; ++y) {
-      for (int x=0; x<width; ++x, ++it) {
-        base::Vector2d<double> q(imgPos.x+x,
-                                 imgPos.y+y);
-        q -= (u+v)/2;
-        q.x /= std::fabs(w.x);
-        q.y /= std::fabs(w.y);
-        double f = std::sqrt(q.x*q.x + q.y*q.y);
-
-        *it = (f*(matrix.maxValue()+2) < matrix(y, x)+1 ? c0: c1);
+#endif
+      for (; x<width; ++x) {
+        const double qx = (double(imgPos.x+x) - center.x) / wx;
+        fs[x] = std::sqrt(qx*qx + qy2);
       }
-    }
-  }
+    });
 }
 
 template<typename ImageTraits>
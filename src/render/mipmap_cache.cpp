@@ -0,0 +1,130 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "render/mipmap_cache.h"
+
+#include "doc/image.h"
+#include "doc/image_traits.h"
+#include "doc/primitives_fast.h"
+
+#include <algorithm>
+
+namespace render {
+
+using namespace doc;
+
+MipmapCache::MipmapCache(const std::size_t maxBytes,
+                         const int minPixels)
+  : m_maxBytes(maxBytes)
+  , m_minPixels(minPixels)
+{
+}
+
+void MipmapCache::clear()
+{
+  const std::lock_guard lock(m_mutex);
+  m_entries.clear();
+  m_bytes = 0;
+}
+
+ImageRef MipmapCache::get(const Image* image, const int level)
+{
+  if (level < 1 ||
+      image->pixelFormat() != IMAGE_RGB ||
+      image->width() * image->height() < m_minPixels)
+    return nullptr;
+
+  // Look for the requested level or the nearest lower level to
+  // generate it
+  ImageRef base;
+  int baseLevel = 0;
+  {
+    const std::lock_guard lock(m_mutex);
+    for (auto it=m_entries.begin(); it!=m_entries.end(); ) {
+      if (it->imageId != image->id()) {
+        ++it;
+        continue;
+      }
+      // Remove the levels of previous versions of the image
+      if (it->imageVersion != image->version()) {
+        m_bytes -= it->image->getMemSize();
+        it = m_entries.erase(it);
+        continue;
+      }
+      if (it->level == level) {
+        m_entries.splice(m_entries.begin(), m_entries, it);
+        return m_entries.front().image;
+      }
+      if (it->level < level && it->level > baseLevel) {
+        base = it->image;
+        baseLevel = it->level;
+      }
+      ++it;
+    }
+  }
+
+  // The level is generated without locking the cache, so other
+  // threads can use other levels in the meantime (two threads could
+  // generate the same level, but the result is the same)
+  ImageRef mipmap = make_mipmap(base ? base.get(): image,
+                                1 << (level - baseLevel));
+
+  const std::lock_guard lock(m_mutex);
+  m_entries.push_front(Entry{ image->id(), image->version(), level, mipmap });
+  m_bytes += mipmap->getMemSize();
+  while (m_bytes > m_maxBytes && m_entries.size() > 1) {
+    m_bytes -= m_entries.back().image->getMemSize();
+    m_entries.pop_back();
+  }
+  return mipmap;
+}
+
+ImageRef make_mipmap(const Image* src, const int factor)
+{
+  ASSERT(src->pixelFormat() == IMAGE_RGB);
+  ASSERT(factor >= 1);
+
+  const int w = (src->width() + factor - 1) / factor;
+  const int h = (src->height() + factor - 1) / factor;
+  ImageRef dst(Image::create(IMAGE_RGB, w, h));
+  const color_t maskColor = src->maskColor();
+
+  for (int y=0; y<h; ++y) {
+    const int sy0 = y*factor;
+    const int sy1 = std::min(sy0 + factor, src->height());
+    auto dstPtr = get_pixel_address_fast<RgbTraits>(dst.get(), 0, y);
+
+    for (int x=0; x<w; ++x, ++dstPtr) {
+      const int sx0 = x*factor;
+      const int sx1 = std::min(sx0 + factor, src->width());
+      uint32_t r = 0, g = 0, b = 0, a = 0, n = 0;
+
+      for (int v=sy0; v<sy1; ++v) {
+        auto srcPtr = get_pixel_address_fast<RgbTraits>(src, sx0, v);
+        for (int u=sx0; u<sx1; ++u, ++srcPtr) {
+          const color_t c = *srcPtr;
+          ++n;
+          if (c == maskColor)
+            continue;
+          const int ca = rgba_geta(c);
+          r += rgba_getr(c) * ca;
+          g += rgba_getg(c) * ca;
+          b += rgba_getb(c) * ca;
+          a += ca;
+        }
+      }
+
+      *dstPtr = (a == 0 ? 0: rgba(r / a, g / a, b / a, a / n));
+    }
+  }
+  return dst;
+}
+
+} // namespace render
@@ -0,0 +1,61 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef RENDER_MIPMAP_CACHE_H_INCLUDED
+#define RENDER_MIPMAP_CACHE_H_INCLUDED
+#pragma once
+
+#include "doc/image_ref.h"
+#include "doc/object_id.h"
+#include "doc/object_version.h"
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+
+namespace render {
+
+  // Cache of downscaled versions (mipmap levels) of RGB images, used
+  // to render them zoomed out with the box filter without averaging
+  // all the pixels of the original image on each render. Each level
+  // is generated the first time it's requested (from the nearest
+  // cached lower level), and it's valid while the version of the
+  // original image is the same.
+  class MipmapCache {
+  public:
+    MipmapCache(const std::size_t maxBytes = 256*1024*1024,
+                const int minPixels = 128*128);
+
+    void clear();
+
+    // Returns the given image scaled down 2^level times with a box
+    // filter (with premultiplied alpha). Returns nullptr if the image
+    // cannot be cached (it's too small or it's not an RGB image).
+    doc::ImageRef get(const doc::Image* image, const int level);
+
+  private:
+    struct Entry {
+      doc::ObjectId imageId;
+      doc::ObjectVersion imageVersion;
+      int level;
+      doc::ImageRef image;
+    };
+
+    const std::size_t m_maxBytes;
+    const int m_minPixels;
+    std::mutex m_mutex;
+    // Most recently used entries first
+    std::list<Entry> m_entries;
+    std::size_t m_bytes = 0;
+  };
+
+  // Creates a copy of the given RGB image scaled down "factor" times
+  // averaging each block of factor x factor pixels.
+  doc::ImageRef make_mipmap(const doc::Image* src, const int factor);
+
+} // namespace render
+
+#endif
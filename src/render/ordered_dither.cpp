@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2022  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -40,6 +40,38 @@ static int colorDistance(int r1, int g1, int b1, int a1,
   return result;
 }
 
+OrderedDitherCache::OrderedDitherCache()
+  : m_entries(1 << kBits)
+{
+}
+
+OrderedDitherCache::Entry& OrderedDitherCache::get(
+  const doc::color_t color,
+  const DitheringMatrix& matrix,
+  const doc::RgbMap* rgbmap,
+  const doc::Palette* palette,
+  bool& found)
+{
+  // Discard all entries if the palette or matrix are different
+  if (m_rgbmap != rgbmap ||
+      m_palette != palette ||
+      m_paletteModifications != palette->getModifications() ||
+      m_maxValue != matrix.maxValue()) {
+    for (Entry& entry : m_entries)
+      entry.index1 = -1;
+    m_rgbmap = rgbmap;
+    m_palette = palette;
+    m_paletteModifications = palette->getModifications();
+    m_maxValue = matrix.maxValue();
+  }
+
+  Entry& entry = m_entries[(uint32_t(color) * 2654435761u) >> (32 - kBits)];
+  found = (entry.index1 >= 0 && entry.color == color);
+  if (!found)
+    entry.color = color;
+  return entry;
+}
+
 OrderedDither::OrderedDither(int transparentIndex)
   : m_transparentIndex(transparentIndex)
 {
@@ -58,6 +90,25 @@ doc::color_t OrderedDither::ditherRgbPixelToIndex(
       doc::rgba_geta(color) == 0)
     return m_transparentIndex;
 
+  bool found;
+  OrderedDitherCache::Entry& entry =
+    m_cache.get(color, matrix, rgbmap, palette, found);
+  if (!found)
+    calcEntry(matrix, color, rgbmap, palette, entry);
+
+  // If d > threshold, it means that we're closer to 'nearest2rgb'
+  // than to 'nearest1rgb'.
+  return (matrix(y, x) < entry.mix ? entry.index2:
+                                     entry.index1);
+}
+
+void OrderedDither::calcEntry(
+  const DitheringMatrix& matrix,
+  const doc::color_t color,
+  const doc::RgbMap* rgbmap,
+  const doc::Palette* palette,
+  OrderedDitherCache::Entry& entry) const
+{
   // Get the nearest color in the palette with the given RGB
   // values.
   int r = doc::rgba_getr(color);
@@ -90,10 +141,14 @@ doc::color_t OrderedDither::ditherRgbPixelToIndex(
     (rgbmap ? rgbmap->mapColor(r2, g2, b2, a2):
               palette->findBestfit(r2, g2, b2, a2, m_transparentIndex));
 
+  entry.index1 = nearest1idx;
+  entry.index2 = nearest2idx;
+  entry.mix = 0;
+
   // If both possible RGB colors use the same index, we cannot
   // make any dither with these two colors.
   if (nearest1idx == nearest2idx)
-    return nearest1idx;
+    return;
 
   doc::color_t nearest2rgb = palette->getEntry(nearest2idx);
   r2 = doc::rgba_getr(nearest2rgb);
@@ -107,16 +162,11 @@ doc::color_t OrderedDither::ditherRgbPixelToIndex(
   int d = colorDistance(r1, g1, b1, a1, r, g, b, a);
   int D = colorDistance(r1, g1, b1, a1, r2, g2, b2, a2);
   if (D == 0)
-    return nearest1idx;
+    return;
 
   // We convert the d/D factor to the matrix range to compare it
-  // with the threshold. If d > threshold, it means that we're
-  // closer to 'nearest2rgb' than to 'nearest1rgb'.
-  d = matrix.maxValue() * d / D;
-  int threshold = matrix(y, x);
-
-  return (d > threshold ? nearest2idx:
-                          nearest1idx);
+  // with the threshold.
+  entry.mix = matrix.maxValue() * d / D;
 }
 
 OrderedDither2::OrderedDither2(int transparentIndex)
@@ -129,7 +179,8 @@ OrderedDither2::OrderedDither2(int transparentIndex)
 // color.
 //
 // TODO it's too slow for big color palettes:
-//      O(W*H*P) where P is the number of palette entries
+//      O(C*P) where C is the number of different colors in the
+//      image and P is the number of palette entries
 //
 // Some ideas from:
 // http://bisqwit.iki.fi/story/howto/dither/jy/
@@ -148,6 +199,25 @@ doc::color_t OrderedDither2::ditherRgbPixelToIndex(
     return m_transparentIndex;
   }
 
+  bool found;
+  OrderedDitherCache::Entry& entry =
+    m_cache.get(color, matrix, rgbmap, palette, found);
+  if (!found)
+    calcEntry(matrix, color, rgbmap, palette, entry);
+
+  // Using the bestMix factor the dithering matrix tells us if we
+  // should paint with altIndex or index in this x,y position.
+  return (matrix(y, x) < entry.mix ? entry.index2:
+                                     entry.index1);
+}
+
+void OrderedDither2::calcEntry(
+  const DitheringMatrix& matrix,
+  const doc::color_t color,
+  const doc::RgbMap* rgbmap,
+  const doc::Palette* palette,
+  OrderedDitherCache::Entry& entry) const
+{
   // Get RGBA values
   const int r = doc::rgba_getr(color);
   const int g = doc::rgba_getg(color);
@@ -219,12 +289,9 @@ doc::color_t OrderedDither2::ditherRgbPixelToIndex(
     }
   }
 
-  // Using the bestMix factor the dithering matrix tells us if we
-  // should paint with altIndex or index in this x,y position.
-  if (altIndex >= 0 && matrix(y, x) < bestMix)
-    return altIndex;
-  else
-    return index;
+  entry.index1 = index;
+  entry.index2 = (altIndex >= 0 ? altIndex: index);
+  entry.mix = bestMix;
 }
 
 void dither_rgb_image_to_indexed(
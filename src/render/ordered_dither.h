@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -17,6 +17,8 @@
 #include "gfx/size.h"
 #include "render/task_delegate.h"
 
+#include <vector>
+
 namespace render {
 
   class Dithering;
@@ -49,6 +51,39 @@ namespace render {
       const doc::Palette* palette) { return 0; }
   };
 
+  // Cache of the ordered dithering of each RGBA color. The result of
+  // the (slow) search in the palette is always two indexes and a mix
+  // factor, then the threshold of the matrix in each pixel position
+  // selects one of those indexes. The cache is valid for the same
+  // palette/rgbmap and matrix maximum value.
+  class OrderedDitherCache {
+  public:
+    struct Entry {
+      doc::color_t color = 0;
+      int index1 = -1;
+      int index2 = -1;
+      int mix = 0;
+    };
+
+    OrderedDitherCache();
+
+    // Returns the entry for the given color, "found" is false if
+    // the entry must be calculated (and filled by the caller).
+    Entry& get(const doc::color_t color,
+               const DitheringMatrix& matrix,
+               const doc::RgbMap* rgbmap,
+               const doc::Palette* palette,
+               bool& found);
+
+  private:
+    static constexpr int kBits = 12;
+    std::vector<Entry> m_entries;
+    const doc::RgbMap* m_rgbmap = nullptr;
+    const doc::Palette* m_palette = nullptr;
+    int m_paletteModifications = 0;
+    int m_maxValue = 0;
+  };
+
   class OrderedDither : public DitheringAlgorithmBase {
   public:
     OrderedDither(int transparentIndex = -1);
@@ -60,7 +95,15 @@ namespace render {
       const doc::RgbMap* rgbmap,
       const doc::Palette* palette) override;
   private:
+    void calcEntry(
+      const DitheringMatrix& matrix,
+      const doc::color_t color,
+      const doc::RgbMap* rgbmap,
+      const doc::Palette* palette,
+      OrderedDitherCache::Entry& entry) const;
+
     int m_transparentIndex;
+    OrderedDitherCache m_cache;
   };
 
   class OrderedDither2 : public DitheringAlgorithmBase {
@@ -74,7 +117,15 @@ namespace render {
       const doc::RgbMap* rgbmap,
       const doc::Palette* palette) override;
   private:
+    void calcEntry(
+      const DitheringMatrix& matrix,
+      const doc::color_t color,
+      const doc::RgbMap* rgbmap,
+      const doc::Palette* palette,
+      OrderedDitherCache::Entry& entry) const;
+
     int m_transparentIndex;
+    OrderedDitherCache m_cache;
   };
 
   void dither_rgb_image_to_indexed(
@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2022  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 // Copyright (c) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -18,6 +18,7 @@
 #include "doc/primitives.h"
 #include "doc/remap.h"
 #include "doc/sprite.h"
+#include "doc/task_scheduler.h"
 #include "render/dithering.h"
 #include "render/error_diffusion.h"
 #include "render/ordered_dither.h"
@@ -139,6 +140,34 @@ Palette* create_palette_from_sprite(
   return palette;
 }
 
+namespace {
+
+// Small direct-mapped cache of RGBA colors already converted to
+// palette indexes. Images (specially pixel art) use a few colors, so
+// most pixels hit the cache and we avoid the RgbMap/palette search.
+class IndexCache {
+public:
+  IndexCache() : m_colors(kSize, 0), m_indexes(kSize, -1) { }
+
+  template<typename MapFunc>
+  int map(const color_t c, MapFunc&& mapFunc) {
+    const uint32_t i = (uint32_t(c) * 2654435761u) >> (32 - kBits);
+    if (m_indexes[i] < 0 || m_colors[i] != c) {
+      m_colors[i] = c;
+      m_indexes[i] = mapFunc(c);
+    }
+    return m_indexes[i];
+  }
+
+private:
+  static constexpr int kBits = 10;
+  static constexpr int kSize = 1 << kBits;
+  std::vector<color_t> m_colors;
+  std::vector<int> m_indexes;
+};
+
+} // anonymous namespace
+
 Image* convert_pixel_format(
   const Image* image,
   Image* new_image,
@@ -220,29 +249,33 @@ Image* convert_pixel_format(
 
         // RGB -> Indexed
         case IMAGE_INDEXED: {
-          LockImageBits<IndexedTraits> dstBits(new_image, Image::WriteLock);
-          auto dst_it = dstBits.begin();
-#ifdef _DEBUG
-          auto dst_end = dstBits.end();
-#endif
-
-          for (; src_it != src_end; ++src_it, ++dst_it) {
-            ASSERT(dst_it != dst_end);
-            c = *src_it;
-
-            r = rgba_getr(c);
-            g = rgba_getg(c);
-            b = rgba_getb(c);
-            a = rgba_geta(c);
-
-            if (a == 0)
-              *dst_it = (new_mask_color == -1? 0 : new_mask_color);
-            else if (rgbmap)
-              *dst_it = rgbmap->mapColor(c);
-            else
-              *dst_it = palette->findBestfit(r, g, b, a, new_mask_color);
+          const int w = image->width();
+          const int maskIndex = (new_mask_color == -1 ? 0: new_mask_color);
+          IndexCache cache;
+
+          for (int y=0; y<image->height(); ++y) {
+            auto src = (const color_t*)image->getPixelAddress(0, y);
+            auto dst = (uint8_t*)new_image->getPixelAddress(0, y);
+            for (int x=0; x<w; ++x) {
+              c = src[x];
+              if (rgba_geta(c) == 0)
+                dst[x] = maskIndex;
+              // Reuse the previous index for runs of the same color
+              else if (x > 0 && c == src[x-1])
+                dst[x] = dst[x-1];
+              else if (rgbmap)
+                dst[x] = cache.map(c, [rgbmap](color_t c){
+                  return rgbmap->mapColor(c);
+                });
+              else
+                dst[x] = cache.map(c, [palette, new_mask_color](color_t c){
+                  return palette->findBestfit(rgba_getr(c),
+                                              rgba_getg(c),
+                                              rgba_getb(c),
+                                              rgba_geta(c), new_mask_color);
+                });
+            }
           }
-          ASSERT(dst_it == dst_end);
           break;
         }
       }
@@ -402,6 +435,14 @@ Image* convert_pixel_format(
 // Creation of optimized palette for RGB images
 // by David Capello
 
+// Minimum number of pixels of an image to build its histogram using
+// several threads.
+static constexpr int kMinPixelsToFeedInParallel = 256*256;
+
+// Maximum number of threads used to build the histogram (each thread
+// needs its own histogram of 16MB).
+static constexpr int kMaxThreadHistograms = 8;
+
 void PaletteOptimizer::feedWithImage(const Image* image,
                                      const bool withAlpha)
 {
@@ -421,7 +462,11 @@ void PaletteOptimizer::feedWithImage(const Image* image,
   switch (image->pixelFormat()) {
 
     case IMAGE_RGB:
-      {
+      if (bounds.w * bounds.h >= kMinPixelsToFeedInParallel &&
+          task_scheduler_threads() >= 2) {
+        feedWithRgbImageInParallel(image, bounds, withAlpha);
+      }
+      else {
         const LockImageBits<RgbTraits> bits(image, bounds);
         auto it = bits.begin(), end = bits.end();
 
@@ -465,6 +510,66 @@ void PaletteOptimizer::feedWithImage(const Image* image,
   }
 }
 
+// Each thread counts the colors of a band of rows in its own
+// histogram. The high-precision table is updated from this thread
+// with the new colors found by each thread in the order of the bands,
+// so the result is the same as feeding the image from one thread.
+void PaletteOptimizer::feedWithRgbImageInParallel(const Image* image,
+                                                  const gfx::Rect& imageBounds,
+                                                  const bool withAlpha)
+{
+  const gfx::Rect bounds = (imageBounds & image->bounds());
+  const int nbands =
+    std::clamp<int>(task_scheduler_threads(), 1, kMaxThreadHistograms);
+  while (int(m_threadHistograms.size()) < nbands)
+    m_threadHistograms.push_back(std::make_unique<Histogram>());
+
+  const bool highPrecision = m_histogram.isHighPrecision();
+  std::vector<std::vector<color_t>> bandColors(nbands);
+  TaskGroup group;
+  for (int band=0; band<nbands; ++band) {
+    const int y1 = bounds.y + bounds.h * band / nbands;
+    const int y2 = bounds.y + bounds.h * (band+1) / nbands;
+
+    group.run(
+      [&, band, y1, y2]{
+        Histogram& histogram = *m_threadHistograms[band];
+        std::vector<color_t>& colors = bandColors[band];
+        bool trackColors = highPrecision;
+
+        for (int y=y1; y<y2; ++y) {
+          auto it = (const color_t*)image->getPixelAddress(bounds.x, y);
+          for (int x=0; x<bounds.w; ++x, ++it) {
+            color_t color = *it;
+            if (rgba_geta(color) == 0)
+              continue;
+
+            if (!withAlpha)
+              color |= rgba(0, 0, 0, 255);
+
+            histogram.addCount(color, 1);
+
+            // More than 256 colors in this band means that the
+            // high-precision table will not be used anyway.
+            if (trackColors &&
+                std::find(colors.begin(), colors.end(), color) == colors.end()) {
+              colors.push_back(color);
+              if (colors.size() > 256)
+                trackColors = false;
+            }
+          }
+        }
+      });
+  }
+  group.wait();
+
+  if (highPrecision) {
+    for (const auto& colors : bandColors)
+      for (const color_t color : colors)
+        m_histogram.addHighPrecisionColor(color);
+  }
+}
+
 void PaletteOptimizer::feedWithRgbaColor(color_t color)
 {
   m_histogram.addSamples(color, 1);
@@ -482,6 +587,11 @@ void PaletteOptimizer::calculate(Palette* palette, int maskIndex)
   else
     addMask = false;
 
+  // Add the colors counted by other threads
+  for (const auto& histogram : m_threadHistograms)
+    m_histogram.addCounts(*histogram);
+  m_threadHistograms.clear();
+
   // If the sprite has a background layer, the first entry can be
   // used, in other case the 0 indexed will be the mask color, so it
   // will not be used later in the color conversion (from RGB to
@@ -1,5 +1,5 @@
 // Aseprite Rener Library
-// Copyright (c) 2019-2021  Igara Studio S.A.
+// Copyright (c) 2019-2024  Igara Studio S.A.
 // Copyright (c) 2001-2017  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -14,6 +14,7 @@
 #include "doc/rgbmap_algorithm.h"
 #include "render/color_histogram.h"
 
+#include <memory>
 #include <vector>
 
 namespace doc {
@@ -40,8 +41,18 @@ namespace render {
     int highPrecisionSize() { return m_histogram.highPrecisionSize(); }
 
   private:
-    render::ColorHistogram<5, 6, 5, 5> m_histogram;
+    using Histogram = render::ColorHistogram<5, 6, 5, 5>;
+
+    void feedWithRgbImageInParallel(const doc::Image* image,
+                                    const gfx::Rect& bounds,
+                                    const bool withAlpha);
+
+    Histogram m_histogram;
     bool m_withAlpha = false;
+
+    // Histograms used by each thread to feed big RGB images in
+    // parallel, they are added to m_histogram in calculate().
+    std::vector<std::unique_ptr<Histogram>> m_threadHistograms;
   };
 
   // Creates a new palette suitable to quantize the given RGB sprite to Indexed color.
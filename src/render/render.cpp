@@ -18,15 +18,28 @@
 #include "doc/layer_tilemap.h"
 #include "doc/playback.h"
 #include "doc/render_plan.h"
+#include "doc/task_scheduler.h"
 #include "doc/tileset.h"
 #include "doc/tilesets.h"
 #include "gfx/clip.h"
 #include "gfx/region.h"
+#include "render/mipmap_cache.h"
+#include "render/render_cache.h"
 
+#include <algorithm>
 #include <cmath>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <vector>
 
 #define TRACE_RENDER_CEL(...) // TRACE
 
+// Minimum height (in pixels of the destination image) of each band
+// rendered in parallel by Render::renderSpriteBands().
+#define MIN_BAND_HEIGHT 64
+
 namespace render {
 
 namespace {
@@ -63,6 +76,22 @@ void composite_image_without_scale(
 
   ASSERT(!srcBounds.isEmpty());
 
+  // RGB -> RGB can blend whole rows at once (vectorized blenders)
+  if constexpr (std::is_same_v<DstTraits, RgbTraits> &&
+                std::is_same_v<SrcTraits, RgbTraits>) {
+    if (BlendRowFunc rowBlender = get_rgba_row_blender(blendMode, newBlend)) {
+      const color_t maskColor = src->maskColor();
+      const int h = std::min(srcBounds.h, dstBounds.h);
+      for (int y=0; y<h; ++y) {
+        rowBlender(
+          (color_t*)dst->getPixelAddress(dstBounds.x, dstBounds.y+y),
+          (const color_t*)src->getPixelAddress(srcBounds.x, srcBounds.y+y),
+          srcBounds.w, opacity, maskColor);
+      }
+      return;
+    }
+  }
+
   // Lock all necessary bits
   const LockImageBits<SrcTraits> srcBits(src, srcBounds);
   LockImageBits<DstTraits> dstBits(dst, dstBounds);
@@ -114,7 +143,6 @@ void composite_image_scale_up(
     return;
 
   BlenderHelper<DstTraits, SrcTraits> blender(dst, src, pal, blendMode, newBlend);
-  int px_x, px_y;
   int px_w = int(sx);
   int px_h = int(sy);
 
@@ -142,106 +170,65 @@ void composite_image_scale_up(
   if (srcBounds.isEmpty())
     return;
 
-  gfx::Rect dstBounds = area.dstBounds();
-  int bottom = dstBounds.y2()-1;
-  int line_h;
-
-  // the scanline variable is used to blend src/dst pixels one time for each pixel
-  typedef std::vector<typename DstTraits::pixel_t> Scanline;
-  Scanline scanline(srcBounds.w);
-  typename Scanline::iterator scanline_it;
-#ifdef _DEBUG
-  typename Scanline::iterator scanline_end = scanline.end();
-#endif
-
-  // Lock all necessary bits
-  const LockImageBits<SrcTraits> srcBits(src, srcBounds);
-  LockImageBits<DstTraits> dstBits(dst, dstBounds);
-  typename LockImageBits<SrcTraits>::const_iterator src_it = srcBits.begin();
-#ifdef _DEBUG
-  typename LockImageBits<SrcTraits>::const_iterator src_end = srcBits.end();
-#endif
-  typename LockImageBits<DstTraits>::iterator dst_it, dst_end;
-
-  // For each line to draw of the source image...
-  dstBounds.h = 1;
-  for (int y=0; y<srcBounds.h; ++y) {
-    dst_it = dstBits.begin_area(dstBounds);
-    dst_end = dstBits.end_area(dstBounds);
-
-    // Read 'src' and 'dst' and blend them, put the result in `scanline'
-    scanline_it = scanline.begin();
-    for (int x=0; x<srcBounds.w; ++x) {
-      ASSERT(src_it >= srcBits.begin() && src_it < src_end);
-      ASSERT(dst_it >= dstBits.begin() && dst_it < dst_end);
-      ASSERT(scanline_it >= scanline.begin() && scanline_it < scanline_end);
-
-      *scanline_it = blender(*dst_it, *src_it, opacity);
-      ++src_it;
-
-      int delta;
-      if (x == 0)
-        delta = first_px_w;
-      else
-        delta = px_w;
-
-      while (dst_it != dst_end && delta-- > 0)
-        ++dst_it;
+  const gfx::Rect dstBounds = area.dstBounds();
+  const int dstW = dstBounds.w;
+  const int bottom = dstBounds.y2()-1;
+
+  // The scanline contains the blended src/dst pixels (one time for
+  // each source pixel), using as backdrop the first destination
+  // pixel of each zoomed pixel. Then the scanline is expanded
+  // "px_w" times horizontally and copied "px_h" times vertically.
+  using pixel_t = typename DstTraits::pixel_t;
+  std::vector<pixel_t> scanline(srcBounds.w);
+
+  // RGB -> RGB can blend the whole scanline at once
+  BlendRowFunc rowBlender = nullptr;
+  if constexpr (std::is_same_v<DstTraits, RgbTraits> &&
+                std::is_same_v<SrcTraits, RgbTraits>) {
+    rowBlender = get_rgba_row_blender(blendMode, newBlend);
+  }
+  const color_t maskColor = src->maskColor();
 
-      ++scanline_it;
+  int dstY = dstBounds.y;
+  for (int y=0; y<srcBounds.h && dstY<=bottom; ++y) {
+    pixel_t* dstRow = get_pixel_address_fast<DstTraits>(dst, dstBounds.x, dstY);
+    auto srcPtr = get_pixel_address_fast<SrcTraits>(src, srcBounds.x, srcBounds.y+y);
+
+    // Backdrop pixels
+    for (int x=0, dx=0; x<srcBounds.w; ++x) {
+      scanline[x] = dstRow[std::min(dx, dstW-1)];
+      dx += (x == 0 ? first_px_w: px_w);
     }
 
-    // Get the 'height' of the line to be painted in 'dst'
-    if ((y == 0) && (first_px_h > 0))
-      line_h = first_px_h;
-    else
-      line_h = px_h;
-
-    // Draw the line in 'dst'
-    for (px_y=0; px_y<line_h; ++px_y) {
-      dst_it = dstBits.begin_area(dstBounds);
-      dst_end = dstBits.end_area(dstBounds);
-      scanline_it = scanline.begin();
-
-      int x = 0;
-
-      // first pixel
-      for (px_x=0; px_x<first_px_w; ++px_x) {
-        ASSERT(scanline_it != scanline_end);
-        ASSERT(dst_it != dst_end);
-
-        *dst_it = *scanline_it;
-
-        ++dst_it;
-        if (dst_it == dst_end)
-          goto done_with_line;
-      }
-
-      ++scanline_it;
-      ++x;
-
-      // the rest of the line
-      for (; x<srcBounds.w; ++x) {
-        for (px_x=0; px_x<px_w; ++px_x) {
-          ASSERT(dst_it !=  dst_end);
-
-          *dst_it = *scanline_it;
-
-          ++dst_it;
-          if (dst_it == dst_end)
-            goto done_with_line;
-        }
+    if (rowBlender) {
+      rowBlender((color_t*)scanline.data(), (const color_t*)srcPtr,
+                 srcBounds.w, opacity, maskColor);
+    }
+    else {
+      for (int x=0; x<srcBounds.w; ++x, ++srcPtr)
+        scanline[x] = blender(scanline[x], *srcPtr, opacity);
+    }
 
-        ++scanline_it;
-      }
+    // Expand the scanline in the first row of this zoomed pixel
+    pixel_t* dstPtr = dstRow;
+    int remaining = dstW;
+    for (int x=0; x<srcBounds.w && remaining > 0; ++x) {
+      const int n = std::min(remaining, (x == 0 ? first_px_w: px_w));
+      std::fill_n(dstPtr, n, scanline[x]);
+      dstPtr += n;
+      remaining -= n;
+    }
 
-done_with_line:;
-      if (++dstBounds.y > bottom)
-        goto done_with_blit;
+    // Get the 'height' of the line to be painted in 'dst' and copy
+    // the expanded row in the rest of rows
+    const int line_h = ((y == 0 && first_px_h > 0) ? first_px_h: px_h);
+    const int rowW = dstW - remaining;
+    for (int px_y=1; px_y<line_h && dstY+px_y<=bottom; ++px_y) {
+      std::copy(dstRow, dstRow+rowW,
+                get_pixel_address_fast<DstTraits>(dst, dstBounds.x, dstY+px_y));
     }
+    dstY += line_h;
   }
-
-done_with_blit:;
 }
 
 template<class DstTraits, class SrcTraits>
@@ -313,6 +300,79 @@ void composite_image_scale_down(
   }
 }
 
+// Zoom out averaging each block of step_w x step_h source pixels
+// (box filter) instead of picking only one pixel of the block. The
+// average is calculated with premultiplied alpha so transparent
+// pixels don't darken the result.
+template<class DstTraits, class SrcTraits>
+void composite_image_scale_down_box(
+  Image* dst, const Image* src, const Palette* pal,
+  const gfx::ClipF& areaF,
+  const int opacity,
+  const BlendMode blendMode,
+  const double sx,
+  const double sy,
+  const bool newBlend,
+  const tile_flags)             // Ignored
+{
+  static_assert(std::is_same_v<DstTraits, RgbTraits> &&
+                std::is_same_v<SrcTraits, RgbTraits>,
+                "Box filter is available only for RGB images");
+  ASSERT(dst);
+  ASSERT(src);
+  ASSERT(DstTraits::pixel_format == dst->pixelFormat());
+  ASSERT(SrcTraits::pixel_format == src->pixelFormat());
+
+  gfx::Clip area(areaF);
+  if (!area.clip(dst->width(), dst->height(),
+                 int(sx*double(src->width())),
+                 int(sy*double(src->height()))))
+    return;
+
+  BlenderHelper<DstTraits, SrcTraits> blender(dst, src, pal, blendMode, newBlend);
+  const int step_w = int(1.0 / sx);
+  const int step_h = int(1.0 / sy);
+  if (step_w < 1 || step_h < 1)
+    return;
+
+  const gfx::Rect dstBounds = area.dstBounds();
+  const int srcX0 = area.src.x * step_w;
+  const int srcY0 = area.src.y * step_h;
+  const color_t maskColor = src->maskColor();
+
+  for (int y=0; y<dstBounds.h; ++y) {
+    const int sy0 = srcY0 + y*step_h;
+    const int sy1 = std::min(sy0 + step_h, src->height());
+    auto dstPtr = get_pixel_address_fast<DstTraits>(dst, dstBounds.x, dstBounds.y+y);
+
+    for (int x=0; x<dstBounds.w; ++x, ++dstPtr) {
+      const int sx0 = srcX0 + x*step_w;
+      const int sx1 = std::min(sx0 + step_w, src->width());
+      uint32_t r = 0, g = 0, b = 0, a = 0, n = 0;
+
+      for (int v=sy0; v<sy1; ++v) {
+        auto srcPtr = get_pixel_address_fast<SrcTraits>(src, sx0, v);
+        for (int u=sx0; u<sx1; ++u, ++srcPtr) {
+          const color_t c = *srcPtr;
+          ++n;
+          if (c == maskColor)
+            continue;
+          const int ca = rgba_geta(c);
+          r += rgba_getr(c) * ca;
+          g += rgba_getg(c) * ca;
+          b += rgba_getb(c) * ca;
+          a += ca;
+        }
+      }
+      if (a == 0 || n == 0)
+        continue;
+
+      const color_t c = rgba(r / a, g / a, b / a, a / n);
+      *dstPtr = blender(*dstPtr, c, opacity);
+    }
+  }
+}
+
 template<class DstTraits, class SrcTraits>
 void composite_image_general(
   Image* dst, const Image* src, const Palette* pal,
@@ -484,6 +544,7 @@ void composite_image_general_with_tile_flags(
 template<class DstTraits, class SrcTraits>
 CompositeImageFunc get_fastest_composition_path(const Projection& proj,
                                                 const bool finegrain,
+                                                const bool boxFilter,
                                                 const tile_flags tileFlags)
 {
   if (tileFlags) {
@@ -504,6 +565,11 @@ CompositeImageFunc get_fastest_composition_path(const Projection& proj,
     return composite_image_general<DstTraits, SrcTraits>;
   }
   else {
+    if constexpr (std::is_same_v<DstTraits, RgbTraits> &&
+                  std::is_same_v<SrcTraits, RgbTraits>) {
+      if (boxFilter)
+        return composite_image_scale_down_box<DstTraits, SrcTraits>;
+    }
     return composite_image_scale_down<DstTraits, SrcTraits>;
   }
 }
@@ -524,10 +590,225 @@ bool has_visible_reference_layers(const LayerGroup* group)
   return false;
 }
 
+// Returns a copy of the tile image flipped in the same way that
+// composite_image_general_with_tile_flags() does.
+ImageRef make_flipped_tile(const Image* tileImage,
+                           const tile_flags tileFlags)
+{
+  const int w = tileImage->width();
+  const int h = tileImage->height();
+  ASSERT(!(tileFlags & tile_f_dflip) || w == h);
+
+  ImageRef flipped(Image::create(tileImage->spec()));
+  for (int y=0; y<h; ++y) {
+    for (int x=0; x<w; ++x) {
+      int srcX = (tileFlags & tile_f_xflip ? w-1-x: x);
+      int srcY = (tileFlags & tile_f_yflip ? h-1-y: y);
+      if (tileFlags & tile_f_dflip)
+        std::swap(srcX, srcY);
+      flipped->putPixel(x, y, tileImage->getPixel(srcX, srcY));
+    }
+  }
+  return flipped;
+}
+
+// Resamples "src" in "dst" picking the same source pixels that
+// composite_image_general() picks for a cel that starts at the
+// origin of the destination.
+template<class Traits>
+void resample_image(Image* dst, const Image* src,
+                    const double sx, const double sy)
+{
+  const double srcXDelta = 1.0 / sx;
+  for (int y=0; y<dst->height(); ++y) {
+    const int srcY = int(double(y) / sy);
+    const auto srcPtr = get_pixel_address_fast<Traits>(src, 0, srcY);
+    auto dstPtr = get_pixel_address_fast<Traits>(dst, 0, y);
+    for (int x=0; x<dst->width(); ++x, ++dstPtr)
+      *dstPtr = srcPtr[int(srcXDelta*x)];
+  }
+}
+
+// Returns a copy of the image scaled by sx/sy with nearest
+// neighbor, or nullptr if the scaled image would be too big to be
+// cached.
+ImageRef make_scaled_image(const Image* src,
+                           const double sx,
+                           const double sy,
+                           const int maxPixels)
+{
+  int w = int(std::ceil(sx * src->width()));
+  int h = int(std::ceil(sy * src->height()));
+  while (w > 0 && int((1.0 / sx) * (w-1)) >= src->width()) --w;
+  while (h > 0 && int(double(h-1) / sy) >= src->height()) --h;
+  if (w < 1 || h < 1 || double(w) * double(h) > double(maxPixels))
+    return nullptr;
+
+  ImageSpec spec = src->spec();
+  spec.setSize(w, h);
+  ImageRef dst(Image::create(spec));
+  switch (src->pixelFormat()) {
+    case IMAGE_RGB:       resample_image<RgbTraits>(dst.get(), src, sx, sy); break;
+    case IMAGE_GRAYSCALE: resample_image<GrayscaleTraits>(dst.get(), src, sx, sy); break;
+    case IMAGE_INDEXED:   resample_image<IndexedTraits>(dst.get(), src, sx, sy); break;
+    default:
+      return nullptr;
+  }
+  return dst;
+}
+
+template<class DstTraits>
+CompositeImageFunc get_composition_without_scale(const PixelFormat srcFormat)
+{
+  switch (srcFormat) {
+    case IMAGE_RGB:       return composite_image_without_scale<DstTraits, RgbTraits>;
+    case IMAGE_GRAYSCALE: return composite_image_without_scale<DstTraits, GrayscaleTraits>;
+    case IMAGE_INDEXED:   return composite_image_without_scale<DstTraits, IndexedTraits>;
+  }
+  return nullptr;
+}
+
+CompositeImageFunc get_composition_without_scale(const PixelFormat dstFormat,
+                                                 const PixelFormat srcFormat)
+{
+  switch (dstFormat) {
+    case IMAGE_RGB:       return get_composition_without_scale<RgbTraits>(srcFormat);
+    case IMAGE_GRAYSCALE: return get_composition_without_scale<GrayscaleTraits>(srcFormat);
+    case IMAGE_INDEXED:   return get_composition_without_scale<IndexedTraits>(srcFormat);
+  }
+  return nullptr;
+}
+
 } // anonymous namespace
 
+// Cache of flipped tiles. Each entry is valid while the version of
+// the original tile image is the same.
+class Render::FlippedTiles {
+public:
+  ImageRef get(const Image* tileImage,
+               const tile_flags tileFlags) {
+    const Key key(tileImage->id(), tileFlags);
+    const std::lock_guard lock(m_mutex);
+    auto it = m_tiles.find(key);
+    if (it != m_tiles.end() &&
+        it->second.version == tileImage->version()) {
+      return it->second.image;
+    }
+
+    // Avoid growing the cache indefinitely (e.g. when several
+    // tilesets are modified/rendered)
+    if (it == m_tiles.end() && int(m_tiles.size()) >= kMaxTiles)
+      m_tiles.clear();
+
+    Entry& entry = m_tiles[key];
+    entry.version = tileImage->version();
+    entry.image = make_flipped_tile(tileImage, tileFlags);
+    return entry.image;
+  }
+
+private:
+  static constexpr int kMaxTiles = 4096;
+  using Key = std::pair<ObjectId, tile_flags>;
+  struct Entry {
+    ObjectVersion version = 0;
+    ImageRef image;
+  };
+  std::mutex m_mutex;
+  std::map<Key, Entry> m_tiles;
+};
+
+// Cache of reference layer images resampled at the current zoom
+// level. Each entry is valid while the version of the original image
+// and the scale are the same.
+class Render::ScaledImages {
+public:
+  ImageRef get(const Image* image,
+               const double sx,
+               const double sy) {
+    const std::lock_guard lock(m_mutex);
+    auto it = m_images.find(image->id());
+    if (it != m_images.end() &&
+        it->second.version == image->version() &&
+        it->second.sx == sx &&
+        it->second.sy == sy) {
+      return it->second.image;
+    }
+
+    if (it == m_images.end() && int(m_images.size()) >= kMaxImages)
+      m_images.clear();
+
+    // The entry is kept even if the image is too big to be cached
+    // (nullptr) to avoid checking it again on each render
+    Entry& entry = m_images[image->id()];
+    entry.version = image->version();
+    entry.sx = sx;
+    entry.sy = sy;
+    entry.image = make_scaled_image(image, sx, sy, kMaxPixels);
+    return entry.image;
+  }
+
+private:
+  static constexpr int kMaxImages = 8;
+  static constexpr int kMaxPixels = 4096*4096;
+  struct Entry {
+    ObjectVersion version = 0;
+    double sx = 0.0;
+    double sy = 0.0;
+    ImageRef image;
+  };
+  std::mutex m_mutex;
+  std::map<ObjectId, Entry> m_images;
+};
+
+// Cache of render plans. Each plan is valid while the structure of
+// the sprite is the same (layers/cels added/removed/moved, layer
+// visibility or cel z-index changes).
+class Render::RenderPlans {
+public:
+  std::shared_ptr<const RenderPlan> get(const Layer* layer,
+                                        const frame_t frame) {
+    const Sprite* sprite = layer->sprite();
+    ASSERT(sprite);
+    const uint32_t version = sprite->structureVersion();
+    const Key key(layer, frame);
+    const std::lock_guard lock(m_mutex);
+
+    if (m_spriteId != sprite->id() || m_version != version) {
+      m_spriteId = sprite->id();
+      m_version = version;
+      m_plans.clear();
+    }
+
+    auto it = m_plans.find(key);
+    if (it != m_plans.end())
+      return it->second;
+
+    // Avoid growing the cache indefinitely (e.g. when we render all
+    // frames of the sprite)
+    if (int(m_plans.size()) >= kMaxPlans)
+      m_plans.clear();
+
+    auto plan = std::make_shared<RenderPlan>();
+    plan->addLayer(layer, frame);
+    // Process z-indexes now as the plan can be used from several
+    // threads (see renderSpriteBands())
+    plan->items();
+    m_plans[key] = plan;
+    return plan;
+  }
+
+private:
+  static constexpr int kMaxPlans = 32;
+  using Key = std::pair<const Layer*, frame_t>;
+  std::mutex m_mutex;
+  ObjectId m_spriteId = NullId;
+  uint32_t m_version = 0;
+  std::map<Key, std::shared_ptr<const RenderPlan>> m_plans;
+};
+
 Render::Render()
   : m_flags(0)
+  , m_maxThreads(1)
   , m_nonactiveLayersOpacity(255)
   , m_sprite(nullptr)
   , m_currentLayer(nullptr)
@@ -544,6 +825,11 @@ Render::Render()
   , m_previewTileset(nullptr)
   , m_previewBlendMode(BlendMode::NORMAL)
   , m_onionskin(OnionskinType::NONE)
+  , m_cache(nullptr)
+  , m_mipmaps(nullptr)
+  , m_flippedTiles(std::make_shared<FlippedTiles>())
+  , m_scaledImages(std::make_shared<ScaledImages>())
+  , m_renderPlans(std::make_shared<RenderPlans>())
 {
 }
 
@@ -555,6 +841,14 @@ void Render::setRefLayersVisiblity(const bool visible)
     m_flags &= ~Flags::ShowRefLayers;
 }
 
+void Render::setBoxFilterScaleDown(const bool state)
+{
+  if (state)
+    m_flags |= Flags::BoxFilterScaleDown;
+  else
+    m_flags &= ~Flags::BoxFilterScaleDown;
+}
+
 void Render::setNonactiveLayersOpacity(const int opacity)
 {
   m_nonactiveLayersOpacity = opacity;
@@ -580,6 +874,21 @@ void Render::setSelectedLayer(const Layer* layer)
   m_selectedLayerForOpacity = layer;
 }
 
+void Render::setMaxThreads(const int threads)
+{
+  m_maxThreads = std::max(1, threads);
+}
+
+void Render::setCache(RenderCache* cache)
+{
+  m_cache = cache;
+}
+
+void Render::setMipmapCache(MipmapCache* mipmaps)
+{
+  m_mipmaps = mipmaps;
+}
+
 void Render::setPreviewImage(const Layer* layer,
                              const frame_t frame,
                              const Image* image,
@@ -669,10 +978,9 @@ void Render::renderLayer(
 
   m_globalOpacity = 255;
 
-  doc::RenderPlan plan;
-  plan.addLayer(layer, frame);
+  auto plan = m_renderPlans->get(layer, frame);
   renderPlan(
-    plan, dstImage, area,
+    *plan, dstImage, area,
     frame, compositeImage,
     true, true, blendMode);
 }
@@ -682,6 +990,108 @@ void Render::renderSprite(
   const Sprite* sprite,
   frame_t frame,
   const gfx::ClipF& area)
+{
+  const int nbands =
+    std::min(m_maxThreads, int(area.size.h) / MIN_BAND_HEIGHT);
+  if (nbands > 1)
+    renderSpriteBands(dstImage, sprite, frame, area, nbands);
+  else
+    renderSpriteArea(dstImage, sprite, frame, area);
+}
+
+void Render::renderSpriteBands(
+  Image* dstImage,
+  const Sprite* sprite,
+  frame_t frame,
+  const gfx::ClipF& area,
+  const int nbands)
+{
+  if (int(m_bandBufs.size()) < nbands)
+    m_bandBufs.resize(nbands);
+
+  // Each band is rendered by its own copy of this Render (so the
+  // state modified while rendering, e.g. m_globalOpacity, is not
+  // shared between threads) in its own image, that is finally
+  // copied to dstImage.
+  struct Band {
+    Render render;
+    ImageRef image;
+    gfx::ClipF area;
+    int y;
+  };
+  std::vector<Band> bands;
+  bands.reserve(nbands);
+
+  const int w = int(area.size.w);
+  const int h = int(area.size.h);
+  ImageSpec spec = dstImage->spec();
+  for (int i=0, y=0; i<nbands; ++i) {
+    const int bandH = (i < nbands-1 ? h / nbands: h - y);
+    auto& bandBuf = m_bandBufs[i];
+    if (!bandBuf.first)
+      bandBuf.first = std::make_shared<doc::ImageBuffer>();
+    if (!bandBuf.second)
+      bandBuf.second = std::make_shared<doc::ImageBuffer>();
+
+    spec.setSize(w, bandH);
+    Band band { *this,
+                ImageRef(Image::create(spec, bandBuf.first)),
+                gfx::ClipF(0, 0, area.src.x, area.src.y+y, w, bandH),
+                y };
+    band.render.m_maxThreads = 1;
+    band.render.m_tmpBuf = bandBuf.second;
+    bands.push_back(std::move(band));
+    y += bandH;
+  }
+
+  TaskGroup group(TaskPriority::High);
+  for (int i=1; i<nbands; ++i) {
+    group.run(
+      [&, i]{
+        Band& band = bands[i];
+        band.render.renderSpriteArea(band.image.get(), sprite, frame, band.area);
+      });
+  }
+
+  // The first band is rendered in the current thread
+  bands[0].render.renderSpriteArea(bands[0].image.get(), sprite, frame, bands[0].area);
+  group.wait();
+
+  for (const Band& band : bands) {
+    copy_image(dstImage, band.image.get(),
+               int(area.dst.x), int(area.dst.y)+band.y);
+  }
+}
+
+void Render::prerenderSprite(
+  const Sprite* sprite,
+  frame_t frame,
+  const PixelFormat dstFormat)
+{
+  if (!m_cache)
+    return;
+
+  // The preview/extra images can be deleted while we render in a
+  // background thread, and the buffers cannot be shared with the
+  // original Render.
+  removePreviewImage();
+  removeExtraImage();
+  m_maxThreads = 1;
+  m_tmpBuf.reset();
+  m_bandBufs.clear();
+
+  // Rendering one pixel of the sprite fills the cache with the whole
+  // projected sprite (see renderSpriteLayersWithCache())
+  ImageRef dstImage(Image::create(dstFormat, 1, 1));
+  renderSpriteArea(dstImage.get(), sprite, frame,
+                   gfx::ClipF(0, 0, 0, 0, 1, 1));
+}
+
+void Render::renderSpriteArea(
+  Image* dstImage,
+  const Sprite* sprite,
+  frame_t frame,
+  const gfx::ClipF& area)
 {
   m_sprite = sprite;
 
@@ -715,7 +1125,11 @@ void Render::renderSprite(
     fill_rect(dstImage, area.dstBounds(), bg_color);
 
     // Draw the Background layer - Onion skin behind the sprite - Transparent Layers
-    renderSpriteLayers(dstImage, area, frame, compositeImage);
+    if (!m_cache ||
+        !renderSpriteLayersWithCache(dstImage, area, frame,
+                                     compositeImage, bg_color)) {
+      renderSpriteLayers(dstImage, area, frame, compositeImage);
+    }
 
     // In case that we need a special background (e.g. like the
     // checkered pattern), we can draw the background in a temporal
@@ -768,12 +1182,11 @@ void Render::renderSpriteLayers(Image* dstImage,
                                 frame_t frame,
                                 CompositeImageFunc compositeImage)
 {
-  doc::RenderPlan plan;
-  plan.addLayer(m_sprite->root(), frame);
+  auto plan = m_renderPlans->get(m_sprite->root(), frame);
 
   // Draw the background layer.
   m_globalOpacity = 255;
-  renderPlan(plan, dstImage,
+  renderPlan(*plan, dstImage,
              area, frame, compositeImage,
              true,
              false,
@@ -785,13 +1198,151 @@ void Render::renderSpriteLayers(Image* dstImage,
 
   // Draw the transparent layers.
   m_globalOpacity = 255;
-  renderPlan(plan, dstImage,
+  renderPlan(*plan, dstImage,
              area, frame, compositeImage,
              false,
              true,
              BlendMode::UNSPECIFIED);
 }
 
+bool Render::renderSpriteLayersWithCache(Image* dstImage,
+                                         const gfx::ClipF& areaF,
+                                         frame_t frame,
+                                         CompositeImageFunc compositeImage,
+                                         const color_t bgColor)
+{
+  // The cached image is the whole projected sprite, so we can use it
+  // only for areas inside the sprite in integer coordinates.
+  const gfx::Clip area(areaF);
+  if (area.dst.x != areaF.dst.x || area.dst.y != areaF.dst.y ||
+      area.src.x != areaF.src.x || area.src.y != areaF.src.y ||
+      area.size.w != areaF.size.w || area.size.h != areaF.size.h)
+    return false;
+
+  const gfx::Size spriteSize(m_proj.applyX(m_sprite->width()),
+                             m_proj.applyY(m_sprite->height()));
+  if (spriteSize.w * spriteSize.h > m_cache->maxPixels() ||
+      !gfx::Rect(spriteSize).contains(area.srcBounds()))
+    return false;
+
+  // Each step renders one item of a render plan, in the same order
+  // as renderSpriteLayers(): background layers, onion skin behind
+  // the sprite (ghost frames), and transparent layers.
+  struct Step {
+    RenderPlan::Item item;
+    frame_t frame;
+    bool background;
+    int opacity;
+    BlendMode blendMode;
+  };
+  std::vector<Step> steps;
+
+  auto plan = m_renderPlans->get(m_sprite->root(), frame);
+  for (const RenderPlan::Item& item : plan->items()) {
+    if (item.layer->isBackground())
+      steps.push_back(Step{ item, frame, true, 255, BlendMode::UNSPECIFIED });
+  }
+
+  if (m_onionskin.position() == OnionskinPosition::BEHIND) {
+    const Layer* onionLayer = onionskinLayer();
+    forEachOnionskinFrame(
+      frame,
+      [this, &steps, onionLayer](const frame_t frameIn,
+                                 const int opacity,
+                                 const BlendMode blendMode) {
+        auto onionPlan = m_renderPlans->get(onionLayer, frameIn);
+        for (const RenderPlan::Item& item : onionPlan->items()) {
+          if (!item.layer->isBackground())
+            steps.push_back(Step{ item, frameIn, false, opacity, blendMode });
+        }
+      });
+  }
+
+  for (const RenderPlan::Item& item : plan->items()) {
+    if (!item.layer->isBackground())
+      steps.push_back(Step{ item, frame, false, 255, BlendMode::UNSPECIFIED });
+  }
+
+  // Cache all steps until the first one that can change without
+  // changing its version (e.g. the layer with the extra cel or
+  // preview image that we are modifying).
+  RenderCache::ItemVersions versions;
+  for (const Step& step : steps) {
+    const Layer* layer = step.item.layer;
+    const Cel* cel = (step.item.cel ? step.item.cel: layer->cel(step.frame));
+
+    if ((layer == m_currentLayer && m_extraCel && m_extraImage) ||
+        (m_previewImage && cel && checkIfWeShouldUsePreview(cel)) ||
+        // Tiles can be modified without changing the tilemap version
+        layer->isTilemap())
+      break;
+
+    RenderCache::ItemVersion v;
+    v.frame = step.frame;
+    v.background = step.background;
+    v.opacity = step.opacity;
+    v.blendMode = step.blendMode;
+    v.layerId = layer->id();
+    v.layerVersion = layer->version();
+    if (cel) {
+      v.celId = cel->id();
+      v.celVersion = cel->version();
+      v.celDataVersion = cel->data()->version();
+      if (const Image* image = cel->image()) {
+        v.imageId = image->id();
+        v.imageVersion = image->version();
+      }
+    }
+    versions.push_back(v);
+  }
+  if (versions.empty())
+    return false;
+
+  const Palette* pal = m_sprite->palette(frame);
+  RenderCache::Key key;
+  key.spriteId = m_sprite->id();
+  key.frame = frame;
+  key.pixelFormat = dstImage->pixelFormat();
+  key.bgColor = bgColor;
+  key.transparentColor = m_sprite->transparentColor();
+  key.paletteVersion = (pal ? pal->version(): 0);
+  key.scaleX = m_proj.scaleX();
+  key.scaleY = m_proj.scaleY();
+  key.flags = m_flags;
+  key.nonactiveLayersOpacity = m_nonactiveLayersOpacity;
+  if (m_nonactiveLayersOpacity != 255 && m_selectedLayerForOpacity)
+    key.selectedLayerId = m_selectedLayerForOpacity->id();
+
+  ImageSpec spec = dstImage->spec();
+  spec.setSize(spriteSize);
+
+  auto renderSteps =
+    [this, &steps, compositeImage](Image* image, const gfx::Clip& area,
+                                   const int fromStep, const int toStep) {
+      for (int i=fromStep; i<toStep; ++i) {
+        const Step& step = steps[i];
+        const RenderPlan::Items items(1, step.item);
+        m_globalOpacity = step.opacity;
+        renderPlanItems(items, 0, 1, image, area,
+                        step.frame, compositeImage,
+                        step.background, !step.background,
+                        step.blendMode);
+      }
+      m_globalOpacity = 255;
+    };
+
+  ImageRef cached = m_cache->get(
+    key, spec, versions,
+    [&renderSteps](Image* image, int fromStep, int toStep){
+      renderSteps(image, gfx::Clip(image->bounds()), fromStep, toStep);
+    });
+
+  // Copy the cached steps and render the rest of steps on it
+  dstImage->copy(cached.get(), area);
+  renderSteps(dstImage, area, int(versions.size()), int(steps.size()));
+  return true;
+}
+
 void Render::renderBackground(Image* image,
                               const Layer* bgLayer,
                               const color_t bg_color,
@@ -844,57 +1395,77 @@ void Render::renderOnionskin(
 {
   // Onion-skin feature: Draw previous/next frames with different
   // opacity (<255)
-  if (m_onionskin.type() != OnionskinType::NONE) {
-    Tag* loop = m_onionskin.loopTag();
-    Layer* onionLayer = (m_onionskin.layer() ? m_onionskin.layer():
-                                               m_sprite->root());
-    Playback play(
-      m_sprite,
-      TagsList(),  // TODO add an onionskin option to iterate subtags
-      frame,
-      loop ? Playback::PlayInLoop : Playback::PlayAll,
-      loop);
-    frame_t prevFrames = (loop ? m_onionskin.prevFrames():
-                                 std::min(frame, m_onionskin.prevFrames()));
-    play.nextFrame(-prevFrames);
-
-    for (frame_t frameOut = frame - prevFrames;
-         frameOut <= frame + m_onionskin.nextFrames();
-         ++frameOut, play.nextFrame()) {
-      const frame_t frameIn = play.frame();
-
-      if (frameIn == frame ||
-          frameIn < 0 ||
-          frameIn > m_sprite->lastFrame()) {
-        continue;
-      }
+  const Layer* onionLayer = onionskinLayer();
+  forEachOnionskinFrame(
+    frame,
+    [this, dstImage, &area, compositeImage, onionLayer]
+    (const frame_t frameIn, const int opacity, const BlendMode blendMode) {
+      m_globalOpacity = opacity;
+
+      auto plan = m_renderPlans->get(onionLayer, frameIn);
+      renderPlan(
+        *plan, dstImage,
+        area, frameIn, compositeImage,
+        // Render background only for "in-front" onion skinning and
+        // when opacity is < 255
+        (m_globalOpacity < 255 &&
+         m_onionskin.position() == OnionskinPosition::INFRONT),
+        true, blendMode);
+    });
+}
 
-      if (frameOut < frame) {
-        m_globalOpacity = m_onionskin.opacityBase() - m_onionskin.opacityStep() * ((frame - frameOut)-1);
-      }
-      else {
-        m_globalOpacity = m_onionskin.opacityBase() - m_onionskin.opacityStep() * ((frameOut - frame)-1);
-      }
+const Layer* Render::onionskinLayer() const
+{
+  return (m_onionskin.layer() ? m_onionskin.layer():
+                                m_sprite->root());
+}
 
-      m_globalOpacity = std::clamp(m_globalOpacity, 0, 255);
-      if (m_globalOpacity > 0) {
-        BlendMode blendMode = BlendMode::UNSPECIFIED;
-        if (m_onionskin.type() == OnionskinType::MERGE)
-          blendMode = BlendMode::NORMAL;
-        else if (m_onionskin.type() == OnionskinType::RED_BLUE_TINT)
-          blendMode = (frameOut < frame ? BlendMode::RED_TINT: BlendMode::BLUE_TINT);
-
-        doc::RenderPlan plan;
-        plan.addLayer(onionLayer, frameIn);
-        renderPlan(
-          plan, dstImage,
-          area, frameIn, compositeImage,
-          // Render background only for "in-front" onion skinning and
-          // when opacity is < 255
-          (m_globalOpacity < 255 &&
-           m_onionskin.position() == OnionskinPosition::INFRONT),
-          true, blendMode);
-      }
+void Render::forEachOnionskinFrame(
+  const frame_t frame,
+  const std::function<void(frame_t, int, BlendMode)>& func)
+{
+  if (m_onionskin.type() == OnionskinType::NONE)
+    return;
+
+  Tag* loop = m_onionskin.loopTag();
+  Playback play(
+    m_sprite,
+    TagsList(),  // TODO add an onionskin option to iterate subtags
+    frame,
+    loop ? Playback::PlayInLoop : Playback::PlayAll,
+    loop);
+  frame_t prevFrames = (loop ? m_onionskin.prevFrames():
+                               std::min(frame, m_onionskin.prevFrames()));
+  play.nextFrame(-prevFrames);
+
+  for (frame_t frameOut = frame - prevFrames;
+       frameOut <= frame + m_onionskin.nextFrames();
+       ++frameOut, play.nextFrame()) {
+    const frame_t frameIn = play.frame();
+
+    if (frameIn == frame ||
+        frameIn < 0 ||
+        frameIn > m_sprite->lastFrame()) {
+      continue;
+    }
+
+    int opacity;
+    if (frameOut < frame) {
+      opacity = m_onionskin.opacityBase() - m_onionskin.opacityStep() * ((frame - frameOut)-1);
+    }
+    else {
+      opacity = m_onionskin.opacityBase() - m_onionskin.opacityStep() * ((frameOut - frame)-1);
+    }
+
+    opacity = std::clamp(opacity, 0, 255);
+    if (opacity > 0) {
+      BlendMode blendMode = BlendMode::UNSPECIFIED;
+      if (m_onionskin.type() == OnionskinType::MERGE)
+        blendMode = BlendMode::NORMAL;
+      else if (m_onionskin.type() == OnionskinType::RED_BLUE_TINT)
+        blendMode = (frameOut < frame ? BlendMode::RED_TINT: BlendMode::BLUE_TINT);
+
+      func(frameIn, opacity, blendMode);
     }
   }
 }
@@ -986,7 +1557,25 @@ void Render::renderImage(
 }
 
 void Render::renderPlan(
-  RenderPlan& plan,
+  const RenderPlan& plan,
+  Image* image,
+  const gfx::Clip& area,
+  const frame_t frame,
+  const CompositeImageFunc compositeImage,
+  const bool render_background,
+  const bool render_transparent,
+  const BlendMode blendMode)
+{
+  const RenderPlan::Items& items = plan.items();
+  renderPlanItems(items, 0, int(items.size()),
+                  image, area, frame, compositeImage,
+                  render_background, render_transparent, blendMode);
+}
+
+void Render::renderPlanItems(
+  const RenderPlan::Items& items,
+  const int fromItem,
+  const int toItem,
   Image* image,
   const gfx::Clip& area,
   const frame_t frame,
@@ -995,7 +1584,8 @@ void Render::renderPlan(
   const bool render_transparent,
   const BlendMode blendMode)
 {
-  for (const auto& item : plan.items()) {
+  for (int i=fromItem; i<toItem; ++i) {
+    const RenderPlan::Item& item = items[i];
     const Cel* cel = item.cel;
     const Layer* layer = item.layer;
 
@@ -1267,39 +1857,115 @@ void Render::renderCel(
                      tilesToDraw.x, tilesToDraw.y, tilesToDraw.w, tilesToDraw.h);
 
     for (int v=tilesToDraw.y; v<tilesToDraw.y2(); ++v) {
+      // Big tilemaps are usually full of empty tiles, so we iterate
+      // the row of tiles directly and calculate the tile bounds only
+      // for the non-empty ones.
+      const tile_t* row = get_pixel_address_fast<TilemapTraits>(cel_image, 0, v);
+
       for (int u=tilesToDraw.x; u<tilesToDraw.x2(); ++u) {
-        auto tileBoundsOnCanvas = grid.tileToCanvas(gfx::Rect(u, v, 1, 1));
-        TRACE_RENDER_CEL(" - tile (%d %d) -> (%d %d %d %d)\n", u, v,
-                         tileBoundsOnCanvas.x, tileBoundsOnCanvas.y,
-                         tileBoundsOnCanvas.w, tileBoundsOnCanvas.h);
-        if (!cel_image->bounds().contains(u, v))
-          continue;
-
-        const tile_t t = cel_image->getPixel(u, v);
+        const tile_t t = row[u];
         if (t != doc::notile) {
+          auto tileBoundsOnCanvas = grid.tileToCanvas(gfx::Rect(u, v, 1, 1));
+          TRACE_RENDER_CEL(" - tile (%d %d) -> (%d %d %d %d)\n", u, v,
+                           tileBoundsOnCanvas.x, tileBoundsOnCanvas.y,
+                           tileBoundsOnCanvas.w, tileBoundsOnCanvas.h);
+
           const tile_index i = tile_geti(t);
 
           if (dst_image->pixelFormat() == IMAGE_TILEMAP) {
             put_pixel(dst_image, u-area.dst.x, v-area.dst.y, t);
           }
           else {
-            const ImageRef tile_image = tileset->get(i);
+            ImageRef tile_image = tileset->get(i);
             if (!tile_image)
               continue;
 
+            // Flipped tiles are replaced with a cached flipped copy
+            // of the tile, so we can use the same compositeImage()
+            // function (the fastest one for the current zoom level)
+            // instead of the general one with tile flags.
+            tile_flags tileFlags = tile_getf(t);
+            if (tileFlags &&
+                (!(tileFlags & tile_f_dflip) ||
+                 tile_image->width() == tile_image->height())) {
+              tile_image = getFlippedTile(tile_image.get(), tileFlags);
+              tileFlags = 0;
+            }
+
             renderImage(dst_image, tile_image.get(), pal, tileBoundsOnCanvas,
-                        area, compositeImage, opacity, blendMode, tile_getf(t));
+                        area, compositeImage, opacity, blendMode, tileFlags);
           }
         }
       }
     }
   }
   else {
+    // Reference layers (usually big images with non-integer bounds)
+    // are composited from a copy resampled at the current zoom level
+    // instead of using composite_image_general() on each render.
+    if (cel_layer &&
+        cel_layer->isReference() &&
+        // The preview/extra images can be modified without changing
+        // their versions
+        cel_image != m_previewImage &&
+        cel_image != m_extraImage &&
+        renderScaledImage(dst_image, cel_image, pal, celBounds,
+                          area, opacity, blendMode)) {
+      return;
+    }
+
     renderImage(dst_image, cel_image, pal, celBounds,
                 area, compositeImage, opacity, blendMode);
   }
 }
 
+bool Render::renderScaledImage(
+  Image* dst_image,
+  const Image* cel_image,
+  const Palette* pal,
+  const gfx::RectF& celBounds,
+  const gfx::Clip& area,
+  const int opacity,
+  const BlendMode blendMode)
+{
+  CompositeImageFunc compositeImage =
+    get_composition_without_scale(dst_image->pixelFormat(),
+                                  cel_image->pixelFormat());
+  if (!compositeImage)
+    return false;
+
+  const double sx = m_proj.scaleX() * celBounds.w / double(cel_image->width());
+  const double sy = m_proj.scaleY() * celBounds.h / double(cel_image->height());
+  ImageRef scaled = m_scaledImages->get(cel_image, sx, sy);
+  if (!scaled)
+    return false;
+
+  // Position of the scaled image in "dst_image"
+  const gfx::RectF scaledBounds = m_proj.apply(celBounds);
+  const gfx::Rect bounds(
+    int(std::floor(double(area.dst.x - area.src.x) + scaledBounds.x)),
+    int(std::floor(double(area.dst.y - area.src.y) + scaledBounds.y)),
+    scaled->width(),
+    scaled->height());
+
+  const gfx::Rect dstBounds =
+    bounds & gfx::Rect(area.dst.x, area.dst.y, area.size.w, area.size.h);
+  if (dstBounds.isEmpty())
+    return true;
+
+  compositeImage(
+    dst_image, scaled.get(), pal,
+    gfx::ClipF(dstBounds.x, dstBounds.y,
+               dstBounds.x - bounds.x,
+               dstBounds.y - bounds.y,
+               dstBounds.w, dstBounds.h),
+    opacity, blendMode,
+    1.0, 1.0,
+    m_newBlendMethod,
+    notile);
+  return true;
+}
+
 void Render::renderImage(
   Image* dst_image,
   const Image* cel_image,
@@ -1324,6 +1990,39 @@ void Render::renderImage(
       nullptr, tileFlags);
   }
 
+  double sx = m_proj.scaleX() * celBounds.w / double(cel_image->width());
+  double sy = m_proj.scaleY() * celBounds.h / double(cel_image->height());
+
+  // The box filter averages all the pixels of the image, so we can
+  // use a downscaled version of the image (mipmap) and average less
+  // pixels (e.g. to zoom out at 25% we can average 2x2 pixels of the
+  // image scaled down at 50%).
+  ImageRef mipmap;
+  if (m_mipmaps &&
+      compositeImage == composite_image_scale_down_box<RgbTraits, RgbTraits> &&
+      // The preview/extra images can be modified without changing
+      // their versions
+      cel_image != m_previewImage &&
+      cel_image != m_extraImage) {
+    int stepW = int(1.0 / sx + 0.5);
+    int stepH = int(1.0 / sy + 0.5);
+    int level = 0;
+    while (stepW > 1 && stepH > 1 &&
+           (stepW & 1) == 0 && (stepH & 1) == 0) {
+      stepW >>= 1;
+      stepH >>= 1;
+      ++level;
+    }
+    if (level > 0) {
+      mipmap = m_mipmaps->get(cel_image, level);
+      if (mipmap) {
+        cel_image = mipmap.get();
+        sx *= double(1 << level);
+        sy *= double(1 << level);
+      }
+    }
+  }
+
   compositeImage(
     dst_image, cel_image, pal,
     gfx::ClipF(
@@ -1335,8 +2034,7 @@ void Render::renderImage(
       srcBounds.h),
     opacity,
     blendMode,
-    m_proj.scaleX() * celBounds.w / double(cel_image->width()),
-    m_proj.scaleY() * celBounds.h / double(cel_image->height()),
+    sx, sy,
     m_newBlendMethod,
     tileFlags);
 }
@@ -1359,37 +2057,38 @@ CompositeImageFunc Render::getImageComposition(
     (layer &&
      layer->isGroup() &&
      has_visible_reference_layers(static_cast<const LayerGroup*>(layer)));
+  const bool boxFilter = (m_flags & Flags::BoxFilterScaleDown);
 
   switch (srcFormat) {
 
     case IMAGE_RGB:
       switch (dstFormat) {
-        case IMAGE_RGB:       return get_fastest_composition_path<RgbTraits, RgbTraits>(m_proj, finegrain, tileFlags);
-        case IMAGE_GRAYSCALE: return get_fastest_composition_path<GrayscaleTraits, RgbTraits>(m_proj, finegrain, tileFlags);
-        case IMAGE_INDEXED:   return get_fastest_composition_path<IndexedTraits, RgbTraits>(m_proj, finegrain, tileFlags);
+        case IMAGE_RGB:       return get_fastest_composition_path<RgbTraits, RgbTraits>(m_proj, finegrain, boxFilter, tileFlags);
+        case IMAGE_GRAYSCALE: return get_fastest_composition_path<GrayscaleTraits, RgbTraits>(m_proj, finegrain, boxFilter, tileFlags);
+        case IMAGE_INDEXED:   return get_fastest_composition_path<IndexedTraits, RgbTraits>(m_proj, finegrain, boxFilter, tileFlags);
       }
       break;
 
     case IMAGE_GRAYSCALE:
       switch (dstFormat) {
-        case IMAGE_RGB:       return get_fastest_composition_path<RgbTraits, GrayscaleTraits>(m_proj, finegrain, tileFlags);
-        case IMAGE_GRAYSCALE: return get_fastest_composition_path<GrayscaleTraits, GrayscaleTraits>(m_proj, finegrain, tileFlags);
-        case IMAGE_INDEXED:   return get_fastest_composition_path<IndexedTraits, GrayscaleTraits>(m_proj, finegrain, tileFlags);
+        case IMAGE_RGB:       return get_fastest_composition_path<RgbTraits, GrayscaleTraits>(m_proj, finegrain, boxFilter, tileFlags);
+        case IMAGE_GRAYSCALE: return get_fastest_composition_path<GrayscaleTraits, GrayscaleTraits>(m_proj, finegrain, boxFilter, tileFlags);
+        case IMAGE_INDEXED:   return get_fastest_composition_path<IndexedTraits, GrayscaleTraits>(m_proj, finegrain, boxFilter, tileFlags);
       }
       break;
 
     case IMAGE_INDEXED:
       switch (dstFormat) {
-        case IMAGE_RGB:       return get_fastest_composition_path<RgbTraits, IndexedTraits>(m_proj, finegrain, tileFlags);
-        case IMAGE_GRAYSCALE: return get_fastest_composition_path<GrayscaleTraits, IndexedTraits>(m_proj, finegrain, tileFlags);
-        case IMAGE_INDEXED:   return get_fastest_composition_path<IndexedTraits, IndexedTraits>(m_proj, finegrain, tileFlags);
+        case IMAGE_RGB:       return get_fastest_composition_path<RgbTraits, IndexedTraits>(m_proj, finegrain, boxFilter, tileFlags);
+        case IMAGE_GRAYSCALE: return get_fastest_composition_path<GrayscaleTraits, IndexedTraits>(m_proj, finegrain, boxFilter, tileFlags);
+        case IMAGE_INDEXED:   return get_fastest_composition_path<IndexedTraits, IndexedTraits>(m_proj, finegrain, boxFilter, tileFlags);
       }
       break;
 
     case IMAGE_TILEMAP:
       switch (dstFormat) {
         case IMAGE_TILEMAP:
-          return get_fastest_composition_path<TilemapTraits, TilemapTraits>(m_proj, finegrain, tileFlags);
+          return get_fastest_composition_path<TilemapTraits, TilemapTraits>(m_proj, finegrain, boxFilter, tileFlags);
       }
       break;
   }
@@ -1399,6 +2098,12 @@ CompositeImageFunc Render::getImageComposition(
   return nullptr;
 }
 
+ImageRef Render::getFlippedTile(const Image* tileImage,
+                                const tile_flags tileFlags)
+{
+  return m_flippedTiles->get(tileImage, tileFlags);
+}
+
 bool Render::checkIfWeShouldUsePreview(const Cel* cel) const
 {
   if ((m_selectedLayer == cel->layer())) {
@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2023 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -15,6 +15,7 @@
 #include "doc/doc.h"
 #include "doc/frame.h"
 #include "doc/pixel_format.h"
+#include "doc/render_plan.h"
 #include "doc/tile.h"
 #include "gfx/clip.h"
 #include "gfx/point.h"
@@ -24,12 +25,16 @@
 #include "render/onionskin_options.h"
 #include "render/projection.h"
 
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
 namespace doc {
   class Cel;
   class Image;
   class Layer;
   class Palette;
-  class RenderPlan;
   class Sprite;
   class Tileset;
 }
@@ -37,6 +42,9 @@ namespace doc {
 namespace render {
   using namespace doc;
 
+  class MipmapCache;
+  class RenderCache;
+
   typedef void (*CompositeImageFunc)(
     Image* dst,
     const Image* src,
@@ -52,6 +60,7 @@ namespace render {
   class Render {
     enum Flags {
       ShowRefLayers = 1,
+      BoxFilterScaleDown = 2,
     };
 
   public:
@@ -60,10 +69,32 @@ namespace render {
     void setRefLayersVisiblity(const bool visible);
     void setNonactiveLayersOpacity(const int opacity);
     void setNewBlend(const bool newBlend);
+
+    // Averages the source pixels (box filter) when the projection
+    // zooms out RGB images, instead of picking one pixel of each
+    // block (nearest neighbor).
+    void setBoxFilterScaleDown(const bool state);
     void setProjection(const Projection& projection);
     void setBgOptions(const BgOptions& bg);
     void setSelectedLayer(const Layer* layer);
 
+    // Maximum number of threads used by renderSprite() to render
+    // horizontal bands of the given area concurrently (1 means that
+    // the sprite is rendered in the current thread only).
+    void setMaxThreads(const int threads);
+
+    // Cache used by renderSprite() to avoid compositing the layers
+    // below the current layer on each call (the cache is not owned
+    // by the Render).
+    void setCache(RenderCache* cache);
+
+    // Cache of downscaled cel images used to zoom out with the box
+    // filter (see setBoxFilterScaleDown()), so the cost of rendering
+    // a huge sprite zoomed out depends on the size of the output
+    // instead of the size of the sprite (it's not owned by the
+    // Render).
+    void setMipmapCache(MipmapCache* mipmaps);
+
     // Sets the preview image. This preview image is an alternative
     // image to be used for the given layer/frame.
     void setPreviewImage(const Layer* layer,
@@ -112,6 +143,18 @@ namespace render {
       frame_t frame,
       const gfx::ClipF& area);
 
+    // Renders the given frame in the cache (see setCache()) as if
+    // renderSprite() were called for the whole sprite, so the next
+    // renderSprite() of this frame only needs to copy the cached
+    // image. It's designed to be called from a background thread in
+    // a copy of the Render used to paint the sprite (e.g. to
+    // pre-render the next frames of the animation while it's
+    // played). The preview and extra images are not rendered.
+    void prerenderSprite(
+      const Sprite* sprite,
+      frame_t frame,
+      const PixelFormat dstFormat = IMAGE_RGB);
+
     // Extra functions
     void renderCheckeredBackground(
       Image* image,
@@ -139,6 +182,19 @@ namespace render {
       const BlendMode blendMode);
 
   private:
+    void renderSpriteArea(
+      Image* dstImage,
+      const Sprite* sprite,
+      frame_t frame,
+      const gfx::ClipF& area);
+
+    void renderSpriteBands(
+      Image* dstImage,
+      const Sprite* sprite,
+      frame_t frame,
+      const gfx::ClipF& area,
+      const int nbands);
+
     void renderSpriteLayers(
       Image* dstImage,
       const gfx::ClipF& area,
@@ -151,6 +207,13 @@ namespace render {
       const color_t bg_color,
       const gfx::ClipF& area);
 
+    bool renderSpriteLayersWithCache(
+      Image* dstImage,
+      const gfx::ClipF& area,
+      frame_t frame,
+      CompositeImageFunc compositeImage,
+      const color_t bgColor);
+
     bool isSolidBackground(
       const Layer* bgLayer,
       const color_t bg_color) const;
@@ -161,8 +224,29 @@ namespace render {
       const frame_t frame,
       const CompositeImageFunc compositeImage);
 
+    const Layer* onionskinLayer() const;
+
+    // Calls func(frameIn, opacity, blendMode) for each frame of the
+    // onion skin (from the first previous frame to the last next
+    // frame) that must be rendered.
+    void forEachOnionskinFrame(
+      const frame_t frame,
+      const std::function<void(frame_t, int, BlendMode)>& func);
+
     void renderPlan(
-      doc::RenderPlan& plan,
+      const doc::RenderPlan& plan,
+      Image* image,
+      const gfx::Clip& area,
+      const frame_t frame,
+      const CompositeImageFunc compositeImage,
+      const bool render_background,
+      const bool render_transparent,
+      const BlendMode blendMode);
+
+    void renderPlanItems(
+      const doc::RenderPlan::Items& items,
+      const int fromItem,
+      const int toItem,
       Image* image,
       const gfx::Clip& area,
       const frame_t frame,
@@ -183,6 +267,18 @@ namespace render {
       const int opacity,
       const BlendMode blendMode);
 
+    // Renders the image of a reference layer using a cached copy
+    // scaled with the current projection. Returns false if the image
+    // cannot be cached (and must be rendered with renderImage()).
+    bool renderScaledImage(
+      Image* dst_image,
+      const Image* cel_image,
+      const Palette* pal,
+      const gfx::RectF& celBounds,
+      const gfx::Clip& area,
+      const int opacity,
+      const BlendMode blendMode);
+
     void renderImage(
       Image* dst_image,
       const Image* cel_image,
@@ -202,7 +298,18 @@ namespace render {
 
     bool checkIfWeShouldUsePreview(const Cel* cel) const;
 
+    // Returns a copy of the given tile image with the "tileFlags"
+    // flips already applied (so it can be composited with the
+    // fastest path, as an image without flips).
+    ImageRef getFlippedTile(const Image* tileImage,
+                            const tile_flags tileFlags);
+
+    class FlippedTiles;
+    class ScaledImages;
+    class RenderPlans;
+
     int m_flags;
+    int m_maxThreads;
     int m_nonactiveLayersOpacity;
     const Sprite* m_sprite;
     const Layer* m_currentLayer;
@@ -224,6 +331,19 @@ namespace render {
     BlendMode m_previewBlendMode;
     OnionskinOptions m_onionskin;
     ImageBufferPtr m_tmpBuf;
+    RenderCache* m_cache;
+    MipmapCache* m_mipmaps;
+    // Buffers for renderSpriteBands() (image and temporary buffers
+    // for each band)
+    std::vector<std::pair<ImageBufferPtr, ImageBufferPtr>> m_bandBufs;
+    // Flipped versions of tiles used in tilemaps (shared between the
+    // copies of this Render used in renderSpriteBands())
+    std::shared_ptr<FlippedTiles> m_flippedTiles;
+    // Reference layer images scaled with the current projection
+    // (shared between copies too)
+    std::shared_ptr<ScaledImages> m_scaledImages;
+    // Render plans of each layer/frame (shared between copies too)
+    std::shared_ptr<RenderPlans> m_renderPlans;
   };
 
   void composite_image(Image* dst,
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2022 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -11,14 +11,25 @@
 #include "render/render.h"
 
 #include "doc/cel.h"
+#include "doc/grid.h"
 #include "doc/image.h"
 #include "doc/layer.h"
+#include "doc/layer_tilemap.h"
 #include "doc/palette.h"
 #include "doc/primitives.h"
 #include "doc/sprite.h"
+#include "doc/tile.h"
+#include "doc/tileset.h"
+#include "doc/tilesets.h"
+#include "render/onionskin_options.h"
+#include "render/projection.h"
+#include "render/zoom.h"
 
 #include <benchmark/benchmark.h>
 
+#include <algorithm>
+#include <memory>
+
 using namespace doc;
 using namespace render;
 
@@ -79,4 +90,213 @@ BENCHMARK(Bm_Render)
   ->Args({ 4096, 4096 })
   ->Unit(benchmark::kMicrosecond);
 
+// Document shapes found in real-world projects
+enum class DocShape {
+  Layers,      // Many semi-transparent RGB layers
+  Tilemap,     // Background + tilemap layer
+  Indexed,     // Indexed sprite with a 256 colors palette
+  Onionskin,   // Animation rendered with onion skin
+  Reference,   // Reference layer below the painting layers
+  Groups,      // Groups of layers with different blend modes
+};
+
+static const char* doc_shape_name(const DocShape shape)
+{
+  switch (shape) {
+    case DocShape::Layers: return "layers";
+    case DocShape::Tilemap: return "tilemap";
+    case DocShape::Indexed: return "indexed";
+    case DocShape::Onionskin: return "onionskin";
+    case DocShape::Reference: return "reference";
+    case DocShape::Groups: return "groups";
+  }
+  return "";
+}
+
+// Fills the image with a few overlapping rectangles which depend on
+// the given "seed" so each layer has different content.
+static void fill_layer_image(Image* img, const int seed)
+{
+  const int w = img->width();
+  const int h = img->height();
+  const bool indexed = (img->pixelFormat() == IMAGE_INDEXED);
+
+  clear_image(img, 0);
+  for (int i=0; i<4; ++i) {
+    const int k = seed*4 + i;
+    const int x = (k * 37) % std::max(1, w/2);
+    const int y = (k * 53) % std::max(1, h/2);
+    const color_t c =
+      (indexed ? color_t(1 + (k * 29) % 255):
+                 rgba((k * 71) & 255,
+                      (k * 113) & 255,
+                      (k * 157) & 255,
+                      (i == 0 ? 255: 64 + (k * 31) % 192)));
+    fill_rect(img, x, y, x + w/2, y + h/2, c);
+  }
+}
+
+static LayerImage* add_layer_with_cels(LayerGroup* parent,
+                                       Sprite* spr,
+                                       const int seed)
+{
+  auto lay = new LayerImage(spr);
+  parent->addLayer(lay);
+  for (frame_t frame=0; frame<spr->totalFrames(); ++frame) {
+    ImageRef img(Image::create(spr->pixelFormat(), spr->width(), spr->height()));
+    fill_layer_image(img.get(), seed + frame);
+    lay->addCel(new Cel(frame, img));
+  }
+  return lay;
+}
+
+static std::unique_ptr<Sprite> make_doc_shape(const DocShape shape,
+                                              const int w, const int h)
+{
+  const ColorMode colorMode =
+    (shape == DocShape::Indexed ? ColorMode::INDEXED: ColorMode::RGB);
+  std::unique_ptr<Sprite> spr(new Sprite(ImageSpec(colorMode, w, h), 256));
+  if (shape == DocShape::Onionskin)
+    spr->setTotalFrames(8);
+
+  LayerGroup* root = spr->root();
+
+  switch (shape) {
+
+    case DocShape::Layers:
+      for (int i=0; i<16; ++i)
+        add_layer_with_cels(root, spr.get(), i)->setOpacity(128 + i*8);
+      break;
+
+    case DocShape::Tilemap: {
+      add_layer_with_cels(root, spr.get(), 0)->configureAsBackground();
+
+      const Grid grid(gfx::Size(16, 16));
+      auto tileset = new Tileset(spr.get(), grid, 32);
+      for (tile_index ti=1; ti<tileset->size(); ++ti)
+        fill_layer_image(tileset->get(ti).get(), ti);
+      spr->tilesets()->add(tileset);
+
+      auto lay = new LayerTilemap(spr.get(), 0);
+      root->addLayer(lay);
+
+      ImageRef tilemap(Image::create(IMAGE_TILEMAP, w/16, h/16));
+      for (int y=0; y<tilemap->height(); ++y)
+        for (int x=0; x<tilemap->width(); ++x)
+          put_pixel(tilemap.get(), x, y, tile((x + y) % 32, 0));
+      lay->addCel(new Cel(0, tilemap));
+      break;
+    }
+
+    case DocShape::Indexed: {
+      Palette pal(0, 256);
+      for (int i=0; i<256; ++i)
+        pal.setEntry(i, rgba(i, 255-i, (i*7) & 255, 255));
+      spr->setPalette(&pal, true);
+      spr->setTransparentColor(0);
+
+      for (int i=0; i<8; ++i)
+        add_layer_with_cels(root, spr.get(), i);
+      break;
+    }
+
+    case DocShape::Onionskin:
+      for (int i=0; i<4; ++i)
+        add_layer_with_cels(root, spr.get(), i);
+      break;
+
+    case DocShape::Reference:
+      add_layer_with_cels(root, spr.get(), 0)->setReference(true);
+      for (int i=1; i<4; ++i)
+        add_layer_with_cels(root, spr.get(), i);
+      break;
+
+    case DocShape::Groups: {
+      const BlendMode modes[] = {
+        BlendMode::MULTIPLY, BlendMode::SCREEN,
+        BlendMode::OVERLAY, BlendMode::DIFFERENCE
+      };
+      for (int g=0; g<4; ++g) {
+        auto group = new LayerGroup(spr.get());
+        root->addLayer(group);
+        for (int i=0; i<4; ++i)
+          add_layer_with_cels(group, spr.get(), g*4+i)->setBlendMode(modes[(g+i) % 4]);
+      }
+      break;
+    }
+  }
+
+  return spr;
+}
+
+// Renders a 512x512 viewport of a 512x512 sprite with the given
+// shape and zoom level. Reports the number of rendered pixels per
+// second as the throughput of the configuration.
+static void Bm_RenderDocShape(benchmark::State& state)
+{
+  const DocShape shape = DocShape(state.range(0));
+  const int zNum = state.range(1);
+  const int zDen = state.range(2);
+  const int w = 512;
+  const int h = 512;
+
+  std::unique_ptr<Sprite> spr = make_doc_shape(shape, w, h);
+  const frame_t frame = (shape == DocShape::Onionskin ? 4: 0);
+
+  const Zoom zoom(zNum, zDen);
+  const int dstW = std::clamp(zoom.apply(w), 1, 512);
+  const int dstH = std::clamp(zoom.apply(h), 1, 512);
+  std::unique_ptr<Image> dst(Image::create(IMAGE_RGB, dstW, dstH));
+
+  Render render;
+  BgOptions bg;
+  bg.type = BgType::CHECKERED;
+  bg.zoom = true;
+  bg.color1 = rgba(100, 100, 100, 255);
+  bg.color2 = rgba(200, 200, 200, 255);
+  bg.stripeSize = gfx::Size(16, 16);
+  render.setBgOptions(bg);
+  render.setNewBlend(true);
+  render.setRefLayersVisiblity(true);
+  render.setProjection(Projection(PixelRatio(1, 1), zoom));
+
+  if (shape == DocShape::Onionskin) {
+    OnionskinOptions opts(OnionskinType::MERGE);
+    opts.position(OnionskinPosition::BEHIND);
+    opts.prevFrames(2);
+    opts.nextFrames(2);
+    opts.opacityBase(68);
+    opts.opacityStep(28);
+    render.setOnionskin(opts);
+  }
+
+  // Scroll to the center of the zoomed canvas
+  const int scrollX = std::max(0, (zoom.apply(w) - dstW) / 2);
+  const int scrollY = std::max(0, (zoom.apply(h) - dstH) / 2);
+
+  while (state.KeepRunning()) {
+    render.renderSprite(
+      dst.get(), spr.get(), frame,
+      gfx::Clip(0, 0, scrollX, scrollY, dstW, dstH));
+  }
+
+  state.SetLabel(doc_shape_name(shape));
+  state.SetItemsProcessed(int64_t(state.iterations()) * dstW * dstH);
+}
+
+static void doc_shape_args(benchmark::internal::Benchmark* b)
+{
+  const int zooms[][2] = {
+    { 1, 8 }, { 1, 4 }, { 1, 2 }, { 1, 1 },
+    { 2, 1 }, { 4, 1 }, { 8, 1 }, { 16, 1 }, { 32, 1 }
+  };
+  for (int shape=int(DocShape::Layers); shape<=int(DocShape::Groups); ++shape)
+    for (const auto& z : zooms)
+      b->Args({ shape, z[0], z[1] });
+}
+
+BENCHMARK(Bm_RenderDocShape)
+  ->Apply(doc_shape_args)
+  ->Unit(benchmark::kMicrosecond);
+
 BENCHMARK_MAIN();
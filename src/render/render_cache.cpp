@@ -0,0 +1,168 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "render/render_cache.h"
+
+#include "doc/image.h"
+
+#include <algorithm>
+
+namespace render {
+
+using namespace doc;
+
+bool RenderCache::Key::operator==(const Key& other) const
+{
+  return (spriteId == other.spriteId &&
+          frame == other.frame &&
+          pixelFormat == other.pixelFormat &&
+          bgColor == other.bgColor &&
+          transparentColor == other.transparentColor &&
+          paletteVersion == other.paletteVersion &&
+          scaleX == other.scaleX &&
+          scaleY == other.scaleY &&
+          flags == other.flags &&
+          nonactiveLayersOpacity == other.nonactiveLayersOpacity &&
+          selectedLayerId == other.selectedLayerId);
+}
+
+bool RenderCache::ItemVersion::operator==(const ItemVersion& other) const
+{
+  return (frame == other.frame &&
+          background == other.background &&
+          opacity == other.opacity &&
+          blendMode == other.blendMode &&
+          layerId == other.layerId &&
+          layerVersion == other.layerVersion &&
+          celId == other.celId &&
+          celVersion == other.celVersion &&
+          celDataVersion == other.celDataVersion &&
+          imageId == other.imageId &&
+          imageVersion == other.imageVersion);
+}
+
+RenderCache::RenderCache(const int maxEntries,
+                         const int maxPixels)
+  : m_maxEntries(std::max(1, maxEntries))
+  , m_maxPixels(maxPixels)
+{
+}
+
+int RenderCache::maxEntries() const
+{
+  const std::lock_guard lock(m_mutex);
+  return m_maxEntries;
+}
+
+void RenderCache::setMaxEntries(const int maxEntries)
+{
+  const std::lock_guard lock(m_mutex);
+  m_maxEntries = std::max(1, maxEntries);
+  while (int(m_entries.size()) > m_maxEntries)
+    m_entries.pop_back();
+}
+
+void RenderCache::clear()
+{
+  const std::lock_guard lock(m_mutex);
+  m_entries.clear();
+}
+
+ImageRef RenderCache::get(const Key& key,
+                          const ImageSpec& spec,
+                          const ItemVersions& versions,
+                          const RenderItemsFunc& renderItems)
+{
+  std::unique_lock lock(m_mutex);
+
+  // If other thread is rendering the same image, we wait for it
+  // instead of rendering it again.
+  m_pendingCV.wait(lock, [this, &key, &spec, &versions]{
+    return !isPending(key, spec, versions);
+  });
+
+  // Look for the entry with more valid items
+  auto best = m_entries.end();
+  int bestItems = -1;
+  for (auto it=m_entries.begin(); it!=m_entries.end(); ++it) {
+    const Entry& entry = *it;
+    if (entry.key != key ||
+        entry.image->width() != spec.width() ||
+        entry.image->height() != spec.height() ||
+        entry.versions.size() > versions.size() ||
+        int(entry.versions.size()) <= bestItems ||
+        !std::equal(entry.versions.begin(),
+                    entry.versions.end(),
+                    versions.begin()))
+      continue;
+
+    best = it;
+    bestItems = int(entry.versions.size());
+  }
+
+  // Exact match
+  if (bestItems == int(versions.size())) {
+    m_entries.splice(m_entries.begin(), m_entries, best);
+    return m_entries.front().image;
+  }
+
+  Entry entry;
+  entry.key = key;
+  entry.versions = versions;
+  if (best != m_entries.end()) {
+    // Continue from the image with some valid items
+    entry.image.reset(Image::createCopy(best->image.get()));
+  }
+  else {
+    entry.image.reset(Image::create(spec));
+    entry.image->clear(key.bgColor);
+    bestItems = 0;
+  }
+
+  // Render the missing items without the lock
+  m_pending.push_front(Entry{ key, versions, entry.image });
+  auto pendingIt = m_pending.begin();
+  lock.unlock();
+  try {
+    renderItems(entry.image.get(), bestItems, int(versions.size()));
+  }
+  catch (...) {
+    lock.lock();
+    m_pending.erase(pendingIt);
+    m_pendingCV.notify_all();
+    throw;
+  }
+  lock.lock();
+  m_pending.erase(pendingIt);
+
+  ImageRef image = entry.image;
+  m_entries.push_front(std::move(entry));
+  while (int(m_entries.size()) > m_maxEntries)
+    m_entries.pop_back();
+
+  m_pendingCV.notify_all();
+  return image;
+}
+
+bool RenderCache::isPending(const Key& key,
+                            const ImageSpec& spec,
+                            const ItemVersions& versions) const
+{
+  for (const Entry& entry : m_pending) {
+    if (entry.key == key &&
+        entry.image->width() == spec.width() &&
+        entry.image->height() == spec.height() &&
+        entry.versions == versions)
+      return true;
+  }
+  return false;
+}
+
+} // namespace render
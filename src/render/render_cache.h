@@ -0,0 +1,130 @@
+// Aseprite Render Library
+// Copyright (c) 2024 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef RENDER_RENDER_CACHE_H_INCLUDED
+#define RENDER_RENDER_CACHE_H_INCLUDED
+#pragma once
+
+#include "doc/blend_mode.h"
+#include "doc/color.h"
+#include "doc/frame.h"
+#include "doc/image_ref.h"
+#include "doc/object_id.h"
+#include "doc/object_version.h"
+#include "doc/pixel_format.h"
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <vector>
+
+namespace render {
+
+  // Cache of the composited bottom layers of a sprite (all the layers
+  // below the layer that is being edited, and the onion skin frames
+  // behind the sprite), so render::Render doesn't need to composite
+  // all those layers again on each repaint.
+  //
+  // Each cached image contains the whole projected sprite, and it's
+  // valid while the versions of all the cached layers/cels/images
+  // are the same.
+  class RenderCache {
+  public:
+    // Everything that affects the rendered image apart from the
+    // layers/cels themselves.
+    struct Key {
+      doc::ObjectId spriteId = 0;
+      doc::frame_t frame = 0;
+      doc::PixelFormat pixelFormat = doc::IMAGE_RGB;
+      doc::color_t bgColor = 0;
+      doc::color_t transparentColor = 0;
+      doc::ObjectVersion paletteVersion = 0;
+      double scaleX = 1.0;
+      double scaleY = 1.0;
+      int flags = 0;
+      int nonactiveLayersOpacity = 255;
+      doc::ObjectId selectedLayerId = 0;
+
+      bool operator==(const Key& other) const;
+      bool operator!=(const Key& other) const { return !operator==(other); }
+    };
+
+    // Versions of each item of a doc::RenderPlan included in a
+    // cached image, and how it was rendered (the same item can be
+    // rendered in several frames for the onion skin).
+    struct ItemVersion {
+      doc::frame_t frame = 0;
+      bool background = false;
+      int opacity = 255;
+      doc::BlendMode blendMode = doc::BlendMode::UNSPECIFIED;
+      doc::ObjectId layerId = 0;
+      doc::ObjectVersion layerVersion = 0;
+      doc::ObjectId celId = 0;
+      doc::ObjectVersion celVersion = 0;
+      doc::ObjectVersion celDataVersion = 0;
+      doc::ObjectId imageId = 0;
+      doc::ObjectVersion imageVersion = 0;
+
+      bool operator==(const ItemVersion& other) const;
+      bool operator!=(const ItemVersion& other) const { return !operator==(other); }
+    };
+    using ItemVersions = std::vector<ItemVersion>;
+
+    // Function to render the given range of items [fromItem, toItem)
+    // in the given image (which is as big as the projected sprite).
+    using RenderItemsFunc =
+      std::function<void(doc::Image* image, int fromItem, int toItem)>;
+
+    RenderCache(const int maxEntries = 2,
+                const int maxPixels = 2048*2048);
+
+    int maxPixels() const { return m_maxPixels; }
+
+    // Maximum number of cached images (e.g. it can be increased to
+    // keep the rendered frames of the animation while it's played).
+    int maxEntries() const;
+    void setMaxEntries(const int maxEntries);
+
+    void clear();
+
+    // Returns an image with all the given items rendered. If there
+    // is no cached image (or it contains only some of these items),
+    // renderItems() is called to render the missing items and the
+    // result is cached.
+    //
+    // The items are rendered without locking the cache, so other
+    // threads can get other cached images in the meantime (only the
+    // threads asking for the same image wait for it).
+    doc::ImageRef get(const Key& key,
+                      const doc::ImageSpec& spec,
+                      const ItemVersions& versions,
+                      const RenderItemsFunc& renderItems);
+
+  private:
+    struct Entry {
+      Key key;
+      ItemVersions versions;
+      doc::ImageRef image;
+    };
+
+    bool isPending(const Key& key,
+                   const doc::ImageSpec& spec,
+                   const ItemVersions& versions) const;
+
+    int m_maxEntries;
+    const int m_maxPixels;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_pendingCV;
+    // Most recently used entries first
+    std::list<Entry> m_entries;
+    // Entries that are being rendered (without image)
+    std::list<Entry> m_pending;
+  };
+
+} // namespace render
+
+#endif
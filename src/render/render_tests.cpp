@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2023 Igara Studio S.A.
+// Copyright (c) 2019-2024 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -11,15 +11,23 @@
 
 #include <gtest/gtest.h>
 
+#include "render/mipmap_cache.h"
 #include "render/render.h"
+#include "render/render_cache.h"
 
 #include "doc/cel.h"
 #include "doc/document.h"
 #include "doc/image.h"
+#include "doc/grid.h"
 #include "doc/layer.h"
+#include "doc/layer_tilemap.h"
 #include "doc/palette.h"
 #include "doc/primitives.h"
+#include "doc/sprite.h"
+#include "doc/tileset.h"
+#include "doc/tilesets.h"
 
+#include <cstdlib>
 #include <memory>
 
 using namespace doc;
@@ -277,6 +285,319 @@ TEST(Render, BugWithMultiplesOf3ZoomFactors)
   }
 }
 
+TEST(Render, ZoomOutWithBoxFilter)
+{
+  // Create this image:
+  // R G 0 0
+  // B W 0 0
+  // W W R R
+  // W W R 0
+  std::shared_ptr<Document> doc = std::make_shared<Document>();
+  doc->sprites().add(Sprite::MakeStdSprite(ImageSpec(ColorMode::RGB, 4, 4)));
+  Image* src = doc->sprite()->root()->firstLayer()->cel(0)->image();
+  const color_t R = rgba(255, 0, 0, 255);
+  const color_t G = rgba(0, 255, 0, 255);
+  const color_t B = rgba(0, 0, 255, 255);
+  const color_t W = rgba(255, 255, 255, 255);
+  clear_image(src, 0);
+  put_pixel(src, 0, 0, R);
+  put_pixel(src, 1, 0, G);
+  put_pixel(src, 0, 1, B);
+  put_pixel(src, 1, 1, W);
+  fill_rect(src, 0, 2, 1, 3, W);
+  fill_rect(src, 2, 2, 3, 2, R);
+  put_pixel(src, 2, 3, R);
+
+  std::unique_ptr<Image> dst(Image::create(IMAGE_RGB, 2, 2));
+
+  Render render;
+  BgOptions bg;
+  bg.type = BgType::TRANSPARENT;
+  render.setBgOptions(bg);
+  render.setProjection(Projection(PixelRatio(1, 1), Zoom(1, 2)));
+
+  // Nearest neighbor (top-left pixel of each 2x2 block)
+  clear_image(dst.get(), 0);
+  render.renderSprite(dst.get(), doc->sprite(), frame_t(0),
+                      gfx::Clip(0, 0, 0, 0, 2, 2));
+  EXPECT_2X2_PIXELS(dst.get(), R, 0, W, R);
+
+  // Box filter (average of each 2x2 block with premultiplied alpha)
+  render.setBoxFilterScaleDown(true);
+  clear_image(dst.get(), 0);
+  render.renderSprite(dst.get(), doc->sprite(), frame_t(0),
+                      gfx::Clip(0, 0, 0, 0, 2, 2));
+  EXPECT_2X2_PIXELS(dst.get(),
+                    rgba(127, 127, 127, 255), 0,
+                    W, rgba(255, 0, 0, 191));
+}
+
+TEST(Render, ZoomOutWithBoxFilterAndMipmaps)
+{
+  std::shared_ptr<Document> doc = std::make_shared<Document>();
+  doc->sprites().add(Sprite::MakeStdSprite(ImageSpec(ColorMode::RGB, 64, 64)));
+  Image* src = doc->sprite()->root()->firstLayer()->cel(0)->image();
+  for (int y=0; y<src->height(); ++y)
+    for (int x=0; x<src->width(); ++x)
+      put_pixel(src, x, y, rgba(x*4, y*4, (x*y) & 255, (x+y) & 1 ? 255: 128));
+  fill_rect(src, 0, 0, 15, 15, 0);
+
+  std::unique_ptr<Image> dst1(Image::create(IMAGE_RGB, 16, 16));
+  std::unique_ptr<Image> dst2(Image::create(IMAGE_RGB, 16, 16));
+
+  MipmapCache mipmaps(1024*1024, 1);
+  Render render1, render2;
+  for (Render* render : { &render1, &render2 }) {
+    BgOptions bg;
+    bg.type = BgType::TRANSPARENT;
+    render->setBgOptions(bg);
+    render->setProjection(Projection(PixelRatio(1, 1), Zoom(1, 4)));
+    render->setBoxFilterScaleDown(true);
+  }
+  render2.setMipmapCache(&mipmaps);
+
+  // The average of the averages can be a little different (rounding
+  // errors)
+  for (int i=0; i<2; ++i) {
+    clear_image(dst1.get(), 0);
+    clear_image(dst2.get(), 0);
+    render1.renderSprite(dst1.get(), doc->sprite(), frame_t(0),
+                         gfx::Clip(0, 0, 0, 0, 16, 16));
+    render2.renderSprite(dst2.get(), doc->sprite(), frame_t(0),
+                         gfx::Clip(0, 0, 0, 0, 16, 16));
+    for (int y=0; y<16; ++y) {
+      for (int x=0; x<16; ++x) {
+        const color_t a = get_pixel(dst1.get(), x, y);
+        const color_t b = get_pixel(dst2.get(), x, y);
+        EXPECT_LE(std::abs(int(rgba_getr(a)) - int(rgba_getr(b))), 2);
+        EXPECT_LE(std::abs(int(rgba_getg(a)) - int(rgba_getg(b))), 2);
+        EXPECT_LE(std::abs(int(rgba_getb(a)) - int(rgba_getb(b))), 2);
+        EXPECT_LE(std::abs(int(rgba_geta(a)) - int(rgba_geta(b))), 2);
+      }
+    }
+  }
+  EXPECT_EQ(0, get_pixel(dst2.get(), 1, 1));
+
+  // Mipmaps of the previous version of the image are not used
+  const color_t R = rgba(255, 0, 0, 255);
+  clear_image(src, R);
+  src->incrementVersion();
+  render2.renderSprite(dst2.get(), doc->sprite(), frame_t(0),
+                       gfx::Clip(0, 0, 0, 0, 16, 16));
+  for (int y=0; y<16; ++y)
+    for (int x=0; x<16; ++x)
+      EXPECT_EQ(R, get_pixel(dst2.get(), x, y));
+}
+
+TEST(Render, CachedOnionskinBehind)
+{
+  std::shared_ptr<Document> doc = std::make_shared<Document>();
+  doc->sprites().add(Sprite::MakeStdSprite(ImageSpec(ColorMode::RGB, 8, 8)));
+  Sprite* spr = doc->sprite();
+  spr->setTotalFrames(5);
+
+  LayerImage* lay = static_cast<LayerImage*>(spr->root()->firstLayer());
+  for (frame_t frame=0; frame<spr->totalFrames(); ++frame) {
+    Image* img;
+    if (frame == 0) {
+      img = lay->cel(0)->image();
+    }
+    else {
+      ImageRef imgRef(Image::create(IMAGE_RGB, 8, 8));
+      img = imgRef.get();
+      lay->addCel(new Cel(frame, imgRef));
+    }
+    clear_image(img, 0);
+    fill_rect(img, frame, frame, frame+3, frame+3,
+              rgba(64*frame, 255-64*frame, 128, 200));
+  }
+
+  OnionskinOptions opts(OnionskinType::MERGE);
+  opts.position(OnionskinPosition::BEHIND);
+  opts.prevFrames(2);
+  opts.nextFrames(2);
+  opts.opacityBase(128);
+  opts.opacityStep(32);
+
+  RenderCache cache;
+  Render render1, render2;
+  for (Render* render : { &render1, &render2 }) {
+    BgOptions bg;
+    bg.type = BgType::CHECKERED;
+    bg.color1 = rgba(128, 128, 128, 255);
+    bg.color2 = rgba(64, 64, 64, 255);
+    bg.stripeSize = gfx::Size(2, 2);
+    render->setBgOptions(bg);
+    render->setOnionskin(opts);
+  }
+  render2.setCache(&cache);
+
+  std::unique_ptr<Image> dst1(Image::create(IMAGE_RGB, 8, 8));
+  std::unique_ptr<Image> dst2(Image::create(IMAGE_RGB, 8, 8));
+
+  for (int i=0; i<3; ++i) {
+    // Modify the current frame between renders (the cached ghost
+    // frames must be the same)
+    if (i == 2) {
+      Image* img = lay->cel(2)->image();
+      fill_rect(img, 0, 0, 1, 1, rgba(255, 0, 0, 255));
+      img->incrementVersion();
+    }
+
+    render1.renderSprite(dst1.get(), spr, frame_t(2));
+    render2.renderSprite(dst2.get(), spr, frame_t(2));
+    EXPECT_EQ(0, count_diff_between_images(dst1.get(), dst2.get()))
+      << "iteration " << i;
+  }
+}
+
+TEST(Render, FlippedTiles)
+{
+  std::shared_ptr<Document> doc = std::make_shared<Document>();
+  doc->sprites().add(new Sprite(ImageSpec(ColorMode::INDEXED, 4, 2), 256));
+  Sprite* spr = doc->sprite();
+
+  // 1 2
+  // 3 4
+  auto tileset = new Tileset(spr, Grid(gfx::Size(2, 2)), 1);
+  ImageRef tileImg(Image::create(IMAGE_INDEXED, 2, 2));
+  put_pixel(tileImg.get(), 0, 0, 1);
+  put_pixel(tileImg.get(), 1, 0, 2);
+  put_pixel(tileImg.get(), 0, 1, 3);
+  put_pixel(tileImg.get(), 1, 1, 4);
+  tileset->add(tileImg);
+  const tileset_index tsi = spr->tilesets()->add(tileset);
+
+  auto lay = new LayerTilemap(spr, tsi);
+  spr->root()->addLayer(lay);
+
+  ImageRef tilemap(Image::create(IMAGE_TILEMAP, 2, 1));
+  put_pixel(tilemap.get(), 0, 0, tile(1, 0));
+  put_pixel(tilemap.get(), 1, 0, tile(1, tile_f_xflip | tile_f_dflip));
+  lay->addCel(new Cel(0, tilemap));
+
+  Render render;
+  std::unique_ptr<Image> dst(Image::create(IMAGE_INDEXED, 4, 2));
+  clear_image(dst.get(), 0);
+  render.renderSprite(dst.get(), spr, frame_t(0));
+  EXPECT_EQ(1, get_pixel(dst.get(), 0, 0));
+  EXPECT_EQ(2, get_pixel(dst.get(), 1, 0));
+  EXPECT_EQ(3, get_pixel(dst.get(), 2, 0));
+  EXPECT_EQ(1, get_pixel(dst.get(), 3, 0));
+  EXPECT_EQ(3, get_pixel(dst.get(), 0, 1));
+  EXPECT_EQ(4, get_pixel(dst.get(), 1, 1));
+  EXPECT_EQ(4, get_pixel(dst.get(), 2, 1));
+  EXPECT_EQ(2, get_pixel(dst.get(), 3, 1));
+
+  // Zoom 2x and 3x must use the same flipped tile
+  for (int zoom=2; zoom<=3; ++zoom) {
+    std::unique_ptr<Image> dst2(Image::create(IMAGE_INDEXED, 4*zoom, 2*zoom));
+    clear_image(dst2.get(), 0);
+    render.setProjection(Projection(PixelRatio(1, 1), Zoom(zoom, 1)));
+    render.renderSprite(dst2.get(), spr, frame_t(0));
+    for (int y=0; y<dst2->height(); ++y)
+      for (int x=0; x<dst2->width(); ++x)
+        EXPECT_EQ(get_pixel(dst.get(), x/zoom, y/zoom),
+                  get_pixel(dst2.get(), x, y)) << "zoom " << zoom
+                                               << " pixel " << x << "," << y;
+  }
+}
+
+TEST(Render, SparseTilemap)
+{
+  std::shared_ptr<Document> doc = std::make_shared<Document>();
+  doc->sprites().add(new Sprite(ImageSpec(ColorMode::INDEXED, 16, 16), 256));
+  Sprite* spr = doc->sprite();
+
+  auto tileset = new Tileset(spr, Grid(gfx::Size(2, 2)), 1);
+  ImageRef tileImg(Image::create(IMAGE_INDEXED, 2, 2));
+  clear_image(tileImg.get(), 5);
+  tileset->add(tileImg);
+  const tileset_index tsi = spr->tilesets()->add(tileset);
+
+  auto lay = new LayerTilemap(spr, tsi);
+  spr->root()->addLayer(lay);
+
+  // Only 3 tiles in a 8x8 tilemap, the rest are empty
+  ImageRef tilemap(Image::create(IMAGE_TILEMAP, 8, 8));
+  clear_image(tilemap.get(), notile);
+  put_pixel(tilemap.get(), 0, 0, tile(1, 0));
+  put_pixel(tilemap.get(), 7, 3, tile(1, 0));
+  put_pixel(tilemap.get(), 3, 7, tile(1, 0));
+  lay->addCel(new Cel(0, tilemap));
+
+  Render render;
+  std::unique_ptr<Image> dst(Image::create(IMAGE_INDEXED, 16, 16));
+  clear_image(dst.get(), 0);
+  render.renderSprite(dst.get(), spr, frame_t(0));
+  for (int y=0; y<16; ++y) {
+    for (int x=0; x<16; ++x) {
+      const int u = x/2, v = y/2;
+      const bool hasTile = ((u == 0 && v == 0) ||
+                            (u == 7 && v == 3) ||
+                            (u == 3 && v == 7));
+      EXPECT_EQ(hasTile ? 5: 0, get_pixel(dst.get(), x, y))
+        << "pixel " << x << "," << y;
+    }
+  }
+}
+
+TEST(Render, ScaledReferenceLayer)
+{
+  std::shared_ptr<Document> doc = std::make_shared<Document>();
+  doc->sprites().add(Sprite::MakeStdSprite(ImageSpec(ColorMode::RGB, 4, 4)));
+  Sprite* spr = doc->sprite();
+  Layer* layer = spr->root()->firstLayer();
+  layer->setReference(true);
+  Cel* cel = layer->cel(0);
+  cel->setBoundsF(gfx::RectF(0.5, 0.5, 3, 3));
+  Image* src = cel->image();
+  for (int y=0; y<4; ++y)
+    for (int x=0; x<4; ++x)
+      put_pixel(src, x, y, rgba(x*64, y*64, 0, 255));
+
+  Render render;
+  BgOptions bg;
+  bg.type = BgType::TRANSPARENT;
+  render.setBgOptions(bg);
+  render.setRefLayersVisiblity(true);
+
+  // Zoom 2x: the 4x4 image is scaled 1.5x and starts at (1, 1)
+  const int map[8] = { -1, 0, 0, 1, 2, 2, 3, -1 };
+  render.setProjection(Projection(PixelRatio(1, 1), Zoom(2, 1)));
+
+  std::unique_ptr<Image> dst(Image::create(IMAGE_RGB, 8, 8));
+  for (int i=0; i<3; ++i) {
+    // The third time the image is modified
+    if (i == 2) {
+      put_pixel(src, 3, 3, rgba(255, 255, 255, 255));
+      src->incrementVersion();
+    }
+
+    clear_image(dst.get(), 0);
+    render.renderSprite(dst.get(), spr, frame_t(0),
+                        gfx::Clip(0, 0, 0, 0, 8, 8));
+    for (int y=0; y<8; ++y) {
+      for (int x=0; x<8; ++x) {
+        const color_t expected =
+          (map[x] < 0 || map[y] < 0 ? 0: get_pixel(src, map[x], map[y]));
+        EXPECT_EQ(expected, get_pixel(dst.get(), x, y))
+          << "render " << i << " pixel " << x << "," << y;
+      }
+    }
+  }
+
+  // Parts of the area are rendered in the same position
+  std::unique_ptr<Image> dst2(Image::create(IMAGE_RGB, 3, 3));
+  clear_image(dst2.get(), 0);
+  render.renderSprite(dst2.get(), spr, frame_t(0),
+                      gfx::Clip(0, 0, 2, 3, 3, 3));
+  for (int y=0; y<3; ++y)
+    for (int x=0; x<3; ++x)
+      EXPECT_EQ(get_pixel(dst.get(), x+2, y+3),
+                get_pixel(dst2.get(), x, y)) << "pixel " << x << "," << y;
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
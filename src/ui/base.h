@@ -1,5 +1,5 @@
 // Aseprite UI Library
-// Copyright (C) 2018-2020  Igara Studio S.A.
+// Copyright (C) 2018-2024  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -29,8 +29,9 @@ namespace ui {
     DOUBLE_BUFFERED  = 0x00002000, // The widget is painted in a back-buffer and then flipped to the main display
     TRANSPARENT      = 0x00004000, // The widget has transparent parts that needs the background painted before
     CTRL_RIGHT_CLICK = 0x00008000, // The widget should transform Ctrl+click to right-click on OS X.
+    FULL_MOUSE_HISTORY = 0x40000000, // Receive all kMouseMoveMessages (consecutive mouse movements aren't compressed).
     IGNORE_MOUSE     = 0x80000000, // Don't process mouse messages for this widget (useful for labels, boxes, grids, etc.)
-    PROPERTIES_MASK  = 0x8000ffff,
+    PROPERTIES_MASK  = 0xc000ffff,
 
     HORIZONTAL       = 0x00010000,
     VERTICAL         = 0x00020000,
@@ -43,7 +44,7 @@ namespace ui {
     HOMOGENEOUS      = 0x01000000,
     WORDWRAP         = 0x02000000,
     CHARWRAP         = 0x04000000,
-    ALIGN_MASK       = 0x7fff0000,
+    ALIGN_MASK       = 0x3fff0000,
   };
 
 } // namespace ui
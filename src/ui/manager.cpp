@@ -9,6 +9,8 @@
 // #define REPORT_FOCUS_MOVEMENT
 // #define DEBUG_PAINT_EVENTS
 // #define LIMIT_DISPATCH_TIME
+// #define LIMIT_PAINT_TIME
+// #define REPORT_PAINT_TIMES
 // #define DEBUG_UI_THREADS
 #define GARBAGE_TRACE(...)
 
@@ -18,6 +20,7 @@
 
 #include "ui/manager.h"
 
+#include "base/chrono.h"
 #include "base/concurrent_queue.h"
 #include "base/scoped_value.h"
 #include "base/thread.h"
@@ -42,6 +45,12 @@
 #include <utility>
 #include <vector>
 
+#ifdef REPORT_PAINT_TIMES
+#include <map>
+#include <string>
+#include <typeinfo>
+#endif
+
 #if defined(_WIN32) && defined(DEBUG_PAINT_EVENTS)
   #define WIN32_LEAN_AND_MEAN
   #include <windows.h>
@@ -93,6 +102,52 @@ static base::concurrent_queue<Message*> concurrent_msg_queue;
 static Filters msg_filters[NFILTERS]; // Filters for every enqueued message
 static int filter_locks = 0;
 
+#ifdef LIMIT_PAINT_TIME
+// Maximum time (in seconds) to process kPaintMessages in each frame,
+// the rest of the invalidated areas are painted in the next frame.
+static constexpr double kPaintTimeBudget = 1.0 / 60.0;
+#endif
+
+#ifdef REPORT_PAINT_TIMES
+struct PaintTime {
+  int count = 0;
+  double total = 0.0;           // Time in seconds
+  double max = 0.0;
+};
+static std::map<std::string, PaintTime> paint_times; // Painting time by widget type
+static base::Chrono paint_times_chrono;
+
+static void add_paint_time(Widget* widget, const double elapsed)
+{
+  PaintTime& t = paint_times[typeid(*widget).name()];
+  ++t.count;
+  t.total += elapsed;
+  t.max = std::max(t.max, elapsed);
+}
+
+// Reports the time spent painting each widget type each second
+static void report_paint_times()
+{
+  if (paint_times_chrono.elapsed() < 1.0)
+    return;
+
+  std::vector<std::pair<std::string, PaintTime>> items(paint_times.begin(),
+                                                       paint_times.end());
+  std::sort(items.begin(), items.end(),
+            [](const auto& a, const auto& b){
+              return a.second.total > b.second.total;
+            });
+  for (const auto& item : items) {
+    TRACEARGS("PAINT", item.first,
+              item.second.count, "msgs",
+              item.second.total*1000.0, "ms",
+              "( max", item.second.max*1000.0, "ms )");
+  }
+  paint_times.clear();
+  paint_times_chrono.reset();
+}
+#endif
+
 // Current display with the mouse, used to avoid processing a
 // os::Event::MouseLeave of the non-current display/window as when we
 // move the mouse between two windows we can receive:
@@ -628,7 +683,7 @@ void Manager::handleMouseMove(Display* display,
 
   // Send the mouse movement message
   Widget* dst = (capture_widget ? capture_widget: mouse_widget);
-  enqueueMessage(
+  Message* msg =
     newMouseMessage(
       kMouseMoveMessage,
       display, dst,
@@ -638,7 +693,30 @@ void Manager::handleMouseMove(Display* display,
       modifiers,
       gfx::Point(0, 0),
       false,
-      pressure));
+      pressure);
+
+  // If the last enqueued message is a mouse movement for the same
+  // widget (and it wasn't processed yet), we replace it with the new
+  // one, so we don't process outdated positions when the UI is busy
+  // (e.g. dragging a big selection). Widgets with FULL_MOUSE_HISTORY
+  // (e.g. the editor drawing with a freehand tool) receive all
+  // movements.
+  if (!msg_queue.empty() &&
+      dst && !dst->hasFlags(FULL_MOUSE_HISTORY)) {
+    auto last = static_cast<MouseMessage*>(msg_queue.back());
+    auto mouseMsg = static_cast<MouseMessage*>(msg);
+    if (last->type() == kMouseMoveMessage &&
+        last->recipient() == dst &&
+        last->display() == mouseMsg->display() &&
+        last->modifiers() == mouseMsg->modifiers() &&
+        last->button() == mouseMsg->button() &&
+        last->pointerType() == mouseMsg->pointerType()) {
+      msg_queue.pop_back();
+      delete last;
+    }
+  }
+
+  enqueueMessage(msg);
 }
 
 void Manager::handleMouseDown(Display* display,
@@ -884,6 +962,10 @@ void Manager::dispatchMessages()
 
       // Flip back-buffers to real displays.
       flipAllDisplays();
+
+#ifdef REPORT_PAINT_TIMES
+      report_paint_times();
+#endif
     }
   }
 }
@@ -1249,6 +1331,25 @@ void Manager::removePaintMessagesForDisplay(Display* display)
   }
 }
 
+void Manager::mergePaintMessagesFor(Widget* widget, gfx::Region& region)
+{
+#ifdef DEBUG_UI_THREADS
+  ASSERT(manager_thread == std::this_thread::get_id());
+#endif
+
+  for (auto it=msg_queue.begin(); it != msg_queue.end(); ) {
+    Message* msg = *it;
+    if (msg->type() == kPaintMessage &&
+        msg->recipient() == widget) {
+      region |= gfx::Region(static_cast<PaintMessage*>(msg)->rect());
+      delete msg;
+      it = msg_queue.erase(it);
+    }
+    else
+      ++it;
+  }
+}
+
 void Manager::addMessageFilter(int message, Widget* widget)
 {
 #ifdef DEBUG_UI_THREADS
@@ -1849,6 +1950,9 @@ int Manager::pumpQueue()
 #ifdef LIMIT_DISPATCH_TIME
   base::tick_t t = base::current_tick();
 #endif
+#ifdef LIMIT_PAINT_TIME
+  base::Chrono paintChrono;
+#endif
 
   int count = 0;                // Number of processed messages
   while (!msg_queue.empty()) {
@@ -1857,6 +1961,32 @@ int Manager::pumpQueue()
       break;
 #endif
 
+#ifdef LIMIT_PAINT_TIME
+    // If we've spent the whole paint budget, the pending paint
+    // messages are converted back to invalidated regions, so they are
+    // painted (with their children) in the next frame in the correct
+    // order.
+    if (count > 0 &&
+        msg_queue.front()->type() == kPaintMessage &&
+        paintChrono.elapsed() > kPaintTimeBudget) {
+      for (auto it=msg_queue.begin(); it != msg_queue.end(); ) {
+        Message* msg = *it;
+        if (msg->type() == kPaintMessage) {
+          if (Widget* widget = msg->recipient())
+            widget->invalidateRect(static_cast<PaintMessage*>(msg)->rect());
+          delete msg;
+          it = msg_queue.erase(it);
+        }
+        else
+          ++it;
+      }
+      if (redrawState == RedrawState::Normal)
+        redrawState = RedrawState::RedrawDelayed;
+      if (msg_queue.empty())
+        break;
+    }
+#endif
+
     // The message to process
     auto it = msg_queue.begin();
     Message* msg = *it;
@@ -2013,8 +2143,16 @@ bool Manager::sendMessageToWidget(Message* msg, Widget* widget)
       }
 #endif
 
+#ifdef REPORT_PAINT_TIMES
+      base::Chrono chrono;
+#endif
+
       // Call the message handler
       used = widget->sendMessage(msg);
+
+#ifdef REPORT_PAINT_TIMES
+      add_paint_time(widget, chrono.elapsed());
+#endif
     }
 
     // Restore clip region for paint messages.
@@ -87,6 +87,11 @@ namespace ui {
     void removeMessagesForDisplay(Display* display);
     void removePaintMessagesForDisplay(Display* display);
 
+    // Removes the enqueued kPaintMessages of the given widget adding
+    // their rectangles to "region" (so the widget can paint the whole
+    // area with a new set of messages).
+    void mergePaintMessagesFor(Widget* widget, gfx::Region& region);
+
     void addMessageFilter(int message, Widget* widget);
     void removeMessageFilter(int message, Widget* widget);
     void removeMessageFilterFor(Widget* widget);
@@ -49,6 +49,10 @@ namespace ui {
 
 using namespace gfx;
 
+// Maximum number of rectangles to paint a widget before trying to
+// paint the bounds of the invalidated region in just one message.
+static constexpr std::size_t kMaxPaintRects = 16;
+
 WidgetType register_widget_type()
 {
   static int type = (int)kFirstUserWidget;
@@ -1096,11 +1100,30 @@ void Widget::flushRedraw()
     }
 
     if (!widget->m_updateRegion.isEmpty()) {
+      // Paint messages of this widget that weren't processed yet
+      // (e.g. from a previous flushRedraw() round) are merged with
+      // the new region, so each area is painted just once.
+      manager->mergePaintMessagesFor(widget, widget->m_updateRegion);
+
       // Intersect m_updateRegion with drawable area.
       {
         Region drawable;
         widget->getDrawableRegion(drawable, kCutTopWindows);
         widget->m_updateRegion &= drawable;
+
+        // If the region is too fragmented, we paint its bounds in one
+        // step (one paint message) when it's completely drawable and
+        // it doesn't add too much extra area to paint.
+        if (widget->m_updateRegion.size() > kMaxPaintRects) {
+          const gfx::Rect bounds = widget->m_updateRegion.bounds();
+          if (drawable.contains(bounds) == Region::In) {
+            int area = 0;
+            for (const gfx::Rect& rc : widget->m_updateRegion)
+              area += rc.w * rc.h;
+            if (area >= bounds.w * bounds.h / 2)
+              widget->m_updateRegion = Region(bounds);
+          }
+        }
       }
 
       std::size_t c, nrects = widget->m_updateRegion.size();
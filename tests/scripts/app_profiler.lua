@@ -0,0 +1,35 @@
+-- Copyright (C) 2024  Igara Studio S.A.
+--
+-- This file is released under the terms of the MIT license.
+-- Read LICENSE.txt for more information.
+
+assert(not app.profiler.isRunning)
+app.profiler.start(100)
+assert(app.profiler.isRunning)
+
+local function slow()
+  local s = 0
+  for i=1,100000 do s = s + i end
+  return s
+end
+slow()
+
+local fn = os.tmpname()
+local report = app.profiler.stop(fn)
+assert(not app.profiler.isRunning)
+assert(report:find("Functions"))
+assert(report:find("slow"))
+
+-- Each line of the file is a stack and the time in microseconds
+local f = io.open(fn)
+local n = 0
+for line in f:lines() do
+  assert(line:match("^script;.* %d+$"))
+  n = n + 1
+end
+f:close()
+os.remove(fn)
+assert(n > 0)
+
+-- Stopping an stopped profiler returns an empty report
+assert(app.profiler.stop() == "")
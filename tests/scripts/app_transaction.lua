@@ -38,3 +38,32 @@ assert(s.height == 32)
 app.redo()
 assert(s.width == 20)
 assert(s.height == 40)
+
+-- app.batch() works like app.transaction() (one undo step)
+do
+  local spr = Sprite(32, 32)
+  for i=1,9 do spr:newCel(spr:newLayer(), 1) end
+  app.batch(
+    "Move Cels",
+    function()
+      for _,cel in ipairs(spr.cels) do
+        cel.position = Point(2, 3)
+      end
+    end)
+  for _,cel in ipairs(spr.cels) do
+    assert(cel.position == Point(2, 3))
+  end
+
+  app.undo()
+  for _,cel in ipairs(spr.cels) do
+    assert(cel.position == Point(0, 0))
+  end
+
+  -- Errors rollback the changes
+  local ok = pcall(app.batch, function()
+                     spr.cels[1].position = Point(5, 5)
+                     error("fail")
+                   end)
+  assert(not ok)
+  assert(spr.cels[1].position == Point(0, 0))
+end
@@ -1,4 +1,4 @@
--- Copyright (C) 2018-2022  Igara Studio S.A.
+-- Copyright (C) 2018-2024  Igara Studio S.A.
 --
 -- This file is released under the terms of the MIT license.
 -- Read LICENSE.txt for more information.
@@ -66,6 +66,35 @@ do
    assert(r:getPixel(2, 2) == pc.rgba(255, 255, 0, 255))
 end
 
+-- Image:drawSpriteFrames
+do
+   local spr = Sprite(2, 2)
+   spr:newFrame()
+   spr:newFrame()
+   spr.cels[1].image:putPixel(0, 0, pc.rgba(255, 0, 0, 255))
+   spr.cels[2].image:clear()
+   spr.cels[2].image:putPixel(1, 0, pc.rgba(0, 255, 0, 255))
+   spr.cels[3].image:clear()
+   spr.cels[3].image:putPixel(0, 1, pc.rgba(0, 0, 255, 255))
+
+   -- 3 frames in 2 columns
+   local r = Image(4, 4, spr.colorMode)
+   r:drawSpriteFrames{ sprite=spr, columns=2 }
+   assert(r:getPixel(0, 0) == pc.rgba(255, 0, 0, 255))
+   assert(r:getPixel(3, 0) == pc.rgba(0, 255, 0, 255))
+   assert(r:getPixel(0, 3) == pc.rgba(0, 0, 255, 255))
+   assert(r:getPixel(2, 2) == pc.rgba(0, 0, 0, 0))
+
+   -- Only some frames in one row from a position
+   r = Image(5, 2, spr.colorMode)
+   r:drawSpriteFrames{ sprite=spr, frames={ 3, spr.frames[1] }, position=Point(1, 0) }
+   assert(r:getPixel(0, 0) == pc.rgba(0, 0, 0, 0))
+   assert(r:getPixel(1, 1) == pc.rgba(0, 0, 255, 255))
+   assert(r:getPixel(3, 0) == pc.rgba(255, 0, 0, 255))
+
+   assert(not pcall(function() r:drawSpriteFrames{ sprite=spr, frames={ 4 } } end))
+end
+
 
 -- Image:drawPixel with indexed color
 do
@@ -534,3 +534,72 @@ do
                     2, 3 })
 
 end
+
+-- Tests for Image:remap() and Image:remapChannels()
+do
+  local idx = Image(3, 2, ColorMode.INDEXED)
+  array_to_pixels({ 0, 1, 2,
+                    2, 1, 0 }, idx)
+  idx:remap({ [1]=5, [2]=1 })
+  expect_img(idx, { 0, 5, 1,
+                    1, 5, 0 })
+
+  local r = rgba(255, 0, 0, 255)
+  local g = rgba(0, 255, 0, 255)
+  local b = rgba(0, 0, 255, 255)
+  local rgb = Image(2, 2)
+  array_to_pixels({ r, g,
+                    b, 0 }, rgb)
+  rgb:remap({ [r]=b, [b]=r })
+  expect_img(rgb, { b, g,
+                    r, 0 })
+
+  local invert = {}
+  for i=0,255 do invert[i] = 255-i end
+  rgb:remapChannels{ red=invert, blue=invert }
+  expect_img(rgb, { rgba(255, 0, 0, 255), rgba(255, 255, 255, 255),
+                    rgba(0, 0, 255, 255), rgba(255, 0, 255, 0) })
+
+  local gray = Image(2, 1, ColorMode.GRAYSCALE)
+  array_to_pixels({ app.pixelColor.graya(10, 255),
+                    app.pixelColor.graya(20, 128) }, gray)
+  gray:remapChannels{ gray=invert }
+  expect_img(gray, { app.pixelColor.graya(245, 255),
+                     app.pixelColor.graya(235, 128) })
+
+  -- Remap a cel image with undo
+  local spr = Sprite(2, 1, ColorMode.INDEXED)
+  local cel = spr.cels[1]
+  array_to_pixels({ 1, 2 }, cel.image)
+  cel.image:remap({ [2]=3 })
+  expect_img(cel.image, { 1, 3 })
+  app.undo()
+  expect_img(cel.image, { 1, 2 })
+end
+
+-- Tests for Image:bytesView()
+do
+  local img = Image(2, 2)
+  array_to_pixels({ rgba(1, 2, 3, 4), rgba(5, 6, 7, 8),
+                    0, 0 }, img)
+  local view = img:bytesView()
+  assert(#view == 2*2*4)
+  assert(view[1] == 1)
+  assert(view[8] == 8)
+  assert(view:getUint32(2) == rgba(5, 6, 7, 8))
+  assert(view:toString() == img.bytes)
+
+  view[9] = 255
+  view:setUint32(4, rgba(9, 10, 11, 12))
+  expect_img(img, { rgba(1, 2, 3, 4), rgba(5, 6, 7, 8),
+                    rgba(255, 0, 0, 0), rgba(9, 10, 11, 12) })
+
+  local row2 = view:slice(9, 16)
+  assert(#row2 == 8)
+  assert(row2[1] == 255)
+  assert(row2:getUint32(2) == rgba(9, 10, 11, 12))
+
+  -- The view is invalid after resizing the image
+  img:resize(4, 4)
+  assert(not pcall(function() return view[1] end))
+end
@@ -1,4 +1,4 @@
--- Copyright (C) 2023  Igara Studio S.A.
+-- Copyright (C) 2023-2024  Igara Studio S.A.
 --
 -- This file is released under the terms of the MIT license.
 -- Read LICENSE.txt for more information.
@@ -101,3 +101,53 @@ do
 
   assert(tostring(o) == '{"a": [10, 20, 30, 40], "b": {"c": 1, "d": 2}}')
 end
+
+-- Decode directly to Lua tables
+do
+  local t = json.decode('{"a": [1, 2.5, "x\\n\\u00e1\\ud83d\\ude00"], "b": {"c": true, "d": null}}',
+                        { tables=true })
+  assert(type(t) == "table")
+  assert(type(t.a) == "table")
+  assert(t.a[1] == 1)
+  assert(math.type(t.a[1]) == "integer")
+  assert(t.a[2] == 2.5)
+  assert(t.a[3] == "x\ná😀")
+  assert(t.b.c == true)
+  assert(t.b.d == nil)
+  assert(json.encode(t) == '{"a": [1, 2.5, "x\\ná😀"], "b": {"c": true}}')
+
+  assert(not pcall(function() json.decode('{"a": 1', { tables=true }) end))
+  assert(not pcall(function() json.decode('[1, 2] 3', { tables=true }) end))
+end
+
+-- Encoding escapes and sorted keys
+do
+  assert(json.encode({ b=1, a="q\"\\\t" }) == '{"a": "q\\"\\\\\\t", "b": 1}')
+  assert(json.encode({ [1]=10, [2]=20 }) == '[10, 20]')
+
+  local r = {}
+  r.r = r
+  assert(not pcall(function() json.encode(r) end))
+end
+
+-- MessagePack
+do
+  local v = { a={ 1, -1, 200, -200, 70000, 1.5, "hi", true, false },
+              b={ c="d" }, n=-5000000000 }
+  local data = json.encodeMessagePack(v)
+  local w = json.decodeMessagePack(data)
+  assert(json.encode(v) == json.encode(w))
+  assert(math.type(w.n) == "integer")
+  assert(w.n == -5000000000)
+
+  assert(json.encodeMessagePack(nil) == "\xc0")
+  assert(json.encodeMessagePack(true) == "\xc3")
+  assert(json.encodeMessagePack(5) == "\x05")
+  assert(json.encodeMessagePack(-1) == "\xff")
+  assert(json.encodeMessagePack("abc") == "\xa3abc")
+  assert(json.encodeMessagePack({ 1, 2 }) == "\x92\x01\x02")
+  assert(json.decodeMessagePack("\xcd\x01\x00") == 256)
+  assert(json.decodeMessagePack("\xca\x3f\xc0\x00\x00") == 1.5)
+
+  assert(not pcall(function() json.decodeMessagePack("\x92\x01") end))
+end
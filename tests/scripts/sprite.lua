@@ -1,4 +1,4 @@
--- Copyright (C) 2019-2023  Igara Studio S.A.
+-- Copyright (C) 2019-2024  Igara Studio S.A.
 -- Copyright (C) 2018  David Capello
 --
 -- This file is released under the terms of the MIT license.
@@ -228,3 +228,43 @@ do
   c = app.open(fn)
   assert(c.tileManagementPlugin == nil)
 end
+
+-- Sprite.undoHistory
+do
+  local s = Sprite(32, 32)
+  assert(#s.undoHistory == 0)
+
+  s.width = 64
+  s.height = 64
+  local h = s.undoHistory
+  assert(#h == 2)
+  assert(h[1].memSize > 0)
+  assert(h[1].executionTime >= 0)
+  assert(h[1].undoTime == 0)
+  assert(not h[1].isCurrent)
+  assert(h[2].isCurrent)
+
+  app.undo()
+  h = s.undoHistory
+  assert(#h == 2)
+  assert(h[1].isCurrent)
+  assert(h[2].undoTime >= 0)
+end
+
+-- Sprite.memoryUsage/Layer.memoryUsage
+do
+  local s = Sprite(32, 32)
+  local m = s.memoryUsage
+  assert(m.images >= 32*32*4)
+  assert(m.cels > 0)
+  assert(m.total >= m.images + m.cels + m.palettes + m.undoHistory)
+  assert(s.layers[1].memoryUsage >= 32*32*4)
+
+  local l = s:newLayer()
+  assert(l.memoryUsage == 0)
+
+  s:newCel(l, 1, Image(64, 64))
+  assert(l.memoryUsage >= 64*64*4)
+  assert(s.memoryUsage.images >= 32*32*4 + 64*64*4)
+  assert(s.memoryUsage.undoHistory > 0)
+end
@@ -0,0 +1,54 @@
+-- Copyright (C) 2024  Igara Studio S.A.
+--
+-- This file is released under the terms of the MIT license.
+-- Read LICENSE.txt for more information.
+
+-- Count the non-transparent pixels of an image in a worker
+do
+  local img = Image(32, 32, ColorMode.RGB)
+  img:drawPixel(1, 2, Color(255, 0, 0))
+  img:drawPixel(30, 31, Color(0, 255, 0))
+
+  local msgs = {}
+  local result, err
+  local w = Worker{
+    code=[[
+      local bytes, n = ...
+      local count = 0
+      for i=4,#bytes,4 do
+        if bytes:byte(i) ~= 0 then count = count + 1 end
+      end
+      postMessage("done " .. n)
+      return tostring(count)
+    ]],
+    args={ img.bytes, "32x32" },
+    onmessage=function(msg) table.insert(msgs, msg) end,
+    onfinish=function(r, e) result, err = r, e end }
+  w:start()
+  w:wait()
+  assert(not w.isRunning)
+  assert(#msgs == 1)
+  assert(msgs[1] == "done 32x32")
+  assert(result == "2")
+  assert(err == nil)
+end
+
+-- Errors are reported to onfinish()
+do
+  local err
+  local w = Worker{ code="error('bad')",
+                    onfinish=function(r, e) err = e end }
+  w:start()
+  w:wait()
+  assert(err:find("bad"))
+end
+
+-- No access to the app API or io library
+do
+  local result
+  local w = Worker{ code="return tostring(app == nil and io == nil)",
+                    onfinish=function(r) result = r end }
+  w:start()
+  w:wait()
+  assert(result == "true")
+end